@@ -0,0 +1,112 @@
+#ifndef CGICACHE_HPP
+#define CGICACHE_HPP
+
+#include <cstddef>
+#include <ctime>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+class ClientConnection;
+
+/**
+ * @brief Per-process cache of CGI, FastCGI and proxy_pass responses
+ *        (cgi_cache)
+ *
+ * Entries are the raw CGI output ("Status: ...", headers, blank line,
+ * body), replayed through CGIHandler::buildResponseFromCGIOutput() on a
+ * hit. A miss takes the key's lock: the other requests for it wait for
+ * that one response instead of each starting the script.
+ */
+class CGICache {
+public:
+  /** @brief Outcome of lookup() */
+  enum Lookup {
+    HIT,   // output is the cached response
+    FILL,  // Miss, the caller holds the lock: run the origin, then store()
+    WAIT,  // Miss, another request is filling the key: wait()
+    BYPASS // Not cacheable for now: run the origin, store nothing
+  };
+
+  CGICache();
+  ~CGICache();
+
+  /** @brief Memory budget and optional disk directory, drops entries */
+  void configure(size_t budgetBytes, const std::string &diskPath);
+  bool isEnabled() const;
+  /** @brief Largest output stored (a quarter of the budget) */
+  size_t getMaxEntrySize() const;
+
+  /**
+   * @param fill Whether a miss may take the lock (GET only)
+   * @param output Receives the response on HIT (valid until the next
+   *        store/release)
+   * @param age Receives the seconds since it was stored, on HIT
+   */
+  Lookup lookup(const std::string &key, bool fill, const std::string *&output,
+                time_t &age);
+  /** @brief Stores the filled response (ttl > 0) and releases the lock */
+  void store(const std::string &key, const std::string &output, long ttl);
+  /**
+   * @brief Releases the lock without an entry
+   * @param uncacheable The response may not be cached: requests for the
+   *        key skip the lock for a while instead of queuing again
+   */
+  void release(const std::string &key, bool uncacheable);
+
+  /** @brief Parks client until the lock of key is released */
+  void wait(const std::string &key, ClientConnection *client);
+  /** @brief client stopped waiting (timed out or closed) */
+  void cancel(const std::string &key, ClientConnection *client);
+  /** @brief Waiters whose lock was released since the last call */
+  void takeWoken(std::vector<ClientConnection *> &out);
+  bool hasWoken() const;
+
+  /** @brief Seconds the output of a fill may be cached, 0 = not at all */
+  static long lifetime(const std::string &output, long defaultValid,
+                       const std::vector<std::string> &keyHeaders,
+                       time_t now);
+
+  size_t size() const;
+  size_t getUsedBytes() const;
+  unsigned long getHits() const;
+  unsigned long getMisses() const;
+
+private:
+  struct Entry {
+    std::string output;
+    time_t stored;
+    time_t expires;
+    std::list<std::string>::iterator lruPos;
+  };
+  typedef std::map<std::string, Entry> EntryMap;
+  typedef std::map<std::string, std::vector<ClientConnection *> > LockMap;
+
+  /** @brief Seconds an uncacheable key skips the lock */
+  static const time_t PASS_TIME = 10;
+
+  EntryMap _entries;
+  std::list<std::string> _lru; // Front = most recently used
+  LockMap _locks;              // Keys being filled, with their waiters
+  std::map<std::string, time_t> _passes; // Uncacheable keys, until then
+  std::vector<ClientConnection *> _woken;
+  size_t _budget; // Max bytes of output (0 = disabled)
+  size_t _used;
+  std::string _diskPath; // "" = memory only
+  unsigned long _hits;
+  unsigned long _misses;
+
+  void erase(EntryMap::iterator it);
+  Entry *insert(const std::string &key, const std::string &output,
+                time_t stored, time_t expires);
+  void wake(const std::string &key);
+  std::string diskFile(const std::string &key) const;
+  Entry *loadFromDisk(const std::string &key, time_t now);
+  void saveToDisk(const std::string &key, const Entry &entry) const;
+
+  CGICache(const CGICache &);
+  CGICache &operator=(const CGICache &);
+};
+
+#endif
@@ -26,9 +26,20 @@ public:
 
   /** @brief Convert to char** for execve (caller must free) */
   char **toEnvArray() const;
-  void freeEnvArray(char **env) const;
+  static void freeEnvArray(char **env);
+
+  /** @brief Variables fixed for a location (built once at config load) */
+  static std::string buildTemplate(int serverPort);
+  /** @brief envp of a request in one allocation (freeEnvArray()) */
+  static char **buildEnvArray(const std::string &envTemplate,
+                              const HttpRequest &request,
+                              const std::string &scriptPath,
+                              const std::string &scriptName,
+                              const std::string &serverName);
 
   std::string getVar(const std::string &key) const;
+  /** @brief Every variable prepared (FastCGI params) */
+  const std::map<std::string, std::string> &getVars() const;
   void printAll() const;
 };
 
@@ -15,6 +15,7 @@
 struct CGIAsyncResult
 {
   int pipeFd;     // Pipe to read CGI output (non-blocking)
+  int stdinFd;    // Pipe to write the request body (non-blocking, -1 = none)
   pid_t childPid; // PID of forked CGI process
   bool success;   // true if fork succeeded
 };
@@ -38,15 +39,17 @@ public:
                       const std::string &scriptPath, char **envp,
                       const std::string &requestBody);
 
-  /** @brief Async execution - forks but doesn't wait */
+  /** @brief Async execution - forks, the caller feeds stdin and reads */
   CGIAsyncResult executeAsync(const std::string &executable,
                               const std::string &scriptPath, char **envp,
-                              const std::string &requestBody);
+                              bool hasBody);
 
   static void setNonBlocking(int fd);
 
 private:
   void setupPipes();
+  pid_t spawnChild(const std::string &executable,
+                   const std::string &scriptPath, char **envp);
   void executeChild(const std::string &executable,
                     const std::string &scriptPath, char **envp);
   std::string readChildOutput();
@@ -8,6 +8,7 @@
 #include "CGIOutputParser.hpp"
 #include "http/HttpRequest.hpp"
 #include "http/HttpResponse.hpp"
+#include <map>
 #include <string>
 
 /**
@@ -28,10 +29,20 @@ public:
                              const LocationConfig &location,
                              const std::string &serverName, int serverPort);
 
+  /** @brief CGI environment of a request, as FastCGI params */
+  std::map<std::string, std::string>
+  fastcgiParams(const HttpRequest &request, const LocationConfig &location,
+                const std::string &serverName, int serverPort);
+
   /** @brief Build HTTP response from completed CGI output */
   HttpResponse buildResponseFromCGIOutput(const std::string &cgiOutput);
+  /** @brief Status + headers once the header block is in (streaming) */
+  bool buildResponseHead(const std::string &cgiOutput, HttpResponse &response,
+                         size_t &bodyOffset);
 
 private:
+  static void copyHeaders(const CGIOutputParser &parser,
+                          HttpResponse &response);
   std::string resolveScriptPath(const HttpRequest &request,
                                 const LocationConfig &location);
   std::string getScriptName(const HttpRequest &request);
@@ -1,6 +1,7 @@
 #ifndef CGIOUTPUTPARSER_HPP
 #define CGIOUTPUTPARSER_HPP
 
+#include <ctime>
 #include <map>
 #include <sstream>
 #include <string>
@@ -14,20 +15,27 @@ class CGIOutputParser {
 private:
   std::map<std::string, std::string> _headers;
   std::vector<std::string> _setCookies;
-  std::string _body;
+  size_t _bodyOffset; // Body = raw output from here to the end
   int _statusCode;
 
 public:
   CGIOutputParser();
   ~CGIOutputParser();
 
+  /** @brief Start of the body, npos while the header block is incomplete */
+  static size_t findBodyOffset(const std::string &rawOutput);
   /** @brief Parse raw CGI output into headers and body */
   void parse(const std::string &rawOutput);
 
   std::map<std::string, std::string> getHeaders() const;
   std::vector<std::string> getSetCookies() const;
-  std::string getBody() const;
+  size_t getBodyOffset() const;
   int getStatusCode() const;
+  /** @brief Value of a header whatever the case of its name, "" if absent */
+  std::string getHeader(const std::string &name) const;
+  /** @brief Seconds the output may be cached (Cache-Control, Expires),
+   *         0 = not cacheable, -1 = the script does not say */
+  long getFreshness(time_t now) const;
 };
 
 #endif
\ No newline at end of file
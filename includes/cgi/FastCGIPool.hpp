@@ -0,0 +1,53 @@
+#ifndef FASTCGIPOOL_HPP
+#define FASTCGIPOOL_HPP
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+/**
+ * @brief Persistent connections to the fastcgi_pass servers of a process
+ *
+ * acquire() hands out an idle connection (or starts a non-blocking
+ * connect()), release() keeps a connection whose last request ended
+ * cleanly for the next one.
+ */
+class FastCGIPool {
+private:
+  struct Backend {
+    bool resolved;
+    sockaddr_storage addr;
+    socklen_t addrLength;
+    std::vector<int> idle; // Connected, no request in flight
+    Backend();
+  };
+
+  /** @brief Idle connections kept per server */
+  static const size_t MAX_IDLE = 16;
+
+  std::map<std::string, Backend> _backends; // By fastcgi_pass value
+  size_t _opened;
+  size_t _reused;
+
+  FastCGIPool(const FastCGIPool &);
+  FastCGIPool &operator=(const FastCGIPool &);
+
+  static bool resolve(const std::string &address, Backend &backend);
+  static bool isAlive(int fd);
+
+public:
+  FastCGIPool();
+  ~FastCGIPool();
+
+  /** @brief Connection to address (non-blocking), -1 on failure */
+  int acquire(const std::string &address);
+  /** @brief Keeps a connection for reuse (closed if the pool is full) */
+  void release(const std::string &address, int fd);
+
+  size_t getOpened() const;
+  size_t getReused() const;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef FASTCGIREQUEST_HPP
+#define FASTCGIREQUEST_HPP
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+/**
+ * @brief One FastCGI responder request: encoded records out, stdout in
+ *
+ * The request is serialized at once (BEGIN_REQUEST, PARAMS, STDIN) and
+ * sent as the connection drains; received records are decoded as they
+ * arrive until END_REQUEST.
+ */
+class FastCGIRequest {
+private:
+  std::string _output; // Encoded records not sent yet (from _outputSent)
+  size_t _outputSent;
+  std::string _input; // Received bytes of an incomplete record
+  bool _active;
+  bool _complete; // END_REQUEST received
+
+  static void appendRecord(std::string &out, unsigned char type,
+                           const char *data, size_t length);
+  static void appendLength(std::string &out, size_t length);
+
+public:
+  FastCGIRequest();
+  ~FastCGIRequest();
+
+  /** @brief Encodes a request (params = CGI environment) */
+  void begin(const std::map<std::string, std::string> &params,
+             const std::string &body);
+  void reset();
+
+  bool isActive() const;
+  bool hasPendingOutput() const;
+  /** @brief Sends queued records; false on a connection error */
+  bool sendPending(int fd);
+  /** @brief Decodes received bytes, appending FCGI_STDOUT data to out */
+  bool receive(const char *data, size_t length, std::string &out);
+  bool isComplete() const;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef FASTCGISPAWNER_HPP
+#define FASTCGISPAWNER_HPP
+
+#include "config/ServerConfig.hpp"
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * @brief Built-in FastCGI worker pool (fastcgi_workers)
+ *
+ * Binds the unix: socket of each fastcgi_pass that sets fastcgi_workers
+ * and pre-forks that many cgi_path interpreters accepting on it, so no
+ * external php-fpm is needed. Started once, before any server worker.
+ */
+class FastCGISpawner {
+private:
+  std::vector<pid_t> _children;
+  std::vector<std::string> _socketPaths; // Unlinked on stop()
+  pid_t _owner; // Process that spawned (forked server workers skip stop())
+
+  FastCGISpawner(const FastCGISpawner &);
+  FastCGISpawner &operator=(const FastCGISpawner &);
+
+  int bindSocket(const std::string &path);
+  bool spawn(int listenFd, const std::string &interpreter, int count);
+
+public:
+  FastCGISpawner();
+  ~FastCGISpawner();
+
+  /** @brief Starts the workers of every location; false on failure */
+  bool start(const std::vector<ServerConfig> &servers);
+  /** @brief Terminates and reaps the workers, removes the sockets */
+  void stop();
+};
+
+#endif
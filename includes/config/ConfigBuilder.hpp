@@ -2,6 +2,7 @@
 #define CONFIGBUILDER_HPP
 
 #include "../config_parser/parser/BlockParser.hpp"
+#include "GlobalConfig.hpp"
 #include "LocationConfig.hpp"
 #include "ServerConfig.hpp"
 #include "UtilsConfig.hpp"
@@ -14,8 +15,14 @@
  */
 class ConfigBuilder {
 private:
-  ServerConfig buildServer(const BlockParser &serverBlock);
-  LocationConfig buildLocation(const BlockParser &locationBlock);
+  std::map<std::string, ProxyPass> _upstreams; // upstream blocks, by name
+  std::vector<LimitReqZone> _limitZones; // limit_req_zone, looked up by name
+  LimitReq _limitReq; // limit_req inherited by the block being built
+  LimitRate _limitRate; // limit_rate(_after) inherited likewise
+
+  void buildServer(const BlockParser &serverBlock, ServerConfig &server);
+  void buildLocation(const BlockParser &locationBlock,
+                     LocationConfig &location);
 
   std::string getDirectiveValue(const BlockParser &block,
                                 const std::string &directiveName);
@@ -27,12 +34,46 @@ private:
   void parseAutoindex(const BlockParser &locationBlock,
                       LocationConfig &location);
   void parseReturn(const BlockParser &locationBlock, LocationConfig &location);
+  void parseFastcgiPass(const BlockParser &locationBlock,
+                        LocationConfig &location);
+  void parseProxyPass(const BlockParser &locationBlock,
+                      LocationConfig &location);
+  void httpParseUpstreams(const BlockParser &httpBlock);
+  void parseCGICache(const BlockParser &locationBlock,
+                     LocationConfig &location);
+  void parseLimitReqZones(const BlockParser &httpBlock,
+                          std::vector<LimitReqZone> &zones);
+  LimitReq parseLimitReq(const BlockParser &block, const LimitReq &inherited);
+  LimitRate parseLimitRate(const BlockParser &block,
+                           const LimitRate &inherited);
   void locationParseErrorPages(const BlockParser &locationBlock,
                                LocationConfig &location);
   void serverParseErrorPages(const BlockParser &serverBlock,
                              ServerConfig &server);
   void serverParseLocation(const BlockParser &serverBlock,
                            ServerConfig &server);
+  void checkDefaultServers(const std::vector<ServerConfig> &servers);
+  void checkListenOptions(const std::vector<ServerConfig> &servers);
+  void checkSsl(const std::vector<ServerConfig> &servers);
+  void serverParseSsl(const BlockParser &serverBlock, ServerConfig &server);
+  void httpParseOpenFileCache(const BlockParser &httpBlock,
+                              GlobalConfig &global);
+  void httpParseResponseCache(const BlockParser &httpBlock,
+                              GlobalConfig &global);
+  void httpParseCGICache(const BlockParser &httpBlock, GlobalConfig &global);
+  void httpParseIoBudgets(const BlockParser &httpBlock, GlobalConfig &global);
+  void httpParseIoThreads(const BlockParser &httpBlock, GlobalConfig &global);
+  void httpParseMetrics(const BlockParser &httpBlock, GlobalConfig &global);
+  void httpParseTracing(const BlockParser &httpBlock, GlobalConfig &global);
+  void httpParseTypes(
+      const BlockParser &httpBlock,
+      std::vector<std::pair<std::string, std::string> > &types,
+      GlobalConfig &global);
+  void parseConnectionLimits(const BlockParser &block, GlobalConfig &global);
+  void httpParseCompression(const BlockParser &httpBlock,
+                            GlobalConfig &global);
+  void httpParseLogs(const BlockParser &httpBlock, GlobalConfig &global);
+  void httpParseTimeouts(const BlockParser &httpBlock, GlobalConfig &global);
 
 public:
   ConfigBuilder();
@@ -40,6 +81,8 @@ public:
 
   /** @brief Build ServerConfigs from parsed configuration tree */
   std::vector<ServerConfig> buildFromBlockParser(const BlockParser &root);
+  /** @brief Build process-wide settings (main/events/http directives) */
+  GlobalConfig buildGlobal(const BlockParser &root);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,153 @@
+#ifndef GLOBALCONFIG_HPP
+#define GLOBALCONFIG_HPP
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** @brief limit_req_zone: key and rate shared by a family of buckets */
+struct LimitReqZone {
+  /** @brief What requests are counted by */
+  enum Key {
+    KEY_ADDR,   // $binary_remote_addr / $remote_addr: client address
+    KEY_SERVER, // $server_name: the virtual host
+    KEY_HEADER  // $http_<name>: a request header (absent = not limited)
+  };
+
+  std::string name;
+  Key key;
+  std::string header; // KEY_HEADER: header name
+  unsigned long rate; // Requests per 1000 seconds ("10r/s" = 10000)
+  size_t size;        // Bytes of buckets ("zone=name:1m")
+
+  LimitReqZone() : key(KEY_ADDR), rate(0), size(0) {}
+};
+
+/**
+ * @brief Process-wide settings from the main/events/http contexts
+ */
+class GlobalConfig {
+public:
+  /** @brief Inactivity timeout of each connection phase */
+  enum Timeout {
+    TIMEOUT_HEADER,    // client_header_timeout: request line + headers
+    TIMEOUT_BODY,      // client_body_timeout: whole body (h2: between reads)
+    TIMEOUT_KEEPALIVE, // keepalive_timeout: idle between two requests
+    TIMEOUT_SEND,      // send_timeout: between two successful writes
+    TIMEOUT_CGI,       // cgi_timeout: whole CGI / FastCGI / proxy exchange
+    TIMEOUT_COUNT
+  };
+
+private:
+  int _workerProcesses;
+  int _workerShutdownTimeout; // Seconds a drain may last before exiting
+  int _workerConnections;    // Client connections per process (events)
+  std::string _eventBackend; // use (events): "" = platform default
+  int _limitConnPerIp;       // Connections per client address, 0 = no cap
+  size_t _openFileCacheMax; // 0 = open_file_cache off
+  int _openFileCacheInactive;
+  int _openFileCacheValid;
+  bool _openFileCacheErrors;
+  size_t _openFileCacheMmap; // Largest file mapped, 0 = off
+  size_t _responseCacheSize; // Bytes, 0 = response cache off
+  size_t _cgiCacheSize;      // Bytes of cgi_cache entries in memory
+  std::string _cgiCachePath; // cgi_cache disk tier, "" = memory only
+  size_t _ioReadBudget;      // Bytes read per readiness event, 0 = one recv
+  size_t _ioWriteBudget;     // Bytes sent per readiness event, 0 = one send
+  int _ioThreads;            // Blocking file I/O threads, 0 = on the loop
+  bool _gzip;                // gzip on: compress responses on the fly
+  bool _gzipStatic;          // gzip_static on: serve precompressed siblings
+  bool _brotli;              // brotli on
+  int _gzipCompLevel;        // 1-9
+  size_t _gzipMinLength;     // Smaller bodies are sent as they are
+  std::vector<std::string> _gzipTypes; // MIME types besides text/html
+  std::string _errorLog;     // "stdout", "stderr" or a file path
+  int _errorLogLevel;        // Logger::Level
+  std::string _accessLog;    // "" = access_log off
+  std::string _metricsPath;  // Prometheus endpoint, "" = metrics_path off
+  long _slowRequestMs;       // slow_request_threshold, 0 = off
+  std::string _requestTrace; // Chrome trace file, "" = request_trace off
+  int _requestTraceEvery;    // One request in N is traced
+  std::vector<LimitReqZone> _limitReqZones; // Declaration order
+  // types {} / types_file: (extension, MIME type), empty = built-in table
+  std::vector<std::pair<std::string, std::string> > _mimeTypes;
+  std::string _defaultType; // Type of unknown extensions
+  int _timeouts[TIMEOUT_COUNT]; // Seconds, by Timeout
+
+public:
+  GlobalConfig();
+  GlobalConfig(const GlobalConfig &other);
+  ~GlobalConfig();
+
+  GlobalConfig &operator=(const GlobalConfig &other);
+
+  int getWorkerProcesses() const;
+  int getWorkerShutdownTimeout() const;
+  int getWorkerConnections() const;
+  const std::string &getEventBackend() const;
+  int getLimitConnPerIp() const;
+  size_t getOpenFileCacheMax() const;
+  int getOpenFileCacheInactive() const;
+  int getOpenFileCacheValid() const;
+  bool getOpenFileCacheErrors() const;
+  size_t getOpenFileCacheMmap() const;
+  size_t getResponseCacheSize() const;
+  size_t getCgiCacheSize() const;
+  const std::string &getCgiCachePath() const;
+  size_t getIoReadBudget() const;
+  size_t getIoWriteBudget() const;
+  int getIoThreads() const;
+  bool getGzip() const;
+  bool getGzipStatic() const;
+  bool getBrotli() const;
+  int getGzipCompLevel() const;
+  size_t getGzipMinLength() const;
+  const std::vector<std::string> &getGzipTypes() const;
+  const std::string &getErrorLog() const;
+  int getErrorLogLevel() const;
+  const std::string &getAccessLog() const;
+  const std::string &getMetricsPath() const;
+  long getSlowRequestThreshold() const;
+  const std::string &getRequestTrace() const;
+  int getRequestTraceEvery() const;
+  const std::vector<LimitReqZone> &getLimitReqZones() const;
+  const std::vector<std::pair<std::string, std::string> > &
+  getMimeTypes() const;
+  const std::string &getDefaultType() const;
+  int getTimeout(Timeout which) const;
+
+  void setWorkerProcesses(int workerProcesses);
+  void setWorkerShutdownTimeout(int seconds);
+  void setWorkerConnections(int connections);
+  void setEventBackend(const std::string &name);
+  void setLimitConnPerIp(int connections);
+  void setOpenFileCache(size_t maxEntries, int inactive);
+  void setOpenFileCacheValid(int seconds);
+  void setOpenFileCacheErrors(bool enabled);
+  void setOpenFileCacheMmap(size_t bytes);
+  void setResponseCacheSize(size_t bytes);
+  void setCgiCacheSize(size_t bytes);
+  void setCgiCachePath(const std::string &path);
+  void setIoReadBudget(size_t bytes);
+  void setIoWriteBudget(size_t bytes);
+  void setIoThreads(int threads);
+  void setGzip(bool enabled);
+  void setGzipStatic(bool enabled);
+  void setBrotli(bool enabled);
+  void setGzipCompLevel(int level);
+  void setGzipMinLength(size_t bytes);
+  void setGzipTypes(const std::vector<std::string> &types);
+  void setErrorLog(const std::string &target, int level);
+  void setAccessLog(const std::string &target);
+  void setMetricsPath(const std::string &path);
+  void setSlowRequestThreshold(long milliseconds);
+  void setRequestTrace(const std::string &path, int every);
+  void setLimitReqZones(const std::vector<LimitReqZone> &zones);
+  void setMimeTypes(
+      const std::vector<std::pair<std::string, std::string> > &types);
+  void setDefaultType(const std::string &type);
+  void setTimeout(Timeout which, int seconds);
+};
+
+#endif
@@ -5,6 +5,43 @@
 #include <string>
 #include <vector>
 
+/** @brief Backends of a proxy_pass location ("upstream" block or address) */
+struct ProxyPass {
+  std::string name;                 // Upstream name, or the "host:port"
+  std::vector<std::string> servers; // "host:port" of each backend
+  bool leastConn;   // "least_conn": fewest active requests, else round-robin
+  size_t keepalive; // "keepalive": idle connections kept per backend
+  std::string uri;  // Replaces the location prefix ("" = target as is)
+
+  ProxyPass() : leastConn(false), keepalive(16) {}
+};
+
+/** @brief cgi_cache settings: caching of CGI, FastCGI and proxy responses */
+struct CGICachePolicy {
+  bool enabled;                        // "cgi_cache on"
+  long valid;                          // Seconds when the response says none
+  std::vector<std::string> keyHeaders; // "cgi_cache_key": request headers
+
+  CGICachePolicy() : enabled(false), valid(0) {}
+};
+
+/** @brief limit_req of a location: zone and tolerance over its rate */
+struct LimitReq {
+  int zone;       // Index in GlobalConfig::getLimitReqZones(), -1 = off
+  size_t burst;   // Requests over the rate accepted before 429
+  bool nodelay;   // Burst served at once instead of paced to the rate
+
+  LimitReq() : zone(-1), burst(0), nodelay(false) {}
+};
+
+/** @brief limit_rate of a location: response bandwidth per connection */
+struct LimitRate {
+  size_t rate;  // Bytes per second, 0 = off
+  size_t after; // Bytes sent at full speed first (limit_rate_after)
+
+  LimitRate() : rate(0), after(0) {}
+};
+
 class LocationConfig {
 private:
   std::string _root;
@@ -12,12 +49,20 @@ private:
   std::vector<std::string> _methods;
   std::vector<std::string> _cgiPaths;
   std::vector<std::string> _cgiExts;
+  std::string _fastcgiPass; // "host:port" or "unix:/path", "" = off
+  int _fastcgiWorkers;      // cgi_path workers spawned on it (0 = none)
+  std::string _cgiEnvTemplate; // Fixed CGI variables (see CGIEnvironment)
+  ProxyPass _proxyPass;        // No servers = proxy_pass off
+  CGICachePolicy _cgiCache;
+  LimitReq _limitReq;
+  LimitRate _limitRate;
   std::map<int, std::string> _errorPages;
   int _returnCode;
   std::string _returnUrl;
   size_t _maxBodySize;
   std::string _pattern;
   std::string _uploadPath;
+  bool _uploadPreallocate;
   std::string _alias;
   bool _autoindex;
 
@@ -33,6 +78,14 @@ public:
   const std::vector<std::string> &getMethods() const;
   const std::vector<std::string> &getCgiPaths() const;
   const std::vector<std::string> &getCgiExts() const;
+  const std::string &getFastcgiPass() const;
+  int getFastcgiWorkers() const;
+  const std::string &getCgiEnvTemplate() const;
+  bool hasProxyPass() const;
+  const ProxyPass &getProxyPass() const;
+  const CGICachePolicy &getCGICache() const;
+  const LimitReq &getLimitReq() const;
+  const LimitRate &getLimitRate() const;
   const std::map<int, std::string> &getErrorPages() const;
   int getReturnCode() const;
   const std::string &getReturnUrl() const;
@@ -41,6 +94,7 @@ public:
   bool isMethodAllowed(const std::string &method) const;
   bool isUploadEnabled() const;
   const std::string &getUploadPath() const;
+  bool getUploadPreallocate() const;
   bool hasAlias() const;
   const std::string &getAlias() const;
   bool getAutoindex() const;
@@ -50,12 +104,20 @@ public:
   void setMethods(const std::vector<std::string> &methods);
   void setCgiPaths(const std::vector<std::string> &cgiPaths);
   void setCgiExts(const std::vector<std::string> &cgiExts);
+  void setFastcgiPass(const std::string &address);
+  void setFastcgiWorkers(int count);
+  void setCgiEnvTemplate(const std::string &envTemplate);
+  void setProxyPass(const ProxyPass &proxyPass);
+  void setCGICache(const CGICachePolicy &policy);
+  void setLimitReq(const LimitReq &limit);
+  void setLimitRate(const LimitRate &limit);
   void setErrorPages(const std::map<int, std::string> &errorPage);
   void setReturnCode(int returnCode);
   void setReturnUrl(const std::string &returnUrl);
   void setMaxBodySize(size_t maxBodySize);
   void setPattern(const std::string &pattern);
   void setUploadPath(const std::string &uploadPath);
+  void setUploadPreallocate(bool preallocate);
   void setAlias(const std::string &alias);
   void setAutoindex(bool autoindex);
 };
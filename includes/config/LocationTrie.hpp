@@ -0,0 +1,42 @@
+#ifndef LOCATIONTRIE_HPP
+#define LOCATIONTRIE_HPP
+
+#include "LocationConfig.hpp"
+#include <string>
+#include <vector>
+
+/**
+ * @brief Location patterns of a server compiled into a radix tree
+ *
+ * Longest-prefix lookup in O(path length) instead of one compare per
+ * location block. Returns indices into the vector the trie was built from.
+ */
+class LocationTrie {
+private:
+  struct Node {
+    std::string label;            // Bytes on the edge from the parent
+    int location;                 // Location ending here, -1 if none
+    std::vector<size_t> children; // Node indices, sorted by label[0]
+  };
+
+  std::vector<Node> _nodes; // _nodes[0] is the root (empty label)
+
+  size_t findChild(size_t node, unsigned char c) const;
+  size_t addChild(size_t node, const std::string &label, int location);
+  void split(size_t node, size_t at);
+  void insert(const std::string &pattern, int location);
+
+public:
+  LocationTrie();
+  LocationTrie(const LocationTrie &other);
+  ~LocationTrie();
+
+  LocationTrie &operator=(const LocationTrie &other);
+
+  /** @brief Replaces the tree with the patterns of locations */
+  void build(const std::vector<LocationConfig> &locations);
+  /** @brief Index of the longest pattern prefixing path, -1 if none */
+  int match(const std::string &path) const;
+};
+
+#endif
@@ -2,16 +2,58 @@
 #define SERVERCONFIG_HPP
 
 #include "LocationConfig.hpp"
+#include "LocationTrie.hpp"
 #include <map>
 #include <string>
 #include <vector>
 
+/** @brief Socket options of "listen <port> ..." (one set per port) */
+struct ListenOptions {
+  int backlog;   // "backlog=N": listen() queue length, 0 = SOMAXCONN
+  bool deferred; // "deferred": TCP_DEFER_ACCEPT
+  int fastOpen;  // "fastopen=N": TCP_FASTOPEN queue length, 0 = off
+  int sndBuf;    // "sndbuf=N": SO_SNDBUF in bytes, 0 = kernel default
+  int rcvBuf;    // "rcvbuf=N": SO_RCVBUF in bytes, 0 = kernel default
+  bool http2;    // "http2": accept HTTP/2 besides HTTP/1.1
+  bool ssl;      // "ssl": TLS on every connection of the port
+
+  ListenOptions()
+      : backlog(0), deferred(false), fastOpen(0), sndBuf(0), rcvBuf(0),
+        http2(false), ssl(false) {}
+  /**
+   * @brief Whether a socket option differs from the defaults
+   *
+   * http2 and ssl are left out: any block of the port may repeat them.
+   */
+  bool isSet() const {
+    return backlog > 0 || deferred || fastOpen > 0 || sndBuf > 0 ||
+           rcvBuf > 0;
+  }
+};
+
+/** @brief TLS settings of a server block (ssl_* directives) */
+struct SslSettings {
+  std::string certificate;    // "ssl_certificate": PEM chain
+  std::string certificateKey; // "ssl_certificate_key": PEM private key
+  int sessionCache;   // "ssl_session_cache": sessions per worker, 0 = off
+  bool sessionTickets; // "ssl_session_tickets"
+  int sessionTimeout; // "ssl_session_timeout": seconds
+
+  SslSettings()
+      : sessionCache(20480), sessionTickets(true), sessionTimeout(300) {}
+};
+
 /**
  * @brief Server block configuration - virtual host settings
  */
 class ServerConfig {
 private:
   int _listen;
+  bool _defaultServer; // "listen <port> default_server"
+  ListenOptions _listenOptions;
+  bool _tcpNoDelay; // "tcp_nodelay": TCP_NODELAY on accepted sockets
+  bool _tcpNoPush;  // "tcp_nopush": TCP_CORK around sendfile() bodies
+  SslSettings _ssl;
   std::string _host;
   std::vector<std::string> _serverNames;
   std::string _root;
@@ -19,6 +61,7 @@ private:
   std::map<int, std::string> _errorPages;
   size_t _clientMaxBodySize;
   std::vector<LocationConfig> _locations;
+  LocationTrie _locationTrie; // Compiled from _locations by setLocations()
 
 public:
   ServerConfig();
@@ -28,6 +71,11 @@ public:
   ServerConfig &operator=(const ServerConfig &other);
 
   int getListen() const;
+  bool isDefaultServer() const;
+  const ListenOptions &getListenOptions() const;
+  bool getTcpNoDelay() const;
+  bool getTcpNoPush() const;
+  const SslSettings &getSsl() const;
   const std::string &getHost() const;
   const std::vector<std::string> &getServerNames() const;
   const std::string &getRoot() const;
@@ -35,8 +83,14 @@ public:
   const std::map<int, std::string> &getErrorPages() const;
   size_t getClientMaxBodySize() const;
   const std::vector<LocationConfig> &getLocations() const;
+  const LocationConfig *matchLocation(const std::string &path) const;
 
   void setListen(int listen);
+  void setDefaultServer(bool defaultServer);
+  void setListenOptions(const ListenOptions &options);
+  void setTcpNoDelay(bool tcpNoDelay);
+  void setTcpNoPush(bool tcpNoPush);
+  void setSsl(const SslSettings &ssl);
   void setHost(const std::string &host);
   void setServerNames(const std::vector<std::string> &serverNames);
   void setRoot(const std::string &root);
@@ -44,6 +98,8 @@ public:
   void setErrorPages(const std::map<int, std::string> &errorPages);
   void setClientMaxBodySize(size_t clientMaxBodySize);
   void setLocations(const std::vector<LocationConfig> &locations);
+  /** @brief Same as setLocations(), swapping the vector in (no copy) */
+  void takeLocations(std::vector<LocationConfig> &locations);
 };
 
 #endif
\ No newline at end of file
@@ -6,5 +6,11 @@
 
 /** @brief Convert string to integer (C++98 compatible) */
 int stringToInt(const std::string &value);
+/** @brief Convert nginx-style time ("30", "30s", "5m", "1h") to seconds */
+int parseDuration(const std::string &value);
+/** @brief Same, plus "ms", to milliseconds ("250ms", "2s") */
+long parseMilliseconds(const std::string &value);
+/** @brief Convert nginx-style size ("512", "8k", "4m", "1g") to bytes */
+long parseSize(const std::string &value);
 
 #endif
\ No newline at end of file
@@ -2,9 +2,12 @@
 #define BLOCKPARSER_HPP
 
 #include "DirectiveParser.hpp"
+#include <map>
 #include <string>
 #include <vector>
 
+class ConfigReader;
+
 /**
  * @brief Configuration block parser - represents { } blocks in config
  */
@@ -15,6 +18,10 @@ private:
   int endLine;
   std::vector<DirectiveToken> directives;
   std::vector<BlockParser> nestedBlocks;
+  // First directive of each name that has values (index in directives)
+  std::map<std::string, size_t> directiveIndex;
+
+  void indexDirective(size_t position);
 
 public:
   BlockParser();
@@ -22,9 +29,11 @@ public:
   BlockParser &operator=(const BlockParser &other);
   ~BlockParser();
 
-  std::string getName() const;
-  std::vector<DirectiveToken> getDirectives() const;
-  std::vector<BlockParser> getNestedBlocks() const;
+  const std::string &getName() const;
+  const std::vector<DirectiveToken> &getDirectives() const;
+  const std::vector<BlockParser> &getNestedBlocks() const;
+  /** @brief First directive named name with values, NULL if none */
+  const DirectiveToken *findDirective(const std::string &directiveName) const;
   int getStartLine() const;
   int getEndLine() const;
 
@@ -33,10 +42,14 @@ public:
 
   void addDirective(const DirectiveToken &directive);
   void addNest(const BlockParser &nest);
-
-  /** @brief Recursively parse a configuration block from file */
-  static BlockParser parseBlock(std::ifstream &file,
-                                const std::string &blockName, int &lineNumber);
+  /** @brief Appends an empty nested block and returns it (no copy) */
+  BlockParser &addNest(const std::string &nestName, int start);
+  /** @brief Appends a directive made of tokens (taken over) */
+  bool addDirective(std::vector<std::string> &tokens, int lineNumber);
+
+  /** @brief Recursively parse the body of block from the file */
+  static void parseBlock(ConfigReader &reader, BlockParser &block,
+                         int &lineNumber);
   void printBlock(const BlockParser &block);
 };
 
@@ -0,0 +1,55 @@
+#ifndef CONFIGREADER_HPP
+#define CONFIGREADER_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Configuration file mapped in memory and walked once
+ *
+ * Hands the parser one significant line at a time (trimmed, comments
+ * stripped, blank lines skipped) and runs the structural checks of
+ * validateStructure() on the same line as it goes, so the file is read
+ * once instead of once per phase.
+ */
+class ConfigReader {
+public:
+  explicit ConfigReader(const std::string &filePath);
+  ~ConfigReader();
+
+  bool isOpen() const;
+  /**
+   * @brief Next significant line
+   * @param line Receives the line (storage reused)
+   * @param lineNumber Receives its number in the file (1-based)
+   * @return false at end of file
+   */
+  bool nextLine(std::string &line, int &lineNumber);
+  /** @brief Walks the rest of the file (structural checks only) */
+  void drain();
+  /** @brief Structural errors of the lines walked, brace balance included */
+  bool checkStructure(std::vector<std::string> &errors) const;
+  /** @brief Lines walked so far */
+  int getLineCount() const;
+
+private:
+  std::string _path;
+  const char *_data; // Mapped file (NULL if empty or not open)
+  size_t _size;
+  size_t _pos;
+  int _lineNumber;
+  bool _open;
+
+  // validateStructure() state
+  std::vector<std::string> _errors;
+  int _openBraces;
+  int _closeBraces;
+  int _firstOpenLine;
+  int _lastCloseLine;
+
+  ConfigReader(const ConfigReader &);
+  ConfigReader &operator=(const ConfigReader &);
+};
+
+#endif
@@ -4,17 +4,21 @@
 #include "../validation/SemanticValidator.hpp"
 #include "../validation/ValidationStructureConfig.hpp"
 #include "BlockParser.hpp"
+#include "ConfigReader.hpp"
 #include "DirectiveParser.hpp"
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
 std::string trimLine(const std::string &line);
 bool isEmptyOrComment(const std::string &trimmedLine);
 std::vector<std::string> tokenize(const std::string &line, int numLine);
+/** @brief Parses the lines of reader into root (no validation) */
+void readConfig(ConfigReader &reader, BlockParser &root);
 BlockParser readConfigFile(const std::string &filePath);
 int initConfigParser(const std::string &configPath);
 
@@ -12,7 +12,8 @@ enum Context {
   CTX_EVENTS = 2,
   CTX_HTTP = 4,
   CTX_SERVER = 8,
-  CTX_LOCATION = 16
+  CTX_LOCATION = 16,
+  CTX_UPSTREAM = 32
 };
 
 /** @brief Argument type for validation */
@@ -25,7 +26,8 @@ enum ArgumentType {
   ARG_IP,
   ARG_HTTP,
   ARG_BOOL,
-  ARG_PATTERN
+  ARG_PATTERN,
+  ARG_LISTEN // listen parameter: default_server, backlog=N, deferred...
 };
 
 /** @brief Directive validation rule */
@@ -46,14 +48,19 @@ private:
   static const DirectiveRule rules[];
   static const size_t rulesCount;
 
+  static const DirectiveRule *const *sortedRules();
+
   static bool validateArgumentTypes(const DirectiveRule *rule,
                                     const std::vector<std::string> &args);
 
 public:
   static const DirectiveRule *getRule(const std::string &directiveName);
   static bool isValidInContext(const std::string &directive, Context ctx);
+  static bool isValidInContext(const DirectiveRule *rule, Context ctx);
   static bool validateArguments(const std::string &directive,
                                 const std::vector<std::string> &args);
+  static bool validateArguments(const DirectiveRule *rule,
+                                const std::vector<std::string> &args);
 };
 
 #endif
\ No newline at end of file
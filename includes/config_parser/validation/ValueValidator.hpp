@@ -12,5 +12,6 @@ bool isValidIP(const std::string &value);
 bool isValidHttpCode(const std::string &value);
 bool isValidBool(const std::string &value);
 bool isValidPattern(const std::string &value);
+bool isValidListenParam(const std::string &value);
 
 #endif
\ No newline at end of file
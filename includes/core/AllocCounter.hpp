@@ -0,0 +1,17 @@
+#pragma once
+
+/**
+ * @brief Process-wide heap allocation counter (make COUNT_ALLOCS=1)
+ *
+ * Built without WEBSERV_COUNT_ALLOCS the global operator new is not
+ * replaced, enabled() is false and count() always returns 0.
+ */
+class AllocCounter {
+private:
+  AllocCounter();
+
+public:
+  static bool enabled();
+  /** @brief operator new / new[] calls since the process started */
+  static unsigned long count();
+};
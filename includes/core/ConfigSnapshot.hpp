@@ -0,0 +1,59 @@
+#pragma once
+
+#include "config/ServerConfig.hpp"
+#include "http/ErrorPageCache.hpp"
+#include "http/VirtualHostTable.hpp"
+#include "network/TlsContext.hpp"
+#include <map>
+#include <vector>
+
+/** @brief Server blocks of one listening port and their server_names */
+struct ListenerConfig {
+  std::vector<ServerConfig> servers; // Configuration order
+  VirtualHostTable hosts;
+  ListenOptions options; // Socket options, from the block that set them
+  bool tcpNoDelay;       // Accepted socket policy of the port's default
+  bool tcpNoPush;        // server block (no Host is known at accept time)
+  TlsContext *tls;       // "ssl" ports, else NULL (owned by the snapshot)
+
+  ListenerConfig() : tcpNoDelay(true), tcpNoPush(false), tls(NULL) {}
+};
+
+/**
+ * @brief Immutable, reference-counted view of one loaded configuration
+ *
+ * Built once per configuration load. Every connection holds a reference
+ * for its lifetime, so a snapshot replaced by a reload stays valid until
+ * its last connection is gone.
+ */
+class ConfigSnapshot {
+private:
+  std::vector<ServerConfig> _servers;
+  std::map<int, ListenerConfig> _listeners; // By port
+  ErrorPageCache _errorPages;
+  size_t _refs;
+
+  ConfigSnapshot(const ConfigSnapshot &);
+  ConfigSnapshot &operator=(const ConfigSnapshot &);
+  ~ConfigSnapshot();
+  void releaseTls();
+
+public:
+  /**
+   * @brief Groups servers by port, indexes names, reads error pages and
+   *        loads the certificates of the "ssl" ports
+   * @throws std::runtime_error if a certificate cannot be loaded
+   */
+  explicit ConfigSnapshot(const std::vector<ServerConfig> &servers);
+
+  /** @brief Takes a reference (the creator already holds one) */
+  void retain();
+  /** @brief Drops a reference; the last one deletes the snapshot */
+  void release();
+
+  const std::vector<ServerConfig> &getServers() const;
+  const std::map<int, ListenerConfig> &getListeners() const;
+  /** @brief Blocks listening on port, NULL if none */
+  const ListenerConfig *findListener(int port) const;
+  const ErrorPageCache &getErrorPages() const;
+};
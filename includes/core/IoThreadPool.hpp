@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <pthread.h>
+#include <stdint.h>
+#include <vector>
+
+class ClientConnection;
+class UringRing;
+
+/**
+ * @brief One system call of a task, submitted to the pool's io_uring
+ *
+ * Mirrors the SQE: the buffers and path belong to the task and stay
+ * valid until stepDone().
+ */
+struct IoStep {
+  enum Op { STATX, OPENAT, READ };
+
+  Op op;
+  int fd;           // File (READ), or directory fd (AT_FDCWD) for paths
+  const char *path; // STATX, OPENAT
+  int flags;        // AT_* (STATX), O_* (OPENAT)
+  void *buffer;     // struct statx (STATX), destination (READ)
+  unsigned length;  // STATX_* mask (STATX), bytes (READ)
+  uint64_t offset;  // READ
+};
+
+/**
+ * @brief Blocking filesystem work run by an I/O thread for a connection
+ *
+ * run() executes on an I/O thread and may only use its own members and
+ * system calls (no logging, no caches, no connection state). complete()
+ * executes back on the event loop, where the results are installed.
+ */
+class IoTask {
+private:
+  ClientConnection *_owner; // Parked connection, NULL once it went away
+
+  IoTask(const IoTask &);
+  IoTask &operator=(const IoTask &);
+
+public:
+  IoTask();
+  virtual ~IoTask();
+
+  /** @brief I/O thread: the blocking system calls */
+  virtual void run() = 0;
+  /** @brief Event loop: installs the results before the request is
+   *  handled again (now without blocking) */
+  virtual void complete() = 0;
+
+  /**
+   * @brief Event loop: the next system call to run through io_uring
+   *
+   * Tasks that support it run as a chain of steps instead of on a thread
+   * (see IoThreadPool::enableUring()). Default: none, run() is used.
+   *
+   * @return false when the task is finished (or, before the first step,
+   *         runs on a thread)
+   */
+  virtual bool nextStep(IoStep &step);
+  /** @brief Event loop: result of the step (>= 0, or -errno) */
+  virtual void stepDone(int result);
+
+  void setOwner(ClientConnection *owner);
+  ClientConnection *getOwner() const;
+  /** @brief The owner is being deleted: results are dropped */
+  void cancel();
+};
+
+/**
+ * @brief Per-process pool of threads for blocking disk I/O
+ */
+class IoThreadPool {
+private:
+  std::vector<pthread_t> _threads;
+  pthread_mutex_t _mutex; // Guards _queue, _done, _stopping
+  pthread_cond_t _wakeup; // Signalled when a task is queued or on stop
+  std::deque<IoTask *> _queue;
+  std::vector<IoTask *> _done;
+  bool _stopping;
+  int _notifyRead;  // Readable while _done is not empty (event loop side)
+  int _notifyWrite; // Same fd as _notifyRead with eventfd
+  unsigned long _submitted;
+  UringRing *_ring;  // Step-wise tasks (enableUring()), NULL if off
+  size_t _ringTasks; // Tasks with a step in flight
+
+  IoThreadPool(const IoThreadPool &);
+  IoThreadPool &operator=(const IoThreadPool &);
+
+  static void *threadMain(void *arg);
+  void work();
+  void notify();
+  void queueStep(IoTask *task, const IoStep &step);
+  void reapSteps(std::vector<IoTask *> &done);
+
+public:
+  IoThreadPool();
+  ~IoThreadPool();
+
+  /** @brief Starts the threads (false: none could be created) */
+  bool start(int threads);
+  /**
+   * @brief Runs the tasks that support it through an io_uring instead
+   *        of the threads (after start(); false: not available)
+   */
+  bool enableUring();
+  /** @brief Joins the threads and deletes the tasks not collected */
+  void stop();
+  bool isEnabled() const;
+
+  /** @brief Queues a task; it comes back through collect() */
+  void submit(IoTask *task);
+  /** @brief Event loop fd, POLLIN when finished tasks wait */
+  int getNotifyFd() const;
+  /** @brief Moves the finished tasks to done (caller deletes them) */
+  void collect(std::vector<IoTask *> &done);
+
+  size_t getThreadCount() const;
+  unsigned long getSubmitted() const;
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+/*
+ * Lowest level compiled in (make LOG_LEVEL=1 drops every LOG_DEBUG):
+ * 0 debug, 1 info, 2 warn, 3 error
+ */
+#ifndef WEBSERV_LOG_LEVEL
+#define WEBSERV_LOG_LEVEL 0
+#endif
+
+/**
+ * @brief Leveled, batched error log plus the access log and request trace
+ *
+ * Lines are formatted into a fixed line buffer and appended to a per-log
+ * batch; the event loop writes each batch with a single write() per
+ * iteration (flush()). Use the LOG_* macros: the message expression is
+ * only evaluated when its level is enabled.
+ */
+class Logger {
+private:
+  static int _level;
+
+  Logger();
+
+public:
+  enum Level { DEBUG = 0, INFO = 1, WARN = 2, ERROR = 3, OFF = 4 };
+
+  /** @brief Longest line kept (longer ones are truncated) */
+  static const size_t LINE_SIZE = 2048;
+  /** @brief Bytes buffered per log before a write() is forced */
+  static const size_t BATCH_SIZE = 64 * 1024;
+
+  /** @brief Opens the logs ("stdout", "stderr" or a path; "" = off) */
+  static bool configure(const std::string &errorLog, int level,
+                        const std::string &accessLog);
+  /** @brief "debug" / "info" / "warn" / "error" → Level, -1 if unknown */
+  static int parseLevel(const std::string &name);
+
+  /** @brief Opens the request trace (Chrome trace JSON; "" = off) */
+  static bool configureTrace(const std::string &traceLog);
+
+  static bool enabled(int level) { return level >= _level; }
+  static bool accessEnabled();
+  static bool traceEnabled();
+
+  /** @brief Starts an error log line (timestamp and level tag written) */
+  static std::ostream &begin(int level);
+  /** @brief Starts an access log line */
+  static std::ostream &beginAccess();
+  /** @brief Starts a request trace line (one trace event) */
+  static std::ostream &beginTrace();
+  /** @brief Ends the current line and queues it in its batch */
+  static void end();
+  /** @brief Writes out every pending batch */
+  static void flush();
+
+  /** @brief [day/Mon/year:hh:mm:ss zone] of the current second */
+  static const char *accessTime();
+  /** @brief Bytes lost because a log write() failed */
+  static unsigned long dropped();
+};
+
+/**
+ * @brief Bounded, single-line view of raw bytes for debug lines
+ *
+ * Streams at most LIMIT bytes; control bytes, quotes and backslashes are
+ * escaped (\r, \n, \xHH) so a dumped request stays on one log line and
+ * access log fields stay quotable.
+ */
+struct LogExcerpt {
+  static const size_t LIMIT = 256;
+
+  const char *data;
+  size_t length;
+
+  LogExcerpt(const char *excerptData, size_t excerptLength)
+      : data(excerptData), length(excerptLength) {}
+};
+
+std::ostream &operator<<(std::ostream &out, const LogExcerpt &excerpt);
+
+#define WEBSERV_LOG(level, expr)                                             \
+  do {                                                                       \
+    if (Logger::enabled(level)) {                                            \
+      Logger::begin(level) << expr;                                          \
+      Logger::end();                                                         \
+    }                                                                        \
+  } while (0)
+
+// Compiled-out level: type-checked, never evaluated, no code emitted
+#define WEBSERV_LOG_OFF(level, expr)                                         \
+  do {                                                                       \
+    if (false) {                                                             \
+      Logger::begin(level) << expr;                                          \
+    }                                                                        \
+  } while (0)
+
+#if WEBSERV_LOG_LEVEL <= 0
+#define LOG_DEBUG(expr) WEBSERV_LOG(Logger::DEBUG, expr)
+#else
+#define LOG_DEBUG(expr) WEBSERV_LOG_OFF(Logger::DEBUG, expr)
+#endif
+
+#if WEBSERV_LOG_LEVEL <= 1
+#define LOG_INFO(expr) WEBSERV_LOG(Logger::INFO, expr)
+#else
+#define LOG_INFO(expr) WEBSERV_LOG_OFF(Logger::INFO, expr)
+#endif
+
+#if WEBSERV_LOG_LEVEL <= 2
+#define LOG_WARN(expr) WEBSERV_LOG(Logger::WARN, expr)
+#else
+#define LOG_WARN(expr) WEBSERV_LOG_OFF(Logger::WARN, expr)
+#endif
+
+#define LOG_ERROR(expr) WEBSERV_LOG(Logger::ERROR, expr)
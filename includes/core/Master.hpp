@@ -0,0 +1,43 @@
+#pragma once
+
+#include "config/GlobalConfig.hpp"
+#include "config/ServerConfig.hpp"
+#include <ctime>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * @brief Master process - forks, supervises and stops worker processes
+ */
+class Master {
+private:
+  std::vector<ServerConfig> _servConfigsList;
+  std::string _configPath; // Re-read on SIGHUP ("" = reload disabled)
+  GlobalConfig _globalConfig;
+  std::vector<std::string> _commandLine; // Exec'd on SIGUSR2
+  pid_t _upgradePid;                     // New binary, 0 = none
+  std::vector<pid_t> _workers;     // slot → worker pid (0 = not running)
+  std::vector<time_t> _spawnTimes; // slot → last fork() time
+
+  pid_t spawnWorker(size_t slot);
+  int runWorker(size_t slot);
+  int findSlot(pid_t pid) const;
+  void stopWorkers();
+  void reloadWorkers();
+  void upgradeBinary();
+
+public:
+  Master(const std::vector<ServerConfig> &configs,
+         const GlobalConfig &globalConfig);
+  ~Master();
+
+  /** @brief Configuration file re-read when SIGHUP is received */
+  void setConfigPath(const std::string &path);
+
+  /** @brief Command line of the binary started on SIGUSR2 */
+  void setCommandLine(int argc, char **argv);
+
+  /** @brief Fork workers and supervise them until SIGINT/SIGTERM/SIGQUIT */
+  int run();
+};
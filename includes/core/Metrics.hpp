@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * @brief Owner of values read at scrape time only (gauges, cache counters)
+ */
+class MetricsSource {
+public:
+  virtual ~MetricsSource();
+  /** @brief Appends its metrics, in Prometheus text format */
+  virtual void appendMetrics(std::string &out) const = 0;
+};
+
+/**
+ * @brief Process-wide counters and latency histograms (metrics_path)
+ *
+ * Updated from the hot path with plain integer arithmetic on fixed arrays;
+ * only render() (a scrape) formats and allocates.
+ *
+ * @note Single-threaded per process, like the rest of the event loop
+ */
+class Metrics {
+public:
+  enum Counter {
+    ACCEPTED,         // Connections accepted
+    REJECTED_FULL,    // Refused: worker_connections reached, none idle
+    REJECTED_PER_IP,  // Refused: limit_conn_per_ip reached
+    REJECTED_NO_FD,   // Refused: out of fds (EMFILE / ENFILE)
+    EVICTED_IDLE,     // Idle keep-alive closed to admit a new connection
+    BYTES_IN,         // Bytes read from client sockets
+    BYTES_OUT,        // Bytes written to client sockets
+    CGI_SPAWNS,       // CGI processes started
+    FASTCGI_REQUESTS, // Requests sent with fastcgi_pass
+    PROXY_REQUESTS,   // Requests forwarded with proxy_pass
+    CGI_TIMEOUTS,     // CGI killed by cgi_timeout
+    COUNTER_COUNT
+  };
+
+  enum Histogram {
+    PHASE_PARSE,   // Request bytes through the parser
+    PHASE_ROUTE,   // Virtual host + location matching
+    PHASE_HANDLER, // Rest of RequestHandler (static file, CGI start...)
+    PHASE_FLUSH,   // Response queued → last byte accepted by the socket
+    CGI_DURATION,  // CGI / FastCGI / proxy request start → output complete
+    HISTOGRAM_COUNT
+  };
+
+  /** @brief Finite bucket bounds of every histogram (+Inf comes after) */
+  static const int BUCKET_COUNT = 16;
+
+  /** @brief Endpoint path ("" = no endpoint) */
+  static void configure(const std::string &path);
+  static bool isEndpoint(const std::string &path);
+  /** @brief Server whose gauges are appended to each scrape (NULL = none) */
+  static void setSource(const MetricsSource *source);
+
+  /** @brief Monotonic clock, in nanoseconds */
+  static uint64_t now();
+  static void add(Counter counter, uint64_t amount = 1);
+  static void observe(Histogram histogram, uint64_t nanoseconds);
+  /** @brief One response sent, by status code and location pattern */
+  static void countResponse(int status, const std::string &location);
+  /** @brief One event loop round: time blocked in wait(), time working */
+  static void addLoopTime(uint64_t waitNs, uint64_t busyNs);
+
+  /** @brief Every metric, in Prometheus text format (version 0.0.4) */
+  static void render(std::string &out);
+
+  // Formatting helpers, also for MetricsSource implementations
+  static void appendHelp(std::string &out, const char *name,
+                         const char *type, const char *help);
+  static void appendSample(std::string &out, const char *name,
+                           const char *labels, uint64_t value);
+  static void appendSeconds(std::string &out, const char *name,
+                            const char *labels, uint64_t nanoseconds);
+
+private:
+  Metrics();
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * @brief Phase boundaries of one request, in Metrics::now() nanoseconds
+ *
+ * Timestamps are 0 when the phase was not reached. Durations add up the
+ * runs of phases that happen several times (parsing over several reads,
+ * the handler run again after an I/O task).
+ */
+struct RequestTiming {
+  uint64_t start;   // First byte of the request parsed
+  uint64_t parsed;  // Request complete (header and body)
+  uint64_t handled; // First RequestHandler run (routing starts)
+  uint64_t cgiAt;   // CGI / FastCGI / proxy request started
+  uint64_t queued;  // Response queued
+  uint64_t end;     // Last byte accepted by the socket
+
+  uint64_t parseNs;   // In the parser
+  uint64_t routeNs;   // Virtual host + location matching
+  uint64_t handlerNs; // Rest of RequestHandler (static file, CGI start...)
+  uint64_t ioNs;      // Parked on io_threads tasks (disk)
+  uint64_t cgiNs;     // CGI started → output complete
+
+  RequestTiming();
+};
+
+/**
+ * @brief The request a RequestTiming belongs to, as the logs show it
+ */
+struct TracedRequest {
+  const char *client;          // Dotted address
+  const std::string *method;   // "" when the request never parsed
+  const std::string *path;
+  const std::string *location; // Pattern of the matched location, or NULL
+  int status;
+  int connection; // Client fd: one trace row per connection
+};
+
+/**
+ * @brief Slow request log and sampled request trace (process-wide)
+ *
+ * Connections keep RequestTiming on their exchange at no more cost than
+ * the Metrics phase clocks they already read; record() turns it into an
+ * error log line past slow_request_threshold and into Chrome trace events
+ * (request_trace) for one request in N, and for every slow one.
+ *
+ * @note Single-threaded per process, like the rest of the event loop
+ */
+class RequestTrace {
+public:
+  /**
+   * @brief Sets the slow threshold and the trace sampling
+   * @param slowMs slow_request_threshold in milliseconds, 0 = off
+   * @param every One request in every is traced, 0 = no trace
+   */
+  static void configure(long slowMs, int every);
+  /** @brief Slow log or trace on: timings are worth recording */
+  static bool enabled();
+  /** @brief One response sent: slow log line and / or trace events */
+  static void record(const RequestTiming &timing,
+                     const TracedRequest &request);
+
+private:
+  RequestTrace();
+};
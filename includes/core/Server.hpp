@@ -1,42 +1,147 @@
 #pragma once
 
+#include "cgi/FastCGIPool.hpp"
+#include "config/GlobalConfig.hpp"
 #include "config/ServerConfig.hpp"
+#include "core/ConfigSnapshot.hpp"
+#include "core/IoThreadPool.hpp"
+#include "core/Metrics.hpp"
+#include "core/TimerWheel.hpp"
+#include "http/OpenFileCache.hpp"
+#include "http/Compression.hpp"
+#include "http/DirectoryListingCache.hpp"
+#include "http/MimeTypes.hpp"
+#include "http/RateLimiter.hpp"
+#include "http/ResponseCache.hpp"
+#include "network/BufferPool.hpp"
 #include "network/ClientConnection.hpp"
+#include "network/ConnectionPool.hpp"
 #include "network/PollManager.hpp"
 #include "network/ServerSocket.hpp"
+#include "proxy/UpstreamPool.hpp"
+#include <ctime>
 #include <map>
 #include <string>
+#include <sys/types.h>
 #include <vector>
 
+/** @brief What a registered fd refers to in the dispatch table */
+enum FdType {
+  FD_FREE,     // Slot unused
+  FD_LISTENER, // Listening server socket
+  FD_CLIENT,   // Client connection socket
+  FD_CGI_PIPE, // CGI stdout pipe or FastCGI socket (client = owner)
+  FD_CGI_STDIN, // CGI stdin pipe while the request body is fed
+  FD_IO_DONE    // IoThreadPool notify fd: finished file I/O tasks
+};
+
+/** @brief Dispatch table entry, indexed directly by fd number */
+struct FdSlot {
+  FdType type;
+  ClientConnection *client;
+  bool pendingClose; // Already queued in _pendingClose (client slots only)
+  bool idle;         // Linked in the idle keep-alive list
+  int idlePrev;      // Previous idle client fd, -1 = head
+  int idleNext;      // Next idle client fd, -1 = tail
+};
+
 /**
  * @brief Main server class - event loop and connection management
  */
-class Server {
+class Server : public MetricsSource {
 private:
-  std::vector<ServerConfig> _servConfigsList;
+  static const int ACCEPT_BATCH = 64; // Connections accepted per loop round
+
+  ConfigSnapshot *_config; // Current configuration (one reference held)
+  std::string _configPath;  // Re-read on SIGHUP ("" = reload disabled)
+  std::vector<std::string> _commandLine; // Exec'd on SIGUSR2 (binary upgrade)
+  pid_t _upgradePid;        // New binary started by SIGUSR2, 0 = none
+  time_t _drainDeadline;    // Draining: connections still open are closed then
+  GlobalConfig _globalConfig;
   std::vector<ServerSocket *> _serverSockets;
   PollManager _pollManager;
+  MimeTypes _mimeTypes;     // Extension → Content-Type (types {} / built-in)
+  OpenFileCache _fileCache; // Shared by every connection of this process
+  ResponseCache _responseCache;
+  DirectoryListingCache _listingCache; // Autoindex names + rendered pages
+  Compression _compression;            // gzip / brotli policy (http block)
+  BufferPool _bufferPool; // Receive blocks of every connection
+  FastCGIPool _fastcgiPool; // Idle fastcgi_pass connections
+  UpstreamPool _upstreamPool; // Idle proxy_pass connections, balancing
+  CGICache _cgiCache;         // cgi_cache responses and fill locks
+  RateLimiter _rateLimiter;   // limit_req zones (this process's buckets)
+  IoThreadPool _ioPool;     // Blocking file I/O (io_threads)
+  ConnectionPool _connectionPool; // Connection storage, request state
+  ConnectionServices _services;   // The above, as connections see them
+  std::vector<IoTask *> _ioDone; // Reused by handleIoCompletions()
+  std::vector<ClientConnection *> _cacheWoken; // Reused, see below
+
+  std::map<int, int> _portByServerFd; // Listener fd → port
+
+  std::vector<FdSlot> _slots;                   // fd → type + connection
+  std::vector<ClientConnection *> _pendingClose; // Closed since last cleanup
+  size_t _clientCount;
 
-  typedef std::vector<ServerConfig> ConfigVector;
-  std::map<int, ConfigVector> _configsByServerFd;
-  std::map<int, ClientConnection *> _clientsByFd;
-  std::map<int, ClientConnection *> _cgiPipeToClient;
+  size_t _maxClients;   // worker_connections, bounded by RLIMIT_NOFILE
+  int _spareFd;         // Reserved fd, given up to refuse on EMFILE
+  int _idleHead;        // Least recently active idle keep-alive client
+  int _idleTail;        // Most recently active one
+  std::map<uint32_t, int> _clientsByAddr; // limit_conn_per_ip counts
+
+  TimerWheel _timers;         // Client fd → deadline of its current phase
+  std::vector<int> _expired;  // Reused by expireTimers()
+
+  void setSlot(int fd, FdType type, ClientConnection *client);
+  void clearSlot(int fd);
+  FdType slotType(int fd) const;
+  void scheduleClose(ClientConnection *client);
+  void linkIdle(int fd);
+  void unlinkIdle(int fd);
+  bool evictIdleClient();
+  void rejectClient(int clientFd, Metrics::Counter reason, bool tls);
+  void reserveConnectionFds();
 
   void acceptNewClient(int serverFd);
-  void handleClientData(ClientConnection *client, size_t pollIndex);
-  void handleClientWrite(ClientConnection *client, size_t pollIndex);
+  void handleClientData(ClientConnection *client);
+  void processBufferedRequests(ClientConnection *client);
+  void handleClientWrite(ClientConnection *client);
   void handleCGIPipe(int pipeFd, ClientConnection *client);
-  void checkClientTimeout(ClientConnection *client, int fd, time_t now);
+  void handleCGIWrite(int cgiFd, ClientConnection *client);
+  void handleCGIStdin(int stdinFd, ClientConnection *client);
+  void watchCGI(ClientConnection *client);
+  void unwatchCGIStdin(ClientConnection *client);
+  void handleIoCompletions();
+  void resumeCacheWaiters();
+  void armTimer(ClientConnection *client);
+  void expireTimers(time_t now);
+  int waitTimeout() const;
   void cleanupClosedClients();
-  std::map<int, ConfigVector> groupConfigsByPort();
+
+  bool openListener(int port, const ListenerConfig &listener);
+  void closeListener(size_t index);
+  bool reload();
+  void beginDrain();
+  void closeIdleClients();
+  void upgradeBinary();
+  void reapUpgrade();
 
 public:
-  Server(const std::vector<ServerConfig> &configs);
+  Server(const std::vector<ServerConfig> &configs,
+         const GlobalConfig &globalConfig = GlobalConfig());
   ~Server();
 
   /** @brief Initialize listening sockets for all configured ports */
   bool init();
 
-  /** @brief Run main poll() event loop until shutdown */
+  /** @brief Configuration file re-read when SIGHUP is received */
+  void setConfigPath(const std::string &path);
+
+  /** @brief Command line of the binary started on SIGUSR2 */
+  void setCommandLine(int argc, char **argv);
+
+  /** @brief Run main readiness event loop until shutdown (then drain) */
   void run();
+
+  /** @brief Connection gauges and cache counters, for a metrics scrape */
+  void appendMetrics(std::string &out) const;
 };
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <ctime>
+#include <vector>
+
+/**
+ * @brief Hashed timer wheel of per-fd deadlines, one-second resolution
+ *
+ * Each fd has at most one timer. Scheduling, rescheduling and cancelling
+ * are O(1); expiring only visits the buckets of the seconds that passed.
+ */
+class TimerWheel {
+private:
+  struct Entry {
+    time_t deadline;
+    size_t bucket;
+    int prev; // fd, -1 = bucket head
+    int next; // fd, -1 = last
+    bool armed;
+  };
+
+  /** @brief Buckets of the wheel (power of two) */
+  static const size_t WHEEL_SIZE = 64;
+
+  std::vector<Entry> _entries; // fd → timer
+  std::vector<int> _buckets;   // deadline % WHEEL_SIZE → first fd
+  time_t _cursor;              // Last second expired
+  size_t _armed;
+
+  size_t bucketOf(time_t deadline) const;
+  void unlink(int fd);
+
+public:
+  TimerWheel();
+  ~TimerWheel();
+
+  /** @brief Arms or moves the timer of fd */
+  void schedule(int fd, time_t deadline);
+  /** @brief Disarms the timer of fd (no-op if none) */
+  void cancel(int fd);
+
+  /** @brief Earliest second a timer can fire, 0 if none is armed */
+  time_t nextExpiry() const;
+  /** @brief Disarms every timer due at now and appends its fd */
+  void expire(time_t now, std::vector<int> &expired);
+
+  size_t size() const;
+};
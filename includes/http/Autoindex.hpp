@@ -1,13 +1,36 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 /**
- * @brief Autoindex utilities - generates directory listings as HTML
+ * @brief Autoindex utilities - generates directory listings as HTML or JSON
  */
 namespace Autoindex {
 
-/** @brief Generate HTML listing for a directory */
+const size_t DEFAULT_LIMIT = 1000; // Entries per page without ?limit=
+const size_t MAX_LIMIT = 5000;     // Largest ?limit= honored
+
+/** @brief Page of a listing selected by ?page=&limit=&format= */
+struct Options {
+  size_t page;  // 1-based
+  size_t limit; // Entries per page
+  bool json;    // format=json
+};
+
+/** @brief Parse page/limit/format from a query string (defaults if absent) */
+void parseOptions(const std::string &query, Options &options);
+
+/** @brief Read the entry names of a directory, sorted (false: see errno) */
+bool scanDirectory(const std::string &dirPath,
+                   std::vector<std::string> &names);
+
+/** @brief Render one page of scanned names (stat() only for that page) */
+std::string renderPage(const std::string &dirPath, const std::string &urlPath,
+                       const std::vector<std::string> &names,
+                       const Options &options);
+
+/** @brief Generate HTML listing (first page) for a directory */
 std::string generateListing(const std::string &dirPath,
                             const std::string &urlPath);
 
@@ -17,4 +40,4 @@ std::string escapeHtml(const std::string &input);
 /** @brief URL-encode a string for use in href attributes */
 std::string urlEncode(const std::string &input);
 
-} // namespace Autoindex
\ No newline at end of file
+} // namespace Autoindex
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "http/FileHandle.hpp"
+#include "http/MappedFile.hpp"
+#include <string>
+#include <sys/types.h>
+
+/**
+ * @brief One piece of a response body: in-memory bytes or a file range
+ *
+ * Bodies made of several pieces (multipart/byteranges) are sent segment by
+ * segment after the header block, so file ranges still go out through
+ * sendfile() and are never read into memory. A file range whose file is
+ * mapped (open_file_cache_mmap) can also be sent from the mapping.
+ */
+struct BodySegment {
+  std::string data; // In-memory bytes (used when file is invalid)
+  FileHandle file;  // File-backed range [offset, offset + length)
+  MappedFile map;   // Whole file mapped, if the open file cache has it
+  off_t offset;
+  off_t length; // Bytes of this segment (data.size() for memory segments)
+
+  BodySegment() : offset(0), length(0) {}
+  bool isFile() const { return file.isValid(); }
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Vectorized byte searches used by the HTTP and CGI parsers
+ *
+ * The kernel (AVX2, SSE2, NEON or portable scalar) is chosen once at
+ * runtime from what the CPU supports; every call then goes through the
+ * selected functions. Results are identical whatever the backend.
+ */
+class ByteScanner {
+private:
+  ByteScanner();
+
+public:
+  /** @brief Returned when nothing was found */
+  static const size_t npos = static_cast<size_t>(-1);
+  /** @brief Largest byte set accepted by findAny() */
+  static const size_t MAX_SET = 4;
+
+  /** @brief Offset of the first byte of data that is in set, or npos */
+  static size_t findAny(const char *data, size_t length, const char *set,
+                        size_t setLength);
+  /** @brief Offset of the first "\r\n\r\n" in data, or npos */
+  static size_t findHeaderEnd(const char *data, size_t length);
+
+  /** @brief Active kernel: "avx2", "sse2", "neon" or "scalar" */
+  static const char *backendName();
+  /** @brief Forces a kernel (benchmarks); false if unsupported here */
+  static bool setBackend(const std::string &name);
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+#ifdef WEBSERV_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+class GlobalConfig;
+class HttpRequest;
+
+/**
+ * @brief Content-coding policy: which responses are compressed, and how
+ */
+class Compression {
+public:
+  enum Encoding { IDENTITY, GZIP, BROTLI };
+
+  /** @brief Largest file compressed on the fly (bigger: gzip_static only) */
+  static const off_t ON_THE_FLY_MAX = 1024 * 1024;
+
+private:
+  bool _gzip;
+  bool _brotli;
+  bool _static; // gzip_static: serve foo.css.gz / foo.css.br if present
+  int _level;   // gzip_comp_level, 1-9 (brotli quality is derived from it)
+  off_t _minLength;
+  std::vector<std::string> _types; // gzip_types, lowercase ("*" = any)
+
+public:
+  Compression();
+
+  /** @brief Takes the gzip* / brotli directives (unsupported codings off) */
+  void configure(const GlobalConfig &config);
+  bool isEnabled() const;
+  bool useStatic() const;
+
+  /** @brief Whether a body of this type and size may be compressed */
+  bool isCompressible(const std::string &contentType, off_t size) const;
+  /** @brief Preferred enabled coding the client accepts (IDENTITY if none) */
+  Encoding negotiate(const HttpRequest &request, bool allowBrotli) const;
+  /** @brief Whether a file of this size is compressed into the cache */
+  bool canCompress(Encoding encoding, off_t size) const;
+  /** @brief Compresses a whole body (false: coding unavailable) */
+  bool compress(Encoding encoding, const std::string &input,
+                std::string &output) const;
+  int getLevel() const;
+
+  /** @brief Content-Encoding token ("gzip", "br") */
+  static const char *token(Encoding encoding);
+  /** @brief Precompressed file suffix (".gz", ".br") */
+  static const char *suffix(Encoding encoding);
+  /** @brief Whether this build links zlib / libbrotlienc */
+  static bool isAvailable(Encoding encoding);
+};
+
+/**
+ * @brief Incremental gzip encoder for bodies produced piece by piece
+ */
+class GzipStream {
+private:
+#ifdef WEBSERV_HAVE_ZLIB
+  z_stream _stream;
+#endif
+  bool _active;
+
+  GzipStream(const GzipStream &);
+  GzipStream &operator=(const GzipStream &);
+
+  bool deflateInto(const std::string &input, int flush, std::string &output);
+
+public:
+  GzipStream();
+  ~GzipStream();
+
+  /** @brief Starts a new gzip member (false: zlib unavailable or failed) */
+  bool begin(int level);
+  bool isActive() const;
+  /** @brief Compresses input and flushes it, so the client can decode it */
+  bool update(const std::string &input, std::string &output);
+  /** @brief Emits the trailer and releases the encoder */
+  bool finish(std::string &output);
+  /** @brief Drops an unfinished stream */
+  void end();
+};
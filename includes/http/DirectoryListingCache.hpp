@@ -0,0 +1,73 @@
+#pragma once
+
+#include "http/Autoindex.hpp"
+#include <ctime>
+#include <map>
+#include <string>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * @brief Scanned names and rendered pages of one directory version
+ */
+struct DirectoryListing {
+  dev_t dev; // Directory version the names were read from
+  ino_t ino;
+  time_t mtime;
+  bool settled; // mtime was in the past at scan time (no same-second race)
+  std::vector<std::string> names;
+  std::map<std::string, std::pair<time_t, std::string> > pages; // key → body
+  time_t lastUsed;
+};
+
+/**
+ * @brief Per-process cache of autoindex listings, keyed by directory path
+ */
+class DirectoryListingCache {
+private:
+  typedef std::map<std::string, DirectoryListing> ListingMap;
+
+  ListingMap _listings;
+  unsigned long _hits;   // Pages served without stat() or readdir()
+  unsigned long _misses; // Pages rendered (after a scan or not)
+  unsigned long _scans;  // readdir() passes
+
+  DirectoryListingCache(const DirectoryListingCache &);
+  DirectoryListingCache &operator=(const DirectoryListingCache &);
+
+  void evictOldest();
+  ListingMap::iterator store(const std::string &dirPath,
+                            const struct stat &dirStat,
+                            std::vector<std::string> &names, time_t now);
+  static bool isCurrent(const DirectoryListing &listing,
+                        const struct stat &dirStat, bool allowUnsettled);
+  static std::string pageKey(const std::string &urlPath,
+                             const Autoindex::Options &options);
+
+public:
+  static const size_t MAX_DIRECTORIES = 32; // Listings kept
+  static const size_t MAX_PAGES = 16;       // Rendered pages per listing
+  static const time_t PAGE_VALID = 10; // Seconds a page's sizes/dates live
+
+  DirectoryListingCache();
+  ~DirectoryListingCache();
+
+  /** @brief Rendered page of a directory (NULL: unreadable, see errno) */
+  const std::string *getPage(const std::string &dirPath,
+                             const struct stat &dirStat,
+                             const std::string &urlPath,
+                             const Autoindex::Options &options,
+                             bool justScanned = false);
+  /** @brief Whether getPage() would readdir() (names missing or stale) */
+  bool needsScan(const std::string &dirPath, const struct stat &dirStat) const;
+  /** @brief Stores names + page scanned and rendered elsewhere */
+  void install(const std::string &dirPath, const struct stat &dirStat,
+               std::vector<std::string> &names, const std::string &urlPath,
+               const Autoindex::Options &options, const std::string &page);
+
+  size_t size() const;
+  unsigned long getHits() const;
+  unsigned long getMisses() const;
+  unsigned long getScans() const;
+};
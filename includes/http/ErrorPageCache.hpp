@@ -0,0 +1,41 @@
+#pragma once
+
+#include "config/ServerConfig.hpp"
+#include "http/HttpResponse.hpp"
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief error_page files of every server/location, rendered at load time
+ */
+class ErrorPageCache {
+private:
+  typedef std::map<int, PrebuiltPage> CodeMap;
+  typedef std::map<std::string, CodeMap> PathMap; // Resolved file → pages
+
+  PathMap _pages;
+  size_t _count;
+
+  ErrorPageCache(const ErrorPageCache &);
+  ErrorPageCache &operator=(const ErrorPageCache &);
+
+  void load(const std::map<int, std::string> &errorPages,
+            const std::string &root);
+
+public:
+  ErrorPageCache();
+  ~ErrorPageCache();
+
+  /** @brief Drops every page and reads those of servers (and locations) */
+  void build(const std::vector<ServerConfig> &servers);
+
+  /** @brief Page of a resolved error_page file for code, NULL if none */
+  const PrebuiltPage *find(const std::string &path, int code) const;
+
+  size_t size() const;
+
+  /** @brief root + error_page path, as the request handler resolves it */
+  static void resolvePath(std::string &out, const std::string &root,
+                          const std::string &page);
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+/**
+ * @brief Reference-counted owner of an open file descriptor
+ *
+ * Copies share the same fd; it is closed when the last copy goes away, so
+ * responses can be copied around freely while a body is being streamed.
+ */
+class FileHandle {
+private:
+  int _fd;
+  int *_refCount;
+
+  void release();
+
+public:
+  FileHandle();
+  explicit FileHandle(int fd);
+  FileHandle(const FileHandle &other);
+  FileHandle &operator=(const FileHandle &other);
+  ~FileHandle();
+
+  int getFd() const;
+  bool isValid() const;
+  void reset();
+};
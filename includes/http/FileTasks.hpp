@@ -0,0 +1,109 @@
+#pragma once
+
+#include "core/IoThreadPool.hpp"
+#include "http/Autoindex.hpp"
+#include "http/DirectoryListingCache.hpp"
+#include "http/OpenFileCache.hpp"
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+/**
+ * @brief Result of a task that changes the filesystem, read back by the
+ *        handler when the request runs again
+ */
+struct IoOutcome {
+  bool ready;
+  std::string path; // Path the task worked on
+  int value;        // Task-specific: errno, or HTTP status
+};
+
+/**
+ * @brief stat() + open() (+ small file read) of a path not cached yet
+ *
+ * On an I/O thread, or as statx / openat / read steps on the pool's
+ * io_uring.
+ */
+class FileLookupTask : public IoTask {
+private:
+  OpenFileCache &_cache;
+  std::string _path;
+  bool _keepContent;
+  size_t _mapMax;
+  OpenFileEntry _entry;
+#ifdef STATX_BASIC_STATS
+  enum Step { START, STAT, OPEN, READ, DONE };
+  Step _step; // In flight (or to issue, for START)
+  struct statx _statx;
+  std::string _content; // Small file being read
+  size_t _read;
+#endif
+
+public:
+  FileLookupTask(OpenFileCache &cache, const std::string &path);
+  void run();
+  void complete();
+#ifdef STATX_BASIC_STATS
+  bool nextStep(IoStep &step);
+  void stepDone(int result);
+#endif
+};
+
+/**
+ * @brief readdir() + first render of an autoindex page
+ */
+class DirectoryScanTask : public IoTask {
+private:
+  DirectoryListingCache &_listings;
+  IoOutcome &_outcome;
+  std::string _dirPath;
+  struct stat _dirStat;
+  std::string _urlPath;
+  Autoindex::Options _options;
+  std::vector<std::string> _names;
+  std::string _page;
+  int _error; // errno of a failed scan, 0 on success
+
+public:
+  DirectoryScanTask(DirectoryListingCache &listings, IoOutcome &outcome,
+                    const std::string &dirPath, const struct stat &dirStat,
+                    const std::string &urlPath,
+                    const Autoindex::Options &options);
+  void run();
+  void complete();
+};
+
+/**
+ * @brief fsync() of a streamed upload before it is committed
+ */
+class FileSyncTask : public IoTask {
+private:
+  IoOutcome &_outcome;
+  std::string _path;
+  int _fd; // Duplicate owned by the task: the upload may be dropped meanwhile
+  int _error;
+
+public:
+  FileSyncTask(IoOutcome &outcome, const std::string &path, int fd);
+  ~FileSyncTask();
+  void run();
+  void complete();
+};
+
+/**
+ * @brief Checks and unlink() of a DELETE target
+ */
+class FileDeleteTask : public IoTask {
+private:
+  IoOutcome &_outcome;
+  std::string _path;
+  int _status;
+
+public:
+  FileDeleteTask(IoOutcome &outcome, const std::string &path);
+  void run();
+  void complete();
+
+  /** @brief Removes a regular file; HTTP status (204 on success) */
+  static int removeFile(const std::string &path);
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <deque>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/** @brief One header field of an HTTP/2 header block */
+struct HeaderPair {
+  std::string name;
+  std::string value;
+};
+
+/**
+ * @brief HPACK (RFC 7541) decoder: one per connection, client to server
+ *
+ * Keeps the dynamic table the client's encoder builds across header
+ * blocks, so every block of a connection goes through the same decoder,
+ * in order.
+ */
+class HpackDecoder {
+public:
+  /** @brief SETTINGS_HEADER_TABLE_SIZE we announce (the RFC default) */
+  static const size_t TABLE_SIZE = 4096;
+
+  enum Result {
+    DECODED,
+    MALFORMED, // Connection COMPRESSION_ERROR
+    TOO_LARGE  // Decoded list over the limit: decoding stopped midway
+  };
+
+  HpackDecoder();
+
+  /**
+   * @brief Decodes one complete header block (fragments joined)
+   * @param maxListSize Limit of the decoded list (RFC size: name + value
+   *        + 32 per field); indexed references cannot expand past it
+   */
+  Result decode(const unsigned char *data, size_t length,
+                std::vector<HeaderPair> &fields, size_t maxListSize);
+
+private:
+  std::deque<HeaderPair> _table; // Dynamic table, newest first
+  size_t _tableSize;             // RFC size: 32 + name + value per entry
+  size_t _maxSize;               // Current limit (size updates lower it)
+
+  bool lookup(size_t index, HeaderPair &field) const;
+  void insert(const HeaderPair &field);
+  void evict();
+};
+
+/**
+ * @brief HPACK encoder of response header blocks
+ *
+ * Stateless: names are taken from the static table when it has them, and
+ * every field is sent as a literal never added to the dynamic table (no
+ * Huffman coding), so the peer's table size settings never matter.
+ */
+class HpackEncoder {
+public:
+  /** @brief Appends ":status" (fully indexed for the common codes) */
+  static void encodeStatus(std::string &out, int status);
+  /** @brief Appends one field; name must be lowercase */
+  static void encode(std::string &out, const std::string &name,
+                     const std::string &value);
+  /** @brief Appends a dynamic table size update (first in a block) */
+  static void encodeTableSize(std::string &out, size_t size);
+
+  /** @brief Integer representation with an N-bit prefix (RFC 7541 5.1) */
+  static void encodeInteger(std::string &out, uint32_t value, int prefixBits,
+                            unsigned char flags);
+};
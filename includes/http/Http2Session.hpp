@@ -0,0 +1,153 @@
+#pragma once
+
+#include "config/ServerConfig.hpp"
+#include "http/BodySegment.hpp"
+#include "http/Hpack.hpp"
+#include "http/HttpRequest.hpp"
+#include "http/HttpResponse.hpp"
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class RequestHandler;
+
+/** @brief One HTTP/2 stream: the request as it arrives, then its response */
+struct Http2Stream {
+  std::string headerBlock; // HPACK fragments until END_HEADERS
+  std::string head;        // Request rebuilt as an HTTP/1.1 header block
+  std::string body;        // Request body received so far
+  bool remoteClosed;       // END_STREAM received: the request is complete
+  bool responding;         // Response queued (HEADERS already sent)
+  size_t bodyLimit;        // client_max_body_size of its location
+  long declaredLength;     // content-length sent by the client (-1 = none)
+  int64_t recvWindow;      // Flow control, our side
+  int64_t sendWindow;      // Flow control, the client's side
+  int weight;              // PRIORITY, 1-256
+  uint32_t dependency;     // Stream this one depends on (0 = root)
+
+  std::string data; // In-memory response body
+  size_t dataOffset;
+  std::vector<BodySegment> segments; // Response body after data
+  size_t segmentIndex;
+  off_t segmentSent;
+
+  Http2Stream();
+  /** @brief Whether DATA frames remain to be sent */
+  bool hasData() const;
+};
+
+/**
+ * @brief HTTP/2 connection state (RFC 9113): frames, streams, flow control
+ *
+ * The connection feeds received bytes to receive() and sends what
+ * produce() appends. Complete requests run through the connection's
+ * RequestHandler as soon as their last frame arrives; responses are
+ * framed as HEADERS + DATA, the DATA as the flow-control windows allow.
+ */
+class Http2Session {
+public:
+  /** @brief Client connection preface, "PRI * HTTP/2.0..." */
+  static const char PREFACE[];
+  static const size_t PREFACE_LENGTH = 24;
+  /** @brief Streams a client may have open at once (advertised) */
+  static const uint32_t MAX_STREAMS = 128;
+  /** @brief Largest frame payload accepted and sent */
+  static const uint32_t MAX_FRAME = 16384;
+  /** @brief Largest header block (all fragments) accepted */
+  static const size_t MAX_HEADER_BLOCK = 64 * 1024;
+  /** @brief Largest decoded header list (SETTINGS_MAX_HEADER_LIST_SIZE) */
+  static const uint32_t MAX_HEADER_LIST = 64 * 1024;
+
+  Http2Session(RequestHandler &handler,
+               const std::vector<ServerConfig> &servers,
+               const std::string &clientIp);
+  ~Http2Session();
+
+  /** @brief Whether data could be (the start of) the client preface */
+  static bool matchesPreface(const char *data, size_t length);
+  /** @brief Whether an HTTP/1.1 request asks for "Upgrade: h2c" */
+  static bool isUpgrade(const HttpRequest &request);
+
+  /** @brief Takes over an upgraded request as stream 1 (after the 101) */
+  void upgrade(const HttpRequest &request);
+  /** @brief Processes received bytes; false once the connection failed */
+  bool receive(const char *data, size_t length);
+  /** @brief Appends frames to out until it holds about limit bytes */
+  void produce(std::string &out, size_t limit);
+  /** @brief Whether produce() has something to append */
+  bool wantsWrite() const;
+  /** @brief No stream open (the connection is idle) */
+  bool isIdle() const;
+  /** @brief GOAWAY exchanged and nothing left to send: close */
+  bool isFinished() const;
+
+private:
+  RequestHandler &_handler;
+  const std::vector<ServerConfig> &_servers;
+  std::string _clientIp;
+
+  std::string _in;      // Received bytes of an incomplete frame
+  bool _prefaceSeen;    // Client preface (24 bytes) consumed
+  bool _settingsSeen;   // First client frame was SETTINGS
+  uint32_t _continuing; // Stream whose header block is incomplete (0 = none)
+  bool _continuingEnd;  // Its HEADERS frame carried END_STREAM
+  uint32_t _lastStream; // Highest stream id opened by the client
+  bool _goingAway;      // GOAWAY sent or received: no new streams
+  bool _failed;         // Connection error: stop reading
+
+  std::map<uint32_t, Http2Stream *> _streams;
+  HpackDecoder _decoder;
+  bool _tableSizeUpdate; // Next header block starts with a size update
+
+  std::string _control; // Frames sent before any DATA (HEADERS included)
+  int64_t _sendWindow;  // Connection flow control, client side
+  int64_t _recvWindow;  // Connection flow control, our side
+  int64_t _initialWindow; // SETTINGS_INITIAL_WINDOW_SIZE of the client
+  uint32_t _peerMaxFrame; // SETTINGS_MAX_FRAME_SIZE of the client
+
+  HttpRequest _request;   // Reused by every stream
+  HttpResponse _response; // Reused by every stream
+
+  bool processFrame(uint8_t type, uint8_t flags, uint32_t streamId,
+                    const unsigned char *payload, uint32_t length);
+  bool onHeaders(uint8_t flags, uint32_t streamId,
+                 const unsigned char *payload, uint32_t length);
+  bool onContinuation(uint8_t flags, uint32_t streamId,
+                      const unsigned char *payload, uint32_t length);
+  bool onData(uint8_t flags, uint32_t streamId, const unsigned char *payload,
+              uint32_t length);
+  bool onSettings(uint8_t flags, uint32_t streamId,
+                  const unsigned char *payload, uint32_t length);
+  bool onWindowUpdate(uint32_t streamId, const unsigned char *payload,
+                      uint32_t length);
+  bool onPriority(uint32_t streamId, const unsigned char *payload,
+                  uint32_t length);
+  bool headerBlockDone(uint32_t streamId, bool endStream);
+  bool buildRequestHead(Http2Stream &stream,
+                        const std::vector<HeaderPair> &fields);
+
+  void execute(uint32_t streamId);
+  void dispatch(uint32_t streamId, Http2Stream &stream,
+                const HttpRequest &request);
+  void respond(uint32_t streamId, Http2Stream &stream,
+               const HttpRequest &request);
+  void sendHeaders(uint32_t streamId, const std::string &block,
+                   bool endStream);
+  bool sendData(std::string &out, uint32_t streamId, Http2Stream &stream,
+                bool &finished);
+  void finishStream(uint32_t streamId, Http2Stream &stream);
+  bool isReady(const Http2Stream &stream) const;
+  void closeStream(uint32_t streamId);
+  void resetStream(uint32_t streamId, uint32_t error);
+  bool fail(uint32_t error, const char *reason);
+  void logAccess(const HttpRequest &request, int status, off_t bytes) const;
+
+  static void appendFrame(std::string &out, uint8_t type, uint8_t flags,
+                          uint32_t streamId, const char *payload,
+                          size_t length);
+  uint32_t applySettings(const unsigned char *payload, uint32_t length);
+
+  Http2Session(const Http2Session &);
+  Http2Session &operator=(const Http2Session &);
+};
@@ -1,7 +1,20 @@
 #pragma once
 
+#include <ctime>
 #include <map>
 #include <string>
+#include <sys/types.h>
+#include <vector>
+
+class UploadSink;
+
+/**
+ * @brief One satisfiable byte range, both ends inclusive
+ */
+struct ByteRange {
+  off_t first;
+  off_t last;
+};
 
 /**
  * @brief HTTP request parser - extracts method, path, headers, and body
@@ -10,17 +23,26 @@ class HttpRequest {
 public:
   HttpRequest();
 
-  /** @brief Parse raw request data, returns true if request is complete */
-  bool parse(const std::string &rawRequest);
+  /** @brief Feed newly received bytes; true once the request is complete */
+  bool parse(const char *data, size_t length);
 
   // Getters
   const std::string &getMethod() const;
   const std::string &getPath() const;
   const std::string &getQuery() const;
   const std::string &getVersion() const;
+  /** @brief Request target as received (not decoded), in place */
+  const char *getTarget(size_t &length) const;
   const std::string &getBody() const;
+  size_t getBodySize() const;
   const std::map<std::string, std::string> &getHeaders() const;
   std::string getOneHeader(const std::string &key) const;
+  /** @brief Header value in place (no copy), NULL if absent */
+  const char *getHeaderValue(const char *key, size_t &length) const;
+  /** @brief Header fields in arrival order, in place (no copy) */
+  size_t getHeaderCount() const;
+  void getHeaderField(size_t index, const char *&name, size_t &nameLength,
+                      const char *&value, size_t &valueLength) const;
   int getParsedBytes() const;
   const std::map<std::string, std::string> &getCookies() const;
 
@@ -30,28 +52,101 @@ public:
   bool isMalformed() const;
   int getContentLength() const;
 
+  /** @brief Send body bytes to sink instead of getBody() (NULL = memory) */
+  void setUploadSink(UploadSink *sink);
+  UploadSink *getUploadSink() const;
+
+  /** @brief Give up on the rest of the body (413): complete, no keep-alive */
+  void stopReadingBody();
+  /** @brief stopReadingBody(), answered with status (507: no space for
+   *  the upload) */
+  void rejectBody(int status);
+  /** @brief Status given to rejectBody(), 0 if none */
+  int getRejectStatus() const;
+  /** @brief Close the connection after this response (server draining) */
+  void disableKeepAlive();
+
   /** @brief Reset state for reuse (keep-alive pipelining) */
   void reset();
 
+  /** @brief Parse an IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT") */
+  static time_t parseHttpDate(const std::string &value);
+
+  /** @brief Outcome of parseRange() */
+  enum RangeResult {
+    RANGE_NONE,         // No usable Range header: send the full entity
+    RANGE_SATISFIABLE,  // ranges holds at least one range
+    RANGE_UNSATISFIABLE // Valid header, nothing overlaps: 416
+  };
+  /** @brief Most ranges accepted in one request before ignoring the header */
+  static const size_t MAX_RANGES = 16;
+
+  /** @brief Resolve the Range header against an entity of entitySize bytes */
+  RangeResult parseRange(off_t entitySize,
+                         std::vector<ByteRange> &ranges) const;
+
+  /** @brief Header fields kept per request; more is answered with 400 */
+  static const size_t MAX_HEADERS = 64;
+
 private:
+  /** @brief One header field as offsets into _headerBuffer (no copies) */
+  struct HeaderSlice {
+    size_t name;
+    size_t nameLength;
+    size_t value;
+    size_t valueLength;
+  };
+
+  /** @brief Position of the chunked decoder between parse() calls */
+  enum ChunkState {
+    CHUNK_SIZE,      // Reading "<hex>[;ext]\r\n"
+    CHUNK_DATA,      // Copying _chunkRemaining data bytes
+    CHUNK_DATA_CRLF, // Expecting the CRLF after the data
+    CHUNK_TRAILER,   // After the 0 chunk: trailer lines until an empty one
+    CHUNK_DONE
+  };
+
   bool _headersComplete;
   bool _isChunked;
   bool _keepAlive;
   bool _isMalformed;
-  int _parsedBytes;
+  bool _complete;
+  int _parsedBytes; // Bytes consumed by the last parse() call
+
+  std::string _headerBuffer; // Header bytes; slices point into it
+  HeaderSlice _slices[MAX_HEADERS];
+  size_t _headerCount;
+  size_t _targetStart; // Request target in _headerBuffer (raw, with query)
+  size_t _targetLength;
+  ChunkState _chunkState;
+  std::string _chunkLine; // Partial size/trailer line
+  size_t _chunkRemaining; // Data bytes left in the current chunk
 
   std::string _method;
   std::string _path;
   std::string _query;
   std::string _version;
-  std::map<std::string, std::string> _headers;
-  std::map<std::string, std::string> _cookies;
+  // Built on first getHeaders()/getCookies() call only
+  mutable std::map<std::string, std::string> _headers;
+  mutable std::map<std::string, std::string> _cookies;
+  mutable bool _headersBuilt;
+  mutable bool _cookiesBuilt;
   std::string _body;
+  size_t _bodySize;        // Body bytes received (in _body or the sink)
+  UploadSink *_uploadSink; // Not owned
   int _contentLength;
+  int _rejectStatus; // Body refused before it was read (rejectBody())
 
-  bool parseHeaders(const std::string &rawRequest);
-  bool parseBody(const std::string &rawRequest);
-  bool parseChunkedBody(const std::string &chunkedData);
-  void _parseCookies();
-  std::string _urlDecode(const std::string &encoded, bool plusAsSpace) const;
+  size_t consumeHeaders(const char *data, size_t length);
+  void parseHeaders();
+  bool parseRequestLine(size_t end);
+  void applyHeader(const HeaderSlice &slice);
+  const HeaderSlice *findHeader(const char *name, size_t length) const;
+  void appendBody(const char *data, size_t length);
+  size_t consumeBody(const char *data, size_t length);
+  size_t consumeChunked(const char *data, size_t length);
+  bool parseChunkSize(const std::string &line);
+  void _parseCookies() const;
+  void _urlDecode(const char *encoded, size_t length, bool plusAsSpace,
+                  std::string &decoded) const;
 };
\ No newline at end of file
@@ -1,40 +1,121 @@
 #pragma once
 
-#include <map>
+#include "http/BodySegment.hpp"
+#include "http/FileHandle.hpp"
+#include <sys/types.h>
 #include <string>
 #include <vector>
 
+/**
+ * @brief Response rendered once and replayed (error pages)
+ */
+struct PrebuiltPage {
+  int code;            // Status the header block was built for
+  std::string message; // Its reason phrase
+  std::string head;    // Status line + headers, without Date/Connection/CRLF
+  std::string body;
+
+  PrebuiltPage() : code(0) {}
+};
+
 /**
  * @brief HTTP response builder - assembles status line, headers, and body
  */
 class HttpResponse {
 private:
+  struct HeaderField {
+    std::string name;
+    std::string value;
+  };
+
   int _statusCode;
   std::string _statusMessage;
   std::string _httpVersion;
-  std::map<std::string, std::string> _headers;
+  std::vector<HeaderField> _headers; // Sorted by name, see _headerCount
+  size_t _headerCount;               // Live fields; the rest are spare slots
   std::vector<std::string> _setCookies;
   std::string _body;
+  const char *_bodyView; // Caller-owned body used instead of _body, or NULL
+  size_t _bodyViewLength;
+  std::vector<BodySegment> _segments; // Streamed after _body, never loaded
   bool _cgiPending;
+  std::string _prebuiltHead; // Cached header block (see usePrebuilt())
+
+  void materialize();
+  void updateSegmentedLength();
+  void setLengthHeader(off_t length);
+  std::string &headerValue(const std::string &key);
+  const HeaderField *findHeader(const std::string &key) const;
+  void appendPreamble(std::string &out) const;
 
 public:
+  /** @brief Larger bodies / header blocks are freed by reset() */
+  static const size_t KEEP_CAPACITY = 16 * 1024;
+
   HttpResponse();
   ~HttpResponse();
 
+  /** @brief Back to an empty 200, keeping the storage for the next use */
+  void reset();
+
   void setStatus(int code, const std::string &message);
   void setHeader(const std::string &key, const std::string &value);
+  void setHeader(const std::string &key, const char *value, size_t length);
+  bool hasHeader(const std::string &key) const;
+  /** @brief Value of a header set earlier ("" if absent) */
+  std::string getHeader(const std::string &key) const;
   void setCookie(const std::string &cookie);
   void setBody(const std::string &body);
+  /** @brief Send caller-owned bytes as the body, without copying them */
+  void setBodyView(const char *data, size_t length);
+  /** @brief Use [offset, offset+length) of an open file as the body */
+  void setFileBody(const FileHandle &file, off_t offset, off_t length,
+                   const MappedFile &map = MappedFile());
+  /** @brief Append in-memory bytes / a file range to a segmented body */
+  void appendBodySegment(const std::string &data);
+  void appendBodySegment(const FileHandle &file, off_t offset, off_t length,
+                         const MappedFile &map = MappedFile());
+  /** @brief Reuse a cached header block; only Date/Connection are added */
+  void usePrebuilt(const std::string &head, const std::string &body);
+  /** @brief Drop the body but keep headers (HEAD) */
+  void clearBody();
   int getStatusCode() const;
+  /** @brief In-memory body (not the segments): _body or the view */
+  const char *getBodyData() const;
+  size_t getBodyLength() const;
+
+  bool hasBodySegments() const;
+  const std::vector<BodySegment> &getBodySegments() const;
+  /** @brief Move the segments out (swap, the response keeps none) */
+  void takeBodySegments(std::vector<BodySegment> &segments);
 
   void setCGIPending(bool pending);
   bool isCGIPending() const;
 
   /** @brief Build final HTTP response string with headers and body */
   std::string buildResponse() const;
+  /** @brief Build status line + headers + blank line only */
+  std::string buildHeaders() const;
+  /** @brief Same as buildHeaders(), appended to a reused string */
+  void appendHeaders(std::string &out) const;
+  /** @brief Header block without per-request lines (for ResponseCache) */
+  std::string buildCacheableHead() const;
 
   /** @brief Set error response with default error page */
   void setErrorResponse(int code);
+  /** @brief Send a pre-rendered page (header block copy, body by pointer) */
+  void useErrorPage(int code, const PrebuiltPage &page);
+  /** @brief Render an HTML error page and its header block */
+  static void preparePage(PrebuiltPage &page, int code,
+                          const std::string &message, const std::string &body);
 
   static std::string getHttpStatusMessage(int code);
+  /** @brief Same, as a literal (no std::string built) */
+  static const char *statusReason(int code);
+  /** @brief Reformat the cached Date line if the second changed */
+  static void tickDate(time_t now);
+  /** @brief Format a timestamp as IMF-fixdate (Date, Last-Modified) */
+  static std::string formatHttpDate(time_t when);
+  /** @brief Same into a caller buffer (>= 30 bytes), returns the length */
+  static size_t formatHttpDate(time_t when, char *buffer, size_t size);
 };
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @brief Reference-counted read-only mapping of a whole file
+ *
+ * Copies share the same mapping; it is unmapped when the last copy goes
+ * away, so every response sending slices of it keeps it alive, like
+ * FileHandle does for the fd.
+ */
+class MappedFile {
+private:
+  const char *_data;
+  size_t _size;
+  int *_refCount;
+
+  void release();
+
+public:
+  MappedFile();
+  MappedFile(int fd, size_t size);
+  MappedFile(const MappedFile &other);
+  MappedFile &operator=(const MappedFile &other);
+  ~MappedFile();
+
+  const char *data() const;
+  size_t size() const;
+  bool isValid() const;
+  void reset();
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "config/GlobalConfig.hpp"
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Extension → Content-Type table of the process
+ *
+ * Built once at startup from the built-in types or the configured ones
+ * (types {} / types_file), then only read. Lookups hash the extension in
+ * place, case-insensitively, and return a reference into the table, so
+ * resolving a type allocates nothing and the result can be kept (see
+ * OpenFileEntry::mime) for as long as the table lives.
+ */
+class MimeTypes {
+public:
+  /** @brief Longer extensions are never in the table */
+  static const size_t MAX_EXTENSION = 15;
+
+  /** @brief Built-in table, default type application/octet-stream */
+  MimeTypes();
+  ~MimeTypes();
+
+  /** @brief Replaces the table with the configured one, if any */
+  void configure(const GlobalConfig &config);
+
+  /**
+   * @brief Content-Type of a path, from its extension
+   * @param path File path (only the part after the last '/' is looked at)
+   * @return Type of the extension, or the default type
+   */
+  const std::string &lookup(const std::string &path) const;
+  /** @brief Type of an extension (without the dot) */
+  const std::string &lookupExtension(const char *extension,
+                                     size_t length) const;
+  const std::string &getDefaultType() const;
+  /** @brief Extensions in the table */
+  size_t size() const;
+
+private:
+  struct Slot {
+    uint32_t hash;
+    uint32_t type;                  // Index in _types (NONE = empty slot)
+    unsigned char length;
+    char extension[MAX_EXTENSION]; // Lowercase, not terminated
+  };
+
+  static const uint32_t NONE = 0xffffffffu;
+
+  std::vector<std::string> _types; // Distinct types (stable references)
+  std::vector<Slot> _slots;        // Open addressing, power of two
+  size_t _count;
+  std::string _defaultType;
+
+  void build(const std::vector<std::pair<std::string, std::string> > &map);
+  static uint32_t hashExtension(const char *extension, size_t length);
+
+  MimeTypes(const MimeTypes &);
+  MimeTypes &operator=(const MimeTypes &);
+};
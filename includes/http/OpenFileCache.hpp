@@ -0,0 +1,113 @@
+#pragma once
+
+#include "http/FileHandle.hpp"
+#include "http/MappedFile.hpp"
+#include <ctime>
+#include <list>
+#include <map>
+#include <string>
+#include <sys/stat.h>
+
+/**
+ * @brief Cached view of one filesystem path (stat, open fd, small content)
+ */
+struct OpenFileEntry {
+  int statError;       // 0, or errno of the failed stat()
+  struct stat st;      // stat() result (follows symlinks), valid if !statError
+  bool opened;         // open() already attempted for this version
+  int openError;       // errno of the failed open(), 0 if file is valid
+  FileHandle file;     // Shared fd of the regular file (large files only)
+  MappedFile map;      // Mapping of a medium file (open_file_cache_mmap)
+  bool hasContent;     // Small file: whole content held in `content`
+  std::string content; // File bytes (hasContent only)
+  const std::string *mime; // Content-Type in the process MimeTypes table,
+                           // NULL until the caller resolves it
+  std::string gzip;    // Compressed content, built once per version by
+  std::string brotli;  // StaticFileHandler (empty = not built yet)
+
+  time_t validatedAt; // Last time st was checked against the filesystem
+  time_t lastUsed;    // For inactive expiry
+  std::list<std::string>::iterator lruPos;
+};
+
+/**
+ * @brief nginx-style open_file_cache - per-process, keyed by resolved path
+ */
+class OpenFileCache {
+private:
+  typedef std::map<std::string, OpenFileEntry> EntryMap;
+
+  EntryMap _entries;
+  std::list<std::string> _lru; // Front = most recently used
+  size_t _maxEntries;          // 0 = cache disabled
+  int _inactive;               // Seconds without use before eviction
+  int _valid;                  // Seconds between revalidations
+  bool _cacheErrors;           // Keep ENOENT/EACCES results too
+  size_t _mapMax;              // Files mapped up to this size (0 = none)
+  unsigned long _hits;
+  unsigned long _misses;
+  EntryMap _handoffs;          // Installed results not cacheable: kept
+                               // for the lookups of the next second
+
+  OpenFileCache(const OpenFileCache &);
+  OpenFileCache &operator=(const OpenFileCache &);
+
+  void statInto(const std::string &path, OpenFileEntry &entry, time_t now);
+  bool sameVersion(const struct stat &a, const struct stat &b) const;
+  void touch(OpenFileEntry &entry, time_t now);
+  void evictExpired(time_t now);
+  void erase(EntryMap::iterator it);
+  EntryMap::const_iterator findHandoff(const std::string &path,
+                                       time_t now) const;
+  void pruneHandoffs(time_t now);
+  static void openInto(OpenFileEntry &entry, const std::string &path,
+                       bool keepContent, size_t mapMax);
+
+public:
+  /** @brief Files up to this size are kept in memory instead of as an fd */
+  static const off_t CONTENT_MAX = 32 * 1024;
+  /** @brief Uncacheable installed results kept at once */
+  static const size_t HANDOFF_MAX = 64;
+
+  OpenFileCache();
+  ~OpenFileCache();
+
+  void configure(size_t maxEntries, int inactive, int valid, bool errors,
+                 size_t mapMax);
+  bool isEnabled() const;
+  /** @brief Largest file mapped when opened (0 = none, or cache off) */
+  size_t getMapMax() const;
+
+  /** @brief stat() through the cache; entry stays valid until next call */
+  OpenFileEntry *lookup(const std::string &path);
+  /** @brief Open (or reuse) the regular file behind a looked-up entry */
+  void open(OpenFileEntry &entry, const std::string &path);
+  /** @brief Forget a path after the server itself changed it */
+  void invalidate(const std::string &path);
+
+  /** @brief Whether lookup() + open() of path would not touch the disk */
+  bool isFresh(const std::string &path) const;
+  /** @brief stat() + open() into a detached entry (any thread) */
+  static void load(const std::string &path, OpenFileEntry &entry,
+                   bool keepContent, size_t mapMax);
+  /**
+   * @brief load() in steps, for a caller doing the system calls itself
+   *
+   * loadStat() takes the stat() result; for a regular file, loadOpened()
+   * the open() result, and returns true when the small file's bytes must
+   * still be read (then given to loadContent()).
+   */
+  static void loadStat(OpenFileEntry &entry, const struct stat &st,
+                       int error);
+  static bool loadOpened(OpenFileEntry &entry, int fd, int error,
+                         bool keepContent, size_t mapMax);
+  static void loadContent(OpenFileEntry &entry, std::string &bytes);
+  /** @brief Flags of the open() of a cached file */
+  static int openFlags();
+  /** @brief Stores an entry filled by load() for the next lookup() */
+  void install(const std::string &path, const OpenFileEntry &loaded);
+
+  size_t size() const;
+  unsigned long getHits() const;
+  unsigned long getMisses() const;
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "config/GlobalConfig.hpp"
+#include "config/LocationConfig.hpp"
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+class HttpRequest;
+class ServerConfig;
+
+/**
+ * @brief limit_req zones of this process: one token bucket per key
+ *
+ * Each zone is a fixed table sized from its limit_req_zone memory and
+ * allocated once by configure(). A request only hashes its key and probes
+ * an open-addressing index (linear probing, at most half full); when every
+ * bucket is taken, the least recently used key gives its bucket up.
+ * Workers do not share zones: each one enforces the rate on the
+ * connections it accepted.
+ *
+ * Buckets follow nginx's limit_req: the excess over the rate drains at the
+ * rate, a request adds one, and an excess over the burst is refused.
+ */
+class RateLimiter {
+public:
+  /** @brief Outcome of check() */
+  enum Result {
+    PASS,  // Within the rate (or the burst, with nodelay)
+    DELAY, // Within the burst: hold it delayMs to pace it to the rate
+    REJECT // Over the burst: 429
+  };
+
+  /** @brief Requests of a zone by outcome, and keys evicted */
+  struct Counters {
+    unsigned long passed;
+    unsigned long delayed;
+    unsigned long rejected;
+    unsigned long evicted;
+
+    Counters() : passed(0), delayed(0), rejected(0), evicted(0) {}
+  };
+
+  RateLimiter();
+  ~RateLimiter();
+
+  /** @brief Allocates the tables of zones (drops every bucket) */
+  void configure(const std::vector<LimitReqZone> &zones);
+  size_t zoneCount() const;
+  const LimitReqZone &getZone(size_t zone) const;
+
+  /**
+   * @brief Accounts one request of key against limit
+   * @param key hashKey() of the request's key
+   * @param nowMs Monotonic milliseconds
+   * @param delayMs Receives how long to hold the request, on DELAY
+   */
+  Result check(const LimitReq &limit, uint64_t key, uint64_t nowMs,
+               uint64_t &delayMs);
+
+  /** @brief 64-bit hash of a key (bucket identity: keys are not stored) */
+  static uint64_t hashKey(const void *data, size_t length);
+  /**
+   * @brief hashKey() of the zone's key for one request
+   * @param addr Client IPv4 address (network order)
+   * @return false if the request has no key (header absent): not limited
+   */
+  static bool requestKey(const LimitReqZone &zone, uint32_t addr,
+                         const ServerConfig &server,
+                         const HttpRequest &request, uint64_t &key);
+
+  const Counters &getCounters(size_t zone) const;
+  /** @brief Keys with a bucket in zone */
+  size_t size(size_t zone) const;
+  /** @brief Buckets of zone (the most keys it tracks at once) */
+  size_t capacity(size_t zone) const;
+
+private:
+  static const uint32_t NONE = 0xffffffffu;
+  /** @brief Most buckets per zone */
+  static const size_t MAX_BUCKETS = 1 << 24;
+
+  struct Bucket {
+    uint64_t key;
+    uint64_t last;   // nowMs of the last request accounted
+    uint64_t excess; // Requests over the rate, in thousandths
+    uint32_t prev;   // LRU neighbours (NONE = end)
+    uint32_t next;
+  };
+
+  struct Zone {
+    LimitReqZone config;
+    std::vector<Bucket> buckets;
+    std::vector<uint32_t> index; // Hash slot → bucket (power of two)
+    size_t used;                 // Buckets handed out so far
+    uint32_t head;               // Most recently used bucket
+    uint32_t tail;               // Least recently used one
+    Counters counters;
+
+    Zone() : used(0), head(NONE), tail(NONE) {}
+  };
+
+  std::vector<Zone> _zones;
+
+  static size_t findSlot(const Zone &zone, uint64_t key);
+  static void removeSlot(Zone &zone, size_t slot);
+  static void unlink(Zone &zone, uint32_t bucket);
+  static void pushFront(Zone &zone, uint32_t bucket);
+  static uint32_t acquire(Zone &zone, uint64_t key, size_t slot);
+
+  RateLimiter(const RateLimiter &);
+  RateLimiter &operator=(const RateLimiter &);
+};
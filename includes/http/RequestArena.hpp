@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Per-request scratch strings, all given back in one reset()
+ */
+class RequestArena {
+private:
+  std::vector<std::string *> _strings; // Every slot ever handed out
+  size_t _used;                        // Slots taken by the current request
+
+  RequestArena(const RequestArena &);
+  RequestArena &operator=(const RequestArena &);
+
+public:
+  /** @brief Larger strings are freed on reset() instead of kept */
+  static const size_t KEEP_CAPACITY = 4096;
+
+  RequestArena();
+  ~RequestArena();
+
+  /** @brief Empty string valid until the next reset() */
+  std::string &string();
+  /** @brief Makes every string available again (capacity kept) */
+  void reset();
+};
@@ -1,9 +1,13 @@
 #pragma once
 
 #include "config/ServerConfig.hpp"
+#include "http/ErrorPageCache.hpp"
 #include "http/HttpRequest.hpp"
 #include "http/HttpResponse.hpp"
+#include "http/RateLimiter.hpp"
 #include "http/StaticFileHandler.hpp"
+#include "http/VirtualHostTable.hpp"
+#include <stdint.h>
 #include <vector>
 
 class ClientConnection;
@@ -20,21 +24,75 @@ public:
    * @brief Main entry point for processing an HTTP request
    * @param request The complete HTTP request
    * @param candidateConfigs ServerConfigs matching the port
-   * @param client Optional - if provided, CGI runs async
-   * @return HttpResponse (or pending if CGI async)
+   * @param response Filled in place (or marked pending if CGI async)
+   * @param client Optional - without it, CGI / FastCGI / proxy locations
+   *        are not run (see needsConnection())
    */
-  HttpResponse handleRequest(const HttpRequest &request,
+  void handleRequest(const HttpRequest &request,
+                     const std::vector<ServerConfig> &candidateConfigs,
+                     HttpResponse &response, ClientConnection *client = NULL);
+
+  /** @brief client_max_body_size of the location a request is routed to */
+  size_t getBodyLimit(const HttpRequest &request,
+                      const std::vector<ServerConfig> &candidateConfigs);
+
+  /** @brief Upload file for a static POST, opened before the body is read */
+  UploadSink *openUploadSink(const HttpRequest &request,
                              const std::vector<ServerConfig> &candidateConfigs,
-                             ClientConnection *client = NULL);
+                             int &status);
+
+  /** @brief Share the process-wide static caches (NULL = disabled) */
+  void setCaches(OpenFileCache *fileCache, ResponseCache *responseCache,
+                 DirectoryListingCache *listingCache = NULL);
+  /** @brief Share the process-wide gzip / brotli policy (NULL = none) */
+  void setCompression(const Compression *compression);
+  /** @brief Share the process-wide MIME table (NULL = built-in types) */
+  void setMimeTypes(const MimeTypes *types);
+  /** @brief Pre-rendered error_page files (NULL = built-in pages only) */
+  void setErrorPages(const ErrorPageCache *errorPages);
+  /** @brief server_name table of the port (NULL = first server only) */
+  void setVirtualHosts(const VirtualHostTable *virtualHosts);
+  /** @brief Server block the TLS SNI name picked (used without Host) */
+  void setSniServer(size_t index);
+  /** @brief Scratch storage of the owning connection (NULL = private) */
+  void setArena(RequestArena *arena);
+  /** @brief limit_req for requests handled without a connection (HTTP/2
+   *         streams), keyed by the client address addr (NULL = none) */
+  void setStreamLimiter(RateLimiter *limiter, uint32_t addr);
+  /** @brief Let static requests park on an I/O thread (io_threads) */
+  void setDeferIo(bool enabled);
+  /** @brief Task the last request is parked on (caller owns it), or NULL */
+  IoTask *takeDeferredIo();
+
+  /** @brief Nanoseconds the last request spent in vhost + location matching */
+  uint64_t getRouteTime() const;
+  /** @brief Pattern of the location the last request matched, or NULL */
+  const std::string *getMatchedLocation() const;
+  /** @brief The last request needs a connection to run (CGI, FastCGI,
+   *         proxy) and got none: nothing was answered */
+  bool needsConnection() const;
 
 private:
   StaticFileHandler _staticHandler;
+  const ErrorPageCache *_errorPages;
+  const VirtualHostTable *_virtualHosts;
+  size_t _sniServer; // Index into the candidates, npos = no SNI
+  std::string _errorPagePath; // Lookup key, storage reused across requests
+  uint64_t _routeTime;                // Of the last request (Metrics)
+  const std::string *_matchedLocation; // Pattern, inside the snapshot
+  bool _needsConnection;               // Of the last request
+  RateLimiter *_streamLimiter;         // limit_req without a connection
+  uint32_t _streamAddr;                // Its client address
 
   const ServerConfig *
   _matchVirtualHost(const HttpRequest &request,
                     const std::vector<ServerConfig> &candidateConfigs);
   const LocationConfig *_matchLocation(const std::string &path,
                                        const ServerConfig &config);
+  bool _streamRejected(const HttpRequest &request,
+                       const LocationConfig &location,
+                       const ServerConfig &server);
+  void _serveMetrics(const HttpRequest &request, HttpResponse &response);
   void _applyConnectionHeader(const HttpRequest &request,
                               HttpResponse &response);
   void _sendError(int errorCode, HttpResponse &response,
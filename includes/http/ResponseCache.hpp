@@ -0,0 +1,60 @@
+#pragma once
+
+#include <ctime>
+#include <list>
+#include <map>
+#include <string>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/**
+ * @brief Fully serialized 200 response for one file version
+ */
+struct CachedResponse {
+  dev_t dev; // File version the bytes were built from
+  ino_t ino;
+  off_t size;
+  time_t mtime;
+  mode_t mode;
+  std::string head; // Status line + headers, without Date/Connection/CRLF
+  std::string body;
+  std::list<std::string>::iterator lruPos;
+};
+
+/**
+ * @brief Per-process cache of pre-serialized responses for small hot files
+ */
+class ResponseCache {
+private:
+  typedef std::map<std::string, CachedResponse> EntryMap;
+
+  EntryMap _entries;
+  std::list<std::string> _lru; // Front = most recently used
+  size_t _budget;              // Max bytes of head + body (0 = disabled)
+  size_t _used;
+  unsigned long _hits;
+  unsigned long _misses;
+
+  ResponseCache(const ResponseCache &);
+  ResponseCache &operator=(const ResponseCache &);
+
+  void erase(EntryMap::iterator it);
+
+public:
+  ResponseCache();
+  ~ResponseCache();
+
+  void configure(size_t budgetBytes);
+  bool isEnabled() const;
+
+  /** @brief Cached response for path if it was built from this version */
+  const CachedResponse *find(const std::string &path, const struct stat &st);
+  void store(const std::string &path, const struct stat &st,
+             const std::string &head, const std::string &body);
+  void invalidate(const std::string &path);
+
+  size_t size() const;
+  size_t getUsedBytes() const;
+  unsigned long getHits() const;
+  unsigned long getMisses() const;
+};
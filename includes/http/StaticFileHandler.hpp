@@ -3,7 +3,14 @@
 #include "config/LocationConfig.hpp"
 #include "http/HttpRequest.hpp"
 #include "http/HttpResponse.hpp"
-#include <map>
+#include "http/OpenFileCache.hpp"
+#include "http/RequestArena.hpp"
+#include "http/Compression.hpp"
+#include "http/DirectoryListingCache.hpp"
+#include "http/FileTasks.hpp"
+#include "http/MimeTypes.hpp"
+#include "http/ResponseCache.hpp"
+#include "http/UploadSink.hpp"
 #include <string>
 
 /**
@@ -22,6 +29,10 @@ public:
   void handlePost(const HttpRequest &request, HttpResponse &response,
                   const LocationConfig &location);
 
+  /** @brief Create the upload file of a POST whose body is still coming */
+  UploadSink *openUpload(const HttpRequest &request,
+                         const LocationConfig &location, int &status);
+
   /** @brief Handle DELETE request */
   void handleDelete(const HttpRequest &request, HttpResponse &response,
                     const LocationConfig &location);
@@ -30,19 +41,76 @@ public:
   void handleHead(const HttpRequest &request, HttpResponse &response,
                   const LocationConfig &location);
 
+  /** @brief Share the process-wide open file cache (NULL = disabled) */
+  void setFileCache(OpenFileCache *cache);
+  /** @brief Share the process-wide serialized response cache */
+  void setResponseCache(ResponseCache *cache);
+  /** @brief Share the process-wide autoindex listing cache */
+  void setListingCache(DirectoryListingCache *cache);
+  /** @brief Use the process-wide gzip / brotli policy (NULL = none) */
+  void setCompression(const Compression *compression);
+  /** @brief Resolve Content-Types from the process-wide table */
+  void setMimeTypes(const MimeTypes *types);
+  /** @brief Take path temporaries from the connection's arena */
+  void setArena(RequestArena *arena);
+  /** @brief Hand blocking filesystem calls to an I/O thread (io_threads) */
+  void setDeferIo(bool enabled);
+  /** @brief Task the last request waits for (caller owns it), or NULL */
+  IoTask *takeDeferredIo();
+  bool hasDeferredIo() const;
+
   /** @brief Serve a specific file from disk */
   void serveStaticFile(const std::string &fullPath, HttpResponse &response);
 
 private:
-  std::map<std::string, std::string> _mimeTypes;
-
-  void _initMimeTypes();
-  std::string _determineMimeType(const std::string &path);
-  std::string _sanitizePath(const std::string &decodedPath) const;
-  bool _readFileToString(const std::string &fullPath, std::string &out,
-                         size_t size);
-  void _handleDirectory(const std::string &dirPath, const std::string &urlPath,
-                        const LocationConfig &location, HttpResponse &response);
+  const MimeTypes *_mimeTypes;
+  OpenFileCache *_fileCache;
+  ResponseCache *_responseCache;
+  DirectoryListingCache *_listingCache;
+  const Compression *_compression;
+  RequestArena *_arena;
+  RequestArena _ownArena; // Used (and reset per request) when _arena is NULL
+  bool _deferIo;          // Cold paths become I/O thread tasks
+  IoTask *_deferred;      // Task the current request is parked on
+  IoOutcome _outcome;     // Result of the last fsync / unlink / scan task
 
-  static const size_t MAX_STATIC_FILE_SIZE = 10 * 1024 * 1024;
+  OpenFileCache &_cache();
+  DirectoryListingCache &_listings();
+  const MimeTypes &_types() const;
+  RequestArena &_scratch();
+  bool _deferLookup(const std::string &path);
+  void _defer(IoTask *task);
+  bool _takeOutcome(const std::string &path, int &value);
+  bool _sanitizePath(const std::string &decodedPath,
+                     std::string &cleanPath) const;
+  void _buildFullPath(const std::string &cleanPath,
+                      const LocationConfig &location,
+                      std::string &fullPath) const;
+  void _serveEntry(OpenFileEntry &entry, const std::string &fullPath,
+                   const HttpRequest *request, HttpResponse &response);
+  static size_t _makeETag(const struct stat &st, char *buffer, size_t size);
+  bool _isNotModified(const HttpRequest *request, const struct stat &st,
+                      HttpResponse &response);
+  bool _serveRanges(const OpenFileEntry &entry, const HttpRequest &request,
+                    HttpResponse &response);
+  void _storeResponse(const OpenFileEntry &entry, const std::string &fullPath,
+                      HttpResponse &response);
+  Compression::Encoding _negotiate(const HttpRequest *request,
+                                   const OpenFileEntry &entry,
+                                   bool wantsRange) const;
+  bool _serveSibling(const std::string &fullPath, const struct stat &original,
+                     const std::string &mime, Compression::Encoding encoding,
+                     const HttpRequest *request, HttpResponse &response);
+  const std::string *_encodedContent(OpenFileEntry &entry,
+                                     Compression::Encoding encoding);
+  static void _setEncodedHeaders(const struct stat &original,
+                                 const std::string &mime,
+                                 Compression::Encoding encoding,
+                                 HttpResponse &response);
+  int _prepareUploadTarget(const LocationConfig &location,
+                           std::string &filepath, std::string &filename);
+  void _handleDirectory(const std::string &dirPath, const struct stat &dirStat,
+                        const std::string &urlPath,
+                        const LocationConfig &location,
+                        const HttpRequest &request, HttpResponse &response);
 };
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <sys/types.h>
+
+/**
+ * @brief Upload file written while the request body is still arriving
+ *
+ * Removed from disk on destruction unless commit() succeeded, so aborted
+ * or rejected uploads leave nothing behind.
+ */
+class UploadSink {
+private:
+  int _fd;
+  std::string _path;
+  std::string _filename;
+  size_t _written;
+  size_t _limit; // Bytes accepted, past that the body is too large anyway
+  bool _failed;
+  bool _committed;
+
+  UploadSink(const UploadSink &);
+  UploadSink &operator=(const UploadSink &);
+
+public:
+  UploadSink();
+  ~UploadSink();
+
+  /** @brief Create path (must not exist) and optionally reserve its size;
+   *  0, or errno of the failure */
+  int open(const std::string &path, const std::string &filename,
+           size_t limit, off_t expectedLength, bool preallocate);
+  /** @brief Append body bytes; errors are remembered, not reported */
+  void write(const char *data, size_t length);
+  /** @brief Flush and keep the file; false if any write failed */
+  bool commit(bool synced = false);
+  /** @brief Duplicate of the file descriptor (-1: nothing to sync) */
+  int dupFd() const;
+
+  bool failed() const;
+  size_t getWritten() const;
+  const std::string &getFilename() const;
+  const std::string &getPath() const;
+};
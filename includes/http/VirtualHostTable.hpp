@@ -0,0 +1,41 @@
+#pragma once
+
+#include "config/ServerConfig.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief server_name → server block of one listening port, hashed
+ *
+ * Exact names cost one hash; "*.example.com" wildcards one more per label
+ * of the Host header. Hosts that match nothing go to the default server.
+ */
+class VirtualHostTable {
+private:
+  struct Slot {
+    std::string name; // Lowercase; "" = empty slot
+    size_t server;    // Index in the port's config vector
+  };
+
+  std::vector<Slot> _exact;    // Open addressing, power-of-two size
+  std::vector<Slot> _suffixes; // ".example.com" of each wildcard
+  size_t _defaultServer;
+
+  static size_t hash(const char *name, size_t length);
+  static void insert(std::vector<Slot> &table, const std::string &name,
+                     size_t server);
+  static const Slot *find(const std::vector<Slot> &table, const char *name,
+                          size_t length);
+
+public:
+  VirtualHostTable();
+  ~VirtualHostTable();
+
+  /** @brief Indexes the server names of the blocks sharing a port */
+  void build(const std::vector<ServerConfig> &servers);
+
+  /** @brief Server index for a Host header value (port ignored) */
+  size_t lookup(const char *host, size_t length) const;
+  size_t getDefaultServer() const;
+};
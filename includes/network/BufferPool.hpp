@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Per-process pool of fixed-size I/O blocks shared by connections
+ */
+class BufferPool {
+private:
+  std::vector<char *> _free; // Released blocks ready for reuse
+  size_t _maxFree;           // Free blocks kept, the rest go back to malloc
+  size_t _allocated;         // Blocks currently allocated (in use + free)
+  unsigned long _acquired;
+  unsigned long _reused;
+
+  BufferPool(const BufferPool &);
+  BufferPool &operator=(const BufferPool &);
+
+public:
+  /** @brief Size of every block */
+  static const size_t BLOCK_SIZE = 16 * 1024;
+
+  explicit BufferPool(size_t maxFree = 256);
+  ~BufferPool();
+
+  /** @brief Block of BLOCK_SIZE bytes (reused when possible) */
+  char *acquire();
+  /** @brief Return a block obtained from acquire() */
+  void release(char *block);
+
+  size_t getInUse() const;
+  size_t getFree() const;
+  unsigned long getAcquired() const;
+  unsigned long getReused() const;
+};
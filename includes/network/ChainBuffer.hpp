@@ -0,0 +1,56 @@
+#pragma once
+
+#include "network/BufferPool.hpp"
+#include <cstddef>
+#include <sys/uio.h>
+#include <vector>
+
+/**
+ * @brief Byte queue made of pooled blocks (receive side of a connection)
+ *
+ * Data is appended at the tail (prepare() + commit()) and consumed from
+ * the head; consuming only moves an offset, and a block that becomes empty
+ * goes straight back to the pool.
+ */
+class ChainBuffer {
+private:
+  struct Block {
+    char *data;
+    size_t start; // First unconsumed byte
+    size_t end;   // One past the last written byte
+  };
+
+  BufferPool *_pool; // NULL: blocks come from new[] directly
+  std::vector<Block> _blocks;
+  size_t _size;
+  size_t _prepared; // First block handed out by the last prepare()
+
+  ChainBuffer(const ChainBuffer &);
+  ChainBuffer &operator=(const ChainBuffer &);
+
+  void popFront();
+  void pushBlock();
+
+public:
+  explicit ChainBuffer(BufferPool *pool = NULL);
+  ~ChainBuffer();
+
+  bool empty() const;
+  /** @brief Unconsumed bytes over all blocks */
+  size_t size() const;
+  size_t blockCount() const;
+
+  /** @brief Writable space at the tail, taking a new block if needed */
+  char *prepare(size_t &room);
+  /** @brief Same, over up to maxBlocks blocks for one readv() */
+  size_t prepare(struct iovec *iov, size_t maxBlocks);
+  /** @brief Marks length bytes written at prepare() as data */
+  void commit(size_t length);
+
+  /** @brief Contiguous unconsumed bytes of the first block ("" if empty) */
+  const char *front(size_t &length) const;
+  /** @brief Drops length bytes from the head, releasing emptied blocks */
+  void consume(size_t length);
+  /** @brief Drops everything and returns all blocks */
+  void clear();
+};
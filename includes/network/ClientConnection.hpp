@@ -1,15 +1,33 @@
 #pragma once
 
+#include "cgi/CGICache.hpp"
+#include "cgi/FastCGIPool.hpp"
+#include "cgi/FastCGIRequest.hpp"
+#include "config/GlobalConfig.hpp"
 #include "config/ServerConfig.hpp"
+#include "core/ConfigSnapshot.hpp"
+#include "core/IoThreadPool.hpp"
+#include "http/Compression.hpp"
+#include "http/Http2Session.hpp"
 #include "http/HttpRequest.hpp"
 #include "http/HttpResponse.hpp"
+#include "http/RateLimiter.hpp"
+#include "http/RequestArena.hpp"
 #include "http/RequestHandler.hpp"
+#include "network/ChainBuffer.hpp"
+#include "network/TlsConnection.hpp"
+#include "proxy/ProxyRequest.hpp"
+#include "proxy/UpstreamPool.hpp"
 #include <ctime>
+#include <map>
 #include <netinet/in.h>
+#include <stdint.h>
 #include <string>
 #include <sys/types.h>
 #include <vector>
 
+class ConnectionPool;
+
 /** @brief CGI process state for this connection */
 enum CGIState {
   CGI_NONE,    // No CGI running
@@ -17,37 +35,178 @@ enum CGIState {
   CGI_DONE     // CGI finished, response ready to send
 };
 
+/**
+ * @brief Process-wide objects every connection of a worker uses
+ *
+ * Owned by the Server and passed as one pointer instead of a dozen per
+ * connection. A NULL member disables what it serves.
+ */
+struct ConnectionServices {
+  OpenFileCache *fileCache;
+  ResponseCache *responseCache;
+  BufferPool *bufferPool;
+  FastCGIPool *fastcgiPool;
+  DirectoryListingCache *listingCache;
+  const Compression *compression;
+  IoThreadPool *ioPool;
+  UpstreamPool *upstreamPool;
+  CGICache *cgiCache;
+  RateLimiter *rateLimiter;
+  const MimeTypes *mimeTypes;
+  ConnectionPool *pool; // Connection storage and exchanges (required)
+  size_t readBudget;    // io_read_budget (0 = one recv per event)
+  size_t writeBudget;   // io_write_budget
+  bool draining;        // Shutting down: every response closes its connection
+
+  ConnectionServices();
+};
+
+/**
+ * @brief State of the request a connection is working on
+ *
+ * Everything a connection only needs between the first byte of a request
+ * and the end of its response: parser, response, handler, write progress,
+ * CGI / FastCGI / proxy / cache / limit state. Taken from the
+ * ConnectionPool when bytes arrive and handed back once the connection is
+ * idle in keep-alive, so idle connections only keep their hot part.
+ * Recycled in the reset state left by resetForNextRequest(), with the
+ * capacity of its buffers.
+ */
+struct ClientExchange {
+  HttpRequest httpRequest;
+  UploadSink *uploadSink; // Streamed static upload of the current request
+  size_t bodyLimit;       // client_max_body_size of the matched location
+
+  std::string batch;       // Finished pipelined responses, sent first
+  size_t batchOffset;      // Bytes of batch already sent
+  bool responseQueued;     // queueResponse() ran, onResponseSent() not yet
+  std::string writeBuffer; // Serialized header block
+  const char *bodyData;    // In-memory body, sent after writeBuffer
+  size_t bodyLength;       // (points into httpResponse or cgiBuffer)
+  size_t writeOffset;      // Progress over writeBuffer + body
+  std::vector<BodySegment> segments; // Streamed after writeBuffer
+  size_t segmentIndex;               // Segment being sent
+  off_t segmentSent;                 // Bytes of it already sent
+  bool bodyFileSendfile; // false → stream through the pread() window
+  bool bodyFileStarted;  // At least one file byte already went out
+  bool requestComplete;
+
+  HttpResponse httpResponse; // Reused: reset() between requests
+  RequestHandler requestHandler;
+  RequestArena arena; // Per-request temporaries, reset in one shot
+
+  CGIState cgiState;
+  int cgiPipeFd;
+  pid_t cgiPid;
+  std::string cgiBuffer;
+  bool cgiFailed;
+  int cgiStdinFd;      // Write end of the script's stdin (-1 = closed)
+  size_t cgiInputSent; // Request body bytes already written to it
+  bool cgiBuffered;    // Output sent whole (HTTP/1.0, no Content-Length)
+  bool cgiStreaming;   // Header block queued, body relayed as it comes
+  bool cgiChunked;     // Relayed body framed with chunked coding
+  bool cgiPaused;      // Pipe not watched: client backlog over the window
+  off_t cgiStreamed;   // Body bytes relayed (segments are dropped once sent)
+  GzipStream cgiGzip;  // Active when the relayed body is gzip-encoded
+
+  FastCGIRequest fastcgi; // Active while the CGI fd is a FastCGI socket
+  std::string fastcgiAddress;
+
+  ProxyRequest proxy;          // Active while the CGI fd is a backend socket
+  const ProxyPass *proxyGroup; // Backends of the location (in the config)
+  std::string proxyServer;     // Backend the request went to
+  bool proxyReused;            // On an idle keep-alive connection
+
+  std::string cacheKey;   // cgi_cache key filled or waited for
+  bool cacheFilling;      // Holds the key's lock: store the output
+  bool cacheWaiting;      // Parked until the key's lock is released
+  bool cacheBypass;       // Lock wait timed out: straight to the origin
+  std::string cacheFill;  // Streamed output kept for the cache
+  const CGICachePolicy *cachePolicy; // Of the location (in the config)
+
+  bool limitChecked;  // Request already accounted (reruns skip it)
+  bool limitDelayed;  // Held to pace it to the zone's rate
+  time_t limitResume; // When the held request runs
+
+  LimitRate limitRate; // Of the current response (rate 0 = full speed)
+  time_t rateStart;    // Response queued
+  uint64_t rateSent;   // Bytes of it sent so far
+  bool ratePaused;     // Ahead of the rate: waiting for rateResume
+  time_t rateResume;
+
+  IoTask *ioTask; // Task the request is parked on (owned by the pool)
+  int ioRounds;   // Tasks the current request waited for
+
+  // Metrics of the current request (nanoseconds, see Metrics)
+  uint64_t parseNs;    // Spent in the parser so far
+  uint64_t routeNs;    // Virtual host + location matching, every run
+  uint64_t handlerNs;  // Rest of RequestHandler, every run
+  uint64_t flushStart; // Response queued (0 = nothing queued)
+  uint64_t cgiStart;   // CGI / FastCGI request started (0 = none)
+  const std::string *matchedLocation; // Pattern of the matched location
+
+  // Phase boundaries for the slow log / trace (see RequestTrace)
+  uint64_t requestStart; // First byte of the request parsed (0 = none yet)
+  uint64_t parsedAt;     // Request complete
+  uint64_t handlerAt;    // First RequestHandler run
+  uint64_t ioStart;      // Current I/O task submitted
+  uint64_t ioNs;         // Parked on I/O tasks so far
+  uint64_t cgiAt;        // CGI / FastCGI / proxy request started
+  uint64_t cgiNs;        // Its duration, once the output is complete
+
+  unsigned long allocMark; // AllocCounter at the start of this request
+
+  explicit ClientExchange(const ConnectionServices &services);
+
+private:
+  ClientExchange(const ClientExchange &);
+  ClientExchange &operator=(const ClientExchange &);
+};
+
 /**
  * @brief Individual client connection - manages request/response lifecycle
  */
 class ClientConnection {
 public:
-  ClientConnection(int fd, const sockaddr_in &addr,
-                   const std::vector<ServerConfig> &serverCandidateConfigs);
+  ClientConnection(int fd, const sockaddr_in &addr, ConfigSnapshot *config,
+                   const ListenerConfig &listener,
+                   const ConnectionServices &services);
   ~ClientConnection();
 
   int getFd() const;
   std::string getIp() const;
+  /** @brief Client IPv4 address, network byte order */
+  uint32_t getAddr() const;
 
   /** @brief Read data from client socket into buffer */
   bool readRequest();
   /** @brief Process buffered request and generate response */
   bool processRequest();
-  /** @brief Send response data to client */
+  /** @brief Send response data to client (or hold it for a pipelined burst) */
   bool sendResponse();
+  /** @brief Sends responses held by sendResponse() if nothing else will */
+  bool flushBatch();
   bool isClosed() const;
 
   /** @brief Attempt to send pending write buffer (non-blocking) */
   bool flushWrite();
+  /** @brief Unsent bytes: held pipelined responses or the current one */
   bool hasPendingWrite() const;
+  /** @brief Unsent bytes of the current request's response */
+  bool isResponsePending() const;
   void markClosed();
   bool isRequestComplete() const;
-  const HttpRequest &getHttpRequest() const;
+  /** @brief Holds request state (false while idle in keep-alive) */
+  bool hasExchange() const;
 
   // Timeout helpers
   time_t getLastActivity() const;
   void updateActivity();
-  bool isTimedOut(time_t now, int timeoutSec) const;
+  /** @brief Phase whose timeout applies now (header, body, send...) */
+  GlobalConfig::Timeout getTimeoutPhase() const;
+  /** @brief What the timeout of phase counts from: its start, or the
+   *  last activity */
+  time_t getTimeoutStart(GlobalConfig::Timeout phase) const;
 
   // Keep-alive support
   void resetForNextRequest();
@@ -57,31 +216,144 @@ public:
   CGIState getCGIState() const;
   int getCGIPipeFd() const;
   pid_t getCGIPid() const;
-  void startCGI(int pipeFd, pid_t pid);
+  void startCGI(int pipeFd, pid_t pid, int stdinFd = -1);
   bool readCGIOutput();
   void finishCGI(int exitStatus);
   const std::string &getCGIBuffer() const;
-  void setCGIResponse(const std::string &responseStr);
+  void setCGIResponse(const HttpResponse &response);
+  /** @brief Kills a stalled CGI and answers 504 (pipe unregistered) */
+  void abortCGI();
+
+  // Blocking file I/O (io_threads): the request waits for an I/O thread
+  bool isIoPending() const;
+  /** @brief The task came back: install its results (request reruns) */
+  void completeIo(IoTask *task);
+
+  // FastCGI (fastcgi_pass): the CGI fd is a pooled server connection
+  bool startFastCGI(const std::string &address,
+                    const std::map<std::string, std::string> &params,
+                    const std::string &body);
+  // Reverse proxy (proxy_pass): the CGI fd is a pooled backend connection
+  bool startProxy(const LocationConfig &location);
+  /** @brief Reused backend connection failed early: retries on a new one
+   *         (the old fd must be unwatched first) */
+  bool retryProxy();
+
+  // cgi_cache: script / backend responses served from CGICache
+  /** @brief Answers from the cache (true: hit, or parked on the lock) */
+  bool lookupCGICache(const LocationConfig &location, HttpResponse &response);
+  /** @brief Parked until another request filled the same key */
+  bool isCacheWaiting() const;
+  /** @brief Ends the wait; timedOut: run the origin without the cache */
+  void resumeCacheWait(bool timedOut);
+
+  // limit_req: requests over the rate are held (DELAY) or refused (REJECT)
+  /** @brief Accounts the request in its location's zone, once per request */
+  RateLimiter::Result checkRateLimit(const LocationConfig &location,
+                                     const ServerConfig &server);
+  /** @brief Held by limit_req until getLimitResume() */
+  bool isLimitDelayed() const;
+  /** @brief Second at which a held request runs (wheel resolution) */
+  time_t getLimitResume() const;
+  void resumeLimitDelay();
+
+  // limit_rate: the response is sent at most rate bytes per second
+  /** @brief Applies the location's limit_rate to the coming response */
+  void setLimitRate(const LimitRate &limit);
+  /** @brief Sent its share of this second: POLLOUT off until getRateResume() */
+  bool isRatePaused() const;
+  /** @brief Second from which the paused response may send again */
+  time_t getRateResume() const;
+  void resumeRatePause();
+
+  /** @brief Request bytes still to write to the script (POLLOUT) */
+  bool hasCGIInput() const;
+  bool writeCGIInput();
+  /** @brief CGI stdin pipe while the body is fed (-1 = none / FastCGI) */
+  int getCGIStdinFd() const;
+  /** @brief Closes the stdin pipe (EOF for the script), once unregistered */
+  void closeCGIInput();
+  /** @brief The FastCGI / backend exchange broke: answer 502 */
+  bool hasCGIFailed() const;
+
+  // Streamed CGI output: headers sent as soon as parsed, body relayed
+  /** @brief Moves new CGI output towards the client (after each read) */
+  void relayCGIOutput();
+  bool isCGIStreaming() const;
+  /** @brief Terminates a streamed response once the CGI is finished */
+  void endCGIStream();
+  /** @brief Relayed bytes not accepted by the client socket yet */
+  size_t getCGIBacklog() const;
+  /** @brief Pipe unregistered until the client drains the backlog */
+  bool isCGIPaused() const;
+  void setCGIPaused(bool paused);
+  /** @brief Backlog at which the pipe stops being read */
+  static const size_t CGI_STREAM_WINDOW = 64 * 1024;
 
 private:
   int _clientFd;
   sockaddr_in _addr;
   bool _closed;
+  bool _tcpNoPush;      // tcp_nopush of the listener: cork file bodies
+  bool _corked;         // TCP_CORK set until the response is written
+  bool _http2;          // "listen ... http2": h2c accepted on this port
+  bool _prefaceChecked; // First bytes were not the HTTP/2 preface
+  bool _keepAliveIdle;  // Response sent, no byte of the next request yet
+  size_t _sniServer;    // Server block picked by SNI (TLS)
 
-  std::string _rawRequest;
-  HttpRequest _httpRequest;
-
-  std::string _writeBuffer;
-  size_t _writeOffset;
+  ChainBuffer _readBuffer; // Received bytes not consumed by the parser yet
+  Http2Session *_h2;       // HTTP/2 session once switched (NULL = HTTP/1.x)
+  TlsConnection *_tls;     // "listen ... ssl" ports, else NULL
   time_t _lastActivity;
-  bool _requestComplete;
-  std::vector<ServerConfig> _servCandidateConfigs;
+  time_t _phaseStart; // Start of the header, body or CGI phase
+  ConfigSnapshot *_config;          // Referenced until the connection goes
+  const ListenerConfig &_listener;  // Servers of the port (in _config)
+  const ConnectionServices *_services; // Process-wide (owned by the Server)
+  ClientExchange *_ex; // Current request state (NULL = idle, see
+                       // attachExchange())
 
-  HttpResponse _httpResponse;
-  RequestHandler _requestHandler;
+  /** @brief Stack window used when sendfile() is unavailable */
+  static const size_t FILE_WINDOW_SIZE = 64 * 1024;
+  /** @brief Buffers gathered per writev() (POSIX guarantees >= 16) */
+  static const int MAX_WRITE_IOV = 16;
+  /** @brief Receive blocks filled by one readv() once the socket is busy */
+  static const size_t MAX_READ_BLOCKS = 4;
+  /** @brief Tasks one request may wait for; then it runs synchronously */
+  static const int MAX_IO_ROUNDS = 8;
+  /** @brief Largest single sendfile() call */
+  static const off_t FILE_CHUNK_SIZE = 1024 * 1024;
+  /** @brief Bytes of pipelined responses held for one write */
+  static const size_t BATCH_LIMIT = 64 * 1024;
 
-  CGIState _cgiState;
-  int _cgiPipeFd;
-  pid_t _cgiPid;
-  std::string _cgiBuffer;
+  void attachExchange();
+  void detachExchange();
+  bool feedParser();
+  bool parseBuffered();
+  void dropUploadSink();
+  ssize_t sendFileChunk(const BodySegment &segment, off_t count);
+  ssize_t sendFileWindow(const BodySegment &segment, off_t count);
+  void clearBodySegments();
+  void queueResponse();
+  bool canBatch() const;
+  bool hasFileSegment() const;
+  void setCork(bool on);
+  bool stepHandshake();
+  ssize_t receive(const struct iovec *iov, int count);
+  ssize_t transmit(const struct iovec *iov, int count);
+  void startHttp2();
+  void feedHttp2();
+  int gatherWrite(struct iovec *iov, int maxCount) const;
+  bool writesMapped(const BodySegment &segment) const;
+  void advanceWrite(size_t bytes);
+  size_t rateAllowance();
+  void recycleWriteBuffer();
+  void onResponseSent();
+  void logAccess() const;
+  void traceRequest(uint64_t end) const;
+  bool readFastCGIOutput();
+  bool readProxyOutput();
+  std::string cacheKey(const CGICachePolicy &policy) const;
+  void endCacheFill(bool complete);
+  void appendStreamSegment(std::string &data);
+  void appendStreamChunk(std::string &data);
 };
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "network/ClientConnection.hpp"
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Per-process free lists of connection objects and request state
+ *
+ * Connections are built in recycled storage and their ClientExchange is
+ * only taken while a request is under way, so a worker holding many idle
+ * keep-alive connections pays for the small hot part of each.
+ */
+class ConnectionPool {
+private:
+  std::vector<void *> _freeConnections;         // Storage of deleted ones
+  std::vector<ClientExchange *> _freeExchanges; // Reset, ready for reuse
+  size_t _maxFreeConnections; // Free entries kept, the rest are freed
+  size_t _maxFreeExchanges;
+  size_t _connections; // Live connections
+  size_t _exchanges;   // Exchanges allocated (in use + free)
+  unsigned long _acquired;
+  unsigned long _reused;
+
+  ConnectionPool(const ConnectionPool &);
+  ConnectionPool &operator=(const ConnectionPool &);
+
+public:
+  explicit ConnectionPool(size_t maxFreeConnections = 4096,
+                          size_t maxFreeExchanges = 256);
+  ~ConnectionPool();
+
+  /** @brief New connection, in recycled storage when possible */
+  ClientConnection *create(int fd, const sockaddr_in &addr,
+                           ConfigSnapshot *config,
+                           const ListenerConfig &listener,
+                           const ConnectionServices &services);
+  /** @brief Destroys a connection from create() (closes its socket) */
+  void destroy(ClientConnection *client);
+
+  /** @brief Reset request state (reused when possible) */
+  ClientExchange *acquireExchange(const ConnectionServices &services);
+  /** @brief Return an exchange left reset by its connection */
+  void releaseExchange(ClientExchange *exchange);
+
+  size_t getConnections() const;
+  size_t getExchangesInUse() const;
+  size_t getFreeExchanges() const;
+  unsigned long getAcquired() const;
+  unsigned long getReused() const;
+};
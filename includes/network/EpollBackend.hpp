@@ -0,0 +1,36 @@
+#pragma once
+
+#include "network/EventBackend.hpp"
+
+#ifdef __linux__
+#define WEBSERV_HAVE_EPOLL 1
+
+#include <sys/epoll.h>
+#include <vector>
+
+/**
+ * @brief Linux epoll backend - O(ready) wakeups, level-triggered
+ */
+class EpollBackend : public EventBackend {
+private:
+  int _epollFd;
+  size_t _count;
+  std::vector<struct epoll_event> _events;
+
+  static unsigned int toEpoll(short events);
+  static short fromEpoll(unsigned int events);
+
+public:
+  EpollBackend();
+  ~EpollBackend();
+
+  bool init();
+  bool add(int fd, short events);
+  bool modify(int fd, short events);
+  void remove(int fd);
+  int wait(int timeoutMs, std::vector<ReadyEvent> &ready);
+  size_t size() const;
+  const char *name() const;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One fd reported ready by the kernel (events use POLL* bit values)
+ */
+struct ReadyEvent {
+  int fd;
+  short events;
+};
+
+/**
+ * @brief Kernel readiness interface (poll, epoll, kqueue, io_uring backends)
+ */
+class EventBackend {
+public:
+  virtual ~EventBackend() {}
+
+  /** @brief Initialize kernel resources (epoll/kqueue fd, ring), false = error */
+  virtual bool init() = 0;
+
+  virtual bool add(int fd, short events) = 0;
+  virtual bool modify(int fd, short events) = 0;
+  virtual void remove(int fd) = 0;
+
+  /** @brief Watches a listening socket: reported POLLIN while connections
+   *         wait for accept() (default: add(fd, POLLIN)) */
+  virtual bool addListener(int fd);
+  /** @brief One connection of a listener, non-blocking and close-on-exec;
+   *         -1 with errno set (EAGAIN: none left) */
+  virtual int accept(int fd, sockaddr_in &addr);
+
+  /** @brief Wait for readiness and fill `ready` (returns count, -1 on error) */
+  virtual int wait(int timeoutMs, std::vector<ReadyEvent> &ready) = 0;
+
+  /** @brief Number of fds currently registered */
+  virtual size_t size() const = 0;
+
+  virtual const char *name() const = 0;
+
+  /** @brief Creates the requested backend ("" = best for this platform) */
+  static EventBackend *create(const std::string &name);
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "network/EventBackend.hpp"
+
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) ||     \
+    defined(__NetBSD__) || defined(__DragonFly__)
+#define WEBSERV_HAVE_KQUEUE 1
+
+#include <sys/event.h>
+#include <sys/types.h>
+#include <vector>
+
+/**
+ * @brief BSD/macOS kqueue backend - read/write filters merged per fd
+ */
+class KqueueBackend : public EventBackend {
+private:
+  int _kqueueFd;
+  size_t _count;
+  std::vector<short> _interestByFd; // fd → registered POLL* mask (0 = absent)
+  std::vector<int> _readySlot;      // fd → index in ready list during wait()
+  std::vector<struct kevent> _events;
+
+  bool applyFilter(int fd, short filter, bool enable);
+
+public:
+  KqueueBackend();
+  ~KqueueBackend();
+
+  bool init();
+  bool add(int fd, short events);
+  bool modify(int fd, short events);
+  void remove(int fd);
+  int wait(int timeoutMs, std::vector<ReadyEvent> &ready);
+  size_t size() const;
+  const char *name() const;
+};
+
+#endif
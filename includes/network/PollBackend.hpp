@@ -0,0 +1,26 @@
+#pragma once
+
+#include "network/EventBackend.hpp"
+#include <poll.h>
+#include <vector>
+
+/**
+ * @brief Portable poll() backend (fallback when epoll/kqueue are missing)
+ */
+class PollBackend : public EventBackend {
+private:
+  std::vector<struct pollfd> _pollFds;
+  std::vector<int> _indexByFd; // fd → position in _pollFds (-1 = absent)
+
+public:
+  PollBackend();
+  ~PollBackend();
+
+  bool init();
+  bool add(int fd, short events);
+  bool modify(int fd, short events);
+  void remove(int fd);
+  int wait(int timeoutMs, std::vector<ReadyEvent> &ready);
+  size_t size() const;
+  const char *name() const;
+};
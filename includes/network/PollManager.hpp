@@ -1,31 +1,43 @@
 #pragma once
 
+#include "network/EventBackend.hpp"
 #include <cstddef>
 #include <poll.h>
+#include <string>
 #include <vector>
 
 /**
- * @brief Manages pollfd vector and poll() system call
+ * @brief Event loop readiness front-end (poll/epoll/kqueue/io_uring, one API)
  */
 class PollManager {
 private:
-  std::vector<struct pollfd> _pollFds;
+  EventBackend *_backend;
+  std::vector<ReadyEvent> _ready;
+
+  PollManager(const PollManager &);
+  PollManager &operator=(const PollManager &);
 
 public:
-  PollManager();
+  PollManager(const std::string &backendName = "");
   ~PollManager();
 
   void addFd(int fd, short events);
+  /** @brief Registers a listening socket (io_uring accepts in the kernel) */
+  void addListener(int fd);
+  /** @brief One pending connection of a ready listener, -1 (errno) if none */
+  int accept(int fd, sockaddr_in &addr);
   void removeFd(int fd);
   void updateEvents(int fd, short events);
-  void updateEventsByIndex(size_t index, short events);
 
-  /** @brief Block until events occur or timeout (returns event count) */
+  /** @brief Block until events occur or timeout (returns ready fd count) */
   int wait(int timeoutMs);
 
-  const std::vector<struct pollfd> &getPollFds() const;
-  short getRevents(size_t index) const;
-  int getFd(size_t index) const;
+  /** @brief Ready list filled by the last wait() call */
+  size_t getReadyCount() const;
+  int getReadyFd(size_t index) const;
+  short getReadyEvents(size_t index) const;
+
   size_t getSize() const;
+  const char *getBackendName() const;
   void clear();
 };
@@ -1,33 +1,69 @@
 #pragma once
 
+#include "config/ServerConfig.hpp"
 #include <cstring>
 #include <errno.h>
 #include <fcntl.h>
 #include <iostream>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <string>
 #include <sys/socket.h>
+#include <sys/types.h>
 #include <unistd.h>
+#include <utility>
 #include <vector>
 
 /**
  * @brief Listening socket wrapper - handles bind, listen, and non-blocking
  * setup
+ *
+ * A socket can also be adopted from the process that exec'd this one
+ * (binary upgrade): the listeners it hands over are listed, as port:fd
+ * pairs, in the INHERIT_ENV environment variable.
  */
 class ServerSocket {
 private:
   int _fd;
   int _port;
+  bool _reusePort;
+  ListenOptions _options;
 
   int setNonBlocking(int fd);
+  void applyBufferSizes();
+  void applyTcpOptions();
 
 public:
-  ServerSocket(int port);
+  ServerSocket(int port, bool reusePort = false,
+               const ListenOptions &options = ListenOptions());
   ~ServerSocket();
 
+  /** @brief Environment variable carrying inherited listeners */
+  static const char *const INHERIT_ENV;
+
   /** @brief Create socket, bind to port, and start listening */
   bool init();
+  /** @brief Take over a listening socket inherited across exec() */
+  bool adopt(int fd);
   int getFd() const;
   int getPort() const;
   void closeSocket();
+
+  /** @brief Reads (and removes) INHERIT_ENV, once at startup */
+  static void loadInherited();
+  /** @brief Inherited listener of port (-1 if none), no longer listed */
+  static int takeInherited(int port);
+  /** @brief Inherited listeners not taken, as (port, fd) */
+  static std::vector<std::pair<int, int> > getInherited();
+  /** @brief Closes the inherited listeners no port took */
+  static void closeInherited();
+  /**
+   * @brief Starts a new copy of the server, handing it listeners
+   * @param argv Command line to exec (argv[0] searched in PATH)
+   * @param listeners (port, fd) pairs, fds stay open in this process
+   * @return Child pid, -1 if fork() failed
+   */
+  static pid_t spawnInheriting(const std::vector<std::string> &argv,
+                               const std::vector<std::pair<int, int> >
+                                   &listeners);
 };
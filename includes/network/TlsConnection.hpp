@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+struct ssl_st;
+class TlsContext;
+
+/**
+ * @brief TLS side of one client connection (non-blocking)
+ *
+ * The handshake advances on each readiness event; reads and writes then
+ * go through OpenSSL, except the writes of a connection whose kernel
+ * encrypts (kTLS), which stay plain writev() / sendfile() on the socket.
+ *
+ * Transfer calls return the bytes moved (> 0), 0 once the peer closed,
+ * AGAIN when the socket is not ready and -1 on error.
+ */
+class TlsConnection {
+public:
+  /** @brief Would block: retry on the next readiness event */
+  static const ssize_t AGAIN = -2;
+
+  TlsConnection(const TlsContext &context, int fd);
+  /** @brief Sends close_notify (best effort) after a clean exchange */
+  ~TlsConnection();
+
+  bool isValid() const;
+  /**
+   * @brief Advances the handshake
+   * @return 1 established, 0 in progress (see wantsWrite()), -1 failed
+   */
+  int handshake();
+  bool isEstablished() const;
+  /** @brief The handshake waits for room in the socket (POLLOUT) */
+  bool wantsWrite() const;
+
+  ssize_t read(char *buffer, size_t length);
+  /** @brief Fills the buffers in order (stops at the first short one) */
+  ssize_t readv(const struct iovec *iov, int count);
+  ssize_t write(const char *data, size_t length);
+  /** @brief Writes the buffers as one or more records (up to 16 KB each) */
+  ssize_t writev(const struct iovec *iov, int count);
+  /** @brief Decrypted (or received) bytes no poll() would report */
+  bool hasPending() const;
+
+  /** @brief The kernel encrypts writes: writev() / sendfile() work as is */
+  bool hasKernelSend() const;
+  /** @brief ALPN selected "h2" */
+  bool isHttp2() const;
+  /** @brief Server block matched by SNI (npos: no SNI name) */
+  size_t getServerIndex() const;
+
+private:
+  ssl_st *_ssl;
+  bool _established;
+  bool _wantWrite; // Last handshake step needed POLLOUT
+  bool _failed;    // Fatal error: no close_notify
+
+  ssize_t result(int ret);
+
+  TlsConnection(const TlsConnection &);
+  TlsConnection &operator=(const TlsConnection &);
+};
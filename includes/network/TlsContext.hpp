@@ -0,0 +1,54 @@
+#pragma once
+
+#include "config/ServerConfig.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct ssl_ctx_st;
+struct ssl_st;
+class VirtualHostTable;
+
+/**
+ * @brief TLS configuration of one "listen ... ssl" port
+ *
+ * One SSL_CTX per server block of the port, each with its certificate.
+ * Handshakes start on the default server's; the SNI name then goes
+ * through the port's VirtualHostTable, the same lookup a Host header
+ * gets, and the handshake switches to the matched block's certificate.
+ */
+class TlsContext {
+public:
+  TlsContext();
+  ~TlsContext();
+
+  /**
+   * @brief Loads the certificate of every block of a port
+   * @throws std::runtime_error naming the file OpenSSL refused
+   */
+  void build(int port, const std::vector<ServerConfig> &servers,
+             const VirtualHostTable &hosts, bool http2);
+  /** @brief New server-side SSL object on fd (NULL on failure) */
+  ssl_st *open(int fd) const;
+  /** @brief Server block chosen by the handshake's SNI name */
+  static size_t getServerIndex(const ssl_st *ssl);
+
+  /** @brief Whether this build links OpenSSL */
+  static bool isAvailable();
+  /** @brief Draws the session ticket keys (before fork: shared by workers) */
+  static void initTicketKeys();
+
+private:
+  std::vector<ssl_ctx_st *> _contexts; // By server index
+  const VirtualHostTable *_hosts;
+  size_t _defaultServer;
+  bool _http2; // ALPN offers "h2"
+
+  static int onServerName(ssl_st *ssl, int *alert, void *arg);
+  static int onAlpn(ssl_st *ssl, const unsigned char **out,
+                    unsigned char *outLength, const unsigned char *in,
+                    unsigned int inLength, void *arg);
+
+  TlsContext(const TlsContext &);
+  TlsContext &operator=(const TlsContext &);
+};
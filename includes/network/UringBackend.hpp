@@ -0,0 +1,63 @@
+#pragma once
+
+#include "network/EventBackend.hpp"
+#include "network/UringRing.hpp"
+
+#ifdef WEBSERV_HAVE_URING
+
+#include <deque>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief Linux io_uring backend - poll requests batched into one syscall
+ *
+ * Readiness is still what the event loop consumes: every registered fd has
+ * one one-shot IORING_OP_POLL_ADD in flight, re-armed after it completes.
+ * Registrations, changes and re-arms are queued in the submission ring and
+ * submitted by the same io_uring_enter() that waits, so a loop round costs
+ * one system call however many fds changed. Listeners have a multishot
+ * IORING_OP_ACCEPT instead: connections arrive already accepted.
+ */
+class UringBackend : public EventBackend {
+private:
+  struct FdState {
+    bool registered;
+    bool armed;          // A poll / accept request is in flight for this fd
+    bool listener;       // Multishot accept instead of a poll
+    short events;        // Registered POLL* mask
+    uint32_t generation; // Tags its completions; bumped on every change
+    int acceptError;     // errno of a failed accept, reported once
+    std::deque<int> accepted; // Connections accepted, not taken yet
+  };
+
+  UringRing _ring;
+  size_t _count;
+  bool _multishotAccept; // Cleared if the kernel refuses it (< 5.19)
+
+  std::vector<FdState> _fds; // Indexed by fd
+  std::vector<int> _rearm;   // fds whose request completed, re-armed in wait()
+  std::vector<int> _listeners; // fds with a multishot accept
+
+  void arm(int fd);
+  void cancel(int fd);
+  FdState &state(int fd);
+  void dropAccepted(FdState &entry);
+  void onAccept(FdState &entry, int fd, const struct io_uring_cqe &cqe);
+
+public:
+  UringBackend();
+  ~UringBackend();
+
+  bool init();
+  bool add(int fd, short events);
+  bool modify(int fd, short events);
+  void remove(int fd);
+  bool addListener(int fd);
+  int accept(int fd, sockaddr_in &addr);
+  int wait(int timeoutMs, std::vector<ReadyEvent> &ready);
+  size_t size() const;
+  const char *name() const;
+};
+
+#endif
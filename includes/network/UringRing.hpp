@@ -0,0 +1,79 @@
+#pragma once
+
+#if defined(__linux__) && defined(WEBSERV_HAVE_IO_URING)
+#define WEBSERV_HAVE_URING 1
+
+#include <cstddef>
+#include <linux/io_uring.h>
+
+/**
+ * @brief One io_uring instance: its two rings mapped, raw system calls
+ *
+ * Shared by UringBackend (readiness, multishot accept) and IoThreadPool
+ * (file lookups): each owns a ring, only used by the event loop thread.
+ * SQE i always sits in slot i of the submission array.
+ */
+class UringRing {
+private:
+  int _fd;
+  unsigned _features;
+
+  void *_sqRing;
+  size_t _sqRingSize;
+  void *_cqRing;
+  size_t _cqRingSize;
+  struct io_uring_sqe *_sqes;
+  size_t _sqesSize;
+
+  unsigned *_sqHead;
+  unsigned *_sqTail;
+  unsigned _sqMask;
+  unsigned _sqEntries;
+  unsigned *_cqHead;
+  unsigned *_cqTail;
+  unsigned _cqMask;
+  struct io_uring_cqe *_cqes;
+  unsigned _sqLocalTail; // Next SQE slot (published with each queued SQE)
+
+  void unmap();
+
+  UringRing(const UringRing &);
+  UringRing &operator=(const UringRing &);
+
+public:
+  UringRing();
+  ~UringRing();
+
+  /**
+   * @brief Creates the ring (false: io_uring unavailable, errno set)
+   * @param entries Submission ring entries (completion ring: cqEntries)
+   * @param singleIssuer Completions processed only inside enter() by the
+   *        creating thread (DEFER_TASKRUN), where the kernel has it
+   */
+  bool init(unsigned entries, unsigned cqEntries, bool singleIssuer);
+  void close();
+  bool isOpen() const;
+  /** @brief IORING_FEAT_* of the kernel */
+  unsigned features() const;
+
+  /** @brief Next free submission entry, zeroed; push() queues it */
+  struct io_uring_sqe *nextSqe();
+  void push();
+  /** @brief SQEs queued and not consumed by the kernel yet */
+  unsigned pending() const;
+  int enter(unsigned toSubmit, unsigned minComplete, unsigned flags,
+            const void *arg, size_t argSize);
+  /** @brief Hands the queued SQEs to the kernel, without waiting */
+  void submit();
+  /** @brief Signal fd on every completion (IORING_REGISTER_EVENTFD) */
+  bool registerEventfd(int fd);
+
+  /** @brief Completions waiting: [cqHead(), cqTail()) */
+  unsigned cqHead() const;
+  unsigned cqTail() const;
+  const struct io_uring_cqe &cqe(unsigned index) const;
+  /** @brief Hands the completion slots up to head back to the kernel */
+  void cqAdvance(unsigned head);
+};
+
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "config/LocationConfig.hpp"
+#include <cstddef>
+#include <string>
+
+class HttpRequest;
+
+/**
+ * @brief One request forwarded to a proxy_pass backend (HTTP/1.1)
+ *
+ * The request head is serialized at once and sent, followed by the body,
+ * as the connection drains. The response is turned into CGI output as it
+ * arrives ("Status:" line, end-to-end headers, decoded body), so the
+ * connection relays it exactly like the output of a script.
+ */
+class ProxyRequest {
+public:
+  ProxyRequest();
+  ~ProxyRequest();
+
+  /**
+   * @brief Serializes a client request for a backend
+   * @note request must stay unchanged until reset() (its body is sent
+   *       from where it is)
+   */
+  void begin(const HttpRequest &request, const LocationConfig &location,
+             const std::string &server, const std::string &clientIp,
+             bool secure);
+  void reset();
+  /** @brief Sends the same request again, on a new connection */
+  void rewind();
+
+  bool isActive() const;
+  bool hasPendingOutput() const;
+  /** @brief Sends the head, then the body; false on a connection error */
+  bool sendPending(int fd);
+  /** @brief Decodes response bytes, appending CGI-style output to out */
+  bool receive(const char *data, size_t length, std::string &out);
+  /** @brief The backend closed: ends a body delimited by EOF */
+  bool receiveEof();
+  /** @brief At least one response byte arrived */
+  bool hasResponse() const;
+  bool isComplete() const;
+  /** @brief Complete, and the backend keeps the connection open */
+  bool isReusable() const;
+
+  /** @brief Longest response header block accepted */
+  static const size_t MAX_HEAD_SIZE = 64 * 1024;
+
+private:
+  /** @brief Position in the response between receive() calls */
+  enum State {
+    HEAD,            // Status line and headers (1xx skipped)
+    BODY_LENGTH,     // _remaining bytes of a Content-Length body
+    BODY_EOF,        // Body until the backend closes
+    CHUNK_SIZE,      // "<hex>[;ext]\r\n"
+    CHUNK_DATA,      // _remaining data bytes of the chunk
+    CHUNK_DATA_CRLF, // The CRLF after the data
+    CHUNK_TRAILER,   // Trailer lines until an empty one
+    DONE
+  };
+
+  std::string _head; // Serialized request head
+  size_t _headSent;
+  const std::string *_body; // Request body (NULL = none)
+  size_t _bodySent;
+  bool _active;
+  bool _headRequest; // HEAD: the response has no body whatever it says
+  bool _received;
+  bool _reusable; // Backend keeps the connection (decided by the head)
+
+  State _state;
+  std::string _input; // Incomplete header block or chunk line
+  size_t _remaining;
+
+  size_t consumeHead(const char *data, size_t length, std::string &out,
+                     bool &error);
+  bool parseHead(const std::string &block, std::string &out);
+  size_t consumeLine(const char *data, size_t length, bool &complete,
+                     bool &error);
+  bool parseChunkLine();
+
+  ProxyRequest(const ProxyRequest &);
+  ProxyRequest &operator=(const ProxyRequest &);
+};
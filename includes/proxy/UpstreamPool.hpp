@@ -0,0 +1,73 @@
+#pragma once
+
+#include "config/LocationConfig.hpp"
+#include "config/ServerConfig.hpp"
+#include <cstddef>
+#include <ctime>
+#include <map>
+#include <string>
+#include <sys/socket.h>
+#include <vector>
+
+/**
+ * @brief Keep-alive connections to the proxy_pass backends of a process
+ *
+ * acquire() picks a backend of the group (round-robin or least_conn),
+ * hands out one of its idle connections or starts a non-blocking
+ * connect(); finish() keeps a connection whose response ended cleanly for
+ * the next request. Backend names are resolved by resolveAll() when the
+ * configuration is loaded, never on the event loop.
+ */
+class UpstreamPool {
+public:
+  UpstreamPool();
+  ~UpstreamPool();
+
+  /** @brief Resolves the backends of every proxy_pass location (blocking:
+   *         configuration load and reload only) */
+  void resolveAll(const std::vector<ServerConfig> &servers);
+  /**
+   * @brief Connection to a backend of group (non-blocking), -1 if none
+   * @param server Receives the chosen "host:port" (for finish())
+   * @param reused Receives whether it is an idle keep-alive connection
+   */
+  int acquire(const ProxyPass &group, std::string &server, bool &reused);
+  /** @brief New connection to server (a reused one just failed), or -1 */
+  int reconnect(const std::string &server);
+  /** @brief Request over: keeps the connection if reusable, else closes */
+  void finish(const ProxyPass &group, const std::string &server, int fd,
+              bool reusable);
+  /** @brief The backend failed: others are preferred for a while */
+  void markFailed(const std::string &server);
+
+  size_t getOpened() const;
+  size_t getReused() const;
+
+private:
+  struct Backend {
+    bool resolved;
+    sockaddr_storage addr;
+    socklen_t addrLength;
+    std::vector<int> idle; // Connected, no request in flight
+    size_t active;         // Requests in flight (least_conn)
+    time_t downUntil;      // Failed: skipped until then
+    Backend();
+  };
+
+  /** @brief Seconds a failed backend is skipped */
+  static const time_t FAIL_TIMEOUT = 10;
+
+  std::map<std::string, Backend> _backends; // By "host:port"
+  std::map<std::string, size_t> _next;      // Round-robin start, by group
+  size_t _opened;
+  size_t _reused;
+
+  size_t pick(const ProxyPass &group, const std::vector<bool> &tried,
+              time_t now);
+  int open(const std::string &server, Backend &backend);
+  static bool resolve(const std::string &server, Backend &backend);
+  static bool isAlive(int fd);
+
+  UpstreamPool(const UpstreamPool &);
+  UpstreamPool &operator=(const UpstreamPool &);
+};
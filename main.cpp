@@ -1,7 +1,14 @@
 #include "../includes/config/ConfigBuilder.hpp"
 #include "../includes/config_parser/parser/UtilsConfigParser.hpp"
+#include "cgi/FastCGISpawner.hpp"
+#include "core/Logger.hpp"
+#include "core/Master.hpp"
+#include "network/TlsContext.hpp"
 #include "core/Server.hpp"
 #include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <sys/time.h>
 
 /**
  * @file main.cpp
@@ -11,19 +18,34 @@
  * It handles:
  * - Command line argument parsing (config file path)
  * - Configuration file parsing and validation
- * - Signal handling for graceful shutdown (SIGINT, SIGTERM)
+ * - Opening the error and access logs (error_log / access_log)
+ * - Signal handling for graceful shutdown (SIGINT, SIGTERM, SIGQUIT),
+ *   configuration reload (SIGHUP) and binary upgrade (SIGUSR2)
  * - Server initialization and main loop execution
  *
  * Usage:
  *   ./webServer              # Uses default config (tests/configs/default.conf)
  *   ./webServer config.conf  # Uses specified config file
+ *   ./webServer -t [config]  # Only checks the config, reports load time
  *
  * Signal handling:
- * - SIGINT (Ctrl+C): Triggers graceful shutdown
- * - SIGTERM (kill): Triggers graceful shutdown
+ * - SIGINT (Ctrl+C), SIGTERM (kill), SIGQUIT: Graceful shutdown - stop
+ *   accepting, finish the responses in flight (worker_shutdown_timeout
+ *   at most), then exit; a second signal exits at once
+ * - SIGHUP: Re-reads the configuration file (see Server::reload())
+ * - SIGUSR2: Binary upgrade - starts the (new) executable with the
+ *   listening sockets; send SIGQUIT to the old process once it is up
+ *     kill -USR2 $OLD && sleep 1 && kill -QUIT $OLD
  *
- * The server shuts down cleanly by setting g_running = false,
- * which breaks the poll() loop and allows proper resource cleanup.
+ * Process model:
+ * - worker_processes 1 (default): this process runs the event loop
+ * - worker_processes N > 1: this process becomes the master and forks N
+ *   workers (see Master), forwarding SIGTERM to them on shutdown and
+ *   SIGHUP on reload
+ *
+ * The server shuts down cleanly by setting g_running = false, which puts
+ * the event loop in drain mode; it returns once the connections are done
+ * and the destructors release the rest.
  */
 
 /**
@@ -43,10 +65,35 @@
 volatile sig_atomic_t g_running = true;
 
 /**
- * @brief Signal handler for SIGINT and SIGTERM
+ * @brief Global flag for an immediate shutdown
+ *
+ * Set by a termination signal received while already draining: the
+ * connections still open are closed without waiting for them.
+ */
+volatile sig_atomic_t g_terminate = false;
+
+/**
+ * @brief Global flag for configuration reload
+ *
+ * Set by the SIGHUP handler; the event loop clears it and reloads the
+ * configuration file between two rounds.
+ */
+volatile sig_atomic_t g_reload = false;
+
+/**
+ * @brief Global flag for a binary upgrade
+ *
+ * Set by the SIGUSR2 handler; the event loop clears it and starts the new
+ * executable on the same listening sockets.
+ */
+volatile sig_atomic_t g_upgrade = false;
+
+/**
+ * @brief Signal handler for SIGINT, SIGTERM and SIGQUIT
  *
  * Called by the OS when the process receives a termination signal.
- * Sets g_running to false to trigger graceful shutdown.
+ * Sets g_running to false to trigger graceful shutdown (drain), or
+ * g_terminate if it already was.
  *
  * What this does NOT do:
  * - Does not call exit()
@@ -62,11 +109,80 @@ void signalHandler(int signum) {
     std::cout << "\n[Signal] SIGINT (Ctrl+C) received" << std::endl;
   else if (signum == SIGTERM)
     std::cout << "\n[Signal] SIGTERM received" << std::endl;
+  else if (signum == SIGQUIT)
+    std::cout << "\n[Signal] SIGQUIT received" << std::endl;
 
+  if (!g_running) {
+    g_terminate = true;
+    std::cout << "[Info] 🛑 Shutting down now" << std::endl;
+    return;
+  }
   g_running = false;
   std::cout << "[Info] 🛑 Shutting down gracefully..." << std::endl;
 }
 
+/**
+ * @brief Signal handler for SIGHUP - only requests a reload
+ *
+ * @param signum Signal number received (SIGHUP=1)
+ */
+void reloadHandler(int signum) {
+  (void)signum;
+  g_reload = true;
+}
+
+/**
+ * @brief Signal handler for SIGUSR2 - only requests a binary upgrade
+ *
+ * @param signum Signal number received (SIGUSR2)
+ */
+void upgradeHandler(int signum) {
+  (void)signum;
+  g_upgrade = true;
+}
+
+/** @brief Wall clock in milliseconds, for the -t report */
+static double nowMs() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/**
+ * @brief -t: loads the configuration like a start would, then exits
+ *
+ * Parsing (with the structural and semantic validation) and building
+ * are timed separately, so a slow config load can be measured without
+ * starting the server:
+ *   webserv: tests/configs/mega_test.conf: syntax is ok
+ *   webserv: 3 server(s), parsed in 0.42 ms, built in 0.31 ms
+ * Nothing is bound and no log file is opened.
+ *
+ * @return 0 if the configuration is valid, 1 otherwise
+ */
+static int testConfig(const std::string &configPath) {
+  try {
+    double start = nowMs();
+    BlockParser root = parseAndValidateConfig(configPath);
+    double parsed = nowMs();
+    ConfigBuilder builder;
+    std::vector<ServerConfig> servConfigsList =
+        builder.buildFromBlockParser(root);
+    builder.buildGlobal(root);
+    double built = nowMs();
+    std::printf("webserv: %s: syntax is ok\n"
+                "webserv: %lu server(s), parsed in %.2f ms, built in %.2f ms\n",
+                configPath.c_str(),
+                static_cast<unsigned long>(servConfigsList.size()),
+                parsed - start, built - parsed);
+  } catch (std::exception &e) {
+    std::cerr << "❌ [Error] Config error: " << e.what() << std::endl;
+    std::cerr << "webserv: " << configPath << ": test failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
 /**
  * @brief Main entry point
  *
@@ -75,8 +191,8 @@ void signalHandler(int signum) {
  * 2. Parse and validate configuration file
  * 3. Build ServerConfig objects from parsed config
  * 4. Register signal handlers for graceful shutdown
- * 5. Initialize server sockets
- * 6. Run main poll() loop until shutdown signal
+ * 5. Initialize server sockets (or fork workers in multi-process mode)
+ * 6. Run main event loop until shutdown signal
  * 7. Clean up resources and exit
  *
  * @param argc Argument count
@@ -84,12 +200,16 @@ void signalHandler(int signum) {
  * @return 0 on success, 1 on error
  */
 int main(int argc, char **argv) {
-  // Step 1: Get config file path
+  // Step 1: Get config file path ("-t": check it and exit)
+  bool testOnly = argc > 1 && std::strcmp(argv[1], "-t") == 0;
+  int pathArg = testOnly ? 2 : 1;
   std::string configPath;
-  if (argc == 1)
+  if (argc <= pathArg)
     configPath = "tests/configs/default.conf";
   else
-    configPath = argv[1];
+    configPath = argv[pathArg];
+  if (testOnly)
+    return testConfig(configPath);
 
   try {
     // Step 2-3: Parse config and build server configurations
@@ -98,13 +218,51 @@ int main(int argc, char **argv) {
     std::vector<ServerConfig> servConfigsList =
         builder.buildFromBlockParser(root);
 
-    std::cout << "[Info] ✅ Configuration loaded: " << servConfigsList.size()
-              << " server(s)" << std::endl;
+    GlobalConfig globalConfig = builder.buildGlobal(root);
+
+    if (!Logger::configure(globalConfig.getErrorLog(),
+                           globalConfig.getErrorLogLevel(),
+                           globalConfig.getAccessLog()) ||
+        !Logger::configureTrace(globalConfig.getRequestTrace())) {
+      std::cerr << "❌ [Error] Cannot open log file" << std::endl;
+      return 1;
+    }
+    LOG_INFO("✅ Configuration loaded: " << servConfigsList.size()
+             << " server(s)");
+
+    // fastcgi_workers: FastCGI interpreters shared by every worker
+    FastCGISpawner fastcgiWorkers;
+    if (!fastcgiWorkers.start(servConfigsList))
+      return 1;
+
+    // A CGI that exits without reading its whole stdin must not kill the
+    // server: write() then fails with EPIPE instead (inherited by workers)
+    signal(SIGPIPE, SIG_IGN);
+
+    // TLS session ticket keys drawn before fork(): a ticket issued by one
+    // worker resumes on any other
+    TlsContext::initTicketKeys();
+
+    // Listeners handed over by the binary this one upgrades (SIGUSR2)
+    ServerSocket::loadInherited();
+
+    // Multi-process mode: master supervises forked workers
+    if (globalConfig.getWorkerProcesses() > 1) {
+      Master master(servConfigsList, globalConfig);
+      master.setConfigPath(configPath);
+      master.setCommandLine(argc, argv);
+      return master.run();
+    }
 
     // Step 4: Create server and register signal handlers
-    Server server(servConfigsList);
+    Server server(servConfigsList, globalConfig);
+    server.setConfigPath(configPath);
+    server.setCommandLine(argc, argv);
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
+    signal(SIGQUIT, signalHandler);
+    signal(SIGHUP, reloadHandler);
+    signal(SIGUSR2, upgradeHandler);
 
     // Step 5: Initialize listening sockets
     if (!server.init()) {
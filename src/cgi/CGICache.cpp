@@ -0,0 +1,407 @@
+#include "../../includes/cgi/CGICache.hpp"
+#include "../../includes/cgi/CGIOutputParser.hpp"
+#include "../../includes/cgi/CGIUtils.hpp"
+#include "../../includes/core/Logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @file CGICache.cpp
+ * @brief Micro-cache of script and backend responses (cgi_cache)
+ *
+ * A CGI endpoint rendering the same page for every visitor forks once per
+ * request. With cgi_cache on, a GET answered by a script, a FastCGI server
+ * or a proxy_pass backend is kept for as long as the response allows:
+ *
+ *   Cache-Control: s-maxage / max-age, else Expires, else cgi_cache_valid
+ *   (no-store, no-cache, private, Set-Cookie or an unkeyed Vary: never)
+ *
+ * Key: method, scheme, Host, request target and the request headers named
+ * by cgi_cache_key (see ClientConnection::lookupCGICache()).
+ *
+ * Cache lock: the first miss on a key runs the origin (FILL); requests for
+ * the same key arriving meanwhile are parked (WAIT) and run again once it
+ * is stored or given up (takeWoken()), so a cold key costs one fork, not
+ * one per waiting client:
+ *
+ *   miss ── lock free? ── yes → FILL ── store() / release()
+ *                      └─ no  → WAIT ─────────┘ wakes the waiters
+ *
+ * A response that turns out not to be cacheable marks its key "pass" for
+ * PASS_TIME seconds: those requests go to the origin in parallel instead
+ * of queuing behind each other.
+ *
+ * Tiers:
+ * - memory: LRU, output bytes of all entries below cgi_cache_size
+ * - disk (cgi_cache_path): every stored entry is also written to
+ *   <dir>/<hash of key>, so it survives a restart and is shared by the
+ *   workers; a memory miss reads it back. Expired files are removed when
+ *   found.
+ *
+ * @note Memory tier and locks are per process, like the rest of the
+ *       event loop state
+ */
+
+CGICache::CGICache() : _budget(0), _used(0), _hits(0), _misses(0) {}
+
+CGICache::~CGICache() {}
+
+/**
+ * @brief Sets the memory budget and the disk directory, drops entries
+ *
+ * @param budgetBytes Max bytes held in memory (0 disables the cache)
+ * @param diskPath Directory of the disk tier, "" for none
+ */
+void CGICache::configure(size_t budgetBytes, const std::string &diskPath) {
+  _entries.clear();
+  _lru.clear();
+  _passes.clear();
+  _used = 0;
+  _budget = budgetBytes;
+  _diskPath = diskPath;
+  if (!_diskPath.empty() && access(_diskPath.c_str(), W_OK | X_OK) != 0) {
+    LOG_WARN("cgi_cache_path " << _diskPath << ": " << strerror(errno)
+             << ", caching in memory only");
+    _diskPath.clear();
+  }
+}
+
+bool CGICache::isEnabled() const { return _budget > 0; }
+
+size_t CGICache::getMaxEntrySize() const { return _budget / 4; }
+
+void CGICache::erase(EntryMap::iterator it) {
+  _used -= it->second.output.size();
+  _lru.erase(it->second.lruPos);
+  _entries.erase(it);
+}
+
+/**
+ * @brief Adds an entry to the memory tier, evicting LRU entries to fit
+ *
+ * @return The entry, NULL if it is larger than getMaxEntrySize()
+ */
+CGICache::Entry *CGICache::insert(const std::string &key,
+                                  const std::string &output, time_t stored,
+                                  time_t expires) {
+  if (!isEnabled() || output.size() > getMaxEntrySize())
+    return NULL;
+  EntryMap::iterator old = _entries.find(key);
+  if (old != _entries.end())
+    erase(old);
+  while (_used + output.size() > _budget && !_lru.empty())
+    erase(_entries.find(_lru.back()));
+
+  Entry &entry = _entries[key];
+  entry.output = output;
+  entry.stored = stored;
+  entry.expires = expires;
+  _lru.push_front(key);
+  entry.lruPos = _lru.begin();
+  _used += output.size();
+  return &entry;
+}
+
+/**
+ * @brief Looks up key, taking its lock on a miss when allowed
+ *
+ * @param key Cache key
+ * @param fill The request may fill the key (GET; HEAD only reads)
+ * @param output Receives the cached CGI output on HIT
+ * @param age Receives its age in seconds on HIT
+ * @return HIT, FILL, WAIT or BYPASS
+ */
+CGICache::Lookup CGICache::lookup(const std::string &key, bool fill,
+                                  const std::string *&output, time_t &age) {
+  time_t now = time(NULL);
+  Entry *entry = NULL;
+  EntryMap::iterator it = _entries.find(key);
+  if (it != _entries.end()) {
+    if (it->second.expires > now)
+      entry = &it->second;
+    else
+      erase(it);
+  }
+  if (!entry && !_diskPath.empty())
+    entry = loadFromDisk(key, now);
+  if (entry) {
+    ++_hits;
+    _lru.splice(_lru.begin(), _lru, entry->lruPos);
+    output = &entry->output;
+    age = now - entry->stored;
+    return HIT;
+  }
+
+  ++_misses;
+  std::map<std::string, time_t>::iterator pass = _passes.find(key);
+  if (pass != _passes.end()) {
+    if (pass->second > now)
+      return BYPASS;
+    _passes.erase(pass);
+  }
+  if (!fill)
+    return BYPASS;
+  if (_locks.find(key) != _locks.end())
+    return WAIT;
+  _locks[key]; // Taken: this request fills the key
+  return FILL;
+}
+
+/**
+ * @brief Stores the response of a fill and releases the key
+ *
+ * @param key Key locked by lookup() (FILL)
+ * @param output Complete CGI output
+ * @param ttl Seconds it stays fresh (see lifetime()), 0 = not cacheable
+ */
+void CGICache::store(const std::string &key, const std::string &output,
+                     long ttl) {
+  time_t now = time(NULL);
+  Entry *entry = ttl > 0 ? insert(key, output, now, now + ttl) : NULL;
+  if (!entry) {
+    release(key, true);
+    return;
+  }
+  if (!_diskPath.empty())
+    saveToDisk(key, *entry);
+  wake(key);
+}
+
+/**
+ * @brief Releases the lock of key without storing anything
+ *
+ * @param key Key locked by lookup() (FILL)
+ * @param uncacheable The origin answered, but not with something to keep
+ *        (the key is passed for PASS_TIME); false when the fill failed,
+ *        so a waiter retries it
+ */
+void CGICache::release(const std::string &key, bool uncacheable) {
+  if (uncacheable) {
+    time_t now = time(NULL);
+    if (_passes.size() >= 4096) { // Forget the expired ones first
+      for (std::map<std::string, time_t>::iterator it = _passes.begin();
+           it != _passes.end();) {
+        if (it->second <= now)
+          _passes.erase(it++);
+        else
+          ++it;
+      }
+    }
+    _passes[key] = now + PASS_TIME;
+  }
+  wake(key);
+}
+
+/**
+ * @brief Unlocks key and queues its waiters for takeWoken()
+ */
+void CGICache::wake(const std::string &key) {
+  LockMap::iterator it = _locks.find(key);
+  if (it == _locks.end())
+    return;
+  _woken.insert(_woken.end(), it->second.begin(), it->second.end());
+  _locks.erase(it);
+}
+
+/**
+ * @brief Parks a request until the fill of key ends
+ *
+ * @param key Key lookup() answered WAIT for
+ * @param client Connection resumed through takeWoken()
+ */
+void CGICache::wait(const std::string &key, ClientConnection *client) {
+  LockMap::iterator it = _locks.find(key);
+  if (it != _locks.end())
+    it->second.push_back(client);
+  else
+    _woken.push_back(client); // Released meanwhile: run again at once
+}
+
+/**
+ * @brief Forgets a waiter (lock wait timed out, connection closed)
+ */
+void CGICache::cancel(const std::string &key, ClientConnection *client) {
+  LockMap::iterator it = _locks.find(key);
+  if (it != _locks.end())
+    it->second.erase(
+        std::remove(it->second.begin(), it->second.end(), client),
+        it->second.end());
+  _woken.erase(std::remove(_woken.begin(), _woken.end(), client),
+               _woken.end());
+}
+
+/**
+ * @brief Hands over the waiters released since the last call
+ *
+ * @param out Cleared, then filled with the connections to run again
+ */
+void CGICache::takeWoken(std::vector<ClientConnection *> &out) {
+  out.clear();
+  out.swap(_woken);
+}
+
+bool CGICache::hasWoken() const { return !_woken.empty(); }
+
+/**
+ * @brief Decides how long the output of a fill may be served from cache
+ *
+ * Only complete responses with a heuristically cacheable status (RFC 9111
+ * §4.2.2: 200, 203, 300, 301, 308, 404, 410) are kept, never one setting
+ * a cookie or varying on a request header that is not part of the key.
+ *
+ * @param output Complete CGI output
+ * @param defaultValid cgi_cache_valid: lifetime when the script gives none
+ * @param keyHeaders cgi_cache_key: request headers the key includes
+ * @param now Current time (Expires)
+ * @return Seconds, 0 if the output must not be cached
+ */
+long CGICache::lifetime(const std::string &output, long defaultValid,
+                        const std::vector<std::string> &keyHeaders,
+                        time_t now) {
+  if (CGIOutputParser::findBodyOffset(output) == std::string::npos)
+    return 0;
+  CGIOutputParser parser;
+  parser.parse(output);
+  int status = parser.getStatusCode();
+  if (status != 200 && status != 203 && status != 300 && status != 301 &&
+      status != 308 && status != 404 && status != 410)
+    return 0;
+  if (!parser.getSetCookies().empty())
+    return 0;
+
+  std::string vary = toUpperCase(parser.getHeader("Vary"));
+  size_t start = 0;
+  while (start < vary.size()) {
+    size_t end = vary.find(',', start);
+    if (end == std::string::npos)
+      end = vary.size();
+    std::string name = vary.substr(start, end - start);
+    size_t first = name.find_first_not_of(" \t");
+    size_t last = name.find_last_not_of(" \t");
+    if (first != std::string::npos) {
+      name = name.substr(first, last - first + 1);
+      bool keyed = false;
+      for (size_t i = 0; i < keyHeaders.size() && !keyed; ++i)
+        keyed = toUpperCase(keyHeaders[i]) == name;
+      if (!keyed)
+        return 0; // "*" or a header the key does not tell apart
+    }
+    start = end + 1;
+  }
+
+  long freshness = parser.getFreshness(now);
+  return freshness < 0 ? defaultValid : freshness;
+}
+
+/**
+ * @brief File of key in the disk tier (64-bit FNV-1a of the key, in hex)
+ */
+std::string CGICache::diskFile(const std::string &key) const {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < key.size(); ++i) {
+    hash ^= static_cast<unsigned char>(key[i]);
+    hash *= 1099511628211ULL;
+  }
+  char name[17];
+  std::snprintf(name, sizeof(name), "%08lx%08lx",
+                static_cast<unsigned long>(hash >> 32),
+                static_cast<unsigned long>(hash & 0xffffffffUL));
+  return _diskPath + "/" + name;
+}
+
+/**
+ * @brief Reads key back from the disk tier into memory
+ *
+ * File layout: "<stored> <expires> <key length>\n", the key (checked, the
+ * file name is only a hash), then the CGI output.
+ *
+ * @return Memory entry, NULL if absent, expired (the file is removed) or
+ *         unreadable
+ */
+CGICache::Entry *CGICache::loadFromDisk(const std::string &key, time_t now) {
+  std::string path = diskFile(key);
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return NULL;
+  struct stat st;
+  std::string data;
+  if (fstat(fd, &st) == 0 && st.st_size > 0 &&
+      static_cast<size_t>(st.st_size) <= getMaxEntrySize() + key.size() + 64) {
+    data.resize(static_cast<size_t>(st.st_size));
+    size_t done = 0;
+    while (done < data.size()) {
+      ssize_t n = read(fd, &data[done], data.size() - done);
+      if (n <= 0)
+        break;
+      done += static_cast<size_t>(n);
+    }
+    data.resize(done);
+  }
+  close(fd);
+
+  size_t newline = data.find('\n');
+  if (newline == std::string::npos)
+    return NULL;
+  std::istringstream header(data.substr(0, newline));
+  long stored = 0;
+  long expires = 0;
+  size_t keyLength = 0;
+  if (!(header >> stored >> expires >> keyLength) ||
+      data.size() < newline + 1 + keyLength ||
+      data.compare(newline + 1, keyLength, key) != 0)
+    return NULL; // Another key with the same hash, or a torn file
+  if (expires <= now) {
+    unlink(path.c_str());
+    return NULL;
+  }
+  return insert(key, data.substr(newline + 1 + keyLength), stored, expires);
+}
+
+/**
+ * @brief Writes an entry to the disk tier
+ *
+ * Written to a temporary file renamed over the final one, so a reader in
+ * another worker never sees half of it.
+ */
+void CGICache::saveToDisk(const std::string &key, const Entry &entry) const {
+  std::string path = diskFile(key);
+  std::ostringstream tmp;
+  tmp << path << "." << getpid() << ".tmp";
+  std::ostringstream header;
+  header << static_cast<long>(entry.stored) << " "
+         << static_cast<long>(entry.expires) << " " << key.size() << "\n";
+  std::string data = header.str() + key + entry.output;
+
+  int fd = open(tmp.str().c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                0600);
+  if (fd == -1) {
+    LOG_DEBUG("cgi_cache: cannot write " << tmp.str() << ": "
+              << strerror(errno));
+    return;
+  }
+  size_t done = 0;
+  while (done < data.size()) {
+    ssize_t n = write(fd, data.data() + done, data.size() - done);
+    if (n <= 0)
+      break;
+    done += static_cast<size_t>(n);
+  }
+  close(fd);
+  if (done != data.size() || rename(tmp.str().c_str(), path.c_str()) != 0)
+    unlink(tmp.str().c_str());
+}
+
+size_t CGICache::size() const { return _entries.size(); }
+
+size_t CGICache::getUsedBytes() const { return _used; }
+
+unsigned long CGICache::getHits() const { return _hits; }
+
+unsigned long CGICache::getMisses() const { return _misses; }
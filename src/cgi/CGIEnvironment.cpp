@@ -1,5 +1,8 @@
 #include "../../includes/cgi/CGIEnvironment.hpp"
 #include "../../includes/cgi/CGIUtils.hpp"
+#include <cstdio>
+#include <cstring>
+#include <strings.h>
 
 /**
  * @file CGIEnvironment.cpp
@@ -19,9 +22,15 @@
  *
  * Memory management:
  * The class converts std::map to char** for execve() system call
- * compatibility. Memory is manually allocated with new/delete (C++98 style,
- * not malloc/free) and must be explicitly freed after execve() to prevent
- * leaks.
+ * compatibility. The array and its strings are ONE new[] block (C++98
+ * style, not malloc/free) that must be freed with freeEnvArray() after
+ * execve() to prevent leaks.
+ *
+ * Fast path (buildEnvArray()): the variables that never change for a
+ * location are rendered once at config load (buildTemplate(), stored in
+ * LocationConfig); each request only adds its own variables and headers,
+ * written straight from the request buffer into the same single block, with
+ * no map and no per-variable string.
  *
  * Key design decisions:
  * - Uses std::map for easy access and extension
@@ -150,14 +159,170 @@ void CGIEnvironment::prepare(const HttpRequest &request,
   _envVars["SCRIPT_NAME"] = scriptName;
   _envVars["SCRIPT_FILENAME"] = scriptPath;
 
-  // Manual header lookup since HttpRequest doesn't have getHeader(key)
-  std::map<std::string, std::string> headers = request.getHeaders();
-  if (headers.count("Content-Type")) {
-    _envVars["CONTENT_TYPE"] = headers["Content-Type"];
-  }
+  size_t contentTypeLength;
+  const char *contentType =
+      request.getHeaderValue("Content-Type", contentTypeLength);
+  if (contentType)
+    _envVars["CONTENT_TYPE"].assign(contentType, contentTypeLength);
   _envVars["CONTENT_LENGTH"] = intToString(request.getBody().size());
 }
 
+/**
+ * @brief Renders the variables that are the same for every request of a
+ *        location
+ *
+ * Result: "GATEWAY_INTERFACE=CGI/1.1\0SERVER_SOFTWARE=webserv/1.0\0...\0",
+ * each entry NUL-terminated, copied as is by buildEnvArray().
+ *
+ * @param serverPort listen port of the location's server
+ */
+std::string CGIEnvironment::buildTemplate(int serverPort) {
+  static const char CONSTANTS[] = "GATEWAY_INTERFACE=CGI/1.1\0"
+                                  "SERVER_SOFTWARE=webserv/1.0\0"
+                                  "SERVER_PROTOCOL=HTTP/1.1\0"
+                                  "REDIRECT_STATUS=200";
+  std::string envTemplate(CONSTANTS, sizeof(CONSTANTS)); // Last NUL too
+  envTemplate += "SERVER_PORT=" + intToString(serverPort);
+  envTemplate += '\0';
+  return envTemplate;
+}
+
+/**
+ * @brief One per-request NAME=value entry of buildEnvArray()
+ */
+struct EnvEntry {
+  const char *name;
+  size_t nameLength;
+  const char *value;
+  size_t valueLength;
+  bool header; // Name written as HTTP_<NAME>, '-' → '_'
+};
+
+static void addEntry(EnvEntry *entries, size_t &count, const char *name,
+                     const char *value, size_t valueLength) {
+  EnvEntry &entry = entries[count++];
+  entry.name = name;
+  entry.nameLength = std::strlen(name);
+  entry.value = value;
+  entry.valueLength = valueLength;
+  entry.header = false;
+}
+
+/**
+ * @brief Builds the envp of a CGI request in a single allocation
+ *
+ * Same variables as prepare() + toEnvArray(), without building any map or
+ * string per variable:
+ *
+ *   ┌─────────────────────────┬──────────────────┬────────────────────┐
+ *   │ char *env[n + 1] (NULL) │ template (copied │ request variables  │
+ *   │ → each string below     │ in one memcpy)   │ + HTTP_* headers   │
+ *   └─────────────────────────┴──────────────────┴────────────────────┘
+ *
+ * Header names are converted while being copied (User-Agent →
+ * HTTP_USER_AGENT). A header sent twice keeps its last value, as the map
+ * did.
+ *
+ * @param envTemplate buildTemplate() of the location
+ * @return NULL-terminated array, freed with freeEnvArray()
+ */
+char **CGIEnvironment::buildEnvArray(const std::string &envTemplate,
+                                     const HttpRequest &request,
+                                     const std::string &scriptPath,
+                                     const std::string &scriptName,
+                                     const std::string &serverName) {
+  EnvEntry entries[8 + HttpRequest::MAX_HEADERS];
+  size_t count = 0;
+  char contentLength[24];
+  std::sprintf(contentLength, "%lu",
+               static_cast<unsigned long>(request.getBody().size()));
+
+  addEntry(entries, count, "SERVER_NAME", serverName.data(),
+           serverName.size());
+  addEntry(entries, count, "REQUEST_METHOD", request.getMethod().data(),
+           request.getMethod().size());
+  addEntry(entries, count, "QUERY_STRING", request.getQuery().data(),
+           request.getQuery().size());
+  addEntry(entries, count, "SCRIPT_NAME", scriptName.data(),
+           scriptName.size());
+  addEntry(entries, count, "SCRIPT_FILENAME", scriptPath.data(),
+           scriptPath.size());
+  addEntry(entries, count, "CONTENT_LENGTH", contentLength,
+           std::strlen(contentLength));
+  size_t contentTypeLength;
+  const char *contentType =
+      request.getHeaderValue("Content-Type", contentTypeLength);
+  if (contentType)
+    addEntry(entries, count, "CONTENT_TYPE", contentType, contentTypeLength);
+
+  size_t headerCount = request.getHeaderCount();
+  for (size_t i = 0; i < headerCount; ++i) {
+    EnvEntry &entry = entries[count];
+    request.getHeaderField(i, entry.name, entry.nameLength, entry.value,
+                           entry.valueLength);
+    bool repeated = false;
+    for (size_t j = i + 1; j < headerCount && !repeated; ++j) {
+      const char *name;
+      const char *value;
+      size_t nameLength;
+      size_t valueLength;
+      request.getHeaderField(j, name, nameLength, value, valueLength);
+      repeated = nameLength == entry.nameLength &&
+                 strncasecmp(name, entry.name, nameLength) == 0;
+    }
+    if (repeated)
+      continue;
+    entry.header = true;
+    ++count;
+  }
+
+  // Size: pointers, then the template, then "NAME=value\0" per entry
+  size_t templateCount = 0;
+  for (size_t i = 0; i < envTemplate.size(); ++i)
+    if (envTemplate[i] == '\0')
+      ++templateCount;
+  size_t pointers = templateCount + count + 1;
+  size_t size = pointers * sizeof(char *) + envTemplate.size();
+  for (size_t i = 0; i < count; ++i)
+    size += (entries[i].header ? 5 : 0) + entries[i].nameLength + 1 +
+            entries[i].valueLength + 1;
+
+  char *block = new char[size];
+  char **env = reinterpret_cast<char **>(block);
+  char *out = block + pointers * sizeof(char *);
+  size_t index = 0;
+
+  std::memcpy(out, envTemplate.data(), envTemplate.size());
+  for (size_t i = 0; i < envTemplate.size(); ++i) {
+    if (i == 0 || out[i - 1] == '\0')
+      env[index++] = out + i;
+  }
+  out += envTemplate.size();
+
+  for (size_t i = 0; i < count; ++i) {
+    const EnvEntry &entry = entries[i];
+    env[index++] = out;
+    if (entry.header) {
+      std::memcpy(out, "HTTP_", 5);
+      out += 5;
+      for (size_t k = 0; k < entry.nameLength; ++k) {
+        char c = entry.name[k];
+        *out++ = c == '-' ? '_' : static_cast<char>(std::toupper(
+                                      static_cast<unsigned char>(c)));
+      }
+    } else {
+      std::memcpy(out, entry.name, entry.nameLength);
+      out += entry.nameLength;
+    }
+    *out++ = '=';
+    std::memcpy(out, entry.value, entry.valueLength);
+    out += entry.valueLength;
+    *out++ = '\0';
+  }
+  env[index] = NULL;
+  return env;
+}
+
 /**
  * @brief Converts environment variables map to char** array for execve()
  *
@@ -165,12 +330,12 @@ void CGIEnvironment::prepare(const HttpRequest &request,
  * in "KEY=VALUE" format, as required by the POSIX execve() system call.
  *
  * Memory allocation process:
- * 1. Count variables → count
- * 2. Allocate array of pointers: new char*[count + 1]
+ * 1. Count variables and the bytes of their "KEY=VALUE\0" strings
+ * 2. Allocate one block: array of count + 1 pointers, then the strings
  * 3. For each variable:
  *    a. Create string "KEY=VALUE"
- *    b. Allocate char array: new char[size + 1]
- *    c. Copy string to char array with stringToCString()
+ *    b. Copy it into the block with stringToCString()
+ *    c. Point the next array element at it
  * 4. Set last element to NULL (execve requirement)
  *
  * Resulting format:
@@ -184,8 +349,7 @@ void CGIEnvironment::prepare(const HttpRequest &request,
  *   };
  *
  * Memory management:
- * - Each string is individually allocated with new char[]
- * - Array of pointers allocated with new char*[]
+ * - Pointers and strings share a single new char[] block
  * - Caller MUST call freeEnvArray() after execve() to prevent leaks
  * - Memory persists even if CGIEnvironment object is destroyed
  *
@@ -205,16 +369,21 @@ void CGIEnvironment::prepare(const HttpRequest &request,
  */
 char **CGIEnvironment::toEnvArray() const {
   size_t count = _envVars.size();
-  size_t index = 0;
-
-  char **env = new char *[count + 1];
-
+  size_t size = (count + 1) * sizeof(char *);
   std::map<std::string, std::string>::const_iterator it;
+  for (it = _envVars.begin(); it != _envVars.end(); ++it)
+    size += it->first.size() + 1 + it->second.size() + 1;
+
+  // Pointer array first, strings right after it: one block
+  char *block = new char[size];
+  char **env = reinterpret_cast<char **>(block);
+  char *out = block + (count + 1) * sizeof(char *);
+  size_t index = 0;
   for (it = _envVars.begin(); it != _envVars.end(); ++it) {
     std::string envLine = it->first + "=" + it->second;
-    int envLineLength = envLine.size();
-    env[index] = new char[envLineLength + 1];
-    stringToCString(envLine, env[index]);
+    env[index] = out;
+    stringToCString(envLine, out);
+    out += envLine.size() + 1;
     index++;
   }
   env[count] = NULL;
@@ -222,24 +391,17 @@ char **CGIEnvironment::toEnvArray() const {
 }
 
 /**
- * @brief Frees memory allocated by toEnvArray()
+ * @brief Frees memory allocated by toEnvArray() or buildEnvArray()
  *
  * Deallocates the char** array created by toEnvArray() to prevent memory leaks.
  * Must be called after execve() in the parent process, since the child process
  * will have its own copy of the environment.
  *
- * Deallocation process:
- * 1. Iterate through array until NULL terminator
- * 2. Delete each individual string: delete[] env[i]
- * 3. Delete array of pointers: delete[] env
- *
- * Memory structure being freed:
- *   env[0] → "REQUEST_METHOD=GET\0"      ← delete[] this
- *   env[1] → "SERVER_PORT=8080\0"        ← delete[] this
- *   env[2] → "QUERY_STRING=...\0"        ← delete[] this
- *   ...
- *   env[n] → NULL                        ← stop iteration
- *   env (array itself)                   ← delete[] this
+ * Memory structure being freed (a single block):
+ *   env[0] ─┐  env[1] ─┐ ... env[n] = NULL
+ *           ↓          ↓
+ *   "REQUEST_METHOD=GET\0SERVER_PORT=8080\0..."
+ *   delete[] the block: the strings go with it
  *
  * Usage pattern:
  *   char **envp = env.toEnvArray();
@@ -256,13 +418,10 @@ char **CGIEnvironment::toEnvArray() const {
  *
  * @warning Must be called exactly once for each toEnvArray() call
  * @warning Do NOT call on stack-allocated or other memory not from toEnvArray()
- * @note Uses delete[] (matching new[] allocation in toEnvArray)
+ * @note Uses delete[] (matching the new char[] block of toEnvArray)
  */
-void CGIEnvironment::freeEnvArray(char **env) const {
-  for (int i = 0; env[i]; i++) {
-    delete[] env[i];
-  }
-  delete[] env;
+void CGIEnvironment::freeEnvArray(char **env) {
+  delete[] reinterpret_cast<char *>(env);
 }
 
 /**
@@ -295,6 +454,18 @@ std::string CGIEnvironment::getVar(const std::string &key) const {
     return "";
 }
 
+/**
+ * @brief Returns every prepared variable
+ *
+ * FastCGI sends the environment as name-value pairs instead of an envp
+ * array (see FastCGIRequest::begin()).
+ *
+ * @return Variables by name
+ */
+const std::map<std::string, std::string> &CGIEnvironment::getVars() const {
+  return _envVars;
+}
+
 /**
  * @brief Prints all environment variables to stdout (debug helper)
  *
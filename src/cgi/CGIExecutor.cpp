@@ -1,5 +1,16 @@
 #include "../../includes/cgi/CGIExecutor.hpp"
 #include "../../includes/cgi/CGIUtils.hpp"
+#include "../../includes/core/Logger.hpp"
+#include <csignal>
+
+// posix_spawn() with a chdir file action (glibc >= 2.29: vfork-style
+// clone, no copy of the server's page tables); elsewhere fork() + execve()
+#if defined(__GLIBC__) && defined(__GLIBC_PREREQ)
+#if __GLIBC_PREREQ(2, 29)
+#include <spawn.h>
+#define WEBSERV_HAVE_SPAWN_CHDIR 1
+#endif
+#endif
 
 /**
  * @file CGIExecutor.cpp
@@ -30,8 +41,15 @@
  * 2. fork() - Split into parent/child processes
  * 3. Child: dup2() redirects stdin/stdout, execve() becomes CGI script
  * 4. Parent: writes POST data, reads script output, waits for child termination
+ *    (async: the event loop feeds stdin and reads stdout, see executeAsync())
  * 5. Return captured output to caller
  *
+ * Launching (spawnChild()): where available, posix_spawn() does steps 2-3
+ * with file actions (dup2, chdir) in a child sharing the parent's memory
+ * until execve(), so its cost does not grow with the server's heap (file
+ * and response caches). Every other server fd is close-on-exec, so client
+ * sockets and cached files never leak into the script.
+ *
  * Key design decisions:
  * - chdir() to script directory: Required for scripts using relative paths
  * - 4KB buffer: POSIX page size (optimal for read/write operations)
@@ -96,13 +114,92 @@ CGIExecutor::~CGIExecutor() {}
  */
 void CGIExecutor::setupPipes() {
   if (pipe(_pipeIn) == -1) {
-    std::cerr << "❌ [Error] pipe() failed for stdin: " << strerror(errno)
-              << std::endl;
+    LOG_ERROR("pipe() failed for stdin: " << strerror(errno));
   }
   if (pipe(_pipeOut) == -1) {
-    std::cerr << "❌ [Error] pipe() failed for stdout: " << strerror(errno)
-              << std::endl;
+    LOG_ERROR("pipe() failed for stdout: " << strerror(errno));
   }
+  // Only the dup2() copies (stdin/stdout) survive execve(); a script
+  // spawned meanwhile for another client gets none of these ends
+  fcntl(_pipeIn[0], F_SETFD, FD_CLOEXEC);
+  fcntl(_pipeIn[1], F_SETFD, FD_CLOEXEC);
+  fcntl(_pipeOut[0], F_SETFD, FD_CLOEXEC);
+  fcntl(_pipeOut[1], F_SETFD, FD_CLOEXEC);
+}
+
+/**
+ * @brief Splits a script path into its directory and file name
+ *
+ * The child runs in the script's directory with the bare file name as
+ * argv[1]; a path without a directory part is used as is.
+ */
+static void splitScriptPath(const std::string &scriptPath,
+                            std::string &scriptDir, std::string &scriptName) {
+  scriptDir.clear();
+  scriptName = scriptPath;
+  size_t lastSlash = scriptPath.find_last_of('/');
+  if (lastSlash != std::string::npos && lastSlash > 0) {
+    scriptDir = scriptPath.substr(0, lastSlash);
+    scriptName = scriptPath.substr(lastSlash + 1);
+  }
+}
+
+/**
+ * @brief Starts the interpreter on the pipes created by setupPipes()
+ *
+ * posix_spawn() version: the child gets the pipes as stdin/stdout, runs in
+ * the script directory and has SIGPIPE back to its default (the server
+ * ignores it), exactly what executeChild() does after fork(). An
+ * interpreter that cannot be executed is reported here (-1) instead of
+ * through a child exiting with status 1.
+ *
+ * @return Child pid, or -1 on failure (pipes left to the caller)
+ */
+pid_t CGIExecutor::spawnChild(const std::string &executable,
+                              const std::string &scriptPath, char **envp) {
+#ifdef WEBSERV_HAVE_SPAWN_CHDIR
+  std::string scriptDir;
+  std::string scriptName;
+  splitScriptPath(scriptPath, scriptDir, scriptName);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, _pipeIn[0], STDIN_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, _pipeOut[1], STDOUT_FILENO);
+  if (!scriptDir.empty())
+    posix_spawn_file_actions_addchdir_np(&actions, scriptDir.c_str());
+
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  sigset_t defaults;
+  sigemptyset(&defaults);
+  sigaddset(&defaults, SIGPIPE);
+  posix_spawnattr_setsigdefault(&attr, &defaults);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+
+  char *argv[3];
+  argv[0] = const_cast<char *>(executable.c_str());
+  argv[1] = const_cast<char *>(scriptName.c_str());
+  argv[2] = NULL;
+  pid_t pid;
+  int error = posix_spawn(&pid, argv[0], &actions, &attr, argv, envp);
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
+  if (error != 0) {
+    LOG_ERROR("posix_spawn() failed: " << strerror(error) << " (executable: "
+              << executable << ", script: " << scriptPath << ")");
+    return -1;
+  }
+  return pid;
+#else
+  Logger::flush(); // The child must not inherit unwritten log lines
+  pid_t pid = fork();
+  if (pid == 0)
+    executeChild(executable, scriptPath, envp); // Never returns
+  if (pid < 0)
+    LOG_ERROR("fork() failed: " << strerror(errno));
+  return pid;
+#endif
 }
 
 /**
@@ -170,16 +267,16 @@ std::string CGIExecutor::execute(const std::string &executable,
                                  const std::string &requestBody) {
   setupPipes();
 
-  _childPid = fork();
+  _childPid = spawnChild(executable, scriptPath, envp);
 
   if (_childPid < 0) {
-    std::cerr << "❌ [Error] fork() failed: " << strerror(errno) << std::endl;
+    close(_pipeIn[0]);
+    close(_pipeIn[1]);
+    close(_pipeOut[0]);
+    close(_pipeOut[1]);
     throw std::runtime_error("Failed to fork CGI process");
   }
 
-  if (_childPid == 0)
-    executeChild(executable, scriptPath,
-                 envp); // Never returns (execve or exit)
   // Parent process continues here
   close(_pipeIn[0]);  // Parent doesn't read from stdin pipe
   close(_pipeOut[1]); // Parent doesn't write to stdout pipe
@@ -250,6 +347,9 @@ std::string CGIExecutor::execute(const std::string &executable,
  */
 void CGIExecutor::executeChild(const std::string &executable,
                                const std::string &scriptPath, char **envp) {
+  // The server ignores SIGPIPE; the script gets the default back
+  signal(SIGPIPE, SIG_DFL);
+
   // Redirect stdin/stdout to pipes
   dup2(_pipeIn[0], STDIN_FILENO);   // Read POST data from parent
   dup2(_pipeOut[1], STDOUT_FILENO); // Write output to parent
@@ -261,16 +361,11 @@ void CGIExecutor::executeChild(const std::string &executable,
 
   // Change to script directory (subject requirement: CGI should run in correct
   // directory for relative path file access)
-  std::string scriptName = scriptPath; // Default: use full path
-  size_t lastSlash = scriptPath.find_last_of('/');
-  if (lastSlash != std::string::npos) {
-    std::string scriptDir = scriptPath.substr(0, lastSlash);
-    if (!scriptDir.empty()) {
-      chdir(scriptDir.c_str());
-      // After chdir, use only the filename (not full path)
-      scriptName = scriptPath.substr(lastSlash + 1);
-    }
-  }
+  std::string scriptDir;
+  std::string scriptName; // After chdir, only the filename (not full path)
+  splitScriptPath(scriptPath, scriptDir, scriptName);
+  if (!scriptDir.empty())
+    chdir(scriptDir.c_str());
 
   // Prepare argv for execve
   char **argv = new char *[3];
@@ -282,6 +377,8 @@ void CGIExecutor::executeChild(const std::string &executable,
   // Replace process image with CGI interpreter
   execve(argv[0], argv, envp);
   // Only reached if execve fails
+  // Plain stderr: in the child stdout is the CGI pipe, and the logger's
+  // batch belongs to the parent
   std::cerr << "❌ [Error] execve() failed: " << strerror(errno)
             << " (executable: " << argv[0] << ", script: " << argv[1] << ")"
             << std::endl;
@@ -321,8 +418,7 @@ void CGIExecutor::executeChild(const std::string &executable,
 void CGIExecutor::writeToChild(const std::string &data) {
   if (!data.empty()) {
     if (write(_pipeIn[1], data.c_str(), data.size()) == -1) {
-      std::cerr << "❌ [Error] write() to child stdin failed: "
-                << strerror(errno) << std::endl;
+      LOG_ERROR("write() to child stdin failed: " << strerror(errno));
     }
   }
 }
@@ -378,8 +474,7 @@ std::string CGIExecutor::readChildOutput() {
     ssize_t bytesRead = read(_pipeOut[0], buffer, 4096);
 
     if (bytesRead < 0) {
-      std::cerr << "❌ [Error] read() from child stdout failed: "
-                << strerror(errno) << std::endl;
+      LOG_ERROR("read() from child stdout failed: " << strerror(errno));
       break;
     }
     if (bytesRead == 0)
@@ -414,33 +509,38 @@ void CGIExecutor::setNonBlocking(int fd) {
  * This method is designed for non-blocking CGI execution:
  * 1. Creates pipes
  * 2. Forks child process
- * 3. Writes request body to child (blocking, but typically fast)
- * 4. Makes output pipe non-blocking
- * 5. Returns pipe FD and PID to caller
- *
- * The caller is responsible for:
+ * 3. Makes both parent ends non-blocking (stdin is closed at once when
+ *    there is no body: the child sees EOF)
+ * 4. Returns the pipe FDs and PID to caller
+ *
+ * The body is not written here: a POST larger than the pipe buffer (64 KB
+ * on Linux) would block the event loop until the script reads it, or
+ * forever if the script writes its output first. The caller is
+ * responsible for:
+ * - Writing the body to stdinFd as POLLOUT allows, then closing it
  * - Adding the pipe FD to poll()
  * - Reading output when POLLIN is signaled
  * - Calling waitpid(WNOHANG) to reap zombie process
  *
- * @return CGIAsyncResult with pipe FD and child PID
+ * @param hasBody false → stdin gets EOF right away (stdinFd = -1)
+ * @return CGIAsyncResult with pipe FDs and child PID
  */
 CGIAsyncResult CGIExecutor::executeAsync(const std::string &executable,
                                          const std::string &scriptPath,
-                                         char **envp,
-                                         const std::string &requestBody) {
+                                         char **envp, bool hasBody) {
   CGIAsyncResult result;
   result.pipeFd = -1;
+  result.stdinFd = -1;
   result.childPid = 0;
   result.success = false;
 
   try {
     setupPipes();
 
-    _childPid = fork();
+    _childPid = spawnChild(executable, scriptPath, envp);
 
     if (_childPid < 0) {
-      // Fork failed
+      // Spawn failed
       close(_pipeIn[0]);
       close(_pipeIn[1]);
       close(_pipeOut[0]);
@@ -448,19 +548,17 @@ CGIAsyncResult CGIExecutor::executeAsync(const std::string &executable,
       return result;
     }
 
-    if (_childPid == 0) {
-      // Child process
-      executeChild(executable, scriptPath, envp);
-      // Never returns
-    }
-
     // Parent process
     close(_pipeIn[0]);  // Parent doesn't read from stdin pipe
     close(_pipeOut[1]); // Parent doesn't write to stdout pipe
 
-    // Write request body to child (this is blocking but typically fast)
-    writeToChild(requestBody);
-    close(_pipeIn[1]); // Signal EOF to child
+    // The body is fed by the event loop; without one, EOF at once
+    if (hasBody) {
+      setNonBlocking(_pipeIn[1]);
+      result.stdinFd = _pipeIn[1];
+    } else {
+      close(_pipeIn[1]);
+    }
 
     // Make output pipe non-blocking for poll() integration
     setNonBlocking(_pipeOut[0]);
@@ -469,11 +567,11 @@ CGIAsyncResult CGIExecutor::executeAsync(const std::string &executable,
     result.childPid = _childPid;
     result.success = true;
 
-    std::cout << "[CGI] Async fork OK (pid: " << _childPid
-              << ", pipe: " << _pipeOut[0] << ")\n";
+    LOG_DEBUG("[CGI] Async spawn OK (pid: " << _childPid << ", pipe: "
+              << _pipeOut[0] << ")");
 
   } catch (const std::exception &e) {
-    std::cerr << "[CGI] Async execute error: " << e.what() << "\n";
+    LOG_ERROR("CGI: async execute error: " << e.what());
     result.success = false;
   }
 
@@ -1,5 +1,6 @@
 #include "../../includes/cgi/CGIHandler.hpp"
 #include "../../includes/cgi/CGIUtils.hpp"
+#include "../../includes/core/Logger.hpp"
 
 /**
  * @file CGIHandler.cpp
@@ -243,8 +244,7 @@ HttpResponse CGIHandler::handle(const HttpRequest &request,
       CGIDetector::isCGIRequest(request.getPath(), location.getCgiExts());
 
   if (!isCGI) {
-    std::cerr << "❌ [Error] Request path is not a CGI script: "
-              << request.getPath() << std::endl;
+    LOG_WARN("Request path is not a CGI script: " << request.getPath());
     HttpResponse response;
     response.setErrorResponse(404);
     return response;
@@ -258,8 +258,8 @@ HttpResponse CGIHandler::handle(const HttpRequest &request,
 
   // Security check: No interpreter configured OR script doesn't exist on disk
   if (executable.empty() || access(scriptPath.c_str(), F_OK) != 0) {
-    std::cerr << "❌ [Error] CGI executable not found or script not accessible: "
-              << scriptPath << std::endl;
+    LOG_ERROR("CGI executable not found or script not accessible: "
+              << scriptPath);
     HttpResponse response;
     response.setErrorResponse(404); // Resource not executable or doesn't exist
     return response;
@@ -291,7 +291,7 @@ HttpResponse CGIHandler::handle(const HttpRequest &request,
         HttpResponse::getHttpStatusMessage(parser.getStatusCode()));
 
     // 2. Body
-    response.setBody(parser.getBody());
+    response.setBody(output.substr(parser.getBodyOffset()));
 
     // 3. Headers del CGI
     std::map<std::string, std::string> cgiHeaders = parser.getHeaders();
@@ -313,7 +313,7 @@ HttpResponse CGIHandler::handle(const HttpRequest &request,
   } catch (std::exception &e) {
     // Exception during CGI execution (fork/execve failed, script error, etc.)
     // Return 500 Internal Server Error and ensure memory cleanup
-    std::cerr << "❌ [Error] CGI execution failed: " << e.what() << std::endl;
+    LOG_ERROR("CGI execution failed: " << e.what());
     env.freeEnvArray(envp);
     HttpResponse response;
     response.setErrorResponse(500);
@@ -325,7 +325,8 @@ HttpResponse CGIHandler::handle(const HttpRequest &request,
  * @brief Async version of handle - forks CGI but doesn't wait
  *
  * Same as handle() but uses executeAsync() instead of execute().
- * Returns pipe FD and PID so caller can add to poll() and read later.
+ * Returns pipe FD and PID so caller can add to poll() and read later,
+ * and the stdin pipe the caller feeds the request body through.
  */
 CGIAsyncResult CGIHandler::handleAsync(const HttpRequest &request,
                                        const LocationConfig &location,
@@ -333,6 +334,7 @@ CGIAsyncResult CGIHandler::handleAsync(const HttpRequest &request,
                                        int serverPort) {
   CGIAsyncResult failResult;
   failResult.pipeFd = -1;
+  failResult.stdinFd = -1;
   failResult.childPid = 0;
   failResult.success = false;
 
@@ -352,40 +354,73 @@ CGIAsyncResult CGIHandler::handleAsync(const HttpRequest &request,
 
   // Security check: No interpreter configured OR script doesn't exist on disk
   if (executable.empty() || access(scriptPath.c_str(), F_OK) != 0) {
-    std::cerr << "❌ [Error] CGI script not found: " << scriptPath << std::endl;
+    LOG_WARN("CGI script not found: " << scriptPath);
     return failResult; // Caller should return 404
   }
 
-  // PHASE 4: Build environment
-  CGIEnvironment env;
+  // PHASE 4: Build environment (one allocation: the fixed variables come
+  // from the location, rendered at config load)
   // scriptName es el path URL del script (ej: /cgi-bin/test.py)
-  std::string scriptName = request.getPath();
-  env.prepare(request, scriptPath, scriptName, serverName, serverPort);
-  char **envp = env.toEnvArray();
+  const std::string &scriptName = request.getPath();
+  std::string builtTemplate; // Location not from ConfigBuilder
+  if (location.getCgiEnvTemplate().empty())
+    builtTemplate = CGIEnvironment::buildTemplate(serverPort);
+  const std::string &envTemplate = builtTemplate.empty()
+                                       ? location.getCgiEnvTemplate()
+                                       : builtTemplate;
+  char **envp = CGIEnvironment::buildEnvArray(envTemplate, request, scriptPath,
+                                              scriptName, serverName);
 
   // PHASE 5: Execute async (fork but don't wait)
   CGIExecutor executor;
-  CGIAsyncResult result =
-      executor.executeAsync(executable, scriptPath, envp, request.getBody());
+  CGIAsyncResult result = executor.executeAsync(executable, scriptPath, envp,
+                                                !request.getBody().empty());
 
   // Free environment array immediately - child has its own copy
-  env.freeEnvArray(envp);
+  CGIEnvironment::freeEnvArray(envp);
 
   return result;
 }
 
+/**
+ * @brief Builds the CGI environment of a request for a FastCGI server
+ *
+ * Same variables as a CGI process gets (RFC 3875), sent as FastCGI
+ * params. SCRIPT_FILENAME is root + path, as seen by this server; the
+ * FastCGI server opens the script itself.
+ *
+ * @param request Parsed HTTP request
+ * @param location Matched location (root)
+ * @param serverName SERVER_NAME value
+ * @param serverPort SERVER_PORT value
+ * @return Params by name
+ */
+std::map<std::string, std::string>
+CGIHandler::fastcgiParams(const HttpRequest &request,
+                          const LocationConfig &location,
+                          const std::string &serverName, int serverPort) {
+  std::string scriptPath =
+      CGIDetector::resolveScriptPath(request.getPath(), location.getRoot());
+  CGIEnvironment env;
+  env.prepare(request, scriptPath, request.getPath(), serverName, serverPort);
+  return env.getVars();
+}
+
 /**
  * @brief Build HTTP response from completed CGI output buffer
  *
  * Used after readCGIOutput() has collected all the CGI output.
- * Parses headers and body, builds proper HttpResponse.
+ * Parses headers and body, builds proper HttpResponse. The body is not
+ * copied: the response points into cgiOutput (see setBodyView()).
+ *
+ * @param cgiOutput Complete CGI output; must outlive the response send
  */
 HttpResponse
 CGIHandler::buildResponseFromCGIOutput(const std::string &cgiOutput) {
   HttpResponse response;
 
   if (cgiOutput.empty()) {
-    std::cerr << "❌ [Error] CGI output is empty" << std::endl;
+    LOG_ERROR("CGI output is empty");
     response.setErrorResponse(500);
     return response;
   }
@@ -393,25 +428,68 @@ CGIHandler::buildResponseFromCGIOutput(const std::string &cgiOutput) {
   CGIOutputParser parser;
   parser.parse(cgiOutput);
 
-  // 1. Status (use "OK" as default message since parser doesn't provide it)
-  response.setStatus(parser.getStatusCode(), "OK");
+  // 1. Status (reason phrase from the code, the parser keeps only the code)
+  int code = parser.getStatusCode();
+  response.setStatus(code, HttpResponse::getHttpStatusMessage(code));
+
+  // 2. Body (sent from cgiOutput itself)
+  size_t bodyOffset = parser.getBodyOffset();
+  response.setBodyView(cgiOutput.data() + bodyOffset,
+                       cgiOutput.size() - bodyOffset);
 
-  // 2. Body
-  response.setBody(parser.getBody());
+  // 3-4. Headers and cookies
+  copyHeaders(parser, response);
 
-  // 3. Headers
+  return response;
+}
+
+/**
+ * @brief Copies the script's headers and cookies into the response
+ *
+ * Status is not copied (it sets the status line). Content-Length is
+ * stored under its canonical name whatever case the script used, so the
+ * response never gets a second, automatic one.
+ */
+void CGIHandler::copyHeaders(const CGIOutputParser &parser,
+                             HttpResponse &response) {
   std::map<std::string, std::string> cgiHeaders = parser.getHeaders();
   for (std::map<std::string, std::string>::iterator it = cgiHeaders.begin();
        it != cgiHeaders.end(); ++it) {
-    if (toUpperCase(it->first) != "STATUS")
+    std::string name = toUpperCase(it->first);
+    if (name == "CONTENT-LENGTH")
+      response.setHeader("Content-Length", it->second);
+    else if (name != "STATUS")
       response.setHeader(it->first, it->second);
   }
 
-  // 4. Cookies
   std::vector<std::string> cgiCookies = parser.getSetCookies();
   for (size_t i = 0; i < cgiCookies.size(); ++i) {
     response.setCookie(cgiCookies[i]);
   }
+}
 
-  return response;
+/**
+ * @brief Builds the status line and headers of a CGI output still running
+ *
+ * Used to start sending a response as soon as the script has printed its
+ * header block; the body is relayed separately as it arrives.
+ *
+ * @param cgiOutput Output received so far
+ * @param response Receives status and headers (no body)
+ * @param bodyOffset Receives where the body starts in cgiOutput
+ * @return false while the header block is incomplete
+ */
+bool CGIHandler::buildResponseHead(const std::string &cgiOutput,
+                                   HttpResponse &response,
+                                   size_t &bodyOffset) {
+  if (CGIOutputParser::findBodyOffset(cgiOutput) == std::string::npos)
+    return false;
+
+  CGIOutputParser parser;
+  parser.parse(cgiOutput);
+  int code = parser.getStatusCode();
+  response.setStatus(code, HttpResponse::getHttpStatusMessage(code));
+  copyHeaders(parser, response);
+  bodyOffset = parser.getBodyOffset();
+  return true;
 }
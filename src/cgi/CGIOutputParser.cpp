@@ -1,5 +1,8 @@
 #include "../../includes/cgi/CGIOutputParser.hpp"
 #include "../../includes/cgi/CGIUtils.hpp"
+#include "../../includes/http/ByteScanner.hpp"
+#include "../../includes/http/HttpRequest.hpp"
+#include <cstdlib>
 
 /**
  * @file CGIOutputParser.cpp
@@ -46,21 +49,20 @@
  * Initializes a CGIOutputParser with default values:
  * - _statusCode = 0 (will be set to 200 or parsed value in parse())
  * - _headers = {} (empty map, filled by parse())
- * - _body = "" (empty string, filled by parse())
+ * - _bodyOffset = 0 (set by parse())
  *
  * The object is not usable until parse() is called with raw CGI output.
  *
  * @note _statusCode is initialized to 0 as sentinel value (invalid HTTP
  * code)
  */
-CGIOutputParser::CGIOutputParser() { _statusCode = 0; }
+CGIOutputParser::CGIOutputParser() : _bodyOffset(0) { _statusCode = 0; }
 
 /**
  * @brief Destructor
  *
  * Cleans up the CGIOutputParser object. No explicit cleanup needed because:
  * - _headers is std::map (automatically destroyed)
- * - _body is std::string (automatically destroyed)
  * - _statusCode is primitive int (no cleanup needed)
  *
  * @note Destructor is empty due to RAII principle (automatic resource
@@ -68,6 +70,29 @@ CGIOutputParser::CGIOutputParser() { _statusCode = 0; }
  */
 CGIOutputParser::~CGIOutputParser() {}
 
+/**
+ * @brief Finds where the body starts, once the header block has ended
+ *
+ * Lets a caller receiving the output piece by piece wait for the whole
+ * header block before calling parse() (see
+ * ClientConnection::relayCGIOutput()).
+ *
+ * @param rawOutput Output received so far
+ * @return Offset after the blank line ("\r\n\r\n", or "\n\n"), npos while
+ *         the header block is incomplete
+ */
+size_t CGIOutputParser::findBodyOffset(const std::string &rawOutput)
+{
+  size_t pos = ByteScanner::findHeaderEnd(rawOutput.data(), rawOutput.size());
+  if (pos != ByteScanner::npos)
+    return pos + 4;
+  // Fallback to \n\n if \r\n\r\n is not found
+  pos = rawOutput.find("\n\n");
+  if (pos != std::string::npos)
+    return pos + 2;
+  return std::string::npos;
+}
+
 /**
  * @brief Parses raw CGI output into headers and body
  *
@@ -121,7 +146,7 @@ CGIOutputParser::~CGIOutputParser() {}
  *       "Content-Type": "text/html",
  *       "Status": "404 Not Found"
  *     }
- *     _body = "<html><body>Not Found</body></html>"
+ *     _bodyOffset = 50 (start of "<html><body>Not Found</body></html>")
  *
  * @param rawOutput Complete output from CGI script (headers + body)
  *
@@ -133,22 +158,13 @@ CGIOutputParser::~CGIOutputParser() {}
 void CGIOutputParser::parse(const std::string &rawOutput)
 {
   // STEP 1: Split headers from body using double CRLF separator
-  size_t pos = rawOutput.find("\r\n\r\n");
-  if (pos == std::string::npos)
-  {
-    // Fallback to \n\n if \r\n\r\n is not found
-    pos = rawOutput.find("\n\n");
-    if (pos == std::string::npos)
-    {
-      _body = rawOutput;
-      return;
-    }
-    _body = rawOutput.substr(pos + 2);
-  }
-  else
+  _bodyOffset = findBodyOffset(rawOutput);
+  if (_bodyOffset == std::string::npos)
   {
-    _body = rawOutput.substr(pos + 4);
+    _bodyOffset = 0;
+    return;
   }
+  size_t pos = _bodyOffset - (rawOutput[_bodyOffset - 2] == '\r' ? 4 : 2);
   std::string headersSection = rawOutput.substr(0, pos);
   // STEP 2: Parse headers line by line
   std::istringstream stream(headersSection);
@@ -277,23 +293,97 @@ std::vector<std::string> CGIOutputParser::getSetCookies() const
 }
 
 /**
- * @brief Returns the parsed body content
- *
- * Provides access to the complete body section of the CGI output. This is
- * everything after the "\r\n\r\n" separator.
+ * @brief Returns where the body starts in the parsed output
  *
- * Body content can be:
- * - HTML page: "<html><body>...</body></html>"
- * - JSON response: '{"status":"ok","data":[...]}'
- * - Plain text: "Hello World"
- * - Binary data: Image/PDF bytes (though less common in CGI)
+ * The body is everything after the "\r\n\r\n" separator (or the whole
+ * output when there is none). It is not copied out: the caller sends it
+ * straight from the output buffer, which for a large CGI response avoids
+ * holding the body twice.
  *
- * @return Complete body content as string
+ * @return Offset of the first body byte in the string given to parse()
  *
- * @note Returns copy of _body (not reference) - caller can modify safely
  * @note Body may be empty if script outputs only headers
  */
-std::string CGIOutputParser::getBody() const
+size_t CGIOutputParser::getBodyOffset() const
 {
-  return _body;
-}
\ No newline at end of file
+  return _bodyOffset;
+}
+std::string CGIOutputParser::getHeader(const std::string &name) const
+{
+  std::string wanted = toUpperCase(name);
+  for (std::map<std::string, std::string>::const_iterator it =
+           _headers.begin();
+       it != _headers.end(); ++it)
+  {
+    if (toUpperCase(it->first) == wanted)
+      return it->second;
+  }
+  return "";
+}
+
+/**
+ * @brief Delta-seconds of a max-age / s-maxage directive (quotes allowed)
+ *
+ * @return Seconds, 0 if the value is not a number (treated as stale)
+ */
+static long parseDeltaSeconds(std::string value)
+{
+  if (value.size() >= 2 && value[0] == '"' && value[value.size() - 1] == '"')
+    value = value.substr(1, value.size() - 2);
+  if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos)
+    return 0;
+  return std::strtol(value.c_str(), NULL, 10);
+}
+
+/**
+ * @brief How long a shared cache may reuse this output (RFC 9111 §4.2.1)
+ *
+ * Precedence:
+ *   Cache-Control: no-store / no-cache / private   → 0 (never stored)
+ *   Cache-Control: s-maxage=N                      → N
+ *   Cache-Control: max-age=N                       → N
+ *   Expires: <HTTP-date>                           → date - now (an
+ *                                                    invalid date is stale)
+ *   none of them                                   → -1 (cgi_cache_valid)
+ *
+ * @param now Current time (Expires)
+ * @return Seconds, 0 if the output must not be cached, -1 if unspecified
+ */
+long CGIOutputParser::getFreshness(time_t now) const
+{
+  std::string control = toUpperCase(getHeader("Cache-Control"));
+  long maxAge = -1;
+  long sharedMaxAge = -1;
+  size_t start = 0;
+  while (start < control.size())
+  {
+    size_t end = control.find(',', start);
+    if (end == std::string::npos)
+      end = control.size();
+    std::string directive = control.substr(start, end - start);
+    size_t first = directive.find_first_not_of(" \t");
+    size_t last = directive.find_last_not_of(" \t");
+    directive = first == std::string::npos
+                    ? ""
+                    : directive.substr(first, last - first + 1);
+    if (directive.compare(0, 8, "NO-STORE") == 0 ||
+        directive.compare(0, 8, "NO-CACHE") == 0 ||
+        directive.compare(0, 7, "PRIVATE") == 0)
+      return 0;
+    if (directive.compare(0, 9, "S-MAXAGE=") == 0)
+      sharedMaxAge = parseDeltaSeconds(directive.substr(9));
+    else if (directive.compare(0, 8, "MAX-AGE=") == 0)
+      maxAge = parseDeltaSeconds(directive.substr(8));
+    start = end + 1;
+  }
+  if (sharedMaxAge >= 0)
+    return sharedMaxAge;
+  if (maxAge >= 0)
+    return maxAge;
+
+  std::string expires = getHeader("Expires");
+  if (expires.empty())
+    return -1;
+  time_t when = HttpRequest::parseHttpDate(expires);
+  return when > now ? static_cast<long>(when - now) : 0;
+}
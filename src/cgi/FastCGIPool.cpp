@@ -0,0 +1,170 @@
+#include "../../includes/cgi/FastCGIPool.hpp"
+#include "../../includes/core/Logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * @file FastCGIPool.cpp
+ * @brief Reused connections to FastCGI servers (fastcgi_pass)
+ *
+ * Opening a connection per request would add a connect() round trip and
+ * a new php-fpm accept to every script run. Requests are sent with
+ * FCGI_KEEP_CONN, and a connection whose request ended with END_REQUEST
+ * goes back here:
+ *
+ *   acquire(addr) ── idle connection? ── yes → reuse it
+ *                                     └─ no  → socket() + connect()
+ *   release(addr, fd) → idle list (at most MAX_IDLE per server)
+ *
+ * Idle connections are not watched by the event loop; a server that
+ * closed one is noticed when it is taken again (recv(MSG_PEEK) sees EOF)
+ * and the next idle or a new connection is used instead.
+ *
+ * Addresses are resolved on first use and cached per fastcgi_pass value:
+ *   "127.0.0.1:9000", "php:9000", "[::1]:9000", "unix:/run/php-fpm.sock"
+ *
+ * @note One pool per process (owned by Server), not shared with workers
+ */
+
+FastCGIPool::Backend::Backend() : resolved(false), addrLength(0) {
+  std::memset(&addr, 0, sizeof(addr));
+}
+
+FastCGIPool::FastCGIPool() : _opened(0), _reused(0) {}
+
+/**
+ * @brief Destructor - closes every idle connection
+ */
+FastCGIPool::~FastCGIPool() {
+  for (std::map<std::string, Backend>::iterator it = _backends.begin();
+       it != _backends.end(); ++it) {
+    for (size_t i = 0; i < it->second.idle.size(); ++i)
+      close(it->second.idle[i]);
+  }
+}
+
+/**
+ * @brief Resolves a fastcgi_pass value into a socket address
+ *
+ * @param address "host:port", "[v6]:port" or "unix:/path"
+ * @param backend Receives the address
+ * @return false if the name does not resolve
+ */
+bool FastCGIPool::resolve(const std::string &address, Backend &backend) {
+  if (address.compare(0, 5, "unix:") == 0) {
+    std::string path = address.substr(5);
+    sockaddr_un un;
+    std::memset(&un, 0, sizeof(un));
+    if (path.size() >= sizeof(un.sun_path))
+      return false;
+    un.sun_family = AF_UNIX;
+    std::memcpy(un.sun_path, path.c_str(), path.size() + 1);
+    std::memcpy(&backend.addr, &un, sizeof(un));
+    backend.addrLength = sizeof(un);
+    return true;
+  }
+
+  size_t colon = address.rfind(':');
+  if (colon == std::string::npos)
+    return false;
+  std::string host = address.substr(0, colon);
+  std::string port = address.substr(colon + 1);
+  if (host.size() > 2 && host[0] == '[' && host[host.size() - 1] == ']')
+    host = host.substr(1, host.size() - 2);
+
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *result = NULL;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0 ||
+      !result)
+    return false;
+  std::memcpy(&backend.addr, result->ai_addr, result->ai_addrlen);
+  backend.addrLength = result->ai_addrlen;
+  freeaddrinfo(result);
+  return true;
+}
+
+/**
+ * @brief Whether an idle connection is still open on the server side
+ *
+ * Nothing is expected on an idle connection: readable means EOF (or a
+ * stray byte, which would corrupt the next response), so it is dropped.
+ */
+bool FastCGIPool::isAlive(int fd) {
+  char byte;
+  ssize_t received = recv(fd, &byte, 1, MSG_PEEK);
+  return received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+/**
+ * @brief Returns a connection to a FastCGI server
+ *
+ * @param address fastcgi_pass value
+ * @return Non-blocking socket (possibly still connecting), -1 if the
+ *         address does not resolve or the connection failed at once
+ */
+int FastCGIPool::acquire(const std::string &address) {
+  Backend &backend = _backends[address];
+
+  while (!backend.idle.empty()) {
+    int fd = backend.idle.back();
+    backend.idle.pop_back();
+    if (isAlive(fd)) {
+      ++_reused;
+      return fd;
+    }
+    close(fd); // Closed by the server while idle
+  }
+
+  if (!backend.resolved) {
+    if (!resolve(address, backend)) {
+      LOG_ERROR("fastcgi_pass: cannot resolve " << address);
+      return -1;
+    }
+    backend.resolved = true;
+  }
+
+  int fd = socket(backend.addr.ss_family, SOCK_STREAM, 0);
+  if (fd == -1) {
+    LOG_ERROR("fastcgi_pass: socket() failed: " << strerror(errno));
+    return -1;
+  }
+  fcntl(fd, F_SETFD, FD_CLOEXEC); // Not inherited by CGI children
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1 ||
+      (connect(fd, reinterpret_cast<sockaddr *>(&backend.addr),
+               backend.addrLength) == -1 &&
+       errno != EINPROGRESS)) {
+    LOG_ERROR("fastcgi_pass: cannot connect to " << address << ": "
+              << strerror(errno));
+    close(fd);
+    return -1;
+  }
+  ++_opened;
+  return fd;
+}
+
+/**
+ * @brief Keeps a connection after a completed request
+ *
+ * @param address fastcgi_pass value it was acquired for
+ * @param fd Connection with no request in flight
+ */
+void FastCGIPool::release(const std::string &address, int fd) {
+  Backend &backend = _backends[address];
+  if (backend.idle.size() >= MAX_IDLE) {
+    close(fd);
+    return;
+  }
+  backend.idle.push_back(fd);
+}
+
+size_t FastCGIPool::getOpened() const { return _opened; }
+
+size_t FastCGIPool::getReused() const { return _reused; }
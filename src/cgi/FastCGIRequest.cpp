@@ -0,0 +1,223 @@
+#include "../../includes/cgi/FastCGIRequest.hpp"
+#include "../../includes/core/Logger.hpp"
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+/**
+ * @file FastCGIRequest.cpp
+ * @brief FastCGI 1.0 responder protocol, client side
+ *
+ * A CGI process costs a fork() of the server and the start-up of the
+ * interpreter on every request. With `fastcgi_pass` the script runs in a
+ * long-lived FastCGI server (php-fpm, ...) instead, and this class speaks
+ * the protocol on a connection taken from FastCGIPool.
+ *
+ * Records (8-byte header + content + padding to a multiple of 8):
+ *   version=1 | type | requestId (2) | contentLength (2) | padding | 0
+ *
+ * Request (all encoded by begin(), sent by sendPending()):
+ *   BEGIN_REQUEST  role=RESPONDER, flags=KEEP_CONN
+ *   PARAMS ...     CGI environment as name-value pairs, then empty PARAMS
+ *   STDIN  ...     request body, then empty STDIN
+ *
+ * Response (decoded by receive()):
+ *   STDOUT ...     CGI output (headers + body), appended to the caller's
+ *                  buffer and parsed like the output of a CGI process
+ *   STDERR ...     logged as warnings
+ *   END_REQUEST    done; the connection can carry the next request
+ *
+ * One request at a time per connection (request id 1): php-fpm and most
+ * servers do not multiplex (FCGI_MPXS_CONNS = 0), so concurrency comes
+ * from the number of pooled connections.
+ */
+
+static const unsigned char FCGI_VERSION_1 = 1;
+static const unsigned char FCGI_BEGIN_REQUEST = 1;
+static const unsigned char FCGI_END_REQUEST = 3;
+static const unsigned char FCGI_PARAMS = 4;
+static const unsigned char FCGI_STDIN = 5;
+static const unsigned char FCGI_STDOUT = 6;
+static const unsigned char FCGI_STDERR = 7;
+static const unsigned char FCGI_RESPONDER = 1;
+static const unsigned char FCGI_KEEP_CONN = 1;
+static const unsigned char FCGI_REQUEST_COMPLETE = 0;
+static const size_t FCGI_HEADER_LEN = 8;
+static const size_t FCGI_MAX_CONTENT = 65535;
+
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL; // A closed backend → EPIPE
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+FastCGIRequest::FastCGIRequest()
+    : _outputSent(0), _active(false), _complete(false) {}
+
+FastCGIRequest::~FastCGIRequest() {}
+
+/**
+ * @brief Appends records of one type, split at the 64 KB content limit
+ *
+ * @param out Destination
+ * @param type Record type
+ * @param data Content (length 0 = the empty record closing a stream)
+ * @param length Content length
+ */
+void FastCGIRequest::appendRecord(std::string &out, unsigned char type,
+                                  const char *data, size_t length) {
+  size_t offset = 0;
+  do {
+    size_t chunk = length - offset;
+    if (chunk > FCGI_MAX_CONTENT)
+      chunk = FCGI_MAX_CONTENT;
+    size_t padding = (8 - chunk % 8) % 8;
+    char header[FCGI_HEADER_LEN] = {
+        static_cast<char>(FCGI_VERSION_1),
+        static_cast<char>(type),
+        0,
+        1, // Request id 1
+        static_cast<char>((chunk >> 8) & 0xFF),
+        static_cast<char>(chunk & 0xFF),
+        static_cast<char>(padding),
+        0};
+    out.append(header, FCGI_HEADER_LEN);
+    out.append(data + offset, chunk);
+    out.append(padding, '\0');
+    offset += chunk;
+  } while (offset < length);
+}
+
+/**
+ * @brief Appends a name-value pair length (1 byte, or 4 with the top bit)
+ */
+void FastCGIRequest::appendLength(std::string &out, size_t length) {
+  if (length < 128) {
+    out += static_cast<char>(length);
+    return;
+  }
+  out += static_cast<char>(((length >> 24) & 0x7F) | 0x80);
+  out += static_cast<char>((length >> 16) & 0xFF);
+  out += static_cast<char>((length >> 8) & 0xFF);
+  out += static_cast<char>(length & 0xFF);
+}
+
+/**
+ * @brief Encodes a whole request, ready for sendPending()
+ *
+ * @param params CGI environment (SCRIPT_FILENAME, REQUEST_METHOD, ...)
+ * @param body Request body, sent as FCGI_STDIN
+ */
+void FastCGIRequest::begin(const std::map<std::string, std::string> &params,
+                           const std::string &body) {
+  reset();
+  _active = true;
+
+  const char beginBody[8] = {0, static_cast<char>(FCGI_RESPONDER),
+                             static_cast<char>(FCGI_KEEP_CONN),
+                             0, 0, 0, 0, 0};
+  appendRecord(_output, FCGI_BEGIN_REQUEST, beginBody, sizeof(beginBody));
+
+  std::string pairs;
+  for (std::map<std::string, std::string>::const_iterator it =
+           params.begin();
+       it != params.end(); ++it) {
+    appendLength(pairs, it->first.size());
+    appendLength(pairs, it->second.size());
+    pairs += it->first;
+    pairs += it->second;
+  }
+  if (!pairs.empty())
+    appendRecord(_output, FCGI_PARAMS, pairs.data(), pairs.size());
+  appendRecord(_output, FCGI_PARAMS, NULL, 0);
+
+  if (!body.empty())
+    appendRecord(_output, FCGI_STDIN, body.data(), body.size());
+  appendRecord(_output, FCGI_STDIN, NULL, 0);
+}
+
+void FastCGIRequest::reset() {
+  std::string().swap(_output);
+  _outputSent = 0;
+  _input.clear();
+  _active = false;
+  _complete = false;
+}
+
+bool FastCGIRequest::isActive() const { return _active; }
+
+bool FastCGIRequest::hasPendingOutput() const {
+  return _outputSent < _output.size();
+}
+
+bool FastCGIRequest::isComplete() const { return _complete; }
+
+/**
+ * @brief Sends as much of the encoded request as the socket takes
+ *
+ * @param fd Connection to the FastCGI server (non-blocking; may still be
+ *        connecting, which reads as EAGAIN)
+ * @return false if the connection failed
+ */
+bool FastCGIRequest::sendPending(int fd) {
+  while (_outputSent < _output.size()) {
+    ssize_t sent = send(fd, _output.data() + _outputSent,
+                        _output.size() - _outputSent, SEND_FLAGS);
+    if (sent < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOTCONN)
+        return true; // POLLOUT will tell when there is room
+      return false;
+    }
+    _outputSent += static_cast<size_t>(sent);
+  }
+  std::string().swap(_output); // The body copy is not needed any more
+  _outputSent = 0;
+  return true;
+}
+
+/**
+ * @brief Decodes the records received so far
+ *
+ * @param data Bytes read from the connection
+ * @param length Their count
+ * @param out Receives the FCGI_STDOUT content
+ * @return false on a malformed stream or a request the server rejected
+ */
+bool FastCGIRequest::receive(const char *data, size_t length,
+                             std::string &out) {
+  _input.append(data, length);
+  size_t pos = 0;
+  while (!_complete && _input.size() - pos >= FCGI_HEADER_LEN) {
+    const unsigned char *header =
+        reinterpret_cast<const unsigned char *>(_input.data() + pos);
+    if (header[0] != FCGI_VERSION_1)
+      return false;
+    size_t contentLength = (static_cast<size_t>(header[4]) << 8) | header[5];
+    size_t recordLength = FCGI_HEADER_LEN + contentLength + header[6];
+    if (_input.size() - pos < recordLength)
+      break; // Rest of the record not received yet
+
+    const char *content = _input.data() + pos + FCGI_HEADER_LEN;
+    switch (header[1]) {
+    case FCGI_STDOUT:
+      out.append(content, contentLength);
+      break;
+    case FCGI_STDERR:
+      if (contentLength > 0)
+        LOG_WARN("FastCGI stderr: "
+                 << LogExcerpt(content, contentLength));
+      break;
+    case FCGI_END_REQUEST:
+      if (contentLength < 5 ||
+          static_cast<unsigned char>(content[4]) != FCGI_REQUEST_COMPLETE)
+        return false;
+      _complete = true;
+      break;
+    default:
+      break; // Management records (GET_VALUES_RESULT, UNKNOWN_TYPE)
+    }
+    pos += recordLength;
+  }
+  _input.erase(0, pos);
+  return true;
+}
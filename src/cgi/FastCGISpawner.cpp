@@ -0,0 +1,169 @@
+#include "../../includes/cgi/FastCGISpawner.hpp"
+#include "../../includes/core/Logger.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <set>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+/**
+ * @file FastCGISpawner.cpp
+ * @brief Pre-forked FastCGI workers started by the server (fastcgi_workers)
+ *
+ * With only fastcgi_pass, a FastCGI server (php-fpm, ...) has to be run
+ * next to the web server. fastcgi_workers lets the server start one from
+ * the location's cgi_path, the way spawn-fcgi does:
+ *
+ *   location /php {
+ *       cgi_path /usr/bin/php-cgi;
+ *       fastcgi_pass unix:/tmp/webserv-php.sock;
+ *       fastcgi_workers 4;
+ *   }
+ *
+ *   socket() + bind(path) + listen()
+ *        │
+ *   fork() ×4 ── dup2(socket → fd 0) ── execve(php-cgi)
+ *
+ * FastCGI-capable interpreters (php-cgi, python flup, ...) detect the
+ * listening socket on fd 0 (FCGI_LISTENSOCK_FILENO) and accept requests
+ * on it for their whole lifetime: the interpreter starts once, not once
+ * per request. The event loop then reaches them through FastCGIPool like
+ * any other fastcgi_pass server.
+ *
+ * Workers are started once at startup (before worker_processes forks) and
+ * are not respawned nor changed by a reload; they are terminated when
+ * the server exits.
+ */
+
+FastCGISpawner::FastCGISpawner() : _owner(getpid()) {}
+
+/**
+ * @brief Destructor - stops the workers (in the spawning process only)
+ */
+FastCGISpawner::~FastCGISpawner() { stop(); }
+
+/**
+ * @brief Creates the listening UNIX socket the workers accept on
+ *
+ * A stale socket file left by a previous run is replaced.
+ *
+ * @param path Socket path (fastcgi_pass without "unix:")
+ * @return Listening fd, -1 on error
+ */
+int FastCGISpawner::bindSocket(const std::string &path) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  if (path.size() >= sizeof(addr.sun_path)) {
+    LOG_ERROR("fastcgi_workers: socket path too long: " << path);
+    return -1;
+  }
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1) {
+    LOG_ERROR("fastcgi_workers: socket() failed: " << strerror(errno));
+    return -1;
+  }
+  fcntl(fd, F_SETFD, FD_CLOEXEC); // Workers get it as fd 0 (dup2) only
+  unlink(path.c_str());
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1 ||
+      listen(fd, SOMAXCONN) == -1) {
+    LOG_ERROR("fastcgi_workers: cannot listen on " << path << ": "
+              << strerror(errno));
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * @brief Forks count interpreters with the listening socket as stdin
+ *
+ * @param listenFd Listening socket (closed by the caller afterwards)
+ * @param interpreter cgi_path of the location
+ * @param count Number of workers
+ * @return false if a fork() failed
+ */
+bool FastCGISpawner::spawn(int listenFd, const std::string &interpreter,
+                           int count) {
+  for (int i = 0; i < count; ++i) {
+    Logger::flush(); // Avoid duplicating batched lines in the child
+    pid_t pid = fork();
+    if (pid == -1) {
+      LOG_ERROR("fastcgi_workers: fork() failed: " << strerror(errno));
+      return false;
+    }
+    if (pid == 0) {
+      if (dup2(listenFd, STDIN_FILENO) == -1)
+        _exit(1);
+      close(listenFd);
+      char *argv[] = {const_cast<char *>(interpreter.c_str()), NULL};
+      execve(argv[0], argv, environ);
+      _exit(127);
+    }
+    _children.push_back(pid);
+  }
+  return true;
+}
+
+/**
+ * @brief Starts the fastcgi_workers of every location
+ *
+ * Locations sharing a socket path share its workers (started once).
+ *
+ * @param servers Loaded server blocks
+ * @return false if a socket could not be bound or a worker forked
+ */
+bool FastCGISpawner::start(const std::vector<ServerConfig> &servers) {
+  std::set<std::string> started;
+  for (size_t s = 0; s < servers.size(); ++s) {
+    const std::vector<LocationConfig> &locations = servers[s].getLocations();
+    for (size_t l = 0; l < locations.size(); ++l) {
+      const LocationConfig &location = locations[l];
+      if (location.getFastcgiWorkers() == 0 ||
+          !started.insert(location.getFastcgiPass()).second)
+        continue;
+
+      std::string path = location.getFastcgiPass().substr(5);
+      int fd = bindSocket(path);
+      if (fd == -1)
+        return false;
+      _socketPaths.push_back(path);
+      bool ok = spawn(fd, location.getCgiPaths()[0],
+                      location.getFastcgiWorkers());
+      close(fd); // Only the workers accept on it
+      if (!ok)
+        return false;
+      LOG_INFO("FastCGI: " << location.getFastcgiWorkers() << " x "
+               << location.getCgiPaths()[0] << " on " << path);
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Terminates the workers and removes their sockets
+ *
+ * Does nothing in a forked server worker, which inherits a copy of this
+ * object but not the workers.
+ */
+void FastCGISpawner::stop() {
+  if (getpid() != _owner)
+    return;
+  for (size_t i = 0; i < _children.size(); ++i)
+    kill(_children[i], SIGTERM);
+  for (size_t i = 0; i < _children.size(); ++i)
+    waitpid(_children[i], NULL, 0);
+  _children.clear();
+  for (size_t i = 0; i < _socketPaths.size(); ++i)
+    unlink(_socketPaths[i].c_str());
+  _socketPaths.clear();
+}
@@ -1,4 +1,14 @@
 #include "../../includes/config/ConfigBuilder.hpp"
+#include "../../includes/cgi/CGIEnvironment.hpp"
+#include "../../includes/core/Logger.hpp"
+#include "../../includes/network/TlsContext.hpp"
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
 /**
  * @file ConfigBuilder.cpp
  * @brief Configuration builder - Converts BlockParser tree to usable
@@ -35,33 +45,27 @@
  * SemanticValidator)
  * - Invalid conversions: Return 0 or empty (graceful degradation)
  *
- * @note Stateless class - no member variables, all state is method-local
+ * @note Only state: the upstream blocks of the configuration being built
+ *       (buildFromBlockParser() fills them, proxy_pass looks them up)
  * @see ServerConfig for server-level configuration structure
  * @see LocationConfig for location-level configuration structure
  */
 
 /**
- * @brief Default constructor - Initializes stateless ConfigBuilder
+ * @brief Default constructor - Initializes ConfigBuilder
  *
- * Creates a ConfigBuilder object. The class has no member variables,
- * so the constructor is empty. All conversion logic is contained within
- * method-local variables.
+ * Creates a ConfigBuilder object. Apart from the upstream blocks of the
+ * configuration being built (reset by every buildFromBlockParser()), all
+ * conversion logic is contained within method-local variables.
  *
  * Design rationale:
- * - Stateless design allows reuse across multiple configurations
- * - No shared state = thread-safe by design
+ * - Reusable across multiple configurations
  * - Can add state later (error counting, warnings) if needed
- *
- * @note Empty constructor because class is stateless
  */
 ConfigBuilder::ConfigBuilder() {}
 
 /**
- * @brief Destructor - No cleanup needed for stateless class
- *
- * Destroys the ConfigBuilder object. No cleanup required because:
- * - No member variables to destroy
- * - All resources are method-local (managed by method scopes)
+ * @brief Destructor - No cleanup needed
  *
  * @note Empty destructor because class owns no resources
  */
@@ -74,11 +78,9 @@ ConfigBuilder::~ConfigBuilder() {}
  * Used for single-value directives like "root", "host", "upload_path".
  *
  * Search algorithm:
- * 1. Get all directives from block
- * 2. Iterate through directive vector
- * 3. Find directive with matching name
- * 4. If found and has values: return first value
- * 5. If not found or empty: return ""
+ * 1. Look the name up in the block's directive index (findDirective)
+ * 2. If found: return first value (indexed directives have values)
+ * 3. If not found or empty: return ""
  *
  * Common use cases:
  *   getDirectiveValue(block, "root") → "./www"
@@ -94,16 +96,11 @@ ConfigBuilder::~ConfigBuilder() {}
  */
 std::string ConfigBuilder::getDirectiveValue(const BlockParser &block,
                                              const std::string &directiveName) {
-  std::vector<DirectiveToken> directives = block.getDirectives();
+  const DirectiveToken *directive = block.findDirective(directiveName);
 
-  for (size_t i = 0; i < directives.size(); ++i) {
-    if (directives[i].name == directiveName) {
-      if (!directives[i].values.empty()) {
-        return directives[i].values[0];
-      }
-    }
-  }
-  return "";
+  if (directive == NULL)
+    return "";
+  return directive->values[0];
 }
 
 /**
@@ -133,16 +130,11 @@ std::string ConfigBuilder::getDirectiveValue(const BlockParser &block,
 std::vector<std::string>
 ConfigBuilder::getDirectiveValues(const BlockParser &block,
                                   const std::string &directiveName) {
-  std::vector<DirectiveToken> directives = block.getDirectives();
+  const DirectiveToken *directive = block.findDirective(directiveName);
 
-  for (size_t i = 0; i < directives.size(); ++i) {
-    if (directives[i].name == directiveName) {
-      if (!directives[i].values.empty()) {
-        return directives[i].values;
-      }
-    }
-  }
-  return std::vector<std::string>();
+  if (directive == NULL)
+    return std::vector<std::string>();
+  return directive->values;
 }
 
 /**
@@ -250,6 +242,391 @@ void ConfigBuilder::parseReturn(const BlockParser &locationBlock,
     location.setReturnCode(0);
 }
 
+/**
+ * @brief Parses fastcgi_pass: the FastCGI server of a location
+ *
+ * Directive format:
+ *   fastcgi_pass 127.0.0.1:9000;          → TCP (host name or IPv4)
+ *   fastcgi_pass unix:/run/php-fpm.sock;  → UNIX domain socket
+ *   fastcgi_workers 4;                    → spawn 4 cgi_path workers
+ *
+ * @param locationBlock BlockParser of location to extract from
+ * @param location LocationConfig to modify (passed by reference)
+ *
+ * @throws std::runtime_error if the address has no path or no valid port,
+ *         or fastcgi_workers is out of range or lacks a socket/interpreter
+ */
+void ConfigBuilder::parseFastcgiPass(const BlockParser &locationBlock,
+                                     LocationConfig &location) {
+  std::string address = getDirectiveValue(locationBlock, "fastcgi_pass");
+  std::string workers = getDirectiveValue(locationBlock, "fastcgi_workers");
+  if (address.empty()) {
+    if (!workers.empty())
+      throw std::runtime_error("fastcgi_workers without fastcgi_pass");
+    return;
+  }
+  if (address.compare(0, 5, "unix:") == 0) {
+    if (address.size() == 5)
+      throw std::runtime_error("fastcgi_pass: missing socket path");
+  } else {
+    size_t colon = address.rfind(':');
+    std::string port =
+        colon == std::string::npos ? "" : address.substr(colon + 1);
+    if (colon == 0 || port.empty() ||
+        port.find_first_not_of("0123456789") != std::string::npos ||
+        port.size() > 5 || stringToInt(port) < 1 ||
+        stringToInt(port) > 65535)
+      throw std::runtime_error("fastcgi_pass: invalid address '" + address +
+                               "' (expected host:port or unix:/path)");
+  }
+  location.setFastcgiPass(address);
+
+  // fastcgi_workers N: this server starts N cgi_path processes listening
+  // on the socket itself (see FastCGISpawner)
+  if (workers.empty())
+    return;
+  int count = stringToInt(workers);
+  if (count < 1 || count > 256)
+    throw std::runtime_error("fastcgi_workers: expected 1-256, got " +
+                             workers);
+  if (address.compare(0, 5, "unix:") != 0 || location.getCgiPaths().empty())
+    throw std::runtime_error(
+        "fastcgi_workers needs fastcgi_pass unix:/path and a cgi_path");
+  location.setFastcgiWorkers(count);
+}
+
+/**
+ * @brief Checks a backend address, adding the default port 80
+ *
+ * @param address "host", "host:port" or "[v6]:port"
+ * @param directive Directive named in the error
+ * @return "host:port"
+ * @throws std::runtime_error on an empty host or an invalid port
+ */
+static std::string backendAddress(const std::string &address,
+                                  const std::string &directive) {
+  size_t bracket = address.rfind(']');
+  size_t colon = address.rfind(':');
+  if (colon == std::string::npos ||
+      (bracket != std::string::npos && colon < bracket))
+    return backendAddress(address + ":80", directive);
+  std::string port = address.substr(colon + 1);
+  if (colon == 0 || port.empty() ||
+      port.find_first_not_of("0123456789") != std::string::npos ||
+      port.size() > 5 || stringToInt(port) < 1 || stringToInt(port) > 65535)
+    throw std::runtime_error(directive + ": invalid address '" + address +
+                             "' (expected host[:port])");
+  return address;
+}
+
+/**
+ * @brief Parses proxy_pass: the backends a location forwards to
+ *
+ * Directive format:
+ *   proxy_pass http://backend;            → upstream block "backend"
+ *   proxy_pass http://127.0.0.1:8080;     → single server (port 80 if none)
+ *   proxy_pass http://backend/app/;       → location prefix replaced by /app/
+ *
+ * Only plain HTTP backends: the connection to them is not encrypted.
+ *
+ * @param locationBlock BlockParser of location to extract from
+ * @param location LocationConfig to modify (passed by reference)
+ *
+ * @throws std::runtime_error on another scheme, an invalid address, or
+ *         proxy_pass combined with fastcgi_pass
+ */
+void ConfigBuilder::parseProxyPass(const BlockParser &locationBlock,
+                                   LocationConfig &location) {
+  std::string target = getDirectiveValue(locationBlock, "proxy_pass");
+  if (target.empty())
+    return;
+  if (target.compare(0, 7, "http://") != 0)
+    throw std::runtime_error("proxy_pass: '" + target +
+                             "' (only http:// backends are supported)");
+  if (!location.getFastcgiPass().empty())
+    throw std::runtime_error("proxy_pass and fastcgi_pass in one location");
+
+  std::string rest = target.substr(7);
+  size_t slash = rest.find('/');
+  std::string host = rest.substr(0, slash);
+  if (host.empty())
+    throw std::runtime_error("proxy_pass: missing host in '" + target + "'");
+
+  ProxyPass proxyPass;
+  std::map<std::string, ProxyPass>::const_iterator upstream =
+      _upstreams.find(host);
+  if (upstream != _upstreams.end()) {
+    proxyPass = upstream->second;
+  } else {
+    proxyPass.name = backendAddress(host, "proxy_pass");
+    proxyPass.servers.push_back(proxyPass.name);
+  }
+  if (slash != std::string::npos)
+    proxyPass.uri = rest.substr(slash);
+  location.setProxyPass(proxyPass);
+}
+
+/**
+ * @brief Parses cgi_cache*: caching of the location's script and backend
+ *        responses
+ *
+ * Directive format:
+ *   cgi_cache on;                      → GET/HEAD answered by CGI, FastCGI
+ *                                        or proxy_pass are cached
+ *   cgi_cache_valid 5s;                → lifetime when the response has
+ *                                        no Cache-Control/Expires
+ *                                        (default 0: not cached)
+ *   cgi_cache_key Accept-Language;     → request headers added to the key
+ *
+ * @param locationBlock BlockParser of location to extract from
+ * @param location LocationConfig to modify (passed by reference)
+ *
+ * @throws std::runtime_error on an invalid time, or cgi_cache_valid /
+ *         cgi_cache_key without cgi_cache on
+ */
+void ConfigBuilder::parseCGICache(const BlockParser &locationBlock,
+                                  LocationConfig &location) {
+  CGICachePolicy policy;
+  policy.enabled = getDirectiveValue(locationBlock, "cgi_cache") == "on";
+  std::string valid = getDirectiveValue(locationBlock, "cgi_cache_valid");
+  policy.keyHeaders = getDirectiveValues(locationBlock, "cgi_cache_key");
+  if (!policy.enabled) {
+    if (!valid.empty() || !policy.keyHeaders.empty())
+      throw std::runtime_error(
+          "cgi_cache_valid / cgi_cache_key without cgi_cache on");
+    return;
+  }
+  if (!valid.empty()) {
+    policy.valid = parseDuration(valid);
+    if (policy.valid < 0)
+      throw std::runtime_error("cgi_cache_valid: invalid time '" + valid +
+                               "'");
+  }
+  location.setCGICache(policy);
+}
+
+/**
+ * @brief Parses the upstream blocks of the http block
+ *
+ * Block format (nginx):
+ *   upstream backend {
+ *       server 10.0.0.1:8080;
+ *       server 10.0.0.2:8080;
+ *       least_conn;        → fewest active requests (default round-robin)
+ *       keepalive 32;      → idle connections kept per server (default 16,
+ *   }                        0 = a connection per request)
+ *
+ * @param httpBlock The http block
+ * @throws std::runtime_error on a duplicate name, a block without server
+ *         or an invalid address
+ */
+void ConfigBuilder::httpParseUpstreams(const BlockParser &httpBlock) {
+  const std::vector<BlockParser> &blocks = httpBlock.getNestedBlocks();
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    if (blocks[i].getName().compare(0, 9, "upstream ") != 0)
+      continue;
+    std::string name = blocks[i].getName().substr(9);
+    if (_upstreams.count(name))
+      throw std::runtime_error("duplicate upstream '" + name + "'");
+
+    ProxyPass group;
+    group.name = name;
+    const std::vector<DirectiveToken> &directives = blocks[i].getDirectives();
+    for (size_t j = 0; j < directives.size(); ++j) {
+      if (directives[j].name == "server" && !directives[j].values.empty())
+        group.servers.push_back(
+            backendAddress(directives[j].values[0], "upstream " + name));
+      else if (directives[j].name == "least_conn")
+        group.leastConn = true;
+    }
+    if (group.servers.empty())
+      throw std::runtime_error("upstream '" + name + "' has no server");
+    std::string keepalive = getDirectiveValue(blocks[i], "keepalive");
+    if (!keepalive.empty()) {
+      int count = stringToInt(keepalive);
+      if (count < 0 || count > 1024)
+        throw std::runtime_error("keepalive: expected 0-1024, got " +
+                                 keepalive);
+      group.keepalive = static_cast<size_t>(count);
+    }
+    _upstreams[name] = group;
+  }
+}
+
+/**
+ * @brief Parses a limit_req_zone rate: requests per 1000 seconds
+ *
+ * @param value "10r/s" or "30r/m"
+ * @return Rate, 0 if malformed
+ */
+static unsigned long parseRate(const std::string &value) {
+  size_t digits = 0;
+  while (digits < value.size() && std::isdigit(value[digits]))
+    ++digits;
+  if (digits == 0 || digits > 7)
+    return 0;
+  unsigned long count = std::strtoul(value.c_str(), NULL, 10);
+  std::string unit = value.substr(digits);
+  if (unit == "r/s")
+    return count * 1000;
+  if (unit == "r/m")
+    return count * 1000 / 60;
+  return 0;
+}
+
+/**
+ * @brief Parses the limit_req_zone directives of an http block
+ *
+ * Directive format (nginx, the size only bounds the bucket table):
+ *   limit_req_zone $binary_remote_addr zone=api:1m rate=10r/s;
+ *   limit_req_zone $server_name zone=vhost:64k rate=100r/s;
+ *   limit_req_zone $http_x_api_key zone=keys:1m rate=30r/m;
+ *
+ * The key is the client address ($binary_remote_addr, $remote_addr), the
+ * virtual host ($server_name) or a request header ($http_<name>, '_'
+ * standing for '-').
+ *
+ * @param httpBlock The http block
+ * @param zones Receives the zones, after those of earlier http blocks
+ * @throws std::runtime_error on an unknown key, a duplicate name, or an
+ *         invalid size or rate
+ */
+void ConfigBuilder::parseLimitReqZones(const BlockParser &httpBlock,
+                                       std::vector<LimitReqZone> &zones) {
+  const std::vector<DirectiveToken> &directives = httpBlock.getDirectives();
+  for (size_t i = 0; i < directives.size(); ++i) {
+    if (directives[i].name != "limit_req_zone" ||
+        directives[i].values.size() != 3)
+      continue;
+    const std::vector<std::string> &args = directives[i].values;
+    LimitReqZone zone;
+    if (args[0] == "$binary_remote_addr" || args[0] == "$remote_addr")
+      zone.key = LimitReqZone::KEY_ADDR;
+    else if (args[0] == "$server_name")
+      zone.key = LimitReqZone::KEY_SERVER;
+    else if (args[0].compare(0, 6, "$http_") == 0 && args[0].size() > 6) {
+      zone.key = LimitReqZone::KEY_HEADER;
+      zone.header = args[0].substr(6);
+      for (size_t j = 0; j < zone.header.size(); ++j)
+        if (zone.header[j] == '_')
+          zone.header[j] = '-';
+    } else
+      throw std::runtime_error("limit_req_zone: unknown key '" + args[0] +
+                               "'");
+
+    for (size_t j = 1; j < args.size(); ++j) {
+      if (args[j].compare(0, 5, "zone=") == 0) {
+        size_t colon = args[j].find(':');
+        long bytes = colon == std::string::npos
+                         ? -1
+                         : parseSize(args[j].substr(colon + 1));
+        zone.name = args[j].substr(5, colon == std::string::npos
+                                          ? std::string::npos
+                                          : colon - 5);
+        if (zone.name.empty() || bytes <= 0)
+          throw std::runtime_error("limit_req_zone: expected zone=name:size, "
+                                   "got '" + args[j] + "'");
+        zone.size = static_cast<size_t>(bytes);
+      } else if (args[j].compare(0, 5, "rate=") == 0) {
+        zone.rate = parseRate(args[j].substr(5));
+        if (zone.rate == 0)
+          throw std::runtime_error("limit_req_zone: expected rate=Nr/s or "
+                                   "Nr/m, got '" + args[j] + "'");
+      } else
+        throw std::runtime_error("limit_req_zone: unknown parameter '" +
+                                 args[j] + "'");
+    }
+    if (zone.name.empty() || zone.rate == 0)
+      throw std::runtime_error("limit_req_zone: zone= and rate= required");
+    for (size_t j = 0; j < zones.size(); ++j)
+      if (zones[j].name == zone.name)
+        throw std::runtime_error("duplicate limit_req_zone '" + zone.name +
+                                 "'");
+    zones.push_back(zone);
+  }
+}
+
+/**
+ * @brief Parses the limit_req directive of an http, server or location block
+ *
+ * Directive format (nginx):
+ *   limit_req zone=api;                → rate of the zone, no excess
+ *   limit_req zone=api burst=5;        → 5 more held back to the rate
+ *   limit_req zone=api burst=5 nodelay; → 5 more served at once
+ * Requests over the burst are answered 429.
+ *
+ * @param block Block whose own limit_req is read
+ * @param inherited limit_req of the enclosing block, kept if it has none
+ * @return The limit of the block
+ * @throws std::runtime_error on an unknown zone or parameter
+ */
+LimitReq ConfigBuilder::parseLimitReq(const BlockParser &block,
+                                      const LimitReq &inherited) {
+  std::vector<std::string> args = getDirectiveValues(block, "limit_req");
+  if (args.empty())
+    return inherited;
+
+  LimitReq limit;
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (args[i].compare(0, 5, "zone=") == 0) {
+      std::string name = args[i].substr(5);
+      for (size_t j = 0; j < _limitZones.size(); ++j)
+        if (_limitZones[j].name == name)
+          limit.zone = static_cast<int>(j);
+      if (limit.zone < 0)
+        throw std::runtime_error("limit_req: unknown zone '" + name + "'");
+    } else if (args[i].compare(0, 6, "burst=") == 0) {
+      int burst = stringToInt(args[i].substr(6));
+      if (burst < 0 || burst > 1000000)
+        throw std::runtime_error("limit_req: expected burst=0-1000000, got '" +
+                                 args[i] + "'");
+      limit.burst = static_cast<size_t>(burst);
+    } else if (args[i] == "nodelay")
+      limit.nodelay = true;
+    else
+      throw std::runtime_error("limit_req: unknown parameter '" + args[i] +
+                               "'");
+  }
+  if (limit.zone < 0)
+    throw std::runtime_error("limit_req: zone= required");
+  return limit;
+}
+
+/**
+ * @brief Parses limit_rate and limit_rate_after of a block
+ *
+ * Directive format (nginx):
+ *   limit_rate 500k;        → each response at most 500 KB per second
+ *   limit_rate_after 10m;   → the first 10 MB at full speed
+ *   limit_rate 0;           → off (cancels an inherited limit)
+ * Each directive the block does not set is inherited separately.
+ *
+ * @param block Block whose own directives are read
+ * @param inherited Limit of the enclosing block
+ * @return The limit of the block
+ * @throws std::runtime_error on an invalid size
+ */
+LimitRate ConfigBuilder::parseLimitRate(const BlockParser &block,
+                                        const LimitRate &inherited) {
+  LimitRate limit = inherited;
+  std::string rate = getDirectiveValue(block, "limit_rate");
+  if (!rate.empty()) {
+    long bytes = parseSize(rate);
+    if (bytes < 0)
+      throw std::runtime_error("limit_rate: invalid size '" + rate + "'");
+    limit.rate = static_cast<size_t>(bytes);
+  }
+  std::string after = getDirectiveValue(block, "limit_rate_after");
+  if (!after.empty()) {
+    long bytes = parseSize(after);
+    if (bytes < 0)
+      throw std::runtime_error("limit_rate_after: invalid size '" + after +
+                               "'");
+    limit.after = static_cast<size_t>(bytes);
+  }
+  return limit;
+}
+
 /**
  * @brief Parses all error_page directives and builds error code → file map
  *
@@ -291,7 +668,7 @@ void ConfigBuilder::parseReturn(const BlockParser &locationBlock,
  */
 void ConfigBuilder::locationParseErrorPages(const BlockParser &locationBlock,
                                             LocationConfig &location) {
-  std::vector<DirectiveToken> directives = locationBlock.getDirectives();
+  const std::vector<DirectiveToken> &directives = locationBlock.getDirectives();
   std::map<int, std::string> errorMap;
   for (size_t i = 0; i < directives.size(); ++i) {
     if (directives[i].name == "error_page") {
@@ -316,7 +693,7 @@ void ConfigBuilder::locationParseErrorPages(const BlockParser &locationBlock,
  * - Simple directives: Direct extraction with helpers
  * - Complex directives: Delegated to specialized parsers
  *
- * Directives processed (13 total):
+ * Directives processed (15 total):
  * 1. pattern (from block name)
  * 2. root (single value)
  * 3. index (multiple values)
@@ -324,27 +701,29 @@ void ConfigBuilder::locationParseErrorPages(const BlockParser &locationBlock,
  * 5. cgi_ext (multiple values)
  * 6. cgi_path (multiple values)
  * 7. allow_methods (multiple values)
- * 8. upload_path (single value)
+ * 8. upload_path (single value), upload_preallocate (on/off)
  * 9. alias (single value - alternative path mapping)
  * 10. autoindex (special: string → bool)
  * 11. return (special: code + URL with validation)
  * 12. error_page (special: multiple directives → map)
+ * 13. fastcgi_pass, fastcgi_workers (special: address validated)
+ * 14. proxy_pass (special: upstream name or address resolved)
+ * 15. cgi_cache, cgi_cache_valid, cgi_cache_key (special: time parsed)
  *
  * Method modularity:
  * - Simple directives: Inline setters with helpers (~8 lines)
  * - Complex directives: Delegated to parse*() methods (clean separation)
  *
  * @param locationBlock BlockParser representing location { ... } block
- * @return Complete LocationConfig ready for use
+ * @param location Default-constructed LocationConfig to fill, in place in
+ *        its server's vector (no copy of the finished location)
  *
- * @note Creates new LocationConfig (not modifying existing)
  * @note All directives optional (uses defaults if missing)
  * @see parseAutoindex(), parseReturn(), locationParseErrorPages() for complex
  * cases
  */
-LocationConfig ConfigBuilder::buildLocation(const BlockParser &locationBlock) {
-  LocationConfig location;
-
+void ConfigBuilder::buildLocation(const BlockParser &locationBlock,
+                                  LocationConfig &location) {
   std::string name = locationBlock.getName();
   if (name.find("location ") == 0) {
     name = name.substr(9);
@@ -361,13 +740,17 @@ LocationConfig ConfigBuilder::buildLocation(const BlockParser &locationBlock) {
   location.setCgiPaths(getDirectiveValues(locationBlock, "cgi_path"));
   location.setMethods(getDirectiveValues(locationBlock, "allow_methods"));
   location.setUploadPath(getDirectiveValue(locationBlock, "upload_path"));
+  location.setUploadPreallocate(
+      getDirectiveValue(locationBlock, "upload_preallocate") == "on");
   location.setAlias(getDirectiveValue(locationBlock, "alias"));
 
   parseAutoindex(locationBlock, location);
   parseReturn(locationBlock, location);
+  parseFastcgiPass(locationBlock, location);
+  parseProxyPass(locationBlock, location);
+  parseCGICache(locationBlock, location);
   locationParseErrorPages(locationBlock, location);
 
-  return location;
 }
 
 /**
@@ -385,7 +768,7 @@ LocationConfig ConfigBuilder::buildLocation(const BlockParser &locationBlock) {
  */
 void ConfigBuilder::serverParseErrorPages(const BlockParser &serverBlock,
                                           ServerConfig &server) {
-  std::vector<DirectiveToken> directives = serverBlock.getDirectives();
+  const std::vector<DirectiveToken> &directives = serverBlock.getDirectives();
   std::map<int, std::string> errorMap;
   for (size_t i = 0; i < directives.size(); ++i) {
     if (directives[i].name == "error_page") {
@@ -440,11 +823,12 @@ void ConfigBuilder::serverParseErrorPages(const BlockParser &serverBlock,
  */
 void ConfigBuilder::serverParseLocation(const BlockParser &serverBlock,
                                         ServerConfig &server) {
-  std::vector<BlockParser> nestedBlocks = serverBlock.getNestedBlocks();
-  std::vector<LocationConfig> locations;
+  const std::vector<BlockParser> &nestedBlocks = serverBlock.getNestedBlocks();
+  std::vector<LocationConfig> locations(nestedBlocks.size());
 
   for (size_t i = 0; i < nestedBlocks.size(); i++) {
-    LocationConfig loc = buildLocation(nestedBlocks[i]);
+    LocationConfig &loc = locations[i];
+    buildLocation(nestedBlocks[i], loc);
     if (loc.getRoot().empty()) {
       loc.setRoot(server.getRoot());
     }
@@ -470,10 +854,17 @@ void ConfigBuilder::serverParseLocation(const BlockParser &serverBlock,
     }
     loc.setErrorPages(mergedErrors);
 
-    locations.push_back(loc);
+    // limit_req / limit_rate: the location's own, else the server's (or
+    // the http one)
+    loc.setLimitReq(parseLimitReq(nestedBlocks[i], _limitReq));
+    loc.setLimitRate(parseLimitRate(nestedBlocks[i], _limitRate));
+
+    // CGI variables that never change for this location, rendered once
+    if (!loc.getCgiExts().empty() || !loc.getCgiPaths().empty())
+      loc.setCgiEnvTemplate(CGIEnvironment::buildTemplate(server.getListen()));
   }
 
-  server.setLocations(locations);
+  server.takeLocations(locations);
 }
 
 /**
@@ -487,28 +878,57 @@ void ConfigBuilder::serverParseLocation(const BlockParser &serverBlock,
  * - Error pages: Delegated to serverParseErrorPages()
  * - Locations: Delegated to serverParseLocation()
  *
- * Directives processed (7 server-level + N locations):
- * 1. listen (int - port number)
+ * Directives processed (11 server-level + N locations):
+ * 1. listen (int - port number, optional "default_server" flag and socket
+ *    options "backlog=N", "deferred", "fastopen=N", "sndbuf=N", "rcvbuf=N",
+ *    "http2", "ssl")
  * 2. host (string - bind address)
  * 3. server_name (multiple - virtual host names)
  * 4. root (string - document root)
  * 5. index (multiple - default index files)
  * 6. client_max_body_size (int - max request body)
- * 7. error_page (special - multiple directives → map)
- * 8. location blocks (special - nested blocks → vector<LocationConfig>)
+ * 7. tcp_nodelay / tcp_nopush (on|off - accepted socket policy)
+ * 8. ssl_* (special - see serverParseSsl())
+ * 9. error_page (special - multiple directives → map)
+ * 10. limit_req, limit_rate(_after) (special - inherited by locations, see
+ *     parseLimitReq() and parseLimitRate())
+ * 11. location blocks (special - nested blocks → vector<LocationConfig>)
  *
  * @param serverBlock BlockParser representing server { ... } block
- * @return Complete ServerConfig with all locations
+ * @param server Default-constructed ServerConfig to fill, in place in the
+ *        result of buildFromBlockParser()
  *
- * @note Creates new ServerConfig (not modifying existing)
  * @note All directives optional (uses defaults if missing)
  * @see serverParseErrorPages() for error_page handling
  * @see serverParseLocation() for location block processing
  */
-ServerConfig ConfigBuilder::buildServer(const BlockParser &serverBlock) {
-  ServerConfig server;
-
+void ConfigBuilder::buildServer(const BlockParser &serverBlock,
+                                ServerConfig &server) {
   server.setListen(getDirectiveValueAsInt(serverBlock, "listen"));
+  std::vector<std::string> listen = getDirectiveValues(serverBlock, "listen");
+  ListenOptions options;
+  for (size_t i = 1; i < listen.size(); ++i) {
+    if (listen[i] == "default_server")
+      server.setDefaultServer(true);
+    else if (listen[i] == "deferred")
+      options.deferred = true;
+    else if (listen[i] == "http2")
+      options.http2 = true;
+    else if (listen[i] == "ssl")
+      options.ssl = true;
+    else if (listen[i].compare(0, 8, "backlog=") == 0)
+      options.backlog = std::atoi(listen[i].c_str() + 8);
+    else if (listen[i].compare(0, 9, "fastopen=") == 0)
+      options.fastOpen = std::atoi(listen[i].c_str() + 9);
+    else if (listen[i].compare(0, 7, "sndbuf=") == 0)
+      options.sndBuf = std::atoi(listen[i].c_str() + 7);
+    else if (listen[i].compare(0, 7, "rcvbuf=") == 0)
+      options.rcvBuf = std::atoi(listen[i].c_str() + 7);
+  }
+  server.setListenOptions(options);
+  server.setTcpNoDelay(getDirectiveValue(serverBlock, "tcp_nodelay") != "off");
+  server.setTcpNoPush(getDirectiveValue(serverBlock, "tcp_nopush") == "on");
+  serverParseSsl(serverBlock, server);
   server.setHost(getDirectiveValue(serverBlock, "host"));
   server.setServerNames(getDirectiveValues(serverBlock, "server_name"));
   server.setRoot(getDirectiveValue(serverBlock, "root"));
@@ -517,9 +937,13 @@ ServerConfig ConfigBuilder::buildServer(const BlockParser &serverBlock) {
       getDirectiveValueAsInt(serverBlock, "client_max_body_size"));
 
   serverParseErrorPages(serverBlock, server);
+  LimitReq httpLimit = _limitReq;
+  LimitRate httpRate = _limitRate;
+  _limitReq = parseLimitReq(serverBlock, httpLimit);
+  _limitRate = parseLimitRate(serverBlock, httpRate);
   serverParseLocation(serverBlock, server);
-
-  return server;
+  _limitReq = httpLimit;
+  _limitRate = httpRate;
 }
 
 /**
@@ -532,6 +956,7 @@ ServerConfig ConfigBuilder::buildServer(const BlockParser &serverBlock) {
  *   root (file)
  *   ├── events { }
  *   └── http {               ← Target context
+ *       ├── upstream x { }   ← Backends, looked up by proxy_pass
  *       ├── server { ... }   ← Convert these
  *       └── server { ... }   ← to ServerConfig
  *   }
@@ -540,6 +965,8 @@ ServerConfig ConfigBuilder::buildServer(const BlockParser &serverBlock) {
  * 1. Get root-level blocks (events, http, stream, mail...)
  * 2. Filter for "http" blocks
  * 3. For each http block:
+ *    - Collect its upstream blocks (see httpParseUpstreams()) and
+ *      limit_req zones (see parseLimitReqZones())
  *    - Get nested server blocks
  *    - Convert each server to ServerConfig
  *    - Accumulate in result vector
@@ -564,17 +991,745 @@ ServerConfig ConfigBuilder::buildServer(const BlockParser &serverBlock) {
  */
 std::vector<ServerConfig>
 ConfigBuilder::buildFromBlockParser(const BlockParser &root) {
-  std::vector<BlockParser> rootBlocks = root.getNestedBlocks();
+  const std::vector<BlockParser> &rootBlocks = root.getNestedBlocks();
   std::vector<ServerConfig> servers;
+  _upstreams.clear();
+  _limitZones.clear();
   for (size_t i = 0; i < rootBlocks.size(); i++) {
     if (rootBlocks[i].getName() == "http") {
-      std::vector<BlockParser> serverBlocks = rootBlocks[i].getNestedBlocks();
+      httpParseUpstreams(rootBlocks[i]);
+      parseLimitReqZones(rootBlocks[i], _limitZones);
+      _limitReq = parseLimitReq(rootBlocks[i], LimitReq());
+      _limitRate = parseLimitRate(rootBlocks[i], LimitRate());
+      const std::vector<BlockParser> &serverBlocks = rootBlocks[i].getNestedBlocks();
+      size_t first = servers.size();
+      size_t count = 0;
+      for (size_t j = 0; j < serverBlocks.size(); j++)
+        count += serverBlocks[j].getName() == "server";
+      // Built in place: a ServerConfig copy would copy all its locations
+      servers.resize(first + count);
       for (size_t j = 0; j < serverBlocks.size(); j++) {
-        ServerConfig srv = buildServer(serverBlocks[j]);
-        servers.push_back(srv);
+        if (serverBlocks[j].getName() != "server")
+          continue;
+        buildServer(serverBlocks[j], servers[first++]);
       }
     }
   }
 
+  checkDefaultServers(servers);
+  checkListenOptions(servers);
+  checkSsl(servers);
   return servers;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Rejects two default_server blocks on the same port
+ *
+ * @param servers Every server block
+ * @throws std::runtime_error naming the port
+ */
+void ConfigBuilder::checkDefaultServers(
+    const std::vector<ServerConfig> &servers) {
+  std::map<int, bool> seen;
+  for (size_t i = 0; i < servers.size(); ++i) {
+    if (!servers[i].isDefaultServer())
+      continue;
+    if (seen[servers[i].getListen()]) {
+      std::ostringstream message;
+      message << "a duplicate default_server for port "
+              << servers[i].getListen();
+      throw std::runtime_error(message.str());
+    }
+    seen[servers[i].getListen()] = true;
+  }
+}
+
+/**
+ * @brief Checks the certificates of the ports listening with "ssl"
+ *
+ * Every block of such a port needs ssl_certificate and
+ * ssl_certificate_key (the handshake picks one by SNI), and both files
+ * must be readable. The certificates themselves are loaded with the
+ * configuration snapshot (see TlsContext).
+ *
+ * @param servers Every server block
+ * @throws std::runtime_error naming the port or the file
+ */
+void ConfigBuilder::checkSsl(const std::vector<ServerConfig> &servers) {
+  std::map<int, bool> ssl;
+  for (size_t i = 0; i < servers.size(); ++i) {
+    if (servers[i].getListenOptions().ssl)
+      ssl[servers[i].getListen()] = true;
+  }
+  for (size_t i = 0; i < servers.size(); ++i) {
+    if (!ssl[servers[i].getListen()])
+      continue;
+    std::ostringstream message;
+    message << "port " << servers[i].getListen() << ": ";
+    const SslSettings &settings = servers[i].getSsl();
+    if (!TlsContext::isAvailable())
+      throw std::runtime_error(message.str() +
+                               "\"ssl\" needs a build with OpenSSL");
+    if (settings.certificate.empty() || settings.certificateKey.empty())
+      throw std::runtime_error(
+          message.str() +
+          "\"ssl\" needs ssl_certificate and ssl_certificate_key");
+    if (access(settings.certificate.c_str(), R_OK) != 0)
+      throw std::runtime_error(message.str() + "cannot read " +
+                               settings.certificate);
+    if (access(settings.certificateKey.c_str(), R_OK) != 0)
+      throw std::runtime_error(message.str() + "cannot read " +
+                               settings.certificateKey);
+  }
+}
+
+/**
+ * @brief Rejects socket options given by two blocks of the same port
+ *
+ * backlog, deferred, fastopen, sndbuf and rcvbuf configure the port's
+ * single listening socket, so (as in nginx) only one of its blocks may set
+ * them. http2 and ssl may be repeated: they apply to the whole port.
+ *
+ * @param servers Every server block
+ * @throws std::runtime_error naming the port
+ */
+void ConfigBuilder::checkListenOptions(
+    const std::vector<ServerConfig> &servers) {
+  std::map<int, bool> seen;
+  for (size_t i = 0; i < servers.size(); ++i) {
+    if (!servers[i].getListenOptions().isSet())
+      continue;
+    if (seen[servers[i].getListen()]) {
+      std::ostringstream message;
+      message << "duplicate listen options (backlog, deferred, fastopen, "
+                 "sndbuf, rcvbuf) for port "
+              << servers[i].getListen();
+      throw std::runtime_error(message.str());
+    }
+    seen[servers[i].getListen()] = true;
+  }
+}
+
+/**
+ * @brief Builds process-wide settings from the main context
+ *
+ * Reads directives that do not belong to any server block:
+ *
+ *   worker_processes 4;      → fork 4 workers
+ *   worker_processes auto;   → one worker per online CPU
+ *   worker_shutdown_timeout 30s;  → drain deadline on SIGTERM/SIGQUIT
+ *
+ * worker_connections from the events block, and the process-wide
+ * directives of the http block (open_file_cache, response_cache_size...).
+ *
+ * @param root BlockParser representing entire configuration file
+ * @return GlobalConfig with defaults for every missing directive
+ *
+ * @throws std::runtime_error if worker_processes is neither a positive
+ *         number nor "auto", worker_shutdown_timeout is not a time, or an
+ *         http-level directive is malformed
+ */
+GlobalConfig ConfigBuilder::buildGlobal(const BlockParser &root)
+{
+    GlobalConfig global;
+
+    std::string workers = getDirectiveValue(root, "worker_processes");
+    if (workers == "auto")
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        global.setWorkerProcesses(cpus > 0 ? static_cast<int>(cpus) : 1);
+    }
+    else if (!workers.empty())
+    {
+        int count = stringToInt(workers);
+        if (count < 1)
+            throw std::runtime_error("worker_processes must be a positive number or 'auto'");
+        global.setWorkerProcesses(count);
+    }
+
+    std::string shutdown = getDirectiveValue(root, "worker_shutdown_timeout");
+    if (!shutdown.empty())
+    {
+        int seconds = parseDuration(shutdown);
+        if (seconds < 0)
+            throw std::runtime_error("worker_shutdown_timeout: invalid time '" + shutdown + "'");
+        global.setWorkerShutdownTimeout(seconds);
+    }
+
+    const std::vector<BlockParser> &rootBlocks = root.getNestedBlocks();
+    std::vector<LimitReqZone> zones;
+    std::vector<std::pair<std::string, std::string> > types;
+    for (size_t i = 0; i < rootBlocks.size(); i++)
+    {
+        if (rootBlocks[i].getName() == "http")
+        {
+            parseLimitReqZones(rootBlocks[i], zones);
+            httpParseTypes(rootBlocks[i], types, global);
+            httpParseOpenFileCache(rootBlocks[i], global);
+            httpParseResponseCache(rootBlocks[i], global);
+            httpParseCGICache(rootBlocks[i], global);
+            httpParseIoBudgets(rootBlocks[i], global);
+            httpParseIoThreads(rootBlocks[i], global);
+            httpParseCompression(rootBlocks[i], global);
+            httpParseLogs(rootBlocks[i], global);
+            httpParseMetrics(rootBlocks[i], global);
+            httpParseTracing(rootBlocks[i], global);
+            httpParseTimeouts(rootBlocks[i], global);
+        }
+        parseConnectionLimits(rootBlocks[i], global); // events + http
+    }
+    global.setLimitReqZones(zones);
+    global.setMimeTypes(types);
+    return global;
+}
+
+/**
+ * @brief Parses open_file_cache* directives of the http block
+ *
+ * Syntax (nginx):
+ *   open_file_cache off;
+ *   open_file_cache max=1000 [inactive=20s];
+ *   open_file_cache_valid 30s;
+ *   open_file_cache_errors on;
+ *   open_file_cache_mmap 4m;      (off = files are never mapped)
+ *
+ * @param httpBlock The http block
+ * @param global GlobalConfig to fill
+ *
+ * @throws std::runtime_error on unknown parameters or invalid numbers/times
+ */
+void ConfigBuilder::httpParseOpenFileCache(const BlockParser &httpBlock,
+                                           GlobalConfig &global)
+{
+    std::vector<std::string> args = getDirectiveValues(httpBlock, "open_file_cache");
+    if (!args.empty() && args[0] != "off")
+    {
+        int maxEntries = -1;
+        int inactive = 60;
+        for (size_t i = 0; i < args.size(); ++i)
+        {
+            if (args[i].compare(0, 4, "max=") == 0)
+                maxEntries = stringToInt(args[i].substr(4));
+            else if (args[i].compare(0, 9, "inactive=") == 0)
+                inactive = parseDuration(args[i].substr(9));
+            else
+                throw std::runtime_error("open_file_cache: invalid parameter '" + args[i] + "'");
+        }
+        if (maxEntries <= 0)
+            throw std::runtime_error("open_file_cache: 'max=N' with N > 0 is required");
+        if (inactive < 0)
+            throw std::runtime_error("open_file_cache: invalid inactive time");
+        global.setOpenFileCache(static_cast<size_t>(maxEntries), inactive);
+    }
+
+    std::string valid = getDirectiveValue(httpBlock, "open_file_cache_valid");
+    if (!valid.empty())
+    {
+        int seconds = parseDuration(valid);
+        if (seconds < 0)
+            throw std::runtime_error("open_file_cache_valid: invalid time '" + valid + "'");
+        global.setOpenFileCacheValid(seconds);
+    }
+
+    global.setOpenFileCacheErrors(getDirectiveValue(httpBlock, "open_file_cache_errors") == "on");
+
+    std::string mmapMax = getDirectiveValue(httpBlock, "open_file_cache_mmap");
+    if (!mmapMax.empty() && mmapMax != "off")
+    {
+        long bytes = parseSize(mmapMax);
+        if (bytes < 0)
+            throw std::runtime_error("open_file_cache_mmap: invalid size '" + mmapMax + "'");
+        global.setOpenFileCacheMmap(static_cast<size_t>(bytes));
+    }
+}
+
+/**
+ * @brief Parses the ssl_* directives of a server block
+ *
+ * Syntax:
+ *   ssl_certificate     certs/example.pem;   → PEM chain, leaf first
+ *   ssl_certificate_key certs/example.key;
+ *   ssl_session_cache   20480;   → sessions kept per worker (off = none)
+ *   ssl_session_tickets on;      → stateless resumption (default on)
+ *   ssl_session_timeout 5m;      → lifetime of a resumable session
+ *
+ * @param serverBlock The server block
+ * @param server ServerConfig to fill
+ *
+ * @throws std::runtime_error if a value is invalid
+ */
+void ConfigBuilder::serverParseSsl(const BlockParser &serverBlock,
+                                   ServerConfig &server)
+{
+    SslSettings ssl;
+    ssl.certificate = getDirectiveValue(serverBlock, "ssl_certificate");
+    ssl.certificateKey = getDirectiveValue(serverBlock, "ssl_certificate_key");
+
+    std::string cache = getDirectiveValue(serverBlock, "ssl_session_cache");
+    if (cache == "off")
+        ssl.sessionCache = 0;
+    else if (!cache.empty())
+    {
+        ssl.sessionCache = stringToInt(cache);
+        if (ssl.sessionCache <= 0)
+            throw std::runtime_error("ssl_session_cache: invalid size '" + cache + "'");
+    }
+    ssl.sessionTickets = getDirectiveValue(serverBlock, "ssl_session_tickets") != "off";
+
+    std::string timeout = getDirectiveValue(serverBlock, "ssl_session_timeout");
+    if (!timeout.empty())
+    {
+        ssl.sessionTimeout = parseDuration(timeout);
+        if (ssl.sessionTimeout <= 0)
+            throw std::runtime_error("ssl_session_timeout: invalid time '" + timeout + "'");
+    }
+    server.setSsl(ssl);
+}
+
+/**
+ * @brief Parses response_cache_size of the http block
+ *
+ * Syntax:
+ *   response_cache_size 4m;    → keep up to 4 MiB of serialized responses
+ *   response_cache_size off;   → disabled (default)
+ *
+ * @param httpBlock The http block
+ * @param global GlobalConfig to fill
+ *
+ * @throws std::runtime_error if the size is invalid
+ */
+void ConfigBuilder::httpParseResponseCache(const BlockParser &httpBlock,
+                                           GlobalConfig &global)
+{
+    std::string value = getDirectiveValue(httpBlock, "response_cache_size");
+    if (value.empty() || value == "off")
+        return;
+    long bytes = parseSize(value);
+    if (bytes < 0)
+        throw std::runtime_error("response_cache_size: invalid size '" + value + "'");
+    global.setResponseCacheSize(static_cast<size_t>(bytes));
+}
+
+/**
+ * @brief Parses cgi_cache_size / cgi_cache_path of the http block
+ *
+ * Syntax:
+ *   cgi_cache_size 16m;               → memory for cgi_cache (default 8m)
+ *   cgi_cache_size off;               → cgi_cache disabled everywhere
+ *   cgi_cache_path /var/cache/webserv; → also keep entries on disk
+ *
+ * @param httpBlock The http block
+ * @param global GlobalConfig to fill
+ *
+ * @throws std::runtime_error if the size is invalid or the path is not an
+ *         existing directory
+ */
+void ConfigBuilder::httpParseCGICache(const BlockParser &httpBlock,
+                                      GlobalConfig &global)
+{
+    std::string value = getDirectiveValue(httpBlock, "cgi_cache_size");
+    if (value == "off")
+        global.setCgiCacheSize(0);
+    else if (!value.empty())
+    {
+        long bytes = parseSize(value);
+        if (bytes < 0)
+            throw std::runtime_error("cgi_cache_size: invalid size '" + value + "'");
+        global.setCgiCacheSize(static_cast<size_t>(bytes));
+    }
+
+    std::string path = getDirectiveValue(httpBlock, "cgi_cache_path");
+    if (path.empty())
+        return;
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+        throw std::runtime_error("cgi_cache_path: '" + path + "' is not a directory");
+    global.setCgiCachePath(path);
+}
+
+/**
+ * @brief Parses io_read_budget / io_write_budget of the http block
+ *
+ * How many bytes one connection may move per readiness event before the
+ * event loop serves the others:
+ *   io_read_budget 256k;    → recv() until drained or 256 KiB (default)
+ *   io_write_budget 1m;     → send() until the socket is full or 1 MiB
+ *   io_read_budget off;     → a single recv() per event
+ *
+ * @param httpBlock The http block
+ * @param global GlobalConfig to fill
+ *
+ * @throws std::runtime_error if a size is invalid
+ */
+void ConfigBuilder::httpParseIoBudgets(const BlockParser &httpBlock,
+                                       GlobalConfig &global)
+{
+    const char *names[] = {"io_read_budget", "io_write_budget"};
+    for (size_t i = 0; i < 2; ++i)
+    {
+        std::string value = getDirectiveValue(httpBlock, names[i]);
+        if (value.empty())
+            continue;
+        long bytes = 0;
+        if (value != "off")
+        {
+            bytes = parseSize(value);
+            if (bytes <= 0)
+                throw std::runtime_error(std::string(names[i]) + ": invalid size '" + value + "'");
+        }
+        if (i == 0)
+            global.setIoReadBudget(static_cast<size_t>(bytes));
+        else
+            global.setIoWriteBudget(static_cast<size_t>(bytes));
+    }
+}
+
+/**
+ * @brief Parses io_threads of the http block
+ *
+ * Threads that run the blocking filesystem calls of static requests
+ * (stat, open, read, readdir, fsync, unlink) off the event loop:
+ *   io_threads 4;     → four threads per worker process
+ *   io_threads off;   → everything on the event loop (default)
+ *
+ * @param httpBlock The http block
+ * @param global GlobalConfig to fill
+ *
+ * @throws std::runtime_error if the count is invalid
+ */
+void ConfigBuilder::httpParseIoThreads(const BlockParser &httpBlock,
+                                       GlobalConfig &global)
+{
+    std::string value = getDirectiveValue(httpBlock, "io_threads");
+    if (value.empty() || value == "off")
+        return;
+    int threads = stringToInt(value);
+    if (threads < 0 || threads > 64)
+        throw std::runtime_error("io_threads: expected 0-64 or off, got '" + value + "'");
+    global.setIoThreads(threads);
+}
+
+/**
+ * @brief Parses the gzip* / brotli directives of the http block
+ *
+ * Syntax (nginx):
+ *   gzip on;                         → compress on the fly (default off)
+ *   gzip_types text/css image/svg+xml; → besides text/html ("*" = any)
+ *   gzip_min_length 1k;              → smaller bodies stay as they are
+ *   gzip_comp_level 6;               → 1 (fastest) to 9 (smallest)
+ *   gzip_static on;                  → serve foo.css.gz / foo.css.br
+ *   brotli on;                       → prefer br when the client accepts it
+ *
+ * @param httpBlock The http block
+ * @param global GlobalConfig to fill
+ *
+ * @throws std::runtime_error if a level or size is invalid
+ */
+void ConfigBuilder::httpParseCompression(const BlockParser &httpBlock,
+                                         GlobalConfig &global)
+{
+    global.setGzip(getDirectiveValue(httpBlock, "gzip") == "on");
+    global.setGzipStatic(getDirectiveValue(httpBlock, "gzip_static") == "on");
+    global.setBrotli(getDirectiveValue(httpBlock, "brotli") == "on");
+
+    std::vector<std::string> types = getDirectiveValues(httpBlock, "gzip_types");
+    if (!types.empty())
+        global.setGzipTypes(types);
+
+    std::string level = getDirectiveValue(httpBlock, "gzip_comp_level");
+    if (!level.empty())
+    {
+        int value = stringToInt(level);
+        if (value < 1 || value > 9)
+            throw std::runtime_error("gzip_comp_level: expected 1-9, got '" + level + "'");
+        global.setGzipCompLevel(value);
+    }
+
+    std::string minLength = getDirectiveValue(httpBlock, "gzip_min_length");
+    if (!minLength.empty())
+    {
+        long bytes = parseSize(minLength);
+        if (bytes < 0)
+            throw std::runtime_error("gzip_min_length: invalid size '" + minLength + "'");
+        global.setGzipMinLength(static_cast<size_t>(bytes));
+    }
+}
+
+/**
+ * @brief Parses the connection timeouts of the http block
+ *
+ * Each one limits how long a connection may stay in one phase, or stay
+ * silent in it:
+ *   client_header_timeout 10s;  → request line and headers, in total
+ *   client_body_timeout 30s;    → the whole body
+ *   keepalive_timeout 15s;      → idle between two requests
+ *   send_timeout 30s;           → between two successful writes
+ *   cgi_timeout 60s;            → the whole CGI / FastCGI / proxy exchange
+ *
+ * @param httpBlock The http block
+ * @param global GlobalConfig to fill
+ *
+ * @throws std::runtime_error if a time is invalid or zero
+ */
+void ConfigBuilder::httpParseTimeouts(const BlockParser &httpBlock,
+                                      GlobalConfig &global)
+{
+    static const char *names[GlobalConfig::TIMEOUT_COUNT] = {
+        "client_header_timeout", "client_body_timeout", "keepalive_timeout",
+        "send_timeout", "cgi_timeout"};
+    for (int i = 0; i < GlobalConfig::TIMEOUT_COUNT; ++i)
+    {
+        std::string value = getDirectiveValue(httpBlock, names[i]);
+        if (value.empty())
+            continue;
+        int seconds = parseDuration(value);
+        if (seconds <= 0)
+            throw std::runtime_error(std::string(names[i]) + ": invalid time '" + value + "'");
+        global.setTimeout(static_cast<GlobalConfig::Timeout>(i), seconds);
+    }
+}
+
+/**
+ * @brief Parses error_log / access_log of the http block
+ *
+ * Syntax:
+ *   error_log logs/error.log warn;   → file, warnings and errors only
+ *   error_log stderr debug;          → everything, to stderr
+ *   access_log logs/access.log;      → one "combined" line per response
+ *   access_log off;                  → no access log (default)
+ *
+ * The level defaults to info; "stdout" and "stderr" name the standard
+ * streams.
+ *
+ * @param httpBlock The http block
+ * @param global GlobalConfig to fill
+ *
+ * @throws std::runtime_error if the level is unknown
+ */
+void ConfigBuilder::httpParseLogs(const BlockParser &httpBlock,
+                                  GlobalConfig &global)
+{
+    std::vector<std::string> args = getDirectiveValues(httpBlock, "error_log");
+    if (!args.empty())
+    {
+        int level = Logger::INFO;
+        if (args.size() > 1)
+        {
+            level = Logger::parseLevel(args[1]);
+            if (level < 0)
+                throw std::runtime_error("error_log: invalid level '" + args[1] + "'");
+        }
+        global.setErrorLog(args[0], level);
+    }
+
+    std::string access = getDirectiveValue(httpBlock, "access_log");
+    if (!access.empty())
+        global.setAccessLog(access == "off" ? "" : access);
+}
+
+/**
+ * @brief Reads a mime.types file into (extension, type) pairs
+ *
+ * Takes nginx's format ("types { text/html html htm; }") as well as
+ * Apache's ("text/html html htm", one type per line): braces, semicolons
+ * and a leading "types" are ignored, '#' starts a comment.
+ *
+ * @param path File to read
+ * @param types Receives the pairs, after those already there
+ * @throws std::runtime_error if the file cannot be read or a line does
+ *         not start with a type/subtype
+ */
+static void readTypesFile(const std::string &path,
+                          std::vector<std::pair<std::string, std::string> > &types)
+{
+    std::ifstream file(path.c_str());
+    if (!file)
+        throw std::runtime_error("types_file: cannot read '" + path + "'");
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        ++lineNumber;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+        for (size_t i = 0; i < line.size(); ++i)
+            if (line[i] == ';' || line[i] == '{' || line[i] == '}')
+                line[i] = ' ';
+        std::istringstream words(line);
+        std::string type;
+        if (!(words >> type) || (type == "types" && !(words >> type)))
+            continue;
+        if (type.find('/') == std::string::npos)
+        {
+            std::ostringstream message;
+            message << "types_file: " << path << ":" << lineNumber
+                    << ": expected a MIME type, got '" << type << "'";
+            throw std::runtime_error(message.str());
+        }
+        std::string extension;
+        while (words >> extension)
+            types.push_back(std::make_pair(extension, type));
+    }
+}
+
+/**
+ * @brief Parses types {}, types_file and default_type of the http block
+ *
+ * Syntax (nginx):
+ *   types_file mime.types;        → read first
+ *   types {                       → then these, overriding it
+ *       application/wasm wasm;
+ *   }
+ *   default_type text/plain;      → unknown extensions (octet-stream)
+ * Any configured type replaces the whole built-in table (see MimeTypes).
+ *
+ * @param httpBlock The http block
+ * @param types Receives the (extension, type) pairs
+ * @param global GlobalConfig to fill (default_type)
+ *
+ * @throws std::runtime_error if the types file cannot be read
+ */
+void ConfigBuilder::httpParseTypes(
+    const BlockParser &httpBlock,
+    std::vector<std::pair<std::string, std::string> > &types,
+    GlobalConfig &global)
+{
+    std::string file = getDirectiveValue(httpBlock, "types_file");
+    if (!file.empty())
+        readTypesFile(file, types);
+
+    const std::vector<BlockParser> &blocks = httpBlock.getNestedBlocks();
+    for (size_t i = 0; i < blocks.size(); ++i)
+    {
+        if (blocks[i].getName() != "types")
+            continue;
+        const std::vector<DirectiveToken> &entries = blocks[i].getDirectives();
+        for (size_t j = 0; j < entries.size(); ++j)
+            for (size_t k = 0; k < entries[j].values.size(); ++k)
+                types.push_back(std::make_pair(entries[j].values[k], entries[j].name));
+    }
+
+    std::string defaultType = getDirectiveValue(httpBlock, "default_type");
+    if (!defaultType.empty())
+        global.setDefaultType(defaultType);
+}
+
+/**
+ * @brief Parses metrics_path of the http block
+ *
+ * Syntax:
+ *   metrics_path /__status;   → Prometheus metrics on that path
+ *   metrics_path off;         → no endpoint (default; counters are kept)
+ *
+ * @param httpBlock The http block
+ * @param global GlobalConfig to fill
+ *
+ * @throws std::runtime_error if the path is not absolute
+ */
+void ConfigBuilder::httpParseMetrics(const BlockParser &httpBlock,
+                                     GlobalConfig &global)
+{
+    std::string path = getDirectiveValue(httpBlock, "metrics_path");
+    if (path.empty())
+        return;
+    if (path == "off")
+        path.clear();
+    else if (path[0] != '/')
+        throw std::runtime_error("metrics_path: expected an absolute path or off, got '" + path + "'");
+    global.setMetricsPath(path);
+}
+
+/**
+ * @brief Parses slow_request_threshold and request_trace of the http block
+ *
+ * Syntax:
+ *   slow_request_threshold 500ms;           → log requests slower than that
+ *   request_trace logs/trace.json;          → every request, Chrome trace
+ *   request_trace logs/trace.json every=100; → one request in 100
+ *
+ * Both are off by default. Slow requests are traced whatever the sampling.
+ *
+ * @param httpBlock The http block
+ * @param global GlobalConfig to fill
+ *
+ * @throws std::runtime_error on an invalid duration or sampling
+ */
+void ConfigBuilder::httpParseTracing(const BlockParser &httpBlock,
+                                     GlobalConfig &global)
+{
+    std::string threshold = getDirectiveValue(httpBlock, "slow_request_threshold");
+    if (!threshold.empty())
+    {
+        long milliseconds = threshold == "off" ? 0 : parseMilliseconds(threshold);
+        if (milliseconds < 0)
+            throw std::runtime_error("slow_request_threshold: invalid time '" + threshold + "'");
+        global.setSlowRequestThreshold(milliseconds);
+    }
+
+    std::vector<std::string> args = getDirectiveValues(httpBlock, "request_trace");
+    if (args.empty() || args[0] == "off")
+        return;
+    int every = 1;
+    if (args.size() > 1)
+    {
+        if (args[1].compare(0, 6, "every=") != 0)
+            throw std::runtime_error("request_trace: expected every=N, got '" + args[1] + "'");
+        every = stringToInt(args[1].substr(6));
+        if (every < 1)
+            throw std::runtime_error("request_trace: every=N needs N > 0, got '" + args[1] + "'");
+    }
+    global.setRequestTrace(args[0], every);
+}
+
+/**
+ * @brief Parses worker_connections and use (events), limit_conn_per_ip (http)
+ *
+ * Syntax:
+ *   events { worker_connections 4096; }  → client connections per process
+ *   events { use io_uring; }              → poll | epoll | kqueue | io_uring
+ *   http { limit_conn_per_ip 64; }        → per client address (0 = off)
+ *
+ * Past worker_connections, an idle keep-alive connection is closed to make
+ * room, or the new one is answered 503 (see Server::acceptNewClient()).
+ *
+ * @param block An events or http block (other blocks are ignored)
+ * @param global GlobalConfig to fill
+ *
+ * A backend not compiled in, or refused by the kernel, falls back to the
+ * platform default when the server starts (see EventBackend::create()).
+ *
+ * @throws std::runtime_error if a count is out of range or use names an
+ *         unknown backend
+ */
+void ConfigBuilder::parseConnectionLimits(const BlockParser &block,
+                                          GlobalConfig &global)
+{
+    if (block.getName() == "events")
+    {
+        std::string backend = getDirectiveValue(block, "use");
+        if (!backend.empty())
+        {
+            if (backend != "poll" && backend != "epoll" && backend != "kqueue" && backend != "io_uring")
+                throw std::runtime_error("use: expected poll, epoll, kqueue or io_uring, got '" + backend + "'");
+            global.setEventBackend(backend);
+        }
+        std::string value = getDirectiveValue(block, "worker_connections");
+        if (value.empty())
+            return;
+        int connections = stringToInt(value);
+        if (connections < 1 || connections > 1000000)
+            throw std::runtime_error("worker_connections: expected 1-1000000, got '" + value + "'");
+        global.setWorkerConnections(connections);
+    }
+    else if (block.getName() == "http")
+    {
+        std::string value = getDirectiveValue(block, "limit_conn_per_ip");
+        if (value.empty())
+            return;
+        int connections = stringToInt(value);
+        if (connections < 0 || connections > 1000000)
+            throw std::runtime_error("limit_conn_per_ip: expected 0-1000000, got '" + value + "'");
+        global.setLimitConnPerIp(connections);
+    }
+}
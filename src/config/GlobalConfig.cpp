@@ -0,0 +1,743 @@
+#include "../../includes/config/GlobalConfig.hpp"
+#include "../../includes/core/Logger.hpp"
+/**
+ * @file GlobalConfig.cpp
+ * @brief Process-wide configuration - settings outside any server block
+ *
+ * Server and location blocks describe virtual hosts; everything that applies
+ * to the whole process (how many workers to run, event loop tuning, ...)
+ * lives here instead. Values come from the main context, the events block
+ * and the http block itself.
+ *
+ * Configuration structure:
+ *   worker_processes 4;         ← main context
+ *   worker_shutdown_timeout 10s;
+ *   events { ... }
+ *   http {
+ *       open_file_cache max=1000 inactive=20s;   ← http context
+ *       response_cache_size 4m;
+ *       cgi_cache_size 16m;
+ *       io_read_budget 256k;
+ *       io_threads 4;
+ *       gzip on;
+ *       error_log logs/error.log warn;
+ *       metrics_path /__status;
+ *       limit_req_zone $binary_remote_addr zone=api:1m rate=10r/s;
+ *       types { application/wasm wasm; }
+ *       keepalive_timeout 15s;
+ *       server { ... }
+ *   }
+ *
+ * @note One GlobalConfig per configuration file
+ * @see ConfigBuilder::buildGlobal() for construction from parsed config
+ */
+
+/**
+ * @brief Default constructor - single process, no workers forked
+ *
+ * Default values:
+ * - _workerProcesses = 1 (master runs the event loop itself)
+ * - worker_shutdown_timeout 10s (the former fixed worker stop timeout)
+ * - worker_connections 1024, no limit_conn_per_ip
+ * - no use: the platform's event backend (epoll, kqueue, else poll)
+ * - open_file_cache off, valid 60s, inactive 60s, errors off (nginx defaults),
+ *   no file mapped
+ * - response cache off; cgi_cache entries up to 8m in memory, no disk tier
+ * - io_read_budget 256k, io_write_budget 1m per readiness event
+ * - io_threads 0: file I/O stays on the event loop
+ * - gzip, gzip_static and brotli off; level 5, min length 256, and the
+ *   usual text asset types (CSS, JS, JSON, SVG, plain text, XML)
+ * - error_log stdout at level info, access_log off
+ * - no metrics endpoint (metrics_path unset)
+ * - no slow request log, no request trace
+ * - no limit_req_zone
+ * - built-in MIME types, default_type application/octet-stream
+ * - every connection timeout 30s (the former fixed idle timeout)
+ */
+GlobalConfig::GlobalConfig()
+    : _workerProcesses(1), _workerShutdownTimeout(10), _workerConnections(1024), _limitConnPerIp(0),
+      _openFileCacheMax(0), _openFileCacheInactive(60),
+      _openFileCacheValid(60), _openFileCacheErrors(false),
+      _openFileCacheMmap(0),
+      _responseCacheSize(0), _cgiCacheSize(8 * 1024 * 1024),
+      _ioReadBudget(256 * 1024),
+      _ioWriteBudget(1024 * 1024), _ioThreads(0), _gzip(false), _gzipStatic(false),
+      _brotli(false), _gzipCompLevel(5), _gzipMinLength(256),
+      _errorLog("stdout"), _errorLogLevel(Logger::INFO), _accessLog(""),
+      _metricsPath(""), _slowRequestMs(0), _requestTrace(""),
+      _requestTraceEvery(1), _defaultType("application/octet-stream")
+{
+    static const char *types[] = {"text/css", "text/plain",
+                                  "text/javascript", "application/javascript",
+                                  "application/json", "image/svg+xml",
+                                  "application/xml", "text/xml"};
+    _gzipTypes.assign(types, types + sizeof(types) / sizeof(types[0]));
+    for (int i = 0; i < TIMEOUT_COUNT; ++i)
+        _timeouts[i] = 30;
+}
+
+/**
+ * @brief Copy constructor - copies all process-wide settings
+ *
+ * @param other GlobalConfig to copy from
+ */
+GlobalConfig::GlobalConfig(const GlobalConfig &other)
+    : _workerProcesses(other._workerProcesses),
+      _workerShutdownTimeout(other._workerShutdownTimeout),
+      _workerConnections(other._workerConnections),
+      _eventBackend(other._eventBackend),
+      _limitConnPerIp(other._limitConnPerIp),
+      _openFileCacheMax(other._openFileCacheMax),
+      _openFileCacheInactive(other._openFileCacheInactive),
+      _openFileCacheValid(other._openFileCacheValid),
+      _openFileCacheErrors(other._openFileCacheErrors),
+      _openFileCacheMmap(other._openFileCacheMmap),
+      _responseCacheSize(other._responseCacheSize),
+      _cgiCacheSize(other._cgiCacheSize),
+      _cgiCachePath(other._cgiCachePath),
+      _ioReadBudget(other._ioReadBudget),
+      _ioWriteBudget(other._ioWriteBudget),
+      _ioThreads(other._ioThreads),
+      _gzip(other._gzip),
+      _gzipStatic(other._gzipStatic),
+      _brotli(other._brotli),
+      _gzipCompLevel(other._gzipCompLevel),
+      _gzipMinLength(other._gzipMinLength),
+      _gzipTypes(other._gzipTypes),
+      _errorLog(other._errorLog),
+      _errorLogLevel(other._errorLogLevel),
+      _accessLog(other._accessLog),
+      _metricsPath(other._metricsPath),
+      _slowRequestMs(other._slowRequestMs),
+      _requestTrace(other._requestTrace),
+      _requestTraceEvery(other._requestTraceEvery),
+      _limitReqZones(other._limitReqZones),
+      _mimeTypes(other._mimeTypes),
+      _defaultType(other._defaultType)
+{
+    for (int i = 0; i < TIMEOUT_COUNT; ++i)
+        _timeouts[i] = other._timeouts[i];
+}
+
+/**
+ * @brief Assignment operator - copies all process-wide settings
+ *
+ * @param other GlobalConfig to copy from
+ * @return Reference to this object
+ */
+GlobalConfig &GlobalConfig::operator=(const GlobalConfig &other)
+{
+    if (this != &other)
+    {
+        _workerProcesses = other._workerProcesses;
+        _workerShutdownTimeout = other._workerShutdownTimeout;
+        _workerConnections = other._workerConnections;
+        _eventBackend = other._eventBackend;
+        _limitConnPerIp = other._limitConnPerIp;
+        _openFileCacheMax = other._openFileCacheMax;
+        _openFileCacheInactive = other._openFileCacheInactive;
+        _openFileCacheValid = other._openFileCacheValid;
+        _openFileCacheErrors = other._openFileCacheErrors;
+        _openFileCacheMmap = other._openFileCacheMmap;
+        _responseCacheSize = other._responseCacheSize;
+        _cgiCacheSize = other._cgiCacheSize;
+        _cgiCachePath = other._cgiCachePath;
+        _ioReadBudget = other._ioReadBudget;
+        _ioWriteBudget = other._ioWriteBudget;
+        _ioThreads = other._ioThreads;
+        _gzip = other._gzip;
+        _gzipStatic = other._gzipStatic;
+        _brotli = other._brotli;
+        _gzipCompLevel = other._gzipCompLevel;
+        _gzipMinLength = other._gzipMinLength;
+        _gzipTypes = other._gzipTypes;
+        _errorLog = other._errorLog;
+        _errorLogLevel = other._errorLogLevel;
+        _accessLog = other._accessLog;
+        _metricsPath = other._metricsPath;
+        _slowRequestMs = other._slowRequestMs;
+        _requestTrace = other._requestTrace;
+        _requestTraceEvery = other._requestTraceEvery;
+        _limitReqZones = other._limitReqZones;
+        _mimeTypes = other._mimeTypes;
+        _defaultType = other._defaultType;
+        for (int i = 0; i < TIMEOUT_COUNT; ++i)
+            _timeouts[i] = other._timeouts[i];
+    }
+    return *this;
+}
+
+/**
+ * @brief Destructor - nothing to release
+ */
+GlobalConfig::~GlobalConfig()
+{
+}
+
+// ==================== GETTERS ====================
+
+/**
+ * @brief Returns number of worker processes to fork
+ * @return Worker count (1 = no master/worker split)
+ */
+int GlobalConfig::getWorkerProcesses() const
+{
+    return _workerProcesses;
+}
+
+/**
+ * @brief Returns how long a stopping process drains its connections
+ * @return Seconds between SIGTERM/SIGQUIT and closing what is still open
+ */
+int GlobalConfig::getWorkerShutdownTimeout() const
+{
+    return _workerShutdownTimeout;
+}
+
+/**
+ * @brief Returns the client connection limit of each process
+ * @return worker_connections (past it, idle keep-alive is evicted or 503)
+ */
+int GlobalConfig::getWorkerConnections() const
+{
+    return _workerConnections;
+}
+
+/**
+ * @brief Returns the event backend named by the use directive
+ * @return "poll", "epoll", "kqueue", "io_uring", or "" for the default
+ */
+const std::string &GlobalConfig::getEventBackend() const
+{
+    return _eventBackend;
+}
+
+/**
+ * @brief Returns the connection limit of one client address
+ * @return limit_conn_per_ip, 0 = no limit
+ */
+int GlobalConfig::getLimitConnPerIp() const
+{
+    return _limitConnPerIp;
+}
+
+/**
+ * @brief Returns open_file_cache max entries
+ * @return Entry limit (0 = cache disabled)
+ */
+size_t GlobalConfig::getOpenFileCacheMax() const
+{
+    return _openFileCacheMax;
+}
+
+/**
+ * @brief Returns seconds an unused cache entry is kept
+ */
+int GlobalConfig::getOpenFileCacheInactive() const
+{
+    return _openFileCacheInactive;
+}
+
+/**
+ * @brief Returns seconds between revalidations of a cache entry
+ */
+int GlobalConfig::getOpenFileCacheValid() const
+{
+    return _openFileCacheValid;
+}
+
+/**
+ * @brief Whether lookup errors (ENOENT, EACCES...) are cached
+ */
+bool GlobalConfig::getOpenFileCacheErrors() const
+{
+    return _openFileCacheErrors;
+}
+
+/**
+ * @brief Returns the largest file the open file cache maps
+ * @return Size in bytes (0 = files are never mapped)
+ */
+size_t GlobalConfig::getOpenFileCacheMmap() const
+{
+    return _openFileCacheMmap;
+}
+
+/**
+ * @brief Returns the serialized response cache budget
+ * @return Bytes (0 = cache disabled)
+ */
+size_t GlobalConfig::getResponseCacheSize() const
+{
+    return _responseCacheSize;
+}
+
+/**
+ * @brief Returns the memory budget of cgi_cache entries
+ * @return Bytes (used only by locations with cgi_cache on)
+ */
+size_t GlobalConfig::getCgiCacheSize() const
+{
+    return _cgiCacheSize;
+}
+
+/**
+ * @brief Returns the cgi_cache disk tier directory
+ * @return Directory ("" = memory only)
+ */
+const std::string &GlobalConfig::getCgiCachePath() const
+{
+    return _cgiCachePath;
+}
+
+/**
+ * @brief Returns the bytes a connection may read per readiness event
+ * @return Bytes (0 = a single recv() per event)
+ */
+size_t GlobalConfig::getIoReadBudget() const
+{
+    return _ioReadBudget;
+}
+
+/**
+ * @brief Returns the bytes a connection may send per readiness event
+ * @return Bytes (0 = a single write per event)
+ */
+size_t GlobalConfig::getIoWriteBudget() const
+{
+    return _ioWriteBudget;
+}
+
+/**
+ * @brief Returns the number of blocking file I/O threads
+ * @return Threads (0 = stat/open/read run on the event loop)
+ */
+int GlobalConfig::getIoThreads() const
+{
+    return _ioThreads;
+}
+
+/**
+ * @brief Whether responses are gzip-compressed on the fly (gzip)
+ */
+bool GlobalConfig::getGzip() const
+{
+    return _gzip;
+}
+
+/**
+ * @brief Whether foo.gz / foo.br siblings are served (gzip_static)
+ */
+bool GlobalConfig::getGzipStatic() const
+{
+    return _gzipStatic;
+}
+
+/**
+ * @brief Whether responses are brotli-compressed on the fly (brotli)
+ */
+bool GlobalConfig::getBrotli() const
+{
+    return _brotli;
+}
+
+/**
+ * @brief Returns the compression level (gzip_comp_level)
+ * @return 1 (fastest) to 9 (smallest)
+ */
+int GlobalConfig::getGzipCompLevel() const
+{
+    return _gzipCompLevel;
+}
+
+/**
+ * @brief Returns the smallest body that is compressed (gzip_min_length)
+ * @return Bytes
+ */
+size_t GlobalConfig::getGzipMinLength() const
+{
+    return _gzipMinLength;
+}
+
+/**
+ * @brief Returns the MIME types compressed besides text/html (gzip_types)
+ */
+const std::vector<std::string> &GlobalConfig::getGzipTypes() const
+{
+    return _gzipTypes;
+}
+
+/**
+ * @brief Returns the error log destination (error_log)
+ * @return "stdout", "stderr" or a file path
+ */
+const std::string &GlobalConfig::getErrorLog() const
+{
+    return _errorLog;
+}
+
+/**
+ * @brief Returns the lowest level written to the error log
+ * @return Logger::Level
+ */
+int GlobalConfig::getErrorLogLevel() const
+{
+    return _errorLogLevel;
+}
+
+/**
+ * @brief Returns the access log destination (access_log)
+ * @return Target, "" when access logging is off
+ */
+const std::string &GlobalConfig::getAccessLog() const
+{
+    return _accessLog;
+}
+
+/**
+ * @brief Returns the path of the metrics endpoint (metrics_path)
+ * @return Path, "" when the endpoint is off
+ */
+const std::string &GlobalConfig::getMetricsPath() const
+{
+    return _metricsPath;
+}
+
+/**
+ * @brief Returns the duration past which a request is logged as slow
+ * @return slow_request_threshold in milliseconds, 0 = off
+ */
+long GlobalConfig::getSlowRequestThreshold() const
+{
+    return _slowRequestMs;
+}
+
+/**
+ * @brief Returns the file the sampled request traces go to
+ * @return request_trace path, "" = off
+ */
+const std::string &GlobalConfig::getRequestTrace() const
+{
+    return _requestTrace;
+}
+
+/**
+ * @brief Returns the sampling of request_trace
+ * @return N: one request in N is traced (slow ones always are)
+ */
+int GlobalConfig::getRequestTraceEvery() const
+{
+    return _requestTraceEvery;
+}
+
+/**
+ * @brief Returns the limit_req zones of the http block
+ * @return Zones, indexed by LimitReq::zone
+ */
+const std::vector<LimitReqZone> &GlobalConfig::getLimitReqZones() const
+{
+    return _limitReqZones;
+}
+
+/**
+ * @brief Returns the configured MIME types
+ * @return (extension, type) pairs in declaration order, empty when the
+ *         built-in table is used
+ */
+const std::vector<std::pair<std::string, std::string> > &
+GlobalConfig::getMimeTypes() const
+{
+    return _mimeTypes;
+}
+
+/**
+ * @brief Returns the Content-Type of files with an unknown extension
+ */
+const std::string &GlobalConfig::getDefaultType() const
+{
+    return _defaultType;
+}
+
+/**
+ * @brief Returns the inactivity timeout of a connection phase
+ * @param which Phase (client_header_timeout, keepalive_timeout, ...)
+ * @return Seconds
+ */
+int GlobalConfig::getTimeout(Timeout which) const
+{
+    return _timeouts[which];
+}
+
+// ==================== SETTERS ====================
+
+/**
+ * @brief Sets number of worker processes
+ * @param workerProcesses Worker count (values < 1 are clamped to 1)
+ */
+void GlobalConfig::setWorkerProcesses(int workerProcesses)
+{
+    _workerProcesses = workerProcesses < 1 ? 1 : workerProcesses;
+}
+
+/**
+ * @brief Sets the drain deadline of a graceful shutdown
+ * @param seconds worker_shutdown_timeout (0 = close at once)
+ */
+void GlobalConfig::setWorkerShutdownTimeout(int seconds)
+{
+    _workerShutdownTimeout = seconds < 0 ? 0 : seconds;
+}
+
+/**
+ * @brief Sets the client connection limit of each process
+ * @param connections worker_connections (> 0)
+ */
+void GlobalConfig::setWorkerConnections(int connections)
+{
+    _workerConnections = connections;
+}
+
+/**
+ * @brief Sets the event backend of every process
+ * @param name Backend name (see EventBackend::create())
+ */
+void GlobalConfig::setEventBackend(const std::string &name)
+{
+    _eventBackend = name;
+}
+
+/**
+ * @brief Sets the connection limit of one client address
+ * @param connections limit_conn_per_ip, 0 = no limit
+ */
+void GlobalConfig::setLimitConnPerIp(int connections)
+{
+    _limitConnPerIp = connections;
+}
+
+/**
+ * @brief Enables the open file cache
+ * @param maxEntries Maximum cached paths (0 = off)
+ * @param inactive Seconds an unused entry is kept
+ */
+void GlobalConfig::setOpenFileCache(size_t maxEntries, int inactive)
+{
+    _openFileCacheMax = maxEntries;
+    _openFileCacheInactive = inactive;
+}
+
+/**
+ * @brief Sets seconds between revalidations (open_file_cache_valid)
+ */
+void GlobalConfig::setOpenFileCacheValid(int seconds)
+{
+    _openFileCacheValid = seconds;
+}
+
+/**
+ * @brief Enables caching of lookup errors (open_file_cache_errors)
+ */
+void GlobalConfig::setOpenFileCacheErrors(bool enabled)
+{
+    _openFileCacheErrors = enabled;
+}
+
+/**
+ * @brief Sets the largest file mapped by the cache (open_file_cache_mmap)
+ * @param bytes Size limit in bytes (0 = off)
+ */
+void GlobalConfig::setOpenFileCacheMmap(size_t bytes)
+{
+    _openFileCacheMmap = bytes;
+}
+
+/**
+ * @brief Sets the serialized response cache budget (response_cache_size)
+ * @param bytes Memory budget in bytes (0 = off)
+ */
+void GlobalConfig::setResponseCacheSize(size_t bytes)
+{
+    _responseCacheSize = bytes;
+}
+
+/**
+ * @brief Sets the memory budget of cgi_cache (cgi_cache_size)
+ * @param bytes Memory budget in bytes (0 = cgi_cache disabled)
+ */
+void GlobalConfig::setCgiCacheSize(size_t bytes)
+{
+    _cgiCacheSize = bytes;
+}
+
+/**
+ * @brief Sets the cgi_cache disk tier directory (cgi_cache_path)
+ * @param path Existing, writable directory
+ */
+void GlobalConfig::setCgiCachePath(const std::string &path)
+{
+    _cgiCachePath = path;
+}
+
+/**
+ * @brief Sets the per-event read budget (io_read_budget)
+ * @param bytes Budget in bytes (0 = off)
+ */
+void GlobalConfig::setIoReadBudget(size_t bytes)
+{
+    _ioReadBudget = bytes;
+}
+
+/**
+ * @brief Sets the per-event write budget (io_write_budget)
+ * @param bytes Budget in bytes (0 = off)
+ */
+void GlobalConfig::setIoWriteBudget(size_t bytes)
+{
+    _ioWriteBudget = bytes;
+}
+
+/**
+ * @brief Sets the size of the blocking file I/O pool (io_threads)
+ * @param threads Worker threads (0 = off)
+ */
+void GlobalConfig::setIoThreads(int threads)
+{
+    _ioThreads = threads;
+}
+
+/**
+ * @brief Enables on-the-fly gzip (gzip)
+ */
+void GlobalConfig::setGzip(bool enabled)
+{
+    _gzip = enabled;
+}
+
+/**
+ * @brief Enables precompressed siblings (gzip_static)
+ */
+void GlobalConfig::setGzipStatic(bool enabled)
+{
+    _gzipStatic = enabled;
+}
+
+/**
+ * @brief Enables on-the-fly brotli (brotli)
+ */
+void GlobalConfig::setBrotli(bool enabled)
+{
+    _brotli = enabled;
+}
+
+/**
+ * @brief Sets the compression level (gzip_comp_level)
+ * @param level 1-9 (clamped)
+ */
+void GlobalConfig::setGzipCompLevel(int level)
+{
+    _gzipCompLevel = level < 1 ? 1 : level > 9 ? 9 : level;
+}
+
+/**
+ * @brief Sets the smallest body that is compressed (gzip_min_length)
+ * @param bytes Size in bytes
+ */
+void GlobalConfig::setGzipMinLength(size_t bytes)
+{
+    _gzipMinLength = bytes;
+}
+
+/**
+ * @brief Sets the MIME types compressed besides text/html (gzip_types)
+ * @param types MIME types, "*" for any
+ */
+void GlobalConfig::setGzipTypes(const std::vector<std::string> &types)
+{
+    _gzipTypes = types;
+}
+
+/**
+ * @brief Sets the error log (error_log)
+ * @param target "stdout", "stderr" or a file path
+ * @param level Lowest Logger::Level written
+ */
+void GlobalConfig::setErrorLog(const std::string &target, int level)
+{
+    _errorLog = target;
+    _errorLogLevel = level;
+}
+
+/**
+ * @brief Sets the access log (access_log)
+ * @param target "stdout", "stderr", a file path, or "" for off
+ */
+void GlobalConfig::setAccessLog(const std::string &target)
+{
+    _accessLog = target;
+}
+
+/**
+ * @brief Sets the path of the metrics endpoint (metrics_path)
+ * @param path Absolute URL path, or "" for off
+ */
+void GlobalConfig::setMetricsPath(const std::string &path)
+{
+    _metricsPath = path;
+}
+
+/**
+ * @brief Sets the slow request log threshold
+ * @param milliseconds slow_request_threshold, 0 = off
+ */
+void GlobalConfig::setSlowRequestThreshold(long milliseconds)
+{
+    _slowRequestMs = milliseconds < 0 ? 0 : milliseconds;
+}
+
+/**
+ * @brief Sets the request trace file and its sampling
+ * @param path Chrome trace JSON file, "" = off
+ * @param every One request in every is traced (>= 1)
+ */
+void GlobalConfig::setRequestTrace(const std::string &path, int every)
+{
+    _requestTrace = path;
+    _requestTraceEvery = every < 1 ? 1 : every;
+}
+
+/**
+ * @brief Sets the limit_req zones (limit_req_zone)
+ * @param zones Zones in declaration order
+ */
+void GlobalConfig::setLimitReqZones(const std::vector<LimitReqZone> &zones)
+{
+    _limitReqZones = zones;
+}
+
+/**
+ * @brief Sets the MIME types (types {} and types_file)
+ * @param types (extension, type) pairs, later ones win
+ */
+void GlobalConfig::setMimeTypes(
+    const std::vector<std::pair<std::string, std::string> > &types)
+{
+    _mimeTypes = types;
+}
+
+/**
+ * @brief Sets the type of unknown extensions (default_type)
+ */
+void GlobalConfig::setDefaultType(const std::string &type)
+{
+    _defaultType = type;
+}
+
+/**
+ * @brief Sets the inactivity timeout of a connection phase
+ * @param which Phase (client_header_timeout, keepalive_timeout, ...)
+ * @param seconds Timeout in seconds (> 0)
+ */
+void GlobalConfig::setTimeout(Timeout which, int seconds)
+{
+    _timeouts[which] = seconds;
+}
@@ -16,18 +16,27 @@
  *       autoindex on;
  *       cgi_path /usr/bin/php-cgi;
  *       cgi_ext .php;
+ *       fastcgi_pass 127.0.0.1:9000;
+ *       fastcgi_workers 4;
+ *       proxy_pass http://backend;
+ *       cgi_cache on;
+ *       cgi_cache_valid 5s;
+ *       cgi_cache_key Accept-Language;
  *       error_page 404 /404.html;
  *       return 301 /new-location;
  *       upload_path ./uploads;
+ *       upload_preallocate on;
  *       client_max_body_size 1048576;
  *       alias /other/path;
  *   }
  *
- * Managed data (13 attributes):
+ * Managed data (14 attributes):
  * - Pattern matching (URI pattern for this location)
  * - Static file serving (root, index, autoindex)
  * - HTTP methods (GET, POST, DELETE allowed)
- * - CGI execution (interpreter paths and extensions)
+ * - CGI execution (interpreter paths and extensions, or a FastCGI server)
+ * - Reverse proxy (proxy_pass backends)
+ * - Response caching of scripts and backends (cgi_cache)
  * - Error handling (custom error pages per status code)
  * - Redirects (HTTP redirects with status code)
  * - File uploads (upload directory and size limits)
@@ -62,12 +71,19 @@
  * - _methods = [] (empty, should be set to restrict methods)
  * - _cgiPaths = [] (empty, CGI disabled by default)
  * - _cgiExts = [] (empty)
+ * - _fastcgiPass = "" (scripts run as CGI processes)
+ * - _fastcgiWorkers = 0 (fastcgi_pass server started separately)
+ * - _proxyPass = no servers (requests are served here)
+ * - _cgiCache = off, valid 0 (only what the response allows), no headers
+ * - _limitReq = no zone (requests are not rate limited)
+ * - _limitRate = 0 (responses are sent at full speed)
  * - _errorPages = {} (empty map, server defaults will apply)
  * - _returnCode = 0 (no redirect configured)
  * - _returnUrl = "" (no redirect)
  * - _maxBodySize = 1MB (same as nginx default)
  * - _pattern = "" (must be set from location block name)
  * - _uploadPath = "" (uploads disabled by default)
+ * - _uploadPreallocate = false (upload files grow as data is written)
  * - _alias = "" (no alias configured)
  * - _autoindex = false (directory listing disabled by default)
  *
@@ -83,8 +99,8 @@
 static const size_t DEFAULT_MAX_BODY_SIZE = 1 * 1024 * 1024;
 
 LocationConfig::LocationConfig()
-    : _returnCode(0), _maxBodySize(DEFAULT_MAX_BODY_SIZE), _alias(""),
-      _autoindex(false) {}
+    : _fastcgiWorkers(0), _returnCode(0), _maxBodySize(DEFAULT_MAX_BODY_SIZE),
+      _uploadPreallocate(false), _alias(""), _autoindex(false) {}
 
 /**
  * @brief Copy constructor - Deep copies all configuration from another
@@ -115,10 +131,16 @@ LocationConfig::LocationConfig()
 LocationConfig::LocationConfig(const LocationConfig &other)
     : _root(other._root), _index(other._index), _methods(other._methods),
       _cgiPaths(other._cgiPaths), _cgiExts(other._cgiExts),
-      _errorPages(other._errorPages), _returnCode(other._returnCode),
-      _returnUrl(other._returnUrl), _maxBodySize(other._maxBodySize),
+      _fastcgiPass(other._fastcgiPass),
+      _fastcgiWorkers(other._fastcgiWorkers),
+      _cgiEnvTemplate(other._cgiEnvTemplate), _proxyPass(other._proxyPass),
+      _cgiCache(other._cgiCache), _limitReq(other._limitReq),
+      _limitRate(other._limitRate),
+      _errorPages(other._errorPages),
+      _returnCode(other._returnCode), _returnUrl(other._returnUrl), _maxBodySize(other._maxBodySize),
       _pattern(other._pattern), _uploadPath(other._uploadPath),
-      _alias(other._alias), _autoindex(other._autoindex) {}
+      _uploadPreallocate(other._uploadPreallocate), _alias(other._alias),
+      _autoindex(other._autoindex) {}
 
 /**
  * @brief Assignment operator - Copies configuration from another location
@@ -157,12 +179,20 @@ LocationConfig &LocationConfig::operator=(const LocationConfig &other) {
     _methods = other._methods;
     _cgiPaths = other._cgiPaths;
     _cgiExts = other._cgiExts;
+    _fastcgiPass = other._fastcgiPass;
+    _fastcgiWorkers = other._fastcgiWorkers;
+    _cgiEnvTemplate = other._cgiEnvTemplate;
+    _proxyPass = other._proxyPass;
+    _cgiCache = other._cgiCache;
+    _limitReq = other._limitReq;
+    _limitRate = other._limitRate;
     _errorPages = other._errorPages;
     _returnCode = other._returnCode;
     _returnUrl = other._returnUrl;
     _maxBodySize = other._maxBodySize;
     _pattern = other._pattern;
     _uploadPath = other._uploadPath;
+    _uploadPreallocate = other._uploadPreallocate;
     _alias = other._alias;
     _autoindex = other._autoindex;
   }
@@ -236,6 +266,56 @@ const std::vector<std::string> &LocationConfig::getCgiExts() const {
   return _cgiExts;
 }
 
+/**
+ * @brief Returns the FastCGI server of this location
+ * @return "host:port", "unix:/path", or "" when scripts run as CGI
+ * @note Example: "127.0.0.1:9000" (php-fpm)
+ */
+const std::string &LocationConfig::getFastcgiPass() const {
+  return _fastcgiPass;
+}
+
+/**
+ * @brief Returns how many FastCGI workers the server starts itself
+ * @return Worker count (0 = the fastcgi_pass server is external)
+ */
+int LocationConfig::getFastcgiWorkers() const { return _fastcgiWorkers; }
+
+/**
+ * @brief Returns the CGI variables fixed for this location
+ * @return NUL-separated "NAME=value" entries ("" = not built, no CGI)
+ */
+const std::string &LocationConfig::getCgiEnvTemplate() const {
+  return _cgiEnvTemplate;
+}
+
+/**
+ * @brief Whether requests of this location go to proxy_pass backends
+ */
+bool LocationConfig::hasProxyPass() const {
+  return !_proxyPass.servers.empty();
+}
+
+/**
+ * @brief Returns the proxy_pass backends and their balancing settings
+ */
+const ProxyPass &LocationConfig::getProxyPass() const { return _proxyPass; }
+
+/**
+ * @brief Returns the cgi_cache settings of the location
+ */
+const CGICachePolicy &LocationConfig::getCGICache() const { return _cgiCache; }
+
+/**
+ * @brief Returns the limit_req settings (own, or inherited from the server)
+ */
+const LimitReq &LocationConfig::getLimitReq() const { return _limitReq; }
+
+/**
+ * @brief Returns the limit_rate settings (own, or inherited from the server)
+ */
+const LimitRate &LocationConfig::getLimitRate() const { return _limitRate; }
+
 /**
  * @brief Returns custom error page mappings (code → file path)
  * @return Reference to map of error codes to HTML file paths
@@ -280,6 +360,12 @@ const std::string &LocationConfig::getPattern() const { return _pattern; }
  */
 const std::string &LocationConfig::getUploadPath() const { return _uploadPath; }
 
+/**
+ * @brief Returns whether upload files are preallocated (upload_preallocate)
+ * @return true if the full Content-Length is reserved before writing
+ */
+bool LocationConfig::getUploadPreallocate() const { return _uploadPreallocate; }
+
 /**
  * @brief Returns directory listing (autoindex) setting
  * @return true if autoindex enabled, false otherwise
@@ -372,6 +458,58 @@ void LocationConfig::setCgiExts(const std::vector<std::string> &cgiExts) {
   _cgiExts = cgiExts;
 }
 
+/**
+ * @brief Sets the FastCGI server scripts are passed to
+ * @param address "host:port" or "unix:/path" ("" = run CGI processes)
+ */
+void LocationConfig::setFastcgiPass(const std::string &address) {
+  _fastcgiPass = address;
+}
+
+/**
+ * @brief Sets how many cgi_path workers serve the fastcgi_pass socket
+ * @param count Worker count (0 = external FastCGI server)
+ */
+void LocationConfig::setFastcgiWorkers(int count) { _fastcgiWorkers = count; }
+
+/**
+ * @brief Stores the CGI variables rendered once at config load
+ * @param envTemplate CGIEnvironment::buildTemplate() of the server port
+ */
+void LocationConfig::setCgiEnvTemplate(const std::string &envTemplate) {
+  _cgiEnvTemplate = envTemplate;
+}
+
+/**
+ * @brief Sets the backends requests are forwarded to
+ * @param proxyPass Resolved by ConfigBuilder (upstream block or address)
+ */
+void LocationConfig::setProxyPass(const ProxyPass &proxyPass) {
+  _proxyPass = proxyPass;
+}
+
+/**
+ * @brief Sets the cgi_cache settings
+ * @param policy Built by ConfigBuilder::parseCGICache()
+ */
+void LocationConfig::setCGICache(const CGICachePolicy &policy) {
+  _cgiCache = policy;
+}
+
+/**
+ * @brief Sets the limit_req settings
+ * @param limit Built by ConfigBuilder::parseLimitReq()
+ */
+void LocationConfig::setLimitReq(const LimitReq &limit) { _limitReq = limit; }
+
+/**
+ * @brief Sets the limit_rate settings
+ * @param limit Built by ConfigBuilder::parseLimitRate()
+ */
+void LocationConfig::setLimitRate(const LimitRate &limit) {
+  _limitRate = limit;
+}
+
 /**
  * @brief Sets custom error page mappings
  * @param errorPages Map of HTTP error codes to HTML file paths
@@ -425,6 +563,14 @@ void LocationConfig::setUploadPath(const std::string &uploadPath) {
   _uploadPath = uploadPath;
 }
 
+/**
+ * @brief Sets upload preallocation mode
+ * @param preallocate true to reserve Content-Length bytes when upload starts
+ */
+void LocationConfig::setUploadPreallocate(bool preallocate) {
+  _uploadPreallocate = preallocate;
+}
+
 /**
  * @brief Sets the alias path for this location
  * @param alias Path to use as alias
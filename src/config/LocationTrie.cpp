@@ -0,0 +1,222 @@
+#include "../../includes/config/LocationTrie.hpp"
+/**
+ * @file LocationTrie.cpp
+ * @brief Compiled location router - radix tree of location patterns
+ *
+ * Location matching used to compare the request path with every location
+ * pattern of the server, on every request. ServerConfig now compiles its
+ * patterns into this tree once (setLocations()), and a lookup walks the
+ * path a single time.
+ *
+ * Example - locations "/", "/api" and "/assets" (indices 0, 1, 2):
+ *   root ── "/" [0] ── "a" ──┬── "pi" [1]
+ *                            └── "ssets" [2]
+ *
+ * Each edge carries a byte string; a node shared by two patterns is split
+ * where they diverge. A node where a pattern ends stores its index.
+ *
+ * Matching rules (same as the former linear scan):
+ * - Plain byte prefix: "/api" also matches "/apiv2"
+ * - The longest matching pattern wins
+ * - Duplicate patterns: the first block wins
+ * - An empty pattern never matches
+ *
+ * @note Exact ("=") and regex locations would be extra node fields or a
+ *       pass before/after the walk; the parser has neither yet
+ */
+
+static const size_t NO_NODE = static_cast<size_t>(-1);
+
+/**
+ * @brief Default constructor - tree with only the root
+ */
+LocationTrie::LocationTrie()
+{
+    Node root;
+    root.location = -1;
+    _nodes.push_back(root);
+}
+
+/**
+ * @brief Copy constructor - copies every node
+ * @param other Tree to copy
+ */
+LocationTrie::LocationTrie(const LocationTrie &other) : _nodes(other._nodes)
+{
+}
+
+/**
+ * @brief Assignment operator - copies every node
+ * @param other Tree to copy
+ * @return Reference to this object
+ */
+LocationTrie &LocationTrie::operator=(const LocationTrie &other)
+{
+    if (this != &other)
+        _nodes = other._nodes;
+    return *this;
+}
+
+/**
+ * @brief Destructor - nodes are released by the vector
+ */
+LocationTrie::~LocationTrie()
+{
+}
+
+/**
+ * @brief Finds the child whose label starts with a byte (binary search)
+ *
+ * @param node Parent node index
+ * @param c First byte of the wanted edge
+ * @return Child index, or NO_NODE
+ */
+size_t LocationTrie::findChild(size_t node, unsigned char c) const
+{
+    const std::vector<size_t> &children = _nodes[node].children;
+    size_t low = 0;
+    size_t high = children.size();
+
+    while (low < high)
+    {
+        size_t mid = (low + high) / 2;
+        unsigned char first =
+            static_cast<unsigned char>(_nodes[children[mid]].label[0]);
+        if (first == c)
+            return children[mid];
+        if (first < c)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return NO_NODE;
+}
+
+/**
+ * @brief Adds a child node, keeping the children sorted
+ *
+ * @param node Parent node index
+ * @param label Edge bytes (not empty)
+ * @param location Location index stored in the child (-1 = none)
+ * @return Index of the new node
+ */
+size_t LocationTrie::addChild(size_t node, const std::string &label,
+                              int location)
+{
+    Node child;
+    child.label = label;
+    child.location = location;
+    _nodes.push_back(child);
+    size_t index = _nodes.size() - 1;
+
+    std::vector<size_t> &children = _nodes[node].children;
+    std::vector<size_t>::iterator it = children.begin();
+    while (it != children.end() &&
+           static_cast<unsigned char>(_nodes[*it].label[0]) <
+               static_cast<unsigned char>(label[0]))
+        ++it;
+    children.insert(it, index);
+    return index;
+}
+
+/**
+ * @brief Splits a node's label in two
+ *
+ * The node keeps label[0, at); a new child gets the rest of the label with
+ * the node's location and children.
+ *
+ * @param node Node index
+ * @param at Split offset (0 < at < label size)
+ */
+void LocationTrie::split(size_t node, size_t at)
+{
+    Node tail;
+    tail.label = _nodes[node].label.substr(at);
+    tail.location = _nodes[node].location;
+    tail.children.swap(_nodes[node].children);
+    _nodes.push_back(tail);
+
+    Node &head = _nodes[node];
+    head.label.erase(at);
+    head.location = -1;
+    head.children.push_back(_nodes.size() - 1);
+}
+
+/**
+ * @brief Inserts one pattern
+ *
+ * @param pattern Location pattern (not empty)
+ * @param location Its index in the locations vector
+ */
+void LocationTrie::insert(const std::string &pattern, int location)
+{
+    size_t node = 0;
+    size_t pos = 0;
+
+    while (pos < pattern.size())
+    {
+        size_t child =
+            findChild(node, static_cast<unsigned char>(pattern[pos]));
+        if (child == NO_NODE)
+        {
+            addChild(node, pattern.substr(pos), location);
+            return;
+        }
+        const std::string &label = _nodes[child].label;
+        size_t common = 0;
+        while (common < label.size() && pos + common < pattern.size() &&
+               label[common] == pattern[pos + common])
+            ++common;
+        if (common < label.size())
+            split(child, common);
+        node = child;
+        pos += common;
+    }
+    if (_nodes[node].location == -1) // Duplicate pattern: first one wins
+        _nodes[node].location = location;
+}
+
+/**
+ * @brief Compiles the patterns of a server's locations
+ *
+ * @param locations Location blocks, in configuration order
+ */
+void LocationTrie::build(const std::vector<LocationConfig> &locations)
+{
+    _nodes.resize(1);
+    _nodes[0].children.clear();
+    _nodes[0].location = -1;
+    for (size_t i = 0; i < locations.size(); ++i)
+    {
+        if (!locations[i].getPattern().empty())
+            insert(locations[i].getPattern(), static_cast<int>(i));
+    }
+}
+
+/**
+ * @brief Longest-prefix match of a request path
+ *
+ * @param path Request URL path
+ * @return Index of the matched location, or -1 if none matches
+ */
+int LocationTrie::match(const std::string &path) const
+{
+    int best = -1;
+    size_t node = 0;
+    size_t pos = 0;
+
+    while (pos < path.size())
+    {
+        size_t child = findChild(node, static_cast<unsigned char>(path[pos]));
+        if (child == NO_NODE)
+            break;
+        const std::string &label = _nodes[child].label;
+        if (path.compare(pos, label.size(), label) != 0)
+            break;
+        pos += label.size();
+        node = child;
+        if (_nodes[node].location != -1)
+            best = _nodes[node].location;
+    }
+    return best;
+}
@@ -29,6 +29,9 @@
  * - Request limits (max body size)
  * - Location blocks (vector of LocationConfig for routing)
  *
+ * Plus the location patterns compiled into a LocationTrie, rebuilt by
+ * setLocations() and copied along with the locations.
+ *
  * Hierarchical structure:
  *   ServerConfig (1 server)
  *       └── Contains multiple LocationConfig (N locations)
@@ -57,6 +60,12 @@
  *
  * Default values:
  * - _listen = 0 (unset, must be configured)
+ * - _defaultServer = false (the port's first block is its default)
+ * - _listenOptions = defaults (SOMAXCONN backlog, no deferred/fastopen,
+ *   kernel socket buffer sizes)
+ * - _tcpNoDelay = true (small responses are not held back by Nagle)
+ * - _tcpNoPush = false (no TCP_CORK around file bodies)
+ * - _ssl = no certificate, 20480 cached sessions, tickets on, 300 s
  * - _host = "" (empty, typically "127.0.0.1" or "0.0.0.0")
  * - _serverNames = [] (empty vector, should have at least one name)
  * - _root = "" (empty, should be set for static file serving)
@@ -72,7 +81,9 @@
  * @note _listen = 0 is used as sentinel (invalid port, must be set)
  * @note Called by ConfigBuilder when creating new server configurations
  */
-ServerConfig::ServerConfig() : _listen(0), _clientMaxBodySize(1048576)
+ServerConfig::ServerConfig()
+    : _listen(0), _defaultServer(false), _tcpNoDelay(true), _tcpNoPush(false),
+      _clientMaxBodySize(1048576)
 {
 }
 
@@ -101,13 +112,17 @@ ServerConfig::ServerConfig() : _listen(0), _clientMaxBodySize(1048576)
  *
  * @param other ServerConfig to copy from
  *
- * @note All 8 members copied in initialization list
+ * @note All members (and the compiled trie) copied in initialization list
  * @note Locations vector performs deep copy of all LocationConfig objects
  */
 ServerConfig::ServerConfig(const ServerConfig &other)
-    : _listen(other._listen), _host(other._host), _serverNames(other._serverNames),
-      _root(other._root), _index(other._index), _errorPages(other._errorPages),
-      _clientMaxBodySize(other._clientMaxBodySize), _locations(other._locations)
+    : _listen(other._listen), _defaultServer(other._defaultServer),
+      _listenOptions(other._listenOptions), _tcpNoDelay(other._tcpNoDelay),
+      _tcpNoPush(other._tcpNoPush), _ssl(other._ssl), _host(other._host),
+      _serverNames(other._serverNames), _root(other._root),
+      _index(other._index), _errorPages(other._errorPages),
+      _clientMaxBodySize(other._clientMaxBodySize),
+      _locations(other._locations), _locationTrie(other._locationTrie)
 {
 }
 
@@ -143,6 +158,11 @@ ServerConfig &ServerConfig::operator=(const ServerConfig &other)
     if (this != &other)
     {
         _listen = other._listen;
+        _defaultServer = other._defaultServer;
+        _listenOptions = other._listenOptions;
+        _tcpNoDelay = other._tcpNoDelay;
+        _tcpNoPush = other._tcpNoPush;
+        _ssl = other._ssl;
         _host = other._host;
         _serverNames = other._serverNames;
         _root = other._root;
@@ -150,6 +170,7 @@ ServerConfig &ServerConfig::operator=(const ServerConfig &other)
         _errorPages = other._errorPages;
         _clientMaxBodySize = other._clientMaxBodySize;
         _locations = other._locations;
+        _locationTrie = other._locationTrie;
     }
     return *this;
 }
@@ -257,6 +278,65 @@ const std::vector<LocationConfig> &ServerConfig::getLocations() const
     return _locations;
 }
 
+/**
+ * @brief Finds the location whose pattern is the longest prefix of path
+ * @param path Request URL path
+ * @return Matched LocationConfig pointer, or NULL if no match
+ * @note Walks the compiled LocationTrie: O(path length), whatever the
+ *       number of location blocks
+ */
+const LocationConfig *ServerConfig::matchLocation(const std::string &path) const
+{
+    int index = _locationTrie.match(path);
+    return index < 0 ? NULL : &_locations[index];
+}
+
+/**
+ * @brief Whether this block is its port's default server
+ * @return true if declared with "listen <port> default_server"
+ * @note Requests whose Host matches no server_name of the port go to it
+ */
+bool ServerConfig::isDefaultServer() const
+{
+    return _defaultServer;
+}
+
+/**
+ * @brief Socket options of this block's listen directive
+ * @return backlog / deferred / fastopen, defaults if none was given
+ */
+const ListenOptions &ServerConfig::getListenOptions() const
+{
+    return _listenOptions;
+}
+
+/**
+ * @brief Whether accepted sockets get TCP_NODELAY ("tcp_nodelay")
+ * @return true unless "tcp_nodelay off"
+ */
+bool ServerConfig::getTcpNoDelay() const
+{
+    return _tcpNoDelay;
+}
+
+/**
+ * @brief Whether file bodies are sent corked ("tcp_nopush")
+ * @return true with "tcp_nopush on"
+ */
+bool ServerConfig::getTcpNoPush() const
+{
+    return _tcpNoPush;
+}
+
+/**
+ * @brief TLS settings, used when the block listens with "ssl"
+ * @return Certificate paths and session resumption settings
+ */
+const SslSettings &ServerConfig::getSsl() const
+{
+    return _ssl;
+}
+
 // ==================== SETTERS ====================
 
 /**
@@ -269,6 +349,51 @@ void ServerConfig::setListen(int listen)
     _listen = listen;
 }
 
+/**
+ * @brief Marks this block as its port's default server
+ * @param defaultServer true for "listen <port> default_server"
+ */
+void ServerConfig::setDefaultServer(bool defaultServer)
+{
+    _defaultServer = defaultServer;
+}
+
+/**
+ * @brief Sets the socket options of this block's listen directive
+ * @param options Parsed "backlog=N", "deferred" and "fastopen=N"
+ */
+void ServerConfig::setListenOptions(const ListenOptions &options)
+{
+    _listenOptions = options;
+}
+
+/**
+ * @brief Sets the "tcp_nodelay" flag
+ * @param tcpNoDelay true to disable Nagle on accepted sockets
+ */
+void ServerConfig::setTcpNoDelay(bool tcpNoDelay)
+{
+    _tcpNoDelay = tcpNoDelay;
+}
+
+/**
+ * @brief Sets the "tcp_nopush" flag
+ * @param tcpNoPush true to cork header + sendfile() bodies
+ */
+void ServerConfig::setTcpNoPush(bool tcpNoPush)
+{
+    _tcpNoPush = tcpNoPush;
+}
+
+/**
+ * @brief Sets the ssl_* directives of the block
+ * @param ssl Parsed ssl_certificate(_key) and ssl_session_* values
+ */
+void ServerConfig::setSsl(const SslSettings &ssl)
+{
+    _ssl = ssl;
+}
+
 /**
  * @brief Sets server bind host address
  * @param host IP address to bind to
@@ -333,8 +458,20 @@ void ServerConfig::setClientMaxBodySize(size_t clientMaxBodySize)
  * @brief Sets all location blocks for this server
  * @param locations Vector of LocationConfig objects
  * @note Each location defines routing rules for URI patterns
+ * @note Also compiles the patterns for matchLocation()
  */
 void ServerConfig::setLocations(const std::vector<LocationConfig> &locations)
 {
     _locations = locations;
+    _locationTrie.build(_locations);
+}
+
+/**
+ * @brief Sets the location blocks, taking the vector over
+ * @param locations Locations built by ConfigBuilder (left empty)
+ */
+void ServerConfig::takeLocations(std::vector<LocationConfig> &locations)
+{
+    _locations.swap(locations);
+    _locationTrie.build(_locations);
 }
\ No newline at end of file
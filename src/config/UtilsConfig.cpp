@@ -11,6 +11,8 @@
  *
  * Current utilities:
  * - stringToInt() - Converts string to integer (C++98 safe)
+ * - parseDuration() - Converts nginx time values ("20s", "5m") to seconds
+ * - parseSize() - Converts nginx size values ("8k", "4m") to bytes
  *
  * Design rationale:
  * - Centralized conversions prevent code duplication
@@ -69,4 +71,127 @@ int stringToInt(const std::string &value)
     int number = 0;
     ss >> number;
     return number;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Converts an nginx-style time value to seconds
+ *
+ * Accepted forms: plain seconds ("30") or a number followed by one unit
+ * suffix: s (seconds), m (minutes), h (hours), d (days).
+ *
+ * Examples:
+ *   parseDuration("20")   → 20
+ *   parseDuration("20s")  → 20
+ *   parseDuration("5m")   → 300
+ *   parseDuration("1h")   → 3600
+ *   parseDuration("abc")  → -1
+ *
+ * @param value Time string from the configuration file
+ * @return Seconds, or -1 if value is not a valid time
+ */
+int parseDuration(const std::string &value)
+{
+    if (value.empty())
+        return -1;
+
+    size_t digits = 0;
+    while (digits < value.size() && value[digits] >= '0' && value[digits] <= '9')
+        ++digits;
+    if (digits == 0 || digits + 1 < value.size())
+        return -1;
+
+    int number = stringToInt(value.substr(0, digits));
+    if (digits == value.size())
+        return number;
+
+    switch (value[digits])
+    {
+    case 's':
+        return number;
+    case 'm':
+        return number * 60;
+    case 'h':
+        return number * 3600;
+    case 'd':
+        return number * 86400;
+    default:
+        return -1;
+    }
+}
+
+/**
+ * @brief Converts an nginx-style time value to milliseconds
+ *
+ * Same forms as parseDuration(), plus the ms suffix.
+ *
+ * Examples:
+ *   parseMilliseconds("250ms") → 250
+ *   parseMilliseconds("2s")    → 2000
+ *   parseMilliseconds("2")     → 2000
+ *   parseMilliseconds("ms")    → -1
+ *
+ * @param value Time string from the configuration file
+ * @return Milliseconds, or -1 if value is not a valid time
+ */
+long parseMilliseconds(const std::string &value)
+{
+    if (value.size() > 2 && value.compare(value.size() - 2, 2, "ms") == 0)
+    {
+        int number = parseDuration(value.substr(0, value.size() - 2));
+        if (number < 0 || value[value.size() - 3] < '0' || value[value.size() - 3] > '9')
+            return -1;
+        return number;
+    }
+    int seconds = parseDuration(value);
+    if (seconds < 0)
+        return -1;
+    return seconds * 1000L;
+}
+
+/**
+ * @brief Converts an nginx-style size value to bytes
+ *
+ * Accepted forms: plain bytes ("512") or a number followed by one unit
+ * suffix, case-insensitive: k (KiB), m (MiB), g (GiB).
+ *
+ * Examples:
+ *   parseSize("512") → 512
+ *   parseSize("8k")  → 8192
+ *   parseSize("4M")  → 4194304
+ *   parseSize("x")   → -1
+ *
+ * @param value Size string from the configuration file
+ * @return Bytes, or -1 if value is not a valid size
+ */
+long parseSize(const std::string &value)
+{
+    if (value.empty())
+        return -1;
+
+    size_t digits = 0;
+    while (digits < value.size() && value[digits] >= '0' && value[digits] <= '9')
+        ++digits;
+    if (digits == 0 || digits + 1 < value.size())
+        return -1;
+
+    std::stringstream ss(value.substr(0, digits));
+    long number = 0;
+    ss >> number;
+    if (digits == value.size())
+        return number;
+
+    switch (value[digits])
+    {
+    case 'k':
+    case 'K':
+        return number * 1024L;
+    case 'm':
+    case 'M':
+        return number * 1024L * 1024L;
+    case 'g':
+    case 'G':
+        return number * 1024L * 1024L * 1024L;
+    default:
+        return -1;
+    }
+}
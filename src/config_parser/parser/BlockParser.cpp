@@ -1,10 +1,11 @@
 #include "../../../includes/config_parser/parser/BlockParser.hpp"
+#include "../../../includes/config_parser/parser/ConfigReader.hpp"
 #include "../../../includes/config_parser/parser/UtilsConfigParser.hpp"
 #include "../../../includes/config_parser/validation/DirectiveMetadata.hpp"
 #include <string>
 #include <iostream>
-#include <fstream>
 #include <sstream>
+#include <stdexcept>
 
 /**
  * @brief Default constructor - creates an empty block
@@ -41,6 +42,7 @@ BlockParser &BlockParser::operator=(const BlockParser &other)
         name = other.name;
         directives = other.directives;
         nestedBlocks = other.nestedBlocks;
+        directiveIndex = other.directiveIndex;
     }
     return *this;
 }
@@ -59,7 +61,7 @@ BlockParser::~BlockParser()
  *
  * @return Block name (e.g., "http", "server", "location /api")
  */
-std::string BlockParser::getName() const
+const std::string &BlockParser::getName() const
 {
     return name;
 }
@@ -67,12 +69,12 @@ std::string BlockParser::getName() const
 /**
  * @brief Gets all directives contained in this block
  *
- * Returns a copy of the directives vector. Does not include directives
- * from nested blocks.
+ * Returns a const reference (no copy of the subtree). Does not include
+ * directives from nested blocks.
  *
  * @return Vector of DirectiveToken objects
  */
-std::vector<DirectiveToken> BlockParser::getDirectives() const
+const std::vector<DirectiveToken> &BlockParser::getDirectives() const
 {
     return directives;
 }
@@ -80,16 +82,34 @@ std::vector<DirectiveToken> BlockParser::getDirectives() const
 /**
  * @brief Gets all nested blocks (children) of this block
  *
- * Returns a copy of the nested blocks vector. For recursive traversal
- * of the entire configuration tree.
+ * Returns a const reference (no copy of the subtree). For recursive
+ * traversal of the entire configuration tree.
  *
  * @return Vector of BlockParser objects
  */
-std::vector<BlockParser> BlockParser::getNestedBlocks() const
+const std::vector<BlockParser> &BlockParser::getNestedBlocks() const
 {
     return nestedBlocks;
 }
 
+/**
+ * @brief Finds a directive of this block by name
+ *
+ * Looks the name up in the index kept by addDirective() instead of
+ * scanning the directives. As the scans it replaces, skips directives
+ * without values and returns the first occurrence.
+ *
+ * @param directiveName Name of the directive (e.g., "root")
+ * @return The directive, or NULL if the block has none with values
+ */
+const DirectiveToken *BlockParser::findDirective(const std::string &directiveName) const
+{
+    std::map<std::string, size_t>::const_iterator it = directiveIndex.find(directiveName);
+    if (it == directiveIndex.end())
+        return NULL;
+    return &directives[it->second];
+}
+
 /**
  * @brief Gets the line number where the block starts
  *
@@ -143,6 +163,21 @@ void BlockParser::setEndLine(int line)
 void BlockParser::addDirective(const DirectiveToken &directive)
 {
     directives.push_back(directive);
+    indexDirective(directives.size() - 1);
+}
+
+/**
+ * @brief Records a new directive in the name index
+ *
+ * Only the first occurrence with values is kept (see findDirective()).
+ *
+ * @param position Index of the directive in directives
+ */
+void BlockParser::indexDirective(size_t position)
+{
+    const DirectiveToken &directive = directives[position];
+    if (!directive.values.empty())
+        directiveIndex.insert(std::make_pair(directive.name, position));
 }
 
 /**
@@ -158,6 +193,47 @@ void BlockParser::addNest(const BlockParser &nest)
     nestedBlocks.push_back(nest);
 }
 
+/**
+ * @brief Appends an empty nested block, to be parsed in place
+ *
+ * The parser fills the returned block directly instead of copying a
+ * finished subtree into its parent.
+ *
+ * @param nestName Name of the nested block (e.g., "location /api")
+ * @param start Line number where the block starts
+ * @return The new block (valid until the next addNest() on this block)
+ */
+BlockParser &BlockParser::addNest(const std::string &nestName, int start)
+{
+    nestedBlocks.push_back(BlockParser(nestName, start));
+    return nestedBlocks.back();
+}
+
+/**
+ * @brief Appends a directive from its tokens
+ *
+ * tokens[0] is the name, the rest are the values; the strings are
+ * swapped into the new DirectiveToken rather than copied.
+ *
+ * @param tokens Tokens of the directive (left empty or moved-from)
+ * @param lineNumber Line number reported for the directive
+ * @return false if tokens is empty
+ */
+bool BlockParser::addDirective(std::vector<std::string> &tokens, int lineNumber)
+{
+    if (tokens.empty())
+        return false;
+    directives.push_back(DirectiveToken());
+    DirectiveToken &directive = directives.back();
+    directive.name.swap(tokens[0]);
+    directive.values.resize(tokens.size() - 1);
+    for (size_t i = 1; i < tokens.size(); ++i)
+        directive.values[i - 1].swap(tokens[i]);
+    directive.lineNumber = lineNumber;
+    indexDirective(directives.size() - 1);
+    return true;
+}
+
 /**
  * @brief Checks if a line starts with a known directive
  *
@@ -185,50 +261,30 @@ static bool isDirectiveStart(const std::string &line)
 }
 
 /**
- * @brief Recursively parses a configuration block from a file stream
+ * @brief Recursively parses the body of a configuration block
  *
- * Reads lines from the file until the closing brace '}' is found.
+ * Takes lines from the reader until the closing brace '}' is found.
  * Handles:
  * - Multi-line directives (accumulated until ';')
- * - Nested blocks (recursive parseBlock calls)
- * - Inline and full-line comments (stripped out)
+ * - Nested blocks (recursive parseBlock calls, filled in place)
  * - Syntax validation (unterminated directives, missing semicolons)
+ * Comments and blank lines never reach here (see ConfigReader).
  *
  * The function modifies the lineNumber reference to track the current
  * position in the file during recursive parsing.
  *
- * @param file Input file stream (must be open and readable)
- * @param blockName Name of the block being parsed (e.g., "server", "location /")
+ * @param reader Configuration file being walked
+ * @param block Block to fill (name and start line already set)
  * @param lineNumber Reference to current line number (modified during parsing)
- * @return BlockParser object containing all parsed directives and nested blocks
  * @throw std::runtime_error if syntax errors are detected (unterminated directives, etc.)
  */
-BlockParser BlockParser::parseBlock(std::ifstream &file, const std::string &blockName, int &lineNumber)
+void BlockParser::parseBlock(ConfigReader &reader, BlockParser &block, int &lineNumber)
 {
-    DirectiveParser parser;
-    BlockParser block(blockName, lineNumber);
-
-    std::string line;
+    std::string trimmed;
     std::string accumulated;
     int directiveStartLine = 0;
-    while (std::getline(file, line))
+    while (reader.nextLine(trimmed, lineNumber))
     {
-        lineNumber++;
-
-        std::string trimmed = trimLine(line);
-
-        if (isEmptyOrComment(trimmed))
-            continue;
-        // Strip inline comments
-        size_t commentPos = trimmed.find('#');
-        if (commentPos != std::string::npos)
-        {
-            trimmed = trimmed.substr(0, commentPos);
-            trimmed = trimLine(trimmed);
-        }
-
-        if (trimmed.empty())
-            continue;
         // Detect unterminated directive (missing semicolon)
         if (!accumulated.empty() && isDirectiveStart(trimmed))
         {
@@ -256,27 +312,21 @@ BlockParser BlockParser::parseBlock(std::ifstream &file, const std::string &bloc
                 throw std::runtime_error(message2.str());
             }
             block.setEndLine(lineNumber);
-            const std::vector<DirectiveToken> &parsed = parser.getDirectives();
-            for (size_t i = 0; i < parsed.size(); ++i)
-                block.addDirective(parsed[i]);
-            return block;
+            return;
         }
         // Nested block opening
         else if (trimmed[trimmed.size() - 1] == '{')
         {
-            std::string blockLine = accumulated;
-            std::string childName = blockLine.substr(0, blockLine.size() - 1);
-            childName = trimLine(childName);
-            BlockParser child = parseBlock(file, childName, lineNumber);
-            block.addNest(child);
+            std::string childName = trimLine(accumulated.substr(0, accumulated.size() - 1));
+            parseBlock(reader, block.addNest(childName, lineNumber), lineNumber);
             accumulated.clear();
         }
         // Directive ending
         else if (trimmed[trimmed.size() - 1] == ';')
         {
-            accumulated = accumulated.substr(0, accumulated.size() - 1);
+            accumulated.erase(accumulated.size() - 1);
             std::vector<std::string> tokens = tokenize(accumulated, lineNumber);
-            if (!parser.parseDirective(tokens, lineNumber))
+            if (!block.addDirective(tokens, lineNumber))
             {
                 std::stringstream message3;
                 message3 << "⚠️ Error parsing directive: " << trimmed << " at line: " << lineNumber << "\n";
@@ -293,7 +343,6 @@ BlockParser BlockParser::parseBlock(std::ifstream &file, const std::string &bloc
                  << "  Start at line: " << directiveStartLine << "\n  Content: " << accumulated << "\n";
         throw std::runtime_error(message4.str());
     }
-    return block;
 }
 
 /**
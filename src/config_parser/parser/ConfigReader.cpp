@@ -0,0 +1,140 @@
+#include "../../../includes/config_parser/parser/ConfigReader.hpp"
+#include "../../../includes/config_parser/validation/ValidationStructureConfig.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Maps a configuration file for reading
+ *
+ * The mapping is private and read-only; an empty file maps nothing and
+ * simply has no lines. isOpen() tells whether the file could be read.
+ *
+ * @param filePath Path to the configuration file
+ */
+ConfigReader::ConfigReader(const std::string &filePath)
+    : _path(filePath), _data(NULL), _size(0), _pos(0), _lineNumber(0),
+      _open(false), _openBraces(0), _closeBraces(0), _firstOpenLine(0),
+      _lastCloseLine(0)
+{
+    int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+    {
+        _size = static_cast<size_t>(info.st_size);
+        if (_size == 0)
+            _open = true;
+        else
+        {
+            void *data = mmap(NULL, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+            {
+                _data = static_cast<const char *>(data);
+                _open = true;
+            }
+        }
+    }
+    close(fd); // The mapping stays valid
+}
+
+/**
+ * @brief Destructor - unmaps the file
+ */
+ConfigReader::~ConfigReader()
+{
+    if (_data)
+        munmap(const_cast<char *>(_data), _size);
+}
+
+bool ConfigReader::isOpen() const
+{
+    return _open;
+}
+
+/**
+ * @brief Returns the next line holding something else than a comment
+ *
+ * Same rules as trimLine() / isEmptyOrComment() and the inline comment
+ * stripping of the parser, applied in place on the mapping: only the
+ * significant part of the line is copied out. Each line returned also
+ * goes through the checks of validateStructure() (orphan '{' or ';',
+ * characters, brace counts).
+ *
+ * @param line Receives the trimmed line without its comment
+ * @param lineNumber Receives the line number
+ * @return false once the whole file was walked
+ */
+bool ConfigReader::nextLine(std::string &line, int &lineNumber)
+{
+    while (_pos < _size)
+    {
+        const char *begin = _data + _pos;
+        const char *newline =
+            static_cast<const char *>(std::memchr(begin, '\n', _size - _pos));
+        const char *end = newline ? newline : _data + _size;
+        _pos = newline ? _pos + (newline - begin) + 1 : _size;
+        ++_lineNumber;
+
+        while (begin < end && (*begin == ' ' || *begin == '\t' || *begin == '\r'))
+            ++begin;
+        if (begin == end || *begin == '#')
+            continue;
+        const char *comment =
+            static_cast<const char *>(std::memchr(begin, '#', end - begin));
+        if (comment)
+            end = comment;
+        while (end > begin &&
+               (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+            --end;
+        if (begin == end)
+            continue;
+
+        line.assign(begin, end);
+        lineNumber = _lineNumber;
+        checkEmptyBraceOrSemicolon(line, _lineNumber, _path, _errors);
+        checkInvalidCharacters(line, _lineNumber, _errors);
+        processConfigLine(line, _lineNumber, _openBraces, _closeBraces,
+                          _firstOpenLine, _lastCloseLine);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Walks the lines the parser did not take (it stopped on an error)
+ *
+ * Structural errors take precedence over parse errors: they are found
+ * anywhere in the file, as when the file was validated before parsing.
+ */
+void ConfigReader::drain()
+{
+    std::string line;
+    int lineNumber;
+    while (nextLine(line, lineNumber))
+        ;
+}
+
+/**
+ * @brief Structural errors of the file (once it was walked to the end)
+ *
+ * @param errors Receives the error messages
+ * @return true if the structure is valid
+ */
+bool ConfigReader::checkStructure(std::vector<std::string> &errors) const
+{
+    errors.insert(errors.end(), _errors.begin(), _errors.end());
+    if (!_open)
+        errors.push_back("Error: Cannot open file '" + _path + "'");
+    checkBraceBalance(_openBraces, _closeBraces, _firstOpenLine,
+                      _lastCloseLine, _path, errors);
+    return errors.empty();
+}
+
+int ConfigReader::getLineCount() const
+{
+    return _lineNumber;
+}
@@ -102,60 +102,37 @@ std::vector<std::string> tokenize(const std::string &line, int numLine)
 }
 
 /**
- * @brief Reads and parses a complete nginx-style configuration file
+ * @brief Parses a complete nginx-style configuration file into root
  *
- * Main entry point for parsing. Reads the file line by line, handling:
+ * Main parsing loop. Takes the significant lines of the file from the
+ * reader (already trimmed, comments stripped: see ConfigReader),
+ * handling:
  * - Multi-line directives (accumulated until ';' is found)
  * - Nested blocks (recursive calls to BlockParser::parseBlock)
- * - Comments (full-line and inline, stripped before processing)
- * - Whitespace normalization
  *
- * The function builds a complete configuration tree (BlockParser) containing
- * all directives and nested blocks found in the file.
+ * The tree is built in place: nested blocks are parsed directly into
+ * root, never copied once finished.
  *
  * Process:
- * 1. Read file line by line
- * 2. Trim and skip empty/comment lines
- * 3. Strip inline comments
- * 4. Accumulate multi-line content until ';' or '{'
- * 5. Parse directives (ending with ';')
- * 6. Parse nested blocks (ending with '{') recursively
- * 7. Return complete tree at EOF
+ * 1. Take the next significant line
+ * 2. Accumulate multi-line content until ';' or '{'
+ * 3. Parse directives (ending with ';')
+ * 4. Parse nested blocks (ending with '{') recursively
+ * 5. Stop at EOF
  *
- * @param filePath Path to the configuration file to read
- * @return BlockParser object representing the root of the config tree
- * @throw std::runtime_error if file cannot be opened or syntax errors are found
+ * @param reader Mapped configuration file
+ * @param root Receives the directives and blocks of the file
+ * @throw std::runtime_error if syntax errors are found
  */
-BlockParser readConfigFile(const std::string &filePath)
+void readConfig(ConfigReader &reader, BlockParser &root)
 {
-    std::ifstream file(filePath.c_str());
-    if (!file.is_open())
-        throw std::runtime_error("❌ File can't be open");
-
-    BlockParser root;
-    std::string line;
+    std::string trimmed;
     std::string accumulated;
     int lineNumber = 0;
     int directiveStartLine = 0;
 
-    while (std::getline(file, line))
+    while (reader.nextLine(trimmed, lineNumber))
     {
-        lineNumber++;
-
-        std::string trimmed = trimLine(line);
-        if (isEmptyOrComment(trimmed))
-            continue;
-        // Strip inline comments
-        size_t commentPos = trimmed.find('#');
-        if (commentPos != std::string::npos)
-        {
-            trimmed = trimmed.substr(0, commentPos);
-            trimmed = trimLine(trimmed);
-        }
-
-        if (trimmed.empty())
-            continue;
-
         if (accumulated.empty())
             directiveStartLine = lineNumber;
 
@@ -165,24 +142,16 @@ BlockParser readConfigFile(const std::string &filePath)
         // Block opening
         if (trimmed[trimmed.size() - 1] == '{')
         {
-            std::string blockLine = accumulated;
-            std::string blockName = blockLine.substr(0, blockLine.size() - 1);
-            blockName = trimLine(blockName);
-            BlockParser temp;
-            BlockParser nest = temp.parseBlock(file, blockName, lineNumber);
-            root.addNest(nest);
+            std::string blockName = trimLine(accumulated.substr(0, accumulated.size() - 1));
+            BlockParser::parseBlock(reader, root.addNest(blockName, lineNumber), lineNumber);
             accumulated.clear();
         }
         // Directive ending
         else if (trimmed[trimmed.size() - 1] == ';')
         {
-            DirectiveParser parser;
-            accumulated = accumulated.substr(0, accumulated.size() - 1);
+            accumulated.erase(accumulated.size() - 1);
             std::vector<std::string> tokens = tokenize(accumulated, lineNumber);
-            parser.parseDirective(tokens, directiveStartLine);
-            const std::vector<DirectiveToken> &dirs = parser.getDirectives();
-            for (size_t i = 0; i < dirs.size(); ++i)
-                root.addDirective(dirs[i]);
+            root.addDirective(tokens, directiveStartLine);
             accumulated.clear();
         }
     }
@@ -194,8 +163,25 @@ BlockParser readConfigFile(const std::string &filePath)
                 << "  Started at line: " << directiveStartLine << "\n  Content: " << accumulated;
         throw std::runtime_error(message.str());
     }
+}
+
+/**
+ * @brief Reads and parses a complete configuration file (no validation)
+ *
+ * @param filePath Path to the configuration file to read
+ * @return BlockParser object representing the root of the config tree
+ * @throw std::runtime_error if file cannot be opened or syntax errors are found
+ */
+BlockParser readConfigFile(const std::string &filePath)
+{
+    ConfigReader reader(filePath);
+    if (!reader.isOpen())
+        throw std::runtime_error("❌ File can't be open");
+    BlockParser root;
+    readConfig(reader, root);
     return root;
 }
+
 /**
  * @brief Parses and validates nginx-style configuration file - Main entry point
  *
@@ -205,8 +191,14 @@ BlockParser readConfigFile(const std::string &filePath)
  *
  * === THREE-PHASE VALIDATION PIPELINE ===
  *
- * PHASE 1: Structural Validation (StructuralValidator)
- *   Validates file structure before parsing:
+ * Phases 1 and 2 share a single walk over the memory-mapped file
+ * (ConfigReader): each line is checked structurally as the parser takes
+ * it. Structural errors still win over parse errors, as if phase 1 had
+ * run alone first: when parsing fails, the rest of the file is only
+ * checked, and the structural report decides.
+ *
+ * PHASE 1: Structural Validation (ConfigReader, validateStructure rules)
+ *   Validates file structure:
  *   - Balanced braces { }
  *   - Proper semicolon placement
  *   - No unclosed blocks
@@ -268,23 +260,39 @@ BlockParser readConfigFile(const std::string &filePath)
  * @note Replaces deprecated initConfigParser() which only returned int
  * @note Performs complete validation (structural + semantic)
  * @note Safe to use - all errors reported via exceptions
- * @see validateStructure() for Phase 1 (structural validation)
- * @see readConfigFile() for Phase 2 (parsing)
+ * @see ConfigReader for Phase 1 (structural validation)
+ * @see readConfig() for Phase 2 (parsing)
  * @see SemanticValidator::validate() for Phase 3 (semantic validation)
  * @see ConfigBuilder::buildFromBlockParser() for typical next step
  */
 BlockParser parseAndValidateConfig(const std::string &configPath)
 {
+    // Parsing, with the structural checks on the way
+    ConfigReader reader(configPath);
+    BlockParser root;
+    std::string parseError;
+    if (reader.isOpen())
+    {
+        try
+        {
+            readConfig(reader, root);
+        }
+        catch (std::exception &e)
+        {
+            parseError = e.what();
+            reader.drain(); // Structural errors further down come first
+        }
+    }
+
     // structural validation
     std::vector<std::string> structuralErrors;
-    if (!validateStructure(configPath, structuralErrors))
+    if (!reader.checkStructure(structuralErrors))
     {
         // show errors
         throw std::runtime_error("Structural validation failed");
     }
-
-    // Parsing
-    BlockParser root = readConfigFile(configPath);
+    if (!parseError.empty())
+        throw std::runtime_error(parseError);
 
     // Semantic validation
     SemanticValidator validator;
@@ -68,6 +68,7 @@ void SemanticValidator::clear()
  * - "server" → CTX_SERVER
  * - "location ..." → CTX_LOCATION (prefix match)
  * - "events" → CTX_EVENTS
+ * - "upstream ..." → CTX_UPSTREAM (prefix match)
  * - "" (root) or unknown → CTX_MAIN
  *
  * Note: "location" blocks include their pattern in the name
@@ -86,6 +87,8 @@ Context SemanticValidator::getBlockContext(const std::string &blockName) const
         return CTX_LOCATION;
     if (blockName == "events")
         return CTX_EVENTS;
+    if (blockName.find("upstream ") == 0)
+        return CTX_UPSTREAM;
     return CTX_MAIN;
 }
 
@@ -96,6 +99,7 @@ Context SemanticValidator::getBlockContext(const std::string &blockName) const
  * 1. Checks if directive exists (DirectiveMetadata::getRule)
  * 2. Validates context (DirectiveMetadata::isValidInContext)
  * 3. Validates arguments (DirectiveMetadata::validateArguments - 3 levels)
+ * The rule is looked up once and reused by both checks.
  *
  * Errors are accumulated (not fail-fast). If directive doesn't exist,
  * stops checking context/arguments (no rule to validate against).
@@ -117,7 +121,7 @@ void SemanticValidator::validateDirective(const DirectiveToken &directive, Conte
         return;
     }
     // Validate context
-    if (!DirectiveMetadata::isValidInContext(directive.name, ctx))
+    if (!DirectiveMetadata::isValidInContext(rule, ctx))
     {
         std::stringstream message;
         message << "Error line " << directive.lineNumber
@@ -126,7 +130,7 @@ void SemanticValidator::validateDirective(const DirectiveToken &directive, Conte
         _errors.push_back(message.str());
     }
     // Validate arguments (continue even if context failed)
-    if (!DirectiveMetadata::validateArguments(directive.name, directive.values))
+    if (!DirectiveMetadata::validateArguments(rule, directive.values))
     {
         std::stringstream message;
         message << "Error line " << directive.lineNumber
@@ -162,13 +166,16 @@ void SemanticValidator::validateDirective(const DirectiveToken &directive, Conte
  * - server: must be inside http (CTX_HTTP)
  * - location: must be inside server (CTX_SERVER)
  * - events: must be at root level (CTX_MAIN)
+ * - upstream: must be inside http (CTX_HTTP)
+ * - types: must be inside http (CTX_HTTP); its entries are
+ *   "type/subtype ext...", not directives
  *
  * @param block BlockParser object to validate
  * @param parentCtx Context where this block appears (parent's context)
  */
 void SemanticValidator::validateBlock(const BlockParser &block, Context parentCtx)
 {
-    std::string blockName = block.getName();
+    const std::string &blockName = block.getName();
     Context blockCtx = getBlockContext(blockName);
     if (!blockName.empty())
     {
@@ -230,6 +237,52 @@ void SemanticValidator::validateBlock(const BlockParser &block, Context parentCt
                 _errors.push_back(message.str());
             }
         }
+        // Validate upstream block (named group of proxy_pass backends)
+        else if (blockName.find("upstream ") == 0)
+        {
+            isKnown = true;
+            if (parentCtx != CTX_HTTP)
+            {
+                std::stringstream message;
+                message << "Error line " << block.getStartLine()
+                        << ": 'upstream' block not allowed here (must be inside 'http')";
+                _errors.push_back(message.str());
+            }
+            std::string name = blockName.substr(9); // After "upstream "
+            if (name.empty() || name.find(' ') != std::string::npos)
+            {
+                std::stringstream message;
+                message << "Error line " << block.getStartLine()
+                        << ": Invalid upstream name '" << name << "'";
+                _errors.push_back(message.str());
+            }
+        }
+        // Validate types block (extension → MIME type entries)
+        else if (blockName == "types")
+        {
+            isKnown = true;
+            if (parentCtx != CTX_HTTP)
+            {
+                std::stringstream message;
+                message << "Error line " << block.getStartLine()
+                        << ": 'types' block not allowed here (must be inside 'http')";
+                _errors.push_back(message.str());
+            }
+            const std::vector<DirectiveToken> &entries = block.getDirectives();
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                if (entries[i].name.find('/') == std::string::npos ||
+                    entries[i].values.empty())
+                {
+                    std::stringstream message;
+                    message << "Error line " << entries[i].lineNumber
+                            << ": Invalid types entry '" << entries[i].name
+                            << "' (expected 'type/subtype extension...')";
+                    _errors.push_back(message.str());
+                }
+            }
+            return;
+        }
         // Unknown block detection
         if (!isKnown)
         {
@@ -240,13 +293,13 @@ void SemanticValidator::validateBlock(const BlockParser &block, Context parentCt
         }
     }
     // Validate all directives in this block
-    std::vector<DirectiveToken> directives = block.getDirectives();
+    const std::vector<DirectiveToken> &directives = block.getDirectives();
     for (size_t i = 0; i < directives.size(); ++i)
     {
         validateDirective(directives[i], blockCtx); // Use block's own context
     }
     // Recursively validate all nested blocks
-    std::vector<BlockParser> children = block.getNestedBlocks();
+    const std::vector<BlockParser> &children = block.getNestedBlocks();
     for (size_t i = 0; i < children.size(); ++i)
     {
         validateBlock(children[i], blockCtx); // Block becomes parent of children
@@ -288,7 +341,7 @@ bool SemanticValidator::validate(const BlockParser &rootParser)
     // Validate entire tree
     validateBlock(rootParser, CTX_MAIN);
     // Verify mandatory blocks (nginx requirement)
-    std::vector<BlockParser> children = rootParser.getNestedBlocks();
+    const std::vector<BlockParser> &children = rootParser.getNestedBlocks();
     bool hasHttp = false;
     bool hasEvents = false;
     for (size_t i = 0; i < children.size(); ++i)
@@ -1,11 +1,11 @@
 #include <string>
 #include <iostream>
 #include <sstream>
-#include <fstream>
 #include <vector>
 #include <cctype>
 #include <sstream>
 #include "../../../includes/config_parser/validation/ValidationStructureConfig.hpp"
+#include "../../../includes/config_parser/parser/ConfigReader.hpp"
 #include "../../../includes/config_parser/parser/UtilsConfigParser.hpp"
 
 /**
@@ -254,9 +254,10 @@ void checkBraceBalance(int contOpenKey, int contCloseKey, int firstOpenKey,
  * - Block nesting rules (handled by SemanticValidator)
  * - Argument types (handled by DirectiveMetadata + ValueValidator)
  *
- * Validation process:
- * 1. Open file
- * 2. Read line by line
+ * Validation process (ConfigReader runs steps 2-7 on each line, also
+ * while parseAndValidateConfig() parses the file):
+ * 1. Map the file
+ * 2. Walk it line by line
  * 3. Skip empty lines and comments
  * 4. Strip inline comments
  * 5. Check for valid characters
@@ -273,43 +274,12 @@ void checkBraceBalance(int contOpenKey, int contCloseKey, int firstOpenKey,
  */
 bool validateStructure(const std::string &filePath, std::vector<std::string> &errors)
 {
-    std::ifstream file(filePath.c_str());
-    if (!file.is_open())
+    ConfigReader reader(filePath);
+    if (!reader.isOpen())
     {
         errors.push_back("Error: Cannot open file '" + filePath + "'");
         return false;
     }
-    std::string line;
-    int contOpenKey = 0;
-    int contCloseKey = 0;
-    int firstOpenKey = 0;
-    int lastCloseKey = 0;
-    int lineCont = 1;
-
-    while (std::getline(file, line))
-    {
-        if (!isEmptyOrComment(line))
-        {
-            std::string trimmed = trimLine(line);
-            // Strip inline comments
-            size_t commentPos = trimmed.find('#');
-            if (commentPos != std::string::npos)
-            {
-                trimmed = trimmed.substr(0, commentPos);
-                trimmed = trimLine(trimmed);
-            }
-            if (!trimmed.empty())
-            {
-                checkEmptyBraceOrSemicolon(trimmed, lineCont, filePath, errors);
-                checkInvalidCharacters(trimmed, lineCont, errors);
-                processConfigLine(trimmed, lineCont, contOpenKey, contCloseKey,
-                                  firstOpenKey, lastCloseKey);
-            }
-        }
-        lineCont++;
-    }
-    // Final brace balance check
-    checkBraceBalance(contOpenKey, contCloseKey, firstOpenKey, lastCloseKey,
-                      filePath, errors);
-    return errors.empty();
+    reader.drain();
+    return reader.checkStructure(errors);
 }
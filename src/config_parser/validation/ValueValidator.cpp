@@ -252,4 +252,42 @@ bool isValidBool(const std::string &value)
 bool isValidPattern(const std::string &value)
 {
     return (value[0] == '/' || value[0] == '~' || value[0] == '=' || value[0] == '^');
-}
\ No newline at end of file
+}
+/**
+ * @brief Validates a parameter following the port of a listen directive
+ *
+ * Accepted parameters:
+ * - default_server : Requests matching no server_name go to this block
+ * - backlog=N      : listen() queue length (N >= 1)
+ * - deferred       : TCP_DEFER_ACCEPT, accept() once data has arrived
+ * - fastopen=N     : TCP_FASTOPEN queue length (N >= 1)
+ * - sndbuf=N       : SO_SNDBUF in bytes (N >= 1)
+ * - rcvbuf=N       : SO_RCVBUF in bytes (N >= 1)
+ * - http2          : HTTP/2 besides HTTP/1.1 (h2c, or h2 with ssl)
+ * - ssl            : TLS on the port (ssl_certificate required)
+ *
+ * Valid examples:   "default_server", "backlog=4096", "sndbuf=262144"
+ * Invalid examples: "backlog=", "backlog=0", "fastopen=-1", "reuseport"
+ *
+ * @param value String to validate as listen parameter
+ * @return true if value is one of the parameters above, false otherwise
+ */
+bool isValidListenParam(const std::string &value)
+{
+    if (value == "default_server" || value == "deferred"
+        || value == "http2" || value == "ssl")
+        return true;
+    std::string number;
+    if (value.compare(0, 8, "backlog=") == 0)
+        number = value.substr(8);
+    else if (value.compare(0, 9, "fastopen=") == 0)
+        number = value.substr(9);
+    else if (value.compare(0, 7, "sndbuf=") == 0
+             || value.compare(0, 7, "rcvbuf=") == 0)
+        number = value.substr(7);
+    else
+        return false;
+    if (number.empty() || number.size() > 9 || !isValidNumber(number))
+        return false;
+    return atoi(number.c_str()) >= 1;
+}
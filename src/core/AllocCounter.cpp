@@ -0,0 +1,49 @@
+#include "core/AllocCounter.hpp"
+#include <cstdlib>
+#include <new>
+
+/**
+ * @file AllocCounter.cpp
+ * @brief Counting replacement of the global operator new (debug builds)
+ *
+ * Used to check that the steady-state request path does not touch the
+ * heap: build with `make re COUNT_ALLOCS=1` and every connection logs the
+ * allocations made for each response it sends (see
+ * ClientConnection::onResponseSent()).
+ *
+ * Only the call count is kept; the replacement forwards to malloc()/free().
+ *
+ * @note Single-threaded per process, like the rest of the event loop
+ */
+
+#ifdef WEBSERV_COUNT_ALLOCS
+
+static unsigned long g_allocations = 0;
+
+void *operator new(size_t size) throw(std::bad_alloc) {
+  ++g_allocations;
+  void *ptr = std::malloc(size ? size : 1);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void *operator new[](size_t size) throw(std::bad_alloc) {
+  return operator new(size);
+}
+
+void operator delete(void *ptr) throw() { std::free(ptr); }
+
+void operator delete[](void *ptr) throw() { std::free(ptr); }
+
+bool AllocCounter::enabled() { return true; }
+
+unsigned long AllocCounter::count() { return g_allocations; }
+
+#else
+
+bool AllocCounter::enabled() { return false; }
+
+unsigned long AllocCounter::count() { return 0; }
+
+#endif
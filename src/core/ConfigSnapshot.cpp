@@ -0,0 +1,101 @@
+#include "core/ConfigSnapshot.hpp"
+
+/**
+ * @file ConfigSnapshot.cpp
+ * @brief Shared, immutable configuration of the running server
+ *
+ * Every accepted connection used to deep-copy the server blocks of its
+ * port (locations, error page maps, index vectors...), so accept latency
+ * and per-connection memory grew with the configuration. Everything
+ * derived from a configuration load now lives in one snapshot:
+ *
+ * - the server blocks, and per port the blocks listening on it
+ * - the per-port server_name tables (VirtualHostTable)
+ * - the pre-rendered error_page files (ErrorPageCache)
+ * - the certificates of the "ssl" ports (TlsContext)
+ *
+ * A connection keeps a pointer to its port's ListenerConfig plus one
+ * reference on the snapshot. Nothing in a snapshot changes after it is
+ * built: a reload builds a new one, and the old one is deleted when its
+ * last reference is released.
+ *
+ * @note Reference counts are not atomic: single-threaded per process
+ */
+
+/**
+ * @brief Builds every derived structure of a configuration
+ *
+ * @param servers Server blocks in configuration order
+ */
+ConfigSnapshot::ConfigSnapshot(const std::vector<ServerConfig> &servers)
+    : _servers(servers), _refs(1) {
+  // Several blocks can listen on the same port (virtual hosting)
+  for (size_t i = 0; i < _servers.size(); ++i) {
+    ListenerConfig &listener = _listeners[_servers[i].getListen()];
+    listener.servers.push_back(_servers[i]);
+    const ListenOptions &options = _servers[i].getListenOptions();
+    bool http2 = listener.options.http2 || options.http2;
+    bool ssl = listener.options.ssl || options.ssl;
+    if (options.isSet())
+      listener.options = options;
+    listener.options.http2 = http2;
+    listener.options.ssl = ssl;
+    // tcp_nodelay / tcp_nopush: the default server's (else the first one's)
+    if (listener.servers.size() == 1 || _servers[i].isDefaultServer()) {
+      listener.tcpNoDelay = _servers[i].getTcpNoDelay();
+      listener.tcpNoPush = _servers[i].getTcpNoPush();
+    }
+  }
+  for (std::map<int, ListenerConfig>::iterator it = _listeners.begin();
+       it != _listeners.end(); ++it)
+    it->second.hosts.build(it->second.servers);
+  try {
+    for (std::map<int, ListenerConfig>::iterator it = _listeners.begin();
+         it != _listeners.end(); ++it) {
+      ListenerConfig &listener = it->second;
+      if (!listener.options.ssl)
+        continue;
+      listener.tls = new TlsContext();
+      listener.tls->build(it->first, listener.servers, listener.hosts,
+                          listener.options.http2);
+    }
+  } catch (...) {
+    releaseTls();
+    throw;
+  }
+  _errorPages.build(_servers);
+}
+
+ConfigSnapshot::~ConfigSnapshot() { releaseTls(); }
+
+void ConfigSnapshot::releaseTls() {
+  for (std::map<int, ListenerConfig>::iterator it = _listeners.begin();
+       it != _listeners.end(); ++it) {
+    delete it->second.tls;
+    it->second.tls = NULL;
+  }
+}
+
+void ConfigSnapshot::retain() { ++_refs; }
+
+void ConfigSnapshot::release() {
+  if (--_refs == 0)
+    delete this;
+}
+
+const std::vector<ServerConfig> &ConfigSnapshot::getServers() const {
+  return _servers;
+}
+
+const std::map<int, ListenerConfig> &ConfigSnapshot::getListeners() const {
+  return _listeners;
+}
+
+const ListenerConfig *ConfigSnapshot::findListener(int port) const {
+  std::map<int, ListenerConfig>::const_iterator it = _listeners.find(port);
+  return it == _listeners.end() ? NULL : &it->second;
+}
+
+const ErrorPageCache &ConfigSnapshot::getErrorPages() const {
+  return _errorPages;
+}
@@ -0,0 +1,323 @@
+#include "core/Logger.hpp"
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <streambuf>
+#include <unistd.h>
+
+/**
+ * @file Logger.cpp
+ * @brief Leveled error log, access log and request trace, batched writes
+ *
+ * Every connection event used to print several std::endl-flushed lines
+ * (one write() each) and dump whole requests to the terminal, so under
+ * load the server spent more time logging than serving. Now:
+ *
+ * - LOG_DEBUG/LOG_INFO/... test the runtime level before the message
+ *   expression is evaluated, and levels below WEBSERV_LOG_LEVEL are not
+ *   compiled at all (make LOG_LEVEL=1)
+ * - a line is formatted into a fixed buffer (truncated at LINE_SIZE) and
+ *   appended to its log's batch; nothing is allocated per line
+ * - the event loop calls flush() once per iteration, so one write() per
+ *   log carries every line of that round; a full batch is written early,
+ *   and error lines are written at once so a crash does not lose them
+ * - the timestamp is formatted once per second
+ *
+ * There is no logging thread (the server is single-threaded per
+ * process): the batch plays the role of the ring, drained by the event
+ * loop between polls. Files are opened O_APPEND and a batch only holds
+ * whole lines, so workers sharing a log never interleave inside a line.
+ * A failed write() drops that batch (counted by dropped()) instead of
+ * blocking the loop.
+ *
+ * @note Not async-signal-safe: signal handlers must not log
+ */
+
+namespace {
+
+/** @brief Fixed line buffer behind the logging ostream */
+class LineBuffer : public std::streambuf {
+private:
+  char _data[Logger::LINE_SIZE];
+
+protected:
+  // Line full: the rest of it is dropped
+  int_type overflow(int_type) { return traits_type::eof(); }
+
+public:
+  LineBuffer() { reset(); }
+  void reset() { setp(_data, _data + sizeof(_data) - 1); }
+  char *data() { return pbase(); }
+  size_t length() const { return static_cast<size_t>(pptr() - pbase()); }
+};
+
+/** @brief One destination and its pending batch */
+struct Sink {
+  int fd; // -1 = disabled
+  bool owned;
+  size_t used;
+  char batch[Logger::BATCH_SIZE];
+};
+
+} // namespace
+
+static Sink g_errorLog = {1, false, 0, {0}};
+static Sink g_accessLog = {-1, false, 0, {0}};
+static Sink g_traceLog = {-1, false, 0, {0}};
+static Sink *g_current = &g_errorLog;
+static int g_currentLevel = Logger::INFO;
+static unsigned long g_dropped = 0;
+
+static LineBuffer g_line;
+static std::ostream g_stream(&g_line);
+
+static time_t g_stampTime = -1;
+static char g_stamp[32] = "";
+static char g_accessStamp[40] = "";
+
+int Logger::_level = Logger::INFO;
+
+static const char *const LEVEL_TAGS[] = {"[Debug] ", "[Info] ",
+                                         "⚠️ [Warning] ", "❌ [Error] "};
+
+/**
+ * @brief Writes a sink's batch; drops it if the write fails
+ */
+static void flushSink(Sink &sink) {
+  size_t offset = 0;
+  while (offset < sink.used) {
+    ssize_t n = write(sink.fd, sink.batch + offset, sink.used - offset);
+    if (n <= 0) {
+      g_dropped += sink.used - offset;
+      break;
+    }
+    offset += static_cast<size_t>(n);
+  }
+  sink.used = 0;
+}
+
+/**
+ * @brief Opens a log destination
+ *
+ * @param sink Sink to (re)open; a file it owned is closed first
+ * @param target "stdout", "stderr", a file path, or "" for disabled
+ * @return false if the file cannot be opened
+ */
+static bool openSink(Sink &sink, const std::string &target) {
+  if (sink.used > 0 && sink.fd != -1)
+    flushSink(sink);
+  if (sink.owned)
+    close(sink.fd);
+  sink.fd = -1;
+  sink.owned = false;
+  sink.used = 0;
+  if (target.empty())
+    return true;
+  if (target == "stdout") {
+    sink.fd = STDOUT_FILENO;
+    return true;
+  }
+  if (target == "stderr") {
+    sink.fd = STDERR_FILENO;
+    return true;
+  }
+  int fd = open(target.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd == -1)
+    return false;
+  fcntl(fd, F_SETFD, FD_CLOEXEC); // CGI children must not inherit it
+  sink.fd = fd;
+  sink.owned = true;
+  return true;
+}
+
+/**
+ * @brief Refreshes both cached timestamps when the second changed
+ */
+static void refreshStamps() {
+  time_t now = time(NULL);
+  if (now == g_stampTime)
+    return;
+  g_stampTime = now;
+  struct tm local;
+  localtime_r(&now, &local);
+  strftime(g_stamp, sizeof(g_stamp), "%Y/%m/%d %H:%M:%S ", &local);
+  strftime(g_accessStamp, sizeof(g_accessStamp), "[%d/%b/%Y:%H:%M:%S %z]",
+           &local);
+}
+
+static void flushAtExit() { Logger::flush(); }
+
+/**
+ * @brief Sets the log destinations and the error log level
+ *
+ * @param errorLog Error log target ("stdout", "stderr" or a path)
+ * @param level Lowest level written (Logger::Level)
+ * @param accessLog Access log target, "" or "off" for none
+ * @return false if a log file cannot be opened
+ */
+bool Logger::configure(const std::string &errorLog, int level,
+                       const std::string &accessLog) {
+  static bool registered = false;
+  if (!registered) {
+    std::atexit(flushAtExit);
+    registered = true;
+  }
+  _level = level;
+  if (!openSink(g_errorLog, errorLog.empty() ? "stdout" : errorLog))
+    return false;
+  return openSink(g_accessLog, accessLog == "off" ? "" : accessLog);
+}
+
+/**
+ * @brief Opens the request trace file (request_trace)
+ *
+ * The file holds a Chrome trace in the JSON array format: a new file
+ * starts with "[", then every event is one line ending with ",". The
+ * closing "]" is optional in that format, so the file can be loaded at
+ * any time and several runs (or workers) keep appending to it.
+ *
+ * @param traceLog File path, "" for none
+ * @return false if the file cannot be opened
+ */
+bool Logger::configureTrace(const std::string &traceLog) {
+  if (!openSink(g_traceLog, traceLog))
+    return false;
+  if (g_traceLog.owned && lseek(g_traceLog.fd, 0, SEEK_END) == 0 &&
+      write(g_traceLog.fd, "[\n", 2) != 2)
+    return false;
+  return true;
+}
+
+/**
+ * @brief Maps an error_log level name to its Level
+ *
+ * @param name "debug", "info", "warn" or "error"
+ * @return Level, or -1 if the name is unknown
+ */
+int Logger::parseLevel(const std::string &name) {
+  static const char *const names[] = {"debug", "info", "warn", "error"};
+  for (int i = 0; i < 4; ++i) {
+    if (name == names[i])
+      return i;
+  }
+  return -1;
+}
+
+bool Logger::accessEnabled() { return g_accessLog.fd != -1; }
+
+bool Logger::traceEnabled() { return g_traceLog.fd != -1; }
+
+/**
+ * @brief Starts an error log line
+ *
+ * @param level Level of the line (also picks its tag)
+ * @return Stream to write the message to; Logger::end() finishes the line
+ */
+std::ostream &Logger::begin(int level) {
+  refreshStamps();
+  g_current = &g_errorLog;
+  g_currentLevel = level;
+  g_line.reset();
+  g_stream.clear();
+  g_stream << g_stamp << LEVEL_TAGS[level < ERROR ? level : ERROR];
+  return g_stream;
+}
+
+/**
+ * @brief Starts an access log line (no prefix: the caller writes it all)
+ *
+ * @return Stream to write the line to; Logger::end() finishes it
+ */
+std::ostream &Logger::beginAccess() {
+  refreshStamps();
+  g_current = &g_accessLog;
+  g_currentLevel = INFO;
+  g_line.reset();
+  g_stream.clear();
+  return g_stream;
+}
+
+/**
+ * @brief Starts a request trace line (the caller writes the whole event)
+ *
+ * @return Stream to write the line to; Logger::end() finishes it
+ */
+std::ostream &Logger::beginTrace() {
+  g_current = &g_traceLog;
+  g_currentLevel = INFO;
+  g_line.reset();
+  g_stream.clear();
+  return g_stream;
+}
+
+/**
+ * @brief Queues the current line in its batch
+ *
+ * A batch without room for the line is written first; error lines are
+ * written right away.
+ */
+void Logger::end() {
+  Sink &sink = *g_current;
+  if (sink.fd == -1)
+    return;
+  size_t length = g_line.length();
+  g_line.data()[length++] = '\n'; // reset() kept one byte for it
+  if (sink.used + length > BATCH_SIZE)
+    flushSink(sink);
+  for (size_t i = 0; i < length; ++i)
+    sink.batch[sink.used + i] = g_line.data()[i];
+  sink.used += length;
+  if (g_currentLevel >= ERROR)
+    flushSink(sink);
+}
+
+/**
+ * @brief Writes every pending line (called once per event loop round)
+ */
+void Logger::flush() {
+  if (g_errorLog.used > 0 && g_errorLog.fd != -1)
+    flushSink(g_errorLog);
+  if (g_accessLog.used > 0 && g_accessLog.fd != -1)
+    flushSink(g_accessLog);
+  if (g_traceLog.used > 0 && g_traceLog.fd != -1)
+    flushSink(g_traceLog);
+}
+
+/**
+ * @brief Returns the access log timestamp of the current second
+ *
+ * @return "[14/Oct/2026:19:05:01 +0200]"
+ */
+const char *Logger::accessTime() {
+  refreshStamps();
+  return g_accessStamp;
+}
+
+unsigned long Logger::dropped() { return g_dropped; }
+
+/**
+ * @brief Streams a bounded, escaped excerpt of raw bytes
+ *
+ * @param out Destination stream
+ * @param excerpt Bytes to show (at most LogExcerpt::LIMIT of them)
+ * @return out
+ */
+std::ostream &operator<<(std::ostream &out, const LogExcerpt &excerpt) {
+  static const char hex[] = "0123456789abcdef";
+  size_t shown =
+      excerpt.length < LogExcerpt::LIMIT ? excerpt.length : LogExcerpt::LIMIT;
+  for (size_t i = 0; i < shown; ++i) {
+    unsigned char c = static_cast<unsigned char>(excerpt.data[i]);
+    if (c == '\r')
+      out << "\\r";
+    else if (c == '\n')
+      out << "\\n";
+    else if (c < 0x20 || c >= 0x7f || c == '"' || c == '\\')
+      out << "\\x" << hex[c >> 4] << hex[c & 0x0f];
+    else
+      out << static_cast<char>(c);
+  }
+  if (shown < excerpt.length)
+    out << "... (" << excerpt.length << " bytes)";
+  return out;
+}
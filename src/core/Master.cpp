@@ -0,0 +1,374 @@
+#include "core/Master.hpp"
+#include "config/ConfigBuilder.hpp"
+#include "config_parser/parser/UtilsConfigParser.hpp"
+#include "core/Logger.hpp"
+#include "core/Server.hpp"
+#include "network/ServerSocket.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+ * @file Master.cpp
+ * @brief Multi-process mode - one master supervising N event-loop workers
+ *
+ * Enabled with `worker_processes N;` (N > 1) in the main context.
+ *
+ * ```
+ *          master (no sockets, only waitpid)
+ *        ┌────┼────┐
+ *     worker worker worker    ← each: Server::init() + Server::run()
+ *        │    │    │
+ *     SO_REUSEPORT listeners on the same ports (kernel load-balances)
+ * ```
+ *
+ * Responsibilities of the master:
+ * - fork() one worker per slot; each worker binds its own listeners
+ * - respawn workers that crash or exit unexpectedly
+ * - on SIGINT/SIGTERM/SIGQUIT forward SIGTERM to every worker and wait
+ *   for them, so each worker drains its connections (at most
+ *   worker_shutdown_timeout) and runs its destructors; a second signal
+ *   forwards a second SIGTERM, which makes the workers close at once
+ * - on SIGHUP validate the configuration file, keep it for future
+ *   respawns and forward SIGHUP; each worker then reloads by itself
+ * - on SIGUSR2 start the new binary (see upgradeBinary())
+ *
+ * A worker that cannot bind its sockets (or load a TLS certificate) exits
+ * with WORKER_INIT_FAILED; the master treats that as fatal instead of
+ * respawning it in a tight loop.
+ *
+ * @note Workers inherit the parsed configuration from the master's memory
+ * @see Server for the per-worker event loop
+ */
+
+// Global flags for shutdown, reload and upgrade (defined in main.cpp)
+extern volatile sig_atomic_t g_running;
+extern volatile sig_atomic_t g_terminate;
+extern volatile sig_atomic_t g_reload;
+extern volatile sig_atomic_t g_upgrade;
+
+/** @brief Worker exit code meaning "could not bind/listen, do not respawn" */
+static const int WORKER_INIT_FAILED = 3;
+
+/** @brief Seconds past worker_shutdown_timeout before SIGKILL */
+static const int WORKER_STOP_TIMEOUT = 10;
+
+/**
+ * @brief Master signal handler - only flips the shutdown/reload flags
+ *
+ * Installed with sigaction() WITHOUT SA_RESTART so the blocking waitpid()
+ * in run() returns EINTR and the loop notices the shutdown request.
+ * Workers inherit it: in a worker, a second SIGTERM sets g_terminate and
+ * ends the drain.
+ */
+static void masterSignalHandler(int signum) {
+  if (signum == SIGHUP)
+    g_reload = true;
+  else if (signum == SIGUSR2)
+    g_upgrade = true;
+  else if (!g_running)
+    g_terminate = true;
+  else
+    g_running = false;
+}
+
+/**
+ * @brief Constructor - stores the configuration handed to every worker
+ */
+Master::Master(const std::vector<ServerConfig> &configs,
+               const GlobalConfig &globalConfig)
+    : _servConfigsList(configs), _globalConfig(globalConfig),
+      _upgradePid(0), _workers(globalConfig.getWorkerProcesses(), 0),
+      _spawnTimes(globalConfig.getWorkerProcesses(), 0) {}
+
+Master::~Master() {}
+
+void Master::setConfigPath(const std::string &path) { _configPath = path; }
+
+void Master::setCommandLine(int argc, char **argv) {
+  _commandLine.assign(argv, argv + argc);
+}
+
+/**
+ * @brief Body of a worker process (runs in the child after fork())
+ *
+ * @param slot Worker index (for logging only)
+ * @return Process exit code
+ */
+int Master::runWorker(size_t slot) {
+  Server *server;
+  try {
+    server = new Server(_servConfigsList, _globalConfig);
+  } catch (std::exception &e) {
+    std::cerr << "[Worker " << slot << "] " << e.what() << std::endl;
+    return WORKER_INIT_FAILED;
+  }
+  server->setConfigPath(_configPath);
+  if (!server->init()) {
+    delete server;
+    return WORKER_INIT_FAILED;
+  }
+
+  std::cout << "[Worker " << slot << "] Started (pid: " << getpid() << ")"
+            << std::endl;
+  server->run();
+  delete server;
+  std::cout << "[Worker " << slot << "] Stopped" << std::endl;
+  return 0;
+}
+
+/**
+ * @brief Forks one worker for the given slot
+ *
+ * @return Child pid in the master, -1 if fork() failed (never returns in
+ *         the child)
+ */
+pid_t Master::spawnWorker(size_t slot) {
+  std::cout.flush(); // Avoid duplicating buffered output in the child
+  std::cerr.flush();
+  Logger::flush();
+
+  pid_t pid = fork();
+  if (pid == -1) {
+    std::cerr << "❌ [Error] fork() failed for worker " << slot << ": "
+              << strerror(errno) << std::endl;
+    return -1;
+  }
+  if (pid == 0) {
+    int code = runWorker(slot);
+    std::cout.flush();
+    std::exit(code);
+  }
+  _workers[slot] = pid;
+  _spawnTimes[slot] = time(NULL);
+  return pid;
+}
+
+/**
+ * @brief Finds the worker slot owning pid
+ *
+ * @return Slot index, or -1 if pid is not one of our workers
+ */
+int Master::findSlot(pid_t pid) const {
+  for (size_t i = 0; i < _workers.size(); ++i) {
+    if (_workers[i] == pid)
+      return (int)i;
+  }
+  return -1;
+}
+
+/**
+ * @brief Sends SIGTERM to every worker and reaps them
+ *
+ * Workers drain for up to worker_shutdown_timeout, then get
+ * WORKER_STOP_TIMEOUT more seconds to leave their event loop; any worker
+ * still alive after that is killed with SIGKILL. A signal received
+ * meanwhile (g_terminate) is forwarded as a second SIGTERM, which ends
+ * the drain of every worker.
+ */
+void Master::stopWorkers() {
+  for (size_t i = 0; i < _workers.size(); ++i) {
+    if (_workers[i] > 0)
+      kill(_workers[i], SIGTERM);
+  }
+
+  time_t deadline = time(NULL) + _globalConfig.getWorkerShutdownTimeout() +
+                    WORKER_STOP_TIMEOUT;
+  bool forwarded = false;
+  size_t alive = 0;
+  do {
+    if (g_terminate && !forwarded) {
+      forwarded = true;
+      for (size_t i = 0; i < _workers.size(); ++i) {
+        if (_workers[i] > 0)
+          kill(_workers[i], SIGTERM);
+      }
+    }
+    alive = 0;
+    for (size_t i = 0; i < _workers.size(); ++i) {
+      if (_workers[i] <= 0)
+        continue;
+      int status;
+      if (waitpid(_workers[i], &status, WNOHANG) == 0)
+        ++alive;
+      else
+        _workers[i] = 0;
+    }
+    if (alive > 0)
+      usleep(100000);
+  } while (alive > 0 && time(NULL) < deadline);
+
+  for (size_t i = 0; i < _workers.size(); ++i) {
+    if (_workers[i] > 0) {
+      std::cerr << "⚠️ [Warning] Worker " << i << " (pid " << _workers[i]
+                << ") did not stop, sending SIGKILL" << std::endl;
+      kill(_workers[i], SIGKILL);
+      waitpid(_workers[i], NULL, 0);
+      _workers[i] = 0;
+    }
+  }
+}
+
+/**
+ * @brief Validates the configuration file and asks every worker to reload
+ *
+ * The master only parses the file: workers re-read it themselves (see
+ * Server::reload()). A file that does not parse is not forwarded, and the
+ * configuration kept for respawned workers is the last valid one.
+ */
+void Master::reloadWorkers() {
+  if (_configPath.empty())
+    return;
+  try {
+    BlockParser root = parseAndValidateConfig(_configPath);
+    ConfigBuilder builder;
+    _servConfigsList = builder.buildFromBlockParser(root);
+  } catch (std::exception &e) {
+    std::cerr << "❌ [Error] Reload failed, keeping the current "
+              << "configuration: " << e.what() << std::endl;
+    return;
+  }
+
+  std::cout << "[Info] 🔄 Master reloading " << _workers.size()
+            << " workers" << std::endl;
+  for (size_t i = 0; i < _workers.size(); ++i) {
+    if (_workers[i] > 0)
+      kill(_workers[i], SIGHUP);
+  }
+}
+
+/**
+ * @brief Starts the new binary (SIGUSR2) beside the running workers
+ *
+ * Workers bind their own SO_REUSEPORT listeners, so the new generation
+ * binds the same ports while the old one still accepts: no refusal
+ * window. Listeners this master inherited itself (it was started by an
+ * upgrade) are handed over as they are. SIGQUIT to this master then
+ * drains the old workers.
+ */
+void Master::upgradeBinary() {
+  if (_commandLine.empty())
+    return;
+  if (_upgradePid > 0) {
+    std::cerr << "⚠️ [Warning] Binary upgrade already running (pid "
+              << _upgradePid << "), SIGUSR2 ignored" << std::endl;
+    return;
+  }
+  std::cout.flush();
+  std::cerr.flush();
+  Logger::flush();
+  pid_t pid = ServerSocket::spawnInheriting(_commandLine,
+                                            ServerSocket::getInherited());
+  if (pid == -1) {
+    std::cerr << "❌ [Error] Binary upgrade: fork() failed: "
+              << strerror(errno) << std::endl;
+    return;
+  }
+  _upgradePid = pid;
+  std::cout << "[Info] 🔁 Binary upgrade: started " << _commandLine[0]
+            << " (pid " << pid << ")" << std::endl;
+}
+
+/**
+ * @brief Master supervision loop
+ *
+ * Flow:
+ * 1. Install non-restarting SIGINT/SIGTERM/SIGQUIT/SIGHUP/SIGUSR2 handlers
+ * 2. Fork all workers
+ * 3. Block in waitpid(); when a worker dies, respawn it (throttled to one
+ *    respawn per second per slot if it keeps crashing right after start)
+ * 4. On SIGHUP, validate the file and forward SIGHUP (reloadWorkers());
+ *    on SIGUSR2, start the new binary (upgradeBinary())
+ * 5. On shutdown, forward SIGTERM and wait for every worker
+ *
+ * @return 0 on clean shutdown, 1 if workers could not start
+ */
+int Master::run() {
+  struct sigaction sa;
+  std::memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = masterSignalHandler;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = 0; // No SA_RESTART: waitpid() must return EINTR
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  sigaction(SIGQUIT, &sa, NULL);
+  sigaction(SIGHUP, &sa, NULL); // Inherited: sets g_reload in workers too
+  sigaction(SIGUSR2, &sa, NULL);
+
+  std::cout << "[Info] Master " << getpid() << " starting "
+            << _workers.size() << " worker processes" << std::endl;
+
+  for (size_t i = 0; i < _workers.size(); ++i) {
+    if (spawnWorker(i) == -1) {
+      stopWorkers();
+      return 1;
+    }
+  }
+
+  int exitCode = 0;
+  while (g_running) {
+    int status;
+    pid_t pid = waitpid(-1, &status, 0);
+    if (pid == -1) {
+      if (errno == EINTR) {
+        if (g_reload && g_running) {
+          g_reload = false;
+          reloadWorkers();
+        }
+        if (g_upgrade && g_running) {
+          g_upgrade = false;
+          upgradeBinary();
+        }
+        continue; // Signal received, re-check g_running
+      }
+      break;      // ECHILD: nothing left to supervise
+    }
+
+    if (pid == _upgradePid) {
+      std::cerr << "❌ [Error] Binary upgrade: pid " << pid
+                << " exited, still serving" << std::endl;
+      _upgradePid = 0;
+      continue;
+    }
+    int slot = findSlot(pid);
+    if (slot < 0)
+      continue;
+    _workers[slot] = 0;
+    if (!g_running)
+      break;
+
+    if (WIFEXITED(status) && WEXITSTATUS(status) == WORKER_INIT_FAILED) {
+      std::cerr << "❌ [Error] Worker " << slot
+                << " failed to initialize listeners, shutting down"
+                << std::endl;
+      exitCode = 1;
+      break;
+    }
+
+    if (WIFSIGNALED(status))
+      std::cerr << "⚠️ [Warning] Worker " << slot << " (pid " << pid
+                << ") killed by signal " << WTERMSIG(status)
+                << ", respawning" << std::endl;
+    else
+      std::cerr << "⚠️ [Warning] Worker " << slot << " (pid " << pid
+                << ") exited with status " << WEXITSTATUS(status)
+                << ", respawning" << std::endl;
+
+    // Crash-loop protection: at most one respawn per second per slot
+    if (time(NULL) - _spawnTimes[slot] < 1)
+      sleep(1);
+    if (g_running && spawnWorker(slot) == -1) {
+      exitCode = 1;
+      break;
+    }
+  }
+
+  std::cout << "[Info] 🛑 Master stopping workers..." << std::endl;
+  stopWorkers();
+  return exitCode;
+}
@@ -0,0 +1,333 @@
+#include "core/Metrics.hpp"
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <sys/time.h>
+#include <unistd.h>
+
+/**
+ * @file Metrics.cpp
+ * @brief Hot-path counters and latency histograms, scraped in Prometheus
+ *        text format from metrics_path (off unless configured)
+ *
+ * Everything a request touches is a fixed array of integers: a counter is
+ * one addition, a histogram observation a scan of 16 bucket bounds, a
+ * response a status slot plus one find() in the per-location table (a
+ * location allocates once, on its first response). Formatting only happens
+ * when the endpoint is scraped.
+ *
+ *   webserv_connections{state}                 gauges (Server, at scrape)
+ *   webserv_accepted_connections_total         rate() = accepts/sec
+ *   webserv_rejected_connections_total{reason} overload shedding (503)
+ *   webserv_evicted_connections_total          idle keep-alive closed early
+ *   webserv_responses_total{code}
+ *   webserv_location_responses_total{location,class}
+ *   webserv_bytes_{received,sent}_total
+ *   webserv_cgi_*                              spawns, timeouts, duration
+ *   webserv_cache_{hits,misses}_total{cache}   (Server, at scrape)
+ *   webserv_loop_{wait,busy}_seconds_total     wait() versus processing
+ *   webserv_request_phase_seconds{phase}       parse / route / handler /
+ *                                              flush histograms
+ *
+ * Values are per process: with worker_processes each worker answers with
+ * its own (the `pid` in webserv_process_info tells them apart).
+ *
+ * @note Single-threaded per process, like the rest of the event loop
+ */
+
+/** @brief Bucket upper bounds, nanoseconds (50µs ... 10s) */
+static const uint64_t BUCKET_BOUNDS[Metrics::BUCKET_COUNT] = {
+    50000ULL,     100000ULL,     250000ULL,     500000ULL,
+    1000000ULL,   2500000ULL,    5000000ULL,    10000000ULL,
+    25000000ULL,  50000000ULL,   100000000ULL,  250000000ULL,
+    500000000ULL, 1000000000ULL, 2500000000ULL, 10000000000ULL};
+
+/** @brief Label value of each Histogram in webserv_request_phase_seconds */
+static const char *const PHASE_NAMES[Metrics::HISTOGRAM_COUNT] = {
+    "parse", "route", "handler", "flush", "cgi"};
+
+struct HistogramData {
+  uint64_t buckets[Metrics::BUCKET_COUNT + 1]; // Last one: +Inf
+  uint64_t count;
+  uint64_t sum; // Nanoseconds
+};
+
+/** @brief Responses of one location, by status class (1xx ... 5xx) */
+struct LocationCounts {
+  uint64_t classes[5];
+};
+
+static const int MAX_STATUS = 600;
+
+static std::string g_path; // Endpoint off until metrics_path sets it
+static const MetricsSource *g_source = NULL;
+static uint64_t g_counters[Metrics::COUNTER_COUNT];
+static uint64_t g_status[MAX_STATUS];
+static HistogramData g_histograms[Metrics::HISTOGRAM_COUNT];
+static std::map<std::string, LocationCounts> g_locations;
+static uint64_t g_waitNs = 0;
+static uint64_t g_busyNs = 0;
+static time_t g_started = time(NULL);
+
+MetricsSource::~MetricsSource() {}
+
+/**
+ * @param path Path the endpoint answers on ("" = metrics_path off)
+ */
+void Metrics::configure(const std::string &path) { g_path = path; }
+
+bool Metrics::isEndpoint(const std::string &path) {
+  return !g_path.empty() && path == g_path;
+}
+
+void Metrics::setSource(const MetricsSource *source) { g_source = source; }
+
+uint64_t Metrics::now() {
+#if defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL +
+           static_cast<uint64_t>(ts.tv_nsec);
+#endif
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000000ULL +
+         static_cast<uint64_t>(tv.tv_usec) * 1000ULL;
+}
+
+void Metrics::add(Counter counter, uint64_t amount) {
+  g_counters[counter] += amount;
+}
+
+/**
+ * @param histogram Which latency
+ * @param nanoseconds Duration measured with now()
+ */
+void Metrics::observe(Histogram histogram, uint64_t nanoseconds) {
+  HistogramData &data = g_histograms[histogram];
+  int bucket = 0;
+  while (bucket < BUCKET_COUNT && nanoseconds > BUCKET_BOUNDS[bucket])
+    ++bucket;
+  ++data.buckets[bucket];
+  ++data.count;
+  data.sum += nanoseconds;
+}
+
+/**
+ * @param status HTTP status sent (outside 100-599: not counted by code)
+ * @param location Pattern of the matched location ("" = none matched)
+ */
+void Metrics::countResponse(int status, const std::string &location) {
+  if (status < 100 || status >= MAX_STATUS)
+    return;
+  ++g_status[status];
+  std::map<std::string, LocationCounts>::iterator it =
+      g_locations.find(location);
+  if (it == g_locations.end()) {
+    LocationCounts counts = {{0, 0, 0, 0, 0}};
+    it = g_locations.insert(std::make_pair(location, counts)).first;
+  }
+  ++it->second.classes[status / 100 - 1];
+}
+
+void Metrics::addLoopTime(uint64_t waitNs, uint64_t busyNs) {
+  g_waitNs += waitNs;
+  g_busyNs += busyNs;
+}
+
+// ==================== Rendering ====================
+
+void Metrics::appendHelp(std::string &out, const char *name,
+                         const char *type, const char *help) {
+  out += "# HELP ";
+  out += name;
+  out += ' ';
+  out += help;
+  out += "\n# TYPE ";
+  out += name;
+  out += ' ';
+  out += type;
+  out += '\n';
+}
+
+/**
+ * @param labels Label set without braces ("" or NULL = none)
+ */
+void Metrics::appendSample(std::string &out, const char *name,
+                           const char *labels, uint64_t value) {
+  char number[32];
+  std::snprintf(number, sizeof(number), "%llu",
+                static_cast<unsigned long long>(value));
+  out += name;
+  if (labels && *labels) {
+    out += '{';
+    out += labels;
+    out += '}';
+  }
+  out += ' ';
+  out += number;
+  out += '\n';
+}
+
+void Metrics::appendSeconds(std::string &out, const char *name,
+                            const char *labels, uint64_t nanoseconds) {
+  char number[32];
+  std::snprintf(number, sizeof(number), "%llu.%09llu",
+                static_cast<unsigned long long>(nanoseconds / 1000000000ULL),
+                static_cast<unsigned long long>(nanoseconds % 1000000000ULL));
+  out += name;
+  if (labels && *labels) {
+    out += '{';
+    out += labels;
+    out += '}';
+  }
+  out += ' ';
+  out += number;
+  out += '\n';
+}
+
+/**
+ * @brief Escapes a label value (backslash, double quote, newline)
+ */
+static std::string labelValue(const std::string &value) {
+  std::string escaped;
+  for (size_t i = 0; i < value.size(); ++i) {
+    if (value[i] == '\\' || value[i] == '"')
+      escaped += '\\';
+    if (value[i] == '\n') {
+      escaped += "\\n";
+      continue;
+    }
+    escaped += value[i];
+  }
+  return escaped;
+}
+
+static void appendHistogram(std::string &out, const char *name,
+                            const char *label, const HistogramData &data) {
+  char labels[96];
+  uint64_t cumulative = 0;
+  std::string bucketName = std::string(name) + "_bucket";
+  for (int i = 0; i <= Metrics::BUCKET_COUNT; ++i) {
+    cumulative += data.buckets[i];
+    if (i == Metrics::BUCKET_COUNT)
+      std::snprintf(labels, sizeof(labels), "%s%sle=\"+Inf\"", label,
+                    *label ? "," : "");
+    else
+      std::snprintf(labels, sizeof(labels), "%s%sle=\"%g\"", label,
+                    *label ? "," : "", BUCKET_BOUNDS[i] / 1e9);
+    Metrics::appendSample(out, bucketName.c_str(), labels, cumulative);
+  }
+  Metrics::appendSeconds(out, (std::string(name) + "_sum").c_str(), label,
+                         data.sum);
+  Metrics::appendSample(out, (std::string(name) + "_count").c_str(), label,
+                        data.count);
+}
+
+/**
+ * @brief Renders the whole registry, then the source's own metrics
+ *
+ * @param out Text is appended (Content-Type: text/plain; version=0.0.4)
+ */
+void Metrics::render(std::string &out) {
+  char labels[64];
+
+  appendHelp(out, "webserv_process_info", "gauge",
+             "Worker process answering this scrape");
+  std::snprintf(labels, sizeof(labels), "pid=\"%ld\"",
+                static_cast<long>(getpid()));
+  appendSample(out, "webserv_process_info", labels, 1);
+  appendHelp(out, "webserv_process_start_time_seconds", "gauge",
+             "Start time of the process since the epoch");
+  appendSample(out, "webserv_process_start_time_seconds", NULL,
+               static_cast<uint64_t>(g_started));
+
+  if (g_source)
+    g_source->appendMetrics(out);
+
+  appendHelp(out, "webserv_accepted_connections_total", "counter",
+             "Connections accepted");
+  appendSample(out, "webserv_accepted_connections_total", NULL,
+               g_counters[ACCEPTED]);
+  appendHelp(out, "webserv_rejected_connections_total", "counter",
+             "Connections answered 503 and closed, by reason");
+  appendSample(out, "webserv_rejected_connections_total",
+               "reason=\"worker_connections\"", g_counters[REJECTED_FULL]);
+  appendSample(out, "webserv_rejected_connections_total",
+               "reason=\"limit_conn_per_ip\"", g_counters[REJECTED_PER_IP]);
+  appendSample(out, "webserv_rejected_connections_total", "reason=\"no_fd\"",
+               g_counters[REJECTED_NO_FD]);
+  appendHelp(out, "webserv_evicted_connections_total", "counter",
+             "Idle keep-alive connections closed to admit new ones");
+  appendSample(out, "webserv_evicted_connections_total", NULL,
+               g_counters[EVICTED_IDLE]);
+  appendHelp(out, "webserv_bytes_received_total", "counter",
+             "Bytes read from client sockets");
+  appendSample(out, "webserv_bytes_received_total", NULL,
+               g_counters[BYTES_IN]);
+  appendHelp(out, "webserv_bytes_sent_total", "counter",
+             "Bytes written to client sockets");
+  appendSample(out, "webserv_bytes_sent_total", NULL, g_counters[BYTES_OUT]);
+
+  appendHelp(out, "webserv_responses_total", "counter",
+             "Responses sent, by status code");
+  for (int code = 100; code < MAX_STATUS; ++code) {
+    if (g_status[code] == 0)
+      continue;
+    std::snprintf(labels, sizeof(labels), "code=\"%d\"", code);
+    appendSample(out, "webserv_responses_total", labels, g_status[code]);
+  }
+
+  appendHelp(out, "webserv_location_responses_total", "counter",
+             "Responses sent, by location and status class");
+  for (std::map<std::string, LocationCounts>::const_iterator it =
+           g_locations.begin();
+       it != g_locations.end(); ++it) {
+    std::string location =
+        it->first.empty() ? std::string("none") : labelValue(it->first);
+    for (int i = 0; i < 5; ++i) {
+      if (it->second.classes[i] == 0)
+        continue;
+      std::string pair = "location=\"" + location + "\",class=\"";
+      pair += static_cast<char>('1' + i);
+      pair += "xx\"";
+      appendSample(out, "webserv_location_responses_total", pair.c_str(),
+                   it->second.classes[i]);
+    }
+  }
+
+  appendHelp(out, "webserv_cgi_spawns_total", "counter",
+             "CGI processes started");
+  appendSample(out, "webserv_cgi_spawns_total", NULL, g_counters[CGI_SPAWNS]);
+  appendHelp(out, "webserv_fastcgi_requests_total", "counter",
+             "Requests sent to fastcgi_pass servers");
+  appendSample(out, "webserv_fastcgi_requests_total", NULL,
+               g_counters[FASTCGI_REQUESTS]);
+  appendHelp(out, "webserv_proxy_requests_total", "counter",
+             "Requests forwarded to proxy_pass backends");
+  appendSample(out, "webserv_proxy_requests_total", NULL,
+               g_counters[PROXY_REQUESTS]);
+  appendHelp(out, "webserv_cgi_timeouts_total", "counter",
+             "CGI requests ended by cgi_timeout");
+  appendSample(out, "webserv_cgi_timeouts_total", NULL,
+               g_counters[CGI_TIMEOUTS]);
+  appendHelp(out, "webserv_cgi_duration_seconds", "histogram",
+             "CGI, FastCGI and proxied requests, start to end of output");
+  appendHistogram(out, "webserv_cgi_duration_seconds", "",
+                  g_histograms[CGI_DURATION]);
+
+  appendHelp(out, "webserv_loop_wait_seconds_total", "counter",
+             "Time the event loop spent blocked in wait()");
+  appendSeconds(out, "webserv_loop_wait_seconds_total", NULL, g_waitNs);
+  appendHelp(out, "webserv_loop_busy_seconds_total", "counter",
+             "Time the event loop spent processing events");
+  appendSeconds(out, "webserv_loop_busy_seconds_total", NULL, g_busyNs);
+
+  appendHelp(out, "webserv_request_phase_seconds", "histogram",
+             "Time spent in each phase of a request");
+  for (int i = 0; i < CGI_DURATION; ++i) {
+    std::snprintf(labels, sizeof(labels), "phase=\"%s\"", PHASE_NAMES[i]);
+    appendHistogram(out, "webserv_request_phase_seconds", labels,
+                    g_histograms[i]);
+  }
+}
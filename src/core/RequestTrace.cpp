@@ -0,0 +1,213 @@
+#include "core/RequestTrace.hpp"
+#include "core/Logger.hpp"
+#include <unistd.h>
+
+/**
+ * @file RequestTrace.cpp
+ * @brief Slow request log (slow_request_threshold) and sampled Chrome
+ *        trace export (request_trace)
+ *
+ * The Metrics histograms say that p99 moved, not which request moved it
+ * nor where its time went. A request slower than the threshold gets one
+ * error log line (warn level) with its phases, as key=value pairs in
+ * microseconds:
+ *
+ *   slow request: client=127.0.0.1 method=GET uri="/cgi/a.py" status=200
+ *   location="/cgi" total_us=812403 read_us=95 parse_us=12 route_us=3
+ *   handler_us=240 io_us=0 cgi_us=790112 send_us=18890
+ *
+ * read is the wall time from the first request byte to the complete
+ * request (a slow body upload shows there), parse the part of it spent
+ * in the parser. handler is the static file work done on the loop (disk,
+ * when io_threads is off), io the time parked on I/O threads, cgi the
+ * script / FastCGI / proxy exchange, send the response queued → last
+ * byte accepted by the socket.
+ *
+ * request_trace writes the same timings as Chrome trace events (JSON
+ * array format, see Logger::configureTrace()), one row per connection:
+ * load the file in chrome://tracing or ui.perfetto.dev. Each request is
+ * a complete ("X") event holding read, handle, cgi and send; a streamed
+ * CGI response starts its send before its cgi ends.
+ *
+ * Nothing here runs unless a request is recorded: the connection reads
+ * the monotonic clock where Metrics already does (plus once per I/O
+ * task) and keeps the values on its exchange.
+ *
+ * @note Single-threaded per process, like the rest of the event loop
+ */
+
+/** @brief Bytes of a path / location kept in a trace event */
+static const size_t TRACE_FIELD_LIMIT = 128;
+
+static uint64_t g_slowNs = 0;
+static int g_every = 0;
+static int g_countdown = 1; // Requests until the next sampled one
+
+RequestTiming::RequestTiming()
+    : start(0), parsed(0), handled(0), cgiAt(0), queued(0), end(0),
+      parseNs(0), routeNs(0), handlerNs(0), ioNs(0), cgiNs(0) {}
+
+void RequestTrace::configure(long slowMs, int every) {
+  g_slowNs = slowMs > 0 ? static_cast<uint64_t>(slowMs) * 1000000ULL : 0;
+  g_every = every > 0 ? every : 0;
+  g_countdown = 1;
+}
+
+bool RequestTrace::enabled() {
+  return g_slowNs != 0 || (g_every != 0 && Logger::traceEnabled());
+}
+
+/**
+ * @brief Streams a nanosecond count as microseconds, 3 decimals
+ */
+static void writeMicros(std::ostream &out, uint64_t nanoseconds) {
+  static const char digits[] = "0123456789";
+  uint64_t fraction = nanoseconds % 1000;
+  out << nanoseconds / 1000 << '.' << digits[fraction / 100]
+      << digits[fraction / 10 % 10] << digits[fraction % 10];
+}
+
+/**
+ * @brief Streams a bounded JSON string body (quotes not included)
+ *
+ * Bounded so an event always fits in one Logger line.
+ */
+static void writeJson(std::ostream &out, const std::string &value) {
+  static const char hex[] = "0123456789abcdef";
+  size_t shown = value.size() < TRACE_FIELD_LIMIT ? value.size()
+                                                  : TRACE_FIELD_LIMIT;
+  for (size_t i = 0; i < shown; ++i) {
+    unsigned char c = static_cast<unsigned char>(value[i]);
+    if (c == '"' || c == '\\')
+      out << '\\' << static_cast<char>(c);
+    else if (c < 0x20 || c >= 0x7f)
+      out << "\\u00" << hex[c >> 4] << hex[c & 0x0f];
+    else
+      out << static_cast<char>(c);
+  }
+}
+
+/**
+ * @brief Writes one complete ("X") trace event line
+ *
+ * @param name Event name (JSON-safe)
+ * @param from Start, nanoseconds
+ * @param to End, nanoseconds (>= from)
+ * @param tid Trace row (the client fd)
+ * @return Stream positioned inside the event, to append ,"args":{...};
+ *         traceEnd() closes it
+ */
+static std::ostream &traceBegin(const char *name, uint64_t from, uint64_t to,
+                                int tid) {
+  std::ostream &line = Logger::beginTrace();
+  line << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":" << getpid()
+       << ",\"tid\":" << tid << ",\"ts\":";
+  writeMicros(line, from);
+  line << ",\"dur\":";
+  writeMicros(line, to > from ? to - from : 0);
+  return line;
+}
+
+static void traceEnd(std::ostream &line) {
+  line << "},";
+  Logger::end();
+}
+
+/**
+ * @brief Writes the trace events of one request
+ */
+static void writeTrace(const RequestTiming &timing,
+                       const TracedRequest &request, uint64_t start,
+                       bool slow) {
+  int tid = request.connection;
+
+  std::ostream &line = Logger::beginTrace();
+  line << "{\"name\":\"";
+  if (request.method->empty()) {
+    line << '-';
+  } else {
+    writeJson(line, *request.method);
+    line << ' ';
+    writeJson(line, *request.path);
+  }
+  line << "\",\"cat\":\"request\",\"ph\":\"X\",\"pid\":" << getpid()
+       << ",\"tid\":" << tid << ",\"ts\":";
+  writeMicros(line, start);
+  line << ",\"dur\":";
+  writeMicros(line, timing.end - start);
+  line << ",\"args\":{\"status\":" << request.status << ",\"client\":\""
+       << request.client << "\",\"location\":\"";
+  if (request.location)
+    writeJson(line, *request.location);
+  line << "\",\"slow\":" << (slow ? "true" : "false") << '}';
+  traceEnd(line);
+
+  if (timing.parsed != 0) {
+    std::ostream &read = traceBegin("read", start, timing.parsed, tid);
+    read << ",\"args\":{\"parse_us\":";
+    writeMicros(read, timing.parseNs);
+    read << '}';
+    traceEnd(read);
+  }
+  if (timing.handled != 0) {
+    uint64_t handledEnd = timing.queued != 0 ? timing.queued : timing.end;
+    std::ostream &handle =
+        traceBegin("handle", timing.handled, handledEnd, tid);
+    handle << ",\"args\":{\"route_us\":";
+    writeMicros(handle, timing.routeNs);
+    handle << ",\"handler_us\":";
+    writeMicros(handle, timing.handlerNs);
+    handle << ",\"io_us\":";
+    writeMicros(handle, timing.ioNs);
+    handle << '}';
+    traceEnd(handle);
+  }
+  if (timing.cgiAt != 0)
+    traceEnd(traceBegin("cgi", timing.cgiAt, timing.cgiAt + timing.cgiNs,
+                        tid));
+  if (timing.queued != 0)
+    traceEnd(traceBegin("send", timing.queued, timing.end, tid));
+}
+
+/**
+ * @brief Logs the request if it was slow and traces it if sampled
+ *
+ * @param timing Phases of the request (end set)
+ * @param request What the lines show about it
+ */
+void RequestTrace::record(const RequestTiming &timing,
+                          const TracedRequest &request) {
+  uint64_t start = timing.start != 0 ? timing.start : timing.queued;
+  if (start == 0 || timing.end < start)
+    return;
+  uint64_t total = timing.end - start;
+  bool slow = g_slowNs != 0 && total >= g_slowNs;
+
+  if (slow && Logger::enabled(Logger::WARN)) {
+    const std::string &path = *request.path;
+    std::ostream &line = Logger::begin(Logger::WARN);
+    line << "slow request: client=" << request.client << " method="
+         << (request.method->empty() ? "-" : request.method->c_str())
+         << " uri=\"" << LogExcerpt(path.data(), path.size())
+         << "\" status=" << request.status << " location=\"";
+    if (request.location)
+      line << LogExcerpt(request.location->data(), request.location->size());
+    line << "\" total_us=" << total / 1000 << " read_us="
+         << (timing.parsed > start ? (timing.parsed - start) / 1000 : 0)
+         << " parse_us=" << timing.parseNs / 1000
+         << " route_us=" << timing.routeNs / 1000
+         << " handler_us=" << timing.handlerNs / 1000
+         << " io_us=" << timing.ioNs / 1000
+         << " cgi_us=" << timing.cgiNs / 1000 << " send_us="
+         << (timing.queued != 0 ? (timing.end - timing.queued) / 1000 : 0);
+    Logger::end();
+  }
+
+  if (g_every == 0 || !Logger::traceEnabled())
+    return;
+  bool sampled = --g_countdown == 0;
+  if (sampled)
+    g_countdown = g_every;
+  if (sampled || slow)
+    writeTrace(timing, request, start, slow);
+}
@@ -1,16 +1,22 @@
 #include "core/Server.hpp"
 #include "cgi/CGIHandler.hpp"
+#include "config/ConfigBuilder.hpp"
+#include "config_parser/parser/UtilsConfigParser.hpp"
+#include "core/Logger.hpp"
+#include "core/RequestTrace.hpp"
 #include <algorithm>
 #include <csignal>
 #include <cstdio>
 #include <cstring>
 #include <fcntl.h>
-#include <iostream>
 #include <map>
 #include <netinet/in.h>
 #include <poll.h>
+#include <set>
 #include <sstream>
+#include <sys/resource.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -20,13 +26,16 @@
  *
  * This is the core orchestrator of the web server. It manages:
  * - Multiple listening sockets (one per unique port)
- * - Client connections via non-blocking poll() event loop
+ * - Client connections via a non-blocking readiness event loop
  * - CGI process pipe handling for async script execution
  * - Connection timeouts and cleanup
+ * - Configuration reload on SIGHUP (see reload())
+ * - Graceful shutdown: draining the connections (see beginDrain()) and
+ *   binary upgrade on SIGUSR2 (see upgradeBinary())
  *
  * Architecture overview:
  * ```
- *   poll() event loop
+ *   wait() event loop (epoll/kqueue/poll)
  *        │
  *   ┌────┴────┐
  *   │         │
@@ -36,16 +45,19 @@
  * accept  read/write/CGI
  * ```
  *
- * The poll() array structure:
- * - Indices [0..N-1]: Server listening sockets (one per port)
- * - Indices [N..M]:   Client sockets and CGI output pipes
+ * Readiness backend:
+ * PollManager picks epoll (Linux), kqueue (macOS/BSD) or poll() - or the
+ * backend named by events { use ...; }, e.g. io_uring - and hands back only
+ * the fds that are ready, so every iteration costs O(ready) fds instead of
+ * O(registered) fds.
  *
  * Event handling flow:
- * 1. poll() waits for events (5 second timeout for periodic checks)
- * 2. Check server sockets for new connections → accept
- * 3. Check client sockets for data → read/process/write
- * 4. Check CGI pipes for output → collect and build response
- * 5. Cleanup closed connections
+ * 1. wait() blocks for events, until the nearest client deadline
+ * 2. For each ready fd, dispatch by its type:
+ *    server socket → accept, client socket → read/process/write,
+ *    CGI pipe → collect and build response
+ * 3. Handle the client timers that expired (TimerWheel)
+ * 4. Cleanup closed connections
  *
  * Non-blocking I/O:
  * All sockets are set to O_NONBLOCK. This means:
@@ -54,51 +66,111 @@
  * - send() returns EAGAIN when buffer full (partial write)
  *
  * @see ClientConnection for per-client state management
- * @see PollManager for poll() abstraction
+ * @see PollManager for the readiness backend abstraction
  * @see ServerSocket for listening socket management
  */
 
-// Global flag for graceful shutdown (defined in main.cpp)
+// Global flags for shutdown, reload and upgrade (defined in main.cpp)
 extern volatile sig_atomic_t g_running;
+extern volatile sig_atomic_t g_terminate;
+extern volatile sig_atomic_t g_reload;
+extern volatile sig_atomic_t g_upgrade;
 
 /**
  * @brief Constructor - stores virtual host configurations
  *
  * The server can handle multiple virtual hosts (server blocks) listening
- * on different ports or the same port with different server_names.
+ * on different ports or the same port with different server_names. They
+ * are grouped, indexed and shared with every connection through one
+ * ConfigSnapshot.
  *
  * @param servConfigsList Vector of server configurations from config parser
+ * @param globalConfig Process-wide settings (worker count, ...)
  */
-Server::Server(const std::vector<ServerConfig> &servConfigsList)
-    : _servConfigsList(servConfigsList) {}
+Server::Server(const std::vector<ServerConfig> &servConfigsList,
+               const GlobalConfig &globalConfig)
+    : _config(new ConfigSnapshot(servConfigsList)), _upgradePid(0),
+      _drainDeadline(0), _globalConfig(globalConfig),
+      _pollManager(_globalConfig.getEventBackend()), _clientCount(0),
+      _maxClients(0), _spareFd(-1), _idleHead(-1), _idleTail(-1) {
+  _mimeTypes.configure(_globalConfig);
+  _fileCache.configure(_globalConfig.getOpenFileCacheMax(),
+                       _globalConfig.getOpenFileCacheInactive(),
+                       _globalConfig.getOpenFileCacheValid(),
+                       _globalConfig.getOpenFileCacheErrors(),
+                       _globalConfig.getOpenFileCacheMmap());
+  _responseCache.configure(_globalConfig.getResponseCacheSize());
+  _cgiCache.configure(_globalConfig.getCgiCacheSize(),
+                      _globalConfig.getCgiCachePath());
+  _rateLimiter.configure(_globalConfig.getLimitReqZones());
+  _upstreamPool.resolveAll(_config->getServers());
+  _compression.configure(_globalConfig);
+  _services.fileCache = &_fileCache;
+  _services.responseCache = &_responseCache;
+  _services.bufferPool = &_bufferPool;
+  _services.fastcgiPool = &_fastcgiPool;
+  _services.listingCache = &_listingCache;
+  _services.compression = &_compression;
+  _services.ioPool = &_ioPool;
+  _services.upstreamPool = &_upstreamPool;
+  _services.cgiCache = &_cgiCache;
+  _services.rateLimiter = &_rateLimiter;
+  _services.mimeTypes = &_mimeTypes;
+  _services.pool = &_connectionPool;
+  _services.readBudget = _globalConfig.getIoReadBudget();
+  _services.writeBudget = _globalConfig.getIoWriteBudget();
+  if (_globalConfig.getGzip() && !Compression::isAvailable(Compression::GZIP))
+    LOG_WARN("gzip: built without zlib, responses are sent uncompressed");
+  if (_globalConfig.getBrotli() &&
+      !Compression::isAvailable(Compression::BROTLI))
+    LOG_WARN("brotli: built without libbrotlienc, directive ignored");
+  Metrics::configure(_globalConfig.getMetricsPath());
+  RequestTrace::configure(_globalConfig.getSlowRequestThreshold(),
+                          _globalConfig.getRequestTrace().empty()
+                              ? 0
+                              : _globalConfig.getRequestTraceEvery());
+  Metrics::setSource(this);
+}
 
 /**
  * @brief Destructor - cleanup all resources
  *
  * Properly releases all resources:
- * 1. Delete all ClientConnection objects (triggers their destructors)
- * 2. Delete all ServerSocket objects (closes listening sockets)
+ * 1. Destroy all ClientConnection objects (triggers their destructors)
+ * 2. Stop the I/O threads
+ * 3. Delete all ServerSocket objects (closes listening sockets)
  *
  * Memory ownership:
- * - Server owns ClientConnection* in _clientsByFd (via new)
+ * - Server owns ClientConnection* in FD_CLIENT slots (via _connectionPool)
  * - Server owns ServerSocket* in _serverSockets (via new)
  * - ClientConnection owns its socket fd (closes in its destructor)
  */
 Server::~Server() {
+  Metrics::setSource(NULL);
+
   // Close all client connections
-  for (std::map<int, ClientConnection *>::iterator it = _clientsByFd.begin();
-       it != _clientsByFd.end(); ++it) {
-    if (it->second) {
-      delete it->second;
+  for (size_t fd = 0; fd < _slots.size(); ++fd) {
+    if (_slots[fd].type == FD_CLIENT && _slots[fd].client) {
+      _connectionPool.destroy(_slots[fd].client);
     }
   }
-  _clientsByFd.clear();
+  _slots.clear();
+  _pendingClose.clear();
+
+  // After the connections: their tasks are cancelled, then joined/deleted
+  _ioPool.stop();
 
   // Close all server sockets
   for (size_t i = 0; i < _serverSockets.size(); ++i) {
     delete _serverSockets[i];
   }
   _serverSockets.clear();
+
+  if (_spareFd != -1)
+    close(_spareFd);
+
+  // Last reference once every connection released its own
+  _config->release();
 }
 
 /**
@@ -118,69 +190,498 @@ Server::~Server() {
  * @return true if all sockets initialized successfully, false on error
  */
 bool Server::init() {
-  // Step 1: Group server blocks by port (virtual hosting)
-  // Multiple server_names can share the same port
-  std::map<int, ConfigVector> configsByPort = groupConfigsByPort();
+  // Step 1: Server blocks grouped by port (virtual hosting), see
+  // ConfigSnapshot; multiple server_names can share the same port
+  const std::map<int, ListenerConfig> &listeners = _config->getListeners();
 
   // Step 2: Create one listening socket per unique port
-  for (std::map<int, ConfigVector>::iterator it = configsByPort.begin();
-       it != configsByPort.end(); ++it) {
-    int port = it->first;
+  for (std::map<int, ListenerConfig>::const_iterator it = listeners.begin();
+       it != listeners.end(); ++it) {
+    if (!openListener(it->first, it->second))
+      return false;
+  }
+  ServerSocket::closeInherited(); // Ports the new configuration dropped
 
-    // Create and initialize the server socket (socket + bind + listen)
-    ServerSocket *serverSocket = new ServerSocket(port);
+  // Step 3: Connection limit and the spare fd, per process
+  reserveConnectionFds();
 
-    if (!serverSocket->init()) {
-      std::cerr << "❌ [Error] Failed to initialize server socket on port "
-                << port << std::endl;
-      delete serverSocket;
-      return false;
+  // Step 4: I/O threads, started in the process that runs the loop (a
+  // worker is forked before init(), threads would not survive fork())
+  int ioThreads = _globalConfig.getIoThreads();
+  if (ioThreads > 0) {
+    if (_ioPool.start(ioThreads)) {
+      int notifyFd = _ioPool.getNotifyFd();
+      _pollManager.addFd(notifyFd, POLLIN);
+      setSlot(notifyFd, FD_IO_DONE, NULL);
+      LOG_INFO("io_threads: " << _ioPool.getThreadCount()
+               << " threads for blocking file I/O");
+      // Same kernel interface as the loop: cold file lookups skip threads
+      if (std::string(_pollManager.getBackendName()) == "io_uring" &&
+          _ioPool.enableUring())
+        LOG_INFO("io_threads: static file lookups run through io_uring");
+    } else {
+      LOG_WARN("io_threads: no thread could be started, file I/O stays on "
+               "the event loop");
     }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Opens, registers and logs the listening socket of one port
+ *
+ * A listener inherited from the previous binary (binary upgrade) is
+ * adopted instead of binding a new one.
+ *
+ * @param port Port to bind
+ * @param listener Its entry in the configuration being installed (on
+ *        reload, not _config yet): the listen options come from it
+ * @return true on success, false if the socket could not be bound
+ */
+bool Server::openListener(int port, const ListenerConfig &listener) {
+  // Create and initialize the server socket (socket + bind + listen)
+  // With several workers each one binds its own SO_REUSEPORT listener
+  ServerSocket *serverSocket = new ServerSocket(
+      port, _globalConfig.getWorkerProcesses() > 1, listener.options);
+
+  int inherited = ServerSocket::takeInherited(port);
+  bool adopted = inherited != -1 && serverSocket->adopt(inherited);
+  if (inherited != -1 && !adopted)
+    close(inherited);
+  if (!adopted && !serverSocket->init()) {
+    LOG_ERROR("Failed to initialize server socket on port " << port);
+    delete serverSocket;
+    return false;
+  }
+
+  // Step 3: Store socket and associate configs with this fd
+  int fd = serverSocket->getFd();
+  _serverSockets.push_back(serverSocket); // Keep track of socket object
+  _portByServerFd[fd] = port;             // Map fd → its port's configs
+  setSlot(fd, FD_LISTENER, NULL);
+
+  // Step 4: Register socket in poll manager for POLLIN events
+  // When a client connects, poll() will signal this fd
+  _pollManager.addListener(fd);
+
+  LOG_INFO("🌐 Server listening on port " << port << " (fd: " << fd
+           << (adopted ? ", inherited" : "") << ")");
+  return true;
+}
+
+/**
+ * @brief Stops accepting on one listener and closes it
+ *
+ * Connections already accepted on it are not affected.
+ *
+ * @param index Position in _serverSockets
+ */
+void Server::closeListener(size_t index) {
+  ServerSocket *serverSocket = _serverSockets[index];
+  int fd = serverSocket->getFd();
+
+  _pollManager.removeFd(fd);
+  clearSlot(fd);
+  _portByServerFd.erase(fd);
+  _serverSockets.erase(_serverSockets.begin() + index);
+  LOG_INFO("Stopped listening on port " << serverSocket->getPort()
+           << " (fd: " << fd << ")");
+  delete serverSocket;
+}
+
+void Server::setConfigPath(const std::string &path) { _configPath = path; }
+
+void Server::setCommandLine(int argc, char **argv) {
+  _commandLine.assign(argv, argv + argc);
+}
+
+/**
+ * @brief Starts the new binary (SIGUSR2), handing it every listener
+ *
+ * nginx-style upgrade: the new process adopts the listening sockets
+ * (see ServerSocket::spawnInheriting()) while this one keeps serving, so
+ * the ports never stop accepting. Once the new one is up, SIGQUIT (or
+ * SIGTERM) here drains the old one. If the new binary exits instead
+ * (bad configuration...), reapUpgrade() reports it and a later SIGUSR2
+ * may try again.
+ */
+void Server::upgradeBinary() {
+  if (_commandLine.empty())
+    return;
+  if (_upgradePid > 0) {
+    LOG_WARN("Binary upgrade already running (pid " << _upgradePid
+             << "), SIGUSR2 ignored");
+    return;
+  }
+  std::vector<std::pair<int, int> > listeners;
+  for (size_t i = 0; i < _serverSockets.size(); ++i)
+    listeners.push_back(std::make_pair(_serverSockets[i]->getPort(),
+                                       _serverSockets[i]->getFd()));
+  Logger::flush();
+  pid_t pid = ServerSocket::spawnInheriting(_commandLine, listeners);
+  if (pid == -1) {
+    LOG_ERROR("Binary upgrade: fork() failed: " << strerror(errno));
+    return;
+  }
+  _upgradePid = pid;
+  LOG_INFO("🔁 Binary upgrade: started " << _commandLine[0] << " (pid " << pid
+           << ") with " << listeners.size() << " listener(s)");
+}
 
-    // Step 3: Store socket and associate configs with this fd
-    int fd = serverSocket->getFd();
-    _serverSockets.push_back(serverSocket); // Keep track of socket object
-    _configsByServerFd[fd] = it->second;    // Map fd → server configs
+/**
+ * @brief Notices a new binary that exited (it failed to start)
+ */
+void Server::reapUpgrade() {
+  int status;
+  if (waitpid(_upgradePid, &status, WNOHANG) != _upgradePid)
+    return;
+  LOG_ERROR("Binary upgrade: pid " << _upgradePid << " exited with status "
+            << (WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status))
+            << ", still serving");
+  _upgradePid = 0;
+}
 
-    // Step 4: Register socket in poll manager for POLLIN events
-    // When a client connects, poll() will signal this fd
-    _pollManager.addFd(fd, POLLIN);
+/**
+ * @brief Graceful shutdown: stops accepting and lets the requests finish
+ *
+ * 1. Close every listener (an upgraded binary holding the same sockets
+ *    keeps accepting on them)
+ * 2. From now on every response says "Connection: close" and the
+ *    connection closes once it is sent (ConnectionServices::draining)
+ * 3. Idle keep-alive connections are closed at once, and so is every
+ *    connection that becomes idle (closeIdleClients() each round)
+ *
+ * run() returns when the last connection closed, or at
+ * worker_shutdown_timeout, when what is still open is cut.
+ */
+void Server::beginDrain() {
+  _services.draining = true;
+  _drainDeadline = time(NULL) + _globalConfig.getWorkerShutdownTimeout();
+  while (!_serverSockets.empty())
+    closeListener(_serverSockets.size() - 1);
+  LOG_INFO("Draining " << _clientCount << " connection(s), at most "
+           << _globalConfig.getWorkerShutdownTimeout()
+           << "s (worker_shutdown_timeout)");
+  closeIdleClients();
+}
+
+/**
+ * @brief Closes every idle keep-alive connection (while draining)
+ *
+ * Same test as evictIdleClient(): no request in progress, nothing left to
+ * send. HTTP/2 connections count as idle once no stream is open.
+ */
+void Server::closeIdleClients() {
+  while (_idleHead != -1) {
+    int fd = _idleHead;
+    unlinkIdle(fd);
+    ClientConnection *client = _slots[fd].client;
+    if (_slots[fd].pendingClose || client->isClosed() ||
+        client->getTimeoutPhase() != GlobalConfig::TIMEOUT_KEEPALIVE ||
+        client->hasPendingWrite())
+      continue;
+    client->markClosed();
+    scheduleClose(client);
+  }
+}
+
+/**
+ * @brief Re-reads the configuration file and switches to it (SIGHUP)
+ *
+ * Runs between two event loop rounds:
+ * 1. Parse, validate and build the file into a new ConfigSnapshot; on any
+ *    error the current configuration stays in place. Its proxy_pass
+ *    backends are resolved here, off the request path
+ * 2. Bind the ports that are new; if one fails, close the ones just
+ *    opened and keep the current configuration
+ * 3. Close the listeners of ports no longer configured
+ * 4. Swap snapshots: new connections use the new one, connections already
+ *    accepted keep a reference on the old one until they close
+ *
+ * Process-wide directives (worker_processes, caches, logs, budgets) are
+ * read at startup only.
+ *
+ * @return true if the new configuration is in use
+ */
+bool Server::reload() {
+  if (_configPath.empty())
+    return false;
+  LOG_INFO("🔄 Reloading configuration from " << _configPath);
+
+  // Step 1: Build the new configuration without touching the current one
+  ConfigSnapshot *next = NULL;
+  try {
+    BlockParser root = parseAndValidateConfig(_configPath);
+    ConfigBuilder builder;
+    next = new ConfigSnapshot(builder.buildFromBlockParser(root));
+  } catch (std::exception &e) {
+    LOG_ERROR("Reload failed, keeping the current configuration: "
+              << e.what());
+    return false;
+  }
+  const std::map<int, ListenerConfig> &listeners = next->getListeners();
+  _upstreamPool.resolveAll(next->getServers());
+
+  // Step 2: Open the added ports first, so a failure changes nothing
+  std::set<int> current;
+  for (size_t i = 0; i < _serverSockets.size(); ++i)
+    current.insert(_serverSockets[i]->getPort());
+  size_t opened = _serverSockets.size();
+  for (std::map<int, ListenerConfig>::const_iterator it = listeners.begin();
+       it != listeners.end(); ++it) {
+    if (current.count(it->first) == 0 &&
+        !openListener(it->first, it->second)) {
+      while (_serverSockets.size() > opened)
+        closeListener(_serverSockets.size() - 1);
+      next->release();
+      LOG_ERROR("Reload failed, keeping the current configuration");
+      return false;
+    }
+  }
 
-    std::cout << "🌐 Server listening on port " << port << " (fd: " << fd << ")"
-              << std::endl;
+  // Step 3: Stop accepting on the removed ports
+  for (size_t i = _serverSockets.size(); i-- > 0;) {
+    if (listeners.count(_serverSockets[i]->getPort()) == 0)
+      closeListener(i);
   }
 
+  // Step 4: Accepted connections hold their own reference on the old one
+  _config->release();
+  _config = next;
+  LOG_INFO("✅ Configuration reloaded: " << _config->getServers().size()
+           << " server(s) on " << _serverSockets.size() << " port(s)");
   return true;
 }
 
 /**
- * @brief Groups server configurations by port number
+ * @brief Records what an fd refers to in the dispatch table
  *
- * Multiple server blocks can listen on the same port (virtual hosting).
- * This function groups them so we create only one socket per port.
+ * The table is a flat vector indexed by fd number. fds are small dense
+ * integers handed out lowest-first by the kernel, so lookups are a single
+ * bounds check + index instead of a std::map tree walk.
  *
- * @return Map: port number → vector of ServerConfig for that port
+ * @param fd File descriptor (grows the table if needed)
+ * @param type FD_LISTENER, FD_CLIENT, FD_CGI_PIPE, FD_CGI_STDIN or
+ *        FD_IO_DONE
+ * @param client Owning connection (NULL for listeners)
  */
-std::map<int, std::vector<ServerConfig> > Server::groupConfigsByPort() {
-  std::map<int, ConfigVector> configsByPort;
-  for (size_t i = 0; i < _servConfigsList.size(); ++i) {
-    configsByPort[_servConfigsList[i].getListen()].push_back(
-        _servConfigsList[i]);
+void Server::setSlot(int fd, FdType type, ClientConnection *client) {
+  if (fd < 0)
+    return;
+  if ((size_t)fd >= _slots.size()) {
+    FdSlot empty;
+    empty.type = FD_FREE;
+    empty.client = NULL;
+    empty.pendingClose = false;
+    empty.idle = false;
+    empty.idlePrev = -1;
+    empty.idleNext = -1;
+    _slots.resize(fd + 1, empty);
+  }
+  _slots[fd].type = type;
+  _slots[fd].client = client;
+  _slots[fd].pendingClose = false;
+}
+
+/**
+ * @brief Marks an fd slot as free again
+ */
+void Server::clearSlot(int fd) {
+  if (fd < 0 || (size_t)fd >= _slots.size())
+    return;
+  unlinkIdle(fd);
+  _slots[fd].type = FD_FREE;
+  _slots[fd].client = NULL;
+  _slots[fd].pendingClose = false;
+}
+
+/**
+ * @brief Type of the fd in the dispatch table (FD_FREE if unknown)
+ */
+FdType Server::slotType(int fd) const {
+  if (fd < 0 || (size_t)fd >= _slots.size())
+    return FD_FREE;
+  return _slots[fd].type;
+}
+
+/**
+ * @brief Queues a closed client for the next cleanup pass (once)
+ *
+ * cleanupClosedClients() only walks this list, so a tick where nothing
+ * closed costs nothing.
+ */
+void Server::scheduleClose(ClientConnection *client) {
+  int fd = client->getFd();
+  if (slotType(fd) != FD_CLIENT || _slots[fd].pendingClose)
+    return;
+  _slots[fd].pendingClose = true;
+  _pendingClose.push_back(client);
+}
+
+/**
+ * @brief Moves a client to the most recent end of the idle list
+ *
+ * The list links idle keep-alive clients through their slots, least
+ * recently active first, so evictIdleClient() takes the head in O(1).
+ */
+void Server::linkIdle(int fd) {
+  unlinkIdle(fd);
+  FdSlot &slot = _slots[fd];
+  slot.idle = true;
+  slot.idlePrev = _idleTail;
+  slot.idleNext = -1;
+  if (_idleTail != -1)
+    _slots[_idleTail].idleNext = fd;
+  else
+    _idleHead = fd;
+  _idleTail = fd;
+}
+
+/**
+ * @brief Removes a client from the idle list (no-op if not in it)
+ */
+void Server::unlinkIdle(int fd) {
+  if (fd < 0 || (size_t)fd >= _slots.size() || !_slots[fd].idle)
+    return;
+  FdSlot &slot = _slots[fd];
+  if (slot.idlePrev != -1)
+    _slots[slot.idlePrev].idleNext = slot.idleNext;
+  else
+    _idleHead = slot.idleNext;
+  if (slot.idleNext != -1)
+    _slots[slot.idleNext].idlePrev = slot.idlePrev;
+  else
+    _idleTail = slot.idlePrev;
+  slot.idle = false;
+  slot.idlePrev = -1;
+  slot.idleNext = -1;
+}
+
+/**
+ * @brief Closes the least recently active idle keep-alive connection
+ *
+ * The client has no request in progress, so closing it only costs it a
+ * reconnect (what keepalive_timeout would do later anyway).
+ *
+ * @return true if a connection was closed to make room
+ */
+bool Server::evictIdleClient() {
+  while (_idleHead != -1) {
+    int fd = _idleHead;
+    unlinkIdle(fd);
+    ClientConnection *client = _slots[fd].client;
+    if (_slots[fd].pendingClose || client->isClosed() ||
+        client->getTimeoutPhase() != GlobalConfig::TIMEOUT_KEEPALIVE ||
+        client->hasPendingWrite())
+      continue; // Busy again since it was linked
+    LOG_DEBUG("worker_connections reached, closing idle fd " << fd);
+    client->markClosed();
+    scheduleClose(client);
+    Metrics::add(Metrics::EVICTED_IDLE);
+    return true;
+  }
+  return false;
+}
+
+/** @brief Sent to a connection refused by overload shedding */
+static const char OVERLOAD_RESPONSE[] =
+    "HTTP/1.1 503 Service Unavailable\r\n"
+    "Retry-After: 1\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 20\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    "Server overloaded.\r\n";
+
+/**
+ * @brief Answers a just-accepted connection 503 and closes it
+ *
+ * No ClientConnection is created: what the client already sent is read
+ * and dropped (closing with unread data would reset the connection and
+ * lose the 503), then one non-blocking send() of a canned response. Best
+ * effort: a client that sent nothing yet still gets the response. A TLS
+ * port is only closed: a handshake would cost what shedding saves.
+ *
+ * @param clientFd Accepted, non-blocking socket (closed here)
+ * @param reason Metrics counter of the refusal
+ * @param tls The port speaks TLS (no plaintext 503)
+ */
+void Server::rejectClient(int clientFd, Metrics::Counter reason, bool tls) {
+  char discard[4096];
+  while (recv(clientFd, discard, sizeof(discard), 0) > 0)
+    ;
+  if (!tls)
+    send(clientFd, OVERLOAD_RESPONSE, sizeof(OVERLOAD_RESPONSE) - 1,
+         MSG_NOSIGNAL);
+  close(clientFd);
+  Metrics::add(reason);
+}
+
+/**
+ * @brief Sets the connection limit and reserves the spare fd
+ *
+ * Each client needs its socket plus, at times, a file, pipes or a
+ * FastCGI socket. The soft RLIMIT_NOFILE is raised (up to the hard one)
+ * to hold worker_connections with that margin; when it cannot be, the
+ * limit is lowered to what fits rather than failing with EMFILE.
+ *
+ * The spare fd (/dev/null) is kept open so that, if fds still run out,
+ * acceptNewClient() can close it, accept the pending connection, answer it
+ * 503 and reopen it. Without it the listener stays readable while accept()
+ * fails, and the loop spins on it.
+ */
+void Server::reserveConnectionFds() {
+  static const rlim_t FD_MARGIN = 64; // Listeners, logs, pipes, files...
+  rlim_t wanted = static_cast<rlim_t>(_globalConfig.getWorkerConnections());
+  _maxClients = static_cast<size_t>(wanted);
+
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+      limit.rlim_cur != RLIM_INFINITY &&
+      limit.rlim_cur < wanted * 2 + FD_MARGIN) {
+    rlim_t raised = wanted * 2 + FD_MARGIN;
+    if (limit.rlim_max != RLIM_INFINITY && raised > limit.rlim_max)
+      raised = limit.rlim_max;
+    if (raised > limit.rlim_cur) {
+      limit.rlim_cur = raised;
+      setrlimit(RLIMIT_NOFILE, &limit);
+      getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if (limit.rlim_cur < wanted + FD_MARGIN) {
+      _maxClients = limit.rlim_cur > FD_MARGIN * 2
+                        ? static_cast<size_t>(limit.rlim_cur - FD_MARGIN)
+                        : static_cast<size_t>(limit.rlim_cur / 2);
+      LOG_WARN("worker_connections " << wanted << " exceeds the open file "
+               "limit (" << limit.rlim_cur << "), using " << _maxClients);
+    }
   }
-  return configsByPort;
+
+  _spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  if (_spareFd == -1)
+    LOG_WARN("Cannot reserve a spare fd: " << strerror(errno));
 }
 
 /**
  * @brief Main event loop - the heart of the server
  *
- * Uses poll() for non-blocking I/O multiplexing. The loop:
- * 1. Waits for events on any registered fd (5s timeout)
- * 2. Handles server socket events (new connections)
- * 3. Handles client socket events (read/write)
- * 4. Handles CGI pipe events (async script output)
- * 5. Cleans up closed connections
+ * Uses the PollManager readiness backend (epoll/kqueue/poll). The loop:
+ * 1. Waits for events on any registered fd, at most until the nearest
+ *    client deadline (waitTimeout())
+ * 2. Walks ONLY the fds reported ready and dispatches by fd type:
+ *    - server socket → accept new connections
+ *    - CGI pipe      → collect script output
+ *    - client socket → read/write
+ * 3. Handles the expired client timers (expireTimers()) and resumes the
+ *    requests that waited for a cgi_cache fill
+ * 4. Cleans up closed connections
+ * 5. Writes the log lines batched during the round (Logger::flush())
  *
- * Poll event handling order (important for correctness):
+ * Shutdown: once g_running drops the loop keeps going in drain mode (see
+ * beginDrain()) until no connection is left, worker_shutdown_timeout
+ * passes or g_terminate is set by a second signal.
+ *
+ * Event handling order per client (important for correctness):
  * 1. POLLERR/POLLHUP/POLLNVAL → Mark client closed immediately
  * 2. POLLIN → Read incoming data
  * 3. POLLOUT → Write pending response data
@@ -188,171 +689,407 @@ std::map<int, std::vector<ServerConfig> > Server::groupConfigsByPort() {
  * This order prevents attempting I/O on dead sockets.
  *
  * CGI pipe handling:
- * When a CGI script runs asynchronously, its output pipe is added to poll.
- * When POLLIN fires on the pipe, we read output until EOF, then build
- * the HTTP response and queue it for sending to the client.
+ * When a CGI script runs asynchronously, its output pipe is added to the
+ * backend. When POLLIN fires on the pipe, we read output until EOF, then
+ * build the HTTP response and queue it for sending to the client. A body
+ * that does not fit in the stdin pipe at once is fed on POLLOUT of that
+ * pipe (FD_CGI_STDIN), never with a blocking write().
  */
 void Server::run() {
-  std::cout << "[Info] Server running with poll()..." << std::endl;
+  LOG_INFO("Server running with " << _pollManager.getBackendName() << "()...");
+
+  for (;;) {
+    // SIGTERM/SIGQUIT/SIGINT: drain, until the last connection closed, the
+    // deadline, or a second signal
+    if (!g_running && !_services.draining)
+      beginDrain();
+    if (_services.draining && (_clientCount == 0 || g_terminate ||
+                               time(NULL) >= _drainDeadline))
+      break;
 
-  while (g_running) {
-    // Wait for events (5s timeout allows periodic timeout checks)
-    int ready = _pollManager.wait(5000);
+    // SIGHUP: switch configurations between two rounds
+    if (g_reload) {
+      g_reload = false;
+      if (!_services.draining)
+        reload();
+    }
+    // SIGUSR2: start the new binary on the same listeners
+    if (g_upgrade) {
+      g_upgrade = false;
+      if (!_services.draining)
+        upgradeBinary();
+    }
+    if (_upgradePid > 0)
+      reapUpgrade();
+
+    // Wait for events, at most until the nearest client deadline
+    uint64_t waitStart = Metrics::now();
+    int ready = _pollManager.wait(waitTimeout());
+    uint64_t busyStart = Metrics::now();
     if (ready < 0) {
+      Metrics::addLoopTime(busyStart - waitStart, 0);
       if (errno == EINTR)
         continue; // Interrupted by signal, retry
-      perror("poll");
+      perror(_pollManager.getBackendName());
       break;
     }
 
     time_t now = time(NULL);
+    HttpResponse::tickDate(now); // Date line shared by this round
 
-    // ===== PHASE 1: Accept new connections on server sockets =====
-    for (size_t i = 0; i < _serverSockets.size(); ++i) {
-      short revents = _pollManager.getRevents(i);
-      if (revents & POLLIN) {
-        acceptNewClient(_pollManager.getFd(i));
-      }
-    }
+    // ===== PHASE 1: Dispatch ready fds (O(1) slot lookup each) =====
+    for (size_t i = 0; i < _pollManager.getReadyCount(); ++i) {
+      int fd = _pollManager.getReadyFd(i);
+      short revents = _pollManager.getReadyEvents(i);
 
-    // ===== PHASE 2: Process client sockets and CGI pipes =====
-    for (size_t i = _serverSockets.size(); i < _pollManager.getSize();) {
-      int fd = _pollManager.getFd(i);
-
-      // --- CGI Pipe Check ---
-      std::map<int, ClientConnection *>::iterator cgiIt =
-          _cgiPipeToClient.find(fd);
-      if (cgiIt != _cgiPipeToClient.end()) {
-        ClientConnection *client = cgiIt->second;
-        short revents = _pollManager.getRevents(i);
-        if (revents & (POLLIN | POLLHUP | POLLERR)) {
-          handleCGIPipe(fd, client);
-        }
-        ++i;
-        continue;
-      }
+      switch (slotType(fd)) {
+      case FD_LISTENER:
+        if (revents & POLLIN)
+          acceptNewClient(fd);
+        break;
 
-      // --- Regular Client Socket ---
-      ClientConnection *client = _clientsByFd[fd];
+      case FD_CGI_PIPE:
+        if (revents & POLLOUT)
+          handleCGIWrite(fd, _slots[fd].client);
+        if (slotType(fd) == FD_CGI_PIPE &&
+            (revents & (POLLIN | POLLHUP | POLLERR)))
+          handleCGIPipe(fd, _slots[fd].client);
+        break;
 
-      if (!client) {
-        _pollManager.removeFd(fd);
-        continue;
-      }
+      case FD_CGI_STDIN:
+        if (revents & (POLLOUT | POLLHUP | POLLERR))
+          handleCGIStdin(fd, _slots[fd].client);
+        break;
 
-      // Check timeout first (more efficient)
-      checkClientTimeout(client, fd, now);
+      case FD_IO_DONE:
+        if (revents & POLLIN)
+          handleIoCompletions();
+        break;
 
-      if (!client->isClosed()) {
-        short revents = _pollManager.getRevents(i);
+      case FD_CLIENT: {
+        ClientConnection *client = _slots[fd].client;
+        if (client->isClosed())
+          break;
 
         // Handle errors first (before attempting I/O)
-        if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        if (revents & (POLLERR | POLLHUP | POLLNVAL))
           client->markClosed();
-          ++i;
-          continue;
-        }
 
         // Handle incoming data
-        if (revents & POLLIN) {
-          handleClientData(client, i);
-        }
+        if ((revents & POLLIN) && !client->isClosed())
+          handleClientData(client);
 
         // Handle outgoing data
-        if (revents & POLLOUT) {
-          handleClientWrite(client, i);
-          if (client->isClosed()) {
-            ++i;
-            continue;
-          }
-        }
+        if ((revents & POLLOUT) && !client->isClosed())
+          handleClientWrite(client);
+
+        if (client->isClosed())
+          scheduleClose(client);
+        else
+          armTimer(client); // Its phase or last activity may have moved
+        break;
       }
 
-      // Advance index if we didn't remove this fd
-      if (i < _pollManager.getSize() && _pollManager.getFd(i) == fd) {
-        // Pipelining note: if client has more data in buffer but request not
-        // yet complete and no pending writes, the next poll() iteration will
-        // continue processing. handleClientData() already loops on complete
-        // requests via checkForNextRequest().
-        ++i;
+      default:
+        _pollManager.removeFd(fd); // Stale registration
+        break;
       }
     }
 
+    // ===== PHASE 2: Expired client timers only =====
+    expireTimers(now);
+    resumeCacheWaiters(); // cgi_cache fills that ended this round
+
     // ===== PHASE 3: Cleanup closed connections =====
+    if (_services.draining)
+      closeIdleClients(); // Became idle this round: nothing more to serve
     cleanupClosedClients();
+
+    // ===== PHASE 4: One write() per log for this round's lines =====
+    Logger::flush();
+    Metrics::addLoopTime(busyStart - waitStart, Metrics::now() - busyStart);
+  }
+
+  if (_clientCount > 0)
+    LOG_WARN("Shutdown: closing " << _clientCount << " connection(s) "
+             << (g_terminate ? "on a second signal"
+                             : "at worker_shutdown_timeout"));
+  if (_fileCache.isEnabled())
+    LOG_INFO("open_file_cache: " << _fileCache.getHits() << " hits, "
+             << _fileCache.getMisses() << " misses, " << _fileCache.size()
+             << " entries");
+  if (_responseCache.isEnabled())
+    LOG_INFO("response cache: " << _responseCache.getHits() << " hits, "
+             << _responseCache.getMisses() << " misses, "
+             << _responseCache.getUsedBytes() << " bytes");
+  if (_cgiCache.getHits() + _cgiCache.getMisses() > 0)
+    LOG_INFO("cgi_cache: " << _cgiCache.getHits() << " hits, "
+             << _cgiCache.getMisses() << " misses, "
+             << _cgiCache.getUsedBytes() << " bytes");
+  for (size_t i = 0; i < _rateLimiter.zoneCount(); ++i) {
+    const RateLimiter::Counters &counters = _rateLimiter.getCounters(i);
+    LOG_INFO("limit_req zone " << _rateLimiter.getZone(i).name << ": "
+             << counters.passed << " passed, " << counters.delayed
+             << " delayed, " << counters.rejected << " rejected, "
+             << _rateLimiter.size(i) << "/" << _rateLimiter.capacity(i)
+             << " keys");
   }
+  if (_listingCache.getScans() > 0)
+    LOG_INFO("autoindex: " << _listingCache.getHits() << " cached pages, "
+             << _listingCache.getMisses() << " rendered, "
+             << _listingCache.getScans() << " directory scans");
+  if (_ioPool.isEnabled())
+    LOG_INFO("io_threads: " << _ioPool.getSubmitted() << " tasks");
+  if (_fastcgiPool.getOpened() > 0)
+    LOG_INFO("fastcgi_pass: " << _fastcgiPool.getOpened()
+             << " connections opened, " << _fastcgiPool.getReused()
+             << " reused");
+  if (_upstreamPool.getOpened() > 0)
+    LOG_INFO("proxy_pass: " << _upstreamPool.getOpened()
+             << " connections opened, " << _upstreamPool.getReused()
+             << " reused");
+  LOG_INFO("buffer pool: " << _bufferPool.getAcquired()
+           << " blocks acquired, " << _bufferPool.getReused() << " reused, "
+           << _bufferPool.getFree() << " free");
+  LOG_INFO("connection pool: " << _connectionPool.getAcquired()
+           << " exchanges acquired, " << _connectionPool.getReused()
+           << " reused, " << _connectionPool.getFreeExchanges() << " free");
 }
 
+/** @brief Directive name of each GlobalConfig::Timeout, for the logs */
+static const char *const TIMEOUT_NAMES[GlobalConfig::TIMEOUT_COUNT] = {
+    "client_header_timeout", "client_body_timeout", "keepalive_timeout",
+    "send_timeout", "cgi_timeout"};
+
 /**
- * @brief Checks if a client has timed out due to inactivity
+ * @brief (Re)arms the timer of a client for the phase it is in now
  *
- * Clients with no activity for CLIENT_TIMEOUT seconds are closed.
- * Exception: clients with pending write data are not timed out.
+ * Called after every event that touched the client, so the wheel always
+ * holds last activity + the timeout of its current phase. Also keeps the
+ * idle keep-alive list (LRU order) that evictIdleClient() takes from.
  *
- * @param client The client connection to check
- * @param fd Client's file descriptor (for logging)
- * @param now Current timestamp
+ * @param client Open client connection
  */
-void Server::checkClientTimeout(ClientConnection *client, int fd, time_t now) {
-  const int CLIENT_TIMEOUT = 30;
-
-  // Don't timeout if we're still sending data
-  if (client->hasPendingWrite()) {
+void Server::armTimer(ClientConnection *client) {
+  if (client->isLimitDelayed()) { // Woken by expireTimers() to run then
+    _timers.schedule(client->getFd(), client->getLimitResume());
+    unlinkIdle(client->getFd());
+    return;
+  }
+  if (client->isRatePaused()) { // limit_rate: POLLOUT again from then
+    _timers.schedule(client->getFd(), client->getRateResume());
+    unlinkIdle(client->getFd());
     return;
   }
+  GlobalConfig::Timeout phase = client->getTimeoutPhase();
+  int timeout = _globalConfig.getTimeout(phase);
+  _timers.schedule(client->getFd(),
+                   client->getTimeoutStart(phase) + timeout);
+  if (phase == GlobalConfig::TIMEOUT_KEEPALIVE)
+    linkIdle(client->getFd()); // Most recently active idle client
+  else
+    unlinkIdle(client->getFd());
+}
 
-  if (client->isTimedOut(now, CLIENT_TIMEOUT)) {
-    std::cout << "⚠️ [Timeout] Client fd " << fd << " inactive for "
-              << CLIENT_TIMEOUT << "s, closing." << std::endl;
+/**
+ * @brief Handles the client timers due at now
+ *
+ * Only the expired entries are visited. A request held by limit_req runs
+ * now, a response paused by limit_rate writes again. A stalled CGI is killed and answered with 504, a request still
+ * waiting for a cgi_cache fill goes to the origin itself; any other phase
+ * closes the connection.
+ *
+ * @param now Current timestamp
+ */
+void Server::expireTimers(time_t now) {
+  _expired.clear();
+  _timers.expire(now, _expired);
+  for (size_t i = 0; i < _expired.size(); ++i) {
+    int fd = _expired[i];
+    if (slotType(fd) != FD_CLIENT || _slots[fd].pendingClose)
+      continue;
+    ClientConnection *client = _slots[fd].client;
+    if (client->isLimitDelayed()) {
+      if (client->getLimitResume() <= now) {
+        client->resumeLimitDelay();
+        client->updateActivity();
+        processBufferedRequests(client);
+      }
+      if (client->isClosed())
+        scheduleClose(client);
+      else
+        armTimer(client);
+      continue;
+    }
+    if (client->isRatePaused()) {
+      if (client->getRateResume() <= now) {
+        client->resumeRatePause();
+        client->updateActivity(); // send_timeout restarts
+        _pollManager.updateEvents(fd, POLLIN | POLLOUT);
+      }
+      armTimer(client);
+      continue;
+    }
+    GlobalConfig::Timeout phase = client->getTimeoutPhase();
+    int timeout = _globalConfig.getTimeout(phase);
+    if (client->getTimeoutStart(phase) + timeout > now) {
+      armTimer(client); // Activity or a new phase since it was armed
+      continue;
+    }
+
+    if (phase == GlobalConfig::TIMEOUT_CGI && client->isCacheWaiting()) {
+      LOG_WARN("cgi_cache fill awaited by client fd " << fd << " for "
+               << timeout << "s, going to the origin");
+      client->resumeCacheWait(true);
+      client->updateActivity();
+      processBufferedRequests(client);
+      if (client->isClosed())
+        scheduleClose(client);
+      else
+        armTimer(client);
+      continue;
+    }
+
+    if (phase == GlobalConfig::TIMEOUT_CGI) {
+      LOG_WARN("CGI of client fd " << fd << " still running after " << timeout
+               << "s (" << TIMEOUT_NAMES[phase] << "), killing it");
+      int pipeFd = client->getCGIPipeFd();
+      if (pipeFd != -1 && slotType(pipeFd) == FD_CGI_PIPE) {
+        _pollManager.removeFd(pipeFd);
+        clearSlot(pipeFd);
+      }
+      unwatchCGIStdin(client);
+      client->abortCGI();
+      if (client->isClosed()) { // Streamed response cut short
+        scheduleClose(client);
+        continue;
+      }
+      client->updateActivity(); // send_timeout starts now
+      _pollManager.updateEvents(fd, POLLIN | POLLOUT);
+      armTimer(client);
+      continue;
+    }
+
+    LOG_WARN("Client fd " << fd << " timed out after " << timeout << "s ("
+             << TIMEOUT_NAMES[phase] << "), closing.");
     client->markClosed();
+    scheduleClose(client);
   }
 }
 
+/**
+ * @brief Readiness wait timeout: until the nearest client deadline
+ *
+ * While draining, the drain deadline counts as one; while a new binary
+ * starts, the wait is at most a second.
+ *
+ * @return Milliseconds to wait, -1 (no limit) when no timer is armed
+ */
+int Server::waitTimeout() const {
+  if (_cgiCache.hasWoken())
+    return 0; // Released by a connection closed during cleanup
+  time_t next = _timers.nextExpiry();
+  if (_services.draining && (next == 0 || _drainDeadline < next))
+    next = _drainDeadline;
+  long ms = -1;
+  if (next != 0) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    ms = (next - now.tv_sec) * 1000L - now.tv_usec / 1000;
+    if (ms < 0)
+      ms = 0;
+  }
+  if (_upgradePid > 0 && (ms < 0 || ms > 1000))
+    ms = 1000; // Notices a failed upgrade within a second (reapUpgrade())
+  return static_cast<int>(ms);
+}
+
 /**
  * @brief Accepts new client connections from a server socket
  *
  * Called when poll() indicates POLLIN on a server socket.
- * Uses a loop because multiple connections may be pending.
+ * Loops because multiple connections may be pending, but accepts at most
+ * ACCEPT_BATCH per loop round: during a connection storm the listener
+ * would otherwise keep the loop busy while the clients already accepted
+ * wait. The listener stays readable, so the rest is accepted next round.
+ *
+ * Overload: a connection is answered 503 (Retry-After) and closed when
+ * its address holds limit_conn_per_ip connections, when the process holds
+ * worker_connections and none of them is idle (otherwise the least
+ * recently active idle keep-alive one is closed to make room), or when
+ * fds run out (EMFILE, through the spare fd).
  *
  * For each new client:
- * 1. accept() creates a new socket fd for the client
- * 2. Set socket to non-blocking mode
- * 3. Create ClientConnection object with appropriate configs
- * 4. Add to poll manager for event monitoring
+ * 1. PollManager::accept() gives a non-blocking, close-on-exec client
+ *    socket (accept4(), or one io_uring already accepted)
+ * 2. Create ClientConnection object with appropriate configs
+ * 3. Add to poll manager for event monitoring
  *
  * @param serverFd The server socket that has pending connections
  */
 void Server::acceptNewClient(int serverFd) {
-  while (true) {
-    sockaddr_in clientAddr;
-    socklen_t clientLen = sizeof(clientAddr);
+  const ListenerConfig *listener =
+      _config->findListener(_portByServerFd[serverFd]);
+  bool tls = listener && listener->tls;
+  int perIpLimit = _globalConfig.getLimitConnPerIp();
 
-    int clientFd = accept(serverFd, (struct sockaddr *)&clientAddr, &clientLen);
+  for (int accepted = 0; accepted < ACCEPT_BATCH; ++accepted) {
+    sockaddr_in clientAddr;
+    int clientFd = _pollManager.accept(serverFd, clientAddr);
     if (clientFd == -1) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK)
-        break; // No more pending connections
-      perror("accept");
-      break;
+      if (errno == ECONNABORTED || errno == EINTR)
+        continue; // Peer gave up while queued, try the next one
+      if ((errno == EMFILE || errno == ENFILE) && _spareFd != -1) {
+        // Out of fds: free the spare one to take the connection off the
+        // queue and refuse it, else the listener would stay readable
+        LOG_WARN("accept on fd " << serverFd << ": " << strerror(errno)
+                 << ", refusing the connection");
+        close(_spareFd);
+        clientFd = _pollManager.accept(serverFd, clientAddr);
+        if (clientFd != -1)
+          rejectClient(clientFd, Metrics::REJECTED_NO_FD, tls);
+        _spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if (clientFd != -1 && _spareFd != -1)
+          continue;
+      } else if (errno != EAGAIN && errno != EWOULDBLOCK)
+        LOG_ERROR("accept on fd " << serverFd << ": " << strerror(errno));
+      break; // No more pending connections
     }
 
-    // Set non-blocking mode
-    int flags = fcntl(clientFd, F_GETFL, 0);
-    if (flags == -1 || fcntl(clientFd, F_SETFL, flags | O_NONBLOCK) == -1) {
-      std::cerr << "❌ [Error] Failed to set non-blocking mode: "
-                << strerror(errno) << std::endl;
+    // Create client with the current configs of this server socket
+    if (!listener) {
       close(clientFd);
       continue;
     }
 
-    // Create client with configs for this server socket
-    ClientConnection *client = new ClientConnection(
-        clientFd, clientAddr, _configsByServerFd[serverFd]);
-    _clientsByFd[clientFd] = client;
+    // Overload shedding: one address may not take the whole table, and a
+    // full table first gives up its least recently active idle client.
+    // find(): a refused address must not leave an entry behind
+    uint32_t addr = clientAddr.sin_addr.s_addr;
+    std::map<uint32_t, int>::const_iterator open = _clientsByAddr.find(addr);
+    if (perIpLimit > 0 && open != _clientsByAddr.end() &&
+        open->second >= perIpLimit) {
+      rejectClient(clientFd, Metrics::REJECTED_PER_IP, tls);
+      continue;
+    }
+    if (_clientCount - _pendingClose.size() >= _maxClients &&
+        !evictIdleClient()) {
+      rejectClient(clientFd, Metrics::REJECTED_FULL, tls);
+      continue;
+    }
+
+    ClientConnection *client = _connectionPool.create(
+        clientFd, clientAddr, _config, *listener, _services);
+    setSlot(clientFd, FD_CLIENT, client);
+    ++_clientCount;
+    ++_clientsByAddr[addr];
+    Metrics::add(Metrics::ACCEPTED);
+    armTimer(client); // client_header_timeout
 
     _pollManager.addFd(clientFd, POLLIN);
 
-    std::cout << "✅ [Info] New connection (fd: " << clientFd
-              << ", IP: " << client->getIp() << ")" << std::endl;
+    LOG_DEBUG("New connection (fd: " << clientFd << ", IP: "
+              << client->getIp() << ")");
   }
 }
 
@@ -360,50 +1097,79 @@ void Server::acceptNewClient(int serverFd) {
  * @brief Handles incoming data from a client socket
  *
  * Called when poll() indicates POLLIN on a client socket.
- * Implements HTTP pipelining - multiple requests can be in the buffer.
- *
- * Flow:
- * 1. Read available data into client's buffer
- * 2. While a complete request is in buffer:
- *    a. Parse and process the request
- *    b. Generate and queue response
- *    c. If CGI async, break and wait for pipe
- *    d. Check for next pipelined request
- * 3. If data pending to write, enable POLLOUT
+ * Reads available data, then runs every complete buffered request.
  *
  * @param client The client with data to read
- * @param pollIndex Index in poll array (for event updates)
  */
-void Server::handleClientData(ClientConnection *client, size_t pollIndex) {
+void Server::handleClientData(ClientConnection *client) {
   // 1. Read data from socket
   if (!client->readRequest())
     return; // Error or disconnect, cleanup will handle
 
-  // 2. Process requests (loop for pipelining support)
-  while (client->isRequestComplete()) {
+  // 2. Process complete requests (pipelining support)
+  processBufferedRequests(client);
+}
+
+/**
+ * @brief Processes buffered requests one response at a time
+ *
+ * Implements HTTP pipelining - multiple requests can be in the buffer.
+ *
+ * Flow:
+ * 1. While a complete request is available:
+ *    a. Process it and queue its response; with more pipelined bytes
+ *       buffered, a small response is held instead of written (see
+ *       ClientConnection::sendResponse()) and the loop goes on
+ *    b. If CGI async, register the pipe and stop; if parked on an I/O
+ *       task, stop (handleIoCompletions() resumes it)
+ *    c. If the response could not be sent at once, stop: the next request
+ *       is only parsed after POLLOUT finishes this one (responses must not
+ *       overwrite each other and must go out in order)
+ * 2. Write the held responses in one go, if no response carried them
+ * 3. If data pending to write, enable POLLOUT
+ *
+ * Nothing runs while bytes from an earlier call wait for POLLOUT: the
+ * socket may be full, and they have to go out first anyway.
+ *
+ * @param client The client whose buffer may hold complete requests
+ */
+void Server::processBufferedRequests(ClientConnection *client) {
+  // A response still going out belongs to the current request: running it
+  // again would rebuild and interleave it with the unsent part
+  bool waiting = client->hasPendingWrite();
+  while (!waiting && !client->isClosed() && !client->isResponsePending() &&
+         (client->isRequestComplete() || client->checkForNextRequest())) {
     if (!client->processRequest() || !client->sendResponse())
       return; // Error, client marked closed
 
     // CGI async registration
     if (client->getCGIState() == CGI_RUNNING) {
-      int pipeFd = client->getCGIPipeFd();
-      if (pipeFd != -1 &&
-          _cgiPipeToClient.find(pipeFd) == _cgiPipeToClient.end()) {
-        _pollManager.addFd(pipeFd, POLLIN);
-        _cgiPipeToClient[pipeFd] = client;
-      }
+      watchCGI(client);
       break; // Wait for CGI to complete before processing next request
     }
 
-    // Check for next pipelined request
-    if (!client->checkForNextRequest()) {
+    // Parked on an I/O thread: resumed by handleIoCompletions()
+    if (client->isIoPending())
+      break;
+
+    // Waiting for a cgi_cache fill: resumed by resumeCacheWaiters()
+    if (client->isCacheWaiting())
+      break;
+
+    // Held by limit_req: resumed by expireTimers()
+    if (client->isLimitDelayed())
+      break;
+
+    // Partially sent: continue on POLLOUT
+    if (client->isResponsePending())
       break;
-    }
   }
+  if (!waiting && !client->isClosed() && !client->flushBatch())
+    return; // Error, client marked closed
 
-  // 3. Enable POLLOUT if we have data to send
-  if (client->hasPendingWrite()) {
-    _pollManager.updateEventsByIndex(pollIndex, POLLIN | POLLOUT);
+  // Enable POLLOUT if we have data to send (limit_rate: once resumed)
+  if (client->hasPendingWrite() && !client->isRatePaused()) {
+    _pollManager.updateEvents(client->getFd(), POLLIN | POLLOUT);
   }
 }
 
@@ -411,84 +1177,136 @@ void Server::handleClientData(ClientConnection *client, size_t pollIndex) {
  * @brief Handles outgoing data to a client socket
  *
  * Called when poll() indicates POLLOUT on a client socket.
- * Attempts to flush the write buffer to the socket.
+ * Attempts to flush the write buffer (or file-backed body) to the socket.
  *
- * When buffer is fully sent, POLLOUT is disabled to avoid
- * busy-polling (sockets are almost always writable).
+ * When the response is fully sent, pipelined requests that arrived in the
+ * meantime are processed, and POLLOUT is disabled if nothing is left to
+ * avoid busy-polling (sockets are almost always writable).
  *
  * @param client The client with data to write
- * @param pollIndex Index in poll array (for event updates)
  */
-void Server::handleClientWrite(ClientConnection *client, size_t pollIndex) {
+void Server::handleClientWrite(ClientConnection *client) {
   client->updateActivity();
 
   if (!client->flushWrite())
     return; // Error, client marked closed
 
-  // Disable POLLOUT when nothing left to send
+  // Streamed CGI output: read the script again once half the window drained
+  if (client->isCGIPaused() &&
+      client->getCGIBacklog() < ClientConnection::CGI_STREAM_WINDOW / 2) {
+    int pipeFd = client->getCGIPipeFd();
+    _pollManager.addFd(pipeFd, POLLIN);
+    setSlot(pipeFd, FD_CGI_PIPE, client);
+    client->setCGIPaused(false);
+  }
+
+  // limit_rate: this second's share is out, expireTimers() resumes it
+  if (client->isRatePaused()) {
+    _pollManager.updateEvents(client->getFd(), POLLIN);
+    return;
+  }
+
   if (!client->hasPendingWrite()) {
-    _pollManager.updateEventsByIndex(pollIndex, POLLIN);
+    if (!client->isClosed() && client->getCGIState() == CGI_NONE &&
+        !client->isIoPending() && !client->isCacheWaiting() &&
+        !client->isLimitDelayed())
+      processBufferedRequests(client);
+
+    // Disable POLLOUT when nothing left to send
+    if (!client->hasPendingWrite())
+      _pollManager.updateEvents(client->getFd(), POLLIN);
   }
 }
 
 /**
  * @brief Removes closed client connections and frees resources
  *
- * Iterates through all clients and removes those marked as closed.
+ * Only walks the pending-close list filled by scheduleClose(), so the cost
+ * is proportional to the number of connections that actually closed.
  * Also cleans up any associated CGI pipes.
  *
- * Safe iteration: uses post-increment erase pattern to avoid
- * iterator invalidation.
+ * fds are unregistered from the backend and their slots freed BEFORE the
+ * connection is deleted (which closes them), so a reused fd number never
+ * inherits a stale slot.
  */
 void Server::cleanupClosedClients() {
-  for (std::map<int, ClientConnection *>::iterator it = _clientsByFd.begin();
-       it != _clientsByFd.end();) {
-    int fd = it->first;
-    ClientConnection *client = it->second;
-
-    if (client->isClosed()) {
-      std::cout << "[Info] Closing connection fd: " << fd << std::endl;
+  for (size_t i = 0; i < _pendingClose.size(); ++i) {
+    ClientConnection *client = _pendingClose[i];
+    int fd = client->getFd();
 
-      // Cleanup associated CGI pipe if any
-      int pipeFd = client->getCGIPipeFd();
-      if (pipeFd != -1) {
-        _pollManager.removeFd(pipeFd);
-        _cgiPipeToClient.erase(pipeFd);
-      }
+    LOG_DEBUG("Closing connection fd: " << fd);
 
-      _pollManager.removeFd(fd);
-      delete client;
-      _clientsByFd.erase(it++);
-    } else {
-      ++it;
+    // Cleanup associated CGI pipes if any
+    int pipeFd = client->getCGIPipeFd();
+    if (pipeFd != -1 && slotType(pipeFd) == FD_CGI_PIPE) {
+      _pollManager.removeFd(pipeFd);
+      clearSlot(pipeFd);
     }
+    unwatchCGIStdin(client);
+
+    _pollManager.removeFd(fd);
+    clearSlot(fd);
+    _timers.cancel(fd);
+    --_clientCount;
+    std::map<uint32_t, int>::iterator addr =
+        _clientsByAddr.find(client->getAddr());
+    if (addr != _clientsByAddr.end() && --addr->second <= 0)
+      _clientsByAddr.erase(addr);
+    _connectionPool.destroy(client);
   }
+  _pendingClose.clear();
 }
 
 /**
  * @brief Handles CGI pipe data when poll() detects POLLIN
  *
  * Called when there's data to read from a running CGI process.
- * Reads available data until EOF, then builds HTTP response.
+ * The response starts as soon as the script's headers are complete and
+ * its body is relayed as it is read (see relayCGIOutput()).
  *
  * Flow:
- * 1. Read data from pipe (non-blocking)
- * 2. When EOF reached (CGI done):
+ * 1. Read data from pipe (non-blocking) and relay it to the client
+ * 2. While running: enable POLLOUT when bytes got queued; past
+ *    CGI_STREAM_WINDOW unsent bytes, unregister the pipe (the script
+ *    blocks on a full pipe) until handleClientWrite() drained half of it
+ * 3. When EOF reached (CGI done; END_REQUEST for FastCGI, end of the
+ *    backend's response for proxy_pass):
  *    a. Reap zombie process with waitpid(WNOHANG)
- *    b. Remove pipe from poll and tracking
- *    c. Parse CGI output and build HTTP response
+ *    b. Remove pipe from the backend and tracking, then close it (a
+ *       FastCGI connection goes back to FastCGIPool, a proxy_pass one
+ *       to UpstreamPool instead)
+ *    c. Streamed: terminate the body. Otherwise parse the whole CGI
+ *       output and build HTTP response (502 if FastCGI or the backend
+ *       failed)
  *    d. Queue response and enable POLLOUT
  *
  * @param pipeFd The CGI output pipe with data
  * @param client The client waiting for CGI response
  */
 void Server::handleCGIPipe(int pipeFd, ClientConnection *client) {
-  if (!client || client->getCGIState() != CGI_RUNNING) {
+  if (!client || client->getCGIState() == CGI_NONE ||
+      client->getCGIPipeFd() != pipeFd) {
     return;
   }
 
-  // Read available data
-  bool readOk = client->readCGIOutput();
+  // Read available data (already done if a FastCGI send just failed). A
+  // failed read ends the exchange itself (CGI_DONE, handled below)
+  bool wasPending = client->hasPendingWrite();
+  if (client->getCGIState() == CGI_RUNNING)
+    client->readCGIOutput();
+  client->relayCGIOutput();
+  int clientFd = client->getFd();
+
+  if (client->getCGIState() == CGI_RUNNING) {
+    if (!wasPending && client->hasPendingWrite())
+      _pollManager.updateEvents(clientFd, POLLIN | POLLOUT);
+    if (client->getCGIBacklog() >= ClientConnection::CGI_STREAM_WINDOW &&
+        !client->hasCGIInput()) {
+      _pollManager.removeFd(pipeFd);
+      clearSlot(pipeFd);
+      client->setCGIPaused(true);
+    }
+  }
 
   // Check if CGI is done (EOF reached)
   if (client->getCGIState() == CGI_DONE) {
@@ -499,22 +1317,261 @@ void Server::handleCGIPipe(int pipeFd, ClientConnection *client) {
       waitpid(pid, &status, WNOHANG);
     }
 
-    // Remove pipe from poll
+    // Remove pipes from the backend BEFORE closing them
     _pollManager.removeFd(pipeFd);
-    _cgiPipeToClient.erase(pipeFd);
+    clearSlot(pipeFd);
 
-    // Build HTTP response from CGI output
-    CGIHandler cgiHandler;
-    HttpResponse response =
-        cgiHandler.buildResponseFromCGIOutput(client->getCGIBuffer());
+    // A reused proxy_pass connection that failed early: once more, anew
+    if (client->hasCGIFailed() && client->retryProxy()) {
+      watchCGI(client);
+      armTimer(client);
+      return;
+    }
+    unwatchCGIStdin(client);
+    client->finishCGI(0);
 
-    // Queue response for sending
-    std::string responseStr = response.buildResponse();
-    client->setCGIResponse(responseStr);
+    if (client->isCGIStreaming()) {
+      client->endCGIStream();
+      if (client->isClosed()) {
+        scheduleClose(client);
+        return;
+      }
+    } else {
+      // Build HTTP response from CGI output (a broken FastCGI exchange has
+      // no usable output: 502 Bad Gateway)
+      HttpResponse response;
+      if (client->hasCGIFailed()) {
+        response.setErrorResponse(502);
+      } else {
+        CGIHandler cgiHandler;
+        response =
+            cgiHandler.buildResponseFromCGIOutput(client->getCGIBuffer());
+      }
+
+      // Queue response for sending (the body is sent from the CGI buffer)
+      client->setCGIResponse(response);
+    }
 
     // Activate POLLOUT
-    int clientFd = client->getFd();
     _pollManager.updateEvents(clientFd, POLLIN | POLLOUT);
   }
-  (void)readOk;
+  armTimer(client); // send_timeout once done
+}
+
+/**
+ * @brief Sends FastCGI request records when POLLOUT fires on the socket
+ *
+ * The first POLLOUT also tells that a non-blocking connect() finished.
+ * Once everything is sent only POLLIN stays enabled; if the connection
+ * failed, handleCGIPipe() answers 502 right away.
+ *
+ * @param cgiFd FastCGI connection of the client
+ * @param client The client waiting for the script
+ */
+void Server::handleCGIWrite(int cgiFd, ClientConnection *client) {
+  if (!client || client->getCGIState() != CGI_RUNNING)
+    return;
+  if (!client->writeCGIInput()) {
+    handleCGIPipe(cgiFd, client);
+    return;
+  }
+  if (!client->hasCGIInput())
+    _pollManager.updateEvents(cgiFd, POLLIN);
+  armTimer(client);
+}
+
+/**
+ * @brief Registers the fds of a CGI that just started
+ *
+ * - Output pipe / FastCGI socket → POLLIN (FD_CGI_PIPE); a FastCGI socket
+ *   also waits for POLLOUT while request records are left to send
+ * - Stdin pipe, if the body did not fit in the pipe buffer at once →
+ *   POLLOUT (FD_CGI_STDIN)
+ *
+ * @param client Connection whose CGI is CGI_RUNNING
+ */
+void Server::watchCGI(ClientConnection *client) {
+  int pipeFd = client->getCGIPipeFd();
+  if (pipeFd != -1 && slotType(pipeFd) != FD_CGI_PIPE) {
+    bool fastcgiInput = client->hasCGIInput() && client->getCGIStdinFd() == -1;
+    _pollManager.addFd(pipeFd, fastcgiInput ? POLLIN | POLLOUT : POLLIN);
+    setSlot(pipeFd, FD_CGI_PIPE, client);
+  }
+  int stdinFd = client->getCGIStdinFd();
+  if (stdinFd != -1 && slotType(stdinFd) != FD_CGI_STDIN) {
+    _pollManager.addFd(stdinFd, POLLOUT);
+    setSlot(stdinFd, FD_CGI_STDIN, client);
+  }
+}
+
+/**
+ * @brief Unregisters and closes the stdin pipe of a client's CGI, if any
+ */
+void Server::unwatchCGIStdin(ClientConnection *client) {
+  int stdinFd = client->getCGIStdinFd();
+  if (stdinFd == -1)
+    return;
+  if (slotType(stdinFd) == FD_CGI_STDIN) {
+    _pollManager.removeFd(stdinFd);
+    clearSlot(stdinFd);
+  }
+  client->closeCGIInput();
+}
+
+/**
+ * @brief Feeds the request body to a CGI when its stdin pipe has room
+ *
+ * The script reads at its own pace while every other client keeps being
+ * served. Once the whole body is in (or the script closed stdin), the
+ * pipe is unregistered and closed so the script sees EOF.
+ *
+ * @param stdinFd Write end of the script's stdin
+ * @param client The client whose body is fed
+ */
+void Server::handleCGIStdin(int stdinFd, ClientConnection *client) {
+  if (!client || client->getCGIStdinFd() != stdinFd)
+    return;
+  client->writeCGIInput();
+  if (!client->hasCGIInput())
+    unwatchCGIStdin(client);
+  armTimer(client);
+}
+
+/**
+ * @brief Resumes the connections whose I/O task finished
+ *
+ * Called on POLLIN of the pool's notify fd. Each task installs its result
+ * (complete()) and its connection runs the request again, which now finds
+ * everything in memory and queues the response like any other request.
+ * Tasks whose connection went away meanwhile are only deleted.
+ */
+void Server::handleIoCompletions() {
+  _ioPool.collect(_ioDone);
+  for (size_t i = 0; i < _ioDone.size(); ++i) {
+    IoTask *task = _ioDone[i];
+    ClientConnection *client = task->getOwner();
+    if (client) {
+      client->completeIo(task);
+      if (!client->isClosed())
+        processBufferedRequests(client);
+      if (client->isClosed())
+        scheduleClose(client);
+      else
+        armTimer(client);
+    }
+    delete task;
+  }
+  _ioDone.clear();
+}
+
+/**
+ * @brief Resumes the connections whose cgi_cache lock was released
+ *
+ * A request that found its key being filled by another one waits for
+ * that response instead of starting the script again. Once the fill
+ * stored (or gave up) the entry, the request runs again: normally a hit,
+ * otherwise it takes the lock itself.
+ */
+void Server::resumeCacheWaiters() {
+  _cgiCache.takeWoken(_cacheWoken);
+  for (size_t i = 0; i < _cacheWoken.size(); ++i) {
+    ClientConnection *client = _cacheWoken[i];
+    client->resumeCacheWait(false);
+    if (client->isClosed())
+      continue; // Already scheduled for cleanup
+    client->updateActivity();
+    processBufferedRequests(client);
+    if (client->isClosed())
+      scheduleClose(client);
+    else
+      armTimer(client);
+  }
+  _cacheWoken.clear();
+}
+
+// ==================== Metrics ====================
+
+/**
+ * @brief Appends what the Server owns to a metrics scrape
+ *
+ * Connection gauges are counted from the slot table (a scrape is rare);
+ * cache and pool counters are the ones logged at shutdown.
+ *
+ * @param out Prometheus text being rendered (see Metrics::render())
+ */
+void Server::appendMetrics(std::string &out) const {
+  uint64_t idle = 0;
+  for (size_t fd = 0; fd < _slots.size(); ++fd)
+    if (_slots[fd].type == FD_CLIENT && !_slots[fd].client->isClosed() &&
+        _slots[fd].client->getTimeoutPhase() == GlobalConfig::TIMEOUT_KEEPALIVE)
+      ++idle;
+  Metrics::appendHelp(out, "webserv_connections", "gauge",
+                      "Open client connections (idle: keep-alive)");
+  Metrics::appendSample(out, "webserv_connections", "state=\"active\"",
+                        _clientCount - idle);
+  Metrics::appendSample(out, "webserv_connections", "state=\"idle\"", idle);
+
+  Metrics::appendHelp(out, "webserv_cache_hits_total", "counter",
+                      "Lookups answered from a cache");
+  Metrics::appendSample(out, "webserv_cache_hits_total",
+                        "cache=\"open_file\"", _fileCache.getHits());
+  Metrics::appendSample(out, "webserv_cache_hits_total", "cache=\"response\"",
+                        _responseCache.getHits());
+  Metrics::appendSample(out, "webserv_cache_hits_total",
+                        "cache=\"autoindex\"", _listingCache.getHits());
+  Metrics::appendSample(out, "webserv_cache_hits_total", "cache=\"fastcgi\"",
+                        _fastcgiPool.getReused());
+  Metrics::appendSample(out, "webserv_cache_hits_total", "cache=\"upstream\"",
+                        _upstreamPool.getReused());
+  Metrics::appendSample(out, "webserv_cache_hits_total", "cache=\"cgi\"",
+                        _cgiCache.getHits());
+  Metrics::appendSample(out, "webserv_cache_hits_total",
+                        "cache=\"buffer_pool\"", _bufferPool.getReused());
+  Metrics::appendHelp(out, "webserv_cache_misses_total", "counter",
+                      "Lookups that had to do the work");
+  Metrics::appendSample(out, "webserv_cache_misses_total",
+                        "cache=\"open_file\"", _fileCache.getMisses());
+  Metrics::appendSample(out, "webserv_cache_misses_total",
+                        "cache=\"response\"", _responseCache.getMisses());
+  Metrics::appendSample(out, "webserv_cache_misses_total",
+                        "cache=\"autoindex\"", _listingCache.getMisses());
+  Metrics::appendSample(out, "webserv_cache_misses_total",
+                        "cache=\"fastcgi\"", _fastcgiPool.getOpened());
+  Metrics::appendSample(out, "webserv_cache_misses_total",
+                        "cache=\"upstream\"", _upstreamPool.getOpened());
+  Metrics::appendSample(out, "webserv_cache_misses_total", "cache=\"cgi\"",
+                        _cgiCache.getMisses());
+  Metrics::appendSample(
+      out, "webserv_cache_misses_total", "cache=\"buffer_pool\"",
+      _bufferPool.getAcquired() - _bufferPool.getReused());
+
+  Metrics::appendHelp(out, "webserv_io_tasks_total", "counter",
+                      "File I/O tasks run on io_threads");
+  Metrics::appendSample(out, "webserv_io_tasks_total", NULL,
+                        _ioPool.getSubmitted());
+
+  if (_rateLimiter.zoneCount() == 0)
+    return;
+  static const char *const RESULTS[] = {"passed", "delayed", "rejected",
+                                        "evicted"};
+  Metrics::appendHelp(out, "webserv_limit_req_total", "counter",
+                      "limit_req requests by outcome, and keys evicted");
+  for (size_t i = 0; i < _rateLimiter.zoneCount(); ++i) {
+    const RateLimiter::Counters &counters = _rateLimiter.getCounters(i);
+    const unsigned long values[] = {counters.passed, counters.delayed,
+                                    counters.rejected, counters.evicted};
+    for (size_t j = 0; j < 4; ++j) {
+      std::string labels = "zone=\"" + _rateLimiter.getZone(i).name +
+                           "\",result=\"" + RESULTS[j] + "\"";
+      Metrics::appendSample(out, "webserv_limit_req_total", labels.c_str(),
+                            values[j]);
+    }
+  }
+  Metrics::appendHelp(out, "webserv_limit_req_keys", "gauge",
+                      "Keys with a limit_req bucket");
+  for (size_t i = 0; i < _rateLimiter.zoneCount(); ++i) {
+    std::string labels = "zone=\"" + _rateLimiter.getZone(i).name + "\"";
+    Metrics::appendSample(out, "webserv_limit_req_keys", labels.c_str(),
+                          _rateLimiter.size(i));
+  }
 }
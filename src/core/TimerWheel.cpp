@@ -0,0 +1,138 @@
+#include "core/TimerWheel.hpp"
+
+/**
+ * @file TimerWheel.cpp
+ * @brief Connection deadlines without scanning every connection
+ *
+ * The event loop used to walk every client once per second to compare its
+ * last activity with a fixed timeout. Each connection now keeps one timer,
+ * armed for the deadline of the phase it is in (see Server::armTimer()).
+ *
+ * Layout: 64 buckets of one second; a deadline goes to the bucket
+ * deadline % 64, in a doubly linked list threaded through an fd-indexed
+ * entry table. Deadlines further than 64 seconds share a bucket with
+ * nearer ones and are skipped until their own turn.
+ *
+ * ```
+ *   _cursor ─┐
+ *   buckets [ ][ ][x][ ][x]...[ ]     x = fds due that second (mod 64)
+ *   entries  fd → {deadline, prev, next}
+ * ```
+ *
+ * - schedule() / cancel(): unlink + link, O(1)
+ * - expire(now): visits the buckets of the seconds since the last call
+ * - nextExpiry(): first non-empty bucket after the cursor, which is what
+ *   the readiness wait sleeps until
+ */
+
+TimerWheel::TimerWheel()
+    : _buckets(WHEEL_SIZE, -1), _cursor(time(NULL)), _armed(0) {}
+
+TimerWheel::~TimerWheel() {}
+
+/**
+ * @brief Bucket of a deadline; past deadlines go to the next second
+ */
+size_t TimerWheel::bucketOf(time_t deadline) const {
+  if (deadline <= _cursor)
+    deadline = _cursor + 1;
+  return static_cast<size_t>(deadline) & (WHEEL_SIZE - 1);
+}
+
+/**
+ * @brief Removes an armed entry from its bucket list
+ */
+void TimerWheel::unlink(int fd) {
+  Entry &entry = _entries[fd];
+  if (entry.prev != -1)
+    _entries[entry.prev].next = entry.next;
+  else
+    _buckets[entry.bucket] = entry.next;
+  if (entry.next != -1)
+    _entries[entry.next].prev = entry.prev;
+  entry.armed = false;
+  --_armed;
+}
+
+/**
+ * @brief Arms the timer of fd, replacing its previous deadline
+ *
+ * @param fd File descriptor (>= 0)
+ * @param deadline Second at which the timer fires
+ */
+void TimerWheel::schedule(int fd, time_t deadline) {
+  if (static_cast<size_t>(fd) >= _entries.size()) {
+    Entry unused = {0, 0, -1, -1, false};
+    _entries.resize(fd + 1, unused);
+  }
+  Entry &entry = _entries[fd];
+  if (entry.armed) {
+    if (entry.deadline == deadline)
+      return;
+    unlink(fd);
+  }
+
+  size_t bucket = bucketOf(deadline);
+  entry.deadline = deadline;
+  entry.bucket = bucket;
+  entry.prev = -1;
+  entry.next = _buckets[bucket];
+  if (entry.next != -1)
+    _entries[entry.next].prev = fd;
+  _buckets[bucket] = fd;
+  entry.armed = true;
+  ++_armed;
+}
+
+void TimerWheel::cancel(int fd) {
+  if (fd >= 0 && static_cast<size_t>(fd) < _entries.size() &&
+      _entries[fd].armed)
+    unlink(fd);
+}
+
+/**
+ * @brief Earliest second at which expire() can find a due timer
+ *
+ * @return That second (may be early for deadlines more than one turn
+ *         away), or 0 if no timer is armed
+ */
+time_t TimerWheel::nextExpiry() const {
+  if (_armed == 0)
+    return 0;
+  for (size_t i = 1; i <= WHEEL_SIZE; ++i) {
+    if (_buckets[static_cast<size_t>(_cursor + i) & (WHEEL_SIZE - 1)] != -1)
+      return _cursor + static_cast<time_t>(i);
+  }
+  return _cursor + static_cast<time_t>(WHEEL_SIZE);
+}
+
+/**
+ * @brief Collects the timers due at now
+ *
+ * @param now Current second
+ * @param expired Receives the fd of every timer that fired (they are
+ *        disarmed; schedule() again to keep one)
+ */
+void TimerWheel::expire(time_t now, std::vector<int> &expired) {
+  if (now <= _cursor)
+    return;
+  size_t seconds = static_cast<size_t>(now - _cursor);
+  if (seconds > WHEEL_SIZE)
+    seconds = WHEEL_SIZE; // Every bucket once is enough
+
+  for (size_t i = 1; i <= seconds && _armed > 0; ++i) {
+    size_t bucket = static_cast<size_t>(_cursor + i) & (WHEEL_SIZE - 1);
+    int fd = _buckets[bucket];
+    while (fd != -1) {
+      int next = _entries[fd].next;
+      if (_entries[fd].deadline <= now) {
+        unlink(fd);
+        expired.push_back(fd);
+      }
+      fd = next;
+    }
+  }
+  _cursor = now;
+}
+
+size_t TimerWheel::size() const { return _armed; }
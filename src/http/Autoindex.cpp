@@ -1,4 +1,7 @@
 #include "http/Autoindex.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <ctime>
 #include <dirent.h>
@@ -13,7 +16,7 @@
  * @file Autoindex.cpp
  * @brief Directory listing generation for web server
  *
- * This module generates HTML directory listings when:
+ * This module generates directory listings when:
  * - The requested URL points to a directory
  * - No index file (e.g., index.html) exists
  * - Autoindex is enabled in the location config
@@ -26,256 +29,409 @@
  * - Parent directory navigation (..)
  * - URL encoding for special characters
  * - HTML escaping to prevent XSS
- * - Entry limit for security (1000 max)
+ * - Pagination: ?page=N&limit=M (1000 entries per page by default)
+ * - Machine-readable output: ?format=json
+ *
+ * A listing is built in two steps so that big directories stay cheap:
+ *
+ *   scanDirectory()  readdir() only, names sorted    (once per version,
+ *        │                                             see DirectoryListingCache)
+ *        ▼
+ *   renderPage()     stat() + markup for the `limit` names of one page
  *
  * @see StaticFileHandler for directory handling
  */
 
 namespace Autoindex {
 
+static const char STYLE[] =
+    "  <style>\n"
+    "    * { box-sizing: border-box; margin: 0; padding: 0; }\n"
+    "    body {\n"
+    "      font-family: 'Segoe UI', system-ui, sans-serif;\n"
+    "      background: linear-gradient(135deg, #0f172a 0%, #1e293b 100%);\n"
+    "      color: #f8fafc;\n"
+    "      min-height: 100vh;\n"
+    "      padding: 2rem;\n"
+    "    }\n"
+    "    .container {\n"
+    "      max-width: 900px;\n"
+    "      margin: 0 auto;\n"
+    "      background: rgba(30, 41, 59, 0.8);\n"
+    "      border-radius: 1rem;\n"
+    "      padding: 2rem;\n"
+    "      box-shadow: 0 25px 50px -12px rgba(0, 0, 0, 0.5);\n"
+    "    }\n"
+    "    h1 {\n"
+    "      color: #38bdf8;\n"
+    "      margin-bottom: 1.5rem;\n"
+    "      font-size: 1.5rem;\n"
+    "      display: flex;\n"
+    "      align-items: center;\n"
+    "      gap: 0.5rem;\n"
+    "    }\n"
+    "    table {\n"
+    "      width: 100%;\n"
+    "      border-collapse: collapse;\n"
+    "    }\n"
+    "    th {\n"
+    "      text-align: left;\n"
+    "      padding: 0.75rem 1rem;\n"
+    "      background: rgba(56, 189, 248, 0.1);\n"
+    "      color: #94a3b8;\n"
+    "      font-weight: 600;\n"
+    "      font-size: 0.8rem;\n"
+    "      text-transform: uppercase;\n"
+    "      letter-spacing: 0.05em;\n"
+    "    }\n"
+    "    td {\n"
+    "      padding: 0.75rem 1rem;\n"
+    "      border-bottom: 1px solid rgba(148, 163, 184, 0.1);\n"
+    "    }\n"
+    "    tr:hover td {\n"
+    "      background: rgba(56, 189, 248, 0.05);\n"
+    "    }\n"
+    "    a {\n"
+    "      text-decoration: none;\n"
+    "      color: #f8fafc;\n"
+    "      display: flex;\n"
+    "      align-items: center;\n"
+    "      gap: 0.5rem;\n"
+    "    }\n"
+    "    a:hover { color: #38bdf8; }\n"
+    "    .size { text-align: right; color: #64748b; }\n"
+    "    .date { color: #64748b; }\n"
+    "    .dir a { color: #fbbf24; font-weight: 500; }\n"
+    "    .icon { font-size: 1.1rem; }\n"
+    "    nav {\n"
+    "      display: flex;\n"
+    "      justify-content: space-between;\n"
+    "      margin-top: 1rem;\n"
+    "      color: #64748b;\n"
+    "    }\n"
+    "    nav a { display: inline; color: #38bdf8; }\n"
+    "    footer {\n"
+    "      margin-top: 1.5rem;\n"
+    "      padding-top: 1rem;\n"
+    "      border-top: 1px solid rgba(148, 163, 184, 0.1);\n"
+    "      color: #64748b;\n"
+    "      font-size: 0.8rem;\n"
+    "      text-align: center;\n"
+    "    }\n"
+    "  </style>\n";
+
 /**
- * @brief Generates an HTML directory listing
+ * @brief Reads a decimal query value, keeping the default when invalid
+ */
+static size_t parseCount(const std::string &value, size_t fallback) {
+  if (value.empty() || value.size() > 9 ||
+      value.find_first_not_of("0123456789") != std::string::npos)
+    return fallback;
+  size_t n = std::strtoul(value.c_str(), NULL, 10);
+  return n > 0 ? n : fallback;
+}
+
+/**
+ * @brief Parses the listing options of a directory request
  *
- * Creates a styled HTML page listing all files and subdirectories
- * in the specified directory.
+ * Recognized parameters (others are ignored):
+ * - page=N    1-based page number
+ * - limit=M   entries per page, clamped to MAX_LIMIT
+ * - format=json
  *
- * @param dirPath Absolute filesystem path to the directory
- * @param urlPath URL path as requested by client (for links and title)
- * @return HTML string, or empty string if directory can't be opened
+ * @param query Query string without '?' (e.g. "page=2&limit=100")
+ * @param options Filled in; defaults for anything absent or invalid
+ */
+void parseOptions(const std::string &query, Options &options) {
+  options.page = 1;
+  options.limit = DEFAULT_LIMIT;
+  options.json = false;
+
+  size_t pos = 0;
+  while (pos < query.size()) {
+    size_t end = query.find('&', pos);
+    if (end == std::string::npos)
+      end = query.size();
+    size_t eq = query.find('=', pos);
+    if (eq != std::string::npos && eq < end) {
+      std::string key = query.substr(pos, eq - pos);
+      std::string value = query.substr(eq + 1, end - eq - 1);
+      if (key == "page")
+        options.page = parseCount(value, 1);
+      else if (key == "limit")
+        options.limit = std::min(parseCount(value, DEFAULT_LIMIT), MAX_LIMIT);
+      else if (key == "format")
+        options.json = (value == "json");
+    }
+    pos = end + 1;
+  }
+}
+
+/**
+ * @brief Reads the names of a directory without stat()ing them
  *
- * @note Returns empty string on error; caller should check errno
- * @note Limits output to MAX_ENTRIES (1000) for security
+ * @param dirPath Absolute filesystem path to the directory
+ * @param names Replaced by the entry names (no "." / ".."), sorted
+ * @return false if the directory can't be opened (errno set)
  */
-std::string generateListing(const std::string &dirPath,
-                            const std::string &urlPath) {
+bool scanDirectory(const std::string &dirPath,
+                   std::vector<std::string> &names) {
   DIR *dir = opendir(dirPath.c_str());
-  if (!dir) {
-    return "";
+  if (!dir)
+    return false;
+
+  names.clear();
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    const char *name = entry->d_name;
+    if (name[0] == '.' &&
+        (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+      continue; // Parent handled by renderPage()
+    names.push_back(name);
   }
+  closedir(dir);
 
-  std::ostringstream html;
-  std::string safeUrlPath = escapeHtml(urlPath);
+  // Stable order, so ?page=N means the same entries on every request
+  std::sort(names.begin(), names.end());
+  return true;
+}
 
-  // HTML header with modern dark theme CSS
-  html << "<!DOCTYPE html>\n"
-       << "<html>\n"
-       << "<head>\n"
-       << "  <meta charset=\"UTF-8\">\n"
-       << "  <title>Index of " << safeUrlPath << "</title>\n"
-       << "  <style>\n"
-       << "    * { box-sizing: border-box; margin: 0; padding: 0; }\n"
-       << "    body {\n"
-       << "      font-family: 'Segoe UI', system-ui, sans-serif;\n"
-       << "      background: linear-gradient(135deg, #0f172a 0%, #1e293b "
-          "100%);\n"
-       << "      color: #f8fafc;\n"
-       << "      min-height: 100vh;\n"
-       << "      padding: 2rem;\n"
-       << "    }\n"
-       << "    .container {\n"
-       << "      max-width: 900px;\n"
-       << "      margin: 0 auto;\n"
-       << "      background: rgba(30, 41, 59, 0.8);\n"
-       << "      border-radius: 1rem;\n"
-       << "      padding: 2rem;\n"
-       << "      box-shadow: 0 25px 50px -12px rgba(0, 0, 0, 0.5);\n"
-       << "    }\n"
-       << "    h1 {\n"
-       << "      color: #38bdf8;\n"
-       << "      margin-bottom: 1.5rem;\n"
-       << "      font-size: 1.5rem;\n"
-       << "      display: flex;\n"
-       << "      align-items: center;\n"
-       << "      gap: 0.5rem;\n"
-       << "    }\n"
-       << "    table {\n"
-       << "      width: 100%;\n"
-       << "      border-collapse: collapse;\n"
-       << "    }\n"
-       << "    th {\n"
-       << "      text-align: left;\n"
-       << "      padding: 0.75rem 1rem;\n"
-       << "      background: rgba(56, 189, 248, 0.1);\n"
-       << "      color: #94a3b8;\n"
-       << "      font-weight: 600;\n"
-       << "      font-size: 0.8rem;\n"
-       << "      text-transform: uppercase;\n"
-       << "      letter-spacing: 0.05em;\n"
-       << "    }\n"
-       << "    td {\n"
-       << "      padding: 0.75rem 1rem;\n"
-       << "      border-bottom: 1px solid rgba(148, 163, 184, 0.1);\n"
-       << "    }\n"
-       << "    tr:hover td {\n"
-       << "      background: rgba(56, 189, 248, 0.05);\n"
-       << "    }\n"
-       << "    a {\n"
-       << "      text-decoration: none;\n"
-       << "      color: #f8fafc;\n"
-       << "      display: flex;\n"
-       << "      align-items: center;\n"
-       << "      gap: 0.5rem;\n"
-       << "    }\n"
-       << "    a:hover { color: #38bdf8; }\n"
-       << "    .size { text-align: right; color: #64748b; }\n"
-       << "    .date { color: #64748b; }\n"
-       << "    .dir a { color: #fbbf24; font-weight: 500; }\n"
-       << "    .icon { font-size: 1.1rem; }\n"
-       << "    footer {\n"
-       << "      margin-top: 1.5rem;\n"
-       << "      padding-top: 1rem;\n"
-       << "      border-top: 1px solid rgba(148, 163, 184, 0.1);\n"
-       << "      color: #64748b;\n"
-       << "      font-size: 0.8rem;\n"
-       << "      text-align: center;\n"
-       << "    }\n"
-       << "  </style>\n"
-       << "</head>\n"
-       << "<body>\n"
-       << "  <div class=\"container\">\n"
-       << "    <h1>🗂️ Index of " << safeUrlPath << "</h1>\n"
-       << "    <table>\n"
-       << "      <tr>\n"
-       << "        <th>Name</th>\n"
-       << "        <th>Last Modified</th>\n"
-       << "        <th class=\"size\">Size</th>\n"
-       << "      </tr>\n";
-
-  // Parent directory link (if not at root)
-  if (urlPath != "/" && !urlPath.empty()) {
-    std::string parentPath = urlPath;
-    if (parentPath[parentPath.size() - 1] == '/')
-      parentPath.erase(parentPath.size() - 1);
-    size_t lastSlash = parentPath.find_last_of('/');
-
-    if (lastSlash == std::string::npos)
-      parentPath = "/";
-    else
-      parentPath = parentPath.substr(0, lastSlash + 1);
-
-    html << "      <tr class=\"dir\">\n"
-         << "        <td><a href=\"" << parentPath
-         << "\"><span class=\"icon\">⬆️</span> ../</a></td>\n"
-         << "        <td class=\"date\">-</td>\n"
-         << "        <td class=\"size\">-</td>\n"
-         << "      </tr>\n";
+/**
+ * @brief Formats a file size as B/KB/MB/GB
+ */
+static std::string formatSize(off_t size) {
+  std::ostringstream oss;
+  if (size < 1024)
+    oss << size << " B";
+  else if (size < 1024 * 1024)
+    oss << (size / 1024) << " KB";
+  else if (size < 1024 * 1024 * 1024)
+    oss << (size / (1024 * 1024)) << " MB";
+  else
+    oss << (size / (1024 * 1024 * 1024)) << " GB";
+  return oss.str();
+}
+
+/**
+ * @brief Picks an icon from the file type/extension
+ */
+static const char *iconFor(const std::string &name, bool isDirectory) {
+  if (isDirectory)
+    return "📁";
+  size_t dotPos = name.rfind('.');
+  if (dotPos == std::string::npos)
+    return "📄";
+  std::string ext = name.substr(dotPos);
+  if (ext == ".html" || ext == ".htm")
+    return "🌐";
+  if (ext == ".css")
+    return "🎨";
+  if (ext == ".js")
+    return "⚡";
+  if (ext == ".png" || ext == ".jpg" || ext == ".gif" || ext == ".webp")
+    return "🖼️";
+  if (ext == ".pdf")
+    return "📝";
+  if (ext == ".py" || ext == ".sh" || ext == ".cpp" || ext == ".c")
+    return "💻";
+  return "📄";
+}
+
+/**
+ * @brief Escapes a string for a JSON string literal
+ */
+static std::string escapeJson(const std::string &input) {
+  std::string output;
+  output.reserve(input.size());
+  for (size_t i = 0; i < input.size(); ++i) {
+    unsigned char c = input[i];
+    if (c == '"' || c == '\\') {
+      output.push_back('\\');
+      output.push_back(c);
+    } else if (c < 0x20) {
+      static const char hex[] = "0123456789abcdef";
+      output.append("\\u00");
+      output.push_back(hex[c >> 4]);
+      output.push_back(hex[c & 0x0F]);
+    } else {
+      output.push_back(c);
+    }
   }
+  return output;
+}
 
-  // Read directory entries
-  struct dirent *entry;
-  int entryCount = 0;
-  const int MAX_ENTRIES = 1000;
+/**
+ * @brief Builds the link to another page of the same listing
+ */
+static std::string pageLink(size_t page, const Options &options) {
+  std::ostringstream link;
+  link << "?page=" << page;
+  if (options.limit != DEFAULT_LIMIT)
+    link << "&amp;limit=" << options.limit;
+  return link.str();
+}
+
+/**
+ * @brief Renders one page of a directory listing
+ *
+ * Only the names of the requested page are stat()ed, so the cost of a page
+ * is bounded by `limit`, not by the size of the directory. Entries that
+ * vanished since the scan are skipped.
+ *
+ * @param dirPath Absolute filesystem path to the directory
+ * @param urlPath URL path as requested by client (for links and title)
+ * @param names Output of scanDirectory()
+ * @param options Page, page size and format
+ * @return HTML page, or JSON object when options.json
+ *
+ * @note A page past the end renders an empty listing, not an error
+ */
+std::string renderPage(const std::string &dirPath, const std::string &urlPath,
+                       const std::vector<std::string> &names,
+                       const Options &options) {
+  size_t total = names.size();
+  size_t pages = total == 0 ? 1 : (total + options.limit - 1) / options.limit;
+  size_t first = std::min((options.page - 1) * options.limit, total);
+  size_t last = std::min(first + options.limit, total);
 
-  while ((entry = readdir(dir)) != NULL && entryCount < MAX_ENTRIES) {
-    std::string name = entry->d_name;
+  std::string prefix = dirPath;
+  if (prefix.empty() || prefix[prefix.size() - 1] != '/')
+    prefix += "/";
 
-    // Skip . and .. (parent handled above)
-    if (name == "." || name == "..")
-      continue;
+  std::ostringstream out;
+  std::string safeUrlPath = escapeHtml(urlPath);
 
-    // Get file metadata
-    std::string fullPath = dirPath;
-    if (fullPath[fullPath.size() - 1] != '/')
-      fullPath += "/";
-    fullPath += name;
+  if (options.json) {
+    out << "{\"path\":\"" << escapeJson(urlPath) << "\",\"page\":"
+        << options.page << ",\"pages\":" << pages << ",\"limit\":"
+        << options.limit << ",\"total\":" << total << ",\"entries\":[";
+  } else {
+    out << "<!DOCTYPE html>\n"
+        << "<html>\n"
+        << "<head>\n"
+        << "  <meta charset=\"UTF-8\">\n"
+        << "  <title>Index of " << safeUrlPath << "</title>\n"
+        << STYLE << "</head>\n"
+        << "<body>\n"
+        << "  <div class=\"container\">\n"
+        << "    <h1>🗂️ Index of " << safeUrlPath << "</h1>\n"
+        << "    <table>\n"
+        << "      <tr>\n"
+        << "        <th>Name</th>\n"
+        << "        <th>Last Modified</th>\n"
+        << "        <th class=\"size\">Size</th>\n"
+        << "      </tr>\n";
 
-    struct stat fileStat;
-    if (stat(fullPath.c_str(), &fileStat) == 0) {
-      bool isDirectory = S_ISDIR(fileStat.st_mode);
-
-      // Format modification date
-      char dateBuf[64];
-      struct tm *timeinfo = localtime(&fileStat.st_mtime);
-      if (timeinfo)
-        strftime(dateBuf, sizeof(dateBuf), "%Y-%m-%d %H:%M:%S", timeinfo);
+    // Parent directory link (if not at root)
+    if (urlPath != "/" && !urlPath.empty()) {
+      std::string parentPath = urlPath;
+      if (parentPath[parentPath.size() - 1] == '/')
+        parentPath.erase(parentPath.size() - 1);
+      size_t lastSlash = parentPath.find_last_of('/');
+
+      if (lastSlash == std::string::npos)
+        parentPath = "/";
       else
-        std::strcpy(dateBuf, "-");
-
-      // Format file size
-      std::string sizeStr;
-      if (isDirectory) {
-        sizeStr = "-";
-      } else {
-        if (fileStat.st_size < 1024) {
-          std::ostringstream oss;
-          oss << fileStat.st_size << " B";
-          sizeStr = oss.str();
-        } else if (fileStat.st_size < 1024 * 1024) {
-          std::ostringstream oss;
-          oss << (fileStat.st_size / 1024) << " KB";
-          sizeStr = oss.str();
-        } else {
-          std::ostringstream oss;
-          oss << (fileStat.st_size / (1024 * 1024)) << " MB";
-          sizeStr = oss.str();
-        }
-      }
-
-      // Prepare display name (escaped, with / for directories)
-      std::string displayName = escapeHtml(name);
-      if (isDirectory)
-        displayName += "/";
-
-      // URL-encode filename for link
-      std::string urlEncodedName = urlEncode(name);
-
-      // Determine icon based on file type/extension
-      std::string icon = isDirectory ? "📁" : "📄";
-      if (!isDirectory) {
-        size_t dotPos = name.rfind('.');
-        if (dotPos != std::string::npos) {
-          std::string ext = name.substr(dotPos);
-          if (ext == ".html" || ext == ".htm")
-            icon = "🌐";
-          else if (ext == ".css")
-            icon = "🎨";
-          else if (ext == ".js")
-            icon = "⚡";
-          else if (ext == ".png" || ext == ".jpg" || ext == ".gif" ||
-                   ext == ".webp")
-            icon = "🖼️";
-          else if (ext == ".pdf")
-            icon = "📝";
-          else if (ext == ".txt")
-            icon = "📄";
-          else if (ext == ".py" || ext == ".sh" || ext == ".cpp" || ext == ".c")
-            icon = "💻";
-        }
-      }
-
-      html << "      <tr>\n"
-           << "        <td class=\"" << (isDirectory ? "dir" : "") << "\">"
-           << "<a href=\"" << urlEncodedName << (isDirectory ? "/" : "")
-           << "\"><span class=\"icon\">" << icon << "</span> " << displayName
-           << "</a></td>\n"
-           << "        <td class=\"date\">" << dateBuf << "</td>\n"
-           << "        <td class=\"size\">" << sizeStr << "</td>\n"
-           << "      </tr>\n";
-      entryCount++;
+        parentPath = parentPath.substr(0, lastSlash + 1);
+
+      out << "      <tr class=\"dir\">\n"
+          << "        <td><a href=\"" << parentPath
+          << "\"><span class=\"icon\">⬆️</span> ../</a></td>\n"
+          << "        <td class=\"date\">-</td>\n"
+          << "        <td class=\"size\">-</td>\n"
+          << "      </tr>\n";
     }
   }
 
-  closedir(dir);
+  std::string fullPath;
+  bool firstEntry = true;
+  for (size_t i = first; i < last; ++i) {
+    const std::string &name = names[i];
+    fullPath.assign(prefix).append(name);
+
+    struct stat fileStat;
+    if (stat(fullPath.c_str(), &fileStat) != 0)
+      continue; // Removed since the scan
+    bool isDirectory = S_ISDIR(fileStat.st_mode);
 
-  // Show warning if entry limit reached
-  if (entryCount >= MAX_ENTRIES) {
-    html << "    <tr>\n"
-         << "      <td colspan=\"3\" style=\"color: #666; font-style: "
-            "italic;\">"
-         << "(Showing first " << MAX_ENTRIES << " entries)</td>\n"
-         << "    </tr>\n";
+    if (options.json) {
+      out << (firstEntry ? "" : ",") << "{\"name\":\"" << escapeJson(name)
+          << "\",\"type\":\"" << (isDirectory ? "directory" : "file")
+          << "\",\"size\":" << (isDirectory ? 0 : fileStat.st_size)
+          << ",\"mtime\":" << fileStat.st_mtime << "}";
+      firstEntry = false;
+      continue;
+    }
+
+    // Format modification date (localtime_r: pages may render on an I/O
+    // thread)
+    char dateBuf[64];
+    struct tm timeinfo;
+    if (localtime_r(&fileStat.st_mtime, &timeinfo))
+      strftime(dateBuf, sizeof(dateBuf), "%Y-%m-%d %H:%M:%S", &timeinfo);
+    else
+      std::strcpy(dateBuf, "-");
+
+    out << "      <tr>\n"
+        << "        <td class=\"" << (isDirectory ? "dir" : "") << "\">"
+        << "<a href=\"" << urlEncode(name) << (isDirectory ? "/" : "")
+        << "\"><span class=\"icon\">" << iconFor(name, isDirectory)
+        << "</span> " << escapeHtml(name) << (isDirectory ? "/" : "")
+        << "</a></td>\n"
+        << "        <td class=\"date\">" << dateBuf << "</td>\n"
+        << "        <td class=\"size\">"
+        << (isDirectory ? std::string("-") : formatSize(fileStat.st_size))
+        << "</td>\n"
+        << "      </tr>\n";
   }
 
-  // Close HTML
-  html << "    </table>\n"
-       << "    <footer>\n"
-       << "      webserv/1.0 · Autoindex\n"
-       << "    </footer>\n"
-       << "  </div>\n"
-       << "</body>\n"
-       << "</html>";
+  if (options.json) {
+    out << "]}";
+    return out.str();
+  }
 
-  return html.str();
+  out << "    </table>\n";
+  if (pages > 1) {
+    out << "    <nav>\n      <span>";
+    if (options.page > 1)
+      out << "<a href=\"" << pageLink(std::min(options.page - 1, pages), options)
+          << "\">← Previous</a>";
+    out << "</span>\n      <span>Page " << options.page << " of " << pages
+        << "</span>\n      <span>";
+    if (options.page < pages)
+      out << "<a href=\"" << pageLink(options.page + 1, options)
+          << "\">Next →</a>";
+    out << "</span>\n    </nav>\n";
+  }
+  out << "    <footer>\n"
+      << "      webserv/1.0 · Autoindex · " << total << " entries\n"
+      << "    </footer>\n"
+      << "  </div>\n"
+      << "</body>\n"
+      << "</html>";
+
+  return out.str();
+}
+
+/**
+ * @brief Generates the HTML listing of a directory (first page)
+ *
+ * Uncached convenience wrapper: scans and renders in one call.
+ *
+ * @param dirPath Absolute filesystem path to the directory
+ * @param urlPath URL path as requested by client (for links and title)
+ * @return HTML string, or empty string if directory can't be opened
+ *
+ * @note Returns empty string on error; caller should check errno
+ */
+std::string generateListing(const std::string &dirPath,
+                            const std::string &urlPath) {
+  std::vector<std::string> names;
+  if (!scanDirectory(dirPath, names))
+    return "";
+  Options options;
+  parseOptions("", options);
+  return renderPage(dirPath, urlPath, names, options);
 }
 
 /**
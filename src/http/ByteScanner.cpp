@@ -0,0 +1,327 @@
+#include "http/ByteScanner.hpp"
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define BYTESCANNER_AVX2 1
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/**
+ * @file ByteScanner.cpp
+ * @brief "Find any of these bytes" and "find CRLFCRLF" kernels
+ *
+ * The header terminator search, the line/colon split of every header field,
+ * the chunk-size line search and the '%'/'+' scan of URL decoding used to
+ * look at one byte per step. Requests behind corporate proxies carry header
+ * blocks of several KB (Via, X-Forwarded-*, long cookies), so these loops
+ * add up. Here they compare 16 or 32 bytes per instruction:
+ *
+ * - avx2   : 32-byte blocks, x86-64 CPUs that report AVX2 at runtime
+ * - sse2   : 16-byte blocks, every x86-64 CPU
+ * - neon   : 16-byte blocks, AArch64
+ * - scalar : portable fallback (memchr for single bytes)
+ *
+ * findAny() ORs one compare per set byte (up to MAX_SET) and takes the
+ * lowest set bit of the resulting mask. findHeaderEnd() compares four
+ * overlapping loads at +0..+3 against '\r', '\n', '\r', '\n' and ANDs
+ * them, so a terminator split across two blocks is still found. Bytes
+ * left after the last full block go through the scalar code.
+ *
+ * The backend is selected on first use (AVX2 is only compiled as a
+ * function-level target, so the binary still runs on CPUs without it).
+ *
+ * @note Loads are unaligned and never read past data + length
+ */
+
+typedef size_t (*FindAnyFn)(const char *, size_t, const char *, size_t);
+typedef size_t (*FindHeaderEndFn)(const char *, size_t);
+
+struct Kernel {
+  const char *name;
+  bool (*supported)();
+  FindAnyFn findAny;
+  FindHeaderEndFn findHeaderEnd;
+};
+
+/**
+ * @brief Adds the block offset to a result found in the scalar tail
+ */
+static inline size_t shifted(size_t offset, size_t found) {
+  return found == ByteScanner::npos ? found : offset + found;
+}
+
+static bool alwaysSupported() { return true; }
+
+static size_t scalarFindAny(const char *data, size_t length, const char *set,
+                            size_t setLength) {
+  if (setLength == 1) {
+    const void *hit = std::memchr(data, set[0], length);
+    return hit ? static_cast<size_t>(static_cast<const char *>(hit) - data)
+               : ByteScanner::npos;
+  }
+  for (size_t i = 0; i < length; ++i)
+    for (size_t j = 0; j < setLength; ++j)
+      if (data[i] == set[j])
+        return i;
+  return ByteScanner::npos;
+}
+
+static size_t scalarFindHeaderEnd(const char *data, size_t length) {
+  size_t pos = 0;
+  while (length - pos >= 4) {
+    const char *cr = static_cast<const char *>(
+        std::memchr(data + pos, '\r', length - pos - 3));
+    if (!cr)
+      break;
+    if (cr[1] == '\n' && cr[2] == '\r' && cr[3] == '\n')
+      return static_cast<size_t>(cr - data);
+    pos = static_cast<size_t>(cr - data) + 1;
+  }
+  return ByteScanner::npos;
+}
+
+#if defined(__SSE2__)
+static size_t sse2FindAny(const char *data, size_t length, const char *set,
+                          size_t setLength) {
+  // Unused slots repeat set[0], so four compares cover any set size
+  const __m128i s0 = _mm_set1_epi8(set[0]);
+  const __m128i s1 = _mm_set1_epi8(set[setLength > 1 ? 1 : 0]);
+  const __m128i s2 = _mm_set1_epi8(set[setLength > 2 ? 2 : 0]);
+  const __m128i s3 = _mm_set1_epi8(set[setLength > 3 ? 3 : 0]);
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    __m128i hit =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, s0),
+                                  _mm_cmpeq_epi8(block, s1)),
+                     _mm_or_si128(_mm_cmpeq_epi8(block, s2),
+                                  _mm_cmpeq_epi8(block, s3)));
+    int mask = _mm_movemask_epi8(hit);
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  return shifted(i, scalarFindAny(data + i, length - i, set, setLength));
+}
+
+static size_t sse2FindHeaderEnd(const char *data, size_t length) {
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i lf = _mm_set1_epi8('\n');
+  size_t i = 0;
+  for (; i + 19 <= length; i += 16) {
+    const __m128i *p = reinterpret_cast<const __m128i *>(data + i);
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(p), cr));
+    if (!mask)
+      continue; // No '\r' in this block: no terminator can start here
+    __m128i a1 = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(data + i + 1));
+    __m128i a2 = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(data + i + 2));
+    __m128i a3 = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(data + i + 3));
+    mask &= _mm_movemask_epi8(
+        _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(a1, lf),
+                                    _mm_cmpeq_epi8(a2, cr)),
+                      _mm_cmpeq_epi8(a3, lf)));
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  return shifted(i, scalarFindHeaderEnd(data + i, length - i));
+}
+#endif
+
+#if defined(BYTESCANNER_AVX2)
+static bool avx2Supported() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+static __attribute__((target("avx2"))) size_t
+avx2FindAny(const char *data, size_t length, const char *set,
+            size_t setLength) {
+  const __m256i s0 = _mm256_set1_epi8(set[0]);
+  const __m256i s1 = _mm256_set1_epi8(set[setLength > 1 ? 1 : 0]);
+  const __m256i s2 = _mm256_set1_epi8(set[setLength > 2 ? 2 : 0]);
+  const __m256i s3 = _mm256_set1_epi8(set[setLength > 3 ? 3 : 0]);
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    __m256i hit =
+        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, s0),
+                                        _mm256_cmpeq_epi8(block, s1)),
+                        _mm256_or_si256(_mm256_cmpeq_epi8(block, s2),
+                                        _mm256_cmpeq_epi8(block, s3)));
+    unsigned int mask =
+        static_cast<unsigned int>(_mm256_movemask_epi8(hit));
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  return shifted(i, sse2FindAny(data + i, length - i, set, setLength));
+}
+
+static __attribute__((target("avx2"))) size_t
+avx2FindHeaderEnd(const char *data, size_t length) {
+  const __m256i cr = _mm256_set1_epi8('\r');
+  const __m256i lf = _mm256_set1_epi8('\n');
+  size_t i = 0;
+  for (; i + 35 <= length; i += 32) {
+    const __m256i *p = reinterpret_cast<const __m256i *>(data + i);
+    unsigned int mask = static_cast<unsigned int>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(p), cr)));
+    if (!mask)
+      continue;
+    __m256i a1 = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(data + i + 1));
+    __m256i a2 = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(data + i + 2));
+    __m256i a3 = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(data + i + 3));
+    mask &= static_cast<unsigned int>(_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(a1, lf),
+                                          _mm256_cmpeq_epi8(a2, cr)),
+                         _mm256_cmpeq_epi8(a3, lf))));
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  return shifted(i, sse2FindHeaderEnd(data + i, length - i));
+}
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+/**
+ * @brief 4 bits per lane: index of the first hit is ctz(mask) / 4
+ */
+static inline unsigned long long neonMask(uint8x16_t hit) {
+  uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(hit), 4);
+  return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+}
+
+static size_t neonFindAny(const char *data, size_t length, const char *set,
+                          size_t setLength) {
+  const uint8x16_t s0 = vdupq_n_u8(static_cast<uint8_t>(set[0]));
+  const uint8x16_t s1 =
+      vdupq_n_u8(static_cast<uint8_t>(set[setLength > 1 ? 1 : 0]));
+  const uint8x16_t s2 =
+      vdupq_n_u8(static_cast<uint8_t>(set[setLength > 2 ? 2 : 0]));
+  const uint8x16_t s3 =
+      vdupq_n_u8(static_cast<uint8_t>(set[setLength > 3 ? 3 : 0]));
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    uint8x16_t block = vld1q_u8(bytes + i);
+    uint8x16_t hit =
+        vorrq_u8(vorrq_u8(vceqq_u8(block, s0), vceqq_u8(block, s1)),
+                 vorrq_u8(vceqq_u8(block, s2), vceqq_u8(block, s3)));
+    unsigned long long mask = neonMask(hit);
+    if (mask)
+      return i + (__builtin_ctzll(mask) >> 2);
+  }
+  return shifted(i, scalarFindAny(data + i, length - i, set, setLength));
+}
+
+static size_t neonFindHeaderEnd(const char *data, size_t length) {
+  const uint8x16_t cr = vdupq_n_u8('\r');
+  const uint8x16_t lf = vdupq_n_u8('\n');
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+  size_t i = 0;
+  for (; i + 19 <= length; i += 16) {
+    uint8x16_t hit = vandq_u8(
+        vandq_u8(vceqq_u8(vld1q_u8(bytes + i), cr),
+                 vceqq_u8(vld1q_u8(bytes + i + 1), lf)),
+        vandq_u8(vceqq_u8(vld1q_u8(bytes + i + 2), cr),
+                 vceqq_u8(vld1q_u8(bytes + i + 3), lf)));
+    unsigned long long mask = neonMask(hit);
+    if (mask)
+      return i + (__builtin_ctzll(mask) >> 2);
+  }
+  return shifted(i, scalarFindHeaderEnd(data + i, length - i));
+}
+#endif
+
+// Preference order: the first supported entry is used
+static const Kernel KERNELS[] = {
+#if defined(BYTESCANNER_AVX2)
+    {"avx2", avx2Supported, avx2FindAny, avx2FindHeaderEnd},
+#endif
+#if defined(__SSE2__)
+    {"sse2", alwaysSupported, sse2FindAny, sse2FindHeaderEnd},
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+    {"neon", alwaysSupported, neonFindAny, neonFindHeaderEnd},
+#endif
+    {"scalar", alwaysSupported, scalarFindAny, scalarFindHeaderEnd},
+};
+
+static const size_t KERNEL_COUNT = sizeof(KERNELS) / sizeof(KERNELS[0]);
+
+static const Kernel *g_kernel = NULL;
+
+/**
+ * @brief Selected kernel, detected on first use
+ */
+static inline const Kernel &kernel() {
+  if (!g_kernel) {
+    size_t i = 0;
+    while (!KERNELS[i].supported())
+      ++i; // "scalar" is last and always supported
+    g_kernel = &KERNELS[i];
+  }
+  return *g_kernel;
+}
+
+/**
+ * @brief Finds the first byte of data that belongs to set
+ *
+ * @param data Bytes to search (need not be NUL-terminated)
+ * @param length Number of bytes at data
+ * @param set Bytes to look for
+ * @param setLength Number of bytes in set (larger than MAX_SET is scanned
+ *        with the scalar code)
+ * @return Offset of the first match, or npos
+ */
+size_t ByteScanner::findAny(const char *data, size_t length, const char *set,
+                            size_t setLength) {
+  if (setLength == 0 || length == 0)
+    return npos;
+  if (setLength > MAX_SET)
+    return scalarFindAny(data, length, set, setLength);
+  return kernel().findAny(data, length, set, setLength);
+}
+
+/**
+ * @brief Finds the blank line ending an HTTP/CGI header block
+ *
+ * @param data Bytes to search (need not be NUL-terminated)
+ * @param length Number of bytes at data
+ * @return Offset of the first "\r\n\r\n", or npos
+ */
+size_t ByteScanner::findHeaderEnd(const char *data, size_t length) {
+  if (length < 4)
+    return npos;
+  return kernel().findHeaderEnd(data, length);
+}
+
+const char *ByteScanner::backendName() { return kernel().name; }
+
+/**
+ * @brief Selects a kernel by name instead of the detected one
+ *
+ * @param name "avx2", "sse2", "neon" or "scalar"
+ * @return false if that kernel is not built or not supported by this CPU
+ */
+bool ByteScanner::setBackend(const std::string &name) {
+  for (size_t i = 0; i < KERNEL_COUNT; ++i) {
+    if (name == KERNELS[i].name && KERNELS[i].supported()) {
+      g_kernel = &KERNELS[i];
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,321 @@
+#include "http/Compression.hpp"
+#include "config/GlobalConfig.hpp"
+#include "http/HttpRequest.hpp"
+#include <cctype>
+#include <cstdlib>
+
+#ifdef WEBSERV_HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+/**
+ * @file Compression.cpp
+ * @brief gzip / brotli content-coding of responses
+ *
+ * Text assets (HTML, CSS, JS, JSON, SVG) shrink to a fraction of their size
+ * when compressed, but compressing them on every request costs far more CPU
+ * than sending them. So compression is done where the result can be kept:
+ *
+ *   static file ≤ ON_THE_FLY_MAX   compressed once per file version, kept
+ *                                  next to the content in the open file
+ *                                  cache (OpenFileEntry::gzip / ::brotli)
+ *   gzip_static on                 foo.css.gz / foo.css.br served as is
+ *   streamed CGI body (chunked)    GzipStream, flushed after each read so
+ *                                  the client sees output as it comes
+ *
+ * Configuration (http context, nginx syntax):
+ *   gzip on;
+ *   gzip_types text/css application/javascript;   (text/html always)
+ *   gzip_min_length 256;
+ *   gzip_comp_level 5;
+ *   gzip_static on;
+ *   brotli on;
+ *
+ * zlib and libbrotlienc are optional: the Makefile defines
+ * WEBSERV_HAVE_ZLIB / WEBSERV_HAVE_BROTLI when they are installed, and a
+ * coding whose library is missing is simply never negotiated.
+ */
+
+Compression::Compression()
+    : _gzip(false), _brotli(false), _static(false), _level(5),
+      _minLength(256) {}
+
+/**
+ * @brief Applies the http-level directives
+ *
+ * @param config Process-wide configuration
+ */
+void Compression::configure(const GlobalConfig &config) {
+  _gzip = config.getGzip() && isAvailable(GZIP);
+  _brotli = config.getBrotli() && isAvailable(BROTLI);
+  _static = config.getGzipStatic();
+  _level = config.getGzipCompLevel();
+  _minLength = static_cast<off_t>(config.getGzipMinLength());
+  _types = config.getGzipTypes();
+  for (size_t i = 0; i < _types.size(); ++i)
+    for (size_t j = 0; j < _types[i].size(); ++j)
+      _types[i][j] = std::tolower(static_cast<unsigned char>(_types[i][j]));
+}
+
+bool Compression::isEnabled() const { return _gzip || _brotli || _static; }
+
+bool Compression::useStatic() const { return _static; }
+
+int Compression::getLevel() const { return _level; }
+
+/**
+ * @brief Whether a body may be compressed
+ *
+ * @param contentType Content-Type value (parameters like charset ignored)
+ * @param size Body size, -1 when unknown (streamed)
+ */
+bool Compression::isCompressible(const std::string &contentType,
+                                 off_t size) const {
+  if (!isEnabled() || (size >= 0 && size < _minLength))
+    return false;
+  size_t end = contentType.find(';');
+  if (end == std::string::npos)
+    end = contentType.size();
+  while (end > 0 && contentType[end - 1] == ' ')
+    --end;
+  std::string type = contentType.substr(0, end);
+  for (size_t i = 0; i < type.size(); ++i)
+    type[i] = std::tolower(static_cast<unsigned char>(type[i]));
+
+  if (type == "text/html")
+    return true; // As in nginx, always part of gzip_types
+  for (size_t i = 0; i < _types.size(); ++i)
+    if (_types[i] == "*" || _types[i] == type)
+      return true;
+  return false;
+}
+
+/**
+ * @brief Picks the content-coding of a response from Accept-Encoding
+ *
+ * brotli is preferred over gzip at equal weight (smaller output). A coding
+ * listed with q=0 is refused; "*" stands for any coding not listed.
+ *
+ * @param request Request being answered
+ * @param allowBrotli false where only gzip can be produced (streams)
+ * @return Coding to use, IDENTITY if none is both enabled and accepted
+ */
+Compression::Encoding Compression::negotiate(const HttpRequest &request,
+                                             bool allowBrotli) const {
+  size_t length = 0;
+  const char *value = request.getHeaderValue("Accept-Encoding", length);
+  if (!value || length == 0)
+    return IDENTITY;
+  std::string header(value, length);
+
+  double gzipQ = -1;
+  double brotliQ = -1;
+  double anyQ = -1;
+  size_t pos = 0;
+  while (pos < header.size()) {
+    size_t comma = header.find(',', pos);
+    if (comma == std::string::npos)
+      comma = header.size();
+    std::string item = header.substr(pos, comma - pos);
+    pos = comma + 1;
+
+    double q = 1;
+    size_t semi = item.find(';');
+    if (semi != std::string::npos) {
+      size_t qpos = item.find("q=", semi);
+      if (qpos != std::string::npos)
+        q = std::strtod(item.c_str() + qpos + 2, NULL);
+      item.erase(semi);
+    }
+    size_t first = item.find_first_not_of(" \t");
+    size_t last = item.find_last_not_of(" \t");
+    if (first == std::string::npos)
+      continue;
+    std::string name = item.substr(first, last - first + 1);
+    for (size_t i = 0; i < name.size(); ++i)
+      name[i] = std::tolower(static_cast<unsigned char>(name[i]));
+    if (name == "gzip" || name == "x-gzip")
+      gzipQ = q;
+    else if (name == "br")
+      brotliQ = q;
+    else if (name == "*")
+      anyQ = q;
+  }
+  if (gzipQ < 0)
+    gzipQ = anyQ;
+  if (brotliQ < 0)
+    brotliQ = anyQ;
+
+  bool brotliUsable = (_brotli || _static) && allowBrotli && brotliQ > 0;
+  bool gzipUsable = (_gzip || _static) && gzipQ > 0;
+  if (brotliUsable && (!gzipUsable || brotliQ >= gzipQ))
+    return BROTLI;
+  if (gzipUsable)
+    return GZIP;
+  return IDENTITY;
+}
+
+bool Compression::canCompress(Encoding encoding, off_t size) const {
+  if (size > ON_THE_FLY_MAX)
+    return false;
+  return (encoding == GZIP && _gzip) || (encoding == BROTLI && _brotli);
+}
+
+/**
+ * @brief Compresses a complete body in one call
+ *
+ * @param encoding GZIP or BROTLI (must be enabled)
+ * @param input Uncompressed bytes
+ * @param output Replaced by the encoded bytes
+ * @return false if the coding is disabled or the encoder failed
+ */
+bool Compression::compress(Encoding encoding, const std::string &input,
+                           std::string &output) const {
+  if (encoding == GZIP && _gzip) {
+    GzipStream stream;
+    output.clear();
+    if (!stream.begin(_level))
+      return false;
+    std::string tail;
+    if (!stream.update(input, output) || !stream.finish(tail))
+      return false;
+    output += tail;
+    return true;
+  }
+#ifdef WEBSERV_HAVE_BROTLI
+  if (encoding == BROTLI && _brotli) {
+    // gzip_comp_level 1-9 → brotli quality 1-9 (10-11 are far too slow
+    // for an event loop, even once per file version)
+    size_t size = BrotliEncoderMaxCompressedSize(input.size());
+    if (size == 0)
+      return false;
+    output.resize(size);
+    if (!BrotliEncoderCompress(
+            _level, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, input.size(),
+            reinterpret_cast<const uint8_t *>(input.data()), &size,
+            reinterpret_cast<uint8_t *>(&output[0])))
+      return false;
+    output.resize(size);
+    return true;
+  }
+#endif
+  return false;
+}
+
+const char *Compression::token(Encoding encoding) {
+  return encoding == BROTLI ? "br" : encoding == GZIP ? "gzip" : "identity";
+}
+
+const char *Compression::suffix(Encoding encoding) {
+  return encoding == BROTLI ? ".br" : encoding == GZIP ? ".gz" : "";
+}
+
+bool Compression::isAvailable(Encoding encoding) {
+#ifdef WEBSERV_HAVE_ZLIB
+  if (encoding == GZIP)
+    return true;
+#endif
+#ifdef WEBSERV_HAVE_BROTLI
+  if (encoding == BROTLI)
+    return true;
+#endif
+  return encoding == IDENTITY;
+}
+
+// ==================== GzipStream ====================
+
+GzipStream::GzipStream() : _active(false) {}
+
+GzipStream::~GzipStream() { end(); }
+
+/**
+ * @brief Starts a gzip stream (RFC 1952 header, deflate, CRC trailer)
+ *
+ * @param level zlib level 1-9
+ */
+bool GzipStream::begin(int level) {
+  end();
+#ifdef WEBSERV_HAVE_ZLIB
+  _stream.zalloc = Z_NULL;
+  _stream.zfree = Z_NULL;
+  _stream.opaque = Z_NULL;
+  // windowBits 15 + 16: gzip wrapper instead of zlib's; memLevel 8 default
+  if (deflateInit2(&_stream, level, Z_DEFLATED, 15 + 16, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK)
+    return false;
+  _active = true;
+  return true;
+#else
+  (void)level;
+  return false;
+#endif
+}
+
+bool GzipStream::isActive() const { return _active; }
+
+bool GzipStream::deflateInto(const std::string &input, int flush,
+                             std::string &output) {
+#ifdef WEBSERV_HAVE_ZLIB
+  if (!_active)
+    return false;
+  _stream.next_in =
+      reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+  _stream.avail_in = static_cast<uInt>(input.size());
+  char buffer[16 * 1024];
+  int status;
+  do {
+    _stream.next_out = reinterpret_cast<Bytef *>(buffer);
+    _stream.avail_out = sizeof(buffer);
+    status = deflate(&_stream, flush);
+    if (status == Z_STREAM_ERROR)
+      return false;
+    output.append(buffer, sizeof(buffer) - _stream.avail_out);
+  } while (_stream.avail_out == 0);
+  return true;
+#else
+  (void)input;
+  (void)flush;
+  (void)output;
+  return false;
+#endif
+}
+
+/**
+ * @brief Compresses one piece of the body (Z_SYNC_FLUSH)
+ *
+ * @param input Uncompressed bytes
+ * @param output Encoded bytes are appended
+ */
+bool GzipStream::update(const std::string &input, std::string &output) {
+#ifdef WEBSERV_HAVE_ZLIB
+  return deflateInto(input, Z_SYNC_FLUSH, output);
+#else
+  (void)input;
+  (void)output;
+  return false;
+#endif
+}
+
+/**
+ * @brief Ends the stream: remaining bytes plus CRC32 and size trailer
+ *
+ * @param output Encoded bytes are appended
+ */
+bool GzipStream::finish(std::string &output) {
+#ifdef WEBSERV_HAVE_ZLIB
+  bool ok = deflateInto("", Z_FINISH, output);
+  end();
+  return ok;
+#else
+  (void)output;
+  return false;
+#endif
+}
+
+void GzipStream::end() {
+#ifdef WEBSERV_HAVE_ZLIB
+  if (_active)
+    deflateEnd(&_stream);
+#endif
+  _active = false;
+}
@@ -0,0 +1,198 @@
+#include "http/DirectoryListingCache.hpp"
+#include <sstream>
+
+/**
+ * @file DirectoryListingCache.cpp
+ * @brief Cached autoindex listings for large, frequently listed directories
+ *
+ * Without a cache every autoindex request read the whole directory and
+ * stat()ed every entry, so one GET on a directory of 100k files cost 100k
+ * syscalls on the event loop. Here the work is split by how long it stays
+ * valid:
+ *
+ *   names (readdir, sorted)  ── valid while the directory's dev/ino/mtime
+ *        │                       are unchanged (entries added, removed or
+ *        │                       renamed bump the mtime)
+ *        ▼
+ *   rendered page            ── valid PAGE_VALID seconds: sizes and dates
+ *                               of the entries change without touching the
+ *                               directory's mtime
+ *
+ * So a hit costs no syscall at all, a page expiry costs `limit` stat()s and
+ * only a changed directory costs a readdir() pass.
+ *
+ * Same-second race: a directory modified in the second it was scanned may
+ * change again without a visible mtime change. Such listings are marked
+ * unsettled and rescanned on the next request.
+ *
+ * With io_threads, a listing that needs a scan is scanned and its page
+ * rendered on an I/O thread instead, then brought in with install().
+ *
+ * Memory: at most MAX_DIRECTORIES listings (least recently used evicted)
+ * with MAX_PAGES rendered pages each.
+ *
+ * @note Single-threaded per process, like the rest of the event loop
+ */
+
+DirectoryListingCache::DirectoryListingCache()
+    : _hits(0), _misses(0), _scans(0) {}
+
+DirectoryListingCache::~DirectoryListingCache() {}
+
+void DirectoryListingCache::evictOldest() {
+  ListingMap::iterator oldest = _listings.begin();
+  for (ListingMap::iterator it = _listings.begin(); it != _listings.end();
+       ++it) {
+    if (it->second.lastUsed < oldest->second.lastUsed)
+      oldest = it;
+  }
+  if (oldest != _listings.end())
+    _listings.erase(oldest);
+}
+
+/**
+ * @brief Returns one page of a directory listing, scanning/rendering on miss
+ *
+ * @param dirPath Filesystem path of the directory
+ * @param dirStat Current stat() view of it (the open file cache's)
+ * @param urlPath Requested URL path (links, title; part of the page key)
+ * @param options Page, page size and format
+ * @param justScanned install() was called for this request: an unsettled
+ *        listing is used once instead of being read again
+ * @return Page body (valid until the next call), or NULL if the directory
+ *         can't be read (errno set)
+ */
+const std::string *
+DirectoryListingCache::getPage(const std::string &dirPath,
+                               const struct stat &dirStat,
+                               const std::string &urlPath,
+                               const Autoindex::Options &options,
+                               bool justScanned) {
+  time_t now = time(NULL);
+
+  ListingMap::iterator it = _listings.find(dirPath);
+  if (it == _listings.end() || !isCurrent(it->second, dirStat, justScanned)) {
+    std::vector<std::string> names;
+    if (!Autoindex::scanDirectory(dirPath, names)) {
+      if (it != _listings.end())
+        _listings.erase(it);
+      return NULL;
+    }
+    it = store(dirPath, dirStat, names, now);
+  }
+
+  DirectoryListing &listing = it->second;
+  listing.lastUsed = now;
+
+  std::string key = pageKey(urlPath, options);
+  std::pair<time_t, std::string> &page = listing.pages[key];
+  if (!page.second.empty() && now - page.first < PAGE_VALID) {
+    ++_hits;
+    return &page.second;
+  }
+
+  ++_misses;
+  if (listing.pages.size() > MAX_PAGES) {
+    // Keep only the page being rendered; rarely used keys go away
+    listing.pages.clear();
+    std::pair<time_t, std::string> &slot = listing.pages[key];
+    slot.first = now;
+    slot.second = Autoindex::renderPage(dirPath, urlPath, listing.names,
+                                        options);
+    return &slot.second;
+  }
+  page.first = now;
+  page.second = Autoindex::renderPage(dirPath, urlPath, listing.names, options);
+  return &page.second;
+}
+
+/**
+ * @brief Whether getPage() would have to read the directory again
+ *
+ * @param dirPath Filesystem path of the directory
+ * @param dirStat Current stat() view of it
+ */
+bool DirectoryListingCache::needsScan(const std::string &dirPath,
+                                      const struct stat &dirStat) const {
+  ListingMap::const_iterator it = _listings.find(dirPath);
+  return it == _listings.end() || !isCurrent(it->second, dirStat, false);
+}
+
+/**
+ * @brief Whether listing still matches the directory version in dirStat
+ */
+bool DirectoryListingCache::isCurrent(const DirectoryListing &listing,
+                                      const struct stat &dirStat,
+                                      bool allowUnsettled) {
+  return (listing.settled || allowUnsettled) &&
+         listing.dev == dirStat.st_dev && listing.ino == dirStat.st_ino &&
+         listing.mtime == dirStat.st_mtime;
+}
+
+/**
+ * @brief Brings in a scan and page rendered on an I/O thread
+ *
+ * @param dirPath Filesystem path of the directory
+ * @param dirStat stat() view the scan was made for
+ * @param names scanDirectory() result (swapped in, left empty)
+ * @param urlPath URL path the page was rendered for
+ * @param options Page, page size and format of the page
+ * @param page renderPage() result
+ */
+void DirectoryListingCache::install(const std::string &dirPath,
+                                    const struct stat &dirStat,
+                                    std::vector<std::string> &names,
+                                    const std::string &urlPath,
+                                    const Autoindex::Options &options,
+                                    const std::string &page) {
+  time_t now = time(NULL);
+  DirectoryListing &listing = store(dirPath, dirStat, names, now)->second;
+  listing.lastUsed = now;
+  std::pair<time_t, std::string> &slot =
+      listing.pages[pageKey(urlPath, options)];
+  slot.first = now;
+  slot.second = page;
+}
+
+/**
+ * @brief Replaces the names of a listing (its rendered pages are dropped)
+ */
+DirectoryListingCache::ListingMap::iterator
+DirectoryListingCache::store(const std::string &dirPath,
+                             const struct stat &dirStat,
+                             std::vector<std::string> &names, time_t now) {
+  ++_scans;
+  ListingMap::iterator it = _listings.find(dirPath);
+  if (it == _listings.end()) {
+    if (_listings.size() >= MAX_DIRECTORIES)
+      evictOldest();
+    it = _listings.insert(std::make_pair(dirPath, DirectoryListing())).first;
+  }
+  DirectoryListing &fresh = it->second;
+  fresh.dev = dirStat.st_dev;
+  fresh.ino = dirStat.st_ino;
+  fresh.mtime = dirStat.st_mtime;
+  fresh.settled = dirStat.st_mtime < now;
+  fresh.names.swap(names);
+  fresh.pages.clear();
+  return it;
+}
+
+/**
+ * @brief Key of a rendered page within its listing
+ */
+std::string DirectoryListingCache::pageKey(const std::string &urlPath,
+                                           const Autoindex::Options &options) {
+  std::ostringstream key;
+  key << (options.json ? 'j' : 'h') << options.page << ':' << options.limit
+      << ':' << urlPath;
+  return key.str();
+}
+
+size_t DirectoryListingCache::size() const { return _listings.size(); }
+
+unsigned long DirectoryListingCache::getHits() const { return _hits; }
+
+unsigned long DirectoryListingCache::getMisses() const { return _misses; }
+
+unsigned long DirectoryListingCache::getScans() const { return _scans; }
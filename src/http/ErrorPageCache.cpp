@@ -0,0 +1,118 @@
+#include "http/ErrorPageCache.hpp"
+#include "core/Logger.hpp"
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+/**
+ * @file ErrorPageCache.cpp
+ * @brief Custom error pages read and serialized once per configuration
+ *
+ * RequestHandler used to stat() and read the error_page file on every
+ * error, then build its headers. Every page named by a server or location
+ * block is now read once when the Server is built, and kept with its
+ * pre-serialized header block; an error costs a lookup and a header block
+ * copy, and the body is sent from here by pointer (see
+ * HttpResponse::useErrorPage()).
+ *
+ * Pages are keyed by resolved file path and status code: connections hold
+ * their own copy of the server configs, and the path is what tells the
+ * (server, location) pairs apart. Files that cannot be read at load time
+ * fall back to the built-in page. Edits to a page take effect when the
+ * configuration is loaded again.
+ *
+ * @note Single-threaded per process, like the rest of the event loop
+ */
+
+ErrorPageCache::ErrorPageCache() : _count(0) {}
+
+ErrorPageCache::~ErrorPageCache() {}
+
+/**
+ * @brief Resolves an error_page path against a root
+ *
+ * @param out Receives the path (its storage is reused)
+ * @param root Server or location root ("" = current directory)
+ * @param page error_page value ("/404.html" or "404.html")
+ */
+void ErrorPageCache::resolvePath(std::string &out, const std::string &root,
+                                 const std::string &page) {
+  out.assign(root.empty() ? "." : root);
+  if (out[out.size() - 1] == '/')
+    out.erase(out.size() - 1);
+  if (page.empty() || page[0] != '/')
+    out += '/';
+  out += page;
+}
+
+/**
+ * @brief Reads the pages of one error_page map
+ *
+ * @param errorPages Code → page path
+ * @param root Root the paths are relative to
+ */
+void ErrorPageCache::load(const std::map<int, std::string> &errorPages,
+                          const std::string &root) {
+  std::string path;
+  for (std::map<int, std::string>::const_iterator it = errorPages.begin();
+       it != errorPages.end(); ++it) {
+    resolvePath(path, root, it->second);
+    CodeMap &pages = _pages[path];
+    if (pages.find(it->first) != pages.end())
+      continue; // Shared by several blocks (or already found unreadable)
+    PrebuiltPage &page = pages[it->first]; // code 0 until loaded
+
+    struct stat fileStat;
+    std::ifstream file;
+    if (stat(path.c_str(), &fileStat) == 0 && S_ISREG(fileStat.st_mode))
+      file.open(path.c_str());
+    if (!file.is_open()) {
+      LOG_WARN("error_page " << it->first << ": cannot read " << path
+               << ", the built-in page is used");
+      continue;
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    HttpResponse::preparePage(page, it->first, "Error", buffer.str());
+    ++_count;
+  }
+}
+
+/**
+ * @brief Reads every error_page of a configuration
+ *
+ * @param servers Server blocks (their locations included)
+ */
+void ErrorPageCache::build(const std::vector<ServerConfig> &servers) {
+  _pages.clear();
+  _count = 0;
+  for (size_t i = 0; i < servers.size(); ++i) {
+    load(servers[i].getErrorPages(), servers[i].getRoot());
+    const std::vector<LocationConfig> &locations = servers[i].getLocations();
+    for (size_t j = 0; j < locations.size(); ++j)
+      load(locations[j].getErrorPages(), locations[j].getRoot());
+  }
+}
+
+/**
+ * @brief Looks up the page of a resolved error_page file
+ *
+ * @param path Path built by resolvePath()
+ * @param code Status code
+ * @return Page (valid until the next build()), or NULL
+ */
+const PrebuiltPage *ErrorPageCache::find(const std::string &path,
+                                         int code) const {
+  PathMap::const_iterator file = _pages.find(path);
+  if (file == _pages.end())
+    return NULL;
+  CodeMap::const_iterator page = file->second.find(code);
+  if (page == file->second.end() || page->second.code == 0)
+    return NULL;
+  return &page->second;
+}
+
+/**
+ * @brief Number of pages held
+ */
+size_t ErrorPageCache::size() const { return _count; }
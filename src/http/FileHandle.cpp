@@ -0,0 +1,72 @@
+#include "http/FileHandle.hpp"
+#include <unistd.h>
+
+/**
+ * @file FileHandle.cpp
+ * @brief Shared ownership of file descriptors for file-backed bodies
+ *
+ * HttpResponse is copied by value (RequestHandler returns it, the
+ * connection stores it). A raw fd inside it would either leak or be closed
+ * twice. FileHandle keeps a small heap counter shared by every copy and
+ * closes the fd exactly once, when the last copy is destroyed or reset.
+ *
+ * @note Not thread-safe - the server is single-threaded per process
+ */
+
+/**
+ * @brief Empty handle (no fd)
+ */
+FileHandle::FileHandle() : _fd(-1), _refCount(NULL) {}
+
+/**
+ * @brief Takes ownership of fd
+ *
+ * @param fd Open file descriptor (closed when the last copy is released)
+ */
+FileHandle::FileHandle(int fd) : _fd(fd), _refCount(NULL) {
+  if (_fd >= 0)
+    _refCount = new int(1);
+}
+
+FileHandle::FileHandle(const FileHandle &other)
+    : _fd(other._fd), _refCount(other._refCount) {
+  if (_refCount)
+    ++*_refCount;
+}
+
+FileHandle &FileHandle::operator=(const FileHandle &other) {
+  if (this != &other && _refCount != other._refCount) {
+    release();
+    _fd = other._fd;
+    _refCount = other._refCount;
+    if (_refCount)
+      ++*_refCount;
+  }
+  return *this;
+}
+
+FileHandle::~FileHandle() { release(); }
+
+/**
+ * @brief Drops this reference, closing the fd if it was the last one
+ */
+void FileHandle::release() {
+  if (_refCount && --*_refCount == 0) {
+    close(_fd);
+    delete _refCount;
+  }
+  _fd = -1;
+  _refCount = NULL;
+}
+
+/**
+ * @brief Returns the shared fd, or -1 for an empty handle
+ */
+int FileHandle::getFd() const { return _fd; }
+
+bool FileHandle::isValid() const { return _fd >= 0; }
+
+/**
+ * @brief Releases this reference and leaves the handle empty
+ */
+void FileHandle::reset() { release(); }
@@ -0,0 +1,262 @@
+#include "http/FileTasks.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+/**
+ * @file FileTasks.cpp
+ * @brief The blocking steps of StaticFileHandler, as I/O thread tasks
+ *
+ * Each task copies what it needs when created, does its system calls in
+ * run() (I/O thread) and hands the result over in complete() (event loop):
+ *
+ *   FileLookupTask      stat + open + small read  → OpenFileCache::install()
+ *   DirectoryScanTask   readdir + page render     → DirectoryListingCache
+ *                                                   (+ IoOutcome)
+ *   FileSyncTask        fsync of an upload        → IoOutcome
+ *   FileDeleteTask      stat + access + unlink    → IoOutcome
+ *
+ * With io_uring, FileLookupTask runs as steps on the event loop instead
+ * (IoThreadPool::enableUring()): statx → openat → read of a small file,
+ * each submitted when the previous one completed, then the same entry
+ * as load() builds is installed.
+ *
+ * The request is then handled again from the start and finds the result
+ * in memory (caches), or in the handler's IoOutcome for the tasks whose
+ * work must not run twice (fsync, unlink, a directory scan).
+ *
+ * complete() only runs while the owning connection is alive, so the
+ * caches and IoOutcome references are valid there; run() never uses them.
+ */
+
+// ==================== FileLookupTask ====================
+
+/**
+ * @param cache Cache the result goes to (its setting decides whether small
+ *        files are read into memory)
+ * @param path Resolved filesystem path
+ */
+FileLookupTask::FileLookupTask(OpenFileCache &cache, const std::string &path)
+    : _cache(cache), _path(path), _keepContent(cache.isEnabled()),
+      _mapMax(cache.getMapMax()) {
+#ifdef STATX_BASIC_STATS
+  _step = START;
+  _read = 0;
+#endif
+}
+
+void FileLookupTask::run() {
+  OpenFileCache::load(_path, _entry, _keepContent, _mapMax);
+}
+
+void FileLookupTask::complete() { _cache.install(_path, _entry); }
+
+#ifdef STATX_BASIC_STATS
+/**
+ * @brief The stat() view of a statx() result
+ */
+static void statFromStatx(const struct statx &from, struct stat &to) {
+  std::memset(&to, 0, sizeof(to));
+  to.st_dev = makedev(from.stx_dev_major, from.stx_dev_minor);
+  to.st_ino = from.stx_ino;
+  to.st_mode = from.stx_mode;
+  to.st_nlink = from.stx_nlink;
+  to.st_uid = from.stx_uid;
+  to.st_gid = from.stx_gid;
+  to.st_rdev = makedev(from.stx_rdev_major, from.stx_rdev_minor);
+  to.st_size = static_cast<off_t>(from.stx_size);
+  to.st_blksize = from.stx_blksize;
+  to.st_blocks = static_cast<blkcnt_t>(from.stx_blocks);
+  to.st_atim.tv_sec = from.stx_atime.tv_sec;
+  to.st_atim.tv_nsec = from.stx_atime.tv_nsec;
+  to.st_mtim.tv_sec = from.stx_mtime.tv_sec;
+  to.st_mtim.tv_nsec = from.stx_mtime.tv_nsec;
+  to.st_ctim.tv_sec = from.stx_ctime.tv_sec;
+  to.st_ctim.tv_nsec = from.stx_ctime.tv_nsec;
+}
+
+/**
+ * @brief The next system call of load(), as an io_uring step
+ */
+bool FileLookupTask::nextStep(IoStep &step) {
+  step.fd = AT_FDCWD;
+  step.path = _path.c_str();
+  step.flags = 0;
+  step.buffer = NULL;
+  step.length = 0;
+  step.offset = 0;
+  switch (_step) {
+  case START:
+    step.op = IoStep::STATX;
+    step.buffer = &_statx;
+    step.length = STATX_BASIC_STATS;
+    _step = STAT;
+    return true;
+  case OPEN:
+    step.op = IoStep::OPENAT;
+    step.flags = OpenFileCache::openFlags();
+    return true;
+  case READ:
+    step.op = IoStep::READ;
+    step.fd = _entry.file.getFd();
+    step.buffer = &_content[_read];
+    step.length = static_cast<unsigned>(_content.size() - _read);
+    step.offset = _read;
+    return true;
+  default:
+    return false;
+  }
+}
+
+/**
+ * @brief Takes the result of the step in flight, as load() would
+ */
+void FileLookupTask::stepDone(int result) {
+  switch (_step) {
+  case STAT: {
+    struct stat st;
+    statFromStatx(_statx, st);
+    OpenFileCache::loadStat(_entry, st, result < 0 ? -result : 0);
+    _step = result == 0 && S_ISREG(st.st_mode) ? OPEN : DONE;
+    break;
+  }
+  case OPEN:
+    _step = DONE;
+    if (OpenFileCache::loadOpened(_entry, result, result < 0 ? -result : 0,
+                                  _keepContent, _mapMax)) {
+      _content.assign(static_cast<size_t>(_entry.st.st_size), '\0');
+      _step = READ;
+    }
+    break;
+  case READ:
+    if (result <= 0) {
+      _step = DONE; // Keep streaming from the fd instead
+      break;
+    }
+    _read += static_cast<size_t>(result);
+    break;
+  default:
+    _step = DONE;
+    break;
+  }
+  if (_step == READ && _read == _content.size()) {
+    OpenFileCache::loadContent(_entry, _content);
+    _step = DONE;
+  }
+}
+#endif
+
+// ==================== DirectoryScanTask ====================
+
+/**
+ * @param listings Cache the names and page go to
+ * @param outcome Receives errno of the scan (0: listing installed)
+ * @param dirPath Filesystem path of the directory
+ * @param dirStat stat() view of it
+ * @param urlPath Requested URL path
+ * @param options Page requested
+ */
+DirectoryScanTask::DirectoryScanTask(DirectoryListingCache &listings,
+                                     IoOutcome &outcome,
+                                     const std::string &dirPath,
+                                     const struct stat &dirStat,
+                                     const std::string &urlPath,
+                                     const Autoindex::Options &options)
+    : _listings(listings), _outcome(outcome), _dirPath(dirPath),
+      _dirStat(dirStat), _urlPath(urlPath), _options(options), _error(0) {}
+
+void DirectoryScanTask::run() {
+  if (!Autoindex::scanDirectory(_dirPath, _names)) {
+    _error = errno;
+    return;
+  }
+  _page = Autoindex::renderPage(_dirPath, _urlPath, _names, _options);
+}
+
+void DirectoryScanTask::complete() {
+  if (_error == 0)
+    _listings.install(_dirPath, _dirStat, _names, _urlPath, _options, _page);
+  _outcome.ready = true;
+  _outcome.path = _dirPath;
+  _outcome.value = _error;
+}
+
+// ==================== FileSyncTask ====================
+
+/**
+ * @param outcome Receives errno of fsync() (0 on success)
+ * @param path Upload path (identifies the outcome)
+ * @param fd Descriptor the task owns and closes
+ */
+FileSyncTask::FileSyncTask(IoOutcome &outcome, const std::string &path,
+                           int fd)
+    : _outcome(outcome), _path(path), _fd(fd), _error(0) {}
+
+FileSyncTask::~FileSyncTask() {
+  if (_fd >= 0)
+    close(_fd);
+}
+
+void FileSyncTask::run() {
+  if (fsync(_fd) != 0)
+    _error = errno;
+  close(_fd);
+  _fd = -1;
+}
+
+void FileSyncTask::complete() {
+  _outcome.ready = true;
+  _outcome.path = _path;
+  _outcome.value = _error;
+}
+
+// ==================== FileDeleteTask ====================
+
+/**
+ * @param outcome Receives the HTTP status of the removal
+ * @param path Resolved filesystem path
+ */
+FileDeleteTask::FileDeleteTask(IoOutcome &outcome, const std::string &path)
+    : _outcome(outcome), _path(path), _status(500) {}
+
+void FileDeleteTask::run() { _status = removeFile(_path); }
+
+void FileDeleteTask::complete() {
+  _outcome.ready = true;
+  _outcome.path = _path;
+  _outcome.value = _status;
+}
+
+/**
+ * @brief Removes the target of a DELETE, with the checks of the handler
+ *
+ * 1. The file must exist (404) and be readable by stat() (403)
+ * 2. Directories are never deleted (403)
+ * 3. The parent directory must be writable (403)
+ * 4. remove() (403 on EACCES/EPERM, 500 otherwise)
+ *
+ * No logging: also runs on I/O threads.
+ *
+ * @param path Resolved filesystem path
+ * @return 204 if removed, else the error status to answer
+ */
+int FileDeleteTask::removeFile(const std::string &path) {
+  struct stat fileStat;
+  if (stat(path.c_str(), &fileStat) != 0)
+    return errno == ENOENT ? 404 : errno == EACCES ? 403 : 500;
+  if (S_ISDIR(fileStat.st_mode))
+    return 403;
+
+  std::string parentDir = path.substr(0, path.find_last_of('/'));
+  if (parentDir.empty())
+    parentDir = ".";
+  if (access(parentDir.c_str(), W_OK) != 0)
+    return 403;
+
+  if (std::remove(path.c_str()) != 0)
+    return errno == EACCES || errno == EPERM ? 403 : 500;
+  return 204;
+}
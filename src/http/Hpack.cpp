@@ -0,0 +1,372 @@
+#include "http/Hpack.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * @file Hpack.cpp
+ * @brief HPACK header compression for HTTP/2 (RFC 7541)
+ *
+ * Decoding is complete: indexed fields, literals with or without indexing,
+ * dynamic table size updates, and Huffman-coded strings (browsers and curl
+ * Huffman-code nearly everything). The Huffman code is canonical, so the
+ * decoder walks it one bit at a time with three small per-length tables
+ * (first code, first symbol index, code count) instead of a tree.
+ *
+ * Encoding favours simplicity over the last bytes: the response header
+ * block is small next to the body, so it uses the static table for names
+ * and plain literals for values.
+ */
+
+struct StaticField {
+  const char *name;
+  const char *value;
+};
+
+// RFC 7541 Appendix A (index 1 first)
+static const StaticField STATIC_TABLE[] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+static const size_t STATIC_COUNT =
+    sizeof(STATIC_TABLE) / sizeof(STATIC_TABLE[0]);
+
+// RFC 7541 Appendix B as a canonical code, by code length (0-30 bits):
+// the codes of length L are FIRST_CODE[L] .. FIRST_CODE[L] + CODE_COUNT[L]
+// - 1, for SYMBOLS[FIRST_INDEX[L]] onwards. Symbol 256 is EOS.
+static const uint32_t FIRST_CODE[31] = {
+    0, 0, 0, 0, 0, 0, 20, 92, 248, 0, 1016, 2042, 4090, 8184, 16380, 32764,
+    0, 0, 0, 524272, 1048550, 2097116, 4194258, 8388568, 16777194, 33554412,
+    67108832, 134217694, 268435426, 0, 1073741820,
+};
+static const uint16_t FIRST_INDEX[31] = {
+    0, 0, 0, 0, 0, 0, 10, 36, 68, 0, 74, 79, 82, 84, 90, 92, 0, 0, 0, 95,
+    98, 106, 119, 145, 174, 186, 190, 205, 224, 0, 253,
+};
+static const uint16_t CODE_COUNT[31] = {
+    0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3, 0, 0, 0, 3, 8, 13,
+    26, 29, 12, 4, 15, 19, 29, 0, 4,
+};
+static const uint16_t SYMBOLS[257] = {
+    48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37, 45, 46, 47, 51, 52,
+    53, 54, 55, 56, 57, 61, 65, 95, 98, 100, 102, 103, 104, 108, 109, 110,
+    112, 114, 117, 58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78,
+    79, 80, 81, 82, 83, 84, 85, 86, 87, 89, 106, 107, 113, 118, 119, 120,
+    121, 122, 38, 42, 44, 59, 88, 90, 33, 34, 40, 41, 63, 39, 43, 124, 35,
+    62, 0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92, 195, 208, 128,
+    130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177, 179,
+    209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156,
+    160, 163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190, 196,
+    198, 228, 232, 233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150,
+    151, 152, 155, 157, 158, 165, 166, 168, 174, 175, 180, 182, 183, 188,
+    191, 197, 231, 239, 9, 142, 144, 145, 148, 159, 171, 206, 215, 225, 236,
+    237, 199, 207, 234, 235, 192, 193, 200, 201, 202, 205, 210, 213, 218,
+    219, 238, 240, 242, 243, 255, 203, 204, 211, 212, 214, 221, 222, 223,
+    241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254, 2, 3, 4, 5, 6, 7,
+    8, 11, 12, 14, 15, 16, 17, 18, 19, 20, 21, 23, 24, 25, 26, 27, 28, 29,
+    30, 31, 127, 220, 249, 10, 13, 22, 256,
+};
+
+/**
+ * @brief Reads an integer with an N-bit prefix (RFC 7541 5.1)
+ * @return false if truncated or over 2^28
+ */
+static bool decodeInteger(const unsigned char *&p, const unsigned char *end,
+                          int prefixBits, size_t &value) {
+  if (p == end)
+    return false;
+  size_t mask = (1u << prefixBits) - 1;
+  value = *p++ & mask;
+  if (value < mask)
+    return true;
+  for (int shift = 0; shift <= 21; shift += 7) {
+    if (p == end)
+      return false;
+    unsigned char byte = *p++;
+    value += static_cast<size_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false; // Longer than any size we accept
+}
+
+/**
+ * @brief Huffman-decodes a string literal
+ *
+ * The final bits must be a prefix of EOS (all ones, at most 7 bits), and
+ * EOS itself must not appear.
+ */
+static bool decodeHuffman(const unsigned char *data, size_t length,
+                          std::string &out) {
+  uint32_t code = 0;
+  int bits = 0;
+  for (size_t i = 0; i < length; ++i) {
+    for (int bit = 7; bit >= 0; --bit) {
+      code = (code << 1) | ((data[i] >> bit) & 1);
+      if (++bits > 30)
+        return false;
+      uint32_t rank = code - FIRST_CODE[bits];
+      if (CODE_COUNT[bits] == 0 || code < FIRST_CODE[bits] ||
+          rank >= CODE_COUNT[bits])
+        continue;
+      uint16_t symbol = SYMBOLS[FIRST_INDEX[bits] + rank];
+      if (symbol == 256)
+        return false;
+      out += static_cast<char>(symbol);
+      code = 0;
+      bits = 0;
+    }
+  }
+  return bits <= 7 && code == (1u << bits) - 1;
+}
+
+/**
+ * @brief Reads a string literal, Huffman-coded or raw
+ */
+static bool decodeString(const unsigned char *&p, const unsigned char *end,
+                         std::string &out) {
+  if (p == end)
+    return false;
+  bool huffman = (*p & 0x80) != 0;
+  size_t length;
+  if (!decodeInteger(p, end, 7, length) ||
+      length > static_cast<size_t>(end - p))
+    return false;
+  out.clear();
+  bool ok = true;
+  if (huffman)
+    ok = decodeHuffman(p, length, out);
+  else
+    out.assign(reinterpret_cast<const char *>(p), length);
+  p += length;
+  return ok;
+}
+
+static void appendString(std::string &out, const std::string &value) {
+  HpackEncoder::encodeInteger(out, static_cast<uint32_t>(value.size()), 7,
+                              0x00);
+  out += value;
+}
+
+HpackDecoder::HpackDecoder() : _tableSize(0), _maxSize(TABLE_SIZE) {}
+
+/**
+ * @brief Decodes one header block into fields, in order
+ *
+ * Representations (first byte):
+ *   1xxxxxxx  indexed field
+ *   01xxxxxx  literal, added to the dynamic table
+ *   001xxxxx  dynamic table size update
+ *   0000xxxx  literal, not added (0001xxxx: never indexed, same here)
+ *
+ * A one-byte indexed reference to a 4 KB table entry decodes to 4 KB, so
+ * a small block can expand a thousandfold: the decoded list is counted
+ * as it grows and decoding stops past maxListSize. The dynamic table is
+ * then out of sync with the client's, so the connection must end.
+ *
+ * @param data Header block
+ * @param length Its size
+ * @param fields Receives the fields (cleared first)
+ * @param maxListSize Limit of the decoded list, RFC 7541 size
+ * @return DECODED, MALFORMED (bad representation or index) or TOO_LARGE
+ */
+HpackDecoder::Result HpackDecoder::decode(const unsigned char *data,
+                                          size_t length,
+                                          std::vector<HeaderPair> &fields,
+                                          size_t maxListSize) {
+  const unsigned char *p = data;
+  const unsigned char *end = data + length;
+  size_t listSize = 0;
+  fields.clear();
+  while (p < end) {
+    unsigned char first = *p;
+    size_t index;
+    HeaderPair field;
+    if (first & 0x80) {
+      if (!decodeInteger(p, end, 7, index) || !lookup(index, field))
+        return MALFORMED;
+      listSize += 32 + field.name.size() + field.value.size();
+      if (listSize > maxListSize)
+        return TOO_LARGE;
+      fields.push_back(field);
+      continue;
+    }
+    if ((first & 0xe0) == 0x20) {
+      if (!decodeInteger(p, end, 5, index) || index > TABLE_SIZE)
+        return MALFORMED;
+      _maxSize = index;
+      evict();
+      continue;
+    }
+    bool indexing = (first & 0x40) != 0;
+    if (!decodeInteger(p, end, indexing ? 6 : 4, index))
+      return MALFORMED;
+    if (index != 0) {
+      if (!lookup(index, field))
+        return MALFORMED;
+    } else if (!decodeString(p, end, field.name)) {
+      return MALFORMED;
+    }
+    if (!decodeString(p, end, field.value))
+      return MALFORMED;
+    listSize += 32 + field.name.size() + field.value.size();
+    if (listSize > maxListSize)
+      return TOO_LARGE;
+    if (indexing)
+      insert(field);
+    fields.push_back(field);
+  }
+  return DECODED;
+}
+
+/**
+ * @brief Field at an HPACK index: 1-61 static, then dynamic, newest first
+ */
+bool HpackDecoder::lookup(size_t index, HeaderPair &field) const {
+  if (index == 0)
+    return false;
+  if (index <= STATIC_COUNT) {
+    field.name = STATIC_TABLE[index - 1].name;
+    field.value = STATIC_TABLE[index - 1].value;
+    return true;
+  }
+  index -= STATIC_COUNT + 1;
+  if (index >= _table.size())
+    return false;
+  field = _table[index];
+  return true;
+}
+
+/**
+ * @brief Adds a field to the dynamic table, evicting the oldest ones
+ *
+ * A field larger than the whole table empties it and is not kept.
+ */
+void HpackDecoder::insert(const HeaderPair &field) {
+  size_t size = 32 + field.name.size() + field.value.size();
+  if (size > _maxSize) {
+    _table.clear();
+    _tableSize = 0;
+    return;
+  }
+  _table.push_front(field);
+  _tableSize += size;
+  evict();
+}
+
+void HpackDecoder::evict() {
+  while (_tableSize > _maxSize && !_table.empty()) {
+    const HeaderPair &oldest = _table.back();
+    _tableSize -= 32 + oldest.name.size() + oldest.value.size();
+    _table.pop_back();
+  }
+}
+
+void HpackEncoder::encodeStatus(std::string &out, int status) {
+  for (size_t i = 7; i < 14; ++i) { // ":status" 200 ... 500
+    if (std::atoi(STATIC_TABLE[i].value) == status) {
+      encodeInteger(out, static_cast<uint32_t>(i + 1), 7, 0x80);
+      return;
+    }
+  }
+  char digits[16];
+  int length = std::snprintf(digits, sizeof(digits), "%d", status);
+  encodeInteger(out, 8, 4, 0x00); // Name of index 8, value literal
+  appendString(out, std::string(digits, static_cast<size_t>(length)));
+}
+
+void HpackEncoder::encode(std::string &out, const std::string &name,
+                          const std::string &value) {
+  for (size_t i = 14; i < STATIC_COUNT; ++i) { // Past the pseudo-headers
+    if (name == STATIC_TABLE[i].name) {
+      encodeInteger(out, static_cast<uint32_t>(i + 1), 4, 0x00);
+      appendString(out, value);
+      return;
+    }
+  }
+  out += '\0'; // Literal name, not indexed
+  appendString(out, name);
+  appendString(out, value);
+}
+
+void HpackEncoder::encodeTableSize(std::string &out, size_t size) {
+  encodeInteger(out, static_cast<uint32_t>(size), 5, 0x20);
+}
+
+/**
+ * @brief Writes value with a prefixBits-bit prefix; flags fill the rest of
+ * the first byte
+ */
+void HpackEncoder::encodeInteger(std::string &out, uint32_t value,
+                                 int prefixBits, unsigned char flags) {
+  uint32_t mask = (1u << prefixBits) - 1;
+  if (value < mask) {
+    out += static_cast<char>(flags | value);
+    return;
+  }
+  out += static_cast<char>(flags | mask);
+  value -= mask;
+  while (value >= 0x80) {
+    out += static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
@@ -0,0 +1,1114 @@
+#include "http/Http2Session.hpp"
+#include "core/Logger.hpp"
+#include "core/Metrics.hpp"
+#include "http/RequestHandler.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <unistd.h>
+
+/**
+ * @file Http2Session.cpp
+ * @brief HTTP/2 over cleartext TCP (h2c), RFC 9113
+ *
+ * A connection switches to HTTP/2 in one of two ways, on a port listening
+ * with "listen 8080 http2":
+ * - prior knowledge: its first bytes are the client preface
+ * - "Upgrade: h2c" on a bodiless HTTP/1.1 request: 101, then that request
+ *   is answered as stream 1
+ *
+ * Each stream is rebuilt as an HTTP/1.1 request (validated: no pseudo
+ * headers out of place, no connection-specific fields, no CR/LF/NUL) and
+ * run through RequestHandler::handleRequest(), exactly like a request of
+ * the HTTP/1.1 path, as soon as its END_STREAM arrives. The response's
+ * header block is converted to HPACK and queued at once (HEADERS are not
+ * flow-controlled); its body (memory part + file segments, read with
+ * pread()) leaves as DATA frames while both flow-control windows allow.
+ *
+ * Streams with DATA pending are served round-robin, each taking
+ * 1 + weight / 64 frames per turn (weights from PRIORITY / HEADERS
+ * priority), and a stream whose parent is itself sending waits for it:
+ * the stylesheet a page depends on goes before the images.
+ *
+ * Limits:
+ * - handleRequest() runs without a connection: streams for CGI, FastCGI
+ *   and proxy_pass locations are reset with HTTP_1_1_REQUIRED (clients
+ *   retry them over HTTP/1.1) rather than run synchronously on the loop
+ * - request bodies are held in memory (up to client_max_body_size)
+ * - header lists decode to at most MAX_HEADER_LIST bytes (advertised in
+ *   SETTINGS_MAX_HEADER_LIST_SIZE); past it the connection ends with
+ *   ENHANCE_YOUR_CALM
+ * - no server push (SETTINGS_ENABLE_PUSH is ignored)
+ */
+
+enum FrameType {
+  FRAME_DATA = 0,
+  FRAME_HEADERS = 1,
+  FRAME_PRIORITY = 2,
+  FRAME_RST_STREAM = 3,
+  FRAME_SETTINGS = 4,
+  FRAME_PUSH_PROMISE = 5,
+  FRAME_PING = 6,
+  FRAME_GOAWAY = 7,
+  FRAME_WINDOW_UPDATE = 8,
+  FRAME_CONTINUATION = 9
+};
+
+static const uint8_t FLAG_END_STREAM = 0x1;
+static const uint8_t FLAG_ACK = 0x1;
+static const uint8_t FLAG_END_HEADERS = 0x4;
+static const uint8_t FLAG_PADDED = 0x8;
+static const uint8_t FLAG_PRIORITY = 0x20;
+
+enum ErrorCode {
+  NO_ERROR = 0x0,
+  PROTOCOL_ERROR = 0x1,
+  INTERNAL_ERROR = 0x2,
+  FLOW_CONTROL_ERROR = 0x3,
+  STREAM_CLOSED = 0x5,
+  FRAME_SIZE_ERROR = 0x6,
+  REFUSED_STREAM = 0x7,
+  COMPRESSION_ERROR = 0x9,
+  ENHANCE_YOUR_CALM = 0xb,
+  HTTP_1_1_REQUIRED = 0xd
+};
+
+static const int64_t DEFAULT_WINDOW = 65535;
+static const int64_t MAX_WINDOW = 0x7fffffff;
+
+const char Http2Session::PREFACE[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+const size_t Http2Session::PREFACE_LENGTH;
+const uint32_t Http2Session::MAX_STREAMS;
+const uint32_t Http2Session::MAX_FRAME;
+const size_t Http2Session::MAX_HEADER_BLOCK;
+const uint32_t Http2Session::MAX_HEADER_LIST;
+
+static uint32_t readUint32(const unsigned char *p) {
+  return (static_cast<uint32_t>(p[0]) << 24) |
+         (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+static void appendUint32(std::string &out, uint32_t value) {
+  out += static_cast<char>(value >> 24);
+  out += static_cast<char>(value >> 16);
+  out += static_cast<char>(value >> 8);
+  out += static_cast<char>(value);
+}
+
+/**
+ * @brief Decodes base64url without padding (the HTTP2-Settings header)
+ */
+static bool decodeBase64Url(const std::string &in, std::string &out) {
+  uint32_t bits = 0;
+  int count = 0;
+  for (size_t i = 0; i < in.size(); ++i) {
+    char c = in[i];
+    int value;
+    if (c >= 'A' && c <= 'Z')
+      value = c - 'A';
+    else if (c >= 'a' && c <= 'z')
+      value = c - 'a' + 26;
+    else if (c >= '0' && c <= '9')
+      value = c - '0' + 52;
+    else if (c == '-' || c == '+')
+      value = 62;
+    else if (c == '_' || c == '/')
+      value = 63;
+    else if (c == '=')
+      break;
+    else
+      return false;
+    bits = (bits << 6) | static_cast<uint32_t>(value);
+    count += 6;
+    if (count >= 8) {
+      count -= 8;
+      out += static_cast<char>((bits >> count) & 0xff);
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Whether a comma-separated header value lists token
+ */
+static bool listsToken(const char *value, size_t length, const char *token) {
+  size_t tokenLength = std::strlen(token);
+  size_t i = 0;
+  while (i < length) {
+    while (i < length && (value[i] == ' ' || value[i] == '\t' ||
+                          value[i] == ','))
+      ++i;
+    size_t start = i;
+    while (i < length && value[i] != ',' && value[i] != ' ' &&
+           value[i] != '\t')
+      ++i;
+    if (i - start == tokenLength) {
+      size_t k = 0;
+      while (k < tokenLength &&
+             std::tolower(static_cast<unsigned char>(value[start + k])) ==
+                 token[k])
+        ++k;
+      if (k == tokenLength)
+        return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief HTTP/1.1 connection-specific fields, forbidden in HTTP/2
+ */
+static bool isConnectionHeader(const std::string &name) {
+  return name == "connection" || name == "keep-alive" ||
+         name == "proxy-connection" || name == "transfer-encoding" ||
+         name == "upgrade";
+}
+
+Http2Stream::Http2Stream()
+    : remoteClosed(false), responding(false), bodyLimit(0),
+      declaredLength(-1), recvWindow(DEFAULT_WINDOW), sendWindow(0),
+      weight(16), dependency(0), dataOffset(0), segmentIndex(0),
+      segmentSent(0) {}
+
+bool Http2Stream::hasData() const {
+  if (dataOffset < data.size())
+    return true;
+  for (size_t i = segmentIndex; i < segments.size(); ++i) {
+    if (segments[i].length > (i == segmentIndex ? segmentSent : 0))
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Starts a session; our SETTINGS frame is queued first
+ *
+ * @param handler The connection's handler (caches, error pages, vhosts)
+ * @param servers Server blocks of the port
+ * @param clientIp For the access log
+ */
+Http2Session::Http2Session(RequestHandler &handler,
+                           const std::vector<ServerConfig> &servers,
+                           const std::string &clientIp)
+    : _handler(handler), _servers(servers), _clientIp(clientIp),
+      _prefaceSeen(false), _settingsSeen(false), _continuing(0),
+      _continuingEnd(false), _lastStream(0), _goingAway(false),
+      _failed(false), _tableSizeUpdate(false), _sendWindow(DEFAULT_WINDOW),
+      _recvWindow(DEFAULT_WINDOW), _initialWindow(DEFAULT_WINDOW),
+      _peerMaxFrame(MAX_FRAME) {
+  std::string settings;
+  settings += '\0'; // SETTINGS_MAX_CONCURRENT_STREAMS
+  settings += '\3';
+  appendUint32(settings, MAX_STREAMS);
+  settings += '\0'; // SETTINGS_MAX_HEADER_LIST_SIZE
+  settings += '\6';
+  appendUint32(settings, MAX_HEADER_LIST);
+  appendFrame(_control, FRAME_SETTINGS, 0, 0, settings.data(),
+              settings.size());
+}
+
+Http2Session::~Http2Session() {
+  for (std::map<uint32_t, Http2Stream *>::iterator it = _streams.begin();
+       it != _streams.end(); ++it)
+    delete it->second;
+}
+
+bool Http2Session::matchesPreface(const char *data, size_t length) {
+  return std::memcmp(data, PREFACE, std::min(length, PREFACE_LENGTH)) == 0;
+}
+
+/**
+ * @brief Whether a request asks to switch to h2c
+ *
+ * Needs "Upgrade: h2c", an HTTP2-Settings header and "Connection:
+ * Upgrade". Requests with a body stay on HTTP/1.1 (the RFC lets a server
+ * ignore the upgrade).
+ */
+bool Http2Session::isUpgrade(const HttpRequest &request) {
+  size_t length;
+  const char *upgrade = request.getHeaderValue("Upgrade", length);
+  if (!upgrade || !listsToken(upgrade, length, "h2c"))
+    return false;
+  const char *connection = request.getHeaderValue("Connection", length);
+  if (!connection || !listsToken(connection, length, "upgrade"))
+    return false;
+  if (!request.getHeaderValue("HTTP2-Settings", length))
+    return false;
+  return request.getBodySize() == 0 && request.getContentLength() <= 0 &&
+         !request.isChunked();
+}
+
+/**
+ * @brief Answers an upgraded HTTP/1.1 request as stream 1
+ *
+ * The client's HTTP2-Settings apply as if sent in a SETTINGS frame; its
+ * preface and SETTINGS still follow on the connection.
+ *
+ * @param request The complete request that carried "Upgrade: h2c"
+ */
+void Http2Session::upgrade(const HttpRequest &request) {
+  std::string settings;
+  if (decodeBase64Url(request.getOneHeader("HTTP2-Settings"), settings) &&
+      settings.size() % 6 == 0)
+    applySettings(reinterpret_cast<const unsigned char *>(settings.data()),
+                  static_cast<uint32_t>(settings.size()));
+  Http2Stream *stream = new Http2Stream();
+  stream->remoteClosed = true;
+  stream->sendWindow = _initialWindow;
+  _streams[1] = stream;
+  _lastStream = 1;
+  dispatch(1, *stream, request);
+}
+
+/**
+ * @brief Processes received bytes: preface, then whole frames
+ *
+ * An incomplete frame is kept until the rest arrives.
+ *
+ * @return false after a connection error (GOAWAY queued)
+ */
+bool Http2Session::receive(const char *data, size_t length) {
+  if (_failed)
+    return false;
+  _in.append(data, length);
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(_in.data());
+  size_t size = _in.size();
+  size_t pos = 0;
+
+  if (!_prefaceSeen) {
+    if (!matchesPreface(_in.data(), size))
+      return fail(PROTOCOL_ERROR, "invalid connection preface");
+    if (size < PREFACE_LENGTH)
+      return true;
+    pos = PREFACE_LENGTH;
+    _prefaceSeen = true;
+  }
+
+  while (size - pos >= 9) {
+    uint32_t frameLength = (static_cast<uint32_t>(p[pos]) << 16) |
+                           (static_cast<uint32_t>(p[pos + 1]) << 8) |
+                           static_cast<uint32_t>(p[pos + 2]);
+    if (frameLength > MAX_FRAME)
+      return fail(FRAME_SIZE_ERROR, "frame larger than SETTINGS_MAX_FRAME");
+    if (size - pos < 9 + frameLength)
+      break;
+    uint8_t type = p[pos + 3];
+    uint8_t flags = p[pos + 4];
+    uint32_t streamId = readUint32(p + pos + 5) & 0x7fffffff;
+    if (!processFrame(type, flags, streamId, p + pos + 9, frameLength))
+      return false;
+    pos += 9 + frameLength;
+  }
+  _in.erase(0, pos);
+  return true;
+}
+
+/**
+ * @brief Dispatches one frame by type
+ *
+ * A header block must be followed by its CONTINUATION frames only, and
+ * the client's first frame must be SETTINGS. Unknown types are ignored.
+ */
+bool Http2Session::processFrame(uint8_t type, uint8_t flags,
+                                uint32_t streamId,
+                                const unsigned char *payload,
+                                uint32_t length) {
+  if (_continuing &&
+      (type != FRAME_CONTINUATION || streamId != _continuing))
+    return fail(PROTOCOL_ERROR, "header block interrupted");
+  if (!_settingsSeen) {
+    if (type != FRAME_SETTINGS || (flags & FLAG_ACK))
+      return fail(PROTOCOL_ERROR, "first frame is not SETTINGS");
+    _settingsSeen = true;
+  }
+
+  switch (type) {
+  case FRAME_DATA:
+    return onData(flags, streamId, payload, length);
+  case FRAME_HEADERS:
+    return onHeaders(flags, streamId, payload, length);
+  case FRAME_PRIORITY:
+    return onPriority(streamId, payload, length);
+  case FRAME_RST_STREAM:
+    if (streamId == 0 || streamId > _lastStream)
+      return fail(PROTOCOL_ERROR, "RST_STREAM on an idle stream");
+    if (length != 4)
+      return fail(FRAME_SIZE_ERROR, "RST_STREAM size");
+    closeStream(streamId);
+    return true;
+  case FRAME_SETTINGS:
+    return onSettings(flags, streamId, payload, length);
+  case FRAME_PUSH_PROMISE:
+    return fail(PROTOCOL_ERROR, "PUSH_PROMISE from a client");
+  case FRAME_PING:
+    if (streamId != 0)
+      return fail(PROTOCOL_ERROR, "PING on a stream");
+    if (length != 8)
+      return fail(FRAME_SIZE_ERROR, "PING size");
+    if (!(flags & FLAG_ACK))
+      appendFrame(_control, FRAME_PING, FLAG_ACK, 0,
+                  reinterpret_cast<const char *>(payload), 8);
+    return true;
+  case FRAME_GOAWAY:
+    if (streamId != 0)
+      return fail(PROTOCOL_ERROR, "GOAWAY on a stream");
+    _goingAway = true; // Streams already open are still answered
+    return true;
+  case FRAME_WINDOW_UPDATE:
+    return onWindowUpdate(streamId, payload, length);
+  case FRAME_CONTINUATION:
+    return onContinuation(flags, streamId, payload, length);
+  default:
+    return true;
+  }
+}
+
+/**
+ * @brief HEADERS: opens a stream (or carries its trailers)
+ *
+ * Padding and the priority fields are stripped; the fragment waits for
+ * its CONTINUATION frames unless END_HEADERS is set.
+ */
+bool Http2Session::onHeaders(uint8_t flags, uint32_t streamId,
+                             const unsigned char *payload, uint32_t length) {
+  if (streamId == 0)
+    return fail(PROTOCOL_ERROR, "HEADERS on stream 0");
+  uint32_t offset = 0;
+  uint32_t padding = 0;
+  if (flags & FLAG_PADDED) {
+    if (length < 1)
+      return fail(FRAME_SIZE_ERROR, "HEADERS padding");
+    padding = payload[0];
+    offset = 1;
+  }
+  uint32_t dependency = 0;
+  int weight = 16;
+  if (flags & FLAG_PRIORITY) {
+    if (length < offset + 5)
+      return fail(FRAME_SIZE_ERROR, "HEADERS priority");
+    dependency = readUint32(payload + offset) & 0x7fffffff;
+    weight = payload[offset + 4] + 1;
+    offset += 5;
+  }
+  if (offset + padding > length)
+    return fail(PROTOCOL_ERROR, "HEADERS padding exceeds the payload");
+
+  Http2Stream *stream;
+  std::map<uint32_t, Http2Stream *>::iterator it = _streams.find(streamId);
+  if (it != _streams.end()) {
+    stream = it->second;
+    if (stream->remoteClosed || !(flags & FLAG_END_STREAM))
+      return fail(STREAM_CLOSED, "HEADERS on a half-closed stream");
+  } else {
+    if (streamId % 2 == 0 || streamId <= _lastStream)
+      return fail(PROTOCOL_ERROR, "invalid new stream id");
+    if (dependency == streamId)
+      return fail(PROTOCOL_ERROR, "stream depends on itself");
+    _lastStream = streamId;
+    stream = new Http2Stream();
+    stream->sendWindow = _initialWindow;
+    stream->weight = weight;
+    stream->dependency = dependency;
+    _streams[streamId] = stream;
+  }
+
+  stream->headerBlock.assign(reinterpret_cast<const char *>(payload) + offset,
+                             length - offset - padding);
+  if (flags & FLAG_END_HEADERS)
+    return headerBlockDone(streamId, (flags & FLAG_END_STREAM) != 0);
+  _continuing = streamId;
+  _continuingEnd = (flags & FLAG_END_STREAM) != 0;
+  return true;
+}
+
+bool Http2Session::onContinuation(uint8_t flags, uint32_t streamId,
+                                  const unsigned char *payload,
+                                  uint32_t length) {
+  if (_continuing == 0 || streamId != _continuing)
+    return fail(PROTOCOL_ERROR, "CONTINUATION without HEADERS");
+  Http2Stream *stream = _streams[streamId];
+  stream->headerBlock.append(reinterpret_cast<const char *>(payload), length);
+  if (stream->headerBlock.size() > MAX_HEADER_BLOCK)
+    return fail(ENHANCE_YOUR_CALM, "header block too large");
+  if (!(flags & FLAG_END_HEADERS))
+    return true;
+  _continuing = 0;
+  return headerBlockDone(streamId, _continuingEnd);
+}
+
+/**
+ * @brief Decodes a complete header block and acts on it
+ *
+ * The block is always decoded (the HPACK table must stay in sync) even
+ * when the stream is then refused or its trailers ignored. A decoded list
+ * over MAX_HEADER_LIST (advertised) ends the connection: decoding stopped
+ * midway, so the table can no longer follow the client's.
+ */
+bool Http2Session::headerBlockDone(uint32_t streamId, bool endStream) {
+  Http2Stream *stream = _streams[streamId];
+  std::vector<HeaderPair> fields;
+  HpackDecoder::Result decoded = _decoder.decode(
+      reinterpret_cast<const unsigned char *>(stream->headerBlock.data()),
+      stream->headerBlock.size(), fields, MAX_HEADER_LIST);
+  std::string().swap(stream->headerBlock);
+  if (decoded == HpackDecoder::TOO_LARGE)
+    return fail(ENHANCE_YOUR_CALM, "decoded header list too large");
+  if (decoded != HpackDecoder::DECODED)
+    return fail(COMPRESSION_ERROR, "invalid header block");
+
+  if (!stream->head.empty()) { // Trailers: not used
+    stream->remoteClosed = true;
+    if (!stream->responding)
+      execute(streamId);
+    return true;
+  }
+  if (_goingAway || _streams.size() > MAX_STREAMS) {
+    resetStream(streamId, REFUSED_STREAM);
+    return true;
+  }
+  if (!buildRequestHead(*stream, fields)) {
+    LOG_DEBUG("[h2] Malformed request on stream " << streamId);
+    resetStream(streamId, PROTOCOL_ERROR);
+    return true;
+  }
+  if (endStream) {
+    stream->remoteClosed = true;
+    execute(streamId);
+    return true;
+  }
+  // A body follows: cap it like the HTTP/1.1 path
+  std::string head = stream->head + "\r\n";
+  _request.reset();
+  _request.parse(head.data(), head.size());
+  stream->bodyLimit = _handler.getBodyLimit(_request, _servers);
+  if (stream->declaredLength >= 0 &&
+      static_cast<size_t>(stream->declaredLength) > stream->bodyLimit)
+    execute(streamId); // 413 before any DATA
+  return true;
+}
+
+/**
+ * @brief Rebuilds the request as an HTTP/1.1 header block
+ *
+ * Rejects (stream PROTOCOL_ERROR) what RFC 9113 calls malformed: missing
+ * or repeated pseudo-headers, pseudo-headers after regular fields,
+ * uppercase names, connection-specific fields. CR, LF and NUL are
+ * refused anywhere, so a field can never inject a line of its own.
+ * Cookie fields are joined back into one; :authority becomes Host; the
+ * Content-Length line is written by execute() from the DATA received.
+ */
+bool Http2Session::buildRequestHead(Http2Stream &stream,
+                                    const std::vector<HeaderPair> &fields) {
+  std::string method, path, scheme, authority, cookies, headers;
+  bool regular = false;
+  for (size_t i = 0; i < fields.size(); ++i) {
+    const std::string &name = fields[i].name;
+    const std::string &value = fields[i].value;
+    if (name.empty())
+      return false;
+    for (size_t k = 0; k < name.size(); ++k) {
+      unsigned char c = static_cast<unsigned char>(name[k]);
+      if (c <= ' ' || c >= 0x7f || std::isupper(c) || (c == ':' && k > 0))
+        return false;
+    }
+    if (value.find_first_of(std::string("\r\n\0", 3)) != std::string::npos)
+      return false;
+
+    if (name[0] == ':') {
+      std::string *target = NULL;
+      if (name == ":method")
+        target = &method;
+      else if (name == ":path")
+        target = &path;
+      else if (name == ":scheme")
+        target = &scheme;
+      else if (name == ":authority")
+        target = &authority;
+      if (regular || !target || !target->empty() || value.empty())
+        return false;
+      *target = value;
+      continue;
+    }
+    regular = true;
+    if (isConnectionHeader(name) || (name == "te" && value != "trailers"))
+      return false;
+    if (name == "te")
+      continue;
+    if (name == "cookie") {
+      cookies += cookies.empty() ? "" : "; ";
+      cookies += value;
+    } else if (name == "content-length") {
+      char *end;
+      long declared = std::strtol(value.c_str(), &end, 10);
+      if (value.empty() || *end != '\0' || declared < 0 ||
+          (stream.declaredLength >= 0 && stream.declaredLength != declared))
+        return false;
+      stream.declaredLength = declared;
+    } else if (name == "host") {
+      if (authority.empty())
+        authority = value;
+    } else {
+      headers += name;
+      headers += ": ";
+      headers += value;
+      headers += "\r\n";
+    }
+  }
+  if (method.empty() || scheme.empty() || path.empty() || path[0] != '/' ||
+      path.find_first_of(" \t") != std::string::npos)
+    return false;
+
+  stream.head = method + " " + path + " HTTP/1.1\r\n";
+  if (!authority.empty())
+    stream.head += "host: " + authority + "\r\n";
+  stream.head += headers;
+  if (!cookies.empty())
+    stream.head += "cookie: " + cookies + "\r\n";
+  return true;
+}
+
+/**
+ * @brief DATA: request body bytes, flow-controlled
+ *
+ * Windows are topped up as soon as they fall under half, since the body
+ * is consumed right away. A body over the location's limit is answered
+ * 413 at once; the rest of it is discarded.
+ */
+bool Http2Session::onData(uint8_t flags, uint32_t streamId,
+                          const unsigned char *payload, uint32_t length) {
+  if (streamId == 0)
+    return fail(PROTOCOL_ERROR, "DATA on stream 0");
+  uint32_t padding = 0;
+  if (flags & FLAG_PADDED) {
+    if (length < 1 || static_cast<uint32_t>(payload[0]) + 1 > length)
+      return fail(PROTOCOL_ERROR, "DATA padding exceeds the payload");
+    padding = payload[0] + 1;
+  }
+
+  _recvWindow -= length;
+  if (_recvWindow < 0)
+    return fail(FLOW_CONTROL_ERROR, "connection window exceeded");
+  if (_recvWindow < DEFAULT_WINDOW / 2) {
+    std::string increment;
+    appendUint32(increment,
+                 static_cast<uint32_t>(DEFAULT_WINDOW - _recvWindow));
+    appendFrame(_control, FRAME_WINDOW_UPDATE, 0, 0, increment.data(), 4);
+    _recvWindow = DEFAULT_WINDOW;
+  }
+
+  std::map<uint32_t, Http2Stream *>::iterator it = _streams.find(streamId);
+  if (it == _streams.end()) {
+    if (streamId > _lastStream)
+      return fail(PROTOCOL_ERROR, "DATA on an idle stream");
+    return true; // Reset or finished stream: frames still in flight
+  }
+  Http2Stream *stream = it->second;
+  if (stream->remoteClosed) {
+    resetStream(streamId, STREAM_CLOSED);
+    return true;
+  }
+  stream->recvWindow -= length;
+  if (stream->recvWindow < 0) {
+    resetStream(streamId, FLOW_CONTROL_ERROR);
+    return true;
+  }
+
+  bool endStream = (flags & FLAG_END_STREAM) != 0;
+  if (!stream->responding) {
+    const char *bytes = reinterpret_cast<const char *>(payload);
+    uint32_t dataLength = length - padding;
+    if (flags & FLAG_PADDED)
+      ++bytes;
+    stream->body.append(bytes, dataLength);
+    if (stream->body.size() > stream->bodyLimit) {
+      execute(streamId); // 413, see execute()
+      return true;
+    }
+  }
+  if (!endStream && stream->recvWindow < DEFAULT_WINDOW / 2) {
+    std::string increment;
+    appendUint32(increment,
+                 static_cast<uint32_t>(DEFAULT_WINDOW - stream->recvWindow));
+    appendFrame(_control, FRAME_WINDOW_UPDATE, 0, streamId, increment.data(),
+                4);
+    stream->recvWindow = DEFAULT_WINDOW;
+  }
+  if (endStream) {
+    stream->remoteClosed = true;
+    if (!stream->responding)
+      execute(streamId);
+    else if (!stream->hasData())
+      closeStream(streamId); // 413 already sent
+  }
+  return true;
+}
+
+bool Http2Session::onSettings(uint8_t flags, uint32_t streamId,
+                              const unsigned char *payload, uint32_t length) {
+  if (streamId != 0)
+    return fail(PROTOCOL_ERROR, "SETTINGS on a stream");
+  if (flags & FLAG_ACK) {
+    if (length != 0)
+      return fail(FRAME_SIZE_ERROR, "SETTINGS ACK with a payload");
+    return true;
+  }
+  if (length % 6 != 0)
+    return fail(FRAME_SIZE_ERROR, "SETTINGS size");
+  uint32_t error = applySettings(payload, length);
+  if (error != NO_ERROR)
+    return fail(error, "invalid SETTINGS value");
+  appendFrame(_control, FRAME_SETTINGS, FLAG_ACK, 0, NULL, 0);
+  return true;
+}
+
+/**
+ * @brief Applies the client's settings
+ *
+ * INITIAL_WINDOW_SIZE changes the window of every open stream by the
+ * difference (it may go negative); HEADER_TABLE_SIZE makes the next header
+ * block start with a size update to 0 (we never index, so any limit
+ * holds); the others we act on are validated only.
+ *
+ * @return NO_ERROR, or the connection error code
+ */
+uint32_t Http2Session::applySettings(const unsigned char *payload,
+                                     uint32_t length) {
+  for (uint32_t i = 0; i + 6 <= length; i += 6) {
+    unsigned id = (static_cast<unsigned>(payload[i]) << 8) | payload[i + 1];
+    uint32_t value = readUint32(payload + i + 2);
+    if (id == 1) { // HEADER_TABLE_SIZE
+      _tableSizeUpdate = true;
+    } else if (id == 2) { // ENABLE_PUSH
+      if (value > 1)
+        return PROTOCOL_ERROR;
+    } else if (id == 4) { // INITIAL_WINDOW_SIZE
+      if (value > MAX_WINDOW)
+        return FLOW_CONTROL_ERROR;
+      int64_t delta = static_cast<int64_t>(value) - _initialWindow;
+      for (std::map<uint32_t, Http2Stream *>::iterator it = _streams.begin();
+           it != _streams.end(); ++it) {
+        it->second->sendWindow += delta;
+        if (it->second->sendWindow > MAX_WINDOW)
+          return FLOW_CONTROL_ERROR;
+      }
+      _initialWindow = value;
+    } else if (id == 5) { // MAX_FRAME_SIZE
+      if (value < 16384 || value > 16777215)
+        return PROTOCOL_ERROR;
+      _peerMaxFrame = value;
+    }
+  }
+  return NO_ERROR;
+}
+
+bool Http2Session::onWindowUpdate(uint32_t streamId,
+                                  const unsigned char *payload,
+                                  uint32_t length) {
+  if (length != 4)
+    return fail(FRAME_SIZE_ERROR, "WINDOW_UPDATE size");
+  int64_t increment = readUint32(payload) & 0x7fffffff;
+  if (streamId == 0) {
+    if (increment == 0)
+      return fail(PROTOCOL_ERROR, "WINDOW_UPDATE of 0");
+    _sendWindow += increment;
+    if (_sendWindow > MAX_WINDOW)
+      return fail(FLOW_CONTROL_ERROR, "connection window overflow");
+    return true;
+  }
+  std::map<uint32_t, Http2Stream *>::iterator it = _streams.find(streamId);
+  if (it == _streams.end()) {
+    if (streamId > _lastStream)
+      return fail(PROTOCOL_ERROR, "WINDOW_UPDATE on an idle stream");
+    return true;
+  }
+  if (increment == 0) {
+    resetStream(streamId, PROTOCOL_ERROR);
+    return true;
+  }
+  it->second->sendWindow += increment;
+  if (it->second->sendWindow > MAX_WINDOW)
+    resetStream(streamId, FLOW_CONTROL_ERROR);
+  return true;
+}
+
+/**
+ * @brief PRIORITY: new weight and parent of a stream (open ones only)
+ */
+bool Http2Session::onPriority(uint32_t streamId, const unsigned char *payload,
+                              uint32_t length) {
+  if (streamId == 0)
+    return fail(PROTOCOL_ERROR, "PRIORITY on stream 0");
+  if (length != 5)
+    return fail(FRAME_SIZE_ERROR, "PRIORITY size");
+  uint32_t dependency = readUint32(payload) & 0x7fffffff;
+  if (dependency == streamId) {
+    resetStream(streamId, PROTOCOL_ERROR);
+    return true;
+  }
+  std::map<uint32_t, Http2Stream *>::iterator it = _streams.find(streamId);
+  if (it != _streams.end()) {
+    it->second->dependency = dependency;
+    it->second->weight = payload[4] + 1;
+  }
+  return true;
+}
+
+/**
+ * @brief Runs a stream whose request is complete (or whose body is over
+ * its limit)
+ *
+ * The HTTP/1.1 block gets the Content-Length of what was received. A body
+ * over bodyLimit (received or declared) is not fed: the request stops
+ * there and the handler answers 413, like on the HTTP/1.1 path.
+ */
+void Http2Session::execute(uint32_t streamId) {
+  Http2Stream &stream = *_streams[streamId];
+  size_t size = stream.body.size();
+  if (stream.declaredLength >= 0)
+    size = std::max(size, static_cast<size_t>(stream.declaredLength));
+  bool tooLarge = !stream.remoteClosed && size > stream.bodyLimit;
+  if (!tooLarge && stream.remoteClosed && stream.declaredLength >= 0 &&
+      static_cast<size_t>(stream.declaredLength) != stream.body.size()) {
+    resetStream(streamId, PROTOCOL_ERROR);
+    return;
+  }
+
+  std::ostringstream length;
+  length << (tooLarge ? size : stream.body.size());
+  std::string head = stream.head;
+  if (!stream.body.empty() || stream.declaredLength >= 0)
+    head += "content-length: " + length.str() + "\r\n";
+  head += "\r\n";
+
+  _request.reset();
+  _request.parse(head.data(), head.size());
+  if (tooLarge)
+    _request.stopReadingBody();
+  else if (!stream.body.empty())
+    _request.parse(stream.body.data(), stream.body.size());
+  std::string().swap(stream.body);
+  dispatch(streamId, stream, _request);
+}
+
+/**
+ * @brief Runs a request through the handler and queues its response
+ */
+void Http2Session::dispatch(uint32_t streamId, Http2Stream &stream,
+                            const HttpRequest &request) {
+  _response.reset();
+  _handler.setDeferIo(false); // Answered now: no connection to park on
+  _handler.handleRequest(request, _servers, _response, NULL);
+  if (_handler.needsConnection()) {
+    LOG_DEBUG("[h2] Stream " << streamId << " from " << _clientIp
+              << " needs HTTP/1.1: " << request.getPath());
+    resetStream(streamId, HTTP_1_1_REQUIRED);
+    return;
+  }
+  const std::string *location = _handler.getMatchedLocation();
+  Metrics::countResponse(_response.getStatusCode(),
+                         location ? *location : std::string());
+  respond(streamId, stream, request);
+}
+
+/**
+ * @brief Converts the handler's response into HEADERS (+ DATA later)
+ *
+ * The HTTP/1.1 header block is rendered as usual and re-read line by
+ * line, so prebuilt and cached header blocks convert the same way.
+ * Connection-specific fields are dropped; names are lowercased.
+ */
+void Http2Session::respond(uint32_t streamId, Http2Stream &stream,
+                           const HttpRequest &request) {
+  std::string head;
+  _response.appendHeaders(head);
+  int status = _response.getStatusCode();
+
+  std::string block;
+  if (_tableSizeUpdate) {
+    HpackEncoder::encodeTableSize(block, 0);
+    _tableSizeUpdate = false;
+  }
+  HpackEncoder::encodeStatus(block, status);
+  size_t pos = head.find("\r\n");
+  while (pos != std::string::npos && pos + 2 < head.size()) {
+    size_t start = pos + 2;
+    pos = head.find("\r\n", start);
+    if (pos == std::string::npos || pos == start)
+      break;
+    size_t colon = head.find(':', start);
+    if (colon == std::string::npos || colon > pos)
+      continue;
+    std::string name = head.substr(start, colon - start);
+    for (size_t i = 0; i < name.size(); ++i)
+      name[i] = static_cast<char>(
+          std::tolower(static_cast<unsigned char>(name[i])));
+    size_t valueStart = colon + 1;
+    while (valueStart < pos && head[valueStart] == ' ')
+      ++valueStart;
+    if (isConnectionHeader(name))
+      continue;
+    HpackEncoder::encode(block, name,
+                         head.substr(valueStart, pos - valueStart));
+  }
+
+  bool bodyAllowed = request.getMethod() != "HEAD" && status != 204 &&
+                     status != 304 && status >= 200;
+  off_t bytes = 0;
+  if (bodyAllowed) {
+    stream.data.assign(_response.getBodyData(), _response.getBodyLength());
+    _response.takeBodySegments(stream.segments);
+    bytes = static_cast<off_t>(stream.data.size());
+    for (size_t i = 0; i < stream.segments.size(); ++i)
+      bytes += stream.segments[i].length;
+  }
+  if (Logger::accessEnabled())
+    logAccess(request, status, bytes);
+
+  stream.responding = true;
+  bool endStream = !stream.hasData();
+  sendHeaders(streamId, block, endStream);
+  if (endStream)
+    finishStream(streamId, stream);
+}
+
+/**
+ * @brief Queues a header block: HEADERS, then CONTINUATION frames if it
+ * exceeds the client's frame size
+ */
+void Http2Session::sendHeaders(uint32_t streamId, const std::string &block,
+                               bool endStream) {
+  size_t offset = 0;
+  bool first = true;
+  do {
+    size_t chunk = std::min(block.size() - offset,
+                            static_cast<size_t>(_peerMaxFrame));
+    bool last = offset + chunk == block.size();
+    uint8_t flags = last ? FLAG_END_HEADERS : 0;
+    if (first && endStream)
+      flags |= FLAG_END_STREAM;
+    appendFrame(_control, first ? FRAME_HEADERS : FRAME_CONTINUATION, flags,
+                streamId, block.data() + offset, chunk);
+    offset += chunk;
+    first = false;
+  } while (offset < block.size());
+}
+
+/**
+ * @brief Whether a stream has DATA to send and window to send it
+ */
+bool Http2Session::isReady(const Http2Stream &stream) const {
+  return stream.responding && stream.sendWindow > 0 && stream.hasData();
+}
+
+/**
+ * @brief Appends one DATA frame of a stream
+ *
+ * One source per frame: the in-memory body, a memory segment, or a file
+ * segment read with pread() straight into the output.
+ *
+ * @param finished Set when this was the last frame (stream closed)
+ * @return false when nothing could be sent (or the file broke)
+ */
+bool Http2Session::sendData(std::string &out, uint32_t streamId,
+                            Http2Stream &stream, bool &finished) {
+  finished = false;
+  int64_t room = std::min<int64_t>(std::min(_sendWindow, stream.sendWindow),
+                                   std::min(MAX_FRAME, _peerMaxFrame));
+  if (room <= 0)
+    return false;
+
+  size_t headerAt = out.size();
+  out.append(9, '\0');
+  size_t sent = 0;
+  if (stream.dataOffset < stream.data.size()) {
+    sent = std::min(static_cast<size_t>(room),
+                    stream.data.size() - stream.dataOffset);
+    out.append(stream.data, stream.dataOffset, sent);
+    stream.dataOffset += sent;
+  } else {
+    while (stream.segmentIndex < stream.segments.size() &&
+           stream.segments[stream.segmentIndex].length <= stream.segmentSent) {
+      ++stream.segmentIndex; // Empty or finished segment
+      stream.segmentSent = 0;
+    }
+    const BodySegment &segment = stream.segments[stream.segmentIndex];
+    sent = static_cast<size_t>(
+        std::min<off_t>(room, segment.length - stream.segmentSent));
+    if (segment.isFile()) {
+      size_t at = out.size();
+      out.resize(at + sent);
+      ssize_t got = pread(segment.file.getFd(), &out[at], sent,
+                          segment.offset + stream.segmentSent);
+      if (got <= 0) { // File shrank under us
+        out.resize(headerAt);
+        resetStream(streamId, INTERNAL_ERROR);
+        finished = true;
+        return false;
+      }
+      sent = static_cast<size_t>(got);
+      out.resize(at + sent);
+    } else {
+      out.append(segment.data, static_cast<size_t>(stream.segmentSent), sent);
+    }
+    stream.segmentSent += static_cast<off_t>(sent);
+  }
+
+  _sendWindow -= static_cast<int64_t>(sent);
+  stream.sendWindow -= static_cast<int64_t>(sent);
+  finished = !stream.hasData();
+  std::string header;
+  appendFrame(header, FRAME_DATA, finished ? FLAG_END_STREAM : 0, streamId,
+              NULL, sent);
+  out.replace(headerAt, 9, header, 0, 9);
+  if (finished)
+    finishStream(streamId, stream);
+  return true;
+}
+
+/**
+ * @brief The response is complete: close the stream
+ *
+ * If the client is still sending (413 before the end of its body), an
+ * RST_STREAM(NO_ERROR) tells it to stop.
+ */
+void Http2Session::finishStream(uint32_t streamId, Http2Stream &stream) {
+  if (!stream.remoteClosed)
+    resetStream(streamId, NO_ERROR);
+  else
+    closeStream(streamId);
+}
+
+/**
+ * @brief Appends frames to send: control frames first, then DATA
+ *
+ * DATA is taken in weighted round-robin turns (see the file comment) and
+ * stops at limit, so a large response is framed as the socket drains
+ * rather than all at once.
+ */
+void Http2Session::produce(std::string &out, size_t limit) {
+  out += _control;
+  _control.clear();
+  bool progress = true;
+  while (progress && out.size() < limit && _sendWindow > 0) {
+    progress = false;
+    std::map<uint32_t, Http2Stream *>::iterator it = _streams.begin();
+    while (it != _streams.end() && out.size() < limit && _sendWindow > 0) {
+      uint32_t streamId = it->first;
+      Http2Stream *stream = it->second;
+      ++it; // The stream may be closed below
+      if (!isReady(*stream))
+        continue;
+      std::map<uint32_t, Http2Stream *>::iterator parent =
+          _streams.find(stream->dependency);
+      if (parent != _streams.end() && isReady(*parent->second))
+        continue; // Parent first
+      int quantum = 1 + stream->weight / 64;
+      for (int turn = 0; turn < quantum && out.size() < limit; ++turn) {
+        bool finished;
+        if (!sendData(out, streamId, *stream, finished))
+          break;
+        progress = true;
+        if (finished)
+          break;
+      }
+    }
+  }
+  out += _control; // RST_STREAM of streams finished above
+  _control.clear();
+}
+
+bool Http2Session::wantsWrite() const {
+  if (!_control.empty())
+    return true;
+  if (_sendWindow <= 0)
+    return false;
+  for (std::map<uint32_t, Http2Stream *>::const_iterator it = _streams.begin();
+       it != _streams.end(); ++it) {
+    if (isReady(*it->second))
+      return true;
+  }
+  return false;
+}
+
+bool Http2Session::isIdle() const { return _streams.empty(); }
+
+bool Http2Session::isFinished() const {
+  return _control.empty() && (_failed || (_goingAway && _streams.empty()));
+}
+
+void Http2Session::closeStream(uint32_t streamId) {
+  std::map<uint32_t, Http2Stream *>::iterator it = _streams.find(streamId);
+  if (it == _streams.end())
+    return;
+  delete it->second;
+  _streams.erase(it);
+}
+
+void Http2Session::resetStream(uint32_t streamId, uint32_t error) {
+  std::string code;
+  appendUint32(code, error);
+  appendFrame(_control, FRAME_RST_STREAM, 0, streamId, code.data(), 4);
+  closeStream(streamId);
+}
+
+/**
+ * @brief Connection error: GOAWAY, drop every stream, stop reading
+ *
+ * @return false (for the callers to return)
+ */
+bool Http2Session::fail(uint32_t error, const char *reason) {
+  LOG_DEBUG("[h2] Connection error " << error << " from " << _clientIp << ": "
+            << reason);
+  std::string payload;
+  appendUint32(payload, _lastStream);
+  appendUint32(payload, error);
+  appendFrame(_control, FRAME_GOAWAY, 0, 0, payload.data(), payload.size());
+  for (std::map<uint32_t, Http2Stream *>::iterator it = _streams.begin();
+       it != _streams.end(); ++it)
+    delete it->second;
+  _streams.clear();
+  _goingAway = true;
+  _failed = true;
+  return false;
+}
+
+/**
+ * @brief Writes the access_log line of a stream (combined format)
+ */
+void Http2Session::logAccess(const HttpRequest &request, int status,
+                             off_t bytes) const {
+  const std::string &path = request.getPath();
+  const std::string &query = request.getQuery();
+  std::ostream &line = Logger::beginAccess();
+  line << _clientIp << " - - " << Logger::accessTime() << " \""
+       << request.getMethod() << ' ' << LogExcerpt(path.data(), path.size());
+  if (!query.empty())
+    line << '?' << LogExcerpt(query.data(), query.size());
+  line << " HTTP/2.0\" " << status << ' ' << bytes << " \"";
+  size_t length;
+  const char *referer = request.getHeaderValue("Referer", length);
+  line << (referer ? LogExcerpt(referer, length) : LogExcerpt("-", 1))
+       << "\" \"";
+  const char *agent = request.getHeaderValue("User-Agent", length);
+  line << (agent ? LogExcerpt(agent, length) : LogExcerpt("-", 1)) << '"';
+  Logger::end();
+}
+
+/**
+ * @brief Appends a frame header (and the payload, if given)
+ */
+void Http2Session::appendFrame(std::string &out, uint8_t type, uint8_t flags,
+                               uint32_t streamId, const char *payload,
+                               size_t length) {
+  out += static_cast<char>((length >> 16) & 0xff);
+  out += static_cast<char>((length >> 8) & 0xff);
+  out += static_cast<char>(length & 0xff);
+  out += static_cast<char>(type);
+  out += static_cast<char>(flags);
+  appendUint32(out, streamId & 0x7fffffff);
+  if (payload)
+    out.append(payload, length);
+}
@@ -1,7 +1,10 @@
 #include "http/HttpRequest.hpp"
+#include "core/Logger.hpp"
+#include "http/ByteScanner.hpp"
+#include "http/UploadSink.hpp"
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
-#include <iostream>
 #include <sstream>
 #include <strings.h>
 
@@ -10,13 +13,18 @@
  * @brief HTTP request parsing and data extraction
  *
  * This module handles progressive parsing of HTTP requests. Features:
- * - Progressive parsing (can be called multiple times as data arrives)
+ * - Resumable parsing: parse() is fed only the bytes received since the
+ *   previous call and reports how many it consumed, so every byte is
+ *   examined once (headers scanned incrementally, chunked bodies decoded
+ *   chunk by chunk as they arrive)
  * - Request line parsing (method, path, version)
  * - Header extraction with case-insensitive keys
  * - Query string separation from path
  * - URL decoding (%XX sequences and + for spaces in queries)
  * - Cookie parsing
  * - Body parsing (Content-Length and chunked transfer encoding)
+ * - HTTP-date parsing for conditional requests (If-Modified-Since)
+ * - Range header resolution (bytes=a-b, a-, -n lists)
  * - HTTP/1.1 pipelining support via parsed bytes tracking
  *
  * @note Body size limits are enforced in RequestHandler, not here
@@ -31,40 +39,57 @@
  */
 HttpRequest::HttpRequest()
     : _headersComplete(false), _isChunked(false), _keepAlive(false),
-      _isMalformed(false), _parsedBytes(0), _contentLength(-1) {}
+      _isMalformed(false), _complete(false), _parsedBytes(0),
+      _headerCount(0), _targetStart(0), _targetLength(0),
+      _chunkState(CHUNK_SIZE), _chunkRemaining(0),
+      _headersBuilt(false), _cookiesBuilt(false), _bodySize(0),
+      _uploadSink(NULL), _contentLength(-1), _rejectStatus(0) {}
 
 /**
  * @brief Main progressive parsing function
  *
- * Called each time new data arrives. Attempts to parse headers first,
- * then body if headers are complete.
+ * Called with the bytes that arrived since the previous call (or that were
+ * left over from a pipelined request). Consumes what belongs to this
+ * request and stops at its end; getParsedBytes() tells the caller how many
+ * bytes to drop from its buffer. Unconsumed bytes belong to the next
+ * pipelined request.
  *
- * @param rawRequest Accumulated raw data from socket
+ * The call that completes the headers of a request with a body returns
+ * right after them (false), so the caller can attach an upload sink before
+ * any body byte is consumed; it then simply calls parse() again.
+ *
+ * @param data Received bytes not consumed yet
+ * @param length Number of bytes at data
  * @return true if request is complete (headers + body if any)
  * @return false if more data is needed
- *
- * @note Sets _parsedBytes to track consumed bytes for pipelining
  */
-bool HttpRequest::parse(const std::string &rawRequest) {
-  _parsedBytes = 0;
+bool HttpRequest::parse(const char *data, size_t length) {
+  size_t used = 0;
 
-  // Stage 1: Parse headers
+  // Stage 1: Headers
   if (!_headersComplete) {
-    if (!parseHeaders(rawRequest))
-      return false;
+    used += consumeHeaders(data, length);
+    if (_headersComplete && !_isMalformed &&
+        (_isChunked || _contentLength > 0)) {
+      _parsedBytes = static_cast<int>(used);
+      return false; // Body routing is decided by the caller first
+    }
   }
 
-  // If malformed, stop parsing
-  if (_isMalformed)
-    return true;
-
-  // Stage 2: Parse body if needed
-  if (_headersComplete && (_contentLength > 0 || _isChunked)) {
-    if (!parseBody(rawRequest))
-      return false;
+  // Stage 2: Body, if any
+  if (_headersComplete && !_complete) {
+    if (_isMalformed)
+      _complete = true;
+    else if (_isChunked)
+      used += consumeChunked(data + used, length - used);
+    else if (_contentLength > 0)
+      used += consumeBody(data + used, length - used);
+    else
+      _complete = true;
   }
 
-  return true;
+  _parsedBytes = static_cast<int>(used);
+  return _complete;
 }
 
 /**
@@ -75,109 +100,254 @@ bool HttpRequest::parse(const std::string &rawRequest) {
 bool HttpRequest::isMalformed() const { return _isMalformed; }
 
 /**
- * @brief Parses HTTP headers from raw request data
+ * @brief Accumulates header bytes until the blank line is seen
  *
- * Looks for \r\n\r\n to mark end of headers, then parses:
- * - Request line: METHOD PATH?QUERY HTTP/VERSION
- * - Headers: Key: Value pairs
- * - Detects Content-Length and Transfer-Encoding: chunked
- * - Sets keep-alive based on HTTP version and Connection header
- * - Validates Host header for HTTP/1.1
+ * The terminator is searched in the new bytes where they are (plus the
+ * joint with the last 3 bytes already buffered, for a terminator split
+ * across reads), and only the header bytes are copied. Copying the whole
+ * input instead would move every pipelined request behind this one again
+ * for each request: O(n²) over a burst.
  *
- * @param rawRequest Raw request data
- * @return true if headers are complete and parsed
- * @return false if \r\n\r\n not yet received
+ * @return Bytes consumed: everything, or up to and including \r\n\r\n
  */
-bool HttpRequest::parseHeaders(const std::string &rawRequest) {
-  // Look for end of headers
-  size_t headerEnd = rawRequest.find("\r\n\r\n");
-  if (headerEnd == std::string::npos)
-    return false;
+size_t HttpRequest::consumeHeaders(const char *data, size_t length) {
+  size_t oldSize = _headerBuffer.size();
+  size_t used = ByteScanner::npos; // Bytes of data through the terminator
+
+  if (oldSize > 0 && length > 0) {
+    char joint[6];
+    size_t tail = oldSize < 3 ? oldSize : 3;
+    size_t head = length < 3 ? length : 3;
+    std::memcpy(joint, _headerBuffer.data() + oldSize - tail, tail);
+    std::memcpy(joint + tail, data, head);
+    size_t at = ByteScanner::findHeaderEnd(joint, tail + head);
+    if (at != ByteScanner::npos)
+      used = at + 4 - tail;
+  }
+  if (used == ByteScanner::npos) {
+    size_t at = ByteScanner::findHeaderEnd(data, length);
+    if (at == ByteScanner::npos) {
+      _headerBuffer.append(data, length);
+      return length;
+    }
+    used = at + 4;
+  }
 
+  _headerBuffer.append(data, used);
+  _headerBuffer.resize(_headerBuffer.size() - 4); // Slices point into it
   _headersComplete = true;
-  _parsedBytes = headerEnd + 4;
+  parseHeaders();
+  return used;
+}
 
-  std::string headerPart = rawRequest.substr(0, headerEnd);
-  std::istringstream ss(headerPart);
-  std::string line;
+/**
+ * @brief Whether c separates request-line tokens (as operator>> did)
+ */
+static bool isLineSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
 
-  // Parse request line: METHOD-TARGET-VERSION
-  if (!std::getline(ss, line))
-    return false;
+/**
+ * @brief atoi() over a slice that is not NUL-terminated
+ */
+static int sliceToInt(const char *data, size_t length) {
+  size_t i = 0;
+  bool negative = false;
+  if (i < length && (data[i] == '-' || data[i] == '+'))
+    negative = data[i++] == '-';
+  long value = 0;
+  while (i < length && data[i] >= '0' && data[i] <= '9' && value < 0x7fffffff)
+    value = value * 10 + (data[i++] - '0');
+  if (value > 0x7fffffff)
+    value = 0x7fffffff;
+  return static_cast<int>(negative ? -value : value);
+}
 
-  std::istringstream firstLine(line);
-  std::string fullTarget;
-  std::string extra;
-  if (!(firstLine >> _method >> fullTarget >> _version) ||
-      (firstLine >> extra)) {
-    std::cout << "[Debug] Malformed request line: " << line << std::endl;
-    _isMalformed = true;
-    return true;
-  }
+/**
+ * @brief Case-insensitive slice == literal
+ */
+static bool sliceEquals(const char *data, size_t length, const char *literal) {
+  return std::strlen(literal) == length &&
+         strncasecmp(data, literal, length) == 0;
+}
 
-  // Separate PATH and QUERY STRING
-  size_t qpos = fullTarget.find('?');
-  if (qpos != std::string::npos) {
-    _path = _urlDecode(fullTarget.substr(0, qpos), false);
-    _query = _urlDecode(fullTarget.substr(qpos + 1), true);
-  } else {
-    _path = _urlDecode(fullTarget, false);
-    _query.clear();
+/**
+ * @brief Parses the header block in _headerBuffer (request line + fields)
+ *
+ * Parses:
+ * - Request line: METHOD PATH?QUERY HTTP/VERSION
+ * - Headers: Key: Value pairs, recorded as offsets into _headerBuffer
+ * - Detects Content-Length and Transfer-Encoding: chunked
+ * - Sets keep-alive based on HTTP version and Connection header
+ * - Validates Host header for HTTP/1.1
+ *
+ * No per-header strings or map nodes are created: each field is a
+ * HeaderSlice (name/value offsets) in a fixed array, looked up
+ * case-insensitively in place. The buffer is reused across keep-alive
+ * requests, so a steady connection parses headers without allocating.
+ * More than MAX_HEADERS fields mark the request malformed.
+ */
+void HttpRequest::parseHeaders() {
+  const char *buf = _headerBuffer.data();
+  size_t size = _headerBuffer.size();
+
+  size_t lineEnd = ByteScanner::findAny(buf, size, "\n", 1);
+  if (lineEnd == ByteScanner::npos)
+    lineEnd = size;
+  if (!parseRequestLine(lineEnd)) {
+    LOG_DEBUG("Malformed request line: " << _headerBuffer.substr(0, lineEnd));
+    _isMalformed = true;
+    return;
   }
 
   // Set keep-alive default based on HTTP version
   _keepAlive = (_version == "HTTP/1.1");
 
   // Parse remaining headers
-  while (std::getline(ss, line)) {
-    if (line == "\r" || line.empty())
+  size_t pos = lineEnd + 1;
+  while (pos < size) {
+    // One pass per line: stop at the colon or the newline, whichever is
+    // first, then finish the line from the colon
+    size_t colon = ByteScanner::npos;
+    size_t hit = ByteScanner::findAny(buf + pos, size - pos, ":\n", 2);
+    if (hit != ByteScanner::npos && buf[pos + hit] == ':') {
+      colon = pos + hit;
+      hit = ByteScanner::findAny(buf + colon, size - colon, "\n", 1);
+      lineEnd = hit == ByteScanner::npos ? size : colon + hit;
+    } else {
+      lineEnd = hit == ByteScanner::npos ? size : pos + hit;
+    }
+    size_t end = lineEnd;
+    if (end > pos && buf[end - 1] == '\r')
+      --end;
+    if (end == pos)
       break;
 
-    size_t pos = line.find(":");
-    if (pos == std::string::npos)
-      continue;
+    if (colon != ByteScanner::npos) {
+      if (_headerCount == MAX_HEADERS) {
+        LOG_DEBUG("More than " << MAX_HEADERS << " header fields");
+        _isMalformed = true;
+        return;
+      }
+      HeaderSlice &slice = _slices[_headerCount++];
+      slice.name = pos;
+      slice.nameLength = colon - pos;
+
+      // Trim optional whitespace around the value
+      size_t valueStart = slice.name + slice.nameLength + 1;
+      while (valueStart < end &&
+             (buf[valueStart] == ' ' || buf[valueStart] == '\t'))
+        ++valueStart;
+      size_t valueEnd = end;
+      while (valueEnd > valueStart &&
+             (buf[valueEnd - 1] == ' ' || buf[valueEnd - 1] == '\t'))
+        --valueEnd;
+      slice.value = valueStart;
+      slice.valueLength = valueEnd - valueStart;
+      applyHeader(slice);
+    }
+    pos = lineEnd + 1;
+  }
 
-    std::string key = line.substr(0, pos);
-    std::string val = line.substr(pos + 1);
+  // Validate: Host header is mandatory in HTTP/1.1
+  if (_version == "HTTP/1.1" && !findHeader("host", 4)) {
+    LOG_DEBUG("HTTP/1.1 request missing Host header");
+    _isMalformed = true;
+  }
+}
 
-    // Trim leading space and trailing \r
-    if (!val.empty() && val[0] == ' ')
-      val.erase(0, 1);
-    if (!val.empty() && val[val.length() - 1] == '\r')
-      val.erase(val.length() - 1);
+/**
+ * @brief Splits the request line into method, target and version
+ *
+ * @param end Offset of the line's '\n' (or buffer end)
+ * @return false unless there are exactly three tokens
+ */
+bool HttpRequest::parseRequestLine(size_t end) {
+  const char *buf = _headerBuffer.data();
+  size_t start[3];
+  size_t length[3];
+  size_t tokens = 0;
+  size_t pos = 0;
+  while (pos < end) {
+    while (pos < end && isLineSpace(buf[pos]))
+      ++pos;
+    if (pos == end)
+      break;
+    if (tokens == 3)
+      return false; // Extra token
+    start[tokens] = pos;
+    while (pos < end && !isLineSpace(buf[pos]))
+      ++pos;
+    length[tokens] = pos - start[tokens];
+    ++tokens;
+  }
+  if (tokens != 3)
+    return false;
 
-    // Normalize key to lowercase for case-insensitive lookup
-    for (size_t i = 0; i < key.length(); ++i) {
-      if (key[i] >= 'A' && key[i] <= 'Z')
-        key[i] = key[i] - 'A' + 'a';
-    }
+  _method.assign(buf + start[0], length[0]);
+  _version.assign(buf + start[2], length[2]);
+  _targetStart = start[1];
+  _targetLength = length[1];
 
-    _headers[key] = val;
+  // Separate PATH and QUERY STRING
+  const char *target = buf + start[1];
+  const char *query =
+      static_cast<const char *>(std::memchr(target, '?', length[1]));
+  if (query) {
+    size_t pathLength = static_cast<size_t>(query - target);
+    _urlDecode(target, pathLength, false, _path);
+    _urlDecode(query + 1, length[1] - pathLength - 1, true, _query);
+  } else {
+    _urlDecode(target, length[1], false, _path);
+    _query.clear();
+  }
+  return true;
+}
 
-    // Detect Content-Length and Transfer-Encoding
-    if (strcasecmp(key.c_str(), "content-length") == 0)
-      _contentLength = atoi(val.c_str());
-    else if (strcasecmp(key.c_str(), "transfer-encoding") == 0 &&
-             val.find("chunked") != std::string::npos)
+/**
+ * @brief Applies the fields that drive parsing (framing, keep-alive)
+ */
+void HttpRequest::applyHeader(const HeaderSlice &slice) {
+  const char *name = _headerBuffer.data() + slice.name;
+  const char *value = _headerBuffer.data() + slice.value;
+
+  // Detect Content-Length and Transfer-Encoding
+  if (sliceEquals(name, slice.nameLength, "content-length")) {
+    _contentLength = sliceToInt(value, slice.valueLength);
+  } else if (sliceEquals(name, slice.nameLength, "transfer-encoding")) {
+    static const char chunked[] = "chunked";
+    if (std::search(value, value + slice.valueLength, chunked,
+                    chunked + sizeof(chunked) - 1) != value + slice.valueLength)
       _isChunked = true;
-
+  } else if (sliceEquals(name, slice.nameLength, "connection")) {
     // Handle Connection header override
-    if (strcasecmp(key.c_str(), "connection") == 0) {
-      if (strcasecmp(val.c_str(), "close") == 0)
-        _keepAlive = false;
-      else if (strcasecmp(val.c_str(), "keep-alive") == 0)
-        _keepAlive = true;
-    }
+    if (sliceEquals(value, slice.valueLength, "close"))
+      _keepAlive = false;
+    else if (sliceEquals(value, slice.valueLength, "keep-alive"))
+      _keepAlive = true;
   }
+}
 
-  // Validate: Host header is mandatory in HTTP/1.1
-  if (_version == "HTTP/1.1" && _headers.find("host") == _headers.end()) {
-    std::cout << "[Debug] HTTP/1.1 request missing Host header" << std::endl;
-    _isMalformed = true;
+/**
+ * @brief Finds a header field by name without allocating
+ *
+ * Searches from the last field, so a repeated header resolves to its last
+ * occurrence (as the former map insertion did).
+ *
+ * @param name Field name, any case
+ * @param length Length of name
+ * @return Slice of the field, or NULL
+ */
+const HttpRequest::HeaderSlice *HttpRequest::findHeader(const char *name,
+                                                        size_t length) const {
+  const char *buf = _headerBuffer.data();
+  for (size_t i = _headerCount; i > 0; --i) {
+    const HeaderSlice &slice = _slices[i - 1];
+    if (slice.nameLength == length &&
+        strncasecmp(buf + slice.name, name, length) == 0)
+      return &slice;
   }
-
-  _parseCookies();
-  return true;
+  return NULL;
 }
 
 /**
@@ -197,74 +367,77 @@ static int hexVal(char c) {
 }
 
 /**
- * @brief Decodes URL-encoded string
+ * @brief Decodes URL-encoded bytes
  *
  * Converts %XX sequences to their byte values.
  * Optionally converts + to space (for query strings).
  *
- * @param encoded URL-encoded string
+ * @param encoded URL-encoded bytes
+ * @param length Number of bytes at encoded
  * @param plusAsSpace If true, convert + to space (for query strings)
- * @return Decoded string
+ * @param decoded Receives the result (its capacity is reused)
  *
  * @note PATH uses %20 for spaces, QUERY uses + for spaces
  */
-std::string HttpRequest::_urlDecode(const std::string &encoded,
-                                    bool plusAsSpace) const {
-  std::string decoded;
-  decoded.reserve(encoded.size());
-
-  for (size_t i = 0; i < encoded.size(); ++i) {
-    char c = encoded[i];
-    if (c == '%' && i + 2 < encoded.size()) {
-      int highNibble = hexVal(encoded[i + 1]);
-      int lowNibble = hexVal(encoded[i + 2]);
-      if (highNibble >= 0 && lowNibble >= 0) {
-        decoded.push_back(static_cast<char>((highNibble << 4) | lowNibble));
-        i += 2;
-      } else {
-        // Malformed sequence: keep % literal
-        decoded.push_back('%');
-      }
-    } else if (c == '+' && plusAsSpace) {
+void HttpRequest::_urlDecode(const char *encoded, size_t length,
+                             bool plusAsSpace, std::string &decoded) const {
+  decoded.clear();
+  decoded.reserve(length);
+
+  // Copy plain runs in bulk, stopping only at '%' (and '+' in queries)
+  size_t i = 0;
+  while (i < length) {
+    size_t run = ByteScanner::findAny(encoded + i, length - i, "%+",
+                                      plusAsSpace ? 2 : 1);
+    if (run == ByteScanner::npos) {
+      decoded.append(encoded + i, length - i);
+      break;
+    }
+    decoded.append(encoded + i, run);
+    i += run;
+    if (encoded[i] == '+') {
       decoded.push_back(' ');
+      ++i;
+      continue;
+    }
+    int highNibble = i + 2 < length ? hexVal(encoded[i + 1]) : -1;
+    int lowNibble = i + 2 < length ? hexVal(encoded[i + 2]) : -1;
+    if (highNibble >= 0 && lowNibble >= 0) {
+      decoded.push_back(static_cast<char>((highNibble << 4) | lowNibble));
+      i += 3;
     } else {
-      decoded.push_back(c);
+      // Malformed sequence: keep % literal
+      decoded.push_back('%');
+      ++i;
     }
   }
-  return decoded;
 }
 
 /**
- * @brief Parses the request body
- *
- * Handles both Content-Length and chunked transfer encoding.
+ * @brief Appends Content-Length body bytes as they arrive
  *
- * @param rawRequest Raw request data
- * @return true if body is complete
- * @return false if more data needed
+ * @return Bytes consumed (never past the declared length)
  *
  * @note Body size limits are checked in RequestHandler
  */
-bool HttpRequest::parseBody(const std::string &rawRequest) {
-  // Find body start (after \r\n\r\n)
-  size_t bodyStart = rawRequest.find("\r\n\r\n");
-  if (bodyStart == std::string::npos)
-    return false;
-  bodyStart += 4;
-
-  if (_isChunked) {
-    std::string chunkedData = rawRequest.substr(bodyStart);
-    return parseChunkedBody(chunkedData);
-  }
-
-  // Content-Length: wait for all bytes
-  size_t bodyBytes = rawRequest.size() - bodyStart;
-  if (bodyBytes < static_cast<size_t>(_contentLength))
-    return false;
+size_t HttpRequest::consumeBody(const char *data, size_t length) {
+  size_t missing = static_cast<size_t>(_contentLength) - _bodySize;
+  size_t take = length < missing ? length : missing;
+  appendBody(data, take);
+  if (_bodySize == static_cast<size_t>(_contentLength))
+    _complete = true;
+  return take;
+}
 
-  _body = rawRequest.substr(bodyStart, _contentLength);
-  _parsedBytes += _contentLength;
-  return true;
+/**
+ * @brief Stores decoded body bytes in memory or hands them to the sink
+ */
+void HttpRequest::appendBody(const char *data, size_t length) {
+  if (_uploadSink)
+    _uploadSink->write(data, length);
+  else
+    _body.append(data, length);
+  _bodySize += length;
 }
 
 // ==================== GETTERS ====================
@@ -279,9 +452,75 @@ const std::string &HttpRequest::getQuery() const { return _query; }
 
 const std::string &HttpRequest::getVersion() const { return _version; }
 
+/**
+ * @brief Request target exactly as sent (percent-encoding and query kept)
+ *
+ * What a proxy forwards: decoding and re-encoding the path could change
+ * it (e.g. an encoded '/').
+ *
+ * @param length Receives the target length (0 before the request line)
+ * @return Pointer into the header buffer (not NUL-terminated, valid until
+ *         reset())
+ */
+const char *HttpRequest::getTarget(size_t &length) const {
+  length = _targetLength;
+  return _headerBuffer.data() + _targetStart;
+}
+
 const std::string &HttpRequest::getBody() const { return _body; }
 
+/**
+ * @brief Body bytes received so far, also when streamed to an upload sink
+ */
+size_t HttpRequest::getBodySize() const { return _bodySize; }
+
+void HttpRequest::setUploadSink(UploadSink *sink) { _uploadSink = sink; }
+
+UploadSink *HttpRequest::getUploadSink() const { return _uploadSink; }
+
+/**
+ * @brief Completes the request without reading the rest of its body
+ *
+ * The unread body bytes would be taken for the next pipelined request, so
+ * the connection is closed after the response.
+ */
+void HttpRequest::stopReadingBody() {
+  _complete = true;
+  _keepAlive = false;
+}
+
+/**
+ * @brief Completes the request without its body, answered with status
+ *
+ * @param status Error the handler answers instead of processing it
+ */
+void HttpRequest::rejectBody(int status) {
+  _rejectStatus = status;
+  stopReadingBody();
+}
+
+int HttpRequest::getRejectStatus() const { return _rejectStatus; }
+
+void HttpRequest::disableKeepAlive() { _keepAlive = false; }
+
+/**
+ * @brief All headers as a lowercase-keyed map, built on first use
+ *
+ * Only code that needs every field (CGI environment) pays for the map.
+ */
 const std::map<std::string, std::string> &HttpRequest::getHeaders() const {
+  if (!_headersBuilt) {
+    const char *buf = _headerBuffer.data();
+    for (size_t i = 0; i < _headerCount; ++i) {
+      std::string key(buf + _slices[i].name, _slices[i].nameLength);
+      for (size_t k = 0; k < key.length(); ++k) {
+        if (key[k] >= 'A' && key[k] <= 'Z')
+          key[k] = key[k] - 'A' + 'a';
+      }
+      _headers[key].assign(buf + _slices[i].value, _slices[i].valueLength);
+    }
+    _headersBuilt = true;
+  }
   return _headers;
 }
 
@@ -294,6 +533,10 @@ int HttpRequest::getContentLength() const { return _contentLength; }
 int HttpRequest::getParsedBytes() const { return _parsedBytes; }
 
 const std::map<std::string, std::string> &HttpRequest::getCookies() const {
+  if (!_cookiesBuilt) {
+    _parseCookies();
+    _cookiesBuilt = true;
+  }
   return _cookies;
 }
 
@@ -307,8 +550,18 @@ void HttpRequest::reset() {
   _isChunked = false;
   _keepAlive = false;
   _isMalformed = false;
+  _complete = false;
   _parsedBytes = 0;
   _contentLength = -1;
+  _headerBuffer.clear();
+  _headerCount = 0;
+  _targetStart = 0;
+  _targetLength = 0;
+  _headersBuilt = false;
+  _cookiesBuilt = false;
+  _chunkState = CHUNK_SIZE;
+  _chunkLine.clear();
+  _chunkRemaining = 0;
   _method.clear();
   _path.clear();
   _query.clear();
@@ -316,6 +569,9 @@ void HttpRequest::reset() {
   _headers.clear();
   _cookies.clear();
   _body.clear();
+  _bodySize = 0;
+  _uploadSink = NULL;
+  _rejectStatus = 0;
 }
 
 /**
@@ -325,80 +581,157 @@ void HttpRequest::reset() {
  * @return Header value, or empty string if not found
  */
 std::string HttpRequest::getOneHeader(const std::string &key) const {
-  std::string lowerKey = key;
-  for (size_t i = 0; i < lowerKey.length(); ++i) {
-    if (lowerKey[i] >= 'A' && lowerKey[i] <= 'Z')
-      lowerKey[i] = lowerKey[i] - 'A' + 'a';
-  }
-  std::map<std::string, std::string>::const_iterator it =
-      _headers.find(lowerKey);
-  if (it != _headers.end()) {
-    return it->second;
-  }
-  return "";
+  const HeaderSlice *slice = findHeader(key.data(), key.size());
+  if (!slice)
+    return "";
+  return _headerBuffer.substr(slice->value, slice->valueLength);
 }
 
 /**
- * @brief Parses chunked transfer encoding body
+ * @brief Gets a header value without copying it out of the header buffer
  *
- * Format: <size_hex>\r\n<data>\r\n...<0>\r\n\r\n
- *
- * @param chunkedData Raw data after headers
- * @return true if complete (found 0\r\n terminator)
- * @return false if more data needed
+ * @param key Header name (case-insensitive)
+ * @param length Receives the value length
+ * @return Pointer to the value (not NUL-terminated, valid until reset()),
+ *         or NULL if the header is absent
  */
-bool HttpRequest::parseChunkedBody(const std::string &chunkedData) {
-  std::string result;
-  size_t pos = 0;
+const char *HttpRequest::getHeaderValue(const char *key,
+                                        size_t &length) const {
+  const HeaderSlice *slice = findHeader(key, std::strlen(key));
+  if (!slice) {
+    length = 0;
+    return NULL;
+  }
+  length = slice->valueLength;
+  return _headerBuffer.data() + slice->value;
+}
 
-  while (pos < chunkedData.size()) {
-    // Find end of size line
-    size_t lineEnd = chunkedData.find("\r\n", pos);
-    if (lineEnd == std::string::npos) {
-      return false;
-    }
+/**
+ * @brief Number of header fields received (duplicates included)
+ */
+size_t HttpRequest::getHeaderCount() const { return _headerCount; }
 
-    // Extract chunk size (hex)
-    std::string chunkSizeStr = chunkedData.substr(pos, lineEnd - pos);
+/**
+ * @brief Gets one header field without copying it out of the header buffer
+ *
+ * Name as sent by the client (original case); both pointers are not
+ * NUL-terminated and stay valid until reset().
+ *
+ * @param index 0 .. getHeaderCount() - 1, in arrival order
+ */
+void HttpRequest::getHeaderField(size_t index, const char *&name,
+                                 size_t &nameLength, const char *&value,
+                                 size_t &valueLength) const {
+  const HeaderSlice &slice = _slices[index];
+  name = _headerBuffer.data() + slice.name;
+  nameLength = slice.nameLength;
+  value = _headerBuffer.data() + slice.value;
+  valueLength = slice.valueLength;
+}
 
-    // Ignore chunk extensions after ';'
-    size_t semicolon = chunkSizeStr.find(';');
-    if (semicolon != std::string::npos) {
-      chunkSizeStr = chunkSizeStr.substr(0, semicolon);
-    }
+/**
+ * @brief Longest chunk-size or trailer line accepted (extensions included)
+ */
+static const size_t CHUNK_LINE_MAX = 4096;
 
-    // Convert hex to integer
-    char *endPtr;
-    long chunkSize = std::strtol(chunkSizeStr.c_str(), &endPtr, 16);
+/**
+ * @brief Reads the hex size of the next chunk from a size line
+ *
+ * @param line Size line without CRLF, chunk extensions allowed after ';'
+ * @return false if the size is missing, not hex, or absurdly large
+ */
+bool HttpRequest::parseChunkSize(const std::string &line) {
+  size_t end = line.find(';');
+  if (end == std::string::npos)
+    end = line.size();
+  while (end > 0 && (line[end - 1] == ' ' || line[end - 1] == '\t'))
+    --end;
+  if (end == 0 || end > 15) // 15 hex digits keep us far from overflow
+    return false;
 
-    if (endPtr == chunkSizeStr.c_str() || chunkSize < 0) {
-      std::cerr << "❌ [Error] Chunked: invalid size '" << chunkSizeStr << "'\n";
+  size_t size = 0;
+  for (size_t i = 0; i < end; ++i) {
+    int digit = hexVal(line[i]);
+    if (digit < 0)
       return false;
-    }
+    size = size * 16 + static_cast<size_t>(digit);
+  }
+  _chunkRemaining = size;
+  return true;
+}
 
-    // Final chunk (size 0) marks end of body
-    if (chunkSize == 0) {
-      _body = result;
-      _parsedBytes = lineEnd + 4;
-      return true;
+/**
+ * @brief Decodes chunked transfer encoding incrementally
+ *
+ * Format: <size_hex>[;ext]\r\n<data>\r\n ... 0\r\n[trailers]\r\n
+ *
+ * The decoder state (_chunkState, _chunkRemaining, a partial size line)
+ * survives between calls, so data bytes are copied into the body once and
+ * never re-scanned. Trailer fields are consumed and ignored.
+ *
+ * @param data Bytes after the headers not consumed yet
+ * @param length Number of bytes at data
+ * @return Bytes consumed (stops right after the terminating empty line)
+ *
+ * @note A malformed size line or missing CRLF marks the request malformed
+ *       and disables keep-alive
+ */
+size_t HttpRequest::consumeChunked(const char *data, size_t length) {
+  size_t pos = 0;
+  while (pos < length && _chunkState != CHUNK_DONE) {
+    if (_chunkState == CHUNK_DATA) {
+      size_t take = length - pos;
+      if (take > _chunkRemaining)
+        take = _chunkRemaining;
+      appendBody(data + pos, take);
+      pos += take;
+      _chunkRemaining -= take;
+      if (_chunkRemaining == 0)
+        _chunkState = CHUNK_DATA_CRLF;
+      continue;
     }
 
-    // Verify we have enough data
-    size_t dataStart = lineEnd + 2;
-    size_t chunkLen = static_cast<size_t>(chunkSize);
-
-    if (dataStart + chunkLen + 2 > chunkedData.size()) {
-      return false;
+    // Line-oriented states: collect up to '\n'
+    size_t newline = ByteScanner::findAny(data + pos, length - pos, "\n", 1);
+    bool lineDone = newline != ByteScanner::npos;
+    size_t lineEnd = lineDone ? pos + newline : length;
+    _chunkLine.append(data + pos, lineEnd - pos);
+    pos = lineDone ? lineEnd + 1 : length;
+    if (_chunkLine.size() > CHUNK_LINE_MAX) {
+      LOG_WARN("Chunked: line too long");
+      _isMalformed = true;
+      break;
     }
-
-    // Extract chunk data
-    result.append(chunkedData, dataStart, chunkLen);
-
-    // Move to next chunk
-    pos = dataStart + chunkLen + 2;
+    if (!lineDone)
+      break;
+    if (!_chunkLine.empty() && _chunkLine[_chunkLine.size() - 1] == '\r')
+      _chunkLine.erase(_chunkLine.size() - 1);
+
+    if (_chunkState == CHUNK_SIZE) {
+      if (!parseChunkSize(_chunkLine)) {
+        LOG_WARN("Chunked: invalid size '" << _chunkLine << "'");
+        _isMalformed = true;
+        break;
+      }
+      _chunkState = _chunkRemaining == 0 ? CHUNK_TRAILER : CHUNK_DATA;
+    } else if (_chunkState == CHUNK_DATA_CRLF) {
+      if (!_chunkLine.empty()) {
+        LOG_WARN("Chunked: missing CRLF after chunk data");
+        _isMalformed = true;
+        break;
+      }
+      _chunkState = CHUNK_SIZE;
+    } else if (_chunkLine.empty()) { // CHUNK_TRAILER: blank line ends body
+      _chunkState = CHUNK_DONE;
+    }
+    _chunkLine.clear();
   }
 
-  return false;
+  if (_isMalformed)
+    _keepAlive = false; // Framing lost: the next request cannot be found
+  if (_chunkState == CHUNK_DONE || _isMalformed)
+    _complete = true;
+  return pos;
 }
 
 /**
@@ -407,14 +740,14 @@ bool HttpRequest::parseChunkedBody(const std::string &chunkedData) {
  * Populates _cookies map from Cookie header.
  * Format: name1=value1; name2=value2
  */
-void HttpRequest::_parseCookies() {
+void HttpRequest::_parseCookies() const {
   _cookies.clear();
-  std::map<std::string, std::string>::const_iterator it =
-      _headers.find("cookie");
-  if (it == _headers.end())
+  const HeaderSlice *slice = findHeader("cookie", 6);
+  if (!slice)
     return;
 
-  std::string cookieHeader = it->second;
+  std::string cookieHeader =
+      _headerBuffer.substr(slice->value, slice->valueLength);
   std::istringstream ss(cookieHeader);
   std::string item;
   while (std::getline(ss, item, ';')) {
@@ -432,3 +765,161 @@ void HttpRequest::_parseCookies() {
     }
   }
 }
+
+/**
+ * @brief Parses an HTTP-date in the preferred IMF-fixdate format
+ *
+ * Format (RFC 9110 §5.6.7): "Sun, 06 Nov 1994 08:49:37 GMT". The obsolete
+ * RFC 850 and asctime() forms are not accepted; per RFC an invalid date in
+ * a conditional header means the condition is ignored.
+ *
+ * Implemented by hand (days-from-civil) because timegm() and strptime() are
+ * not part of C++98.
+ *
+ * @param value Header value
+ * @return Seconds since the epoch (UTC), or -1 if value is not valid
+ */
+time_t HttpRequest::parseHttpDate(const std::string &value) {
+  static const char *months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                 "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+  // "Sun, 06 Nov 1994 08:49:37 GMT" - fixed positions, 29 characters
+  if (value.size() != 29 || value[3] != ',' || value[4] != ' ' ||
+      value[7] != ' ' || value[11] != ' ' || value[16] != ' ' ||
+      value[19] != ':' || value[22] != ':' || value.compare(25, 4, " GMT") != 0)
+    return -1;
+
+  const int digitPos[] = {5, 6, 12, 13, 14, 15, 17, 18, 20, 21, 23, 24};
+  for (size_t i = 0; i < sizeof(digitPos) / sizeof(digitPos[0]); ++i) {
+    if (value[digitPos[i]] < '0' || value[digitPos[i]] > '9')
+      return -1;
+  }
+
+  int month = -1;
+  for (int i = 0; i < 12; ++i) {
+    if (value.compare(8, 3, months[i]) == 0)
+      month = i + 1;
+  }
+  if (month == -1)
+    return -1;
+
+  long day = std::atol(value.substr(5, 2).c_str());
+  long year = std::atol(value.substr(12, 4).c_str());
+  long hour = std::atol(value.substr(17, 2).c_str());
+  long minute = std::atol(value.substr(20, 2).c_str());
+  long second = std::atol(value.substr(23, 2).c_str());
+  if (day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+    return -1;
+
+  // Days since 1970-01-01 (Howard Hinnant's days_from_civil)
+  long y = year - (month <= 2 ? 1 : 0);
+  long era = (y >= 0 ? y : y - 399) / 400;
+  long yoe = y - era * 400;
+  long mp = (month + 9) % 12;
+  long doy = (153 * mp + 2) / 5 + day - 1;
+  long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  long days = era * 146097 + doe - 719468;
+
+  return static_cast<time_t>(days * 86400 + hour * 3600 + minute * 60 +
+                             second);
+}
+
+/**
+ * @brief Parses a non-empty run of decimal digits into an offset
+ *
+ * @return false on empty input, non-digits or overflow
+ */
+static bool parseOffset(const std::string &str, off_t &out) {
+  if (str.empty())
+    return false;
+  off_t value = 0;
+  for (size_t i = 0; i < str.size(); ++i) {
+    if (str[i] < '0' || str[i] > '9')
+      return false;
+    off_t digit = str[i] - '0';
+    // off_t is 64-bit here (_FILE_OFFSET_BITS=64); stay below its max
+    if (value > (static_cast<off_t>(0x7fffffffffffffffLL) - digit) / 10)
+      return false;
+    value = value * 10 + digit;
+  }
+  out = value;
+  return true;
+}
+
+/**
+ * @brief Resolves the Range header against the entity size
+ *
+ * Syntax (RFC 9110 §14.1.2): "bytes=" followed by a comma list of
+ * "first-last", "first-" or "-suffixLength". Ranges starting past the end
+ * are dropped and "last" is clamped to the entity size.
+ *
+ * The header is ignored (full 200) when it is malformed, uses another unit,
+ * lists more than MAX_RANGES ranges, or the ranges add up to more than the
+ * entity itself - overlapping lists are a cheap amplification attack.
+ *
+ * @param entitySize Size of the selected representation
+ * @param ranges Receives the satisfiable ranges in request order
+ * @return RANGE_NONE, RANGE_SATISFIABLE or RANGE_UNSATISFIABLE
+ */
+HttpRequest::RangeResult
+HttpRequest::parseRange(off_t entitySize,
+                        std::vector<ByteRange> &ranges) const {
+  ranges.clear();
+  std::string value = getOneHeader("Range");
+  if (value.size() < 6 || strncasecmp(value.c_str(), "bytes=", 6) != 0)
+    return RANGE_NONE;
+
+  size_t count = 0;
+  off_t total = 0;
+  size_t pos = 6;
+  while (pos <= value.size()) {
+    size_t comma = value.find(',', pos);
+    if (comma == std::string::npos)
+      comma = value.size();
+    size_t start = value.find_first_not_of(" \t", pos);
+    if (start == std::string::npos || start >= comma) {
+      pos = comma + 1; // Empty list element, allowed by the list syntax
+      continue;
+    }
+    size_t end = value.find_last_not_of(" \t", comma - 1);
+    std::string spec = value.substr(start, end - start + 1);
+    pos = comma + 1;
+
+    if (++count > MAX_RANGES)
+      return RANGE_NONE;
+    size_t dash = spec.find('-');
+    if (dash == std::string::npos)
+      return RANGE_NONE;
+
+    ByteRange range;
+    if (dash == 0) {
+      off_t suffix;
+      if (!parseOffset(spec.substr(1), suffix))
+        return RANGE_NONE;
+      if (suffix == 0 || entitySize == 0)
+        continue; // Valid but unsatisfiable
+      range.first = suffix < entitySize ? entitySize - suffix : 0;
+      range.last = entitySize - 1;
+    } else {
+      if (!parseOffset(spec.substr(0, dash), range.first))
+        return RANGE_NONE;
+      range.last = entitySize - 1;
+      if (dash + 1 < spec.size()) {
+        off_t last;
+        if (!parseOffset(spec.substr(dash + 1), last) || last < range.first)
+          return RANGE_NONE;
+        if (last < range.last)
+          range.last = last;
+      }
+      if (range.first >= entitySize)
+        continue; // Starts past the end
+    }
+
+    total += range.last - range.first + 1;
+    if (total > entitySize)
+      return RANGE_NONE;
+    ranges.push_back(range);
+  }
+  if (count == 0)
+    return RANGE_NONE;
+  return ranges.empty() ? RANGE_UNSATISFIABLE : RANGE_SATISFIABLE;
+}
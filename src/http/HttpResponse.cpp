@@ -1,6 +1,6 @@
 #include "http/HttpResponse.hpp"
+#include <cstring>
 #include <ctime>
-#include <sstream>
 
 /**
  * @file HttpResponse.cpp
@@ -10,9 +10,21 @@
  * It provides methods to:
  * - Set status code and message
  * - Add headers and cookies
- * - Set response body
+ * - Set response body (in memory, a view of caller-owned bytes such as the
+ *   CGI output, or a file-backed range streamed later)
  * - Generate built-in error pages with modern styling
  * - Build the final response string for sending
+ * - Reuse a pre-serialized header block from ResponseCache, so a cache hit
+ *   only appends the Date and Connection lines
+ * - Copy constant preambles instead of formatting them: the "Date:" line
+ *   is rebuilt once per second (tickDate(), driven by the event loop) and
+ *   the status line + "Server:" of every common code is a literal
+ * - Be reused in place for the next request of a connection: reset()
+ *   keeps the header slots, body and header block storage, and
+ *   appendHeaders() serializes into the connection's output string, so
+ *   a steady keep-alive response builds without heap allocations
+ * - Never concatenate headers and body: the connection sends the header
+ *   block, getBodyData() and the segments with one writev()
  *
  * Response structure follows RFC 9110:
  * ```
@@ -38,6 +50,7 @@
  */
 HttpResponse::HttpResponse()
     : _statusCode(200), _statusMessage("OK"), _httpVersion("HTTP/1.1"),
+      _headerCount(0), _bodyView(NULL), _bodyViewLength(0),
       _cgiPending(false) {}
 
 /**
@@ -45,26 +58,165 @@ HttpResponse::HttpResponse()
  */
 HttpResponse::~HttpResponse() {}
 
+/**
+ * @brief Empties a string, giving its storage back only if it is large
+ */
+static void clearKeepingSmall(std::string &text, size_t keep) {
+  if (text.capacity() > keep)
+    std::string().swap(text);
+  else
+    text.clear();
+}
+
+/**
+ * @brief Turns the object back into a fresh 200 OK response
+ *
+ * Equivalent to assigning HttpResponse(), except that header name/value
+ * strings, the body and the prebuilt block keep their capacity (up to
+ * KEEP_CAPACITY), so refilling the response for the next request of the
+ * connection needs no new allocation.
+ */
+void HttpResponse::reset() {
+  _statusCode = 200;
+  _statusMessage = "OK";
+  _httpVersion = "HTTP/1.1";
+  _headerCount = 0;
+  _setCookies.clear();
+  _segments.clear();
+  _cgiPending = false;
+  clearKeepingSmall(_body, KEEP_CAPACITY);
+  clearKeepingSmall(_prebuiltHead, KEEP_CAPACITY);
+  _bodyView = NULL;
+  _bodyViewLength = 0;
+}
+
 // ==================== STATIC HELPERS ====================
 
+/** @brief Precomputed status line + Server line of a common code */
+struct StatusPreamble {
+  int code;
+  const char *reason;
+  const char *bytes; // "HTTP/1.1 <code> <reason>\r\nServer: ...\r\n"
+  size_t length;
+};
+
+#define STATUS_PREAMBLE(code, reason)                                        \
+  {code, reason, "HTTP/1.1 " #code " " reason "\r\nServer: webserv/1.0\r\n",  \
+   sizeof("HTTP/1.1 " #code " " reason "\r\nServer: webserv/1.0\r\n") - 1}
+
+static const StatusPreamble STATUS_PREAMBLES[] = {
+    STATUS_PREAMBLE(200, "OK"),
+    STATUS_PREAMBLE(201, "Created"),
+    STATUS_PREAMBLE(204, "No Content"),
+    STATUS_PREAMBLE(206, "Partial Content"),
+    STATUS_PREAMBLE(301, "Moved Permanently"),
+    STATUS_PREAMBLE(302, "Found"),
+    STATUS_PREAMBLE(304, "Not Modified"),
+    STATUS_PREAMBLE(400, "Bad Request"),
+    STATUS_PREAMBLE(403, "Forbidden"),
+    STATUS_PREAMBLE(404, "Not Found"),
+    STATUS_PREAMBLE(405, "Method Not Allowed"),
+    STATUS_PREAMBLE(413, "Request Entity Too Large"),
+    STATUS_PREAMBLE(416, "Range Not Satisfiable"),
+    STATUS_PREAMBLE(429, "Too Many Requests"),
+    STATUS_PREAMBLE(500, "Internal Server Error"),
+    STATUS_PREAMBLE(501, "Not Implemented"),
+    STATUS_PREAMBLE(504, "Gateway Timeout"),
+    STATUS_PREAMBLE(507, "Insufficient Storage"),
+};
+
+#undef STATUS_PREAMBLE
+
+static const size_t STATUS_PREAMBLE_COUNT =
+    sizeof(STATUS_PREAMBLES) / sizeof(STATUS_PREAMBLES[0]);
+
+/**
+ * @brief Finds the precomputed preamble of a status code
+ *
+ * @return Entry, or NULL for codes outside the table
+ */
+static const StatusPreamble *findPreamble(int code) {
+  for (size_t i = 0; i < STATUS_PREAMBLE_COUNT; ++i) {
+    if (STATUS_PREAMBLES[i].code == code)
+      return &STATUS_PREAMBLES[i];
+  }
+  return NULL;
+}
+
+/** @brief "Date: <IMF-fixdate>\r\n" of g_dateSecond */
+static char g_dateLine[64];
+static size_t g_dateLineLength = 0;
+static time_t g_dateSecond = -1;
+
 /**
- * @brief Generates current date-time in HTTP format (RFC 9110)
+ * @brief Refreshes the cached "Date:" line if the second changed
  *
- * Format: "Day, DD Mon YYYY HH:MM:SS GMT"
- * Example: "Mon, 15 Jan 2024 14:30:00 GMT"
+ * Server::run() calls it with the time it computes after every wait, so
+ * responses of one event loop round share one formatted date. The date may
+ * lag the wall clock by the length of one round, well under a second.
  *
- * @return Date string in HTTP format
+ * @param now Current time
+ */
+void HttpResponse::tickDate(time_t now) {
+  if (now == g_dateSecond)
+    return;
+  g_dateSecond = now;
+  std::memcpy(g_dateLine, "Date: ", 6);
+  size_t length = formatHttpDate(now, g_dateLine + 6, sizeof(g_dateLine) - 8);
+  g_dateLine[6 + length] = '\r';
+  g_dateLine[7 + length] = '\n';
+  g_dateLineLength = length + 8;
+}
+
+/**
+ * @brief Formats a timestamp as an HTTP-date (IMF-fixdate, always GMT)
  *
- * @note Uses gmtime (UTC/GMT) as required by RFC
- * @note The Date header is mandatory in HTTP responses
+ * @param when Seconds since the epoch
+ * @return e.g. "Mon, 15 Jan 2024 14:30:00 GMT"
  */
-static std::string getHttpDate() {
-  time_t currentTime;
-  time(&currentTime);
-  struct tm *timeInfo = gmtime(&currentTime);
+std::string HttpResponse::formatHttpDate(time_t when) {
   char buffer[80];
-  strftime(buffer, 80, "%a, %d %b %Y %H:%M:%S GMT", timeInfo);
-  return std::string(buffer);
+  size_t length = formatHttpDate(when, buffer, sizeof(buffer));
+  return std::string(buffer, length);
+}
+
+/**
+ * @brief Formats a timestamp as an HTTP-date into a caller buffer
+ *
+ * @param when Seconds since the epoch
+ * @param buffer Destination (29 characters + NUL)
+ * @param size Size of buffer
+ * @return Characters written, without the NUL
+ */
+size_t HttpResponse::formatHttpDate(time_t when, char *buffer, size_t size) {
+  struct tm *timeInfo = gmtime(&when);
+  return strftime(buffer, size, "%a, %d %b %Y %H:%M:%S GMT", timeInfo);
+}
+
+/**
+ * @brief Appends a decimal number without a stream or temporary string
+ */
+static void appendNumber(std::string &out, unsigned long long value) {
+  char digits[24];
+  size_t length = 0;
+  do {
+    digits[length++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+  while (length > 0)
+    out += digits[--length];
+}
+
+/**
+ * @brief Maps HTTP status code to standard reason phrase
+ *
+ * @param code HTTP status code (e.g., 200, 404, 500)
+ * @return Standard reason phrase for the code ("Internal Server Error" for
+ *         codes this server does not know)
+ */
+const char *HttpResponse::statusReason(int code) {
+  const StatusPreamble *entry = findPreamble(code);
+  return entry ? entry->reason : "Internal Server Error";
 }
 
 /**
@@ -77,34 +229,7 @@ static std::string getHttpDate() {
  * CGIHandler)
  */
 std::string HttpResponse::getHttpStatusMessage(int code) {
-  switch (code) {
-  case 200:
-    return "OK";
-  case 201:
-    return "Created";
-  case 204:
-    return "No Content";
-  case 301:
-    return "Moved Permanently";
-  case 302:
-    return "Found";
-  case 400:
-    return "Bad Request";
-  case 403:
-    return "Forbidden";
-  case 404:
-    return "Not Found";
-  case 405:
-    return "Method Not Allowed";
-  case 413:
-    return "Request Entity Too Large";
-  case 500:
-    return "Internal Server Error";
-  case 501:
-    return "Not Implemented";
-  default:
-    return "Internal Server Error";
-  }
+  return statusReason(code);
 }
 
 // ==================== SETTERS ====================
@@ -116,10 +241,25 @@ std::string HttpResponse::getHttpStatusMessage(int code) {
  * @param message Status message (e.g., "OK", "Not Found")
  */
 void HttpResponse::setStatus(int code, const std::string &message) {
+  materialize();
   _statusCode = code;
   _statusMessage = message;
 }
 
+/**
+ * @brief Whether a serialized header block has a "\r\n<key>: " line
+ */
+static bool headBlockHas(const std::string &head, const std::string &key) {
+  size_t pos = head.find(key);
+  while (pos != std::string::npos) {
+    if (pos >= 2 && head.compare(pos - 2, 2, "\r\n") == 0 &&
+        head.compare(pos + key.size(), 2, ": ") == 0)
+      return true;
+    pos = head.find(key, pos + 1);
+  }
+  return false;
+}
+
 /**
  * @brief Sets or updates a response header
  *
@@ -127,7 +267,94 @@ void HttpResponse::setStatus(int code, const std::string &message) {
  * @param value Header value (e.g., "text/html")
  */
 void HttpResponse::setHeader(const std::string &key, const std::string &value) {
-  _headers[key] = value;
+  // Headers the cached block does not contain (Connection...) are appended
+  // as-is; overriding one of its own headers needs the full map again.
+  if (!_prebuiltHead.empty() && headBlockHas(_prebuiltHead, key))
+    materialize();
+  headerValue(key) = value;
+}
+
+/**
+ * @brief Sets a header from a character range (e.g. a formatted buffer)
+ *
+ * @param key Header name
+ * @param value First character of the value
+ * @param length Value length
+ */
+void HttpResponse::setHeader(const std::string &key, const char *value,
+                             size_t length) {
+  if (!_prebuiltHead.empty() && headBlockHas(_prebuiltHead, key))
+    materialize();
+  headerValue(key).assign(value, length);
+}
+
+/**
+ * @brief Value slot of a header, inserted in name order if missing
+ *
+ * Fields stay sorted by name (the output order of the former std::map).
+ * Fields past _headerCount are spare slots left by reset(): inserting
+ * swaps the strings one position up instead of constructing new ones, so
+ * their capacity is reused.
+ *
+ * @param key Header name
+ * @return Value to assign (empty if the header was just inserted)
+ */
+std::string &HttpResponse::headerValue(const std::string &key) {
+  size_t pos = 0;
+  while (pos < _headerCount) {
+    int order = _headers[pos].name.compare(key);
+    if (order == 0)
+      return _headers[pos].value;
+    if (order > 0)
+      break;
+    ++pos;
+  }
+  if (_headerCount == _headers.size())
+    _headers.push_back(HeaderField());
+  for (size_t i = _headerCount; i > pos; --i) {
+    _headers[i].name.swap(_headers[i - 1].name);
+    _headers[i].value.swap(_headers[i - 1].value);
+  }
+  ++_headerCount;
+  _headers[pos].name = key;
+  _headers[pos].value.clear();
+  return _headers[pos].value;
+}
+
+/**
+ * @brief Live header field by exact name, or NULL
+ */
+const HttpResponse::HeaderField *
+HttpResponse::findHeader(const std::string &key) const {
+  for (size_t i = 0; i < _headerCount; ++i) {
+    if (_headers[i].name == key)
+      return &_headers[i];
+  }
+  return NULL;
+}
+
+/**
+ * @brief Whether a header was set (exact name, as given to setHeader())
+ */
+bool HttpResponse::hasHeader(const std::string &key) const {
+  return findHeader(key) != NULL;
+}
+
+/**
+ * @brief Value of a header (exact name, as given to setHeader())
+ */
+std::string HttpResponse::getHeader(const std::string &key) const {
+  const HeaderField *field = findHeader(key);
+  return field ? field->value : std::string();
+}
+
+/**
+ * @brief Sets Content-Length from a number
+ */
+void HttpResponse::setLengthHeader(off_t length) {
+  std::string &value = headerValue("Content-Length");
+  value.clear();
+  appendNumber(value, static_cast<unsigned long long>(length));
 }
 
 /**
@@ -150,10 +377,185 @@ void HttpResponse::setCookie(const std::string &cookie) {
  * @note Automatically calculates and sets Content-Length header
  */
 void HttpResponse::setBody(const std::string &body) {
+  materialize();
+  _body = body;
+  _bodyView = NULL;
+  _bodyViewLength = 0;
+  _segments.clear();
+  setLengthHeader(static_cast<off_t>(_body.size()));
+}
+
+/**
+ * @brief Uses bytes owned by the caller as the body (no copy)
+ *
+ * The CGI output already sits in the connection's buffer; the response just
+ * points into it and the connection sends it straight from there.
+ *
+ * @param data First body byte; must stay valid and unchanged until the
+ *        response has been sent
+ * @param length Body length (becomes Content-Length)
+ */
+void HttpResponse::setBodyView(const char *data, size_t length) {
+  materialize();
+  _body.clear();
+  _bodyView = data;
+  _bodyViewLength = length;
+  _segments.clear();
+  setLengthHeader(static_cast<off_t>(length));
+}
+
+/**
+ * @brief Sets a file-backed body (zero-copy delivery)
+ *
+ * Only the headers are serialized by buildHeaders(); ClientConnection then
+ * streams the byte range straight from the file (sendfile() or pread()),
+ * so the file content never has to be held in memory.
+ *
+ * @param file Shared handle of the open file
+ * @param offset First byte of the file to send
+ * @param length Number of bytes to send (becomes Content-Length)
+ * @param map Mapping of the whole file, if the open file cache has one
+ */
+void HttpResponse::setFileBody(const FileHandle &file, off_t offset,
+                               off_t length, const MappedFile &map) {
+  materialize();
+  _body.clear();
+  _bodyView = NULL;
+  _bodyViewLength = 0;
+  _segments.clear();
+  appendBodySegment(file, offset, length, map);
+}
+
+/**
+ * @brief Appends in-memory bytes to a segmented body
+ *
+ * Segments follow _body on the wire; Content-Length always covers both.
+ *
+ * @param data Bytes to send (e.g. a multipart boundary block)
+ */
+void HttpResponse::appendBodySegment(const std::string &data) {
+  materialize();
+  BodySegment segment;
+  segment.data = data;
+  segment.length = static_cast<off_t>(data.size());
+  _segments.push_back(segment);
+  updateSegmentedLength();
+}
+
+/**
+ * @brief Appends a file range to a segmented body (streamed, not loaded)
+ *
+ * @param file Shared handle of the open file
+ * @param offset First byte of the file to send
+ * @param length Number of bytes to send
+ * @param map Mapping of the whole file, if the open file cache has one
+ */
+void HttpResponse::appendBodySegment(const FileHandle &file, off_t offset,
+                                     off_t length, const MappedFile &map) {
+  materialize();
+  BodySegment segment;
+  segment.file = file;
+  segment.map = map;
+  segment.offset = offset;
+  segment.length = length;
+  _segments.push_back(segment);
+  updateSegmentedLength();
+}
+
+/**
+ * @brief Content-Length = in-memory body + every segment
+ */
+void HttpResponse::updateSegmentedLength() {
+  off_t total = static_cast<off_t>(getBodyLength());
+  for (size_t i = 0; i < _segments.size(); ++i)
+    total += _segments[i].length;
+  setLengthHeader(total);
+}
+
+/**
+ * @brief Uses a pre-serialized 200 response from ResponseCache
+ *
+ * buildHeaders() then emits `head` followed by Date, any header set after
+ * this call (typically Connection) and the blank line. Any later change to
+ * the status or to a header contained in `head` first turns the block back
+ * into the regular header map, so callers never see a difference.
+ *
+ * @param head Status line + headers, as returned by buildCacheableHead()
+ * @param body Response body
+ */
+void HttpResponse::usePrebuilt(const std::string &head,
+                               const std::string &body) {
+  _statusCode = 200;
+  _statusMessage = "OK";
+  _headerCount = 0;
+  _setCookies.clear();
+  _segments.clear();
   _body = body;
-  std::ostringstream oss;
-  oss << _body.size();
-  _headers["Content-Length"] = oss.str();
+  _bodyView = NULL;
+  _bodyViewLength = 0;
+  _prebuiltHead = head;
+}
+
+/**
+ * @brief Converts a prebuilt header block back into the header map
+ *
+ * Parses the "Name: value" lines produced by buildCacheableHead(). The
+ * status line and the automatic Server header are regenerated anyway.
+ */
+void HttpResponse::materialize() {
+  if (_prebuiltHead.empty())
+    return;
+  size_t pos = _prebuiltHead.find("\r\n");
+  while (pos != std::string::npos) {
+    size_t start = pos + 2;
+    size_t end = _prebuiltHead.find("\r\n", start);
+    std::string line = _prebuiltHead.substr(
+        start, end == std::string::npos ? std::string::npos : end - start);
+    size_t colon = line.find(": ");
+    if (colon != std::string::npos && line.compare(0, colon, "Server") != 0 &&
+        !findHeader(line.substr(0, colon)))
+      headerValue(line.substr(0, colon)) = line.substr(colon + 2);
+    pos = end;
+  }
+  _prebuiltHead.clear();
+}
+
+/**
+ * @brief Removes the body but keeps every header (incl. Content-Length)
+ *
+ * Used for HEAD: the response must advertise the same headers as GET
+ * without sending (or even reading) the representation.
+ */
+void HttpResponse::clearBody() {
+  _body.clear();
+  _bodyView = NULL;
+  _bodyViewLength = 0;
+  _segments.clear();
+}
+
+/**
+ * @brief Whether body segments (file ranges...) follow the in-memory body
+ */
+bool HttpResponse::hasBodySegments() const { return !_segments.empty(); }
+
+/**
+ * @brief Body segments to stream after buildResponse() output
+ */
+const std::vector<BodySegment> &HttpResponse::getBodySegments() const {
+  return _segments;
+}
+
+/**
+ * @brief Hands the body segments over to the connection that streams them
+ *
+ * Swapping instead of copying keeps both vectors' storage in use from one
+ * response to the next. Headers (Content-Length) are not touched.
+ *
+ * @param segments Receives the segments; its old content ends up here
+ */
+void HttpResponse::takeBodySegments(std::vector<BodySegment> &segments) {
+  segments.swap(_segments);
+  _segments.clear();
 }
 
 /**
@@ -163,6 +565,20 @@ void HttpResponse::setBody(const std::string &body) {
  */
 int HttpResponse::getStatusCode() const { return _statusCode; }
 
+/**
+ * @brief Start of the in-memory body (sent right after the header block)
+ */
+const char *HttpResponse::getBodyData() const {
+  return _bodyView ? _bodyView : _body.data();
+}
+
+/**
+ * @brief Length of the in-memory body (segments not included)
+ */
+size_t HttpResponse::getBodyLength() const {
+  return _bodyView ? _bodyViewLength : _body.size();
+}
+
 /**
  * @brief Sets the CGI pending flag
  *
@@ -180,7 +596,7 @@ bool HttpResponse::isCGIPending() const { return _cgiPending; }
 // ==================== ERROR HANDLING ====================
 
 /**
- * @brief Generates a styled error page for the given status code
+ * @brief Renders the styled built-in error page of a status code
  *
  * Creates a modern, dark-themed HTML error page with:
  * - Gradient background
@@ -188,15 +604,12 @@ bool HttpResponse::isCGIPending() const { return _cgiPending; }
  * - Appropriate icon and message
  * - Back to dashboard link
  *
- * @param code HTTP error code (400, 403, 404, 405, 413, 500)
- *
- * @note Sets Content-Type to text/html
- * @note Sets X-Content-Type-Options: nosniff for security
+ * @param code HTTP error code (400, 403, 404, 405, 413, 416, 429, 500,
+ *        501, 504, 507; anything else gets the 500 page)
+ * @return Page HTML
  */
-void HttpResponse::setErrorResponse(int code) {
-  _httpVersion = "HTTP/1.1";
-  _statusCode = code;
-  _statusMessage = getHttpStatusMessage(code);
+static std::string renderErrorBody(int code) {
+  std::string body;
 
   // Common CSS for all error pages (dark theme)
   std::string css =
@@ -226,69 +639,209 @@ void HttpResponse::setErrorResponse(int code) {
 
   switch (code) {
   case 400:
-    _body = head +
-            "<div class=\"code\">400</div>"
-            "<div class=\"icon\">🚫</div>"
-            "<h1>Bad Request</h1>"
-            "<p>The server could not understand your request.</p>" +
-            foot;
+    body = head +
+           "<div class=\"code\">400</div>"
+           "<div class=\"icon\">🚫</div>"
+           "<h1>Bad Request</h1>"
+           "<p>The server could not understand your request.</p>" +
+           foot;
     break;
   case 403:
-    _body = head +
-            "<div class=\"code\">403</div>"
-            "<div class=\"icon\">🔒</div>"
-            "<h1>Forbidden</h1>"
-            "<p>You don't have permission to access this resource.</p>" +
-            foot;
+    body = head +
+           "<div class=\"code\">403</div>"
+           "<div class=\"icon\">🔒</div>"
+           "<h1>Forbidden</h1>"
+           "<p>You don't have permission to access this resource.</p>" +
+           foot;
     break;
   case 404:
-    _body = head +
-            "<div class=\"code\">404</div>"
-            "<div class=\"icon\">🔍</div>"
-            "<h1>Not Found</h1>"
-            "<p>The page you're looking for doesn't exist.</p>" +
-            foot;
+    body = head +
+           "<div class=\"code\">404</div>"
+           "<div class=\"icon\">🔍</div>"
+           "<h1>Not Found</h1>"
+           "<p>The page you're looking for doesn't exist.</p>" +
+           foot;
     break;
   case 405:
-    _body = head +
-            "<div class=\"code\">405</div>"
-            "<div class=\"icon\">⛔</div>"
-            "<h1>Method Not Allowed</h1>"
-            "<p>This HTTP method is not allowed for this resource.</p>" +
-            foot;
+    body = head +
+           "<div class=\"code\">405</div>"
+           "<div class=\"icon\">⛔</div>"
+           "<h1>Method Not Allowed</h1>"
+           "<p>This HTTP method is not allowed for this resource.</p>" +
+           foot;
     break;
   case 413:
-    _body = head +
-            "<div class=\"code\">413</div>"
-            "<div class=\"icon\">📦</div>"
-            "<h1>Payload Too Large</h1>"
-            "<p>The uploaded file exceeds the maximum size limit (10MB).</p>" +
-            foot;
+    body = head +
+           "<div class=\"code\">413</div>"
+           "<div class=\"icon\">📦</div>"
+           "<h1>Payload Too Large</h1>"
+           "<p>The uploaded file exceeds the maximum size limit (10MB).</p>" +
+           foot;
+    break;
+  case 416:
+    body = head +
+           "<div class=\"code\">416</div>"
+           "<div class=\"icon\">📏</div>"
+           "<h1>Range Not Satisfiable</h1>"
+           "<p>The requested range lies outside the file.</p>" +
+           foot;
+    break;
+  case 429:
+    body = head +
+           "<div class=\"code\">429</div>"
+           "<div class=\"icon\">🚦</div>"
+           "<h1>Too Many Requests</h1>"
+           "<p>Slow down: too many requests in a short time.</p>" +
+           foot;
     break;
   case 501:
-    _body = head +
-            "<div class=\"code\">501</div>"
-            "<div class=\"icon\">🚧</div>"
-            "<h1>Not Implemented</h1>"
-            "<p>This feature is not supported by the server.</p>" +
-            foot;
+    body = head +
+           "<div class=\"code\">501</div>"
+           "<div class=\"icon\">🚧</div>"
+           "<h1>Not Implemented</h1>"
+           "<p>This feature is not supported by the server.</p>" +
+           foot;
+    break;
+  case 504:
+    body = head +
+           "<div class=\"code\">504</div>"
+           "<div class=\"icon\">⏳</div>"
+           "<h1>Gateway Timeout</h1>"
+           "<p>The script did not answer in time.</p>" +
+           foot;
+    break;
+  case 507:
+    body = head +
+           "<div class=\"code\">507</div>"
+           "<div class=\"icon\">💾</div>"
+           "<h1>Insufficient Storage</h1>"
+           "<p>There is no room left on the server for this upload.</p>" +
+           foot;
     break;
   case 500:
   default:
-    _body = head +
-            "<div class=\"code\">500</div>"
-            "<div class=\"icon\">💥</div>"
-            "<h1>Internal Server Error</h1>"
-            "<p>Something went wrong on our end. Please try again later.</p>" +
-            foot;
+    body = head +
+           "<div class=\"code\">500</div>"
+           "<div class=\"icon\">💥</div>"
+           "<h1>Internal Server Error</h1>"
+           "<p>Something went wrong on our end. Please try again later.</p>" +
+           foot;
     break;
   }
 
-  _headers["Content-Type"] = "text/html";
-  _headers["X-Content-Type-Options"] = "nosniff";
-  std::ostringstream length;
-  length << _body.size();
-  _headers["Content-Length"] = length.str();
+  return body;
+}
+
+/**
+ * @brief Built-in error page of a code, rendered on first use
+ *
+ * @param code HTTP error code
+ * @return Page built for code, or the 500 page for codes without one
+ *         (its code member tells them apart)
+ */
+static const PrebuiltPage &builtinErrorPage(int code) {
+  static const int codes[] = {400, 403, 404, 405, 413, 416, 429, 501,
+                              504, 507, 500};
+  static const size_t count = sizeof(codes) / sizeof(codes[0]);
+  static PrebuiltPage pages[count];
+  static bool built = false;
+
+  if (!built) {
+    for (size_t i = 0; i < count; ++i)
+      HttpResponse::preparePage(pages[i], codes[i],
+                                HttpResponse::statusReason(codes[i]),
+                                renderErrorBody(codes[i]));
+    built = true;
+  }
+  for (size_t i = 0; i + 1 < count; ++i) {
+    if (codes[i] == code)
+      return pages[i];
+  }
+  return pages[count - 1];
+}
+
+/**
+ * @brief Renders an error page once: header block + body
+ *
+ * The header block carries the status line, Content-Length, Content-Type
+ * and X-Content-Type-Options, in buildCacheableHead() format.
+ *
+ * @param page Filled in
+ * @param code Status the page is sent with
+ * @param message Reason phrase
+ * @param body Page HTML
+ */
+void HttpResponse::preparePage(PrebuiltPage &page, int code,
+                               const std::string &message,
+                               const std::string &body) {
+  HttpResponse response;
+  response.setStatus(code, message);
+  response.setHeader("Content-Type", "text/html");
+  response.setHeader("X-Content-Type-Options", "nosniff");
+  response.setBodyView(body.data(), body.size());
+  page.code = code;
+  page.message = message;
+  page.head = response.buildCacheableHead();
+  page.body = body;
+}
+
+/**
+ * @brief Sends a pre-rendered error page
+ *
+ * A response without headers of its own (the usual case: the lookup failed
+ * before anything was set) just copies the page's header block and points
+ * at its body. Otherwise the page's headers are merged into the map, as
+ * setHeader() would. Either way no HTML is built.
+ *
+ * @param code Status to send (may differ from page.code, e.g. 502 with the
+ *        500 page)
+ * @param page Page that outlives the response (built-in table or
+ *        ErrorPageCache)
+ */
+void HttpResponse::useErrorPage(int code, const PrebuiltPage &page) {
+  _httpVersion = "HTTP/1.1";
+  _segments.clear(); // An error page replaces any file-backed body
+  _body.clear();
+  _bodyView = page.body.data();
+  _bodyViewLength = page.body.size();
+
+  if (code == page.code && _headerCount == 0 && _setCookies.empty()) {
+    _statusCode = code;
+    _statusMessage = page.message;
+    _prebuiltHead = page.head;
+    return;
+  }
+
+  materialize();
+  _statusCode = code;
+  _statusMessage = code == page.code ? page.message : statusReason(code);
+  size_t pos = page.head.find("\r\n"); // Skip the status line
+  while (pos != std::string::npos) {
+    size_t start = pos + 2;
+    size_t colon = page.head.find(": ", start);
+    pos = page.head.find("\r\n", start);
+    if (colon == std::string::npos || pos == std::string::npos || colon > pos)
+      break;
+    if (page.head.compare(start, colon - start, "Server") != 0)
+      headerValue(page.head.substr(start, colon - start))
+          .assign(page.head, colon + 2, pos - colon - 2);
+  }
+}
+
+/**
+ * @brief Sets the built-in error page of a status code
+ *
+ * The pages are rendered once per process (see builtinErrorPage()), so
+ * an error costs a header block copy.
+ *
+ * @param code HTTP error code (400, 403, 404, 405, 413, 416, 429, 500, 501,
+ *        504, 507)
+ *
+ * @note Sets Content-Type to text/html
+ * @note Sets X-Content-Type-Options: nosniff for security
+ */
+void HttpResponse::setErrorResponse(int code) {
+  useErrorPage(code, builtinErrorPage(code));
 }
 
 // ==================== RESPONSE BUILDER ====================
@@ -300,7 +853,7 @@ void HttpResponse::setErrorResponse(int code) {
  * 1. Status line: "HTTP/1.1 200 OK\r\n"
  * 2. Server header: "Server: webserv/1.0\r\n"
  * 3. Date header: RFC-formatted timestamp
- * 4. User-set headers from _headers map
+ * 4. User-set headers, in alphabetical order
  * 5. Content-Length (if not already set)
  * 6. Set-Cookie headers (if any)
  * 7. Blank line separator
@@ -308,40 +861,125 @@ void HttpResponse::setErrorResponse(int code) {
  *
  * @return Complete HTTP response ready to send
  *
- * @note Headers are output in alphabetical order (std::map behavior)
+ * @note A file-backed body is NOT included - the caller streams it after
+ *       the returned bytes (see hasBodySegments())
  */
 std::string HttpResponse::buildResponse() const {
-  std::ostringstream oss;
+  std::string response;
+  response.reserve(256 + getBodyLength());
+  appendHeaders(response);
+  response.append(getBodyData(), getBodyLength());
+  return response;
+}
+
+/**
+ * @brief Serializes status line and headers, ending with the blank line
+ *
+ * @return Header block ready to send before the body
+ */
+std::string HttpResponse::buildHeaders() const {
+  std::string out;
+  appendHeaders(out);
+  return out;
+}
 
-  // Step 1: Status line
-  oss << _httpVersion << " " << _statusCode << " " << _statusMessage << "\r\n";
+/**
+ * @brief Appends the buildHeaders() bytes to out
+ *
+ * @param out Destination; ClientConnection passes its write buffer, whose
+ *        capacity survives from one response to the next
+ */
+void HttpResponse::appendHeaders(std::string &out) const {
+  if (g_dateSecond == (time_t)-1)
+    tickDate(time(NULL)); // No event loop (tests, benchmarks)
+
+  if (!_prebuiltHead.empty()) {
+    // Cached block + the only lines that differ between requests
+    out += _prebuiltHead;
+  } else {
+    // Steps 1-2: Status line + automatic Server header (RFC-compliant)
+    appendPreamble(out);
+  }
 
-  // Step 2-3: Automatic headers (RFC-compliant)
-  oss << "Server: webserv/1.0\r\n";
-  oss << "Date: " << getHttpDate() << "\r\n";
+  // Step 3: Date (formatted once per second)
+  out.append(g_dateLine, g_dateLineLength);
 
   // Step 4: User-set headers
-  for (std::map<std::string, std::string>::const_iterator it = _headers.begin();
-       it != _headers.end(); ++it) {
-    oss << it->first << ": " << it->second << "\r\n";
+  for (size_t i = 0; i < _headerCount; ++i) {
+    out += _headers[i].name;
+    out += ": ";
+    out += _headers[i].value;
+    out += "\r\n";
   }
 
-  // Step 5: Automatic Content-Length if not manually set
-  if (_headers.find("Content-Length") == _headers.end()) {
-    oss << "Content-Length: " << _body.size() << "\r\n";
+  // Step 5: Automatic Content-Length if not manually set (a 304 has no
+  // body and must not claim an empty representation; a prebuilt block
+  // already carries it; a chunked body is delimited by its last chunk)
+  if (_prebuiltHead.empty() && !findHeader("Content-Length") &&
+      !findHeader("Transfer-Encoding") && _statusCode != 304) {
+    out += "Content-Length: ";
+    appendNumber(out, static_cast<unsigned long long>(getBodyLength()));
+    out += "\r\n";
   }
 
   // Step 6: Set-Cookie headers
   for (std::vector<std::string>::const_iterator it = _setCookies.begin();
        it != _setCookies.end(); ++it) {
-    oss << "Set-Cookie: " << *it << "\r\n";
+    out += "Set-Cookie: ";
+    out += *it;
+    out += "\r\n";
   }
 
   // Step 7: Mandatory blank line separating headers from body
-  oss << "\r\n";
+  out += "\r\n";
+}
 
-  // Step 8: Body
-  oss << _body;
+/**
+ * @brief Serializes the request-independent part of the header block
+ *
+ * Same content as buildHeaders() minus Date, Connection, Set-Cookie and the
+ * final blank line. Stored by ResponseCache and replayed with usePrebuilt().
+ *
+ * @return Status line + "Server" + headers, each line ending in CRLF
+ */
+std::string HttpResponse::buildCacheableHead() const {
+  std::string head;
+  appendPreamble(head);
+  for (size_t i = 0; i < _headerCount; ++i) {
+    if (_headers[i].name != "Connection") {
+      head += _headers[i].name;
+      head += ": ";
+      head += _headers[i].value;
+      head += "\r\n";
+    }
+  }
+  if (!findHeader("Content-Length")) {
+    head += "Content-Length: ";
+    appendNumber(head, static_cast<unsigned long long>(getBodyLength()));
+    head += "\r\n";
+  }
+  return head;
+}
 
-  return oss.str();
-}
\ No newline at end of file
+/**
+ * @brief Appends the status line and the Server line
+ *
+ * Common codes with their standard reason phrase copy a precomputed
+ * literal; anything else (custom reason, other version) is formatted.
+ *
+ * @param out Destination
+ */
+void HttpResponse::appendPreamble(std::string &out) const {
+  const StatusPreamble *entry = findPreamble(_statusCode);
+  if (entry && _statusMessage == entry->reason && _httpVersion == "HTTP/1.1") {
+    out.append(entry->bytes, entry->length);
+    return;
+  }
+  out += _httpVersion;
+  out += ' ';
+  appendNumber(out, static_cast<unsigned long long>(_statusCode));
+  out += ' ';
+  out += _statusMessage;
+  out += "\r\n";
+  out += "Server: webserv/1.0\r\n";
+}
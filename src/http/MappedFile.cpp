@@ -0,0 +1,92 @@
+#include "http/MappedFile.hpp"
+#include <sys/mman.h>
+
+/**
+ * @file MappedFile.cpp
+ * @brief Shared ownership of file mappings for mapped bodies
+ *
+ * Same scheme as FileHandle: a small heap counter shared by every copy,
+ * munmap() exactly once when the last copy is destroyed or reset. The
+ * mapping outlives the fd it was made from.
+ *
+ * @note Not thread-safe - a mapping made on an I/O thread is only copied
+ *       once it was handed to the event loop
+ */
+
+/**
+ * @brief Empty mapping
+ */
+MappedFile::MappedFile() : _data(NULL), _size(0), _refCount(NULL) {}
+
+/**
+ * @brief Maps size bytes of fd, read-only
+ *
+ * The pages are announced as read sequentially and needed soon
+ * (madvise()), so the kernel reads ahead instead of faulting them in one
+ * by one. A failed mmap() leaves the mapping empty (isValid() false).
+ *
+ * @param fd Open regular file (may be closed afterwards)
+ * @param size Bytes to map (the file size, > 0)
+ */
+MappedFile::MappedFile(int fd, size_t size)
+    : _data(NULL), _size(0), _refCount(NULL) {
+  void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED)
+    return;
+#ifdef MADV_SEQUENTIAL
+  madvise(data, size, MADV_SEQUENTIAL);
+#endif
+#ifdef MADV_WILLNEED
+  madvise(data, size, MADV_WILLNEED);
+#endif
+  _data = static_cast<const char *>(data);
+  _size = size;
+  _refCount = new int(1);
+}
+
+MappedFile::MappedFile(const MappedFile &other)
+    : _data(other._data), _size(other._size), _refCount(other._refCount) {
+  if (_refCount)
+    ++*_refCount;
+}
+
+MappedFile &MappedFile::operator=(const MappedFile &other) {
+  if (this != &other && _refCount != other._refCount) {
+    release();
+    _data = other._data;
+    _size = other._size;
+    _refCount = other._refCount;
+    if (_refCount)
+      ++*_refCount;
+  }
+  return *this;
+}
+
+MappedFile::~MappedFile() { release(); }
+
+/**
+ * @brief Drops this reference, unmapping if it was the last one
+ */
+void MappedFile::release() {
+  if (_refCount && --*_refCount == 0) {
+    munmap(const_cast<char *>(_data), _size);
+    delete _refCount;
+  }
+  _data = NULL;
+  _size = 0;
+  _refCount = NULL;
+}
+
+/**
+ * @brief Returns the first mapped byte, or NULL for an empty mapping
+ */
+const char *MappedFile::data() const { return _data; }
+
+size_t MappedFile::size() const { return _size; }
+
+bool MappedFile::isValid() const { return _data != NULL; }
+
+/**
+ * @brief Releases this reference and leaves the mapping empty
+ */
+void MappedFile::reset() { release(); }
@@ -0,0 +1,250 @@
+#include "http/MimeTypes.hpp"
+#include <map>
+
+/**
+ * @file MimeTypes.cpp
+ * @brief Content-Type resolution for static files
+ *
+ * The table is an open-addressing array of fixed-size slots (extension
+ * bytes stored inline, lowercase), at most half full and probed linearly
+ * from an FNV-1a hash of the lowercased extension. A lookup reads the
+ * extension straight out of the path: no substr(), no std::string key.
+ *
+ * Configuration (http context, as nginx):
+ *   types {
+ *       text/html html htm;
+ *       application/wasm wasm;
+ *   }
+ *   types_file /etc/nginx/mime.types;
+ *   default_type application/octet-stream;
+ * Configured types replace the built-in ones as a whole.
+ *
+ * @note Built once per process, before the first request; read-only after
+ */
+
+const uint32_t MimeTypes::NONE;
+const size_t MimeTypes::MAX_EXTENSION;
+
+/** @brief Built-in types: the common web formats (nginx's mime.types) */
+static const char *const BUILTIN_TYPES[][2] = {
+    {"html", "text/html"},
+    {"htm", "text/html"},
+    {"shtml", "text/html"},
+    {"css", "text/css"},
+    {"xml", "text/xml"},
+    {"txt", "text/plain"},
+    {"csv", "text/csv"},
+    {"md", "text/markdown"},
+    {"js", "application/javascript"},
+    {"mjs", "application/javascript"},
+    {"json", "application/json"},
+    {"map", "application/json"},
+    {"webmanifest", "application/manifest+json"},
+    {"wasm", "application/wasm"},
+    {"pdf", "application/pdf"},
+    {"zip", "application/zip"},
+    {"gz", "application/gzip"},
+    {"tar", "application/x-tar"},
+    {"rss", "application/rss+xml"},
+    {"atom", "application/atom+xml"},
+    {"xhtml", "application/xhtml+xml"},
+    {"rtf", "application/rtf"},
+    {"doc", "application/msword"},
+    {"xls", "application/vnd.ms-excel"},
+    {"ppt", "application/vnd.ms-powerpoint"},
+    {"docx", "application/vnd.openxmlformats-officedocument."
+             "wordprocessingml.document"},
+    {"xlsx", "application/vnd.openxmlformats-officedocument."
+             "spreadsheetml.sheet"},
+    {"pptx", "application/vnd.openxmlformats-officedocument."
+             "presentationml.presentation"},
+    {"png", "image/png"},
+    {"jpg", "image/jpeg"},
+    {"jpeg", "image/jpeg"},
+    {"gif", "image/gif"},
+    {"svg", "image/svg+xml"},
+    {"svgz", "image/svg+xml"},
+    {"ico", "image/x-icon"},
+    {"webp", "image/webp"},
+    {"avif", "image/avif"},
+    {"bmp", "image/bmp"},
+    {"tif", "image/tiff"},
+    {"tiff", "image/tiff"},
+    {"woff", "font/woff"},
+    {"woff2", "font/woff2"},
+    {"ttf", "font/ttf"},
+    {"otf", "font/otf"},
+    {"eot", "application/vnd.ms-fontobject"},
+    {"mp3", "audio/mpeg"},
+    {"ogg", "audio/ogg"},
+    {"oga", "audio/ogg"},
+    {"wav", "audio/wav"},
+    {"m4a", "audio/mp4"},
+    {"flac", "audio/flac"},
+    {"mp4", "video/mp4"},
+    {"m4v", "video/mp4"},
+    {"webm", "video/webm"},
+    {"ogv", "video/ogg"},
+    {"mov", "video/quicktime"},
+    {"avi", "video/x-msvideo"},
+    {"mkv", "video/x-matroska"},
+    {"ts", "video/mp2t"},
+    {"m3u8", "application/vnd.apple.mpegurl"},
+};
+
+/**
+ * @brief Built-in table
+ */
+MimeTypes::MimeTypes() : _count(0), _defaultType("application/octet-stream") {
+  std::vector<std::pair<std::string, std::string> > map;
+  for (size_t i = 0; i < sizeof(BUILTIN_TYPES) / sizeof(BUILTIN_TYPES[0]);
+       ++i)
+    map.push_back(std::make_pair(std::string(BUILTIN_TYPES[i][0]),
+                                 std::string(BUILTIN_TYPES[i][1])));
+  build(map);
+}
+
+MimeTypes::~MimeTypes() {}
+
+/**
+ * @brief Uses the types and default_type of the configuration
+ *
+ * Call before the first lookup: references returned earlier do not
+ * survive a rebuild.
+ *
+ * @param config Process configuration (types {} / types_file entries)
+ */
+void MimeTypes::configure(const GlobalConfig &config) {
+  _defaultType = config.getDefaultType();
+  if (!config.getMimeTypes().empty())
+    build(config.getMimeTypes());
+}
+
+/**
+ * @brief FNV-1a of the lowercased extension
+ */
+uint32_t MimeTypes::hashExtension(const char *extension, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; ++i) {
+    unsigned char c = static_cast<unsigned char>(extension[i]);
+    if (c >= 'A' && c <= 'Z')
+      c = static_cast<unsigned char>(c - 'A' + 'a');
+    hash ^= c;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * @brief Fills the table from (extension, type) pairs
+ *
+ * A later pair overrides an earlier one for the same extension. Extensions
+ * longer than MAX_EXTENSION are skipped (lookups never find them anyway).
+ *
+ * @param map Pairs, extensions in any case
+ */
+void MimeTypes::build(
+    const std::vector<std::pair<std::string, std::string> > &map) {
+  std::map<std::string, uint32_t> byExtension;
+  std::map<std::string, uint32_t> typeIndex;
+  _types.clear();
+  for (size_t i = 0; i < map.size(); ++i) {
+    if (map[i].first.empty() || map[i].first.size() > MAX_EXTENSION)
+      continue;
+    std::string extension = map[i].first;
+    for (size_t j = 0; j < extension.size(); ++j)
+      if (extension[j] >= 'A' && extension[j] <= 'Z')
+        extension[j] = static_cast<char>(extension[j] - 'A' + 'a');
+    std::map<std::string, uint32_t>::iterator type =
+        typeIndex.find(map[i].second);
+    if (type == typeIndex.end()) {
+      type = typeIndex
+                 .insert(std::make_pair(map[i].second,
+                                        static_cast<uint32_t>(_types.size())))
+                 .first;
+      _types.push_back(map[i].second);
+    }
+    byExtension[extension] = type->second;
+  }
+
+  size_t capacity = 16;
+  while (capacity < 2 * byExtension.size())
+    capacity *= 2;
+  Slot empty;
+  empty.hash = 0;
+  empty.type = NONE;
+  empty.length = 0;
+  _slots.assign(capacity, empty);
+  _count = byExtension.size();
+  for (std::map<std::string, uint32_t>::const_iterator it =
+           byExtension.begin();
+       it != byExtension.end(); ++it) {
+    uint32_t hash = hashExtension(it->first.data(), it->first.size());
+    size_t slot = hash & (capacity - 1);
+    while (_slots[slot].type != NONE)
+      slot = (slot + 1) & (capacity - 1);
+    _slots[slot].hash = hash;
+    _slots[slot].type = it->second;
+    _slots[slot].length = static_cast<unsigned char>(it->first.size());
+    it->first.copy(_slots[slot].extension, it->first.size());
+  }
+}
+
+/**
+ * @brief Type of an extension, compared case-insensitively
+ *
+ * @param extension Extension bytes, without the dot
+ * @param length Their count
+ * @return Type from the table, or the default type
+ */
+const std::string &MimeTypes::lookupExtension(const char *extension,
+                                              size_t length) const {
+  if (length == 0 || length > MAX_EXTENSION)
+    return _defaultType;
+  uint32_t hash = hashExtension(extension, length);
+  size_t mask = _slots.size() - 1;
+  for (size_t slot = hash & mask; _slots[slot].type != NONE;
+       slot = (slot + 1) & mask) {
+    const Slot &entry = _slots[slot];
+    if (entry.hash != hash || entry.length != length)
+      continue;
+    size_t i = 0;
+    while (i < length) {
+      char c = extension[i];
+      if (c >= 'A' && c <= 'Z')
+        c = static_cast<char>(c - 'A' + 'a');
+      if (c != entry.extension[i])
+        break;
+      ++i;
+    }
+    if (i == length)
+      return _types[entry.type];
+  }
+  return _defaultType;
+}
+
+/**
+ * @brief Type of a file path, from the extension of its last component
+ *
+ * "/a.b/file" has no extension; neither has "/dir/.hidden" nor "file.".
+ */
+const std::string &MimeTypes::lookup(const std::string &path) const {
+  size_t length = path.size();
+  size_t dot = length;
+  for (size_t i = length; i > 0; --i) {
+    char c = path[i - 1];
+    if (c == '/')
+      break;
+    if (c == '.') {
+      dot = i - 1;
+      break;
+    }
+  }
+  if (dot == length || dot == 0 || path[dot - 1] == '/')
+    return _defaultType;
+  return lookupExtension(path.data() + dot + 1, length - dot - 1);
+}
+
+const std::string &MimeTypes::getDefaultType() const { return _defaultType; }
+
+size_t MimeTypes::size() const { return _count; }
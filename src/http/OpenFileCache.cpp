@@ -0,0 +1,476 @@
+#include "http/OpenFileCache.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @file OpenFileCache.cpp
+ * @brief Per-process cache of stat() results, open fds and small files
+ *
+ * A static GET used to cost stat() + open() + fstat() (+ one more stat() for
+ * a directory index) before the first byte went out. With the cache enabled
+ * a hot path is looked up in memory and served with no filesystem syscall:
+ *
+ * - stat() results, positive and (optionally) negative (ENOENT, EACCES...)
+ * - the open fd of larger files, shared through FileHandle so sendfile()
+ *   keeps working while responses are still streaming
+ * - the whole content of files up to CONTENT_MAX bytes
+ * - with open_file_cache_mmap, a mapping of larger files up to that size,
+ *   shared by every response sending it (MappedFile) and dropped with the
+ *   file version
+ * - the MIME type and the gzip / brotli encoded content (filled in once
+ *   by StaticFileHandler, see Compression)
+ *
+ * Entries are revalidated with one stat() every `valid` seconds. If the
+ * inode, size or mtime changed, the cached fd/content is dropped and the
+ * file is reopened on next use. Entries not used for `inactive` seconds are
+ * evicted, and the total count is bounded by `max` (LRU order).
+ *
+ * Configuration (http context, same syntax as nginx):
+ *   open_file_cache max=1000 inactive=20s;
+ *   open_file_cache_valid 30s;
+ *   open_file_cache_errors on;
+ *   open_file_cache_mmap 4m;
+ *
+ * When disabled, lookup() fills a scratch entry on every call, so callers
+ * use the same code path with no caching at all.
+ *
+ * With io_threads, load() runs the same stat() + open() on an I/O thread
+ * and install() brings the result in on the event loop. A result the
+ * cache would not keep (cache off, or an error without
+ * open_file_cache_errors) is handed to the lookups of that path in the
+ * next second only, one per path: a request that looked up a directory
+ * and then its index (or a file and its .gz sibling) on I/O threads finds
+ * both results when its handler runs again.
+ *
+ * @note Single-threaded per process, like the rest of the event loop
+ */
+
+static OpenFileEntry makeEmptyEntry() {
+  OpenFileEntry entry;
+  entry.statError = 0;
+  entry.opened = false;
+  entry.openError = 0;
+  entry.hasContent = false;
+  entry.mime = NULL;
+  entry.validatedAt = 0;
+  entry.lastUsed = 0;
+  return entry;
+}
+
+/**
+ * @brief Disabled cache (max = 0) until configure() is called
+ */
+OpenFileCache::OpenFileCache()
+    : _maxEntries(0), _inactive(60), _valid(60), _cacheErrors(false),
+      _mapMax(0), _hits(0), _misses(0) {}
+
+/**
+ * @brief Destructor - cached FileHandles close their fds with the entries
+ */
+OpenFileCache::~OpenFileCache() {}
+
+/**
+ * @brief Applies open_file_cache settings and drops current entries
+ *
+ * @param maxEntries Maximum cached paths (0 disables the cache)
+ * @param inactive Seconds an unused entry survives
+ * @param valid Seconds between stat() revalidations of an entry
+ * @param errors Whether failed lookups are cached too
+ * @param mapMax Largest file mapped (0 = none)
+ */
+void OpenFileCache::configure(size_t maxEntries, int inactive, int valid,
+                              bool errors, size_t mapMax) {
+  _entries.clear();
+  _lru.clear();
+  _handoffs.clear();
+  _maxEntries = maxEntries;
+  _inactive = inactive;
+  _valid = valid;
+  _cacheErrors = errors;
+  _mapMax = mapMax;
+}
+
+bool OpenFileCache::isEnabled() const { return _maxEntries > 0; }
+
+/**
+ * @brief Largest file mapped by open(): mappings only pay off when cached
+ */
+size_t OpenFileCache::getMapMax() const { return isEnabled() ? _mapMax : 0; }
+
+/**
+ * @brief Runs stat() for path and stores result/errno in entry
+ */
+void OpenFileCache::statInto(const std::string &path, OpenFileEntry &entry,
+                             time_t now) {
+  struct stat st;
+  int error = stat(path.c_str(), &st) == 0 ? 0 : errno;
+  bool changed = error != entry.statError ||
+                 (error == 0 && !sameVersion(st, entry.st));
+
+  entry.statError = error;
+  if (error == 0)
+    entry.st = st;
+  entry.validatedAt = now;
+  if (changed) {
+    entry.opened = false;
+    entry.openError = 0;
+    entry.file.reset();
+    entry.map.reset(); // Unmapped once the responses using it are sent
+    entry.hasContent = false;
+    entry.content.clear();
+    entry.gzip.clear();
+    entry.brotli.clear();
+  }
+}
+
+/**
+ * @brief Whether two stat() results describe the same file version
+ */
+bool OpenFileCache::sameVersion(const struct stat &a,
+                                const struct stat &b) const {
+  return a.st_ino == b.st_ino && a.st_dev == b.st_dev &&
+         a.st_size == b.st_size && a.st_mtime == b.st_mtime &&
+         a.st_mode == b.st_mode;
+}
+
+/**
+ * @brief Marks entry as most recently used
+ */
+void OpenFileCache::touch(OpenFileEntry &entry, time_t now) {
+  entry.lastUsed = now;
+  _lru.splice(_lru.begin(), _lru, entry.lruPos);
+}
+
+/**
+ * @brief Evicts entries (oldest first) unused for more than `inactive`
+ */
+void OpenFileCache::evictExpired(time_t now) {
+  while (!_lru.empty()) {
+    EntryMap::iterator it = _entries.find(_lru.back());
+    if (it == _entries.end() || now - it->second.lastUsed <= _inactive)
+      break;
+    erase(it);
+  }
+}
+
+void OpenFileCache::erase(EntryMap::iterator it) {
+  _lru.erase(it->second.lruPos);
+  _entries.erase(it);
+}
+
+/**
+ * @brief Returns the (possibly cached) stat() view of path
+ *
+ * A fresh entry is returned without touching the filesystem. Stale entries
+ * are revalidated with a single stat().
+ *
+ * @param path Resolved filesystem path
+ * @return Entry valid until the next lookup()/invalidate() call, never NULL
+ */
+OpenFileEntry *OpenFileCache::lookup(const std::string &path) {
+  static OpenFileEntry scratch;
+  time_t now = time(NULL);
+
+  EntryMap::const_iterator handoff = findHandoff(path, now);
+  if (handoff != _handoffs.end()) {
+    scratch = handoff->second; // Callers may open() / annotate their copy
+    return &scratch;
+  }
+
+  if (!isEnabled()) {
+    scratch = makeEmptyEntry();
+    statInto(path, scratch, now);
+    return &scratch;
+  }
+
+  evictExpired(now);
+
+  EntryMap::iterator it = _entries.find(path);
+  if (it != _entries.end()) {
+    OpenFileEntry &entry = it->second;
+    if (now - entry.validatedAt < _valid) {
+      ++_hits;
+      touch(entry, now);
+      return &entry;
+    }
+    ++_misses;
+    statInto(path, entry, now);
+    if (entry.statError != 0 && !_cacheErrors) {
+      scratch = entry;
+      erase(it);
+      return &scratch;
+    }
+    touch(entry, now);
+    return &entry;
+  }
+
+  ++_misses;
+  OpenFileEntry fresh = makeEmptyEntry();
+  statInto(path, fresh, now);
+  if (fresh.statError != 0 && !_cacheErrors) {
+    scratch = fresh;
+    return &scratch;
+  }
+
+  if (_entries.size() >= _maxEntries && !_lru.empty())
+    erase(_entries.find(_lru.back()));
+
+  OpenFileEntry &entry = _entries[path];
+  entry = fresh;
+  _lru.push_front(path);
+  entry.lruPos = _lru.begin();
+  entry.lastUsed = now;
+  return &entry;
+}
+
+/**
+ * @brief Opens the file behind entry once per file version
+ *
+ * Sets openError on failure. On success entry.st is refreshed with fstat()
+ * of the open fd (the exact file that will be sent). Small regular files
+ * are read completely and the fd is released again when caching is on.
+ *
+ * @param entry Entry returned by lookup() for the same path
+ * @param path Resolved filesystem path
+ */
+void OpenFileCache::open(OpenFileEntry &entry, const std::string &path) {
+  if (entry.opened)
+    return;
+  openInto(entry, path, isEnabled(), getMapMax());
+}
+
+/**
+ * @brief open() + fstat() (+ read of a small file, or mmap()) into entry
+ *
+ * @param entry Entry to fill (opened set, openError on failure)
+ * @param path Resolved filesystem path
+ * @param keepContent Keep small files as bytes instead of an fd
+ * @param mapMax Also map regular files above CONTENT_MAX up to this size
+ */
+void OpenFileCache::openInto(OpenFileEntry &entry, const std::string &path,
+                             bool keepContent, size_t mapMax) {
+  int fd = ::open(path.c_str(), openFlags());
+  if (!loadOpened(entry, fd, fd < 0 ? errno : 0, keepContent, mapMax))
+    return;
+
+  std::string content(static_cast<size_t>(entry.st.st_size), '\0');
+  off_t done = 0;
+  while (done < entry.st.st_size) {
+    ssize_t n = pread(fd, &content[done], entry.st.st_size - done, done);
+    if (n <= 0)
+      return; // Keep streaming from the fd instead
+    done += n;
+  }
+  loadContent(entry, content);
+}
+
+/**
+ * O_NONBLOCK: never hang on a FIFO; O_CLOEXEC: cached fds live long and
+ * must not leak into CGI children.
+ */
+int OpenFileCache::openFlags() {
+  int flags = O_RDONLY | O_NONBLOCK | O_CLOEXEC;
+#ifdef O_NOFOLLOW
+  flags |= O_NOFOLLOW; // Security: don't follow symlinks
+#endif
+  return flags;
+}
+
+/**
+ * @brief Starts a detached entry from the stat() of its path
+ *
+ * @param entry Replaced by the result
+ * @param st stat() view (follows symlinks), read if error is 0
+ * @param error errno of the failed stat(), or 0
+ */
+void OpenFileCache::loadStat(OpenFileEntry &entry, const struct stat &st,
+                             int error) {
+  entry = makeEmptyEntry();
+  entry.statError = error;
+  if (error == 0)
+    entry.st = st;
+}
+
+/**
+ * @brief Takes the result of the open() of a regular file into entry
+ *
+ * On success entry.st is refreshed with fstat() of the fd (the exact
+ * file that will be sent), and medium files are mapped.
+ *
+ * @param entry Entry to fill (opened set, openError on failure)
+ * @param fd Opened file, owned by the entry from now on, or -1
+ * @param error errno of the failed open() (fd -1)
+ * @param keepContent Keep small files as bytes instead of an fd
+ * @param mapMax Also map regular files above CONTENT_MAX up to this size
+ * @return true if the file is small: its st.st_size bytes are to be
+ *         read from entry.file and handed to loadContent()
+ */
+bool OpenFileCache::loadOpened(OpenFileEntry &entry, int fd, int error,
+                               bool keepContent, size_t mapMax) {
+  entry.opened = true;
+  entry.openError = 0;
+  entry.file.reset();
+  entry.map.reset();
+  entry.hasContent = false;
+  entry.content.clear();
+  entry.gzip.clear();
+  entry.brotli.clear();
+  if (fd < 0) {
+    entry.openError = error;
+    return false;
+  }
+  FileHandle file(fd);
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    entry.openError = EIO;
+    return false;
+  }
+  entry.st = st;
+  entry.file = file;
+
+  if (!keepContent || !S_ISREG(st.st_mode))
+    return false;
+  if (st.st_size > CONTENT_MAX) {
+    if (static_cast<unsigned long long>(st.st_size) <= mapMax)
+      entry.map = MappedFile(fd, static_cast<size_t>(st.st_size));
+    return false; // The fd stays: ranges, HTTP/2 and TLS read it
+  }
+  return true;
+}
+
+/**
+ * @brief Small file: keep the bytes, not the descriptor
+ *
+ * @param bytes The whole file (swapped into the entry)
+ */
+void OpenFileCache::loadContent(OpenFileEntry &entry, std::string &bytes) {
+  entry.content.swap(bytes);
+  entry.hasContent = true;
+  entry.file.reset();
+}
+
+/**
+ * @brief Drops path from the cache (e.g. after DELETE)
+ */
+void OpenFileCache::invalidate(const std::string &path) {
+  EntryMap::iterator it = _entries.find(path);
+  if (it != _entries.end())
+    erase(it);
+  _handoffs.erase(path);
+}
+
+/**
+ * @brief The installed, uncacheable result waiting for path, if any
+ *
+ * It is meant for the lookups of the request that deferred it, which may
+ * run its handler several times: it goes stale after a second.
+ */
+OpenFileCache::EntryMap::const_iterator
+OpenFileCache::findHandoff(const std::string &path, time_t now) const {
+  EntryMap::const_iterator it = _handoffs.find(path);
+  if (it == _handoffs.end() || now - it->second.validatedAt > 1)
+    return _handoffs.end();
+  return it;
+}
+
+/**
+ * @brief Drops stale handoffs (and their fd references)
+ */
+void OpenFileCache::pruneHandoffs(time_t now) {
+  EntryMap::iterator it = _handoffs.begin();
+  while (it != _handoffs.end()) {
+    if (now - it->second.validatedAt > 1)
+      _handoffs.erase(it++);
+    else
+      ++it;
+  }
+}
+
+/**
+ * @brief Whether path is cached, still valid and (regular file) opened
+ *
+ * @param path Resolved filesystem path
+ */
+bool OpenFileCache::isFresh(const std::string &path) const {
+  if (findHandoff(path, time(NULL)) != _handoffs.end())
+    return true;
+  if (!isEnabled())
+    return false;
+  EntryMap::const_iterator it = _entries.find(path);
+  if (it == _entries.end())
+    return false;
+  const OpenFileEntry &entry = it->second;
+  return time(NULL) - entry.validatedAt < _valid &&
+         (entry.opened || entry.statError != 0 ||
+          !S_ISREG(entry.st.st_mode));
+}
+
+/**
+ * @brief What lookup() followed by open() would find, without the cache
+ *
+ * Touches no member: meant for an I/O thread (see FileLookupTask).
+ *
+ * @param path Resolved filesystem path
+ * @param entry Replaced by the result
+ * @param keepContent Read small files into the entry (cache enabled)
+ * @param mapMax Map larger files up to this size (see getMapMax())
+ */
+void OpenFileCache::load(const std::string &path, OpenFileEntry &entry,
+                         bool keepContent, size_t mapMax) {
+  struct stat st;
+  loadStat(entry, st, stat(path.c_str(), &st) != 0 ? errno : 0);
+  if (entry.statError == 0 && S_ISREG(entry.st.st_mode))
+    openInto(entry, path, keepContent, mapMax);
+}
+
+/**
+ * @brief Brings in an entry filled by load(), as if looked up now
+ *
+ * An entry already cached for the same file version is only revalidated,
+ * so its MIME type and encoded copies are kept.
+ *
+ * @param path Resolved filesystem path
+ * @param loaded Result of load() for path
+ */
+void OpenFileCache::install(const std::string &path,
+                            const OpenFileEntry &loaded) {
+  time_t now = time(NULL);
+  if (!isEnabled() || (loaded.statError != 0 && !_cacheErrors)) {
+    pruneHandoffs(now);
+    if (_handoffs.size() >= HANDOFF_MAX && _handoffs.count(path) == 0)
+      _handoffs.erase(_handoffs.begin());
+    OpenFileEntry &handoff = _handoffs[path];
+    handoff = loaded;
+    handoff.validatedAt = now;
+    return;
+  }
+
+  ++_misses;
+  evictExpired(now);
+  EntryMap::iterator it = _entries.find(path);
+  if (it == _entries.end()) {
+    if (_entries.size() >= _maxEntries && !_lru.empty())
+      erase(_entries.find(_lru.back()));
+    it = _entries.insert(std::make_pair(path, makeEmptyEntry())).first;
+    _lru.push_front(path);
+    it->second.lruPos = _lru.begin();
+  }
+  OpenFileEntry &entry = it->second;
+  bool same = entry.opened && entry.statError == 0 && loaded.statError == 0 &&
+              sameVersion(entry.st, loaded.st);
+  if (!same) {
+    std::list<std::string>::iterator pos = entry.lruPos;
+    entry = loaded;
+    entry.lruPos = pos;
+  }
+  entry.validatedAt = now;
+  touch(entry, now);
+}
+
+size_t OpenFileCache::size() const { return _entries.size(); }
+
+unsigned long OpenFileCache::getHits() const { return _hits; }
+
+unsigned long OpenFileCache::getMisses() const { return _misses; }
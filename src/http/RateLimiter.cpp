@@ -0,0 +1,265 @@
+#include "http/RateLimiter.hpp"
+#include "config/ServerConfig.hpp"
+#include "http/HttpRequest.hpp"
+
+/**
+ * @file RateLimiter.cpp
+ * @brief limit_req: per-key request rate limiting, bounded memory
+ *
+ * Every zone owns two flat arrays sized once from its limit_req_zone
+ * memory:
+ * - buckets: key hash, time of the last request and excess, linked in
+ *   LRU order;
+ * - index: open-addressing table of bucket numbers, twice as many slots
+ *   as buckets, probed linearly from the key hash.
+ * A lookup hashes the key and walks a short probe run; nothing is
+ * allocated per request. A full zone recycles its least recently used
+ * bucket (counted as evicted), so a flood of new keys cannot grow memory;
+ * it only forgets the quietest clients.
+ *
+ * Keys are identified by their 64-bit hash: two keys colliding would share
+ * a bucket, which at that width does not happen in practice.
+ *
+ * @note Single-threaded per process, like the rest of the event loop
+ */
+
+const uint32_t RateLimiter::NONE;
+
+RateLimiter::RateLimiter() {}
+
+RateLimiter::~RateLimiter() {}
+
+/**
+ * @brief Allocates the bucket table and index of every zone
+ *
+ * A bucket and its two index slots take about 40 bytes, so "zone=api:1m"
+ * tracks some 26000 keys at once.
+ *
+ * @param zones limit_req_zone definitions, indexed by LimitReq::zone
+ */
+void RateLimiter::configure(const std::vector<LimitReqZone> &zones) {
+  _zones.clear();
+  _zones.resize(zones.size());
+  for (size_t i = 0; i < zones.size(); ++i) {
+    Zone &zone = _zones[i];
+    zone.config = zones[i];
+    size_t count =
+        zones[i].size / (sizeof(Bucket) + 2 * sizeof(uint32_t));
+    if (count < 1)
+      count = 1;
+    if (count > MAX_BUCKETS)
+      count = MAX_BUCKETS;
+    size_t slots = 2;
+    while (slots < 2 * count)
+      slots *= 2;
+    zone.buckets.resize(count);
+    zone.index.assign(slots, NONE);
+  }
+}
+
+size_t RateLimiter::zoneCount() const { return _zones.size(); }
+
+const LimitReqZone &RateLimiter::getZone(size_t zone) const {
+  return _zones[zone].config;
+}
+
+/**
+ * @brief Slot of key in the index, or the empty slot ending its probe run
+ */
+size_t RateLimiter::findSlot(const Zone &zone, uint64_t key) {
+  size_t mask = zone.index.size() - 1;
+  size_t slot = static_cast<size_t>(key) & mask;
+  while (zone.index[slot] != NONE && zone.buckets[zone.index[slot]].key != key)
+    slot = (slot + 1) & mask;
+  return slot;
+}
+
+/**
+ * @brief Empties an index slot, shifting back the entries probed past it
+ *
+ * Linear probing without tombstones: every later entry of the run whose
+ * home slot is not between the hole and itself moves into the hole, so
+ * lookups never stop early on it.
+ */
+void RateLimiter::removeSlot(Zone &zone, size_t slot) {
+  size_t mask = zone.index.size() - 1;
+  size_t hole = slot;
+  size_t next = slot;
+  for (;;) {
+    zone.index[hole] = NONE;
+    for (;;) {
+      next = (next + 1) & mask;
+      if (zone.index[next] == NONE)
+        return;
+      size_t home = static_cast<size_t>(zone.buckets[zone.index[next]].key) &
+                    mask;
+      bool stays = hole <= next ? (hole < home && home <= next)
+                                : (hole < home || home <= next);
+      if (!stays)
+        break;
+    }
+    zone.index[hole] = zone.index[next];
+    hole = next;
+  }
+}
+
+void RateLimiter::unlink(Zone &zone, uint32_t bucket) {
+  Bucket &entry = zone.buckets[bucket];
+  if (entry.prev != NONE)
+    zone.buckets[entry.prev].next = entry.next;
+  else
+    zone.head = entry.next;
+  if (entry.next != NONE)
+    zone.buckets[entry.next].prev = entry.prev;
+  else
+    zone.tail = entry.prev;
+}
+
+void RateLimiter::pushFront(Zone &zone, uint32_t bucket) {
+  Bucket &entry = zone.buckets[bucket];
+  entry.prev = NONE;
+  entry.next = zone.head;
+  if (zone.head != NONE)
+    zone.buckets[zone.head].prev = bucket;
+  else
+    zone.tail = bucket;
+  zone.head = bucket;
+}
+
+/**
+ * @brief Gives key a bucket: an unused one, else the least recently used
+ *
+ * @param slot Empty slot found for key (recomputed after an eviction,
+ *        which may shift the run)
+ * @return Bucket number, linked at the LRU front
+ */
+uint32_t RateLimiter::acquire(Zone &zone, uint64_t key, size_t slot) {
+  uint32_t bucket;
+  if (zone.used < zone.buckets.size()) {
+    bucket = static_cast<uint32_t>(zone.used++);
+  } else {
+    bucket = zone.tail;
+    unlink(zone, bucket);
+    removeSlot(zone, findSlot(zone, zone.buckets[bucket].key));
+    ++zone.counters.evicted;
+    slot = findSlot(zone, key);
+  }
+  zone.buckets[bucket].key = key;
+  zone.index[slot] = bucket;
+  pushFront(zone, bucket);
+  return bucket;
+}
+
+/**
+ * @brief Accounts one request against its zone's bucket for key
+ *
+ * excess = previous excess - rate * elapsed + 1 request, never below
+ * zero. Over the burst the request is refused and the bucket unchanged;
+ * otherwise the new excess is kept, and unless the location says nodelay
+ * the request waits excess / rate to stay on the rate.
+ *
+ * @param limit limit_req of the location (zone must be valid)
+ * @param key hashKey() of the request's key
+ * @param nowMs Monotonic clock, in milliseconds
+ * @param delayMs Receives the wait, on DELAY
+ * @return PASS, DELAY or REJECT
+ */
+RateLimiter::Result RateLimiter::check(const LimitReq &limit, uint64_t key,
+                                       uint64_t nowMs, uint64_t &delayMs) {
+  Zone &zone = _zones[limit.zone];
+  uint64_t rate = zone.config.rate;
+  size_t slot = findSlot(zone, key);
+  uint32_t bucket = zone.index[slot];
+
+  uint64_t excess = 0; // First request of a key: within the rate
+  if (bucket != NONE) {
+    const Bucket &entry = zone.buckets[bucket];
+    uint64_t elapsed = nowMs > entry.last ? nowMs - entry.last : 0;
+    if (elapsed > 86400000) // A day drains any excess (and avoids overflow)
+      elapsed = 86400000;
+    uint64_t drained = rate * elapsed / 1000;
+    excess = entry.excess + 1000 > drained ? entry.excess + 1000 - drained
+                                           : 0;
+  }
+  if (excess > static_cast<uint64_t>(limit.burst) * 1000) {
+    ++zone.counters.rejected;
+    return REJECT;
+  }
+
+  if (bucket == NONE) {
+    bucket = acquire(zone, key, slot);
+  } else if (bucket != zone.head) {
+    unlink(zone, bucket);
+    pushFront(zone, bucket);
+  }
+  Bucket &entry = zone.buckets[bucket];
+  entry.excess = excess;
+  entry.last = nowMs;
+  if (excess == 0 || limit.nodelay) {
+    ++zone.counters.passed;
+    return PASS;
+  }
+  delayMs = excess * 1000 / rate;
+  ++zone.counters.delayed;
+  return DELAY;
+}
+
+/**
+ * @brief FNV-1a over the key bytes, then a 64-bit finalizer
+ *
+ * The finalizer spreads the low bits, which pick the index slot.
+ */
+uint64_t RateLimiter::hashKey(const void *data, size_t length) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/**
+ * @brief Key of a request in zone: client address, server or header value
+ *
+ * @param zone Zone the location's limit_req points to
+ * @param addr Client IPv4 address
+ * @param server Server block the request was routed to
+ * @param request Parsed request (header keys)
+ * @param key Receives the hashKey() of the key
+ * @return false if a header key is absent (the request is not limited)
+ */
+bool RateLimiter::requestKey(const LimitReqZone &zone, uint32_t addr,
+                             const ServerConfig &server,
+                             const HttpRequest &request, uint64_t &key) {
+  if (zone.key == LimitReqZone::KEY_ADDR) {
+    key = hashKey(&addr, sizeof(addr));
+  } else if (zone.key == LimitReqZone::KEY_SERVER) {
+    const std::vector<std::string> &names = server.getServerNames();
+    int port = server.getListen();
+    key = names.empty() ? hashKey(&port, sizeof(port))
+                        : hashKey(names[0].data(), names[0].size());
+  } else {
+    size_t length;
+    const char *value = request.getHeaderValue(zone.header.c_str(), length);
+    if (!value)
+      return false;
+    key = hashKey(value, length);
+  }
+  return true;
+}
+
+const RateLimiter::Counters &RateLimiter::getCounters(size_t zone) const {
+  return _zones[zone].counters;
+}
+
+size_t RateLimiter::size(size_t zone) const { return _zones[zone].used; }
+
+size_t RateLimiter::capacity(size_t zone) const {
+  return _zones[zone].buckets.size();
+}
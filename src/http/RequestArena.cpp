@@ -0,0 +1,52 @@
+#include "http/RequestArena.hpp"
+
+/**
+ * @file RequestArena.cpp
+ * @brief Scratch storage for the temporaries of one request
+ *
+ * Path resolution (sanitized path, root/alias + path, index file path...)
+ * used to build fresh std::string temporaries for every request, each one a
+ * malloc() as soon as it outgrows the small-string buffer. Handlers now
+ * take their temporaries from the connection's arena: a string handed out
+ * by string() is empty but keeps the capacity it reached on earlier
+ * requests, and ClientConnection hands them all back with a single reset()
+ * once the response is queued. After the first request of a connection the
+ * same slots are reused, so a steady keep-alive GET allocates nothing here.
+ *
+ * Only strings above KEEP_CAPACITY (a very long URL) are given back to the
+ * heap on reset(), so one odd request does not pin its memory.
+ *
+ * @note References from string() stay valid until reset(); the arena is
+ *       owned by one connection and never shared
+ */
+
+RequestArena::RequestArena() : _used(0) {}
+
+RequestArena::~RequestArena() {
+  for (size_t i = 0; i < _strings.size(); ++i)
+    delete _strings[i];
+}
+
+/**
+ * @brief Takes the next free scratch string
+ *
+ * @return Empty string, owned by the arena
+ */
+std::string &RequestArena::string() {
+  if (_used == _strings.size())
+    _strings.push_back(new std::string());
+  std::string &slot = *_strings[_used++];
+  slot.clear();
+  return slot;
+}
+
+/**
+ * @brief Ends the current request: every slot becomes free again
+ */
+void RequestArena::reset() {
+  for (size_t i = 0; i < _used; ++i) {
+    if (_strings[i]->capacity() > KEEP_CAPACITY)
+      std::string().swap(*_strings[i]);
+  }
+  _used = 0;
+}
@@ -1,11 +1,9 @@
 #include "http/RequestHandler.hpp"
 #include "cgi/CGIDetector.hpp"
 #include "cgi/CGIHandler.hpp"
+#include "core/Logger.hpp"
+#include "core/Metrics.hpp"
 #include "network/ClientConnection.hpp"
-#include <fstream>
-#include <iostream>
-#include <sstream>
-#include <sys/stat.h>
 
 /**
  * @file RequestHandler.cpp
@@ -30,99 +28,331 @@
 /**
  * @brief Default constructor
  */
-RequestHandler::RequestHandler() {}
+RequestHandler::RequestHandler()
+    : _errorPages(NULL), _virtualHosts(NULL),
+      _sniServer(static_cast<size_t>(-1)), _routeTime(0),
+      _matchedLocation(NULL), _needsConnection(false), _streamLimiter(NULL),
+      _streamAddr(0) {}
 
 /**
  * @brief Destructor
  */
 RequestHandler::~RequestHandler() {}
 
+/**
+ * @brief Forwards the process-wide static caches to the static handler
+ *
+ * @param fileCache Open file cache owned by the Server (NULL = none)
+ * @param responseCache Serialized response cache (NULL = none)
+ * @param listingCache Autoindex listing cache (NULL = handler-local one)
+ */
+void RequestHandler::setCaches(OpenFileCache *fileCache,
+                               ResponseCache *responseCache,
+                               DirectoryListingCache *listingCache) {
+  _staticHandler.setFileCache(fileCache);
+  _staticHandler.setResponseCache(responseCache);
+  _staticHandler.setListingCache(listingCache);
+}
+
+/**
+ * @brief Forwards the content-coding policy to the static handler
+ *
+ * @param compression Policy owned by the Server (NULL = identity only)
+ */
+void RequestHandler::setCompression(const Compression *compression) {
+  _staticHandler.setCompression(compression);
+}
+
+/**
+ * @brief Forwards the MIME table to the static handler
+ *
+ * @param types Table owned by the Server (NULL = built-in types)
+ */
+void RequestHandler::setMimeTypes(const MimeTypes *types) {
+  _staticHandler.setMimeTypes(types);
+}
+
+/**
+ * @brief Sets the error_page files rendered at load time
+ *
+ * @param errorPages Pages owned by the Server (NULL = built-in pages only)
+ */
+void RequestHandler::setErrorPages(const ErrorPageCache *errorPages) {
+  _errorPages = errorPages;
+}
+
+/**
+ * @brief Sets the server_name table of the connection's listening port
+ *
+ * @param virtualHosts Table owned by the Server (NULL = first server only)
+ */
+void RequestHandler::setVirtualHosts(const VirtualHostTable *virtualHosts) {
+  _virtualHosts = virtualHosts;
+}
+
+/**
+ * @brief Sets the server block chosen by the TLS handshake's SNI name
+ *
+ * @param index Index into the port's blocks (npos = no SNI name sent)
+ */
+void RequestHandler::setSniServer(size_t index) { _sniServer = index; }
+
+/**
+ * @brief Forwards the connection's per-request arena to the static handler
+ *
+ * @param arena Arena reset by the connection between requests (NULL = none)
+ */
+void RequestHandler::setArena(RequestArena *arena) {
+  _staticHandler.setArena(arena);
+}
+
+/**
+ * @brief limit_req zones applied when handleRequest() gets no client
+ *
+ * @param limiter Zones of the process (NULL = not limited)
+ * @param addr Client address, for zones keyed by $binary_remote_addr
+ */
+void RequestHandler::setStreamLimiter(RateLimiter *limiter, uint32_t addr) {
+  _streamLimiter = limiter;
+  _streamAddr = addr;
+}
+
+/**
+ * @brief Accounts a request handled without a connection against limit_req
+ *
+ * Nothing can hold an HTTP/2 stream: within the burst it is answered at
+ * once, as with nodelay, and the excess still drains at the zone's rate,
+ * so only requests over the burst are refused.
+ *
+ * @return true if the request must be answered 429
+ */
+bool RequestHandler::_streamRejected(const HttpRequest &request,
+                                     const LocationConfig &location,
+                                     const ServerConfig &server) {
+  const LimitReq &limit = location.getLimitReq();
+  if (!_streamLimiter || limit.zone < 0 ||
+      static_cast<size_t>(limit.zone) >= _streamLimiter->zoneCount())
+    return false;
+  uint64_t key;
+  if (!RateLimiter::requestKey(_streamLimiter->getZone(limit.zone),
+                               _streamAddr, server, request, key))
+    return false;
+  uint64_t delayMs = 0;
+  return _streamLimiter->check(limit, key, Metrics::now() / 1000000,
+                               delayMs) == RateLimiter::REJECT;
+}
+
+/**
+ * @brief Lets the static handler turn blocking calls into I/O tasks
+ *
+ * @param enabled Set by the connection before each run of a request
+ */
+void RequestHandler::setDeferIo(bool enabled) {
+  _staticHandler.setDeferIo(enabled);
+}
+
+/**
+ * @brief Takes the I/O task the last handleRequest() stopped on
+ *
+ * @return Task to submit (the request runs again once it completes), or
+ *         NULL if the response is complete
+ */
+IoTask *RequestHandler::takeDeferredIo() {
+  return _staticHandler.takeDeferredIo();
+}
+
+/**
+ * @brief Time the last handleRequest() spent routing (Metrics)
+ */
+uint64_t RequestHandler::getRouteTime() const { return _routeTime; }
+
+/**
+ * @brief Location pattern the last handleRequest() routed to
+ *
+ * @return Pattern (valid while the configuration snapshot is held), NULL
+ *         if the request never reached a location
+ */
+const std::string *RequestHandler::getMatchedLocation() const {
+  return _matchedLocation;
+}
+
+/**
+ * @brief Whether the last request was left unanswered for lack of a client
+ *
+ * CGI scripts, FastCGI and proxied requests run asynchronously on the
+ * event loop, tied to a ClientConnection (pipes, timers, cgi_timeout).
+ * Without one (HTTP/2 streams) they are not run at all: running them
+ * synchronously would block every connection of the worker.
+ */
+bool RequestHandler::needsConnection() const { return _needsConnection; }
+
 /**
  * @brief Main request handling function
  *
  * Flow:
- * 1. Check for malformed request → 400
+ * 1. Check for malformed request → 400; metrics_path → metrics
  * 2. Match virtual host (ServerConfig) by Host header
  * 3. Match location (longest prefix match)
- * 4. Check if method is allowed → 405
- * 5. Check body size limit → 413
- * 6. Handle redirects (return directive)
- * 7. Detect and execute CGI if applicable
- * 8. Otherwise delegate to StaticFileHandler
- * 9. Apply custom error pages if needed
+ * 4. limit_req: hold requests over the zone's rate, or refuse them → 429;
+ *    limit_rate: pace the response (HTTP/1.x)
+ * 5. Check if method is allowed → 405
+ * 6. Check body size limit → 413 (or the status of a refused upload)
+ * 7. Handle redirects (return directive)
+ * 8. Forward to a proxy_pass backend (or answer from cgi_cache)
+ * 9. Detect and execute CGI if applicable (or answer from cgi_cache)
+ * 10. Otherwise delegate to StaticFileHandler
+ * 11. Apply custom error pages if needed
  *
  * @param request Parsed HTTP request
  * @param candidateConfigs Server configs for this port
- * @param client Client connection (for async CGI), may be NULL
- * @return HttpResponse ready to send
+ * @param response Response to fill; a fresh or reset() HttpResponse (the
+ *        connection reuses its own, see HttpResponse::reset())
+ * @param client Client connection (for async CGI), may be NULL: CGI,
+ *        FastCGI and proxy locations then answer nothing and set
+ *        needsConnection()
  */
-HttpResponse
-RequestHandler::handleRequest(const HttpRequest &request,
-                              const std::vector<ServerConfig> &candidateConfigs,
-                              ClientConnection *client) {
-  HttpResponse response;
+void RequestHandler::handleRequest(
+    const HttpRequest &request,
+    const std::vector<ServerConfig> &candidateConfigs, HttpResponse &response,
+    ClientConnection *client) {
+  _routeTime = 0;
+  _matchedLocation = NULL;
+  _needsConnection = false;
 
   // Step 1: Check for malformed request
   if (request.isMalformed()) {
-    std::cout << "[Info] Malformed request detected → 400" << std::endl;
+    LOG_DEBUG("Malformed request detected → 400");
     response.setErrorResponse(400);
-    return response;
+    return;
+  }
+
+  // Process-wide endpoint, answered the same on every virtual host
+  if (Metrics::isEndpoint(request.getPath())) {
+    _serveMetrics(request, response);
+    return;
   }
 
   // Step 2: Virtual host matching
+  uint64_t routeStart = Metrics::now();
   const ServerConfig *matchedConfig =
       _matchVirtualHost(request, candidateConfigs);
   if (!matchedConfig) {
-    std::cerr << "❌ [Error] No matching virtual host for: " << request.getPath()
-              << std::endl;
+    LOG_ERROR("No matching virtual host for: " << request.getPath());
     response.setErrorResponse(500);
-    return response;
+    return;
   }
 
   // Step 3: Location matching
   const LocationConfig *matchedLocation =
       _matchLocation(request.getPath(), *matchedConfig);
+  _routeTime = Metrics::now() - routeStart;
   if (!matchedLocation) {
-    std::cout << "[Debug] No location matched → 404" << std::endl;
+    LOG_DEBUG("No location matched → 404");
     _sendError(404, response, *matchedConfig, request);
-    return response;
+    return;
   }
 
   const LocationConfig &location = *matchedLocation;
+  _matchedLocation = &location.getPattern();
 
-  // Step 4: Method validation
+  // Step 4: Rate limiting, before anything is dispatched (HTTP/1.x: the
+  // delay parks the connection), and the bandwidth of the response
+  if (!client && _streamRejected(request, location, *matchedConfig)) {
+    _sendError(429, response, *matchedConfig, request, &location);
+    return;
+  }
+  if (client) {
+    RateLimiter::Result limit =
+        client->checkRateLimit(location, *matchedConfig);
+    if (limit == RateLimiter::DELAY)
+      return; // Runs again once the delay is over
+    if (limit == RateLimiter::REJECT) {
+      _sendError(429, response, *matchedConfig, request, &location);
+      return;
+    }
+    client->setLimitRate(location.getLimitRate());
+  }
+
+  // Step 5: Method validation
   const std::string &method = request.getMethod();
   if (!location.isMethodAllowed(method)) {
     _sendError(405, response, *matchedConfig, request, &location);
-    return response;
+    return;
   }
 
-  // Step 5: Body size limit
-  if (request.getBody().size() > location.getMaxBodySize()) {
+  // Step 6: Body size limit (streamed uploads and unread bodies count too)
+  if (request.getRejectStatus() != 0) {
+    _sendError(request.getRejectStatus(), response, *matchedConfig, request,
+               &location);
+    return;
+  }
+  if (request.getBodySize() > location.getMaxBodySize() ||
+      (request.getContentLength() > 0 &&
+       static_cast<size_t>(request.getContentLength()) >
+           location.getMaxBodySize())) {
     _sendError(413, response, *matchedConfig, request, &location);
-    return response;
+    return;
   }
 
-  // Step 6: Redirects
+  // Step 7: Redirects
   if (location.getReturnCode() != 0) {
     response.setStatus(location.getReturnCode(), "Redirect");
     response.setHeader("Location", location.getReturnUrl());
     _applyConnectionHeader(request, response);
-    return response;
+    return;
+  }
+
+  // Step 8: Reverse proxy (the whole location goes to the backends)
+  if (location.hasProxyPass()) {
+    if (!client) {
+      _needsConnection = true;
+      return;
+    }
+    if (client->lookupCGICache(location, response)) {
+      if (!client->isCacheWaiting())
+        _applyConnectionHeader(request, response);
+      return;
+    }
+    if (client->startProxy(location)) {
+      response.setCGIPending(true);
+      return;
+    }
+    LOG_ERROR("proxy_pass: no backend available for " << request.getPath());
+    _sendError(502, response, *matchedConfig, request, &location);
+    _applyConnectionHeader(request, response);
+    return;
   }
 
-  // Step 7: CGI detection and execution
-  if (CGIDetector::isCGIRequest(request.getPath(), location.getCgiExts())) {
+  // Step 9: CGI detection and execution
+  // With fastcgi_pass, every request of the location (or those matching
+  // cgi_ext, if set) goes to the FastCGI server instead
+  bool isScript =
+      CGIDetector::isCGIRequest(request.getPath(), location.getCgiExts());
+  bool fastcgi = !location.getFastcgiPass().empty() &&
+                 (location.getCgiExts().empty() || isScript);
+  if (isScript || fastcgi) {
+    if (!client) {
+      _needsConnection = true;
+      return;
+    }
     CGIHandler cgiHandler;
 
-    // Check if script file exists BEFORE attempting execution
+    // Check if script file exists BEFORE attempting execution (a FastCGI
+    // server may see another filesystem: it reports missing scripts)
     std::string scriptPath =
         CGIDetector::resolveScriptPath(request.getPath(), location.getRoot());
-    if (access(scriptPath.c_str(), F_OK) != 0) {
-      std::cout << "⚠️ [Warning] CGI script not found: " << scriptPath
-                << std::endl;
+    if (!fastcgi && access(scriptPath.c_str(), F_OK) != 0) {
+      LOG_WARN("CGI script not found: " << scriptPath);
       _sendError(404, response, *matchedConfig, request, &location);
-      return response;
+      return;
+    }
+
+    // cgi_cache: a stored response, or one being produced for another
+    // request, spares starting the script
+    if (client->lookupCGICache(location, response)) {
+      if (!client->isCacheWaiting())
+        _applyConnectionHeader(request, response);
+      return;
     }
 
     // Extract server name from Host header
@@ -136,30 +366,39 @@ RequestHandler::handleRequest(const HttpRequest &request,
     }
     int serverPort = matchedConfig->getListen();
 
-    // Async CGI execution path
-    if (client) {
-      CGIAsyncResult asyncResult =
-          cgiHandler.handleAsync(request, location, serverName, serverPort);
-
-      if (asyncResult.success) {
-        client->startCGI(asyncResult.pipeFd, asyncResult.childPid);
+    // FastCGI: the request goes out on a pooled connection
+    if (fastcgi) {
+      if (client->startFastCGI(location.getFastcgiPass(),
+                               cgiHandler.fastcgiParams(request, location,
+                                                        serverName,
+                                                        serverPort),
+                               request.getBody())) {
         response.setCGIPending(true);
-        return response;
-      } else {
-        std::cerr << "❌ [Error] CGI async execution failed" << std::endl;
-        _sendError(500, response, *matchedConfig, request, &location);
-        _applyConnectionHeader(request, response);
-        return response;
+        return;
       }
+      LOG_ERROR("FastCGI request to " << location.getFastcgiPass()
+                << " failed");
+      _sendError(502, response, *matchedConfig, request, &location);
+      _applyConnectionHeader(request, response);
+      return;
     }
 
-    // Fallback: sync execution (for internal tests)
-    response = cgiHandler.handle(request, location, serverName, serverPort);
-    _applyConnectionHeader(request, response);
-    return response;
+    // Async CGI execution path
+    CGIAsyncResult asyncResult =
+        cgiHandler.handleAsync(request, location, serverName, serverPort);
+    if (!asyncResult.success) {
+      LOG_ERROR("CGI async execution failed");
+      _sendError(500, response, *matchedConfig, request, &location);
+      _applyConnectionHeader(request, response);
+      return;
+    }
+    client->startCGI(asyncResult.pipeFd, asyncResult.childPid,
+                     asyncResult.stdinFd);
+    response.setCGIPending(true);
+    return;
   }
 
-  // Step 8: Static file handling
+  // Step 10: Static file handling
   if (method == "GET") {
     _staticHandler.handleGet(request, response, location);
   } else if (method == "HEAD") {
@@ -172,21 +411,82 @@ RequestHandler::handleRequest(const HttpRequest &request,
     _sendError(405, response, *matchedConfig, request, &location);
   }
 
-  // Step 9: Apply custom error pages if needed
+  // Parked on an I/O thread: nothing to answer until the request reruns
+  if (_staticHandler.hasDeferredIo())
+    return;
+
+  // Step 11: Apply custom error pages if needed
   if (response.getStatusCode() >= 400) {
     _sendError(response.getStatusCode(), response, *matchedConfig, request,
                &location);
   }
 
   _applyConnectionHeader(request, response);
-  return response;
+}
+
+/**
+ * @brief client_max_body_size that applies to a request, at header time
+ *
+ * @param request Request whose headers are complete
+ * @param candidateConfigs Server configs for this port
+ * @return Limit of the matched location (1MB if nothing matches)
+ */
+size_t
+RequestHandler::getBodyLimit(const HttpRequest &request,
+                             const std::vector<ServerConfig> &candidateConfigs) {
+  const ServerConfig *matchedConfig =
+      _matchVirtualHost(request, candidateConfigs);
+  const LocationConfig *location =
+      matchedConfig ? _matchLocation(request.getPath(), *matchedConfig) : NULL;
+  return location ? location->getMaxBodySize() : 1024 * 1024;
+}
+
+/**
+ * @brief Opens a streaming upload sink for a static POST, at header time
+ *
+ * Applies the same routing as handleRequest() (virtual host, location,
+ * method, Content-Length limit, redirect, CGI). Only a request that will
+ * end up in StaticFileHandler::handlePost() gets a sink; everything else
+ * keeps its body in memory and is answered by handleRequest() as before.
+ *
+ * @param request Request whose headers are complete, body not read yet
+ * @param candidateConfigs Server configs for this port
+ * @param status Set when the upload cannot be stored (507: no space): the
+ *        body is then not read, see HttpRequest::rejectBody()
+ * @return Sink owned by the caller, or NULL to buffer the body
+ */
+UploadSink *RequestHandler::openUploadSink(
+    const HttpRequest &request,
+    const std::vector<ServerConfig> &candidateConfigs, int &status) {
+  if (request.isMalformed() || request.getMethod() != "POST")
+    return NULL;
+
+  const ServerConfig *matchedConfig =
+      _matchVirtualHost(request, candidateConfigs);
+  if (!matchedConfig)
+    return NULL;
+  const LocationConfig *location =
+      _matchLocation(request.getPath(), *matchedConfig);
+  if (!location || !location->isMethodAllowed("POST") ||
+      !location->isUploadEnabled() || location->getReturnCode() != 0 ||
+      location->hasProxyPass() ||
+      CGIDetector::isCGIRequest(request.getPath(), location->getCgiExts()))
+    return NULL;
+  if (request.getContentLength() > 0 &&
+      static_cast<size_t>(request.getContentLength()) >
+          location->getMaxBodySize())
+    return NULL; // Answered with 413, nothing to store
+
+  return _staticHandler.openUpload(request, *location, status);
 }
 
 /**
  * @brief Matches virtual host based on Host header
  *
- * Searches candidate configs for one whose server_name matches
- * the Host header. Falls back to first config if no match.
+ * One lookup in the port's VirtualHostTable (exact names, then
+ * "*.domain" wildcards); hosts matching no server_name get the port's
+ * default server. A TLS request without Host goes to the block its SNI
+ * name picked.
  *
  * @param request HTTP request with Host header
  * @param candidateConfigs Configs listening on this port
@@ -197,29 +497,25 @@ const ServerConfig *RequestHandler::_matchVirtualHost(
     const std::vector<ServerConfig> &candidateConfigs) {
   if (candidateConfigs.empty())
     return NULL;
-
-  std::string host = request.getOneHeader("Host");
-  size_t colonPos = host.find(':');
-  if (colonPos != std::string::npos)
-    host = host.substr(0, colonPos);
-
-  for (size_t i = 0; i < candidateConfigs.size(); ++i) {
-    const std::vector<std::string> &serverNames =
-        candidateConfigs[i].getServerNames();
-    for (size_t j = 0; j < serverNames.size(); ++j) {
-      if (serverNames[j] == host) {
-        return &candidateConfigs[i];
-      }
-    }
-  }
-  return &candidateConfigs[0]; // Default to first
+  if (!_virtualHosts)
+    return &candidateConfigs[0];
+
+  // Looked up in place in the header buffer
+  size_t hostLength = 0;
+  const char *host = request.getHeaderValue("Host", hostLength);
+  size_t index = !host && _sniServer < candidateConfigs.size()
+                     ? _sniServer
+                     : _virtualHosts->lookup(host ? host : "", hostLength);
+  return index < candidateConfigs.size() ? &candidateConfigs[index]
+                                         : &candidateConfigs[0];
 }
 
 /**
  * @brief Matches location using longest prefix match
  *
- * Iterates through all locations in the config and finds the one
- * with the longest matching prefix for the request path.
+ * The server's location patterns are compiled into a trie when the
+ * configuration is built (see LocationTrie), so this costs one walk of
+ * the path however many locations the server has.
  *
  * @param path Request URL path
  * @param config Server configuration
@@ -228,21 +524,35 @@ const ServerConfig *RequestHandler::_matchVirtualHost(
 const LocationConfig *
 RequestHandler::_matchLocation(const std::string &path,
                                const ServerConfig &config) {
-  const std::vector<LocationConfig> &locations = config.getLocations();
-  const LocationConfig *matchedLocation = NULL;
-  size_t longestMatch = 0;
-
-  for (size_t i = 0; i < locations.size(); ++i) {
-    const std::string &locationPattern = locations[i].getPattern();
+  return config.matchLocation(path);
+}
 
-    if (path.compare(0, locationPattern.length(), locationPattern) == 0) {
-      if (locationPattern.length() > longestMatch) {
-        longestMatch = locationPattern.length();
-        matchedLocation = &locations[i];
-      }
-    }
+/**
+ * @brief Answers a scrape of metrics_path
+ *
+ * GET / HEAD only (405 otherwise). The page is rendered on each scrape and
+ * never cached.
+ *
+ * @param request HTTP request
+ * @param response HTTP response to populate
+ */
+void RequestHandler::_serveMetrics(const HttpRequest &request,
+                                   HttpResponse &response) {
+  const std::string &method = request.getMethod();
+  if (method != "GET" && method != "HEAD") {
+    response.setErrorResponse(405);
+    response.setHeader("Allow", "GET, HEAD");
+  } else {
+    std::string page;
+    Metrics::render(page);
+    response.setStatus(200, "OK");
+    response.setHeader("Content-Type", "text/plain; version=0.0.4");
+    response.setHeader("Cache-Control", "no-store");
+    response.setBody(page);
+    if (method == "HEAD")
+      response.clearBody(); // Keeps Content-Length
   }
-  return matchedLocation;
+  _applyConnectionHeader(request, response);
 }
 
 /**
@@ -262,11 +572,14 @@ void RequestHandler::_applyConnectionHeader(const HttpRequest &request,
 /**
  * @brief Generates error response with custom page support
  *
- * Tries to load custom error page from:
+ * Uses the custom error page of:
  * 1. Location error_page directive
  * 2. Server error_page directive
  * 3. Falls back to built-in styled error page
  *
+ * Custom pages come pre-rendered from the ErrorPageCache; nothing is read
+ * from disk here.
+ *
  * @param errorCode HTTP error code
  * @param response Response to populate
  * @param config Server configuration for error pages
@@ -277,8 +590,8 @@ void RequestHandler::_sendError(int errorCode, HttpResponse &response,
                                 const ServerConfig &config,
                                 const HttpRequest &request,
                                 const LocationConfig *location) {
-  std::string errorPagePath;
-  std::string rootUsed;
+  const std::string *errorPagePath = NULL;
+  const std::string *rootUsed = NULL;
 
   // Priority 1: Location-level error page
   if (location) {
@@ -286,52 +599,36 @@ void RequestHandler::_sendError(int errorCode, HttpResponse &response,
     std::map<int, std::string>::const_iterator it =
         locErrorPages.find(errorCode);
     if (it != locErrorPages.end()) {
-      errorPagePath = it->second;
-      rootUsed = location->getRoot();
+      errorPagePath = &it->second;
+      rootUsed = &location->getRoot();
     }
   }
 
   // Priority 2: Server-level error page
-  if (errorPagePath.empty()) {
+  if (!errorPagePath) {
     const std::map<int, std::string> &servErrorPages = config.getErrorPages();
     std::map<int, std::string>::const_iterator it =
         servErrorPages.find(errorCode);
     if (it != servErrorPages.end()) {
-      errorPagePath = it->second;
-      rootUsed = config.getRoot();
+      errorPagePath = &it->second;
+      rootUsed = &config.getRoot();
     }
   }
 
-  // Try to load custom error page
-  if (!errorPagePath.empty()) {
-    if (rootUsed.empty())
-      rootUsed = ".";
-    if (rootUsed[rootUsed.size() - 1] == '/')
-      rootUsed.erase(rootUsed.size() - 1);
-
-    std::string separator = (errorPagePath[0] == '/') ? "" : "/";
-    std::string fullPath = rootUsed + separator + errorPagePath;
-
-    struct stat fileStat;
-    if (stat(fullPath.c_str(), &fileStat) == 0 && S_ISREG(fileStat.st_mode)) {
-      std::ifstream file(fullPath.c_str());
-      if (file.is_open()) {
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-
-        response.setStatus(errorCode, "Error");
-        response.setHeader("Content-Type", "text/html");
-        response.setBody(buffer.str());
-        _applyConnectionHeader(request, response);
-        return;
-      }
+  // Custom error page, read when the configuration was loaded
+  if (errorPagePath && _errorPages) {
+    ErrorPageCache::resolvePath(_errorPagePath, *rootUsed, *errorPagePath);
+    const PrebuiltPage *page = _errorPages->find(_errorPagePath, errorCode);
+    if (page) {
+      response.useErrorPage(errorCode, *page);
+      _applyConnectionHeader(request, response);
+      return;
     }
   }
 
   // Fallback: built-in error page
   if (errorCode >= 400) {
-    std::cerr << "⚠️ [Warning] Error " << errorCode
-              << " for: " << request.getPath() << std::endl;
+    LOG_WARN("Error " << errorCode << " for: " << request.getPath());
   }
   response.setErrorResponse(errorCode);
   _applyConnectionHeader(request, response);
@@ -0,0 +1,124 @@
+#include "http/ResponseCache.hpp"
+
+/**
+ * @file ResponseCache.cpp
+ * @brief Pre-serialized responses for small, frequently requested files
+ *
+ * Serving a cached small file still meant rebuilding the status line, the
+ * Server header and the whole header map through an ostringstream on every
+ * request. This cache keeps the finished header block and the body of a
+ * 200 response, keyed by resolved path. On a hit only the per-request lines
+ * (Date, Connection) are appended - see HttpResponse::usePrebuilt().
+ *
+ * Invalidation: every entry remembers the device, inode, size, mtime and
+ * mode of the file it was built from. find() compares them with the
+ * caller's current stat() view (the open file cache's, when enabled) and
+ * drops the entry on any difference, so edits and chmods take effect.
+ *
+ * Memory: head + body bytes of all entries stay below the configured
+ * budget (response_cache_size), evicting least recently used entries.
+ *
+ * @note Single-threaded per process, like the rest of the event loop
+ */
+
+ResponseCache::ResponseCache() : _budget(0), _used(0), _hits(0), _misses(0) {}
+
+ResponseCache::~ResponseCache() {}
+
+/**
+ * @brief Sets the memory budget and drops current entries
+ *
+ * @param budgetBytes Max bytes held (0 disables the cache)
+ */
+void ResponseCache::configure(size_t budgetBytes) {
+  _entries.clear();
+  _lru.clear();
+  _used = 0;
+  _budget = budgetBytes;
+}
+
+bool ResponseCache::isEnabled() const { return _budget > 0; }
+
+void ResponseCache::erase(EntryMap::iterator it) {
+  _used -= it->second.head.size() + it->second.body.size();
+  _lru.erase(it->second.lruPos);
+  _entries.erase(it);
+}
+
+/**
+ * @brief Looks up the serialized response of path
+ *
+ * @param path Resolved filesystem path
+ * @param st Current stat() view of the file
+ * @return Entry (valid until the next store/invalidate), or NULL on miss
+ */
+const CachedResponse *ResponseCache::find(const std::string &path,
+                                          const struct stat &st) {
+  EntryMap::iterator it = _entries.find(path);
+  if (it == _entries.end()) {
+    ++_misses;
+    return NULL;
+  }
+  CachedResponse &entry = it->second;
+  if (entry.dev != st.st_dev || entry.ino != st.st_ino ||
+      entry.size != st.st_size || entry.mtime != st.st_mtime ||
+      entry.mode != st.st_mode) {
+    erase(it); // File changed since the response was built
+    ++_misses;
+    return NULL;
+  }
+  ++_hits;
+  _lru.splice(_lru.begin(), _lru, entry.lruPos);
+  return &entry;
+}
+
+/**
+ * @brief Stores a serialized response, evicting LRU entries to fit
+ *
+ * Responses larger than a quarter of the budget are not cached, so one big
+ * file cannot flush every other entry.
+ *
+ * @param path Resolved filesystem path
+ * @param st stat() of the file the response was built from
+ * @param head Header block without Date/Connection and final CRLF
+ * @param body Response body
+ */
+void ResponseCache::store(const std::string &path, const struct stat &st,
+                          const std::string &head, const std::string &body) {
+  size_t cost = head.size() + body.size();
+  if (!isEnabled() || cost > _budget / 4)
+    return;
+
+  invalidate(path);
+  while (_used + cost > _budget && !_lru.empty())
+    erase(_entries.find(_lru.back()));
+
+  CachedResponse &entry = _entries[path];
+  entry.dev = st.st_dev;
+  entry.ino = st.st_ino;
+  entry.size = st.st_size;
+  entry.mtime = st.st_mtime;
+  entry.mode = st.st_mode;
+  entry.head = head;
+  entry.body = body;
+  _lru.push_front(path);
+  entry.lruPos = _lru.begin();
+  _used += cost;
+}
+
+/**
+ * @brief Drops path (e.g. after DELETE)
+ */
+void ResponseCache::invalidate(const std::string &path) {
+  EntryMap::iterator it = _entries.find(path);
+  if (it != _entries.end())
+    erase(it);
+}
+
+size_t ResponseCache::size() const { return _entries.size(); }
+
+size_t ResponseCache::getUsedBytes() const { return _used; }
+
+unsigned long ResponseCache::getHits() const { return _hits; }
+
+unsigned long ResponseCache::getMisses() const { return _misses; }
@@ -1,6 +1,11 @@
 #include "http/StaticFileHandler.hpp"
+#include "core/Logger.hpp"
 #include "http/Autoindex.hpp"
+#include "http/OpenFileCache.hpp"
+#include "http/ResponseCache.hpp"
+#include "http/UploadSink.hpp"
 #include <algorithm>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
@@ -8,7 +13,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <fstream>
-#include <iostream>
+#include <iomanip>
 #include <sstream>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -20,118 +25,190 @@
  * This module handles all filesystem interactions for the web server:
  * - GET: Serve files and directory listings
  * - HEAD: Return headers without body
- * - POST: Handle file uploads
+ * - POST: Handle file uploads (streamed to disk while the body arrives)
  * - DELETE: Remove files
  *
  * Key features:
- * - MIME type detection by file extension
+ * - MIME type detection by file extension (process-wide MimeTypes table)
  * - Path traversal protection via sanitization
  * - Root/Alias path resolution (Nginx-style)
  * - Autoindex directory listing
  * - Secure file operations (O_NOFOLLOW, fsync)
+ * - Zero-copy file delivery: files become file-backed bodies that the
+ *   connection streams with sendfile(), never read into memory here
+ * - Optional open_file_cache: stat()/open() results, small file contents
+ *   and MIME types of hot paths are reused across requests
+ * - Optional response cache: small files are answered with a pre-serialized
+ *   header block + body (only Date/Connection are added per request)
+ * - Validators (ETag, Last-Modified) and conditional GET: If-None-Match /
+ *   If-Modified-Since answered with a body-less 304
+ * - Range / If-Range: 206 Partial Content with one range or a
+ *   multipart/byteranges body, file parts still streamed with sendfile()
+ * - Path temporaries (sanitized path, filesystem path, index path) come
+ *   from the connection's RequestArena and validators are formatted in
+ *   stack buffers, so a cached GET does not touch the heap
+ * - Optional io_threads: a path that is not cached, a directory to scan,
+ *   an upload fsync() or a DELETE becomes an IoTask (see FileTasks) and
+ *   the handler returns at once; the connection parks until the task is
+ *   done and the request is handled again, now without blocking
  *
  * @see Autoindex for directory listing generation
  * @see RequestHandler for routing to this handler
  */
 
 /**
- * @brief Constructor - initializes MIME type mappings
+ * @brief Constructor - no caches shared yet
  */
-StaticFileHandler::StaticFileHandler() { _initMimeTypes(); }
+StaticFileHandler::StaticFileHandler()
+    : _mimeTypes(NULL), _fileCache(NULL), _responseCache(NULL),
+      _listingCache(NULL), _compression(NULL), _arena(NULL), _deferIo(false),
+      _deferred(NULL) {
+  _outcome.ready = false;
+  _outcome.value = 0;
+}
+
+/**
+ * @brief Destructor - drops a task that was never submitted
+ */
+StaticFileHandler::~StaticFileHandler() { delete _deferred; }
+
+/**
+ * @brief Uses the process-wide open file cache (NULL = no caching)
+ *
+ * @param cache Cache owned by the Server, outlives this handler
+ */
+void StaticFileHandler::setFileCache(OpenFileCache *cache) {
+  _fileCache = cache;
+}
 
 /**
- * @brief Destructor
+ * @brief Uses the process-wide serialized response cache (NULL = none)
+ *
+ * @param cache Cache owned by the Server, outlives this handler
  */
-StaticFileHandler::~StaticFileHandler() {}
+void StaticFileHandler::setResponseCache(ResponseCache *cache) {
+  _responseCache = cache;
+}
 
 /**
- * @brief Initializes the MIME type lookup table
+ * @brief Uses the process-wide autoindex listing cache (NULL = private one)
+ *
+ * @param cache Cache owned by the Server, outlives this handler
  */
-void StaticFileHandler::_initMimeTypes() {
-  _mimeTypes["html"] = "text/html";
-  _mimeTypes["css"] = "text/css";
-  _mimeTypes["js"] = "application/javascript";
-  _mimeTypes["png"] = "image/png";
-  _mimeTypes["jpg"] = "image/jpeg";
-  _mimeTypes["jpeg"] = "image/jpeg";
-  _mimeTypes["gif"] = "image/gif";
-  _mimeTypes["svg"] = "image/svg+xml";
-  _mimeTypes["ico"] = "image/x-icon";
-  _mimeTypes["txt"] = "text/plain";
-  _mimeTypes["json"] = "application/json";
-  _mimeTypes["pdf"] = "application/pdf";
+void StaticFileHandler::setListingCache(DirectoryListingCache *cache) {
+  _listingCache = cache;
 }
 
 /**
- * @brief Determines MIME type from file extension
+ * @brief Uses the process-wide content-coding policy (NULL = identity only)
  *
- * @param path File path
- * @return MIME type string, or "application/octet-stream" if unknown
+ * @param compression Policy owned by the Server, outlives this handler
  */
-std::string StaticFileHandler::_determineMimeType(const std::string &path) {
-  size_t dotPos = path.find_last_of('.');
-  if (dotPos == std::string::npos)
-    return "application/octet-stream";
+void StaticFileHandler::setCompression(const Compression *compression) {
+  _compression = compression;
+}
 
-  std::string ext = path.substr(dotPos + 1);
-  std::map<std::string, std::string>::iterator it = _mimeTypes.find(ext);
-  if (it != _mimeTypes.end())
-    return it->second;
-  return "application/octet-stream";
+/**
+ * @brief Uses the process-wide MIME table (NULL = built-in types)
+ *
+ * @param types Table owned by the Server, outlives this handler and every
+ *        cache entry pointing into it
+ */
+void StaticFileHandler::setMimeTypes(const MimeTypes *types) {
+  _mimeTypes = types;
 }
 
 /**
- * @brief Reads file content into a string using low-level I/O
+ * @brief Uses the owning connection's arena for per-request temporaries
  *
- * @param fullPath Absolute path to file
- * @param out Output string to store content
- * @param size Expected file size
- * @return true on success, false on error
+ * @param arena Reset by the connection once a response is queued; NULL
+ *        makes the handler use (and reset) a private one per request
+ */
+void StaticFileHandler::setArena(RequestArena *arena) { _arena = arena; }
+
+/**
+ * @brief Lets blocking filesystem calls become I/O thread tasks
  *
- * @note Uses O_NOFOLLOW for security (don't follow symlinks)
- * @note Handles EINTR interruptions by retrying
+ * @param enabled Set by the connection before each run of a request
+ *        (false without io_threads, or once a request was parked enough)
  */
-bool StaticFileHandler::_readFileToString(const std::string &fullPath,
-                                          std::string &out, size_t size) {
-  int flags = O_RDONLY;
-#ifdef O_NOFOLLOW
-  flags |= O_NOFOLLOW; // Security: don't follow symlinks
-#endif
+void StaticFileHandler::setDeferIo(bool enabled) { _deferIo = enabled; }
+
+/**
+ * @brief Returns the task the request was parked on, and forgets it
+ */
+IoTask *StaticFileHandler::takeDeferredIo() {
+  IoTask *task = _deferred;
+  _deferred = NULL;
+  return task;
+}
 
-  int fd = open(fullPath.c_str(), flags);
-  if (fd < 0) {
+bool StaticFileHandler::hasDeferredIo() const { return _deferred != NULL; }
+
+/**
+ * @brief Parks the request on an I/O thread lookup of path if it is cold
+ *
+ * @param path Resolved filesystem path about to be looked up
+ * @return true if the request must stop here (task deferred)
+ */
+bool StaticFileHandler::_deferLookup(const std::string &path) {
+  if (!_deferIo || _cache().isFresh(path))
     return false;
-  }
+  LOG_DEBUG("Cold path, stat/open on an I/O thread: " << path);
+  _defer(new FileLookupTask(_cache(), path));
+  return true;
+}
 
-  out.clear();
-  try {
-    out.resize(size);
-  } catch (const std::exception &e) {
-    close(fd);
+void StaticFileHandler::_defer(IoTask *task) {
+  delete _deferred;
+  _deferred = task;
+  _outcome.ready = false;
+}
+
+/**
+ * @brief Takes the result of a finished fsync / unlink / scan task
+ *
+ * @param path Path the handler is about to work on
+ * @param value Receives the task's result
+ * @return true if a task just finished that work for path
+ */
+bool StaticFileHandler::_takeOutcome(const std::string &path, int &value) {
+  if (!_outcome.ready || _outcome.path != path)
     return false;
-  }
+  _outcome.ready = false;
+  value = _outcome.value;
+  return true;
+}
 
-  size_t total = 0;
-  while (total < size) {
-    ssize_t bytesRead = read(fd, &out[total], size - total);
-    if (bytesRead < 0) {
-      if (errno == EINTR)
-        continue; // Retry if interrupted by signal
-      close(fd);
-      return false;
-    }
-    if (bytesRead == 0) {
-      break; // EOF
-    }
-    total += static_cast<size_t>(bytesRead);
-  }
+/**
+ * @brief Returns the shared cache, or a disabled one (plain syscalls)
+ */
+OpenFileCache &StaticFileHandler::_cache() {
+  static OpenFileCache disabled;
+  return _fileCache ? *_fileCache : disabled;
+}
 
-  close(fd);
+/**
+ * @brief Returns the shared listing cache, or a process-local fallback
+ */
+DirectoryListingCache &StaticFileHandler::_listings() {
+  static DirectoryListingCache fallback;
+  return _listingCache ? *_listingCache : fallback;
+}
 
-  if (total < size)
-    out.resize(total);
+/**
+ * @brief Returns the arena for the current request's temporaries
+ */
+RequestArena &StaticFileHandler::_scratch() {
+  return _arena ? *_arena : _ownArena;
+}
 
-  return true;
+/**
+ * @brief Returns the MIME table (built-in types without a Server)
+ */
+const MimeTypes &StaticFileHandler::_types() const {
+  static MimeTypes fallback;
+  return _mimeTypes ? *_mimeTypes : fallback;
 }
 
 /**
@@ -139,59 +216,86 @@ bool StaticFileHandler::_readFileToString(const std::string &fullPath,
  *
  * Handles:
  * - Empty paths → "/"
- * - Paths not starting with "/" → "__FORBIDDEN__"
- * - ".." segments that escape root → "__FORBIDDEN__"
+ * - Paths not starting with "/" → rejected
+ * - ".." segments that escape root → rejected
  * - "." segments → ignored
  * - Trailing slashes preserved
  *
+ * Segments are resolved directly in cleanPath (".." truncates it back to
+ * the previous '/'), no list of parts is built.
+ *
  * @param decodedPath URL-decoded path from request
- * @return Sanitized path, or "__FORBIDDEN__" if invalid
+ * @param cleanPath Receives the sanitized path
+ * @return false if the path is invalid (answer 403)
  */
-std::string
-StaticFileHandler::_sanitizePath(const std::string &decodedPath) const {
+bool StaticFileHandler::_sanitizePath(const std::string &decodedPath,
+                                      std::string &cleanPath) const {
+  cleanPath = "/";
   if (decodedPath.empty())
-    return "/";
+    return true;
 
   if (decodedPath[0] != '/')
-    return "__FORBIDDEN__";
+    return false;
 
-  std::vector<std::string> allParts;
   bool endsWithSlash =
       (decodedPath.size() > 1 && decodedPath[decodedPath.size() - 1] == '/');
 
   size_t i = 1;
   while (i <= decodedPath.size()) {
     size_t j = decodedPath.find('/', i);
-    std::string part;
-    if (j == std::string::npos) {
-      part = decodedPath.substr(i);
-      i = decodedPath.size() + 1;
+    if (j == std::string::npos)
+      j = decodedPath.size();
+    size_t length = j - i;
+    if (length == 0 || decodedPath.compare(i, length, ".") == 0) {
+      // Empty or "." segment
+    } else if (decodedPath.compare(i, length, "..") == 0) {
+      if (cleanPath.size() == 1)
+        return false; // Attempt to escape root
+      size_t slash = cleanPath.rfind('/');
+      cleanPath.erase(slash == 0 ? 1 : slash);
     } else {
-      part = decodedPath.substr(i, j - i);
-      i = j + 1;
+      if (cleanPath.size() > 1)
+        cleanPath += '/';
+      cleanPath.append(decodedPath, i, length);
     }
-    if (part.empty() || part == ".") {
-      continue;
-    } else if (part == "..") {
-      if (allParts.empty()) {
-        return "__FORBIDDEN__"; // Attempt to escape root
-      }
-      allParts.pop_back();
-    } else
-      allParts.push_back(part);
-  }
-
-  std::string cleanPath = "/";
-  for (size_t k = 0; k < allParts.size(); ++k) {
-    cleanPath += allParts[k];
-    if (k + 1 < allParts.size())
-      cleanPath += "/";
+    i = j + 1;
   }
 
   if (endsWithSlash && cleanPath[cleanPath.size() - 1] != '/')
-    cleanPath += "/";
+    cleanPath += '/';
 
-  return cleanPath;
+  return true;
+}
+
+/**
+ * @brief Maps a sanitized URL path to the filesystem (root or alias)
+ *
+ * - ALIAS: the location pattern is replaced by the alias directory
+ * - ROOT: the path is appended to the root directory
+ *
+ * @param cleanPath Path returned by _sanitizePath()
+ * @param location Location configuration
+ * @param fullPath Receives the filesystem path
+ */
+void StaticFileHandler::_buildFullPath(const std::string &cleanPath,
+                                       const LocationConfig &location,
+                                       std::string &fullPath) const {
+  const std::string &base =
+      location.hasAlias() ? location.getAlias() : location.getRoot();
+  size_t baseLength = base.size();
+  if (baseLength > 0 && base[baseLength - 1] == '/')
+    --baseLength;
+  fullPath.assign(base, 0, baseLength);
+
+  if (!location.hasAlias()) {
+    fullPath += cleanPath;
+    return;
+  }
+  size_t skip = location.getPattern().size();
+  if (skip >= cleanPath.size() || cleanPath[skip] != '/')
+    fullPath += '/';
+  if (skip < cleanPath.size())
+    fullPath.append(cleanPath, skip, std::string::npos);
 }
 
 /**
@@ -200,7 +304,7 @@ StaticFileHandler::_sanitizePath(const std::string &decodedPath) const {
  * Flow:
  * 1. Sanitize path (prevent traversal)
  * 2. Build full filesystem path using root or alias
- * 3. Check file/directory existence with stat()
+ * 3. Check file/directory existence with stat() (through the file cache)
  * 4. If directory → delegate to _handleDirectory()
  * 5. If file → serve with serveStaticFile()
  *
@@ -211,67 +315,53 @@ StaticFileHandler::_sanitizePath(const std::string &decodedPath) const {
 void StaticFileHandler::handleGet(const HttpRequest &request,
                                   HttpResponse &response,
                                   const LocationConfig &location) {
-  std::string decodedPath = request.getPath();
+  if (!_arena)
+    _ownArena.reset();
+  const std::string &decodedPath = request.getPath();
 
-  std::string cleanPath = _sanitizePath(decodedPath);
-  if (cleanPath == "__FORBIDDEN__") {
-    std::cerr << "❌ [Error] Path forbidden by sanitization: " << decodedPath
-              << std::endl;
+  std::string &cleanPath = _scratch().string();
+  if (!_sanitizePath(decodedPath, cleanPath)) {
+    LOG_WARN("Path forbidden by sanitization: " << decodedPath);
     response.setErrorResponse(403);
     return;
   }
 
-  std::cout << "[Info] GET request path: " << decodedPath << std::endl;
+  LOG_DEBUG("GET request path: " << decodedPath);
 
   // Build full path (Nginx-style root/alias logic)
-  std::string fullPath;
-  if (location.hasAlias()) {
-    // ALIAS: Replace location pattern with alias path
-    std::string relativePath = cleanPath.substr(location.getPattern().size());
-    if (relativePath.empty() || relativePath[0] != '/')
-      relativePath = "/" + relativePath;
-
-    std::string aliasPath = location.getAlias();
-    if (!aliasPath.empty() && aliasPath[aliasPath.size() - 1] == '/')
-      aliasPath.erase(aliasPath.size() - 1);
-
-    fullPath = aliasPath + relativePath;
-    std::cout << "[Debug] Using ALIAS: " << fullPath << std::endl;
-  } else {
-    // ROOT: Append path to root directory
-    std::string rootPath = location.getRoot();
-    if (!rootPath.empty() && rootPath[rootPath.size() - 1] == '/')
-      rootPath.erase(rootPath.size() - 1);
-
-    fullPath = rootPath + cleanPath;
-    std::cout << "[Debug] Using ROOT: " << fullPath << std::endl;
-  }
+  std::string &fullPath = _scratch().string();
+  _buildFullPath(cleanPath, location, fullPath);
+  LOG_DEBUG("Using " << (location.hasAlias() ? "ALIAS" : "ROOT") << ": "
+            << fullPath);
 
-  std::cout << "[Info] Full filesystem path: " << fullPath << std::endl;
+  LOG_DEBUG("Full filesystem path: " << fullPath);
 
-  // Check existence with stat()
-  struct stat fileStat;
-  if (stat(fullPath.c_str(), &fileStat) != 0) {
-    if (errno == EACCES) {
-      std::cerr << "❌ [Error] Access denied: " << fullPath << std::endl;
+  // Check existence with stat() (cached when open_file_cache is on)
+  if (_deferLookup(fullPath))
+    return;
+  OpenFileEntry *entry = _cache().lookup(fullPath);
+  if (entry->statError != 0) {
+    if (entry->statError == EACCES) {
+      LOG_WARN("Access denied: " << fullPath);
       response.setErrorResponse(403);
     } else {
-      std::cerr << "❌ [Error] Not found: " << fullPath << std::endl;
+      LOG_WARN("Not found: " << fullPath);
       response.setErrorResponse(404);
     }
     return;
   }
 
   // Handle directory
-  if (S_ISDIR(fileStat.st_mode)) {
-    std::cout << "[Debug] Directory detected → handling autoindex/index"
-              << std::endl;
-    _handleDirectory(fullPath, decodedPath, location, response);
+  if (S_ISDIR(entry->st.st_mode)) {
+    LOG_DEBUG("Directory detected → handling autoindex/index");
+    struct stat dirStat = entry->st; // The index lookup may evict entry
+    _handleDirectory(fullPath, dirStat, decodedPath, location, request,
+                     response);
     return;
   }
 
   // Serve file
-  serveStaticFile(fullPath, response);
+  _serveEntry(*entry, fullPath, &request, response);
 }
 
 /**
@@ -285,7 +375,7 @@ void StaticFileHandler::handleHead(const HttpRequest &request,
                                    HttpResponse &response,
                                    const LocationConfig &location) {
   handleGet(request, response, location);
-  response.setBody(""); // Remove body, keep headers
+  response.clearBody(); // Remove body, keep headers (incl. Content-Length)
 }
 
 /**
@@ -297,68 +387,539 @@ void StaticFileHandler::handleHead(const HttpRequest &request,
 void StaticFileHandler::serveStaticFile(const std::string &fullPath,
                                         HttpResponse &response) {
   if (fullPath == "__FORBIDDEN__") {
-    std::cerr << "❌ [Error] Path forbidden: " << fullPath << std::endl;
+    LOG_WARN("Path forbidden: " << fullPath);
     response.setErrorResponse(403);
     return;
   }
+  _serveEntry(*_cache().lookup(fullPath), fullPath, NULL, response);
+}
 
-  struct stat fileStat;
-  if (stat(fullPath.c_str(), &fileStat) != 0) {
-    if (errno == EACCES) {
-      std::cerr << "❌ [Error] Access denied: " << fullPath << std::endl;
+/**
+ * @brief Serves the file behind an already looked-up cache entry
+ *
+ * @param entry Entry from OpenFileCache::lookup() for fullPath
+ * @param fullPath Absolute filesystem path
+ * @param request Request being answered (conditional headers), or NULL
+ * @param response HTTP response to populate
+ */
+void StaticFileHandler::_serveEntry(OpenFileEntry &entry,
+                                    const std::string &fullPath,
+                                    const HttpRequest *request,
+                                    HttpResponse &response) {
+  // Byte ranges only apply to GET (HEAD mirrors the full 200 headers)
+  bool wantsRange = request && request->getMethod() == "GET" &&
+                    !request->getOneHeader("Range").empty();
+
+  if (entry.statError == 0 && !entry.mime)
+    entry.mime = &_types().lookup(fullPath);
+
+  // Content-coding: precompressed sibling first (gzip_static), then the
+  // compressed copy kept in the cache entry, else the file as it is
+  OpenFileEntry *current = &entry;
+  Compression::Encoding encoding = _negotiate(request, entry, wantsRange);
+  bool varies = encoding != Compression::IDENTITY ||
+                (_compression && entry.statError == 0 &&
+                 _compression->isCompressible(*entry.mime, entry.st.st_size));
+  while (encoding != Compression::IDENTITY) {
+    if (_compression->useStatic()) {
+      struct stat original = current->st; // The sibling lookup may evict it
+      const std::string *mime = current->mime;
+      if (_serveSibling(fullPath, original, *mime, encoding, request,
+                        response))
+        return;
+      current = _cache().lookup(fullPath);
+      if (current->statError == 0 && !current->mime)
+        current->mime = mime;
+    }
+    if (_compression->canCompress(encoding, current->st.st_size))
+      break;
+    encoding = encoding == Compression::BROTLI
+                   ? _compression->negotiate(*request, false)
+                   : Compression::IDENTITY;
+  }
+  OpenFileEntry &file = *current;
+  std::string encodedKey; // Response cache key of an encoded variant
+  if (encoding != Compression::IDENTITY)
+    encodedKey.append(fullPath).append(1, '\0').append(
+        Compression::token(encoding));
+  const std::string &cacheKey =
+      encoding == Compression::IDENTITY ? fullPath : encodedKey;
+
+  // Small hot file already serialized for this exact file version?
+  bool cacheable = _responseCache && _responseCache->isEnabled() &&
+                   !wantsRange && file.statError == 0 &&
+                   S_ISREG(file.st.st_mode) &&
+                   file.st.st_size <= OpenFileCache::CONTENT_MAX;
+  if (cacheable) {
+    const CachedResponse *hit = _responseCache->find(cacheKey, file.st);
+    if (hit) {
+      if (!_isNotModified(request, file.st, response))
+        response.usePrebuilt(hit->head, hit->body);
+      return;
+    }
+  }
+
+  // Open first, then fstat() the open fd: the size we advertise is the size
+  // of the exact file we are going to stream. Cached entries skip both.
+  _cache().open(file, fullPath);
+  if (file.openError != 0) {
+    if (file.openError == EACCES) {
+      LOG_WARN("Access denied: " << fullPath);
       response.setErrorResponse(403);
-    } else {
-      std::cerr << "❌ [Error] Not found: " << fullPath << std::endl;
+    } else if (file.openError == ENOENT || file.openError == ENOTDIR) {
+      LOG_WARN("Not found: " << fullPath);
       response.setErrorResponse(404);
+    } else {
+      LOG_ERROR("Open failed: " << fullPath << " ("
+                << strerror(file.openError) << ")");
+      response.setErrorResponse(500);
     }
     return;
   }
 
+  const struct stat &fileStat = file.st;
+  if (!S_ISREG(fileStat.st_mode)) {
+    LOG_WARN("Not a regular file: " << fullPath);
+    response.setErrorResponse(403);
+    return;
+  }
+
   if (fileStat.st_size < 0) {
-    std::cerr << "❌ [Error] Invalid file size: " << fullPath << std::endl;
+    LOG_ERROR("Invalid file size: " << fullPath);
     response.setErrorResponse(500);
     return;
   }
 
-  size_t size = static_cast<size_t>(fileStat.st_size);
-  if (size > MAX_STATIC_FILE_SIZE) {
-    std::cerr << "❌ [Error] File too large (" << size << " bytes): " << fullPath
-              << std::endl;
-    response.setErrorResponse(413);
+  // No size ceiling: the body is streamed from the fd as the socket drains,
+  // so a multi-GB file costs the same per-connection memory as a small one.
+
+  if (_isNotModified(request, fileStat, response))
+    return;
+
+  if (!file.mime)
+    file.mime = &_types().lookup(fullPath);
+
+  if (encoding != Compression::IDENTITY) {
+    const std::string *encoded = _encodedContent(file, encoding);
+    if (encoded) {
+      _setEncodedHeaders(fileStat, *file.mime, encoding, response);
+      response.setBody(*encoded);
+      if (cacheable)
+        _responseCache->store(cacheKey, fileStat,
+                              response.buildCacheableHead(), *encoded);
+      LOG_DEBUG("✅ File served (" << Compression::token(encoding)
+                << "): " << fullPath);
+      return;
+    }
+  }
+
+  if (wantsRange && _serveRanges(file, *request, response)) {
+    LOG_DEBUG("✅ Range served: " << fullPath << " ("
+              << response.getStatusCode() << ")");
     return;
   }
 
-  std::string content;
-  if (!_readFileToString(fullPath, content, size)) {
-    if (errno == EACCES) {
-      std::cerr << "❌ [Error] Read permission denied: " << fullPath
-                << std::endl;
-      response.setErrorResponse(403);
-    } else if (errno == ENOENT) {
-      std::cerr << "❌ [Error] File disappeared: " << fullPath << std::endl;
-      response.setErrorResponse(404);
-    } else if (errno == EFBIG) {
-      std::cerr << "❌ [Error] File too large: " << fullPath << std::endl;
-      response.setErrorResponse(413);
+  char etag[64];
+  char lastModified[64];
+  response.setStatus(200, "OK");
+  response.setHeader("Content-Type", *file.mime);
+  response.setHeader("ETag", etag, _makeETag(fileStat, etag, sizeof(etag)));
+  response.setHeader("Last-Modified", lastModified,
+                     HttpResponse::formatHttpDate(fileStat.st_mtime,
+                                                  lastModified,
+                                                  sizeof(lastModified)));
+  response.setHeader("Accept-Ranges", "bytes");
+  if (varies)
+    response.setHeader("Vary", "Accept-Encoding");
+  if (file.hasContent)
+    response.setBody(file.content); // Small cached file, no syscalls
+  else if (fileStat.st_size == 0)
+    response.setBody("");
+  else
+    response.setFileBody(file.file, 0, fileStat.st_size,
+                         file.map); // Streamed (from the mapping if any)
+
+  if (cacheable && fileStat.st_size <= OpenFileCache::CONTENT_MAX)
+    _storeResponse(file, fullPath, response);
+
+  LOG_DEBUG("✅ File served: " << fullPath);
+}
+
+/**
+ * @brief Builds a strong entity tag from the file version
+ *
+ * Format: "<inode>-<size>-<mtime>" in hex. Any change of content through
+ * write/rename changes at least one of the three.
+ *
+ * @param st stat() of the file
+ * @param buffer Receives the quoted ETag value (64 bytes are plenty)
+ * @param size Size of buffer
+ * @return Length of the value
+ */
+size_t StaticFileHandler::_makeETag(const struct stat &st, char *buffer,
+                                    size_t size) {
+  int length = snprintf(buffer, size, "\"%lx-%llx-%lx\"",
+                        static_cast<unsigned long>(st.st_ino),
+                        static_cast<unsigned long long>(st.st_size),
+                        static_cast<unsigned long>(st.st_mtime));
+  if (length < 0)
+    return 0;
+  return static_cast<size_t>(length) < size ? static_cast<size_t>(length)
+                                            : size - 1;
+}
+
+/**
+ * @brief Whether an If-None-Match list contains etag
+ *
+ * Accepts "*" and compares weakly (W/ prefixes ignored), as RFC 9110
+ * requires for If-None-Match.
+ */
+static bool etagListMatches(const std::string &list, const std::string &etag) {
+  size_t pos = 0;
+  while (pos < list.size()) {
+    size_t comma = list.find(',', pos);
+    if (comma == std::string::npos)
+      comma = list.size();
+    size_t start = list.find_first_not_of(" \t", pos);
+    size_t end = list.find_last_not_of(" \t", comma - 1);
+    if (start != std::string::npos && start < comma && end >= start) {
+      std::string tag = list.substr(start, end - start + 1);
+      if (tag == "*")
+        return true;
+      if (tag.compare(0, 2, "W/") == 0)
+        tag.erase(0, 2);
+      if (tag == etag)
+        return true;
+    }
+    pos = comma + 1;
+  }
+  return false;
+}
+
+/**
+ * @brief Answers 304 Not Modified when the client copy is still current
+ *
+ * RFC 9110 §13.2.2 order: If-None-Match wins; If-Modified-Since is only
+ * evaluated when If-None-Match is absent (and ignored if not a valid date).
+ *
+ * @param request Request being answered (NULL = unconditional)
+ * @param st stat() of the file that would be sent
+ * @param response Set to a body-less 304 with validators on match
+ * @return true if the 304 was produced
+ */
+bool StaticFileHandler::_isNotModified(const HttpRequest *request,
+                                       const struct stat &st,
+                                       HttpResponse &response) {
+  if (!request ||
+      (request->getMethod() != "GET" && request->getMethod() != "HEAD"))
+    return false;
+
+  // Unconditional requests (the common case) copy no header value
+  size_t length = 0;
+  const char *ifNoneMatch = request->getHeaderValue("If-None-Match", length);
+  bool hasNoneMatch = ifNoneMatch && length > 0;
+  if (!hasNoneMatch && !request->getHeaderValue("If-Modified-Since", length))
+    return false;
+
+  char etag[64];
+  size_t etagLength = _makeETag(st, etag, sizeof(etag));
+  bool notModified = false;
+  if (hasNoneMatch) {
+    notModified =
+        etagListMatches(std::string(ifNoneMatch, length),
+                        std::string(etag, etagLength));
+  } else {
+    time_t since =
+        HttpRequest::parseHttpDate(request->getOneHeader("If-Modified-Since"));
+    notModified = since != -1 && st.st_mtime <= since;
+  }
+  if (!notModified)
+    return false;
+
+  char lastModified[64];
+  response.setStatus(304, "Not Modified");
+  response.setHeader("ETag", etag, etagLength);
+  response.setHeader("Last-Modified", lastModified,
+                     HttpResponse::formatHttpDate(st.st_mtime, lastModified,
+                                                  sizeof(lastModified)));
+  response.clearBody();
+  LOG_DEBUG("✅ Not modified: " << request->getPath());
+  return true;
+}
+
+/**
+ * @brief Whether If-Range still selects the current file version
+ *
+ * An entity tag must match strongly (weak tags never do); a date must be
+ * exactly the Last-Modified value. A mismatch means the client's partial
+ * copy is stale and the full 200 response is sent instead.
+ */
+static bool ifRangeMatches(const HttpRequest &request, const std::string &etag,
+                           time_t mtime) {
+  std::string ifRange = request.getOneHeader("If-Range");
+  if (ifRange.empty())
+    return true;
+  if (ifRange[0] == '"')
+    return ifRange == etag;
+  if (ifRange.compare(0, 2, "W/") == 0)
+    return false;
+  return HttpRequest::parseHttpDate(ifRange) == mtime;
+}
+
+/**
+ * @brief Answers a Range request with 206 Partial Content or 416
+ *
+ * One range becomes a plain 206 with Content-Range. Several ranges become a
+ * multipart/byteranges body assembled from segments, so file parts are
+ * still streamed from the fd with sendfile() and never read into memory.
+ *
+ * @param entry Opened cache entry of a regular file (mime already set)
+ * @param request GET request carrying a Range header
+ * @param response HTTP response to populate
+ * @return false if the header must be ignored (full 200 instead)
+ */
+bool StaticFileHandler::_serveRanges(const OpenFileEntry &entry,
+                                     const HttpRequest &request,
+                                     HttpResponse &response) {
+  const struct stat &fileStat = entry.st;
+  char etagBuffer[64];
+  std::string etag(etagBuffer,
+                   _makeETag(fileStat, etagBuffer, sizeof(etagBuffer)));
+  if (!ifRangeMatches(request, etag, fileStat.st_mtime))
+    return false;
+
+  std::vector<ByteRange> ranges;
+  HttpRequest::RangeResult result =
+      request.parseRange(fileStat.st_size, ranges);
+  if (result == HttpRequest::RANGE_NONE)
+    return false;
+
+  std::ostringstream size;
+  size << fileStat.st_size;
+  if (result == HttpRequest::RANGE_UNSATISFIABLE) {
+    response.setErrorResponse(416);
+    response.setHeader("Content-Range", "bytes */" + size.str());
+    return true;
+  }
+
+  response.setStatus(206, "Partial Content");
+  response.setHeader("ETag", etag);
+  response.setHeader("Last-Modified",
+                     HttpResponse::formatHttpDate(fileStat.st_mtime));
+  response.setHeader("Accept-Ranges", "bytes");
+
+  if (ranges.size() == 1) {
+    const ByteRange &range = ranges[0];
+    off_t length = range.last - range.first + 1;
+    std::ostringstream contentRange;
+    contentRange << "bytes " << range.first << '-' << range.last << '/'
+                 << fileStat.st_size;
+    response.setHeader("Content-Type", *entry.mime);
+    response.setHeader("Content-Range", contentRange.str());
+    if (entry.hasContent)
+      response.setBody(entry.content.substr(static_cast<size_t>(range.first),
+                                            static_cast<size_t>(length)));
+    else
+      response.setFileBody(entry.file, range.first, length, entry.map);
+    return true;
+  }
+
+  // Boundary only has to be absent from the parts; a per-process counter
+  // keeps it unique without reading any random source
+  static unsigned long boundaryCounter = 0;
+  std::ostringstream boundary;
+  boundary << std::setw(20) << std::setfill('0')
+           << (static_cast<unsigned long>(time(NULL)) ^ ++boundaryCounter);
+
+  response.setHeader("Content-Type",
+                     "multipart/byteranges; boundary=" + boundary.str());
+  response.setBody("");
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    const ByteRange &range = ranges[i];
+    off_t length = range.last - range.first + 1;
+    std::ostringstream part;
+    part << "\r\n--" << boundary.str() << "\r\nContent-Type: " << *entry.mime
+         << "\r\nContent-Range: bytes " << range.first << '-' << range.last
+         << '/' << fileStat.st_size << "\r\n\r\n";
+    if (entry.hasContent) {
+      part << entry.content.substr(static_cast<size_t>(range.first),
+                                   static_cast<size_t>(length));
+      response.appendBodySegment(part.str());
     } else {
-      std::cerr << "❌ [Error] Read failed: " << fullPath << " ("
-                << strerror(errno) << ")" << std::endl;
-      response.setErrorResponse(500);
+      response.appendBodySegment(part.str());
+      response.appendBodySegment(entry.file, range.first, length, entry.map);
     }
-    return;
   }
+  response.appendBodySegment("\r\n--" + boundary.str() + "--\r\n");
+  return true;
+}
+
+/**
+ * @brief Keeps the serialized form of a small file response for reuse
+ *
+ * The body comes from the open file cache when it already holds the
+ * content, otherwise it is read once here. The response itself switches to
+ * the in-memory body so both paths send identical bytes.
+ *
+ * @param entry Opened cache entry of the served file
+ * @param fullPath Absolute filesystem path (cache key)
+ * @param response 200 response just built for the file
+ */
+void StaticFileHandler::_storeResponse(const OpenFileEntry &entry,
+                                       const std::string &fullPath,
+                                       HttpResponse &response) {
+  std::string body;
+  if (entry.hasContent) {
+    body = entry.content;
+  } else if (entry.st.st_size > 0) {
+    body.resize(static_cast<size_t>(entry.st.st_size));
+    off_t done = 0;
+    while (done < entry.st.st_size) {
+      ssize_t n = pread(entry.file.getFd(), &body[done],
+                        entry.st.st_size - done, done);
+      if (n <= 0)
+        return; // Keep the streamed response, just don't cache it
+      done += n;
+    }
+    response.setBody(body);
+  }
+  _responseCache->store(fullPath, entry.st, response.buildCacheableHead(),
+                        body);
+}
+
+/**
+ * @brief Content-coding a static file response would use
+ *
+ * Ranges are always served from the identity body, and so are files whose
+ * type or size gzip_types / gzip_min_length exclude.
+ *
+ * @param request Request being answered, or NULL (internal: identity)
+ * @param entry Looked-up entry of the file (mime filled in)
+ * @param wantsRange Whether the request carries a Range header
+ */
+Compression::Encoding
+StaticFileHandler::_negotiate(const HttpRequest *request,
+                              const OpenFileEntry &entry,
+                              bool wantsRange) const {
+  if (!request || wantsRange || !_compression || entry.statError != 0 ||
+      !S_ISREG(entry.st.st_mode) ||
+      !_compression->isCompressible(*entry.mime, entry.st.st_size))
+    return Compression::IDENTITY;
+  return _compression->negotiate(*request, true);
+}
+
+/**
+ * @brief Serves foo.css.gz / foo.css.br in place of foo.css (gzip_static)
+ *
+ * The sibling goes through the open file cache like any file, so it is
+ * sent from memory or with sendfile(). Validators are those of the
+ * original file: the sibling is meant to be rebuilt along with it.
+ *
+ * @param fullPath Path of the original file
+ * @param original stat() of the original file
+ * @param mime Content-Type of the original file
+ * @param encoding Coding whose sibling is looked for
+ * @param request Request being answered (conditional headers)
+ * @param response HTTP response to populate
+ * @return false if there is no readable sibling
+ */
+bool StaticFileHandler::_serveSibling(const std::string &fullPath,
+                                      const struct stat &original,
+                                      const std::string &mime,
+                                      Compression::Encoding encoding,
+                                      const HttpRequest *request,
+                                      HttpResponse &response) {
+  std::string &path = _scratch().string();
+  path.assign(fullPath).append(Compression::suffix(encoding));
+  if (_deferLookup(path))
+    return true; // Parked: the response is built when the request reruns
+  OpenFileEntry *sibling = _cache().lookup(path);
+  if (sibling->statError != 0 || !S_ISREG(sibling->st.st_mode))
+    return false;
+  _cache().open(*sibling, path);
+  if (sibling->openError != 0 || !S_ISREG(sibling->st.st_mode))
+    return false;
 
-  std::string mime = _determineMimeType(fullPath);
+  if (_isNotModified(request, original, response)) {
+    response.setHeader("Vary", "Accept-Encoding");
+    return true;
+  }
+  _setEncodedHeaders(original, mime, encoding, response);
+  if (sibling->hasContent)
+    response.setBody(sibling->content);
+  else if (sibling->st.st_size == 0)
+    response.setBody("");
+  else
+    response.setFileBody(sibling->file, 0, sibling->st.st_size,
+                         sibling->map);
+  LOG_DEBUG("✅ Precompressed file served: " << path);
+  return true;
+}
 
-  std::ostringstream oss;
-  oss << content.size();
+/**
+ * @brief Returns the encoded content of a file, compressing it on first use
+ *
+ * The result lives in the cache entry next to the plain content, so a
+ * file is compressed once per version (and per coding), not per request.
+ *
+ * @param entry Opened entry of a regular file up to ON_THE_FLY_MAX bytes
+ * @param encoding GZIP or BROTLI
+ * @return Encoded bytes, or NULL if the file could not be read/compressed
+ */
+const std::string *
+StaticFileHandler::_encodedContent(OpenFileEntry &entry,
+                                   Compression::Encoding encoding) {
+  std::string &variant =
+      encoding == Compression::BROTLI ? entry.brotli : entry.gzip;
+  if (!variant.empty())
+    return &variant;
+
+  std::string source;
+  if (!entry.hasContent && entry.st.st_size > 0) {
+    source.resize(static_cast<size_t>(entry.st.st_size));
+    off_t done = 0;
+    while (done < entry.st.st_size) {
+      ssize_t n = pread(entry.file.getFd(), &source[done],
+                        entry.st.st_size - done, done);
+      if (n <= 0)
+        return NULL;
+      done += n;
+    }
+  }
+  if (!_compression->compress(encoding,
+                              entry.hasContent ? entry.content : source,
+                              variant)) {
+    variant.clear();
+    return NULL;
+  }
+  return &variant;
+}
 
+/**
+ * @brief Sets the headers of an encoded 200 response
+ *
+ * The entity tag is the file's, made weak: the bytes differ from the
+ * identity body, but a conditional request for either is answered the
+ * same way (nginx does the same).
+ */
+void StaticFileHandler::_setEncodedHeaders(const struct stat &original,
+                                           const std::string &mime,
+                                           Compression::Encoding encoding,
+                                           HttpResponse &response) {
+  char etag[64];
+  char lastModified[64];
+  etag[0] = 'W';
+  etag[1] = '/';
+  size_t etagLength = 2 + _makeETag(original, etag + 2, sizeof(etag) - 2);
   response.setStatus(200, "OK");
   response.setHeader("Content-Type", mime);
-  response.setHeader("Content-Length", oss.str());
-  response.setBody(content);
-
-  std::cout << "✅ [Info] File served: " << fullPath << "\n";
+  response.setHeader("Content-Encoding", Compression::token(encoding));
+  response.setHeader("Vary", "Accept-Encoding");
+  response.setHeader("ETag", etag, etagLength);
+  response.setHeader("Last-Modified", lastModified,
+                     HttpResponse::formatHttpDate(original.st_mtime,
+                                                  lastModified,
+                                                  sizeof(lastModified)));
 }
 
 /**
@@ -370,128 +931,128 @@ void StaticFileHandler::serveStaticFile(const std::string &fullPath,
  * 3. Return 403 Forbidden otherwise
  *
  * @param dirPath Filesystem directory path
+ * @param dirStat stat() view of the directory (listing cache validation)
  * @param urlPath URL path for links
  * @param location Location configuration
+ * @param request Request being answered (conditional headers)
  * @param response HTTP response to populate
  */
 void StaticFileHandler::_handleDirectory(const std::string &dirPath,
+                                         const struct stat &dirStat,
                                          const std::string &urlPath,
                                          const LocationConfig &location,
+                                         const HttpRequest &request,
                                          HttpResponse &response) {
+  static const std::string noIndex;
   bool autoindexEnabled = location.getAutoindex();
-  std::string defaultFile =
-      location.getIndex().empty() ? "" : location.getIndex()[0];
+  const std::string &defaultFile =
+      location.getIndex().empty() ? noIndex : location.getIndex()[0];
 
-  std::cout << "[Debug] handleDirectory: " << dirPath
-            << ", autoindex=" << (autoindexEnabled ? "ON" : "OFF")
-            << ", index=" << defaultFile << std::endl;
+  LOG_DEBUG("handleDirectory: " << dirPath << ", autoindex="
+            << (autoindexEnabled ? "ON" : "OFF") << ", index=" << defaultFile);
 
   // Priority 1: Try to serve index file
-  std::string indexPath = dirPath;
+  std::string &indexPath = _scratch().string();
+  indexPath = dirPath;
   if (!indexPath.empty() && indexPath[indexPath.size() - 1] != '/')
     indexPath += "/";
   indexPath += defaultFile;
 
-  struct stat fileStat;
-  if (!defaultFile.empty() && stat(indexPath.c_str(), &fileStat) == 0 &&
-      S_ISREG(fileStat.st_mode)) {
-    std::cout << "[Debug] Serving index: " << indexPath << std::endl;
-    serveStaticFile(indexPath, response);
+  if (!defaultFile.empty() && _deferLookup(indexPath))
+    return;
+  OpenFileEntry *index =
+      defaultFile.empty() ? NULL : _cache().lookup(indexPath);
+  if (index && index->statError == 0 && S_ISREG(index->st.st_mode)) {
+    LOG_DEBUG("Serving index: " << indexPath);
+    _serveEntry(*index, indexPath, &request, response);
     return;
   }
-  std::cout << "[Debug] No index file found: " << indexPath << std::endl;
+  LOG_DEBUG("No index file found: " << indexPath);
 
-  // Priority 2: Generate autoindex if enabled
+  // Priority 2: Generate autoindex if enabled (?page=&limit=&format=json)
   if (autoindexEnabled) {
-    std::cout << "[Debug] Generating autoindex for: " << dirPath << std::endl;
-    std::string html = Autoindex::generateListing(dirPath, urlPath);
-    if (html.empty()) {
+    LOG_DEBUG("Generating autoindex for: " << dirPath);
+    Autoindex::Options options;
+    Autoindex::parseOptions(request.getQuery(), options);
+    const std::string *listing = NULL;
+    int scanError = 0;
+    bool scanned = _takeOutcome(dirPath, scanError); // On an I/O thread
+    if (!scanned && _deferIo && _listings().needsScan(dirPath, dirStat)) {
+      _defer(new DirectoryScanTask(_listings(), _outcome, dirPath, dirStat,
+                                   urlPath, options));
+      return;
+    }
+    if (scanError == 0)
+      listing =
+          _listings().getPage(dirPath, dirStat, urlPath, options, scanned);
+    else
+      errno = scanError;
+    if (!listing) {
       if (errno == EACCES) {
-        std::cerr << "❌ [Error] Autoindex: permission denied: " << dirPath
-                  << std::endl;
+        LOG_WARN("Autoindex: permission denied: " << dirPath);
         response.setErrorResponse(403);
       } else {
-        std::cerr << "❌ [Error] Autoindex failed: " << dirPath << std::endl;
+        LOG_ERROR("Autoindex failed: " << dirPath);
         response.setErrorResponse(404);
       }
       return;
     }
     response.setStatus(200, "OK");
-    response.setHeader("Content-Type", "text/html");
-    response.setBody(html);
+    response.setHeader("Content-Type",
+                       options.json ? "application/json" : "text/html");
+    response.setBody(*listing);
     return;
   }
 
   // Priority 3: No index and autoindex off → 403
-  std::cout << "[Debug] No index, autoindex OFF → 403 Forbidden" << std::endl;
+  LOG_DEBUG("No index, autoindex OFF → 403 Forbidden");
   response.setErrorResponse(403);
 }
 
 /**
- * @brief Handles POST requests (file uploads)
+ * @brief Validates the upload directory and picks a unique file name
  *
- * Flow:
- * 1. Reject chunked uploads (not supported)
- * 2. Get upload directory from location config
- * 3. Create directory if needed
+ * 1. Get upload directory from location config
+ * 2. Create directory if needed
+ * 3. Check write permission
  * 4. Generate unique filename
- * 5. Write request body to file
- * 6. Respond with 201 Created
  *
- * @param request HTTP request with body
- * @param response HTTP response to populate
  * @param location Location configuration with upload_path
+ * @param filepath Receives the full path of the file to create
+ * @param filename Receives the bare file name
+ * @return 0 on success, otherwise the HTTP error status to answer
  */
-void StaticFileHandler::handlePost(const HttpRequest &request,
-                                   HttpResponse &response,
-                                   const LocationConfig &location) {
-  // Step 1: Reject chunked uploads
-  if (request.isChunked()) {
-    response.setStatus(501, "Not Implemented");
-    response.setHeader("Content-Type", "text/html");
-    response.setBody("<html><body><h1>501 Not Implemented</h1>"
-                     "<p>Chunked uploads are not supported.</p>"
-                     "</body></html>");
-    return;
-  }
-
-  // Step 2: Get upload directory
+int StaticFileHandler::_prepareUploadTarget(const LocationConfig &location,
+                                            std::string &filepath,
+                                            std::string &filename) {
+  // Step 1: Get upload directory
   std::string uploadDir = location.getUploadPath();
   if (uploadDir.empty()) {
-    std::cerr << "❌ [Error] No upload_path configured" << std::endl;
-    response.setErrorResponse(500);
-    return;
+    LOG_ERROR("No upload_path configured");
+    return 500;
   }
 
-  // Step 3: Verify/create upload directory
+  // Step 2: Verify/create upload directory
   struct stat fileStat;
   if (stat(uploadDir.c_str(), &fileStat) != 0) {
     if (errno == ENOENT) {
       if (mkdir(uploadDir.c_str(), 0755) != 0) {
-        std::cerr << "❌ [Error] Failed to create upload directory: "
-                  << uploadDir << std::endl;
-        response.setErrorResponse(500);
-        return;
+        LOG_ERROR("Failed to create upload directory: " << uploadDir);
+        return 500;
       }
     } else {
-      std::cerr << "❌ [Error] stat() failed on upload directory: " << uploadDir
-                << std::endl;
-      response.setErrorResponse(500);
-      return;
+      LOG_ERROR("stat() failed on upload directory: " << uploadDir);
+      return 500;
     }
   } else if (!S_ISDIR(fileStat.st_mode)) {
-    std::cerr << "❌ [Error] Upload path is not a directory: " << uploadDir
-              << std::endl;
-    response.setErrorResponse(500);
-    return;
+    LOG_ERROR("Upload path is not a directory: " << uploadDir);
+    return 500;
   }
 
-  // Check write permission
+  // Step 3: Check write permission
   if (access(uploadDir.c_str(), W_OK) != 0) {
-    std::cerr << "❌ [Error] Write permission denied: " << uploadDir
-              << std::endl;
-    response.setErrorResponse(403);
-    return;
+    LOG_ERROR("Write permission denied: " << uploadDir);
+    return 403;
   }
 
   // Step 4: Generate unique filename
@@ -502,44 +1063,138 @@ void StaticFileHandler::handlePost(const HttpRequest &request,
 
   ss << "upload_" << now << "_" << pid << "_" << rnd << ".dat";
 
-  std::string filename = ss.str();
-  std::string filepath = uploadDir;
+  filename = ss.str();
+  filepath = uploadDir;
   if (!filepath.empty() && filepath[filepath.size() - 1] != '/')
     filepath += "/";
   filepath += filename;
+  return 0;
+}
 
-  // Step 5: Write file
-  int fd = open(filepath.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
-  if (fd == -1) {
-    std::cerr << "❌ [Error] Failed to create upload file: " << filepath
-              << std::endl;
-    response.setErrorResponse(500);
-    return;
+/**
+ * @brief Creates the upload file before the body arrives
+ *
+ * Called by RequestHandler once the headers of a static POST are parsed.
+ * When the disk has no room for it (creation or upload_preallocate fails
+ * with ENOSPC / EDQUOT), status is set to 507, or 413 past the file size
+ * limit (EFBIG): the request is answered without reading its body. On
+ * any other failure no sink is used: the body is then buffered as usual
+ * and handlePost() reports the same error through the regular path.
+ *
+ * @param request Request whose headers are complete
+ * @param location Location configuration with upload_path
+ * @param status Set to the error to answer at once, else left alone
+ * @return New sink owned by the caller, or NULL
+ */
+UploadSink *StaticFileHandler::openUpload(const HttpRequest &request,
+                                          const LocationConfig &location,
+                                          int &status) {
+  std::string filepath;
+  std::string filename;
+  if (_prepareUploadTarget(location, filepath, filename) != 0)
+    return NULL;
+
+  off_t expected = request.isChunked() ? -1 : request.getContentLength();
+  UploadSink *sink = new UploadSink();
+  int error = sink->open(filepath, filename, location.getMaxBodySize(),
+                         expected, location.getUploadPreallocate());
+  if (error != 0) {
+    delete sink;
+    if (error == ENOSPC || error == EDQUOT)
+      status = 507;
+    else if (error == EFBIG)
+      status = 413;
+    return NULL;
   }
+  LOG_DEBUG("Streaming upload to: " << filepath);
+  return sink;
+}
 
-  const std::string &body = request.getBody();
-  const char *buf = body.data();
-  size_t buf_size = body.size();
-  size_t written = 0;
+/**
+ * @brief Handles POST requests (file uploads)
+ *
+ * Flow:
+ * 1. Streamed upload (sink attached at header time): commit the file
+ * 2. Otherwise validate the upload directory and pick a file name
+ * 3. Write the buffered request body to the file
+ * 4. Respond with 201 Created
+ *
+ * Chunked bodies arrive already decoded, so they are stored like any other.
+ *
+ * @param request HTTP request with body
+ * @param response HTTP response to populate
+ * @param location Location configuration with upload_path
+ */
+void StaticFileHandler::handlePost(const HttpRequest &request,
+                                   HttpResponse &response,
+                                   const LocationConfig &location) {
+  std::string filename;
+  size_t size = 0;
+
+  UploadSink *sink = request.getUploadSink();
+  if (sink) {
+    // Step 1: Body already on disk (fsync() on an I/O thread if enabled)
+    int syncError = 0;
+    bool synced = _takeOutcome(sink->getPath(), syncError);
+    if (!synced && _deferIo) {
+      int fd = sink->dupFd();
+      if (fd >= 0) {
+        _defer(new FileSyncTask(_outcome, sink->getPath(), fd));
+        return;
+      }
+    }
+    if (syncError != 0)
+      LOG_WARN("fsync() failed: " << sink->getPath() << " ("
+               << strerror(syncError) << ")");
+    if (!sink->commit(synced)) {
+      response.setErrorResponse(500);
+      return;
+    }
+    filename = sink->getFilename();
+    size = sink->getWritten();
+  } else {
+    // Step 2: Directory checks + unique name
+    std::string filepath;
+    int status = _prepareUploadTarget(location, filepath, filename);
+    if (status != 0) {
+      response.setErrorResponse(status);
+      return;
+    }
 
-  while (written < buf_size) {
-    ssize_t ret = write(fd, buf + written, buf_size - written);
-    if (ret < 0) {
-      if (errno == EINTR)
-        continue;
-      std::cerr << "❌ [Error] Write failed: " << filepath << std::endl;
-      close(fd);
-      unlink(filepath.c_str()); // Clean up incomplete file
+    // Step 3: Write file
+    int fd =
+        open(filepath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd == -1) {
+      LOG_ERROR("Failed to create upload file: " << filepath);
       response.setErrorResponse(500);
       return;
     }
-    written += static_cast<size_t>(ret);
-  }
 
-  fsync(fd);
-  close(fd);
+    const std::string &body = request.getBody();
+    const char *buf = body.data();
+    size_t buf_size = body.size();
+    size_t written = 0;
+
+    while (written < buf_size) {
+      ssize_t ret = write(fd, buf + written, buf_size - written);
+      if (ret < 0) {
+        if (errno == EINTR)
+          continue;
+        LOG_ERROR("Write failed: " << filepath);
+        close(fd);
+        unlink(filepath.c_str()); // Clean up incomplete file
+        response.setErrorResponse(500);
+        return;
+      }
+      written += static_cast<size_t>(ret);
+    }
+
+    fsync(fd);
+    close(fd);
+    size = body.size();
+  }
 
-  // Step 6: Respond with 201 Created
+  // Step 4: Respond with 201 Created
   response.setStatus(201, "Created");
   response.setHeader("Content-Type", "text/html");
   response.setHeader("Location", "/uploads/" + filename);
@@ -547,13 +1202,12 @@ void StaticFileHandler::handlePost(const HttpRequest &request,
   std::ostringstream html;
   html << "<html><body>"
        << "<h1>Upload successful</h1>"
-       << "<p>Saved as: " << filename << " (" << body.size() << " bytes)</p>"
+       << "<p>Saved as: " << filename << " (" << size << " bytes)</p>"
        << "</body></html>";
 
   response.setBody(html.str());
 
-  std::cout << "✅ [Info] Upload OK: " << filename << " (" << body.size()
-            << " bytes)" << std::endl;
+  LOG_INFO("✅ Upload OK: " << filename << " (" << size << " bytes)");
 }
 
 /**
@@ -564,7 +1218,8 @@ void StaticFileHandler::handlePost(const HttpRequest &request,
  * 2. Build full filesystem path
  * 3. Verify file exists and is not a directory
  * 4. Check write permission on parent directory
- * 5. Remove file
+ * 5. Remove file (3-5: FileDeleteTask::removeFile(), on an I/O thread
+ *    with io_threads)
  * 6. Respond with 204 No Content
  *
  * @param request HTTP request
@@ -574,85 +1229,54 @@ void StaticFileHandler::handlePost(const HttpRequest &request,
 void StaticFileHandler::handleDelete(const HttpRequest &request,
                                      HttpResponse &response,
                                      const LocationConfig &location) {
-  std::string decodedPath = request.getPath();
-  std::string cleanPath = _sanitizePath(decodedPath);
-
-  if (cleanPath == "__FORBIDDEN__") {
+  if (!_arena)
+    _ownArena.reset();
+  std::string &cleanPath = _scratch().string();
+  if (!_sanitizePath(request.getPath(), cleanPath)) {
     response.setErrorResponse(403);
     return;
   }
 
   // Build full path (same logic as GET)
-  std::string fullPath;
-  if (location.hasAlias()) {
-    std::string relativePath = cleanPath.substr(location.getPattern().size());
-    if (relativePath.empty() || relativePath[0] != '/')
-      relativePath = "/" + relativePath;
-
-    std::string aliasPath = location.getAlias();
-    if (!aliasPath.empty() && aliasPath[aliasPath.size() - 1] == '/')
-      aliasPath.erase(aliasPath.size() - 1);
+  std::string &fullPath = _scratch().string();
+  _buildFullPath(cleanPath, location, fullPath);
 
-    fullPath = aliasPath + relativePath;
-  } else {
-    std::string rootPath = location.getRoot();
-    if (!rootPath.empty() && rootPath[rootPath.size() - 1] == '/')
-      rootPath.erase(rootPath.size() - 1);
-
-    fullPath = rootPath + cleanPath;
-  }
+  LOG_DEBUG("DELETE path: " << fullPath);
 
-  std::cout << "[Debug] DELETE path: " << fullPath << std::endl;
-
-  // Verify file exists
-  struct stat fileStat;
-  if (stat(fullPath.c_str(), &fileStat) != 0) {
-    if (errno == ENOENT) {
-      std::cerr << "❌ [Error] File not found: " << fullPath << std::endl;
-      response.setErrorResponse(404);
-    } else if (errno == EACCES) {
-      std::cerr << "❌ [Error] Permission denied: " << fullPath << std::endl;
-      response.setErrorResponse(403);
-    } else {
-      std::cerr << "❌ [Error] stat() failed: " << fullPath << std::endl;
-      response.setErrorResponse(500);
+  // Checks + removal (on an I/O thread if enabled, see FileDeleteTask)
+  int status;
+  if (!_takeOutcome(fullPath, status)) {
+    if (_deferIo) {
+      _defer(new FileDeleteTask(_outcome, fullPath));
+      return;
     }
-    return;
+    status = FileDeleteTask::removeFile(fullPath);
   }
-
-  // Don't allow deleting directories
-  if (S_ISDIR(fileStat.st_mode)) {
-    std::cerr << "❌ [Error] Cannot delete directory: " << fullPath << std::endl;
-    response.setErrorResponse(403);
+  if (status != 204) {
+    if (status == 404)
+      LOG_WARN("File not found: " << fullPath);
+    else if (status == 403)
+      LOG_WARN("Cannot delete (directory or permission denied): "
+               << fullPath);
+    else
+      LOG_ERROR("Remove failed: " << fullPath);
+    response.setErrorResponse(status);
     return;
   }
 
-  // Check write permission on parent directory
-  std::string parentDir = fullPath.substr(0, fullPath.find_last_of('/'));
-  if (parentDir.empty())
-    parentDir = ".";
-
-  if (access(parentDir.c_str(), W_OK) != 0) {
-    std::cerr << "❌ [Error] No write permission in: " << parentDir << std::endl;
-    response.setErrorResponse(403);
-    return;
-  }
-
-  // Delete file
-  if (std::remove(fullPath.c_str()) != 0) {
-    if (errno == EACCES || errno == EPERM) {
-      std::cerr << "❌ [Error] Permission denied: " << fullPath << std::endl;
-      response.setErrorResponse(403);
-    } else {
-      std::cerr << "❌ [Error] Remove failed: " << fullPath << std::endl;
-      response.setErrorResponse(500);
-    }
-    return;
+  _cache().invalidate(fullPath);
+  if (_responseCache) {
+    _responseCache->invalidate(fullPath);
+    std::string encodedKey = fullPath + '\0'; // Variants, see _serveEntry
+    _responseCache->invalidate(encodedKey +
+                               Compression::token(Compression::GZIP));
+    _responseCache->invalidate(encodedKey +
+                               Compression::token(Compression::BROTLI));
   }
 
   // Respond with 204 No Content
   response.setStatus(204, "No Content");
   response.setBody("");
 
-  std::cout << "✅ [Info] File deleted: " << fullPath << std::endl;
+  LOG_INFO("✅ File deleted: " << fullPath);
 }
@@ -0,0 +1,143 @@
+#include "http/UploadSink.hpp"
+#include "core/Logger.hpp"
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @file UploadSink.cpp
+ * @brief Streams POST bodies to the upload file as they are received
+ *
+ * Without a sink an upload is held twice in memory before handlePost()
+ * runs: once in the connection's receive buffer and once in the request
+ * body. RequestHandler::openUploadSink() routes the request as soon as its
+ * headers are parsed; when it is a static upload, the target file is
+ * created right away and HttpRequest hands every body byte (Content-Length
+ * or de-chunked) to write(). Memory per upload is then one read buffer.
+ *
+ * With upload_preallocate on and a known Content-Length, the whole size is
+ * reserved with posix_fallocate() first: the filesystem can lay the file
+ * out contiguously, and a full disk is detected before any byte is written
+ * (the request is answered 507 without reading its body).
+ *
+ * Lifetime: the connection owns the sink. If the client disconnects, the
+ * request is rejected (413, 405...) or a write fails, the sink is destroyed
+ * without commit() and the partial file is unlinked.
+ *
+ * @note O_DIRECT is not used: it requires block-aligned buffers and sizes,
+ *       which arbitrary socket reads and chunk boundaries never provide
+ */
+
+UploadSink::UploadSink()
+    : _fd(-1), _written(0), _limit(0), _failed(false), _committed(false) {}
+
+/**
+ * @brief Closes the file and removes it unless the upload was committed
+ */
+UploadSink::~UploadSink() {
+  if (_fd >= 0)
+    close(_fd);
+  if (!_committed && !_path.empty()) {
+    unlink(_path.c_str());
+    LOG_WARN("Upload aborted, removed: " << _path);
+  }
+}
+
+/**
+ * @brief Creates the upload file
+ *
+ * @param path Full path of the file to create (O_EXCL)
+ * @param filename Name reported to the client
+ * @param limit Maximum body bytes that will be written
+ * @param expectedLength Content-Length, or -1 if unknown (chunked)
+ * @param preallocate Reserve expectedLength bytes with posix_fallocate()
+ * @return 0, or errno of the failed open(), or of posix_fallocate() when
+ *         the space is missing (ENOSPC, EDQUOT, EFBIG)
+ */
+int UploadSink::open(const std::string &path, const std::string &filename,
+                     size_t limit, off_t expectedLength, bool preallocate) {
+  _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (_fd < 0) {
+    int error = errno;
+    LOG_ERROR("Failed to create upload file: " << path);
+    return error;
+  }
+  _path = path;
+  _filename = filename;
+  _limit = limit;
+
+  if (preallocate && expectedLength > 0) {
+    int error = posix_fallocate(_fd, 0, expectedLength);
+    if (error != 0) {
+      LOG_WARN("posix_fallocate(" << expectedLength << ") failed: "
+               << strerror(error));
+      // Other errors (EOPNOTSUPP...): the space is simply not reserved
+      if (error == ENOSPC || error == EDQUOT || error == EFBIG)
+        return error; // Destructor removes the file
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Writes body bytes at the end of the file
+ *
+ * After a failure (or past the limit) further data is discarded; the
+ * request is still read to its end so the connection stays in sync.
+ */
+void UploadSink::write(const char *data, size_t length) {
+  if (_failed)
+    return;
+  if (length > _limit - _written) {
+    _failed = true; // Body too large, RequestHandler answers 413
+    return;
+  }
+  size_t done = 0;
+  while (done < length) {
+    ssize_t ret = ::write(_fd, data + done, length - done);
+    if (ret <= 0) {
+      LOG_ERROR("Write failed: " << _path);
+      _failed = true;
+      return;
+    }
+    done += static_cast<size_t>(ret);
+  }
+  _written += length;
+}
+
+/**
+ * @brief Makes the upload durable and keeps the file
+ *
+ * @param synced fsync() already done (on an I/O thread, see dupFd())
+ * @return false if a write failed (the file is then removed on destroy)
+ */
+bool UploadSink::commit(bool synced) {
+  if (_failed || _fd < 0)
+    return false;
+  if (!synced)
+    fsync(_fd);
+  close(_fd);
+  _fd = -1;
+  _committed = true;
+  return true;
+}
+
+/**
+ * @brief Close-on-exec duplicate of the file, for an fsync() elsewhere
+ *
+ * @return New descriptor owned by the caller, or -1
+ */
+int UploadSink::dupFd() const {
+  if (_failed || _fd < 0)
+    return -1;
+  return fcntl(_fd, F_DUPFD_CLOEXEC, 0);
+}
+
+bool UploadSink::failed() const { return _failed; }
+
+const std::string &UploadSink::getPath() const { return _path; }
+
+size_t UploadSink::getWritten() const { return _written; }
+
+const std::string &UploadSink::getFilename() const { return _filename; }
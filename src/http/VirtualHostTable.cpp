@@ -0,0 +1,209 @@
+#include "http/VirtualHostTable.hpp"
+#include <cctype>
+
+/**
+ * @file VirtualHostTable.cpp
+ * @brief Hashed virtual host selection for one listening port
+ *
+ * Picking the server block of a request used to compare the Host header
+ * with every server_name of every block on the port. The Server now builds
+ * one table per listener at init(), and a lookup is a hash of the Host
+ * value (compared in place, no copy):
+ *
+ * - "example.com"    exact name, case-insensitive, trailing dot ignored
+ * - "*.example.com"  any host ending in ".example.com" (not example.com
+ *                    itself); the longest matching wildcard wins
+ * - ".example.com"   both of the above
+ * - no match         the block marked "listen <port> default_server", or
+ *                    the first block of the port
+ *
+ * When two blocks declare the same name the first one keeps it, as with
+ * the former linear scan. Other wildcard forms ("www.example.*") are
+ * plain names here.
+ *
+ * Both tables use open addressing with linear probing, sized to at most
+ * half full, so a miss stops at the first empty slot.
+ */
+
+VirtualHostTable::VirtualHostTable() : _defaultServer(0) {}
+
+VirtualHostTable::~VirtualHostTable() {}
+
+/**
+ * @brief Lowercase form of a server_name, without a trailing dot
+ */
+static std::string normalizeName(const std::string &name) {
+  std::string normalized(name);
+  for (size_t i = 0; i < normalized.size(); ++i)
+    normalized[i] = static_cast<char>(
+        std::tolower(static_cast<unsigned char>(normalized[i])));
+  if (!normalized.empty() && normalized[normalized.size() - 1] == '.')
+    normalized.erase(normalized.size() - 1);
+  return normalized;
+}
+
+/**
+ * @brief Smallest power of two holding count names at most half full
+ */
+static size_t tableSize(size_t count) {
+  size_t size = 8;
+  while (size < count * 2)
+    size *= 2;
+  return size;
+}
+
+/**
+ * @brief FNV-1a hash of a name, case-insensitive
+ *
+ * @param name Name bytes (any case)
+ * @param length Name length
+ * @return Hash of the lowercase name
+ */
+size_t VirtualHostTable::hash(const char *name, size_t length) {
+  size_t value = 2166136261u;
+  for (size_t i = 0; i < length; ++i) {
+    value ^= static_cast<size_t>(
+        std::tolower(static_cast<unsigned char>(name[i])));
+    value *= 16777619u;
+  }
+  return value;
+}
+
+/**
+ * @brief Adds a name unless the table already has it
+ *
+ * @param table Table sized by tableSize()
+ * @param name Normalized name (not empty)
+ * @param server Server index
+ */
+void VirtualHostTable::insert(std::vector<Slot> &table,
+                              const std::string &name, size_t server) {
+  size_t mask = table.size() - 1;
+  size_t index = hash(name.data(), name.size()) & mask;
+  while (!table[index].name.empty()) {
+    if (table[index].name == name)
+      return; // Declared by an earlier block: the first one keeps it
+    index = (index + 1) & mask;
+  }
+  table[index].name = name;
+  table[index].server = server;
+}
+
+/**
+ * @brief Looks up a name (case-insensitive)
+ *
+ * @param table Table to search
+ * @param name Name bytes, as received
+ * @param length Name length
+ * @return Slot, or NULL if absent
+ */
+const VirtualHostTable::Slot *
+VirtualHostTable::find(const std::vector<Slot> &table, const char *name,
+                       size_t length) {
+  if (table.empty())
+    return NULL;
+  size_t mask = table.size() - 1;
+  size_t index = hash(name, length) & mask;
+  while (!table[index].name.empty()) {
+    const std::string &candidate = table[index].name;
+    if (candidate.size() == length) {
+      size_t i = 0;
+      while (i < length &&
+             candidate[i] ==
+                 std::tolower(static_cast<unsigned char>(name[i])))
+        ++i;
+      if (i == length)
+        return &table[index];
+    }
+    index = (index + 1) & mask;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Indexes the server_name entries of the blocks sharing a port
+ *
+ * @param servers Server blocks of the port, in configuration order
+ */
+void VirtualHostTable::build(const std::vector<ServerConfig> &servers) {
+  std::vector<std::string> exactNames;
+  std::vector<size_t> exactServers;
+  std::vector<std::string> suffixNames;
+  std::vector<size_t> suffixServers;
+
+  _defaultServer = 0;
+  bool defaultFound = false;
+  for (size_t i = 0; i < servers.size(); ++i) {
+    if (!defaultFound && servers[i].isDefaultServer()) {
+      _defaultServer = i;
+      defaultFound = true;
+    }
+    const std::vector<std::string> &names = servers[i].getServerNames();
+    for (size_t j = 0; j < names.size(); ++j) {
+      std::string name = normalizeName(names[j]);
+      if (name.size() > 2 && name.compare(0, 2, "*.") == 0) {
+        suffixNames.push_back(name.substr(1));
+        suffixServers.push_back(i);
+      } else if (name.size() > 1 && name[0] == '.') {
+        suffixNames.push_back(name);
+        suffixServers.push_back(i);
+        exactNames.push_back(name.substr(1));
+        exactServers.push_back(i);
+      } else if (!name.empty()) {
+        exactNames.push_back(name);
+        exactServers.push_back(i);
+      }
+    }
+  }
+
+  _exact.assign(exactNames.empty() ? 0 : tableSize(exactNames.size()),
+                Slot());
+  for (size_t i = 0; i < exactNames.size(); ++i)
+    insert(_exact, exactNames[i], exactServers[i]);
+  _suffixes.assign(suffixNames.empty() ? 0 : tableSize(suffixNames.size()),
+                   Slot());
+  for (size_t i = 0; i < suffixNames.size(); ++i)
+    insert(_suffixes, suffixNames[i], suffixServers[i]);
+}
+
+/**
+ * @brief Selects the server block for a Host header value
+ *
+ * @param host Host header bytes ("name", "name:port", "[v6]:port")
+ * @param length Their length (0 = no Host header)
+ * @return Index in the port's config vector
+ */
+size_t VirtualHostTable::lookup(const char *host, size_t length) const {
+  // Port stripped (an IPv6 literal keeps its brackets), then trailing dot
+  size_t end = 0;
+  if (length > 0 && host[0] == '[') {
+    while (end < length && host[end] != ']')
+      ++end;
+    if (end < length)
+      ++end;
+  } else {
+    while (end < length && host[end] != ':')
+      ++end;
+  }
+  if (end > 0 && host[end - 1] == '.')
+    --end;
+  if (end == 0)
+    return _defaultServer;
+
+  const Slot *slot = find(_exact, host, end);
+  if (slot)
+    return slot->server;
+  if (!_suffixes.empty()) {
+    // Leftmost dot first: the longest wildcard wins
+    for (size_t i = 0; i < end; ++i) {
+      if (host[i] == '.') {
+        slot = find(_suffixes, host + i, end - i);
+        if (slot)
+          return slot->server;
+      }
+    }
+  }
+  return _defaultServer;
+}
+
+size_t VirtualHostTable::getDefaultServer() const { return _defaultServer; }
@@ -0,0 +1,75 @@
+#include "network/BufferPool.hpp"
+
+/**
+ * @file BufferPool.cpp
+ * @brief Fixed-size block pool for connection receive buffers
+ *
+ * Every connection used to own a std::string that grew by append while a
+ * request arrived and kept its capacity for the whole life of the
+ * connection, even while idle in keep-alive. Receive data now goes into
+ * BLOCK_SIZE blocks taken from this pool (see ChainBuffer) and handed back
+ * as soon as they are consumed, so an idle connection holds no block and a
+ * busy server recycles the same few blocks instead of calling malloc().
+ *
+ * Up to maxFree released blocks are kept for reuse; beyond that they are
+ * freed, so a burst of connections does not pin its memory forever.
+ *
+ * @note Single-threaded per process, like the rest of the event loop
+ */
+
+/**
+ * @param maxFree Released blocks kept for reuse
+ */
+BufferPool::BufferPool(size_t maxFree)
+    : _maxFree(maxFree), _allocated(0), _acquired(0), _reused(0) {}
+
+/**
+ * @brief Frees the pooled blocks
+ *
+ * @note Blocks still held by connections must be released before
+ */
+BufferPool::~BufferPool() {
+  for (size_t i = 0; i < _free.size(); ++i)
+    delete[] _free[i];
+}
+
+/**
+ * @brief Takes a free block, or allocates one when the pool is empty
+ *
+ * @return Block of BLOCK_SIZE bytes (contents undefined)
+ */
+char *BufferPool::acquire() {
+  ++_acquired;
+  if (!_free.empty()) {
+    char *block = _free.back();
+    _free.pop_back();
+    ++_reused;
+    return block;
+  }
+  ++_allocated;
+  return new char[BLOCK_SIZE];
+}
+
+/**
+ * @brief Puts a block back in the pool (or frees it if the pool is full)
+ *
+ * @param block Block returned by acquire(), NULL is ignored
+ */
+void BufferPool::release(char *block) {
+  if (!block)
+    return;
+  if (_free.size() < _maxFree) {
+    _free.push_back(block);
+    return;
+  }
+  delete[] block;
+  --_allocated;
+}
+
+size_t BufferPool::getInUse() const { return _allocated - _free.size(); }
+
+size_t BufferPool::getFree() const { return _free.size(); }
+
+unsigned long BufferPool::getAcquired() const { return _acquired; }
+
+unsigned long BufferPool::getReused() const { return _reused; }
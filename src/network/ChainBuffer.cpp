@@ -0,0 +1,164 @@
+#include "network/ChainBuffer.hpp"
+
+/**
+ * @file ChainBuffer.cpp
+ * @brief Chained pooled blocks holding received, not yet parsed bytes
+ *
+ * Replaces the per-connection std::string receive buffer:
+ *
+ * - recv() writes straight into the tail block, no intermediate copy
+ * - consuming parsed bytes moves the block's start offset; nothing is
+ *   shifted (std::string::erase(0, n) moved the whole pipelined remainder)
+ * - when more bytes arrive than one block holds (pipelined requests while
+ *   a response is in flight), another block is chained instead of
+ *   reallocating and copying
+ * - a busy socket can be read with one readv() over several blocks
+ *   (prepare(iov, n)); blocks the read did not reach go straight back
+ * - a block is released to the BufferPool as soon as it is fully
+ *   consumed, so an idle keep-alive connection holds no block at all
+ *
+ * Readers walk the chain with front() + consume(); the request parser is
+ * resumable, so feeding it one block at a time is equivalent to feeding it
+ * the concatenation.
+ */
+
+ChainBuffer::ChainBuffer(BufferPool *pool)
+    : _pool(pool), _size(0), _prepared(0) {}
+
+ChainBuffer::~ChainBuffer() { clear(); }
+
+bool ChainBuffer::empty() const { return _size == 0; }
+
+size_t ChainBuffer::size() const { return _size; }
+
+size_t ChainBuffer::blockCount() const { return _blocks.size(); }
+
+/**
+ * @brief Returns where the next received bytes should be written
+ *
+ * @param room Receives the writable bytes at the returned pointer (> 0)
+ * @return Pointer into the tail block
+ */
+char *ChainBuffer::prepare(size_t &room) {
+  if (_blocks.empty() || _blocks.back().end == BufferPool::BLOCK_SIZE)
+    pushBlock();
+  _prepared = _blocks.size() - 1;
+  Block &tail = _blocks.back();
+  room = BufferPool::BLOCK_SIZE - tail.end;
+  return tail.data + tail.end;
+}
+
+/**
+ * @brief Returns writable space spread over several blocks (for readv())
+ *
+ * The first region is the room left in the tail block, the others are
+ * whole new blocks. commit() gives back the ones the read did not reach.
+ *
+ * @param iov Receives the regions
+ * @param maxBlocks Capacity of iov (>= 1)
+ * @return Regions filled
+ */
+size_t ChainBuffer::prepare(struct iovec *iov, size_t maxBlocks) {
+  size_t room;
+  iov[0].iov_base = prepare(room);
+  iov[0].iov_len = room;
+  size_t count = 1;
+  while (count < maxBlocks) {
+    pushBlock();
+    iov[count].iov_base = _blocks.back().data;
+    iov[count].iov_len = BufferPool::BLOCK_SIZE;
+    ++count;
+  }
+  return count;
+}
+
+/**
+ * @brief Appends an empty block from the pool
+ */
+void ChainBuffer::pushBlock() {
+  Block block;
+  block.data = _pool ? _pool->acquire() : new char[BufferPool::BLOCK_SIZE];
+  block.start = 0;
+  block.end = 0;
+  _blocks.push_back(block);
+}
+
+/**
+ * @brief Accounts for bytes written at the space from prepare()
+ *
+ * Fills the prepared blocks in order; blocks left empty at the tail are
+ * released at once (commit(0) after a failed read releases all of them).
+ *
+ * @param length Bytes written (at most the room reported by prepare())
+ */
+void ChainBuffer::commit(size_t length) {
+  for (size_t i = _prepared; i < _blocks.size() && length > 0; ++i) {
+    size_t take = BufferPool::BLOCK_SIZE - _blocks[i].end;
+    if (take > length)
+      take = length;
+    _blocks[i].end += take;
+    _size += take;
+    length -= take;
+  }
+  while (!_blocks.empty() && _blocks.back().end == _blocks.back().start) {
+    char *data = _blocks.back().data;
+    if (_pool)
+      _pool->release(data);
+    else
+      delete[] data;
+    _blocks.pop_back();
+  }
+  _prepared = _blocks.size();
+}
+
+/**
+ * @brief First contiguous run of unconsumed bytes
+ *
+ * @param length Receives the number of bytes at the returned pointer
+ * @return Pointer to the bytes, or "" with length 0 when empty
+ */
+const char *ChainBuffer::front(size_t &length) const {
+  if (_blocks.empty()) {
+    length = 0;
+    return "";
+  }
+  const Block &head = _blocks.front();
+  length = head.end - head.start;
+  return head.data + head.start;
+}
+
+/**
+ * @brief Discards bytes from the head of the chain
+ *
+ * @param length Bytes to drop (clamped to size())
+ */
+void ChainBuffer::consume(size_t length) {
+  while (length > 0 && !_blocks.empty()) {
+    Block &head = _blocks.front();
+    size_t available = head.end - head.start;
+    size_t take = length < available ? length : available;
+    head.start += take;
+    _size -= take;
+    length -= take;
+    if (head.start == head.end)
+      popFront();
+  }
+}
+
+/**
+ * @brief Releases the head block to the pool
+ */
+void ChainBuffer::popFront() {
+  char *data = _blocks.front().data;
+  if (_pool)
+    _pool->release(data);
+  else
+    delete[] data;
+  _blocks.erase(_blocks.begin());
+}
+
+void ChainBuffer::clear() {
+  while (!_blocks.empty())
+    popFront();
+  _size = 0;
+}
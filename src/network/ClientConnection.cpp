@@ -1,14 +1,35 @@
 #include "network/ClientConnection.hpp"
+#include "cgi/CGIHandler.hpp"
+#include "core/AllocCounter.hpp"
+#include "core/Logger.hpp"
+#include "core/Metrics.hpp"
+#include "core/RequestTrace.hpp"
+#include "http/UploadSink.hpp"
+#include "network/ConnectionPool.hpp"
 #include <algorithm>
 #include <arpa/inet.h>
+#include <cctype>
 #include <cerrno>
 #include <csignal>
 #include <cstring>
-#include <iostream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sstream>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#define WEBSERV_HAVE_SENDFILE 1
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__DragonFly__)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#define WEBSERV_HAVE_SENDFILE 1
+#endif
+
 /**
  * @file ClientConnection.cpp
  * @brief Client connection state management and I/O handling
@@ -18,15 +39,30 @@
  * - Socket file descriptor and client address
  * - Raw request data buffer and parsed HttpRequest
  * - Response data buffer and write progress
+ * - Gathered writes: header block, in-memory body and memory segments go
+ *   out in one writev() straight from where they live (nothing is
+ *   concatenated into a single string first)
+ * - File-backed response body (sendfile() offset tracking)
+ * - Draining: one readiness event reads (writes) until the socket has no
+ *   more data (room) or the io_read_budget (io_write_budget) is spent, so
+ *   a busy connection costs fewer poll() rounds without starving others
  * - CGI execution state (for async CGI handling)
  * - Keep-alive and pipelining support
+ * - HTTP/2 (h2c, "listen ... http2"): after the client preface or an
+ *   "Upgrade: h2c" request, received bytes go to an Http2Session and the
+ *   frames it produces are sent through _batch
+ * - TLS ("listen ... ssl"): the handshake advances on each readiness
+ *   event, then bytes go through TlsConnection (receive() / transmit());
+ *   with kTLS the kernel encrypts and sendfile() keeps working
  *
  * The connection follows this lifecycle:
- * 1. Created by Server when accept() returns new client fd
- * 2. readRequest() accumulates data until HTTP request is complete
+ * 1. Created by Server (ConnectionPool) when accept() returns new client fd
+ * 2. readRequest() takes a ClientExchange from the pool on the first bytes
+ *    and accumulates data until HTTP request is complete
  * 3. processRequest() generates HttpResponse via RequestHandler
  * 4. sendResponse()/flushWrite() sends response data
- * 5. If keep-alive: resetForNextRequest() and repeat from step 2
+ * 5. If keep-alive: resetForNextRequest(), the exchange goes back to the
+ *    pool if nothing is buffered, and repeat from step 2
  * 6. Destructor cleans up socket and any running CGI process
  *
  * @note Does not check errno after recv/send per subject requirements
@@ -34,58 +70,164 @@
  * @see RequestHandler for request processing
  */
 
+/**
+ * @brief No process-wide object: every feature off, no pool yet
+ */
+ConnectionServices::ConnectionServices()
+    : fileCache(NULL), responseCache(NULL), bufferPool(NULL),
+      fastcgiPool(NULL), listingCache(NULL), compression(NULL), ioPool(NULL),
+      upstreamPool(NULL), cgiCache(NULL), rateLimiter(NULL), mimeTypes(NULL),
+      pool(NULL), readBudget(0), writeBudget(0), draining(false) {}
+
+/**
+ * @brief Fresh request state, wired to the process-wide caches
+ *
+ * The per-connection parts of the handler (error pages, virtual hosts,
+ * SNI server) are set each time the exchange is attached.
+ *
+ * @param services Caches and policies the static handler uses
+ */
+ClientExchange::ClientExchange(const ConnectionServices &services)
+    : uploadSink(NULL), bodyLimit(0), batchOffset(0), responseQueued(false),
+      bodyData(NULL), bodyLength(0), writeOffset(0), segmentIndex(0),
+      segmentSent(0), bodyFileSendfile(true), bodyFileStarted(false),
+      requestComplete(false), cgiState(CGI_NONE), cgiPipeFd(-1), cgiPid(0),
+      cgiFailed(false), cgiStdinFd(-1), cgiInputSent(0), cgiBuffered(false),
+      cgiStreaming(false), cgiChunked(false), cgiPaused(false),
+      cgiStreamed(0), proxyGroup(NULL), proxyReused(false),
+      cacheFilling(false),
+      cacheWaiting(false), cacheBypass(false), cachePolicy(NULL),
+      limitChecked(false), limitDelayed(false), limitResume(0), rateStart(0),
+      rateSent(0), ratePaused(false), rateResume(0), ioTask(NULL),
+      ioRounds(0), parseNs(0), routeNs(0), handlerNs(0), flushStart(0),
+      cgiStart(0), matchedLocation(NULL), requestStart(0), parsedAt(0),
+      handlerAt(0), ioStart(0), ioNs(0), cgiAt(0), cgiNs(0), allocMark(0) {
+  requestHandler.setCaches(services.fileCache, services.responseCache,
+                           services.listingCache);
+  requestHandler.setCompression(services.compression);
+  requestHandler.setMimeTypes(services.mimeTypes);
+  requestHandler.setArena(&arena);
+}
+
 /**
  * @brief Constructor with socket, address, and server configurations
  *
  * Creates a new client connection with the accepted socket and potential
- * server configurations for this port.
+ * server configurations for this port. No request state is held until
+ * the first bytes arrive (see attachExchange()).
  *
  * @param fd Client socket file descriptor from accept()
  * @param addr Client address structure from accept()
- * @param servCandidateConfigs Server configs matching the listening port
+ * @param config Configuration the connection keeps a reference on
+ * @param listener Server blocks of the listening port (inside config)
+ * @param services Process-wide caches, pools and I/O budgets (outlive the
+ *        connection)
  *
  * @note The final ServerConfig is selected later based on Host header
  */
-ClientConnection::ClientConnection(
-    int fd, const sockaddr_in &addr,
-    const std::vector<ServerConfig> &servCandidateConfigs)
-    : _clientFd(fd), _addr(addr), _closed(false), _rawRequest(""),
-      _writeBuffer(""), _writeOffset(0), _lastActivity(time(NULL)),
-      _requestComplete(false), _servCandidateConfigs(servCandidateConfigs),
-      _cgiState(CGI_NONE), _cgiPipeFd(-1), _cgiPid(0) {}
+ClientConnection::ClientConnection(int fd, const sockaddr_in &addr,
+                                   ConfigSnapshot *config,
+                                   const ListenerConfig &listener,
+                                   const ConnectionServices &services)
+    : _clientFd(fd), _addr(addr), _closed(false),
+      _tcpNoPush(listener.tcpNoPush), _corked(false),
+      _http2(listener.options.http2),
+      _prefaceChecked(!listener.options.http2), _keepAliveIdle(false),
+      _sniServer(0), _readBuffer(services.bufferPool), _h2(NULL),
+      _tls(listener.tls ? new TlsConnection(*listener.tls, fd) : NULL),
+      _lastActivity(time(NULL)), _phaseStart(_lastActivity), _config(config),
+      _listener(listener),
+      _services(&services), _ex(NULL) {
+  _config->retain();
+  if (listener.tcpNoDelay) {
+    // Header blocks and small bodies leave at once instead of waiting for
+    // the ACK of the previous segment (Nagle + delayed ACK: ~40 ms)
+    int on = 1;
+    setsockopt(_clientFd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  }
+}
 
 /**
  * @brief Destructor - cleans up connection resources
  *
  * Performs cleanup in this order:
  * 1. Kill any running CGI process (SIGKILL + waitpid)
- * 2. Close CGI pipe if open
+ * 2. Close CGI pipes if open
  * 3. Close client socket
+ * 4. Release the configuration snapshot
+ *
+ * A task still running on an I/O thread is only cancelled: the pool
+ * deletes it when it comes back. A cgi_cache lock held or waited for is
+ * given up, so the other requests for the key go on. The request state
+ * is reset and goes back to the pool.
  */
 ClientConnection::~ClientConnection() {
-  // Cleanup CGI process if running
-  if (_cgiPid > 0) {
-    std::cout << "[Info] Killing CGI process " << _cgiPid << " for fd "
-              << _clientFd << std::endl;
-    kill(_cgiPid, SIGKILL);
-    int status;
-    waitpid(_cgiPid, &status, 0);
-  }
+  delete _h2; // Refers to the exchange's handler
 
-  // Close CGI pipe if open
-  if (_cgiPipeFd != -1) {
-    close(_cgiPipeFd);
-    _cgiPipeFd = -1;
+  if (_ex) {
+    // Cleanup CGI process if running
+    if (_ex->cgiPid > 0) {
+      LOG_INFO("Killing CGI process " << _ex->cgiPid << " for fd "
+               << _clientFd);
+      kill(_ex->cgiPid, SIGKILL);
+      int status;
+      waitpid(_ex->cgiPid, &status, 0);
+      _ex->cgiPid = 0;
+    }
+    resumeCacheWait(true);
+    // Cancels the I/O task, closes CGI pipes (a backend connection is
+    // handed back), gives up a cache fill, removes a partial upload
+    resetForNextRequest();
+    detachExchange();
   }
 
+  delete _tls; // close_notify, before the socket goes
+
   // Close client socket
   if (_clientFd != -1) {
-    std::cout << "[Info] Closing connection with " << getIp()
-              << " (fd: " << _clientFd << ")" << std::endl;
+    LOG_DEBUG("Closing connection with " << getIp() << " (fd: " << _clientFd
+              << ")");
     close(_clientFd);
     _clientFd = -1;
   }
   _closed = true;
+  _config->release(); // May delete a configuration replaced by a reload
+}
+
+/**
+ * @brief Takes request state from the pool for the coming request
+ *
+ * The exchange comes back reset; only what depends on this connection
+ * (configuration, port, SNI choice) is set on its handler.
+ */
+void ClientConnection::attachExchange() {
+  _ex = _services->pool->acquireExchange(*_services);
+  _ex->requestHandler.setErrorPages(&_config->getErrorPages());
+  _ex->requestHandler.setVirtualHosts(&_listener.hosts);
+  _ex->requestHandler.setSniServer(_sniServer);
+  _ex->requestHandler.setStreamLimiter(NULL, 0);
+  _ex->allocMark = AllocCounter::count();
+}
+
+/**
+ * @brief Hands the request state back to the pool
+ *
+ * Called once resetForNextRequest() ran: idle in keep-alive, or closing.
+ * What that reset keeps for a pipelined request (held responses, a
+ * limit_req hold, the gzip stream of a cut stream) is cleared here, and a
+ * large batch buffer is given back rather than pinned in the pool.
+ */
+void ClientConnection::detachExchange() {
+  if (_ex->batch.capacity() > HttpResponse::KEEP_CAPACITY)
+    std::string().swap(_ex->batch);
+  else
+    _ex->batch.clear();
+  _ex->batchOffset = 0;
+  _ex->limitDelayed = false;
+  _ex->cgiGzip.end();
+  _ex->bodyLimit = 0;
+  _services->pool->releaseExchange(_ex);
+  _ex = NULL;
 }
 
 /**
@@ -109,419 +251,1406 @@ std::string ClientConnection::getIp() const {
   return "Unknown IP";
 }
 
+uint32_t ClientConnection::getAddr() const { return _addr.sin_addr.s_addr; }
+
 /**
  * @brief Reads data from the client socket
  *
- * Reads available data from the socket into the request buffer.
- * Attempts to parse the request after each read.
+ * Receives straight into the pooled read buffer and parses what arrived,
+ * repeating while the socket keeps filling every byte offered: the first
+ * call offers the room left in the tail block, later ones a readv() over
+ * up to MAX_READ_BLOCKS blocks (64 KB). The loop stops on a short read
+ * (socket drained), once the request is complete, or when _services->readBudget
+ * bytes were read in this event, so one fast uploader cannot monopolize
+ * the poll loop.
  *
  * Error handling (per subject requirement - no errno checking):
- * - bytesRead < 0: Treat as error, mark connection closed
- * - bytesRead == 0: Client closed connection gracefully
+ * - bytesRead < 0 on the first call: Treat as error, mark connection closed
+ * - bytesRead == 0 on the first call: Client closed connection gracefully
+ * - either one after earlier reads: Stop; the bytes already read are
+ *   handled and the next poll() round reports the condition again
  * - bytesRead > 0: Append to buffer and try parsing
  *
  * @return true if read successful or request incomplete, false on error/close
  *
+ * On TLS the handshake is stepped first; once it is done, decrypted bytes
+ * OpenSSL still holds are read on before returning, since poll() cannot
+ * report them.
+ *
  * @note Should only be called when poll() indicates POLLIN
  * @note Supports HTTP pipelining by preserving unparsed data
  */
 bool ClientConnection::readRequest() {
-  char buffer[4096];
-  int bytesRead = recv(_clientFd, buffer, sizeof(buffer), 0);
-
-  if (bytesRead < 0) {
-    // poll() indicated POLLIN but recv() failed - real error
-    // (errno not checked per subject requirement)
-    std::cerr << "❌ [Error] recv() failed for client fd " << _clientFd << "\n";
-    _closed = true;
-    return false;
-  } else if (bytesRead == 0) {
-    // Client closed connection gracefully
-    std::cout << "[Info] Client closed connection (fd: " << _clientFd << ")\n";
-    _closed = true;
-    return false;
+  if (_tls && !_tls->isEstablished()) {
+    if (!stepHandshake())
+      return false;
+    if (!_tls->isEstablished())
+      return true;
   }
+  size_t total = 0;
+  size_t blocks = 1;
+  while (true) {
+    struct iovec iov[MAX_READ_BLOCKS];
+    size_t count = _readBuffer.prepare(iov, blocks);
+    size_t offered = 0;
+    for (size_t i = 0; i < count; ++i)
+      offered += iov[i].iov_len;
+    ssize_t bytesRead = receive(iov, static_cast<int>(count));
 
-  // bytesRead > 0: Append data to request buffer
-  std::cout << "\n[Info] Reading request (fd: " << _clientFd << ")\n";
-  _rawRequest.append(buffer, bytesRead);
+    if (bytesRead <= 0) {
+      _readBuffer.commit(0); // Gives the untouched blocks back
+      if (total > 0 || bytesRead == TlsConnection::AGAIN)
+        break; // Nothing more for now
+      if (bytesRead < 0) {
+        // poll() indicated POLLIN but recv() failed - real error
+        // (errno not checked per subject requirement)
+        LOG_ERROR("recv() failed for client fd " << _clientFd);
+      } else {
+        // Client closed connection gracefully
+        LOG_DEBUG("Client closed connection (fd: " << _clientFd << ")");
+      }
+      _closed = true;
+      return false;
+    }
 
-  std::cout << _rawRequest;
+    // bytesRead > 0: Keep the received bytes in the request buffer
+    _readBuffer.commit(static_cast<size_t>(bytesRead));
+    Metrics::add(Metrics::BYTES_IN, static_cast<uint64_t>(bytesRead));
+    LOG_DEBUG("Received " << bytesRead << " bytes (fd: " << _clientFd
+              << "): "
+              << LogExcerpt(static_cast<char *>(iov[0].iov_base),
+                            std::min(static_cast<size_t>(bytesRead),
+                                     static_cast<size_t>(iov[0].iov_len))));
+    total += static_cast<size_t>(bytesRead);
+    _lastActivity = time(NULL);
+    if (_keepAliveIdle)
+      _phaseStart = _lastActivity; // client_header_timeout starts
+    _keepAliveIdle = false;
+    if (!_ex)
+      attachExchange(); // First bytes of a request
 
-  _lastActivity = time(NULL);
+    if (!_prefaceChecked) {
+      // HTTP/2 with prior knowledge: decided by the first 24 bytes
+      size_t length;
+      const char *data = _readBuffer.front(length);
+      if (!Http2Session::matchesPreface(data, length))
+        _prefaceChecked = true;
+      else if (length >= Http2Session::PREFACE_LENGTH)
+        startHttp2();
+      else
+        continue; // Could still be the preface: wait for more
+    }
+    if (_h2) {
+      feedHttp2();
+      if ((static_cast<size_t>(bytesRead) < offered ||
+           total >= _services->readBudget) &&
+          !(_tls && _tls->hasPending()))
+        break;
+      if (blocks < MAX_READ_BLOCKS)
+        blocks *= 2;
+      continue;
+    }
 
-  // Try to parse the accumulated request data
-  std::cout << "[Debug] Parsing request from client fd " << _clientFd
-            << std::endl;
-  if (_httpRequest.parse(_rawRequest)) {
-    std::cout << "✅ [Info] Request complete (fd: " << _clientFd << ")\n";
-    _requestComplete = true;
-
-    // Pipelining support: remove only parsed bytes, keep remainder
-    int parsedBytes = _httpRequest.getParsedBytes();
-    if (parsedBytes > 0 && (size_t)parsedBytes <= _rawRequest.size()) {
-      _rawRequest.erase(0, parsedBytes);
-      std::cout << "[Debug] Pipelining: erased " << parsedBytes
-                << " bytes. Remaining in buffer: " << _rawRequest.size()
-                << std::endl;
-    } else {
-      _rawRequest.clear();
+    // A response (CGI, I/O task) is still in flight for the current
+    // request: only buffer the pipelined bytes, they are parsed once it
+    // completes.
+    if (_ex->requestComplete || hasPendingWrite() || _ex->cgiState != CGI_NONE ||
+        _ex->ioTask || _ex->cacheWaiting || _ex->limitDelayed) {
+      if (_tls && _tls->hasPending())
+        continue;
+      break;
     }
-  } else if (_httpRequest.headersComplete()) {
-    // Early body size check using Content-Length header
-    if (_httpRequest.getContentLength() > 0) {
-      size_t maxBody = 1024 * 1024; // 1MB default
-      if (!_servCandidateConfigs.empty()) {
-        maxBody = _servCandidateConfigs[0].getClientMaxBodySize();
-      }
 
-      if ((size_t)_httpRequest.getContentLength() > maxBody) {
-        std::cout << "⚠️ [Warning] Body too large ("
-                  << _httpRequest.getContentLength() << " > " << maxBody
-                  << "). Stopping read.\n";
-        _requestComplete = true; // Force completion for 413 response
-      }
+    LOG_DEBUG("Parsing request from client fd " << _clientFd);
+    uint64_t parseStart = Metrics::now();
+    if (_ex->requestStart == 0)
+      _ex->requestStart = parseStart;
+    bool complete = feedParser();
+    uint64_t parseEnd = Metrics::now();
+    _ex->parseNs += parseEnd - parseStart;
+    if (complete) {
+      LOG_DEBUG("✅ Request complete (fd: " << _clientFd << ")");
+      _ex->requestComplete = true;
+      _ex->parsedAt = parseEnd;
+      // Pipelining support: whatever is left belongs to the next request
+      LOG_DEBUG("Pipelining: remaining in buffer: " << _readBuffer.size());
+      if (_tls && _tls->hasPending())
+        continue;
+      break;
     }
+
+    if ((static_cast<size_t>(bytesRead) < offered ||
+         total >= _services->readBudget) &&
+        !(_tls && _tls->hasPending()))
+      break;
+    if (blocks < MAX_READ_BLOCKS)
+      blocks *= 2;
   }
   return true;
 }
 
 /**
- * @brief Processes a complete HTTP request
+ * @brief Advances the TLS handshake
  *
- * Delegates request handling to RequestHandler and prepares the response
- * for sending. For CGI requests, may return early with pending state.
+ * Once established, the server block SNI picked becomes the one a
+ * request without Host header goes to.
  *
- * @return true on success (includes CGI pending state)
+ * @return false if the handshake failed (connection marked closed)
+ */
+bool ClientConnection::stepHandshake() {
+  int state = _tls->isValid() ? _tls->handshake() : -1;
+  if (state < 0) {
+    LOG_DEBUG("TLS handshake failed (fd: " << _clientFd << ")");
+    _closed = true;
+    return false;
+  }
+  if (state == 1) {
+    _lastActivity = time(NULL);
+    _sniServer = _tls->getServerIndex();
+    if (_ex)
+      _ex->requestHandler.setSniServer(_sniServer);
+    LOG_DEBUG("TLS established (fd: " << _clientFd << ")"
+              << (_tls->isHttp2() ? ", ALPN h2" : "")
+              << (_tls->hasKernelSend() ? ", kTLS" : ""));
+  }
+  return true;
+}
+
+/**
+ * @brief readv() on the socket, or through TLS
  *
- * @note Only processes if _requestComplete is true
- * @note For CGI requests, response is set later via setCGIResponse()
+ * @return Bytes read, 0 on close, -1 on error, TlsConnection::AGAIN if
+ *         TLS has no application data yet
  */
-bool ClientConnection::processRequest() {
-  if (!_requestComplete)
-    return true;
+ssize_t ClientConnection::receive(const struct iovec *iov, int count) {
+  if (_tls)
+    return _tls->readv(iov, count);
+  return readv(_clientFd, iov, count);
+}
 
-  // Guard: Don't reprocess if CGI is already running
-  if (_cgiState != CGI_NONE)
-    return true;
+/**
+ * @brief writev() on the socket, or through TLS unless the kernel encrypts
+ *
+ * @return Bytes written, -1 on error, TlsConnection::AGAIN if TLS could
+ *         not write yet
+ */
+ssize_t ClientConnection::transmit(const struct iovec *iov, int count) {
+  if (_tls && !_tls->hasKernelSend())
+    return _tls->writev(iov, count);
+  return writev(_clientFd, iov, count);
+}
 
-  // Process request through handler
-  _httpResponse =
-      _requestHandler.handleRequest(_httpRequest, _servCandidateConfigs, this);
+/**
+ * @brief Feeds the unconsumed buffered bytes to the request parser
+ *
+ * The parser keeps its own state, so what it consumed is dropped right
+ * away and never scanned again. When the headers of a request with a body
+ * complete, the body is routed before any of it is consumed: a static
+ * upload gets a sink and is written to disk as it arrives.
+ *
+ * Bodies over the matched location's client_max_body_size (declared by
+ * Content-Length, or reached while de-chunking) are not read any further:
+ * the request completes at once and is answered 413, connection close.
+ *
+ * @return true if the request is complete
+ */
+bool ClientConnection::feedParser() {
+  bool hadHeaders = _ex->httpRequest.headersComplete();
+  bool complete = parseBuffered();
 
-  // If CGI is pending, wait for async completion
-  if (_httpResponse.isCGIPending()) {
-    std::cout << "[CGI] Pending for fd: " << _clientFd << std::endl;
-    return true;
+  if (!hadHeaders && !complete && _ex->httpRequest.headersComplete()) {
+    _ex->bodyLimit =
+        _ex->requestHandler.getBodyLimit(_ex->httpRequest, _listener.servers);
+    if (_ex->httpRequest.getContentLength() > 0 &&
+        static_cast<size_t>(_ex->httpRequest.getContentLength()) > _ex->bodyLimit) {
+      LOG_WARN("Body too large (" << _ex->httpRequest.getContentLength() << " > "
+               << _ex->bodyLimit << "). Stopping read.");
+      _ex->httpRequest.stopReadingBody();
+      return true; // Completed early for the 413 response
+    }
+    _phaseStart = time(NULL); // client_body_timeout starts
+    dropUploadSink();
+    int refused = 0;
+    _ex->uploadSink = _ex->requestHandler.openUploadSink(
+        _ex->httpRequest, _listener.servers, refused);
+    if (refused != 0) {
+      LOG_WARN("Upload refused before its body (" << refused
+               << "). Stopping read.");
+      _ex->httpRequest.rejectBody(refused);
+      return true; // Completed early for the error response
+    }
+    _ex->httpRequest.setUploadSink(_ex->uploadSink);
+    complete = parseBuffered();
   }
 
-  // Build response for non-CGI or sync CGI requests
-  _writeBuffer = _httpResponse.buildResponse();
-  _writeOffset = 0;
-
-  return true;
+  if (!complete && _ex->httpRequest.getBodySize() > _ex->bodyLimit) {
+    LOG_WARN("Chunked body too large (> " << _ex->bodyLimit << "). Stopping read.");
+    _ex->httpRequest.stopReadingBody();
+    return true;
+  }
+  return complete;
 }
 
 /**
- * @brief Initiates response sending
+ * @brief Runs the parser over the buffered blocks, in order
  *
- * Wrapper that calls flushWrite() to send pending response data.
+ * Parsed bytes are consumed from the read buffer (blocks emptied on the
+ * way go back to the pool). Stops when the request is complete or the
+ * parser leaves bytes unconsumed (end of headers before a body, so the
+ * caller can route it first; or pipelined bytes of the next request).
  *
- * @return Result of flushWrite()
+ * @return true if the request is complete
  */
-bool ClientConnection::sendResponse() { return flushWrite(); }
+bool ClientConnection::parseBuffered() {
+  bool complete;
+  do {
+    size_t length;
+    const char *data = _readBuffer.front(length);
+    complete = _ex->httpRequest.parse(data, length);
+    size_t used = static_cast<size_t>(_ex->httpRequest.getParsedBytes());
+    _readBuffer.consume(used);
+    if (complete || used < length)
+      break;
+  } while (!_readBuffer.empty());
+  return complete;
+}
 
 /**
- * @brief Sends pending response data to the client
- *
- * Attempts to send all remaining data in _writeBuffer. Handles partial
- * sends by updating _writeOffset.
- *
- * Error handling (per subject requirement - no errno checking):
- * - s > 0: Data sent successfully
- * - s == -1: Treat as error, mark connection closed
- * - s == 0: Peer closed connection
+ * @brief Destroys the upload sink (unlinking the file unless committed)
+ */
+void ClientConnection::dropUploadSink() {
+  delete _ex->uploadSink;
+  _ex->uploadSink = NULL;
+  _ex->httpRequest.setUploadSink(NULL);
+}
+
+/**
+ * @brief Processes a complete HTTP request
  *
- * After complete send:
- * - If !keep-alive: Mark connection closed
- * - If keep-alive: Reset for next request
+ * Delegates request handling to RequestHandler and prepares the response
+ * for sending. For CGI requests, may return early with pending state.
  *
- * @return true if send successful or buffer empty, false on error
+ * @return true on success (includes CGI pending state)
  *
- * @note Should only be called when poll() indicates POLLOUT
+ * @note Only processes if _ex->requestComplete is true
+ * @note For CGI requests, response is set later via setCGIResponse()
+ * @note A request parked on an I/O task runs again after completeIo()
  */
-bool ClientConnection::flushWrite() {
-  if (_writeBuffer.empty())
+bool ClientConnection::processRequest() {
+  if (!_ex || !_ex->requestComplete)
     return true;
 
-  // Safety check: all data already sent
-  if (_writeOffset >= _writeBuffer.size()) {
-    _writeBuffer.clear();
-    _writeOffset = 0;
+  // Guard: Don't reprocess if CGI or an I/O task is already running
+  if (_ex->cgiState != CGI_NONE || _ex->ioTask || _ex->cacheWaiting || _ex->limitDelayed)
     return true;
-  }
 
-  const char *buf = _writeBuffer.data() + _writeOffset;
-  size_t remaining = _writeBuffer.size() - _writeOffset;
+  if (_ex->ioRounds == 0)
+    Metrics::observe(Metrics::PHASE_PARSE, _ex->parseNs);
+
+  if (_http2 && !_h2 && Http2Session::isUpgrade(_ex->httpRequest)) {
+    _ex->batch.append("HTTP/1.1 101 Switching Protocols\r\n"
+                  "Connection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+    startHttp2();
+    return true;
+  }
 
-  ssize_t s = send(_clientFd, buf, remaining, 0);
+  // Process request through handler (the response object is reused)
+  _ex->httpResponse.reset();
+  _ex->requestHandler.setDeferIo(_services->ioPool && _services->ioPool->isEnabled() &&
+                             _ex->ioRounds < MAX_IO_ROUNDS);
+  uint64_t handlerStart = Metrics::now();
+  if (_ex->handlerAt == 0)
+    _ex->handlerAt = handlerStart;
+  _ex->requestHandler.handleRequest(_ex->httpRequest, _listener.servers,
+                                _ex->httpResponse, this);
+  uint64_t route = _ex->requestHandler.getRouteTime();
+  _ex->routeNs += route;
+  _ex->handlerNs += Metrics::now() - handlerStart - route;
+  _ex->matchedLocation = _ex->requestHandler.getMatchedLocation();
 
-  if (s > 0) {
-    _writeOffset += static_cast<size_t>(s);
-    _lastActivity = time(NULL);
+  // Blocking file I/O needed: park until an I/O thread did it, then the
+  // request runs again (see completeIo())
+  IoTask *task = _ex->requestHandler.takeDeferredIo();
+  if (task) {
+    _ex->ioTask = task;
+    _ex->ioStart = Metrics::now();
+    ++_ex->ioRounds;
+    task->setOwner(this);
+    _services->ioPool->submit(task);
+    LOG_DEBUG("[IO] Parked fd " << _clientFd << " on an I/O thread");
+    return true;
+  }
 
-    std::cout << "[Info] Sending response (fd: " << _clientFd
-              << "): " << _writeOffset << "/" << _writeBuffer.size()
-              << " bytes\n";
+  // Another request is filling the same cgi_cache key: the request runs
+  // again once it is done (see resumeCacheWait())
+  if (_ex->cacheWaiting) {
+    LOG_DEBUG("[cache] fd " << _clientFd << " waits for " << _ex->cacheKey);
+    return true;
+  }
 
-    // Check if all data sent
-    if (_writeOffset >= _writeBuffer.size()) {
-      _writeBuffer.clear();
-      _writeOffset = 0;
+  // Held by limit_req: the request runs again at _ex->limitResume (the Server
+  // wakes it from the timer wheel), without being accounted twice
+  if (_ex->limitDelayed) {
+    LOG_DEBUG("[limit_req] fd " << _clientFd << " delayed until "
+              << _ex->limitResume);
+    return true;
+  }
+  Metrics::observe(Metrics::PHASE_ROUTE, _ex->routeNs);
+  Metrics::observe(Metrics::PHASE_HANDLER, _ex->handlerNs);
 
-      // Handle keep-alive vs close
-      if (!_httpRequest.isKeepAlive()) {
-        _closed = true;
-        std::cout << "✅ [Info] Response sent (fd: " << _clientFd
-                  << ") → Connection: close" << std::endl;
-      } else {
-        resetForNextRequest();
-        std::cout << "✅ [Info] Response sent (fd: " << _clientFd
-                  << ") → Connection: keep-alive\n    Waiting for new request"
-                  << std::endl;
-      }
-    }
+  // If CGI is pending, wait for async completion
+  if (_ex->httpResponse.isCGIPending()) {
+    LOG_DEBUG("[CGI] Pending for fd: " << _clientFd);
     return true;
-  } else if (s == -1) {
-    // poll() indicated POLLOUT but send() failed - real error
-    std::cerr << "❌ [Error] send() failed for fd " << _clientFd << "\n";
-    _closed = true;
-    return false;
-  } else { // s == 0
-    // Peer closed connection during send
-    std::cout << "[Info] Client closed during send (fd: " << _clientFd << ")\n";
-    _closed = true;
-    return false;
   }
+
+  // Queue response for non-CGI or sync CGI requests
+  queueResponse();
+  return true;
 }
 
 /**
- * @brief Checks if there is pending data to send
+ * @brief Switches the connection to HTTP/2
  *
- * @return true if _writeBuffer has unsent data
- */
-bool ClientConnection::hasPendingWrite() const { return !_writeBuffer.empty(); }
-
-/**
- * @brief Marks the connection as closed
+ * Either the client preface is buffered (prior knowledge), or the current
+ * request asked for "Upgrade: h2c" and its 101 is queued: that request
+ * becomes stream 1, and what follows it in the buffer is HTTP/2.
  */
-void ClientConnection::markClosed() { _closed = true; }
+void ClientConnection::startHttp2() {
+  _prefaceChecked = true;
+  _h2 = new Http2Session(_ex->requestHandler, _listener.servers, getIp());
+  _ex->requestHandler.setStreamLimiter(_services->rateLimiter, getAddr());
+  LOG_DEBUG("[h2] fd " << _clientFd << " switched to HTTP/2");
+  if (_ex->requestComplete) {
+    _h2->upgrade(_ex->httpRequest);
+    resetForNextRequest();
+  }
+  feedHttp2();
+}
 
 /**
- * @brief Checks if the connection is closed
+ * @brief Hands every buffered byte to the HTTP/2 session
  *
- * @return true if connection is marked closed
+ * Streams completed by these bytes are answered at once; their frames
+ * are taken by flushWrite() (see hasPendingWrite()). The arena only holds
+ * temporaries of those requests, so it is emptied right after.
  */
-bool ClientConnection::isClosed() const { return _closed; }
+void ClientConnection::feedHttp2() {
+  while (!_readBuffer.empty()) {
+    size_t length;
+    const char *data = _readBuffer.front(length);
+    _h2->receive(data, length);
+    _readBuffer.consume(length);
+  }
+  _ex->arena.reset();
+}
 
 /**
- * @brief Checks if the HTTP request is complete
+ * @brief Queues _ex->httpResponse for flushWrite()
  *
- * @return true if headers and body (if any) are fully received
+ * Only the header block is serialized (into _ex->writeBuffer, whose capacity
+ * is reused). The in-memory body is sent from the response itself and the
+ * segments are moved over, so no body byte is copied here.
+ *
+ * While the server drains, the response announces "Connection: close"
+ * and the connection closes once it is sent.
  */
-bool ClientConnection::isRequestComplete() const { return _requestComplete; }
+void ClientConnection::queueResponse() {
+  if (_services->draining && !_h2 && _ex->httpRequest.isKeepAlive()) {
+    _ex->httpRequest.disableKeepAlive();
+    _ex->httpResponse.setHeader("Connection", "close");
+  }
+  _ex->writeBuffer.clear();
+  _ex->httpResponse.appendHeaders(_ex->writeBuffer);
+  _ex->bodyData = _ex->httpResponse.getBodyData();
+  _ex->bodyLength = _ex->httpResponse.getBodyLength();
+  _ex->writeOffset = 0;
+  clearBodySegments();
+  _ex->httpResponse.takeBodySegments(_ex->segments);
+  advanceWrite(0); // Skip leading empty segments
+  _ex->responseQueued = true;
+  _ex->flushStart = Metrics::now();
+  _ex->rateStart = time(NULL);
+  _ex->rateSent = 0;
+}
 
 /**
- * @brief Returns the parsed HTTP request
+ * @brief Initiates response sending
  *
- * @return Const reference to the HttpRequest object
+ * When more pipelined bytes are already buffered, a small in-memory
+ * response is not written yet: it is copied to _ex->batch and finished at
+ * once, and the next request runs. The burst then leaves in one writev()
+ * (batch first, then the response that could not be held) instead of one
+ * system call per response. flushBatch() sends what is still held when
+ * the burst stops without a response to carry it.
+ *
+ * @return Result of flushWrite(), true when the response was held
  */
-const HttpRequest &ClientConnection::getHttpRequest() const {
-  return _httpRequest;
+bool ClientConnection::sendResponse() {
+  if (!canBatch())
+    return flushWrite();
+  _ex->batch.append(_ex->writeBuffer);
+  _ex->batch.append(_ex->bodyData, _ex->bodyLength);
+  for (size_t i = 0; i < _ex->segments.size(); ++i)
+    _ex->batch.append(_ex->segments[i].data);
+  LOG_DEBUG("Pipelining: response held for fd " << _clientFd << " ("
+            << _ex->batch.size() - _ex->batchOffset << " bytes batched)");
+  onResponseSent(); // Keep-alive only: resets for the next request
+  return true;
 }
 
 /**
- * @brief Returns the timestamp of last activity
+ * @brief Whether the queued response can wait for the next one
  *
- * @return time_t of last read or write operation
+ * Keep-alive, another request at least partly buffered, nothing of this
+ * response sent yet, no file segment (those go out with sendfile()) and
+ * the batch stays under BATCH_LIMIT.
  */
-time_t ClientConnection::getLastActivity() const { return _lastActivity; }
+bool ClientConnection::canBatch() const {
+  if (!_ex->responseQueued || _ex->cgiStreaming || _ex->writeOffset != 0 ||
+      _readBuffer.empty() || !_ex->httpRequest.isKeepAlive())
+    return false;
+  size_t size = _ex->batch.size() - _ex->batchOffset + _ex->writeBuffer.size() +
+                _ex->bodyLength;
+  for (size_t i = 0; i < _ex->segments.size(); ++i) {
+    if (_ex->segments[i].isFile())
+      return false;
+    size += _ex->segments[i].data.size();
+  }
+  return size <= BATCH_LIMIT;
+}
 
 /**
- * @brief Updates the last activity timestamp to now
+ * @brief Writes the held pipelined responses when nothing follows them
+ *
+ * Called once the burst stops (next request incomplete, CGI started, I/O
+ * task parked). A response still pending already carries the batch.
+ *
+ * @return Result of flushWrite(), true when there was nothing to send
  */
-void ClientConnection::updateActivity() { _lastActivity = time(NULL); }
+bool ClientConnection::flushBatch() {
+  if (!_ex || _ex->batchOffset == _ex->batch.size() || isResponsePending())
+    return true;
+  return flushWrite();
+}
 
 /**
- * @brief Checks if the connection has timed out
- *
- * @param now Current time
- * @param timeoutSec Timeout threshold in seconds
- * @return true if inactive longer than timeoutSec
+ * @brief Whether a file segment is still to be sent
  */
-bool ClientConnection::isTimedOut(time_t now, int timeoutSec) const {
-  return (now - _lastActivity) > timeoutSec;
+bool ClientConnection::hasFileSegment() const {
+  for (size_t i = _ex->segmentIndex; i < _ex->segments.size(); ++i) {
+    if (_ex->segments[i].isFile() && !writesMapped(_ex->segments[i]))
+      return true;
+  }
+  return false;
 }
 
 /**
- * @brief Resets state for next request (keep-alive support)
+ * @brief Sets or clears TCP_CORK (TCP_NOPUSH on the BSDs)
  *
- * Clears request state while preserving connection and any pipelined
- * data in the raw request buffer.
+ * While corked the kernel only sends full segments, so the header block
+ * and the first file bytes share a packet instead of the header leaving
+ * alone. Clearing it pushes out the last partial segment at once.
+ *
+ * @param on true to cork
  */
-void ClientConnection::resetForNextRequest() {
-  _httpRequest.reset();
-  _requestComplete = false;
-  // Note: _rawRequest not cleared to support pipelining
-  std::cout << "[Debug] resetForNextRequest: rawRequest size remaining: "
-            << _rawRequest.size() << std::endl;
-  _writeBuffer.clear();
-  _writeOffset = 0;
-
-  // Reset CGI state
-  _cgiState = CGI_NONE;
-  if (_cgiPipeFd != -1) {
-    close(_cgiPipeFd);
-    _cgiPipeFd = -1;
-  }
-  _cgiPid = 0;
-  _cgiBuffer.clear();
+void ClientConnection::setCork(bool on) {
+  int value = on ? 1 : 0;
+#if defined(TCP_CORK)
+  setsockopt(_clientFd, IPPROTO_TCP, TCP_CORK, &value, sizeof(value));
+#elif defined(TCP_NOPUSH)
+  setsockopt(_clientFd, IPPROTO_TCP, TCP_NOPUSH, &value, sizeof(value));
+#else
+  (void)value;
+#endif
+  _corked = on;
 }
 
 /**
- * @brief Checks for and parses next pipelined request
+ * @brief Sends the next piece of a file-backed body segment
  *
- * If there is remaining data in the raw request buffer from pipelining,
- * attempts to parse it as the next HTTP request.
+ * Uses sendfile() where available so file pages go from the page cache to
+ * the socket without passing through user space. The file position is
+ * segment.offset + _ex->segmentSent (sendfile/pread with explicit offsets never
+ * move the shared fd's own position, so several connections can share one
+ * fd).
  *
- * @return true if a complete request was found in the buffer
+ * If sendfile() is missing, or refuses this file before sending a single
+ * byte (some filesystems do not support it), the body is streamed through
+ * sendFileWindow() instead for the rest of the response. So is it on TLS
+ * without kTLS: OpenSSL has to encrypt the bytes.
+ *
+ * @param segment File segment being sent
+ * @param count Bytes to send (at most what is left of the segment)
+ * @return Bytes sent (> 0), 0 if the file ended early, -1 on error
  */
-bool ClientConnection::checkForNextRequest() {
-  if (_rawRequest.empty())
-    return false;
-
-  std::cout << "[Debug] Checking for next request in buffer (size: "
-            << _rawRequest.size() << ") for fd " << _clientFd << std::endl;
+ssize_t ClientConnection::sendFileChunk(const BodySegment &segment,
+                                        off_t count) {
+  off_t position = segment.offset + _ex->segmentSent;
 
-  _httpRequest.reset();
+  if (!_ex->bodyFileSendfile || (_tls && !_tls->hasKernelSend()))
+    return sendFileWindow(segment, count);
 
-  if (_httpRequest.parse(_rawRequest)) {
-    std::cout << "✅ [Info] Pipelined request complete (fd: " << _clientFd
-              << ")\n";
-    _requestComplete = true;
+  int fileFd = segment.file.getFd();
+  ssize_t sent;
+#if defined(WEBSERV_HAVE_SENDFILE) && defined(__linux__)
+  off_t offset = position;
+  sent = sendfile(_clientFd, fileFd, &offset, (size_t)count);
+#elif defined(WEBSERV_HAVE_SENDFILE) && defined(__APPLE__)
+  off_t len = count;
+  int rc = sendfile(fileFd, _clientFd, position, &len, NULL, 0);
+  if (len > 0)
+    sent = (ssize_t)len; // Partial progress counts even when rc == -1
+  else
+    sent = rc == 0 ? 0 : -1;
+#elif defined(WEBSERV_HAVE_SENDFILE)
+  off_t done = 0;
+  int rc = sendfile(fileFd, _clientFd, position, (size_t)count, NULL, &done,
+                    0);
+  if (done > 0)
+    sent = (ssize_t)done;
+  else
+    sent = rc == 0 ? 0 : -1;
+#else
+  (void)fileFd;
+  (void)position;
+  sent = -1;
+#endif
 
-    // Remove parsed bytes, keep remainder for further pipelining
-    int parsedBytes = _httpRequest.getParsedBytes();
-    if (parsedBytes > 0 && (size_t)parsedBytes <= _rawRequest.size()) {
-      _rawRequest.erase(0, parsedBytes);
-      std::cout << "[Debug] Pipelining (buffer): erased " << parsedBytes
-                << " bytes. Remaining: " << _rawRequest.size() << std::endl;
-    } else {
-      _rawRequest.clear();
-    }
-    return true;
+  if (sent == -1 && !_ex->bodyFileStarted) {
+    // Nothing went out through sendfile() yet: stream this body through the
+    // bounded read window instead. A genuinely broken socket fails there too.
+    _ex->bodyFileSendfile = false;
+    return sendFileWindow(segment, count);
   }
-  return false;
+  return sent;
 }
 
-// ==================== CGI Non-blocking Methods ====================
-
 /**
- * @brief Returns the current CGI execution state
+ * @brief Streams one bounded window of the file body with pread() + send()
  *
- * @return CGI_NONE, CGI_RUNNING, or CGI_DONE
+ * The window lives on the stack, so a download costs the same memory per
+ * connection whether the file is 1 KB or several GB. Bytes the socket did
+ * not accept are simply re-read on the next POLLOUT.
+ *
+ * @param segment File segment being sent
+ * @param count Upper bound of bytes to send in this call
+ * @return Bytes sent (> 0), 0 if the file ended early, -1 on error
  */
-CGIState ClientConnection::getCGIState() const { return _cgiState; }
+ssize_t ClientConnection::sendFileWindow(const BodySegment &segment,
+                                         off_t count) {
+  char window[FILE_WINDOW_SIZE];
+  size_t toRead =
+      count < (off_t)sizeof(window) ? (size_t)count : sizeof(window);
+  ssize_t bytesRead = pread(segment.file.getFd(), window, toRead,
+                            segment.offset + _ex->segmentSent);
+  if (bytesRead <= 0)
+    return bytesRead;
+  struct iovec iov;
+  iov.iov_base = window;
+  iov.iov_len = (size_t)bytesRead;
+  return transmit(&iov, 1);
+}
 
 /**
- * @brief Returns the CGI output pipe file descriptor
+ * @brief Collects the pending in-memory bytes for one writev()
  *
- * @return Pipe fd, or -1 if no CGI running
+ * In order: held pipelined responses (_ex->batch), rest of the header block,
+ * rest of the in-memory body, then the following memory segments up to
+ * the first file segment (files go out with sendfile() instead). A mapped
+ * file segment is gathered like memory (see writesMapped()), so a medium
+ * file leaves with its header block in one writev().
+ *
+ * @param iov Receives the buffers
+ * @param maxCount Capacity of iov
+ * @return Buffers filled; 0 when the next byte comes from a file segment
  */
-int ClientConnection::getCGIPipeFd() const { return _cgiPipeFd; }
+int ClientConnection::gatherWrite(struct iovec *iov, int maxCount) const {
+  int count = 0;
+  if (_ex->batchOffset < _ex->batch.size()) {
+    iov[count].iov_base = const_cast<char *>(_ex->batch.data()) + _ex->batchOffset;
+    iov[count].iov_len = _ex->batch.size() - _ex->batchOffset;
+    ++count;
+  }
+  size_t headerSize = _ex->writeBuffer.size();
+  if (_ex->writeOffset < headerSize) {
+    iov[count].iov_base =
+        const_cast<char *>(_ex->writeBuffer.data()) + _ex->writeOffset;
+    iov[count].iov_len = headerSize - _ex->writeOffset;
+    ++count;
+  }
+  if (_ex->writeOffset < headerSize + _ex->bodyLength) {
+    size_t done = _ex->writeOffset > headerSize ? _ex->writeOffset - headerSize : 0;
+    iov[count].iov_base = const_cast<char *>(_ex->bodyData) + done;
+    iov[count].iov_len = _ex->bodyLength - done;
+    ++count;
+  }
+  for (size_t i = _ex->segmentIndex; i < _ex->segments.size() && count < maxCount;
+       ++i) {
+    const BodySegment &segment = _ex->segments[i];
+    size_t done = i == _ex->segmentIndex ? static_cast<size_t>(_ex->segmentSent) : 0;
+    if (segment.isFile()) {
+      if (!writesMapped(segment))
+        break;
+      if (static_cast<size_t>(segment.length) > done) {
+        iov[count].iov_base = const_cast<char *>(segment.map.data()) +
+                              segment.offset + done;
+        iov[count].iov_len = static_cast<size_t>(segment.length) - done;
+        ++count;
+      }
+    } else if (segment.data.size() > done) {
+      iov[count].iov_base = const_cast<char *>(segment.data.data()) + done;
+      iov[count].iov_len = segment.data.size() - done;
+      ++count;
+    }
+  }
+  return count;
+}
 
 /**
- * @brief Returns the CGI child process ID
+ * @brief Whether a file segment is sent from its mapping with writev()
  *
- * @return Child PID, or 0 if no CGI running
+ * Only when the kernel does the copy (plain TCP, or kTLS): a file
+ * truncated under the mapping then fails the write (EFAULT) instead of
+ * raising SIGBUS in the process, as a copy by OpenSSL would.
  */
-pid_t ClientConnection::getCGIPid() const { return _cgiPid; }
+bool ClientConnection::writesMapped(const BodySegment &segment) const {
+  return segment.map.isValid() && (!_tls || _tls->hasKernelSend());
+}
 
 /**
- * @brief Returns the accumulated CGI output buffer
+ * @brief Accounts for bytes accepted by the socket
  *
- * @return Const reference to CGI output data
+ * A write may end anywhere: in the header block, in the body, or in the
+ * middle of any segment; progress continues from there on the next call.
+ * Empty segments are stepped over.
+ *
+ * @param bytes Bytes just sent (0 only skips empty segments)
  */
-const std::string &ClientConnection::getCGIBuffer() const { return _cgiBuffer; }
+void ClientConnection::advanceWrite(size_t bytes) {
+  if (_ex->batchOffset < _ex->batch.size()) {
+    size_t take = std::min(bytes, _ex->batch.size() - _ex->batchOffset);
+    _ex->batchOffset += take;
+    bytes -= take;
+    if (_ex->batchOffset < _ex->batch.size())
+      return;
+    _ex->batch.clear(); // Capacity kept for the next burst (<= BATCH_LIMIT)
+    _ex->batchOffset = 0;
+  }
+  size_t inlineSize = _ex->writeBuffer.size() + _ex->bodyLength;
+  if (_ex->writeOffset < inlineSize) {
+    size_t take = std::min(bytes, inlineSize - _ex->writeOffset);
+    _ex->writeOffset += take;
+    bytes -= take;
+    if (_ex->writeOffset < inlineSize)
+      return;
+  }
+  while (_ex->segmentIndex < _ex->segments.size()) {
+    off_t remaining = _ex->segments[_ex->segmentIndex].length - _ex->segmentSent;
+    if (static_cast<off_t>(bytes) < remaining) {
+      _ex->segmentSent += static_cast<off_t>(bytes);
+      return;
+    }
+    bytes -= static_cast<size_t>(remaining);
+    ++_ex->segmentIndex; // Segment done (also skips empty ones)
+    _ex->segmentSent = 0;
+  }
+}
 
 /**
- * @brief Initiates CGI execution tracking
+ * @brief Bytes of the current response limit_rate lets out now
  *
- * Called after fork() to set up async CGI monitoring.
+ * nginx's accounting at the timer wheel's resolution: by the end of
+ * second n after the response was queued, limit_rate_after + rate * n
+ * bytes may be out. Ahead of that, the connection pauses until the second
+ * in which the response is behind again, so it goes out in bursts of
+ * rate bytes, one per second.
  *
- * @param pipeFd Read end of CGI output pipe
- * @param pid Child process ID
+ * @return Bytes that may be sent, 0 when paused (see getRateResume())
  */
-void ClientConnection::startCGI(int pipeFd, pid_t pid) {
-  _cgiState = CGI_RUNNING;
-  _cgiPipeFd = pipeFd;
-  _cgiPid = pid;
-  _cgiBuffer.clear();
-  std::cout << "[CGI] Started async CGI (pid: " << pid << ", pipe: " << pipeFd
-            << ")\n";
+size_t ClientConnection::rateAllowance() {
+  time_t now = time(NULL);
+  uint64_t elapsed = now > _ex->rateStart ? static_cast<uint64_t>(now - _ex->rateStart)
+                                      : 0;
+  uint64_t allowed = _ex->limitRate.after + _ex->limitRate.rate * (elapsed + 1);
+  if (_ex->rateSent < allowed) {
+    uint64_t allowance = allowed - _ex->rateSent;
+    size_t most = static_cast<size_t>(-1);
+    return allowance < most ? static_cast<size_t>(allowance) : most;
+  }
+  _ex->ratePaused = true;
+  _ex->rateResume =
+      _ex->rateStart + static_cast<time_t>((_ex->rateSent - _ex->limitRate.after) /
+                                       _ex->limitRate.rate);
+  return 0;
 }
 
 /**
- * @brief Reads available CGI output from the pipe
+ * @brief Sends pending response data to the client
  *
- * Called when poll() indicates POLLIN on the CGI pipe.
+ * Memory parts (header block, in-memory body, memory segments) are sent
+ * together with one writev(), straight from their own buffers; a file
+ * segment is sent with sendfile(). One write system call per call, as the
+ * caller only invokes this after POLLOUT readiness.
  *
- * @return true if read successful or EOF reached, false on error
+ * With tcp_nopush a response carrying a file is written corked, and the
+ * cork is pulled once its last byte is out (see setCork()).
+ *
+ * Under limit_rate no write goes past rateAllowance(); once it is spent
+ * the connection pauses (isRatePaused()) until the Server's timer resumes
+ * it, instead of waiting for POLLOUT.
+ *
+ * Error handling (per subject requirement - no errno checking):
+ * - s > 0: Data sent successfully; repeated while the socket takes every
+ *   byte offered and less than _services->writeBudget went out in this event
+ * - s == -1: Treat as error, mark connection closed
+ * - s == 0: Peer closed connection (or file truncated while sending)
+ * - -1 or 0 after earlier progress: Stop; the next POLLOUT reports it
+ * - s == TlsConnection::AGAIN: TLS could not write; retried on POLLOUT
+ *
+ * After complete send:
+ * - If !keep-alive: Mark connection closed
+ * - If keep-alive: Reset for next request
+ *
+ * @return true if send successful or buffer empty, false on error
  *
- * @note Sets _cgiState to CGI_DONE on EOF or error
+ * @note Should only be called when poll() indicates POLLOUT
  */
-bool ClientConnection::readCGIOutput() {
-  if (_cgiState != CGI_RUNNING || _cgiPipeFd == -1) {
-    return false;
+bool ClientConnection::flushWrite() {
+  if (_tls && !_tls->isEstablished()) {
+    if (!stepHandshake())
+      return false;
+    if (!_tls->isEstablished())
+      return true;
+  }
+  if (!_ex)
+    return true; // Idle: nothing queued
+  size_t paced = 0; // Bytes limit_rate lets out now (0 = no limit)
+  if (_ex->limitRate.rate > 0) {
+    if (_ex->ratePaused)
+      return true;
+    paced = rateAllowance();
+    if (paced == 0)
+      return true; // Paused until _ex->rateResume
   }
+  size_t total = 0;
+  ssize_t s = 0;
+  if (_tcpNoPush && !_corked && hasFileSegment())
+    setCork(true);
+  while (hasPendingWrite()) {
+    if (_h2 && _ex->batchOffset == _ex->batch.size()) {
+      _h2->produce(_ex->batch, BATCH_LIMIT); // HTTP/2: frame the next batch
+      if (_ex->batch.empty())
+        break;
+    }
+    struct iovec iov[MAX_WRITE_IOV];
+    int iovCount = gatherWrite(iov, MAX_WRITE_IOV);
+    size_t offered = 0;
+    if (iovCount > 0) {
+      int used = 0;
+      for (; used < iovCount && (!paced || offered < paced - total); ++used) {
+        if (paced && iov[used].iov_len > paced - total - offered)
+          iov[used].iov_len = paced - total - offered; // Rest of the share
+        offered += iov[used].iov_len;
+      }
+      s = transmit(iov, used);
+    } else {
+      const BodySegment &segment = _ex->segments[_ex->segmentIndex];
+      off_t count = segment.length - _ex->segmentSent;
+      if (count > FILE_CHUNK_SIZE)
+        count = FILE_CHUNK_SIZE;
+      if (paced && count > static_cast<off_t>(paced - total))
+        count = static_cast<off_t>(paced - total);
+      offered = static_cast<size_t>(count);
+      s = sendFileChunk(segment, count);
+    }
+    if (s <= 0)
+      break;
 
-  char buffer[4096];
-  ssize_t bytesRead = read(_cgiPipeFd, buffer, sizeof(buffer));
+    if (iovCount == 0)
+      _ex->bodyFileStarted = true;
+    advanceWrite(static_cast<size_t>(s));
+    total += static_cast<size_t>(s);
+    if (static_cast<size_t>(s) < offered || total >= _services->writeBudget ||
+        total == paced)
+      break; // Socket full, or this event's (or second's) share is spent
+  }
+  _ex->rateSent += total;
 
-  if (bytesRead > 0) {
-    _cgiBuffer.append(buffer, bytesRead);
+  if (_corked && !hasPendingWrite())
+    setCork(false);
+  if (_h2 && _h2->isFinished() && !hasPendingWrite())
+    _closed = true; // GOAWAY sent
+
+  if (total > 0) {
     _lastActivity = time(NULL);
+    Metrics::add(Metrics::BYTES_OUT, static_cast<uint64_t>(total));
+
+    LOG_DEBUG("Sending response (fd: " << _clientFd << "): " << _ex->writeOffset
+              << "/" << _ex->writeBuffer.size() + _ex->bodyLength
+              << " header+body bytes, segment " << _ex->segmentIndex << "/"
+              << _ex->segments.size());
+
+    // Check if all data sent (a streamed CGI body may still be growing;
+    // a write of held responses alone has no current one to finish)
+    if (!hasPendingWrite() && !_ex->cgiStreaming && _ex->responseQueued)
+      onResponseSent();
     return true;
-  } else if (bytesRead == 0) {
-    // EOF - CGI process closed stdout
-    std::cout << "[CGI] EOF reached, output size: " << _cgiBuffer.size()
-              << " bytes\n";
-    close(_cgiPipeFd);
-    _cgiPipeFd = -1;
-    _cgiState = CGI_DONE;
-    return true;
-  } else {
-    // bytesRead < 0: Error (errno not checked per subject requirement)
-    std::cerr << "❌ [CGI] Read error on pipe\n";
-    close(_cgiPipeFd);
-    _cgiPipeFd = -1;
-    _cgiState = CGI_DONE;
+  } else if (!hasPendingWrite() || s == TlsConnection::AGAIN) {
+    return true; // TLS: the record is finished on the next POLLOUT
+  } else if (s == -1) {
+    // poll() indicated POLLOUT but the write failed - real error
+    LOG_ERROR("send() failed for fd " << _clientFd);
+    _closed = true;
+    return false;
+  } else { // s == 0
+    // Peer closed connection during send (or file shrank under us)
+    LOG_INFO("Client closed during send (fd: " << _clientFd << ")");
+    _closed = true;
     return false;
   }
 }
 
 /**
- * @brief Marks CGI execution as finished
- *
- * @param exitStatus Child process exit status (for logging)
+ * @brief Streams a request header for the access log ("-" if absent)
  */
-void ClientConnection::finishCGI(int exitStatus) {
-  (void)exitStatus; // May be used for logging
-  _cgiState = CGI_DONE;
-  if (_cgiPipeFd != -1) {
-    close(_cgiPipeFd);
-    _cgiPipeFd = -1;
-  }
+static void logHeader(std::ostream &line, const HttpRequest &request,
+                      const char *name) {
+  size_t length;
+  const char *value = request.getHeaderValue(name, length);
+  line << '"';
+  if (value)
+    line << LogExcerpt(value, length);
+  else
+    line << '-';
+  line << '"';
+}
+
+/**
+ * @brief Writes the access_log line of the response just sent
+ *
+ * nginx "combined" format, bytes being the body bytes:
+ *   127.0.0.1 - - [14/Oct/2026:19:05:01 +0200] "GET /a?b HTTP/1.1" 200 512
+ *   "referer" "user agent"
+ */
+void ClientConnection::logAccess() const {
+  off_t bodyBytes = static_cast<off_t>(_ex->bodyLength) + _ex->cgiStreamed;
+  for (size_t i = 0; i < _ex->segments.size(); ++i)
+    bodyBytes += _ex->segments[i].length;
+
+  char ip[INET_ADDRSTRLEN];
+  if (inet_ntop(AF_INET, &_addr.sin_addr, ip, sizeof(ip)) == NULL)
+    std::strcpy(ip, "-");
+
+  std::ostream &line = Logger::beginAccess();
+  line << ip << " - - " << Logger::accessTime() << " \"";
+  if (_ex->httpRequest.getMethod().empty()) {
+    line << '-';
+  } else {
+    const std::string &path = _ex->httpRequest.getPath();
+    const std::string &query = _ex->httpRequest.getQuery();
+    line << _ex->httpRequest.getMethod() << ' '
+         << LogExcerpt(path.data(), path.size());
+    if (!query.empty())
+      line << '?' << LogExcerpt(query.data(), query.size());
+    line << ' ' << _ex->httpRequest.getVersion();
+  }
+  line << "\" " << _ex->httpResponse.getStatusCode() << ' ' << bodyBytes << ' ';
+  logHeader(line, _ex->httpRequest, "Referer");
+  line << ' ';
+  logHeader(line, _ex->httpRequest, "User-Agent");
+  Logger::end();
+}
+
+/**
+ * @brief Hands the phases of the response just sent to RequestTrace
+ *
+ * @param end When its last byte was accepted by the socket
+ */
+void ClientConnection::traceRequest(uint64_t end) const {
+  RequestTiming timing;
+  timing.start = _ex->requestStart;
+  timing.parsed = _ex->parsedAt;
+  timing.handled = _ex->handlerAt;
+  timing.cgiAt = _ex->cgiAt;
+  timing.queued = _ex->flushStart;
+  timing.end = end;
+  timing.parseNs = _ex->parseNs;
+  timing.routeNs = _ex->routeNs;
+  timing.handlerNs = _ex->handlerNs;
+  timing.ioNs = _ex->ioNs;
+  timing.cgiNs = _ex->cgiNs;
+
+  char ip[INET_ADDRSTRLEN];
+  if (inet_ntop(AF_INET, &_addr.sin_addr, ip, sizeof(ip)) == NULL)
+    std::strcpy(ip, "-");
+  TracedRequest request;
+  request.client = ip;
+  request.method = &_ex->httpRequest.getMethod();
+  request.path = &_ex->httpRequest.getPath();
+  request.location = _ex->matchedLocation;
+  request.status = _ex->httpResponse.getStatusCode();
+  request.connection = _clientFd;
+  RequestTrace::record(timing, request);
+}
+
+/**
+ * @brief Finalizes a fully sent response (keep-alive or close)
+ */
+void ClientConnection::onResponseSent() {
+  _ex->responseQueued = false;
+  if (Logger::accessEnabled())
+    logAccess();
+  Metrics::countResponse(_ex->httpResponse.getStatusCode(),
+                         _ex->matchedLocation ? *_ex->matchedLocation : std::string());
+  uint64_t sentAt = Metrics::now();
+  if (_ex->flushStart != 0)
+    Metrics::observe(Metrics::PHASE_FLUSH, sentAt - _ex->flushStart);
+  if (RequestTrace::enabled())
+    traceRequest(sentAt);
+  recycleWriteBuffer();
+  _ex->bodyData = NULL;
+  _ex->bodyLength = 0;
+  _ex->writeOffset = 0;
+  clearBodySegments();
+
+  if (AllocCounter::enabled())
+    LOG_DEBUG("Heap allocations for this request (fd: " << _clientFd << "): "
+              << AllocCounter::count() - _ex->allocMark);
+
+  // Handle keep-alive vs close (draining: only a pipelined request stays)
+  if (!_ex->httpRequest.isKeepAlive() ||
+      (_services->draining && _readBuffer.empty())) {
+    _closed = true;
+    LOG_DEBUG("✅ Response sent (fd: " << _clientFd
+              << ") → Connection: close");
+  } else {
+    resetForNextRequest();
+    _keepAliveIdle = _readBuffer.empty(); // Else a pipelined request follows
+    _phaseStart = time(NULL);
+    if (_keepAliveIdle && !_h2)
+      detachExchange(); // Idle: only the hot part stays
+    LOG_DEBUG("✅ Response sent (fd: " << _clientFd
+              << ") → Connection: keep-alive");
+  }
+}
+
+/**
+ * @brief Empties the write buffer for the next response
+ *
+ * A typical header block (+ small body) keeps its storage, so the next
+ * response on this connection is serialized without allocating; a large
+ * in-memory body is given back instead of being pinned while idle.
+ */
+void ClientConnection::recycleWriteBuffer() {
+  if (_ex->writeBuffer.capacity() > HttpResponse::KEEP_CAPACITY)
+    std::string().swap(_ex->writeBuffer);
+  else
+    _ex->writeBuffer.clear();
+}
+
+/**
+ * @brief Checks if there is pending data to send
+ *
+ * @return true if held pipelined responses, header bytes or body
+ *         segments remain unsent, HTTP/2 frames are ready to be framed,
+ *         or the TLS handshake waits for room in the socket
+ */
+bool ClientConnection::hasPendingWrite() const {
+  return (_ex && (_ex->batchOffset < _ex->batch.size() ||
+                  isResponsePending())) ||
+         (_h2 && _h2->wantsWrite()) || (_tls && _tls->wantsWrite());
+}
+
+/**
+ * @brief Checks if the current response has unsent bytes
+ *
+ * @return true if its header bytes or body segments remain unsent
+ */
+bool ClientConnection::isResponsePending() const {
+  if (!_ex)
+    return false;
+  return _ex->writeOffset < _ex->writeBuffer.size() + _ex->bodyLength ||
+         _ex->segmentIndex < _ex->segments.size();
+}
+
+/**
+ * @brief Drops the body segments of the current response
+ *
+ * File handles are only released here; an fd shared with the open file
+ * cache stays open.
+ */
+void ClientConnection::clearBodySegments() {
+  _ex->segments.clear();
+  _ex->segmentIndex = 0;
+  _ex->segmentSent = 0;
+  _ex->bodyFileSendfile = true;
+  _ex->bodyFileStarted = false;
+}
+
+/**
+ * @brief Marks the connection as closed
+ */
+void ClientConnection::markClosed() { _closed = true; }
+
+/**
+ * @brief Checks if the connection is closed
+ *
+ * @return true if connection is marked closed
+ */
+bool ClientConnection::isClosed() const { return _closed; }
+
+/**
+ * @brief Checks if the HTTP request is complete
+ *
+ * @return true if headers and body (if any) are fully received
+ */
+bool ClientConnection::isRequestComplete() const {
+  return _ex && _ex->requestComplete;
+}
+
+/**
+ * @brief Whether request state is attached (see attachExchange())
+ */
+bool ClientConnection::hasExchange() const { return _ex != NULL; }
+
+/**
+ * @brief Returns the timestamp of last activity
+ *
+ * @return time_t of last read or write operation
+ */
+time_t ClientConnection::getLastActivity() const { return _lastActivity; }
+
+/**
+ * @brief Updates the last activity timestamp to now
+ */
+void ClientConnection::updateActivity() { _lastActivity = time(NULL); }
+
+/**
+ * @brief Tells which timeout the connection is currently subject to
+ *
+ * The timers count from getTimeoutStart():
+ * - CGI running           → cgi_timeout
+ * - waiting for I/O task  → send_timeout (the response is under way)
+ * - response not sent yet → send_timeout
+ * - headers received      → client_body_timeout, until the body is complete
+ * - HTTP/2 stream open    → client_body_timeout, keepalive_timeout if none
+ * - idle after a response → keepalive_timeout
+ * - otherwise             → client_header_timeout
+ *
+ * @return Phase of the connection
+ */
+GlobalConfig::Timeout ClientConnection::getTimeoutPhase() const {
+  if (!_ex) // Idle: after a response, or nothing received yet
+    return _keepAliveIdle ? GlobalConfig::TIMEOUT_KEEPALIVE
+                          : GlobalConfig::TIMEOUT_HEADER;
+  if (_ex->cgiState == CGI_RUNNING || _ex->cacheWaiting)
+    return GlobalConfig::TIMEOUT_CGI;
+  if (hasPendingWrite() || _ex->ioTask)
+    return GlobalConfig::TIMEOUT_SEND;
+  if (_h2)
+    return _h2->isIdle() ? GlobalConfig::TIMEOUT_KEEPALIVE
+                         : GlobalConfig::TIMEOUT_BODY;
+  if (_ex->httpRequest.headersComplete() && !_ex->requestComplete)
+    return GlobalConfig::TIMEOUT_BODY;
+  if (_keepAliveIdle)
+    return GlobalConfig::TIMEOUT_KEEPALIVE;
+  return GlobalConfig::TIMEOUT_HEADER;
+}
+
+/**
+ * @brief Where the deadline of a phase counts from
+ *
+ * client_header_timeout, client_body_timeout and cgi_timeout bound the
+ * whole phase, from its start: a client trickling one byte at a time, or
+ * a script printing a line now and then, cannot stretch it. send_timeout
+ * and keepalive_timeout measure inactivity, and so does the body timeout
+ * of an HTTP/2 connection, whose streams come and go.
+ *
+ * @param phase Phase returned by getTimeoutPhase()
+ * @return Timestamp the phase's timeout is added to
+ */
+time_t ClientConnection::getTimeoutStart(GlobalConfig::Timeout phase) const {
+  if (phase == GlobalConfig::TIMEOUT_HEADER ||
+      phase == GlobalConfig::TIMEOUT_CGI ||
+      (phase == GlobalConfig::TIMEOUT_BODY && !_h2))
+    return _phaseStart;
+  return _lastActivity;
+}
+
+/**
+ * @brief Resets state for next request (keep-alive support)
+ *
+ * Clears request state while preserving connection and any pipelined
+ * data in the read buffer. Everything allocated for the request is given
+ * back in one go: the arena's scratch strings are all freed for reuse, the
+ * response object is reset in place, and the write buffer keeps only a
+ * small capacity (see recycleWriteBuffer()); the CGI buffer is released.
+ */
+void ClientConnection::resetForNextRequest() {
+  if (!_ex)
+    return;
+  dropUploadSink();
+  _ex->httpRequest.reset();
+  _ex->requestComplete = false;
+  _ex->responseQueued = false;
+  // Note: _readBuffer not cleared to support pipelining
+  LOG_DEBUG("resetForNextRequest: rawRequest size remaining: "
+            << _readBuffer.size());
+  recycleWriteBuffer();
+  _ex->bodyData = NULL;
+  _ex->bodyLength = 0;
+  _ex->writeOffset = 0;
+  clearBodySegments();
+  _ex->httpResponse.reset(); // Drops file handles and large bodies
+  _ex->arena.reset();
+
+  // Reset CGI state
+  _ex->cgiState = CGI_NONE;
+  if (_ex->cgiPipeFd != -1) {
+    if (_ex->proxy.isActive())
+      _services->upstreamPool->finish(*_ex->proxyGroup, _ex->proxyServer, _ex->cgiPipeFd, false);
+    else
+      close(_ex->cgiPipeFd);
+    _ex->cgiPipeFd = -1;
+  }
+  closeCGIInput();
+  _ex->cgiPid = 0;
+  _ex->cgiFailed = false;
+  _ex->cgiBuffered = false;
+  _ex->cgiStreaming = false;
+  _ex->cgiChunked = false;
+  _ex->cgiPaused = false;
+  _ex->cgiStreamed = 0;
+  _ex->fastcgi.reset();
+  _ex->proxy.reset();
+  std::string().swap(_ex->cgiBuffer);
+  endCacheFill(false); // Origin never started (e.g. 502)
+  _ex->cacheBypass = false;
+  _ex->limitChecked = false;
+  _ex->limitRate = LimitRate();
+  _ex->ratePaused = false;
+  if (_ex->ioTask)
+    _ex->ioTask->cancel();
+  _ex->ioTask = NULL;
+  _ex->ioRounds = 0;
+  _ex->parseNs = 0;
+  _ex->routeNs = 0;
+  _ex->handlerNs = 0;
+  _ex->flushStart = 0;
+  _ex->cgiStart = 0;
+  _ex->matchedLocation = NULL;
+  _ex->requestStart = 0;
+  _ex->parsedAt = 0;
+  _ex->handlerAt = 0;
+  _ex->ioNs = 0;
+  _ex->cgiAt = 0;
+  _ex->cgiNs = 0;
+  _ex->allocMark = AllocCounter::count();
+}
+
+/**
+ * @brief Checks for and parses next pipelined request
+ *
+ * If there is remaining data in the read buffer from pipelining, feeds
+ * it to the parser. Only unconsumed bytes are parsed: what earlier calls
+ * consumed is never scanned again.
+ *
+ * @return true if a complete request was found in the buffer
+ */
+bool ClientConnection::checkForNextRequest() {
+  if (_readBuffer.empty() || _h2)
+    return false;
+  if (!_ex)
+    attachExchange();
+
+  LOG_DEBUG("Checking for next request in buffer (size: "
+            << _readBuffer.size() << ") for fd " << _clientFd);
+
+  // No reset: resetForNextRequest() did it when the previous response
+  // finished, and the parser resumes where earlier bytes left it
+  uint64_t parseStart = Metrics::now();
+  if (_ex->requestStart == 0)
+    _ex->requestStart = parseStart;
+  bool complete = feedParser();
+  uint64_t parseEnd = Metrics::now();
+  _ex->parseNs += parseEnd - parseStart;
+  if (complete) {
+    LOG_DEBUG("✅ Pipelined request complete (fd: " << _clientFd << ")");
+    _ex->requestComplete = true;
+    _ex->parsedAt = parseEnd;
+    LOG_DEBUG("Pipelining (buffer): remaining: " << _readBuffer.size());
+    return true;
+  }
+  return false;
+}
+
+// ==================== Blocking File I/O (io_threads) ====================
+
+/**
+ * @brief Whether the request waits for a task on an I/O thread
+ */
+bool ClientConnection::isIoPending() const { return _ex && _ex->ioTask; }
+
+/**
+ * @brief Takes back the finished task the request was parked on
+ *
+ * The results go to the caches (or the handler's IoOutcome); the request
+ * is then ready to run again through processRequest().
+ *
+ * @param task Task returned by IoThreadPool::collect() with this owner
+ */
+void ClientConnection::completeIo(IoTask *task) {
+  if (!_ex || task != _ex->ioTask)
+    return;
+  _ex->ioTask = NULL;
+  _ex->ioNs += Metrics::now() - _ex->ioStart;
+  if (!_closed)
+    task->complete();
+  _lastActivity = time(NULL);
+}
+
+// ==================== CGI Non-blocking Methods ====================
+
+/**
+ * @brief Returns the current CGI execution state
+ *
+ * @return CGI_NONE, CGI_RUNNING, or CGI_DONE
+ */
+CGIState ClientConnection::getCGIState() const {
+  return _ex ? _ex->cgiState : CGI_NONE;
+}
+
+/**
+ * @brief Returns the CGI output pipe file descriptor
+ *
+ * @return Pipe fd, or -1 if no CGI running
+ */
+int ClientConnection::getCGIPipeFd() const {
+  return _ex ? _ex->cgiPipeFd : -1;
+}
+
+/**
+ * @brief Returns the CGI child process ID
+ *
+ * @return Child PID, or 0 if no CGI running
+ */
+pid_t ClientConnection::getCGIPid() const { return _ex ? _ex->cgiPid : 0; }
+
+/**
+ * @brief Returns the accumulated CGI output buffer
+ *
+ * @return Const reference to CGI output data
+ */
+const std::string &ClientConnection::getCGIBuffer() const {
+  return _ex->cgiBuffer;
+}
+
+/**
+ * @brief Initiates CGI execution tracking
+ *
+ * Called after fork() to set up async CGI monitoring. The request body is
+ * written to the script's stdin right away as far as the pipe buffer
+ * allows; what is left is fed on POLLOUT (see writeCGIInput()), so a large
+ * POST never blocks the event loop.
+ *
+ * @param pipeFd Read end of CGI output pipe
+ * @param pid Child process ID
+ * @param stdinFd Non-blocking write end of the script's stdin (-1 = no
+ *        body, stdin already at EOF)
+ */
+void ClientConnection::startCGI(int pipeFd, pid_t pid, int stdinFd) {
+  _ex->cgiState = CGI_RUNNING;
+  _phaseStart = time(NULL);
+  _ex->cgiPipeFd = pipeFd;
+  _ex->cgiPid = pid;
+  _ex->cgiBuffer.clear();
+  _ex->cgiStdinFd = stdinFd;
+  _ex->cgiInputSent = 0;
+  _ex->cgiStart = Metrics::now();
+  Metrics::add(Metrics::CGI_SPAWNS);
+  LOG_DEBUG("[CGI] Started async CGI (pid: " << pid << ", pipe: " << pipeFd
+            << ")");
+
+  // Most bodies fit in the pipe buffer: then stdin is never registered
+  writeCGIInput();
+  if (!hasCGIInput())
+    closeCGIInput();
+}
+
+/**
+ * @brief Reads available CGI output from the pipe
+ *
+ * Called when poll() indicates POLLIN on the CGI pipe.
+ *
+ * @return true if read successful or EOF reached, false on error
+ *
+ * @note Sets _ex->cgiState to CGI_DONE on EOF or error. The pipe stays open
+ *       until finishCGI() so the Server can unregister it from the event
+ *       backend first (epoll keeps events for fds shared with CGI children).
+ */
+bool ClientConnection::readCGIOutput() {
+  if (_ex->cgiState != CGI_RUNNING || _ex->cgiPipeFd == -1) {
+    return false;
+  }
+  if (_ex->fastcgi.isActive())
+    return readFastCGIOutput();
+  if (_ex->proxy.isActive())
+    return readProxyOutput();
+
+  char buffer[4096];
+  ssize_t bytesRead = read(_ex->cgiPipeFd, buffer, sizeof(buffer));
+
+  if (bytesRead > 0) {
+    _ex->cgiBuffer.append(buffer, bytesRead);
+    _lastActivity = time(NULL);
+    return true;
+  } else if (bytesRead == 0) {
+    // EOF - CGI process closed stdout
+    LOG_DEBUG("[CGI] EOF reached, output size: " << _ex->cgiBuffer.size()
+              << " bytes");
+    _ex->cgiState = CGI_DONE; // Pipe closed by finishCGI() once unregistered
+    return true;
+  } else {
+    // bytesRead < 0: Error (errno not checked per subject requirement)
+    LOG_ERROR("CGI: Read error on pipe");
+    _ex->cgiState = CGI_DONE;
+    return false;
+  }
+}
+
+/**
+ * @brief Marks CGI execution as finished
+ *
+ * A cgi_cache fill is stored only if the output is complete.
+ *
+ * @param exitStatus 0 when the output ended normally, -1 if aborted
+ */
+void ClientConnection::finishCGI(int exitStatus) {
+  _ex->cgiState = CGI_DONE;
+  endCacheFill(exitStatus == 0 && !_ex->cgiFailed);
+  closeCGIInput(); // Output is complete: the script wants no more input
+  if (_ex->cgiPipeFd != -1) {
+    // A FastCGI connection whose request ended cleanly carries the next one
+    if (_ex->fastcgi.isActive() && _ex->fastcgi.isComplete() &&
+        !_ex->fastcgi.hasPendingOutput() && !_ex->cgiFailed)
+      _services->fastcgiPool->release(_ex->fastcgiAddress, _ex->cgiPipeFd);
+    else if (_ex->proxy.isActive())
+      _services->upstreamPool->finish(*_ex->proxyGroup, _ex->proxyServer, _ex->cgiPipeFd,
+                            _ex->proxy.isReusable() && !_ex->cgiFailed);
+    else
+      close(_ex->cgiPipeFd);
+    _ex->cgiPipeFd = -1;
+  }
+  _ex->fastcgi.reset();
+  _ex->proxy.reset();
+  _ex->cgiPaused = false;
+  if (_ex->cgiStart != 0) {
+    _ex->cgiAt = _ex->cgiStart;
+    _ex->cgiNs = Metrics::now() - _ex->cgiStart;
+    Metrics::observe(Metrics::CGI_DURATION, _ex->cgiNs);
+  }
+  _ex->cgiStart = 0;
 }
 
 /**
@@ -530,9 +1659,764 @@ void ClientConnection::finishCGI(int exitStatus) {
  * Called by Server after CGI completes to set the response data
  * for normal POLLOUT sending flow.
  *
- * @param responseStr Complete HTTP response string
+ * @param response Response built from getCGIBuffer(); its body points into
+ *        that buffer, which is kept until resetForNextRequest()
+ */
+void ClientConnection::setCGIResponse(const HttpResponse &response) {
+  _ex->httpResponse = response;
+  queueResponse();
+}
+
+/**
+ * @brief Gives up on a CGI that stopped producing output (cgi_timeout)
+ *
+ * Kills and reaps the script, closes its pipe and queues a 504 Gateway
+ * Timeout instead of whatever it printed so far. The Server unregisters
+ * the pipe before calling this. If the response is already being
+ * streamed, its head is gone: the connection is closed instead, so the
+ * client sees a truncated body rather than a complete one.
+ */
+void ClientConnection::abortCGI() {
+  if (_ex->cgiPid > 0) {
+    kill(_ex->cgiPid, SIGKILL);
+    int status;
+    waitpid(_ex->cgiPid, &status, 0);
+    _ex->cgiPid = 0;
+  }
+  Metrics::add(Metrics::CGI_TIMEOUTS);
+  finishCGI(-1);
+  if (_ex->cgiStreaming) {
+    _ex->cgiFailed = true;
+    endCGIStream();
+    return;
+  }
+  _ex->httpResponse.reset();
+  _ex->httpResponse.setErrorResponse(504);
+  queueResponse();
+}
+
+/**
+ * @brief Sends a script request to a FastCGI server (fastcgi_pass)
+ *
+ * The CGI fd becomes a pooled connection to the server instead of a
+ * pipe: the Server watches it like a CGI pipe, plus POLLOUT while
+ * hasCGIInput(). Its output is decoded into the CGI buffer and parsed
+ * exactly like the output of a CGI process.
+ *
+ * @param address fastcgi_pass value
+ * @param params CGI environment (see CGIHandler::fastcgiParams())
+ * @param body Request body (FCGI_STDIN)
+ * @return false if no connection could be opened (caller answers 502)
+ */
+bool ClientConnection::startFastCGI(
+    const std::string &address,
+    const std::map<std::string, std::string> &params,
+    const std::string &body) {
+  if (!_services->fastcgiPool)
+    return false;
+  int fd = _services->fastcgiPool->acquire(address);
+  if (fd == -1)
+    return false;
+
+  _ex->fastcgi.begin(params, body);
+  if (!_ex->fastcgi.sendPending(fd)) {
+    _ex->fastcgi.reset();
+    close(fd);
+    return false;
+  }
+  _ex->fastcgiAddress = address;
+  _ex->cgiFailed = false;
+  _ex->cgiState = CGI_RUNNING;
+  _phaseStart = time(NULL);
+  _ex->cgiPipeFd = fd;
+  _ex->cgiPid = 0;
+  _ex->cgiBuffer.clear();
+  _ex->cgiStart = Metrics::now();
+  Metrics::add(Metrics::FASTCGI_REQUESTS);
+  LOG_DEBUG("[CGI] FastCGI request to " << address << " (fd: " << fd
+            << ")");
+  return true;
+}
+
+/**
+ * @brief Forwards the request to a proxy_pass backend
+ *
+ * Same plumbing as FastCGI: the CGI fd becomes a pooled connection to
+ * the backend chosen by UpstreamPool, watched for POLLOUT while the
+ * request is being sent and read like a CGI pipe. The response is
+ * turned into CGI output (see ProxyRequest), so it streams to the client
+ * through relayCGIOutput() with the same CGI_STREAM_WINDOW backpressure.
+ *
+ * @param location Matched location (proxy_pass settings)
+ * @return false if no backend could be reached (caller answers 502)
+ */
+bool ClientConnection::startProxy(const LocationConfig &location) {
+  if (!_services->upstreamPool)
+    return false;
+  const ProxyPass &group = location.getProxyPass();
+  std::string server;
+  bool reused = false;
+  int fd = _services->upstreamPool->acquire(group, server, reused);
+  if (fd == -1)
+    return false;
+
+  _ex->proxy.begin(_ex->httpRequest, location, server, getIp(), _tls != NULL);
+  if (!_ex->proxy.sendPending(fd)) {
+    _ex->proxy.reset();
+    _services->upstreamPool->finish(group, server, fd, false);
+    _services->upstreamPool->markFailed(server);
+    return false;
+  }
+  _ex->proxyGroup = &group;
+  _ex->proxyServer = server;
+  _ex->proxyReused = reused;
+  _ex->cgiFailed = false;
+  _ex->cgiState = CGI_RUNNING;
+  _phaseStart = time(NULL);
+  _ex->cgiPipeFd = fd;
+  _ex->cgiPid = 0;
+  _ex->cgiBuffer.clear();
+  _ex->cgiStart = Metrics::now();
+  Metrics::add(Metrics::PROXY_REQUESTS);
+  LOG_DEBUG("[proxy] " << _ex->httpRequest.getMethod() << " to " << server
+            << " (fd: " << fd << ")");
+  return true;
+}
+
+/**
+ * @brief Sends the proxied request again after its connection failed
+ *
+ * A keep-alive connection the backend closed while it sat idle fails the
+ * next request before any response byte: that says nothing about the
+ * backend, so the request goes out once more on a new connection (not
+ * marked down). Like nginx, a POST / PATCH the backend may have received
+ * whole is not sent twice.
+ *
+ * @return true if the exchange runs again on the new cgiPipeFd
+ */
+bool ClientConnection::retryProxy() {
+  if (!_ex || !_ex->proxy.isActive() || !_ex->proxyReused ||
+      _ex->proxy.hasResponse())
+    return false;
+  const std::string &method = _ex->httpRequest.getMethod();
+  if ((method == "POST" || method == "PATCH") &&
+      !_ex->proxy.hasPendingOutput())
+    return false;
+
+  _ex->proxyReused = false; // Once: a new connection failing is the backend
+  _services->upstreamPool->finish(*_ex->proxyGroup, _ex->proxyServer,
+                                  _ex->cgiPipeFd, false);
+  _ex->cgiPipeFd = -1;
+  int fd = _services->upstreamPool->reconnect(_ex->proxyServer);
+  if (fd == -1) {
+    _services->upstreamPool->markFailed(_ex->proxyServer);
+    return false;
+  }
+  _ex->proxy.rewind();
+  if (!_ex->proxy.sendPending(fd)) {
+    _services->upstreamPool->finish(*_ex->proxyGroup, _ex->proxyServer, fd,
+                                    false);
+    _services->upstreamPool->markFailed(_ex->proxyServer);
+    return false;
+  }
+  LOG_DEBUG("[proxy] Reused connection to " << _ex->proxyServer
+            << " failed, retrying on fd " << fd);
+  _ex->cgiPipeFd = fd;
+  _ex->cgiFailed = false;
+  _ex->cgiState = CGI_RUNNING;
+  return true;
+}
+
+/**
+ * @brief Whether request bytes are still waiting to reach the script
+ *
+ * CGI: body bytes not yet written to the stdin pipe. FastCGI: request
+ * records not yet sent on the connection. Proxy: request head or body
+ * bytes not yet sent to the backend.
+ */
+bool ClientConnection::hasCGIInput() const {
+  if (!_ex || _ex->cgiState != CGI_RUNNING)
+    return false;
+  if (_ex->fastcgi.isActive())
+    return _ex->fastcgi.hasPendingOutput();
+  if (_ex->proxy.isActive())
+    return _ex->proxy.hasPendingOutput();
+  return _ex->cgiStdinFd != -1 && _ex->cgiInputSent < _ex->httpRequest.getBody().size();
+}
+
+/**
+ * @brief Writes request bytes when POLLOUT fires on the CGI input fd
+ *
+ * CGI: writes the body into the stdin pipe until it is full (EAGAIN) or
+ * io_write_budget bytes went in. A script that exits or closes stdin
+ * without reading everything (EPIPE) simply stops being fed; its output
+ * is still used.
+ *
+ * @return false if the FastCGI or backend connection failed (CGI done,
+ *         hasCGIFailed()); always true for a CGI pipe
+ */
+bool ClientConnection::writeCGIInput() {
+  if (!hasCGIInput())
+    return true;
+  if (_ex->proxy.isActive()) {
+    if (_ex->proxy.sendPending(_ex->cgiPipeFd)) {
+      _lastActivity = time(NULL);
+      return true;
+    }
+    LOG_ERROR("proxy_pass: cannot send to " << _ex->proxyServer << ": "
+              << strerror(errno));
+    if (!_ex->proxy.hasResponse() && !_ex->proxyReused)
+      _services->upstreamPool->markFailed(_ex->proxyServer);
+    _ex->cgiFailed = true;
+    _ex->cgiState = CGI_DONE;
+    return false;
+  }
+  if (!_ex->fastcgi.isActive()) {
+    const std::string &body = _ex->httpRequest.getBody();
+    size_t total = 0;
+    while (_ex->cgiInputSent < body.size()) {
+      ssize_t written = write(_ex->cgiStdinFd, body.data() + _ex->cgiInputSent,
+                              body.size() - _ex->cgiInputSent);
+      if (written < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          LOG_DEBUG("[CGI] stdin closed by the script after "
+                    << _ex->cgiInputSent << " bytes");
+          _ex->cgiInputSent = body.size(); // Nothing more to feed
+        }
+        break;
+      }
+      _ex->cgiInputSent += static_cast<size_t>(written);
+      _lastActivity = time(NULL);
+      total += static_cast<size_t>(written);
+      if (total >= _services->writeBudget)
+        break;
+    }
+    return true;
+  }
+  if (_ex->fastcgi.sendPending(_ex->cgiPipeFd)) {
+    _lastActivity = time(NULL);
+    return true;
+  }
+  LOG_ERROR("FastCGI: cannot send to " << _ex->fastcgiAddress << ": "
+            << strerror(errno));
+  _ex->cgiFailed = true;
+  _ex->cgiState = CGI_DONE;
+  return false;
+}
+
+bool ClientConnection::hasCGIFailed() const { return _ex && _ex->cgiFailed; }
+
+int ClientConnection::getCGIStdinFd() const {
+  return _ex ? _ex->cgiStdinFd : -1;
+}
+
+/**
+ * @brief Closes the script's stdin: EOF once the body is written
+ *
+ * @note The Server unregisters the fd from the event backend first
+ */
+void ClientConnection::closeCGIInput() {
+  if (_ex && _ex->cgiStdinFd != -1) {
+    close(_ex->cgiStdinFd);
+    _ex->cgiStdinFd = -1;
+  }
+}
+
+/**
+ * @brief Reads and decodes FastCGI records (readCGIOutput() on a socket)
+ *
+ * The exchange is over at END_REQUEST, not at EOF: the connection stays
+ * open for the next request. EOF, a socket error (e.g. a refused
+ * connect()) or a malformed record before that marks the CGI failed.
+ *
+ * @return true while the exchange is healthy
+ */
+bool ClientConnection::readFastCGIOutput() {
+  char buffer[4096];
+  ssize_t bytesRead = recv(_ex->cgiPipeFd, buffer, sizeof(buffer), 0);
+
+  if (bytesRead > 0) {
+    _lastActivity = time(NULL);
+    if (!_ex->fastcgi.receive(buffer, bytesRead, _ex->cgiBuffer)) {
+      LOG_ERROR("FastCGI: bad response from " << _ex->fastcgiAddress);
+      _ex->cgiFailed = true;
+      _ex->cgiState = CGI_DONE;
+      return false;
+    }
+    if (_ex->fastcgi.isComplete())
+      _ex->cgiState = CGI_DONE;
+    return true;
+  }
+  if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    return true; // Spurious wakeup (e.g. connect() just completed)
+
+  if (bytesRead == 0)
+    LOG_ERROR("FastCGI: " << _ex->fastcgiAddress
+              << " closed the connection before END_REQUEST");
+  else
+    LOG_ERROR("FastCGI: " << _ex->fastcgiAddress << ": " << strerror(errno));
+  _ex->cgiFailed = true;
+  _ex->cgiState = CGI_DONE;
+  return false;
+}
+
+/**
+ * @brief Reads and decodes a backend response (readCGIOutput() on a
+ *        proxy_pass connection)
+ *
+ * The exchange is over when the response is complete, not at EOF
+ * (unless the body is delimited by EOF): the connection then goes back to
+ * the pool. EOF or an error before any response byte marks the backend
+ * failed for a while (see UpstreamPool), unless the connection was a
+ * reused one (see retryProxy()); otherwise the client gets 502, or a
+ * cut-short body if streaming had started.
+ *
+ * @return true while the exchange is healthy
+ */
+bool ClientConnection::readProxyOutput() {
+  char buffer[16384];
+  ssize_t bytesRead = recv(_ex->cgiPipeFd, buffer, sizeof(buffer), 0);
+
+  if (bytesRead > 0) {
+    _lastActivity = time(NULL);
+    if (!_ex->proxy.receive(buffer, static_cast<size_t>(bytesRead),
+                        _ex->cgiBuffer)) {
+      LOG_ERROR("proxy_pass: bad response from " << _ex->proxyServer);
+      _ex->cgiFailed = true;
+      _ex->cgiState = CGI_DONE;
+      return false;
+    }
+    if (_ex->proxy.isComplete())
+      _ex->cgiState = CGI_DONE;
+    return true;
+  }
+  if (bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    return true; // Spurious wakeup (e.g. connect() just completed)
+  if (bytesRead == 0 && _ex->proxy.receiveEof()) {
+    _ex->cgiState = CGI_DONE;
+    return true;
+  }
+
+  if (bytesRead == 0)
+    LOG_ERROR("proxy_pass: " << _ex->proxyServer
+              << " closed the connection before the end of the response");
+  else
+    LOG_ERROR("proxy_pass: " << _ex->proxyServer << ": " << strerror(errno));
+  if (!_ex->proxy.hasResponse() && !_ex->proxyReused)
+    _services->upstreamPool->markFailed(_ex->proxyServer);
+  _ex->cgiFailed = true;
+  _ex->cgiState = CGI_DONE;
+  return false;
+}
+
+// ==================== CGI Cache ====================
+
+/**
+ * @brief Builds the cgi_cache key of the current request
+ *
+ * Scheme, host and target as received (query included), then the
+ * cgi_cache_key request headers of the location:
+ *   "GET http://example.com/app.py?id=3\nAccept-Language: fr"
+ * HEAD shares the entries of GET.
+ */
+std::string ClientConnection::cacheKey(const CGICachePolicy &policy) const {
+  std::string key(_tls ? "GET https://" : "GET http://");
+  size_t length;
+  const char *value = _ex->httpRequest.getHeaderValue("Host", length);
+  for (size_t i = 0; value && i < length; ++i)
+    key += static_cast<char>(std::tolower(static_cast<unsigned char>(value[i])));
+  const char *target = _ex->httpRequest.getTarget(length);
+  key.append(target, length);
+  for (size_t i = 0; i < policy.keyHeaders.size(); ++i) {
+    value = _ex->httpRequest.getHeaderValue(policy.keyHeaders[i].c_str(), length);
+    key += '\n';
+    key += policy.keyHeaders[i];
+    key += ": ";
+    if (value)
+      key.append(value, length);
+  }
+  return key;
+}
+
+/**
+ * @brief Answers a CGI / proxy_pass request from cgi_cache if possible
+ *
+ * Called by RequestHandler right before the origin would be started:
+ * - hit: response is built from the cached output (with an Age header)
+ * - another request is filling the key: the connection is parked
+ *   (isCacheWaiting()) and runs the request again once it is done
+ * - miss: the connection holds the key's lock, and the output of the
+ *   origin is stored when it is complete (see endCacheFill())
+ * Requests with credentials and other methods than GET/HEAD bypass it.
+ *
+ * @param location Matched location (cgi_cache settings)
+ * @param response Receives the cached response on a hit
+ * @return true if response is answered or deferred, false to run the
+ *         origin
+ */
+bool ClientConnection::lookupCGICache(const LocationConfig &location,
+                                      HttpResponse &response) {
+  const CGICachePolicy &policy = location.getCGICache();
+  if (!_services->cgiCache || !_services->cgiCache->isEnabled() || !policy.enabled ||
+      _ex->cacheBypass)
+    return false;
+  const std::string &method = _ex->httpRequest.getMethod();
+  size_t length;
+  if ((method != "GET" && method != "HEAD") ||
+      _ex->httpRequest.getHeaderValue("Authorization", length))
+    return false;
+
+  std::string key = cacheKey(policy);
+  const std::string *output = NULL;
+  time_t age = 0;
+  switch (_services->cgiCache->lookup(key, method == "GET", output, age)) {
+  case CGICache::HIT: {
+    _ex->cgiBuffer = *output; // The response body is a view into _ex->cgiBuffer
+    CGIHandler cgiHandler;
+    response = cgiHandler.buildResponseFromCGIOutput(_ex->cgiBuffer);
+    std::ostringstream ageValue;
+    ageValue << age;
+    response.setHeader("Age", ageValue.str());
+    if (method == "HEAD")
+      response.clearBody(); // Content-Length stays
+    LOG_DEBUG("[cache] HIT " << key);
+    return true;
+  }
+  case CGICache::WAIT:
+    _ex->cacheKey = key;
+    _ex->cacheWaiting = true;
+    _phaseStart = time(NULL);
+    _services->cgiCache->wait(key, this);
+    return true;
+  case CGICache::FILL:
+    _ex->cacheKey = key;
+    _ex->cacheFilling = true;
+    _ex->cachePolicy = &policy;
+    return false;
+  case CGICache::BYPASS:
+    break;
+  }
+  return false;
+}
+
+bool ClientConnection::isCacheWaiting() const {
+  return _ex && _ex->cacheWaiting;
+}
+
+/**
+ * @brief Ends a wait for a cgi_cache fill
+ *
+ * The request is then processed again (by the Server): normally a hit
+ * now. After a wait of cgi_timeout the request goes to the origin
+ * without the cache, rather than queuing behind a slow script again.
+ *
+ * @param timedOut The lock was not released in time (or the connection
+ *        closes)
+ */
+void ClientConnection::resumeCacheWait(bool timedOut) {
+  if (!_ex || !_ex->cacheWaiting)
+    return;
+  if (timedOut) {
+    _services->cgiCache->cancel(_ex->cacheKey, this);
+    _ex->cacheBypass = true;
+  }
+  _ex->cacheWaiting = false;
+  _ex->cacheKey.clear();
+}
+
+/**
+ * @brief Accounts the request in the limit_req zone of its location
+ *
+ * The key is hashed straight from where it lives (client address, server
+ * name, header bytes in the request buffer): nothing is copied. A request
+ * without the key's header is not limited. A request that runs again
+ * (I/O task, cgi_cache wait, end of its delay) was already accounted and
+ * passes.
+ *
+ * On DELAY the connection holds the request: the delay is rounded up to
+ * the second the timer wheel wakes it at.
+ *
+ * @param location Matched location (its limit_req)
+ * @param server Matched virtual host ($server_name keys)
+ * @return PASS, DELAY (held) or REJECT (answer 429)
+ */
+RateLimiter::Result
+ClientConnection::checkRateLimit(const LocationConfig &location,
+                                 const ServerConfig &server) {
+  const LimitReq &limit = location.getLimitReq();
+  if (!_services->rateLimiter || limit.zone < 0 || _ex->limitChecked ||
+      static_cast<size_t>(limit.zone) >= _services->rateLimiter->zoneCount())
+    return RateLimiter::PASS; // Zone added by a reload: read at startup
+  _ex->limitChecked = true;
+
+  const LimitReqZone &zone = _services->rateLimiter->getZone(limit.zone);
+  uint64_t key;
+  if (!RateLimiter::requestKey(zone, getAddr(), server, _ex->httpRequest,
+                               key))
+    return RateLimiter::PASS;
+
+  uint64_t delayMs = 0;
+  RateLimiter::Result result = _services->rateLimiter->check(
+      limit, key, Metrics::now() / 1000000, delayMs);
+  if (result == RateLimiter::DELAY) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    uint64_t resumeMs = static_cast<uint64_t>(now.tv_sec) * 1000 +
+                        now.tv_usec / 1000 + delayMs;
+    _ex->limitResume = static_cast<time_t>((resumeMs + 999) / 1000);
+    _ex->limitDelayed = true;
+  }
+  return result;
+}
+
+bool ClientConnection::isLimitDelayed() const {
+  return _ex && _ex->limitDelayed;
+}
+
+time_t ClientConnection::getLimitResume() const {
+  return _ex ? _ex->limitResume : 0;
+}
+
+/**
+ * @brief Ends a limit_req delay: the request runs at the next
+ *        processRequest()
+ */
+void ClientConnection::resumeLimitDelay() {
+  if (_ex)
+    _ex->limitDelayed = false;
+}
+
+/**
+ * @brief Paces the response of the current request to limit.rate
+ *
+ * Kept until the response is sent (resetForNextRequest()); the bytes are
+ * counted from queueResponse().
+ *
+ * @param limit limit_rate of the matched location
+ */
+void ClientConnection::setLimitRate(const LimitRate &limit) {
+  _ex->limitRate = limit;
+}
+
+bool ClientConnection::isRatePaused() const { return _ex && _ex->ratePaused; }
+
+time_t ClientConnection::getRateResume() const {
+  return _ex ? _ex->rateResume : 0;
+}
+
+/**
+ * @brief Ends a limit_rate pause: the next POLLOUT sends again
+ */
+void ClientConnection::resumeRatePause() {
+  if (_ex)
+    _ex->ratePaused = false;
+}
+
+/**
+ * @brief Ends a cgi_cache fill: stores the output or gives the lock up
+ *
+ * The output is what was streamed so far (_ex->cacheFill) plus what is still
+ * in _ex->cgiBuffer, or _ex->cgiBuffer alone if the response was not streamed.
+ * Its lifetime follows the response headers (see CGICache::lifetime()).
+ *
+ * @param complete The origin's output is whole and valid
+ */
+void ClientConnection::endCacheFill(bool complete) {
+  if (!_ex->cacheFilling)
+    return;
+  _ex->cacheFilling = false;
+  if (!complete) {
+    _services->cgiCache->release(_ex->cacheKey, false);
+  } else {
+    if (_ex->cacheFill.empty())
+      _ex->cacheFill = _ex->cgiBuffer;
+    else
+      _ex->cacheFill += _ex->cgiBuffer;
+    long ttl = CGICache::lifetime(_ex->cacheFill, _ex->cachePolicy->valid,
+                                  _ex->cachePolicy->keyHeaders, time(NULL));
+    _services->cgiCache->store(_ex->cacheKey, _ex->cacheFill, ttl);
+  }
+  _ex->cacheKey.clear();
+  _ex->cachePolicy = NULL;
+  std::string().swap(_ex->cacheFill);
+}
+
+// ==================== Streamed CGI Output ====================
+
+/**
+ * @brief Moves CGI output read so far towards the client
+ *
+ * Called by the Server after every read of the CGI fd. Until the header
+ * block is complete nothing happens. Once it is, the response head is
+ * built from it and queued right away, and from then on every read is
+ * appended to the response as a body segment:
+ *
+ *   _ex->cgiBuffer: "Status: 200\r\nContent-Type: ...\r\n\r\n<body...>"
+ *                └────────── head, queued once ──────────┘└ segment ┘
+ *   next reads:                                  "<more>" → segment
+ *
+ * The body keeps the script's Content-Length if it gave one; otherwise it
+ * is sent with chunked transfer-coding, and gzip-encoded on the way when
+ * the client accepts it and the type is in gzip_types (each read is
+ * flushed through the encoder, so nothing is held back). An HTTP/1.0 client understands
+ * neither a missing length nor chunks, so its response is still collected
+ * whole and sent by the Server when the CGI is done. A CGI that failed or
+ * finished before its headers were complete also takes that path.
+ */
+void ClientConnection::relayCGIOutput() {
+  if (!_ex->cgiStreaming) {
+    if (_ex->cgiBuffered || _ex->cgiState != CGI_RUNNING || _ex->cgiFailed)
+      return;
+    size_t bodyOffset;
+    _ex->httpResponse.reset();
+    CGIHandler cgiHandler;
+    if (!cgiHandler.buildResponseHead(_ex->cgiBuffer, _ex->httpResponse, bodyOffset))
+      return; // Header block not complete yet
+    bool hasLength = _ex->httpResponse.hasHeader("Content-Length");
+    if (!hasLength && _ex->httpRequest.getVersion() != "HTTP/1.1") {
+      _ex->cgiBuffered = true;
+      _ex->httpResponse.reset();
+      return;
+    }
+    _ex->cgiChunked = !hasLength;
+    if (_ex->cgiChunked)
+      _ex->httpResponse.setHeader("Transfer-Encoding", "chunked");
+    if (_ex->cgiChunked && _services->compression && _ex->httpResponse.getStatusCode() == 200 &&
+        !_ex->httpResponse.hasHeader("Content-Encoding") &&
+        _services->compression->canCompress(Compression::GZIP, 0) &&
+        _services->compression->isCompressible(_ex->httpResponse.getHeader("Content-Type"),
+                                     -1) &&
+        _services->compression->negotiate(_ex->httpRequest, false) == Compression::GZIP &&
+        _ex->cgiGzip.begin(_services->compression->getLevel())) {
+      _ex->httpResponse.setHeader("Content-Encoding", "gzip");
+      _ex->httpResponse.setHeader("Vary", "Accept-Encoding");
+    }
+    _ex->cgiStreaming = true;
+    queueResponse();
+    if (_ex->cacheFilling)
+      _ex->cacheFill.assign(_ex->cgiBuffer, 0, bodyOffset);
+    _ex->cgiBuffer.erase(0, bodyOffset);
+    LOG_DEBUG("[CGI] Streaming response (fd: " << _clientFd << ", "
+              << (_ex->cgiChunked ? "chunked" : "Content-Length") << ")");
+  }
+  if (_ex->cgiBuffer.empty())
+    return;
+  if (_ex->httpRequest.getMethod() == "HEAD") {
+    _ex->cgiBuffer.clear();
+    return;
+  }
+  if (_ex->cacheFilling) {
+    _ex->cacheFill.append(_ex->cgiBuffer);
+    if (_ex->cacheFill.size() > _services->cgiCache->getMaxEntrySize()) {
+      _services->cgiCache->release(_ex->cacheKey, true); // Too large to keep
+      _ex->cacheFilling = false;
+      std::string().swap(_ex->cacheFill);
+    }
+  }
+  if (_ex->cgiGzip.isActive()) {
+    std::string encoded;
+    if (!_ex->cgiGzip.update(_ex->cgiBuffer, encoded)) {
+      _ex->cgiFailed = true; // Cut short, see endCGIStream()
+      _ex->cgiBuffer.clear();
+      return;
+    }
+    _ex->cgiBuffer.swap(encoded);
+  }
+
+  // Segments already sent are dropped, so memory stays within the window
+  if (_ex->segmentIndex == _ex->segments.size()) {
+    _ex->segments.clear();
+    _ex->segmentIndex = 0;
+    _ex->segmentSent = 0;
+  }
+  _ex->cgiStreamed += static_cast<off_t>(_ex->cgiBuffer.size());
+  if (_ex->cgiChunked)
+    appendStreamChunk(_ex->cgiBuffer);
+  else
+    appendStreamSegment(_ex->cgiBuffer);
+}
+
+/**
+ * @brief Appends one chunk (size line, data, CRLF) to the streamed body
+ *
+ * @param data Chunk data, non-empty; taken over like appendStreamSegment()
+ */
+void ClientConnection::appendStreamChunk(std::string &data) {
+  std::ostringstream size;
+  size << std::hex << data.size() << "\r\n";
+  std::string prefix = size.str();
+  appendStreamSegment(prefix);
+  appendStreamSegment(data);
+  std::string suffix("\r\n");
+  appendStreamSegment(suffix);
+}
+
+/**
+ * @brief Appends a memory segment to the streamed body
+ *
+ * @param data Bytes to send; taken over (left empty) without a copy
+ */
+void ClientConnection::appendStreamSegment(std::string &data) {
+  _ex->segments.push_back(BodySegment());
+  BodySegment &segment = _ex->segments.back();
+  segment.data.swap(data);
+  segment.length = static_cast<off_t>(segment.data.size());
+}
+
+bool ClientConnection::isCGIStreaming() const {
+  return _ex && _ex->cgiStreaming;
+}
+
+/**
+ * @brief Terminates a streamed response (CGI finished, pipe closed)
+ *
+ * Appends the last chunk when the body is chunked. A CGI that failed
+ * midway (FastCGI error, cgi_timeout) cannot be reported any more: the
+ * connection is closed so the client sees the body was cut short.
  */
-void ClientConnection::setCGIResponse(const std::string &responseStr) {
-  _writeBuffer = responseStr;
-  _writeOffset = 0;
+void ClientConnection::endCGIStream() {
+  relayCGIOutput(); // Output read together with EOF
+  _ex->cgiStreaming = false;
+  if (_ex->cgiFailed) {
+    LOG_ERROR("[CGI] Streamed response cut short (fd: " << _clientFd << ")");
+    _ex->cgiGzip.end();
+    _closed = true;
+    return;
+  }
+  if (_ex->cgiGzip.isActive() && _ex->httpRequest.getMethod() != "HEAD") {
+    std::string trailer; // Rest of the deflate stream + CRC32 and length
+    if (_ex->cgiGzip.finish(trailer) && !trailer.empty()) {
+      _ex->cgiStreamed += static_cast<off_t>(trailer.size());
+      appendStreamChunk(trailer);
+    }
+  }
+  _ex->cgiGzip.end();
+  if (_ex->cgiChunked && _ex->httpRequest.getMethod() != "HEAD") {
+    std::string last("0\r\n\r\n");
+    appendStreamSegment(last);
+  }
+  if (!hasPendingWrite())
+    onResponseSent();
+}
+
+/**
+ * @brief Bytes queued for the client and not sent yet
+ *
+ * Counts the unsent part of the header block and of the relayed
+ * segments; the Server stops reading the CGI at CGI_STREAM_WINDOW.
+ */
+size_t ClientConnection::getCGIBacklog() const {
+  if (!_ex)
+    return 0;
+  size_t backlog = _ex->writeBuffer.size() + _ex->bodyLength - _ex->writeOffset;
+  for (size_t i = _ex->segmentIndex; i < _ex->segments.size(); ++i)
+    backlog += static_cast<size_t>(_ex->segments[i].length);
+  return backlog - static_cast<size_t>(_ex->segmentSent);
+}
+
+bool ClientConnection::isCGIPaused() const { return _ex && _ex->cgiPaused; }
+
+void ClientConnection::setCGIPaused(bool paused) {
+  if (_ex)
+    _ex->cgiPaused = paused;
 }
@@ -0,0 +1,143 @@
+#include "network/ConnectionPool.hpp"
+#include <new>
+
+/**
+ * @file ConnectionPool.cpp
+ * @brief Recycling of connection objects and of their request state
+ *
+ * A connection used to embed everything a request needs (parser with its
+ * header table, response, handler, write and CGI state): close to 4 KB
+ * per socket, idle or not, allocated with new on accept() and freed on
+ * close. It is now split in two:
+ * - ClientConnection, the hot part (fd, flags, timestamps, receive
+ *   buffer handle), built with placement new in storage this pool keeps
+ *   from closed connections;
+ * - ClientExchange, the request state, taken when a request starts and
+ *   handed back once its response is sent and the connection is idle in
+ *   keep-alive. A returned exchange keeps the capacity of its buffers, so
+ *   the next request does not grow them again.
+ * Busy connections are bounded by the traffic, not by the number of open
+ * sockets.
+ *
+ * Up to maxFreeConnections storage blocks (a few hundred bytes each) and
+ * maxFreeExchanges exchanges (some KB each) are kept; beyond that they
+ * are freed, so a burst does not pin its memory forever.
+ *
+ * @note Single-threaded per process, like the rest of the event loop
+ */
+
+/**
+ * @param maxFreeConnections Storage of closed connections kept for reuse
+ * @param maxFreeExchanges Released exchanges kept for reuse
+ */
+ConnectionPool::ConnectionPool(size_t maxFreeConnections,
+                               size_t maxFreeExchanges)
+    : _maxFreeConnections(maxFreeConnections),
+      _maxFreeExchanges(maxFreeExchanges), _connections(0), _exchanges(0), _acquired(0),
+      _reused(0) {}
+
+/**
+ * @brief Frees the pooled storage and exchanges
+ *
+ * @note Live connections must be destroyed before
+ */
+ConnectionPool::~ConnectionPool() {
+  for (size_t i = 0; i < _freeConnections.size(); ++i)
+    ::operator delete(_freeConnections[i]);
+  for (size_t i = 0; i < _freeExchanges.size(); ++i)
+    delete _freeExchanges[i];
+}
+
+/**
+ * @brief Builds a connection, reusing the storage of a closed one
+ *
+ * @return New connection (see ClientConnection's constructor)
+ */
+ClientConnection *ConnectionPool::create(int fd, const sockaddr_in &addr,
+                                         ConfigSnapshot *config,
+                                         const ListenerConfig &listener,
+                                         const ConnectionServices &services) {
+  void *storage;
+  if (!_freeConnections.empty()) {
+    storage = _freeConnections.back();
+    _freeConnections.pop_back();
+  } else {
+    storage = ::operator new(sizeof(ClientConnection));
+  }
+  ClientConnection *client;
+  try {
+    client = new (storage) ClientConnection(fd, addr, config, listener,
+                                            services);
+  } catch (...) {
+    ::operator delete(storage);
+    throw;
+  }
+  ++_connections;
+  return client;
+}
+
+/**
+ * @brief Destroys a connection and keeps its storage for the next one
+ *
+ * @param client Connection from create(), NULL is ignored
+ */
+void ConnectionPool::destroy(ClientConnection *client) {
+  if (!client)
+    return;
+  client->~ClientConnection(); // Hands its exchange back first
+  --_connections;
+  if (_freeConnections.size() < _maxFreeConnections)
+    _freeConnections.push_back(client);
+  else
+    ::operator delete(client);
+}
+
+/**
+ * @brief Takes a free exchange, or builds one when the pool is empty
+ *
+ * @param services Caches the handler of a new exchange is wired to (the
+ *        same for every connection of the process)
+ * @return Exchange in the reset state
+ */
+ClientExchange *
+ConnectionPool::acquireExchange(const ConnectionServices &services) {
+  ++_acquired;
+  if (!_freeExchanges.empty()) {
+    ClientExchange *exchange = _freeExchanges.back();
+    _freeExchanges.pop_back();
+    ++_reused;
+    return exchange;
+  }
+  ++_exchanges;
+  return new ClientExchange(services);
+}
+
+/**
+ * @brief Puts an exchange back (or frees it if the pool is full)
+ *
+ * @param exchange Exchange from acquireExchange(), reset by its connection
+ */
+void ConnectionPool::releaseExchange(ClientExchange *exchange) {
+  if (!exchange)
+    return;
+  if (_freeExchanges.size() < _maxFreeExchanges) {
+    _freeExchanges.push_back(exchange);
+    return;
+  }
+  delete exchange;
+  --_exchanges;
+}
+
+size_t ConnectionPool::getConnections() const { return _connections; }
+
+size_t ConnectionPool::getExchangesInUse() const {
+  return _exchanges - _freeExchanges.size();
+}
+
+size_t ConnectionPool::getFreeExchanges() const {
+  return _freeExchanges.size();
+}
+
+unsigned long ConnectionPool::getAcquired() const { return _acquired; }
+
+unsigned long ConnectionPool::getReused() const { return _reused; }
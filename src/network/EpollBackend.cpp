@@ -0,0 +1,131 @@
+#include "network/EpollBackend.hpp"
+
+#ifdef WEBSERV_HAVE_EPOLL
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @file EpollBackend.cpp
+ * @brief epoll(7) readiness backend for Linux
+ *
+ * The kernel keeps the interest list, so registration changes are single
+ * epoll_ctl() calls and epoll_wait() returns only the fds that are actually
+ * ready: the event loop cost is O(ready) instead of O(registered).
+ *
+ * Level-triggered mode is used on purpose: ClientConnection performs one
+ * read/write per readiness notification, so an fd that still has data will
+ * simply be reported again on the next wait() - same semantics as poll().
+ *
+ * Events are translated to POLL* bits so Server code is backend-agnostic.
+ */
+
+/** @brief Upper bound of events harvested per epoll_wait() call */
+static const size_t MAX_EVENTS_PER_WAIT = 1024;
+
+EpollBackend::EpollBackend() : _epollFd(-1), _count(0) {}
+
+EpollBackend::~EpollBackend() {
+  if (_epollFd != -1)
+    close(_epollFd);
+}
+
+/**
+ * @brief Creates the epoll instance
+ *
+ * @return false if epoll_create() fails (caller falls back to poll)
+ */
+bool EpollBackend::init() {
+  _epollFd = epoll_create(MAX_EVENTS_PER_WAIT);
+  if (_epollFd == -1)
+    return false;
+  fcntl(_epollFd, F_SETFD, FD_CLOEXEC); // Not inherited by CGI children
+  _events.resize(MAX_EVENTS_PER_WAIT);
+  return true;
+}
+
+/**
+ * @brief POLL* mask → EPOLL* mask
+ */
+unsigned int EpollBackend::toEpoll(short events) {
+  unsigned int result = 0;
+  if (events & POLLIN)
+    result |= EPOLLIN;
+  if (events & POLLOUT)
+    result |= EPOLLOUT;
+  return result;
+}
+
+/**
+ * @brief EPOLL* mask → POLL* mask
+ */
+short EpollBackend::fromEpoll(unsigned int events) {
+  short result = 0;
+  if (events & EPOLLIN)
+    result |= POLLIN;
+  if (events & EPOLLOUT)
+    result |= POLLOUT;
+  if (events & EPOLLERR)
+    result |= POLLERR;
+  if (events & EPOLLHUP)
+    result |= POLLHUP;
+  return result;
+}
+
+bool EpollBackend::add(int fd, short events) {
+  struct epoll_event ev;
+  ev.events = toEpoll(events);
+  ev.data.fd = fd;
+  if (epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &ev) == -1)
+    return false;
+  ++_count;
+  return true;
+}
+
+bool EpollBackend::modify(int fd, short events) {
+  struct epoll_event ev;
+  ev.events = toEpoll(events);
+  ev.data.fd = fd;
+  return epoll_ctl(_epollFd, EPOLL_CTL_MOD, fd, &ev) != -1;
+}
+
+/**
+ * @brief Removes fd from the interest list
+ *
+ * @note If fd was already closed the kernel dropped it by itself; the
+ *       counter is still decremented because the caller tracked it as added.
+ */
+void EpollBackend::remove(int fd) {
+  struct epoll_event ev; // Non-NULL required by kernels < 2.6.9
+  ev.events = 0;
+  ev.data.fd = fd;
+  epoll_ctl(_epollFd, EPOLL_CTL_DEL, fd, &ev);
+  if (_count > 0)
+    --_count;
+}
+
+/**
+ * @brief Waits with epoll_wait() and copies ready fds to `ready`
+ *
+ * @return Number of ready fds, 0 on timeout, -1 on error
+ */
+int EpollBackend::wait(int timeoutMs, std::vector<ReadyEvent> &ready) {
+  ready.clear();
+  int n = epoll_wait(_epollFd, &_events[0], (int)_events.size(), timeoutMs);
+  if (n <= 0)
+    return n;
+
+  for (int i = 0; i < n; ++i) {
+    ReadyEvent event;
+    event.fd = _events[i].data.fd;
+    event.events = fromEpoll(_events[i].events);
+    ready.push_back(event);
+  }
+  return n;
+}
+
+size_t EpollBackend::size() const { return _count; }
+
+const char *EpollBackend::name() const { return "epoll"; }
+
+#endif
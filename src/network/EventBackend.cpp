@@ -0,0 +1,103 @@
+#include "network/EventBackend.hpp"
+#include "core/Logger.hpp"
+#include "network/EpollBackend.hpp"
+#include "network/KqueueBackend.hpp"
+#include "network/PollBackend.hpp"
+#include "network/UringBackend.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * @file EventBackend.cpp
+ * @brief Factory for readiness backends
+ *
+ * Selection order when no explicit name is given:
+ *   Linux       → epoll
+ *   macOS / BSD → kqueue
+ *   otherwise   → poll
+ *
+ * An explicit name ("poll", "epoll", "kqueue", "io_uring") forces that
+ * backend when it is compiled in. io_uring is never picked by default: it
+ * is used only when asked for (events { use io_uring; }), and epoll takes
+ * over when the kernel refuses it (too old, io_uring_disabled, seccomp).
+ * If the chosen backend fails to initialize, poll() is used so the server
+ * still starts.
+ */
+
+bool EventBackend::addListener(int fd) { return add(fd, POLLIN); }
+
+/**
+ * @brief Accepts one pending connection, non-blocking and close-on-exec
+ *
+ * accept4() sets both flags atomically in the same system call; other
+ * platforms fall back to accept() + fcntl().
+ *
+ * @return Client fd, or -1 with errno set by accept
+ */
+int EventBackend::accept(int fd, sockaddr_in &addr) {
+  socklen_t length = sizeof(addr);
+#ifdef SOCK_NONBLOCK
+  return accept4(fd, reinterpret_cast<sockaddr *>(&addr), &length,
+                 SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+  int clientFd = ::accept(fd, reinterpret_cast<sockaddr *>(&addr), &length);
+  if (clientFd == -1)
+    return -1;
+  int flags = fcntl(clientFd, F_GETFL, 0);
+  if (flags == -1 || fcntl(clientFd, F_SETFL, flags | O_NONBLOCK) == -1) {
+    int saved = errno;
+    close(clientFd);
+    errno = saved;
+    return -1;
+  }
+  fcntl(clientFd, F_SETFD, FD_CLOEXEC); // Never leaked into a CGI script
+  return clientFd;
+#endif
+}
+
+/**
+ * @brief Instantiates and initializes a backend by name
+ *
+ * @param name Backend name, or "" for the platform default
+ * @return Heap-allocated backend (caller owns it), never NULL
+ */
+EventBackend *EventBackend::create(const std::string &name) {
+  EventBackend *backend = NULL;
+
+#ifdef WEBSERV_HAVE_URING
+  if (name == "io_uring") {
+    backend = new UringBackend();
+    if (backend->init())
+      return backend;
+    LOG_WARN("io_uring backend unavailable, falling back to epoll");
+    delete backend;
+    backend = NULL;
+  }
+#endif
+#ifdef WEBSERV_HAVE_EPOLL
+  if (!backend && name == "io_uring")
+    backend = new EpollBackend();
+  if (!backend && (name.empty() || name == "epoll"))
+    backend = new EpollBackend();
+#endif
+#ifdef WEBSERV_HAVE_KQUEUE
+  if (!backend && (name.empty() || name == "kqueue"))
+    backend = new KqueueBackend();
+#endif
+
+  if (backend && !backend->init()) {
+    LOG_WARN(backend->name() << " backend unavailable, falling back to poll()");
+    delete backend;
+    backend = NULL;
+  }
+  if (!backend) {
+    if (!name.empty() && name != "poll")
+      LOG_WARN("Event backend '" << name
+               << "' not supported on this platform, using poll()");
+    backend = new PollBackend();
+    backend->init();
+  }
+  return backend;
+}
@@ -0,0 +1,153 @@
+#include "network/KqueueBackend.hpp"
+
+#ifdef WEBSERV_HAVE_KQUEUE
+
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @file KqueueBackend.cpp
+ * @brief kqueue(2) readiness backend for macOS and the BSDs
+ *
+ * kqueue tracks read and write interest as two independent filters
+ * (EVFILT_READ / EVFILT_WRITE), so a single fd can come back as two kevents
+ * in the same batch. wait() merges them into one ReadyEvent per fd using a
+ * small fd → slot table, keeping the Server-facing contract identical to
+ * the poll/epoll backends.
+ *
+ * EV_EOF is mapped to POLLHUP and EV_ERROR to POLLERR.
+ */
+
+/** @brief Upper bound of events harvested per kevent() call */
+static const size_t MAX_EVENTS_PER_WAIT = 1024;
+
+KqueueBackend::KqueueBackend() : _kqueueFd(-1), _count(0) {}
+
+KqueueBackend::~KqueueBackend() {
+  if (_kqueueFd != -1)
+    close(_kqueueFd);
+}
+
+bool KqueueBackend::init() {
+  _kqueueFd = kqueue();
+  if (_kqueueFd == -1)
+    return false;
+  fcntl(_kqueueFd, F_SETFD, FD_CLOEXEC); // Not inherited by CGI children
+  _events.resize(MAX_EVENTS_PER_WAIT);
+  return true;
+}
+
+/**
+ * @brief Adds or deletes one filter for fd
+ */
+bool KqueueBackend::applyFilter(int fd, short filter, bool enable) {
+  struct kevent change;
+  EV_SET(&change, fd, filter, enable ? EV_ADD : EV_DELETE, 0, 0, NULL);
+  return kevent(_kqueueFd, &change, 1, NULL, 0, NULL) != -1;
+}
+
+bool KqueueBackend::add(int fd, short events) {
+  if (fd < 0)
+    return false;
+  if ((size_t)fd >= _interestByFd.size()) {
+    _interestByFd.resize(fd + 1, 0);
+    _readySlot.resize(fd + 1, -1);
+  }
+  if (_interestByFd[fd] != 0)
+    return modify(fd, events);
+
+  _interestByFd[fd] = events | POLLNVAL; // POLLNVAL marks "registered"
+  if ((events & POLLIN) && !applyFilter(fd, EVFILT_READ, true))
+    return false;
+  if ((events & POLLOUT) && !applyFilter(fd, EVFILT_WRITE, true))
+    return false;
+  ++_count;
+  return true;
+}
+
+/**
+ * @brief Applies only the filter differences between old and new masks
+ */
+bool KqueueBackend::modify(int fd, short events) {
+  if (fd < 0 || (size_t)fd >= _interestByFd.size() || !_interestByFd[fd])
+    return false;
+
+  short old = _interestByFd[fd];
+  bool ok = true;
+  if ((old & POLLIN) != (events & POLLIN))
+    ok = applyFilter(fd, EVFILT_READ, events & POLLIN) && ok;
+  if ((old & POLLOUT) != (events & POLLOUT))
+    ok = applyFilter(fd, EVFILT_WRITE, events & POLLOUT) && ok;
+  _interestByFd[fd] = events | POLLNVAL;
+  return ok;
+}
+
+void KqueueBackend::remove(int fd) {
+  if (fd < 0 || (size_t)fd >= _interestByFd.size() || !_interestByFd[fd])
+    return;
+  short old = _interestByFd[fd];
+  if (old & POLLIN)
+    applyFilter(fd, EVFILT_READ, false);
+  if (old & POLLOUT)
+    applyFilter(fd, EVFILT_WRITE, false);
+  _interestByFd[fd] = 0;
+  --_count;
+}
+
+/**
+ * @brief Waits with kevent() and merges read/write filters per fd
+ *
+ * @return Number of ready fds, 0 on timeout, -1 on error
+ */
+int KqueueBackend::wait(int timeoutMs, std::vector<ReadyEvent> &ready) {
+  ready.clear();
+
+  struct timespec ts;
+  struct timespec *tsp = NULL;
+  if (timeoutMs >= 0) {
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+    tsp = &ts;
+  }
+
+  int n = kevent(_kqueueFd, NULL, 0, &_events[0], (int)_events.size(), tsp);
+  if (n <= 0)
+    return n;
+
+  for (int i = 0; i < n; ++i) {
+    int fd = (int)_events[i].ident;
+    short bits = 0;
+    if (_events[i].filter == EVFILT_READ)
+      bits |= POLLIN;
+    else if (_events[i].filter == EVFILT_WRITE)
+      bits |= POLLOUT;
+    if (_events[i].flags & EV_EOF)
+      bits |= POLLHUP;
+    if (_events[i].flags & EV_ERROR)
+      bits |= POLLERR;
+
+    if (fd >= 0 && (size_t)fd < _readySlot.size() && _readySlot[fd] != -1) {
+      ready[_readySlot[fd]].events |= bits;
+      continue;
+    }
+    ReadyEvent event;
+    event.fd = fd;
+    event.events = bits;
+    if (fd >= 0 && (size_t)fd < _readySlot.size())
+      _readySlot[fd] = (int)ready.size();
+    ready.push_back(event);
+  }
+
+  for (size_t i = 0; i < ready.size(); ++i) {
+    if ((size_t)ready[i].fd < _readySlot.size())
+      _readySlot[ready[i].fd] = -1;
+  }
+  return (int)ready.size();
+}
+
+size_t KqueueBackend::size() const { return _count; }
+
+const char *KqueueBackend::name() const { return "kqueue"; }
+
+#endif
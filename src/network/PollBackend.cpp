@@ -0,0 +1,108 @@
+#include "network/PollBackend.hpp"
+
+/**
+ * @file PollBackend.cpp
+ * @brief poll() readiness backend - portable fallback for EventBackend
+ *
+ * Keeps the classic std::vector<pollfd> array, plus an fd → index table so
+ * add/modify/remove are O(1) instead of a linear search. Removal swaps the
+ * last entry into the freed slot (ordering of the array does not matter).
+ *
+ * wait() still has to scan the whole array after poll() returns - that is
+ * inherent to poll(2) and the reason the epoll/kqueue backends exist.
+ *
+ * @see poll(2) man page for POSIX poll() details
+ */
+
+PollBackend::PollBackend() {}
+
+PollBackend::~PollBackend() {}
+
+/**
+ * @brief Nothing to allocate for poll() - always succeeds
+ */
+bool PollBackend::init() { return true; }
+
+/**
+ * @brief Registers a new fd in the pollfd array
+ *
+ * @param fd File descriptor to monitor
+ * @param events POLLIN / POLLOUT mask
+ * @return false if fd is invalid or already registered
+ */
+bool PollBackend::add(int fd, short events) {
+  if (fd < 0)
+    return false;
+  if ((size_t)fd >= _indexByFd.size())
+    _indexByFd.resize(fd + 1, -1);
+  if (_indexByFd[fd] != -1)
+    return modify(fd, events);
+
+  struct pollfd pollFd;
+  pollFd.fd = fd;
+  pollFd.events = events;
+  pollFd.revents = 0;
+  _indexByFd[fd] = (int)_pollFds.size();
+  _pollFds.push_back(pollFd);
+  return true;
+}
+
+/**
+ * @brief Changes the watched events of a registered fd
+ *
+ * @return false if fd is not registered
+ */
+bool PollBackend::modify(int fd, short events) {
+  if (fd < 0 || (size_t)fd >= _indexByFd.size() || _indexByFd[fd] == -1)
+    return false;
+  _pollFds[_indexByFd[fd]].events = events;
+  return true;
+}
+
+/**
+ * @brief Unregisters an fd (swap-with-last, O(1))
+ *
+ * @note No effect if fd is not registered
+ */
+void PollBackend::remove(int fd) {
+  if (fd < 0 || (size_t)fd >= _indexByFd.size() || _indexByFd[fd] == -1)
+    return;
+
+  size_t index = _indexByFd[fd];
+  size_t last = _pollFds.size() - 1;
+  if (index != last) {
+    _pollFds[index] = _pollFds[last];
+    _indexByFd[_pollFds[index].fd] = (int)index;
+  }
+  _pollFds.pop_back();
+  _indexByFd[fd] = -1;
+}
+
+/**
+ * @brief Calls poll() and collects fds with non-zero revents
+ *
+ * @param timeoutMs Timeout in milliseconds (-1 = infinite, 0 = immediate)
+ * @param ready Output list (cleared first)
+ * @return Number of ready fds, 0 on timeout, -1 on error
+ */
+int PollBackend::wait(int timeoutMs, std::vector<ReadyEvent> &ready) {
+  ready.clear();
+  int n = poll(_pollFds.empty() ? NULL : &_pollFds[0], _pollFds.size(),
+               timeoutMs);
+  if (n <= 0)
+    return n;
+
+  for (size_t i = 0; i < _pollFds.size() && (int)ready.size() < n; ++i) {
+    if (_pollFds[i].revents) {
+      ReadyEvent event;
+      event.fd = _pollFds[i].fd;
+      event.events = _pollFds[i].revents;
+      ready.push_back(event);
+    }
+  }
+  return (int)ready.size();
+}
+
+size_t PollBackend::size() const { return _pollFds.size(); }
+
+const char *PollBackend::name() const { return "poll"; }
@@ -1,81 +1,98 @@
 #include "network/PollManager.hpp"
-#include <algorithm>
+#include "core/Logger.hpp"
 
 /**
  * @file PollManager.cpp
- * @brief Wrapper for poll() system call - manages multiple file descriptors
+ * @brief Readiness multiplexer - one wait() call for every fd in the server
  *
- * This module provides a C++ wrapper around the POSIX poll() system call,
- * allowing the server to monitor multiple file descriptors (sockets, pipes)
- * for I/O readiness in a single call.
+ * This module hides the kernel notification mechanism behind a small API so
+ * the event loop never depends on a specific system call:
+ *
+ * - Linux       → epoll (EpollBackend), or io_uring on request (UringBackend)
+ * - macOS / BSD → kqueue (KqueueBackend)
+ * - fallback    → poll()  (PollBackend)
  *
  * Key functionality:
  * - Add/remove file descriptors to monitor
  * - Update events to watch (POLLIN, POLLOUT)
  * - Wait for events with timeout
- * - Access resulting events after poll returns
+ * - Iterate ONLY the fds that became ready (getReadyFd / getReadyEvents)
+ *
+ * Events are always expressed with POLL* bits (POLLIN, POLLOUT, POLLERR,
+ * POLLHUP) whatever the backend, so callers keep the familiar semantics.
  *
- * @note Uses std::vector<pollfd> for dynamic fd management
- * @see poll(2) man page for POSIX poll() details
+ * @note Still exactly one blocking wait per loop iteration for all I/O
+ * @see EventBackend for the backend contract
  */
 
 /**
- * @brief Default constructor
+ * @brief Constructor - selects and initializes the readiness backend
  *
- * Initializes an empty PollManager with no file descriptors to monitor.
- * The internal _pollFds vector is automatically initialized empty.
+ * @param backendName "poll", "epoll", "kqueue", "io_uring" or "" for the
+ *        platform default (events { use ...; })
  */
-PollManager::PollManager() {}
+PollManager::PollManager(const std::string &backendName)
+    : _backend(EventBackend::create(backendName)) {}
 
 /**
  * @brief Destructor
  *
- * Cleans up the PollManager. No explicit cleanup needed because _pollFds
- * is a std::vector which handles its own memory management (RAII).
+ * Releases the backend (closes the epoll/kqueue descriptor if any).
  *
- * @note Does not close any file descriptors - caller is responsible for that
+ * @note Does not close any monitored fds - caller is responsible for that
  */
-PollManager::~PollManager() {}
+PollManager::~PollManager() { delete _backend; }
 
 /**
  * @brief Adds a file descriptor to monitor
  *
- * Creates a new pollfd structure and adds it to the internal vector.
- * The fd will be monitored for the specified events on next wait() call.
- *
  * @param fd File descriptor to monitor (socket, pipe, etc.)
  * @param events Events to watch for (POLLIN, POLLOUT, or both ORed together)
  *
- * @note revents is initialized to 0 and will be set by poll()
  * @see POLLIN for read readiness, POLLOUT for write readiness
  */
 void PollManager::addFd(int fd, short events) {
-  struct pollfd pollFd;
-  pollFd.fd = fd;
-  pollFd.events = events;
-  pollFd.revents = 0;
-  _pollFds.push_back(pollFd);
+  if (!_backend->add(fd, events)) {
+    LOG_ERROR("Failed to register fd " << fd << " in " << _backend->name());
+  }
+}
+
+/**
+ * @brief Adds a listening socket
+ *
+ * Reported with POLLIN while connections are pending; they are taken with
+ * accept(), which on io_uring hands out the ones the kernel already
+ * accepted (multishot accept).
+ */
+void PollManager::addListener(int fd) {
+  if (!_backend->addListener(fd)) {
+    LOG_ERROR("Failed to register listener " << fd << " in "
+              << _backend->name());
+  }
+}
+
+/**
+ * @brief Takes one connection of a listener
+ *
+ * @param fd Listening socket reported ready
+ * @param addr Receives the client address
+ * @return Non-blocking, close-on-exec client fd; -1 with errno set
+ */
+int PollManager::accept(int fd, sockaddr_in &addr) {
+  return _backend->accept(fd, addr);
 }
 
 /**
  * @brief Removes a file descriptor from monitoring
  *
- * Searches for the specified fd and removes it from the internal vector.
- * If fd is not found, no action is taken.
+ * Must be called BEFORE close(fd) so the fd number cannot be reused while
+ * still registered.
  *
  * @param fd File descriptor to stop monitoring
  *
- * @note Uses linear search O(n) - acceptable for typical server fd counts
+ * @note O(1) on every backend
  */
-void PollManager::removeFd(int fd) {
-  for (std::vector<struct pollfd>::iterator it = _pollFds.begin();
-       it != _pollFds.end(); ++it) {
-    if (it->fd == fd) {
-      _pollFds.erase(it);
-      return;
-    }
-  }
-}
+void PollManager::removeFd(int fd) { _backend->remove(fd); }
 
 /**
  * @brief Updates the events to watch for a file descriptor
@@ -86,99 +103,69 @@ void PollManager::removeFd(int fd) {
  * @param fd File descriptor to update
  * @param events New events to watch for
  *
- * @note No effect if fd is not in the poll set
+ * @note No effect if fd is not registered
  */
 void PollManager::updateEvents(int fd, short events) {
-  for (size_t i = 0; i < _pollFds.size(); ++i) {
-    if (_pollFds[i].fd == fd) {
-      _pollFds[i].events = events;
-      return;
-    }
-  }
-}
-
-/**
- * @brief Updates events by vector index
- *
- * More efficient than updateEvents() when the index is already known.
- * Used during the poll loop iteration.
- *
- * @param index Index in the _pollFds vector
- * @param events New events to watch for
- *
- * @note Bounds-checked - no effect if index is out of range
- */
-void PollManager::updateEventsByIndex(size_t index, short events) {
-  if (index < _pollFds.size()) {
-    _pollFds[index].events = events;
-  }
+  _backend->modify(fd, events);
 }
 
 /**
  * @brief Waits for events on monitored file descriptors
  *
- * Calls poll() to block until one or more fds have events ready,
- * a timeout occurs, or an error happens.
- *
  * @param timeoutMs Timeout in milliseconds (-1 = infinite, 0 = immediate)
  * @return Number of fds with events ready, 0 on timeout, -1 on error
  *
- * @note After this call, use getRevents() to check which events occurred
- * @see poll(2) for complete semantics
+ * @note After this call, iterate getReadyFd()/getReadyEvents()
  */
 int PollManager::wait(int timeoutMs) {
-  return poll(_pollFds.data(), _pollFds.size(), timeoutMs);
+  return _backend->wait(timeoutMs, _ready);
 }
 
 /**
- * @brief Returns the complete pollfd vector
- *
- * Provides read-only access to the internal pollfd array.
- * Used for iterating over all monitored fds.
- *
- * @return Const reference to the vector of pollfd structures
+ * @brief Number of entries in the ready list from the last wait()
  */
-const std::vector<struct pollfd> &PollManager::getPollFds() const {
-  return _pollFds;
-}
+size_t PollManager::getReadyCount() const { return _ready.size(); }
 
 /**
- * @brief Gets the events that occurred for a specific index
+ * @brief Ready fd at position index of the last wait()
  *
- * Returns the revents field set by poll() for the fd at the given index.
- * Check with POLLIN, POLLOUT, POLLERR, POLLHUP masks.
- *
- * @param index Index in the _pollFds vector
- * @return Events that occurred (revents), or 0 if index out of range
+ * @return File descriptor, or -1 if index out of range
  */
-short PollManager::getRevents(size_t index) const {
-  if (index < _pollFds.size())
-    return _pollFds[index].revents;
-  return 0;
+int PollManager::getReadyFd(size_t index) const {
+  if (index < _ready.size())
+    return _ready[index].fd;
+  return -1;
 }
 
 /**
- * @brief Gets the file descriptor at a specific index
+ * @brief Events (POLL* bits) reported for the ready entry at index
  *
- * @param index Index in the _pollFds vector
- * @return File descriptor, or -1 if index out of range
+ * @return Events that occurred, or 0 if index out of range
  */
-int PollManager::getFd(size_t index) const {
-  if (index < _pollFds.size())
-    return _pollFds[index].fd;
-  return -1;
+short PollManager::getReadyEvents(size_t index) const {
+  if (index < _ready.size())
+    return _ready[index].events;
+  return 0;
 }
 
 /**
  * @brief Returns the number of monitored file descriptors
- *
- * @return Current count of fds being monitored
  */
-size_t PollManager::getSize() const { return _pollFds.size(); }
+size_t PollManager::getSize() const { return _backend->size(); }
 
 /**
- * @brief Removes all file descriptors from monitoring
+ * @brief Name of the active backend ("epoll", "kqueue" or "poll")
+ */
+const char *PollManager::getBackendName() const { return _backend->name(); }
+
+/**
+ * @brief Drops the current backend and starts over with an empty one
  *
- * Clears the internal vector. Used during server shutdown.
+ * Used during server shutdown.
  */
-void PollManager::clear() { _pollFds.clear(); }
+void PollManager::clear() {
+  std::string name = _backend->name();
+  delete _backend;
+  _backend = EventBackend::create(name);
+  _ready.clear();
+}
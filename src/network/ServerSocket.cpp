@@ -1,4 +1,10 @@
 #include "network/ServerSocket.hpp"
+#include "core/Logger.hpp"
+#include <cstdlib>
+#include <map>
+#include <sstream>
+
+extern char **environ;
 
 /**
  * @file ServerSocket.cpp
@@ -10,12 +16,29 @@
  * 2. Address reuse configuration (setsockopt SO_REUSEADDR)
  * 3. Non-blocking mode (fcntl O_NONBLOCK)
  * 4. Binding to address/port (bind())
- * 5. Listening for connections (listen())
+ * 5. Listening for connections (listen(), backlog from "listen ... backlog=N")
+ * 6. Optional TCP_DEFER_ACCEPT / TCP_FASTOPEN ("deferred", "fastopen=N")
+ *
+ * SO_SNDBUF / SO_RCVBUF ("sndbuf=N", "rcvbuf=N") are set before listen():
+ * accepted sockets inherit them, and the receive window scale is fixed
+ * from the receive buffer during the handshake.
+ *
+ * Binary upgrade (SIGUSR2): spawnInheriting() fork()s and exec()s a new
+ * copy of the server with the listening fds left open across exec() and
+ * listed in WEBSERV_LISTENERS ("8080:5;8443:6"). The new process adopts
+ * them (adopt()) instead of binding, so the ports stay bound the whole
+ * time: connections queued on them are accepted by whichever process
+ * calls accept() first, and none is refused while the old one drains.
  *
  * @note Uses IPv4 (AF_INET) with TCP (SOCK_STREAM)
  * @see socket(2), bind(2), listen(2) man pages
  */
 
+const char *const ServerSocket::INHERIT_ENV = "WEBSERV_LISTENERS";
+
+/** @brief Inherited listeners not adopted yet: port → fd */
+static std::map<int, int> g_inherited;
+
 /**
  * @brief Constructor with port specification
  *
@@ -23,10 +46,16 @@
  * The actual socket is not created until init() is called.
  *
  * @param port Port number to listen on
+ * @param reusePort Set SO_REUSEPORT so several worker processes can bind
+ *                  their own listener on the same port (kernel balances)
+ * @param options backlog / deferred / fastopen / sndbuf / rcvbuf of the
+ *                listen directive
  *
  * @note _fd is set to -1 (invalid) until init() succeeds
  */
-ServerSocket::ServerSocket(int port) : _fd(-1), _port(port) {}
+ServerSocket::ServerSocket(int port, bool reusePort,
+                           const ListenOptions &options)
+    : _fd(-1), _port(port), _reusePort(reusePort), _options(options) {}
 
 /**
  * @brief Destructor
@@ -50,16 +79,25 @@ ServerSocket::~ServerSocket() { closeSocket(); }
  *   - Allows restarting server without waiting for TIME_WAIT to expire
  *   - Prevents "Address already in use" errors on quick restart
  *
+ * Step 2b: Configure SO_REUSEPORT (worker_processes > 1 only)
+ *   - Every worker binds its own socket on the same port
+ *   - The kernel spreads incoming connections across the workers
+ *
  * Step 3: Set non-blocking mode
  *   - Required for poll()-based I/O multiplexing
  *   - Prevents accept() from blocking when no connections pending
  *
+ * Step 3b: Optional socket buffer sizes (see applyBufferSizes())
+ *
  * Step 4: Bind to address
  *   - INADDR_ANY: Accept connections on any network interface
  *   - sin_port: Network byte order via htons()
  *
  * Step 5: Start listening
- *   - SOMAXCONN: Maximum pending connection queue size
+ *   - backlog=N, or SOMAXCONN: pending connection queue size (the kernel
+ *     caps it at net.core.somaxconn)
+ *
+ * Step 6: Optional TCP options (see applyTcpOptions())
  *
  * @return true if socket initialized successfully, false on error
  *
@@ -70,27 +108,46 @@ bool ServerSocket::init() {
   // Step 1: Create socket (IPv4, TCP)
   _fd = socket(AF_INET, SOCK_STREAM, 0);
   if (_fd < 0) {
-    std::cerr << "❌ Error creating socket on port " << _port << ": "
-              << strerror(errno) << std::endl;
+    LOG_ERROR("Cannot create socket on port " << _port << ": "
+              << strerror(errno));
     return false;
   }
 
   // Step 2: Configure SO_REUSEADDR to allow quick server restart
   int opt = 1;
   if (setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-    std::cerr << "❌ Error configuring SO_REUSEADDR on port " << _port << ": "
-              << strerror(errno) << std::endl;
+    LOG_ERROR("Cannot set SO_REUSEADDR on port " << _port << ": "
+              << strerror(errno));
     closeSocket();
     return false;
   }
 
+  // Step 2b: SO_REUSEPORT for multi-worker mode (one listener per worker)
+  if (_reusePort) {
+#ifdef SO_REUSEPORT
+    if (setsockopt(_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+      LOG_ERROR("Cannot set SO_REUSEPORT on port " << _port << ": "
+                << strerror(errno));
+      closeSocket();
+      return false;
+    }
+#else
+    LOG_WARN("SO_REUSEPORT not supported, port " << _port
+             << " cannot be shared between workers");
+#endif
+  }
+
   // Step 3: Set non-blocking mode for poll() compatibility
   if (setNonBlocking(_fd) < 0) {
-    std::cerr << "❌ Error setting non-blocking mode on port " << _port << ": "
-              << strerror(errno) << std::endl;
+    LOG_ERROR("Cannot set non-blocking mode on port " << _port << ": "
+              << strerror(errno));
     closeSocket();
     return false;
   }
+  fcntl(_fd, F_SETFD, FD_CLOEXEC); // Not inherited by CGI children
+
+  // Step 3b: sndbuf / rcvbuf, inherited by the accepted sockets
+  applyBufferSizes();
 
   // Step 4: Configure address structure
   struct sockaddr_in addr;
@@ -101,23 +158,119 @@ bool ServerSocket::init() {
 
   // Step 5: Bind socket to address
   if (bind(_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-    std::cerr << "❌ Error binding to port " << _port << ": " << strerror(errno)
-              << std::endl;
+    LOG_ERROR("Cannot bind to port " << _port << ": " << strerror(errno));
     closeSocket();
     return false;
   }
 
   // Step 6: Start listening for connections
-  if (listen(_fd, SOMAXCONN) < 0) {
-    std::cerr << "❌ Error listening on port " << _port << ": "
-              << strerror(errno) << std::endl;
+  int backlog = _options.backlog > 0 ? _options.backlog : SOMAXCONN;
+  if (listen(_fd, backlog) < 0) {
+    LOG_ERROR("Cannot listen on port " << _port << ": " << strerror(errno));
     closeSocket();
     return false;
   }
 
+  // Step 7: deferred / fastopen
+  applyTcpOptions();
+  return true;
+}
+
+/**
+ * @brief Takes over a listening socket inherited from the previous binary
+ *
+ * The socket must be listening and bound to this port. The listen options
+ * of the current configuration are applied again: listen() on a listening
+ * socket only updates its backlog, the queued connections stay.
+ *
+ * @param fd Inherited fd (owned by this object on success)
+ * @return false if fd is not a listener of this port (left open)
+ */
+bool ServerSocket::adopt(int fd) {
+  int listening = 0;
+  socklen_t length = sizeof(listening);
+  struct sockaddr_in addr;
+  socklen_t addrLength = sizeof(addr);
+  if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &length) < 0 ||
+      !listening ||
+      getsockname(fd, (struct sockaddr *)&addr, &addrLength) < 0 ||
+      addr.sin_family != AF_INET || ntohs(addr.sin_port) != _port) {
+    LOG_WARN("Inherited fd " << fd << " is not a listener on port " << _port);
+    return false;
+  }
+  if (setNonBlocking(fd) < 0) {
+    LOG_ERROR("Cannot set non-blocking mode on port " << _port << ": "
+              << strerror(errno));
+    return false;
+  }
+  fcntl(fd, F_SETFD, FD_CLOEXEC); // Cleared for exec() only, not for CGIs
+  _fd = fd;
+  applyBufferSizes();
+  listen(_fd, _options.backlog > 0 ? _options.backlog : SOMAXCONN);
+  applyTcpOptions();
   return true;
 }
 
+/**
+ * @brief Sets SO_SNDBUF / SO_RCVBUF from "sndbuf=N" / "rcvbuf=N"
+ *
+ * Linux doubles the value for its own bookkeeping and caps it at
+ * net.core.wmem_max / rmem_max. A refused size only logs a warning.
+ */
+void ServerSocket::applyBufferSizes() {
+  if (_options.sndBuf > 0) {
+    int size = _options.sndBuf;
+    if (setsockopt(_fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) < 0)
+      LOG_WARN("Cannot set SO_SNDBUF on port " << _port << ": "
+               << strerror(errno));
+  }
+  if (_options.rcvBuf > 0) {
+    int size = _options.rcvBuf;
+    if (setsockopt(_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0)
+      LOG_WARN("Cannot set SO_RCVBUF on port " << _port << ": "
+               << strerror(errno));
+  }
+}
+
+/**
+ * @brief Sets the optional TCP options of the listen directive
+ *
+ * - deferred: TCP_DEFER_ACCEPT, the kernel completes the handshake but
+ *   wakes accept() only once the request bytes have arrived, so an
+ *   accepted connection is readable at once (idle connects cost no fd)
+ * - fastopen=N: TCP_FASTOPEN, clients holding a cookie send the request
+ *   in the SYN; N bounds the pending fast-open requests
+ *
+ * Both are optimizations: when the platform or kernel refuses one, a
+ * warning is logged and the socket is used without it.
+ */
+void ServerSocket::applyTcpOptions() {
+  if (_options.deferred) {
+#ifdef TCP_DEFER_ACCEPT
+    int seconds = 1; // Rounded up by the kernel to one SYN-ACK retransmit
+    if (setsockopt(_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &seconds,
+                   sizeof(seconds)) < 0)
+      LOG_WARN("Cannot set TCP_DEFER_ACCEPT on port " << _port << ": "
+               << strerror(errno));
+#else
+    LOG_WARN("TCP_DEFER_ACCEPT not supported, ignoring deferred on port "
+             << _port);
+#endif
+  }
+  if (_options.fastOpen > 0) {
+#ifdef TCP_FASTOPEN
+    int queue = _options.fastOpen;
+    if (setsockopt(_fd, IPPROTO_TCP, TCP_FASTOPEN, &queue, sizeof(queue)) <
+        0)
+      LOG_WARN("Cannot set TCP_FASTOPEN on port " << _port << ": "
+               << strerror(errno));
+#else
+    LOG_WARN("TCP_FASTOPEN not supported, ignoring fastopen on port "
+             << _port);
+#endif
+  }
+}
+
 /**
  * @brief Sets a file descriptor to non-blocking mode
  *
@@ -162,3 +315,106 @@ void ServerSocket::closeSocket() {
     _fd = -1;
   }
 }
+
+/**
+ * @brief Reads the listeners handed over by the previous binary
+ *
+ * The variable is removed, so it never reaches CGI scripts nor a later
+ * upgrade. Malformed entries are ignored.
+ */
+void ServerSocket::loadInherited() {
+  const char *value = getenv(INHERIT_ENV);
+  if (!value)
+    return;
+  std::string list(value);
+  unsetenv(INHERIT_ENV);
+
+  std::istringstream entries(list);
+  std::string entry;
+  while (std::getline(entries, entry, ';')) {
+    size_t colon = entry.find(':');
+    if (colon == std::string::npos)
+      continue;
+    char *end;
+    long port = std::strtol(entry.c_str(), &end, 10);
+    if (end != entry.c_str() + colon || port <= 0 || port > 65535)
+      continue;
+    long fd = std::strtol(entry.c_str() + colon + 1, &end, 10);
+    if (*end != '\0' || fd < 0 || fcntl(static_cast<int>(fd), F_GETFD) == -1)
+      continue;
+    fcntl(static_cast<int>(fd), F_SETFD, FD_CLOEXEC);
+    g_inherited[static_cast<int>(port)] = static_cast<int>(fd);
+  }
+  if (!g_inherited.empty())
+    LOG_INFO("Inherited " << g_inherited.size()
+             << " listening socket(s) from the previous binary");
+}
+
+int ServerSocket::takeInherited(int port) {
+  std::map<int, int>::iterator it = g_inherited.find(port);
+  if (it == g_inherited.end())
+    return -1;
+  int fd = it->second;
+  g_inherited.erase(it);
+  return fd;
+}
+
+std::vector<std::pair<int, int> > ServerSocket::getInherited() {
+  return std::vector<std::pair<int, int> >(g_inherited.begin(),
+                                           g_inherited.end());
+}
+
+/**
+ * @brief Closes inherited listeners of ports the configuration dropped
+ */
+void ServerSocket::closeInherited() {
+  for (std::map<int, int>::iterator it = g_inherited.begin();
+       it != g_inherited.end(); ++it) {
+    LOG_INFO("Closing inherited listener of port " << it->first
+             << " (not configured)");
+    close(it->second);
+  }
+  g_inherited.clear();
+}
+
+/**
+ * @brief fork() + exec() of a new server inheriting the listeners
+ *
+ * Everything the child needs (argument vector, environment with
+ * WEBSERV_LISTENERS) is built before fork(): between fork() and exec()
+ * the child only clears FD_CLOEXEC on the listeners, so it is safe even
+ * with I/O threads running. The listeners stay open in this process,
+ * which keeps accepting until it is told to drain.
+ */
+pid_t ServerSocket::spawnInheriting(
+    const std::vector<std::string> &argv,
+    const std::vector<std::pair<int, int> > &listeners) {
+  std::ostringstream list;
+  list << INHERIT_ENV << '=';
+  for (size_t i = 0; i < listeners.size(); ++i)
+    list << (i ? ";" : "") << listeners[i].first << ':' << listeners[i].second;
+  std::string variable = list.str();
+
+  std::vector<char *> args;
+  for (size_t i = 0; i < argv.size(); ++i)
+    args.push_back(const_cast<char *>(argv[i].c_str()));
+  args.push_back(NULL);
+  std::vector<char *> env;
+  size_t nameLength = std::strlen(INHERIT_ENV);
+  for (char **it = environ; *it; ++it) {
+    if (std::strncmp(*it, INHERIT_ENV, nameLength) != 0 ||
+        (*it)[nameLength] != '=')
+      env.push_back(*it);
+  }
+  env.push_back(const_cast<char *>(variable.c_str()));
+  env.push_back(NULL);
+
+  pid_t pid = fork();
+  if (pid != 0)
+    return pid;
+  for (size_t i = 0; i < listeners.size(); ++i)
+    fcntl(listeners[i].second, F_SETFD, 0);
+  environ = &env[0];
+  execvp(args[0], &args[0]);
+  _exit(127);
+}
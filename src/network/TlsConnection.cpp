@@ -0,0 +1,207 @@
+#include "network/TlsConnection.hpp"
+#include "network/TlsContext.hpp"
+#include <climits>
+#include <cstring>
+
+#ifdef WEBSERV_HAVE_OPENSSL
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#endif
+
+/**
+ * @file TlsConnection.cpp
+ * @brief Non-blocking TLS I/O of one client connection
+ *
+ * No errno is looked at (per subject requirement): SSL_get_error() tells
+ * "not ready" (AGAIN) from a closed or broken connection.
+ *
+ * Writes gather small buffers (header block, short body) into one record
+ * instead of one record each. A write that would block is retried from
+ * the same byte with at least as many bytes, which is what OpenSSL needs
+ * to finish a record it already started (SSL_MODE_ACCEPT_MOVING_WRITE_
+ * BUFFER lets the bytes live at another address).
+ */
+
+/** @brief Largest TLS record payload */
+static const size_t RECORD_SIZE = 16384;
+
+TlsConnection::TlsConnection(const TlsContext &context, int fd)
+    : _ssl(context.open(fd)), _established(false), _wantWrite(false),
+      _failed(false) {}
+
+TlsConnection::~TlsConnection() {
+#ifdef WEBSERV_HAVE_OPENSSL
+  if (!_ssl)
+    return;
+  if (_established && !_failed)
+    SSL_shutdown(_ssl); // close_notify; the reply is not waited for
+  SSL_free(_ssl);
+  ERR_clear_error();
+#endif
+}
+
+bool TlsConnection::isValid() const { return _ssl != NULL; }
+
+bool TlsConnection::isEstablished() const { return _established; }
+
+bool TlsConnection::wantsWrite() const { return !_established && _wantWrite; }
+
+int TlsConnection::handshake() {
+#ifdef WEBSERV_HAVE_OPENSSL
+  int ret = SSL_do_handshake(_ssl);
+  if (ret == 1) {
+    _established = true;
+    _wantWrite = false;
+    return 1;
+  }
+  int error = SSL_get_error(_ssl, ret);
+  ERR_clear_error();
+  if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+    _wantWrite = error == SSL_ERROR_WANT_WRITE;
+    return 0;
+  }
+  _failed = true;
+#endif
+  return -1;
+}
+
+/**
+ * @brief Maps an SSL_read() / SSL_write() return value
+ */
+ssize_t TlsConnection::result(int ret) {
+#ifdef WEBSERV_HAVE_OPENSSL
+  if (ret > 0)
+    return ret;
+  int error = SSL_get_error(_ssl, ret);
+  ERR_clear_error();
+  if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE)
+    return AGAIN;
+  if (error == SSL_ERROR_ZERO_RETURN ||
+      (error == SSL_ERROR_SYSCALL && ret == 0))
+    return 0; // close_notify, or the peer just closed the socket
+  _failed = true;
+#else
+  (void)ret;
+#endif
+  return -1;
+}
+
+ssize_t TlsConnection::read(char *buffer, size_t length) {
+#ifdef WEBSERV_HAVE_OPENSSL
+  if (length > INT_MAX)
+    length = INT_MAX;
+  return result(SSL_read(_ssl, buffer, static_cast<int>(length)));
+#else
+  (void)buffer;
+  (void)length;
+  return -1;
+#endif
+}
+
+ssize_t TlsConnection::readv(const struct iovec *iov, int count) {
+  ssize_t total = 0;
+  for (int i = 0; i < count; ++i) {
+    size_t filled = 0;
+    while (filled < iov[i].iov_len) {
+      ssize_t got = read(static_cast<char *>(iov[i].iov_base) + filled,
+                         iov[i].iov_len - filled);
+      if (got <= 0)
+        return total > 0 ? total : got;
+      filled += static_cast<size_t>(got);
+      total += got;
+    }
+  }
+  return total;
+}
+
+ssize_t TlsConnection::write(const char *data, size_t length) {
+#ifdef WEBSERV_HAVE_OPENSSL
+  if (length > INT_MAX)
+    length = INT_MAX;
+  return result(SSL_write(_ssl, data, static_cast<int>(length)));
+#else
+  (void)data;
+  (void)length;
+  return -1;
+#endif
+}
+
+/**
+ * @brief Writes the buffers in order, small ones gathered into records
+ *
+ * A buffer of a full record or more is written from where it lives; the
+ * others are copied together into a record-sized window first.
+ *
+ * @return Bytes written (> 0), or what the first write returned
+ */
+ssize_t TlsConnection::writev(const struct iovec *iov, int count) {
+  char record[RECORD_SIZE];
+  ssize_t total = 0;
+  int index = 0;
+  size_t offset = 0; // Into iov[index]
+  while (index < count) {
+    const char *data;
+    size_t length;
+    if (offset == 0 && iov[index].iov_len >= RECORD_SIZE) {
+      data = static_cast<const char *>(iov[index].iov_base);
+      length = iov[index].iov_len;
+      ++index;
+    } else {
+      length = 0;
+      while (index < count && length < RECORD_SIZE) {
+        size_t take = iov[index].iov_len - offset;
+        if (take > RECORD_SIZE - length)
+          take = RECORD_SIZE - length;
+        std::memcpy(record + length,
+                    static_cast<const char *>(iov[index].iov_base) + offset,
+                    take);
+        length += take;
+        offset += take;
+        if (offset == iov[index].iov_len) {
+          ++index;
+          offset = 0;
+        }
+      }
+      data = record;
+    }
+    ssize_t sent = write(data, length);
+    if (sent <= 0)
+      return total > 0 ? total : sent;
+    total += sent;
+    if (static_cast<size_t>(sent) < length)
+      break;
+  }
+  return total;
+}
+
+bool TlsConnection::hasPending() const {
+#ifdef WEBSERV_HAVE_OPENSSL
+  return SSL_has_pending(_ssl) == 1;
+#else
+  return false;
+#endif
+}
+
+bool TlsConnection::hasKernelSend() const {
+#if defined(WEBSERV_HAVE_OPENSSL) && defined(BIO_get_ktls_send)
+  return _established && BIO_get_ktls_send(SSL_get_wbio(_ssl));
+#else
+  return false;
+#endif
+}
+
+bool TlsConnection::isHttp2() const {
+#ifdef WEBSERV_HAVE_OPENSSL
+  const unsigned char *protocol;
+  unsigned int length;
+  SSL_get0_alpn_selected(_ssl, &protocol, &length);
+  return length == 2 && std::memcmp(protocol, "h2", 2) == 0;
+#else
+  return false;
+#endif
+}
+
+size_t TlsConnection::getServerIndex() const {
+  return TlsContext::getServerIndex(_ssl);
+}
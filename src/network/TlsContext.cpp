@@ -0,0 +1,270 @@
+#include "network/TlsContext.hpp"
+#include "core/Logger.hpp"
+#include "http/VirtualHostTable.hpp"
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef WEBSERV_HAVE_OPENSSL
+#include <openssl/err.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#endif
+
+/**
+ * @file TlsContext.cpp
+ * @brief Certificates and session resumption of the "ssl" ports
+ *
+ * Configuration (server context, nginx syntax):
+ *   listen 443 ssl;
+ *   ssl_certificate     certs/example.pem;
+ *   ssl_certificate_key certs/example.key;
+ *   ssl_session_cache   20480;   (per worker, "off" = none)
+ *   ssl_session_tickets on;
+ *   ssl_session_timeout 5m;
+ *
+ * Resumption skips the certificate and key exchange of a full handshake:
+ * - session tickets: the client keeps the encrypted session; the ticket
+ *   keys are drawn once in the master (initTicketKeys()), so a ticket
+ *   issued by one worker resumes on any other, and across reloads
+ * - session cache: the server keeps the session under an id; each worker
+ *   has its own, so it only helps a client that lands on the same worker
+ *
+ * SSL_OP_ENABLE_KTLS lets OpenSSL hand the record encryption to the
+ * kernel when it can (Linux "tls" module, supported cipher): the
+ * connection then writes plaintext with writev() / sendfile() and the
+ * kernel encrypts it (see TlsConnection::hasKernelSend()).
+ *
+ * OpenSSL is optional: the Makefile defines WEBSERV_HAVE_OPENSSL when it
+ * is installed; without it a configuration using "ssl" is refused.
+ */
+
+#ifdef WEBSERV_HAVE_OPENSSL
+/** @brief Session ticket keys: name (16), HMAC secret (32), AES key (32) */
+static unsigned char g_ticketKeys[80];
+static bool g_ticketKeysReady = false;
+
+/** @brief SSL ex_data slot holding the SNI-selected server index + 1 */
+static int g_serverSlot = -1;
+
+/**
+ * @brief Last OpenSSL error as text (and clears the queue)
+ */
+static std::string takeError() {
+  unsigned long code = ERR_get_error();
+  ERR_clear_error();
+  if (code == 0)
+    return "unknown error";
+  char text[256];
+  ERR_error_string_n(code, text, sizeof(text));
+  return text;
+}
+#endif
+
+TlsContext::TlsContext() : _hosts(NULL), _defaultServer(0), _http2(false) {}
+
+TlsContext::~TlsContext() {
+#ifdef WEBSERV_HAVE_OPENSSL
+  for (size_t i = 0; i < _contexts.size(); ++i)
+    SSL_CTX_free(_contexts[i]);
+#endif
+}
+
+bool TlsContext::isAvailable() {
+#ifdef WEBSERV_HAVE_OPENSSL
+  return true;
+#else
+  return false;
+#endif
+}
+
+void TlsContext::initTicketKeys() {
+#ifdef WEBSERV_HAVE_OPENSSL
+  if (g_ticketKeysReady)
+    return;
+  g_ticketKeysReady = RAND_bytes(g_ticketKeys, sizeof(g_ticketKeys)) == 1;
+#endif
+}
+
+/**
+ * @brief Creates one SSL_CTX per server block of the port
+ *
+ * TLS 1.2 minimum, no renegotiation, a peer closing without close_notify
+ * seen as a plain close, partial writes (the connection retries from
+ * where a write stopped) and buffers released while idle.
+ * Every context of the port shares the session id context and the ticket
+ * keys, so a session resumes whichever certificate SNI picked.
+ *
+ * @param port Listening port (session id context)
+ * @param servers Blocks of the port, in configuration order
+ * @param hosts The port's server_name table (outlives this object)
+ * @param http2 Whether ALPN may select "h2"
+ */
+void TlsContext::build(int port, const std::vector<ServerConfig> &servers,
+                       const VirtualHostTable &hosts, bool http2) {
+  _hosts = &hosts;
+  _defaultServer = hosts.getDefaultServer();
+  _http2 = http2;
+#ifdef WEBSERV_HAVE_OPENSSL
+  initTicketKeys();
+  if (g_serverSlot < 0)
+    g_serverSlot = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+  std::ostringstream context;
+  context << "webserv:" << port;
+  std::string sessionContext = context.str();
+
+  for (size_t i = 0; i < servers.size(); ++i) {
+    const SslSettings &settings = servers[i].getSsl();
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+    if (!ctx)
+      throw std::runtime_error("SSL_CTX_new: " + takeError());
+    _contexts.push_back(ctx);
+
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    long options = SSL_OP_NO_RENEGOTIATION | SSL_OP_CIPHER_SERVER_PREFERENCE;
+#ifdef SSL_OP_ENABLE_KTLS
+    options |= SSL_OP_ENABLE_KTLS;
+#endif
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    options |= SSL_OP_IGNORE_UNEXPECTED_EOF; // Closing without close_notify
+#endif
+    if (!settings.sessionTickets)
+      options |= SSL_OP_NO_TICKET;
+    SSL_CTX_set_options(ctx, options);
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE |
+                              SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER |
+                              SSL_MODE_RELEASE_BUFFERS);
+
+    if (SSL_CTX_use_certificate_chain_file(ctx,
+                                           settings.certificate.c_str()) !=
+        1)
+      throw std::runtime_error(settings.certificate + ": " + takeError());
+    if (SSL_CTX_use_PrivateKey_file(ctx, settings.certificateKey.c_str(),
+                                    SSL_FILETYPE_PEM) != 1)
+      throw std::runtime_error(settings.certificateKey + ": " + takeError());
+    if (SSL_CTX_check_private_key(ctx) != 1)
+      throw std::runtime_error(settings.certificateKey +
+                               ": does not match " + settings.certificate);
+
+    SSL_CTX_set_session_id_context(
+        ctx, reinterpret_cast<const unsigned char *>(sessionContext.data()),
+        static_cast<unsigned int>(sessionContext.size()));
+    if (settings.sessionCache > 0) {
+      SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+      SSL_CTX_sess_set_cache_size(ctx, settings.sessionCache);
+    } else {
+      SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    }
+    SSL_CTX_set_timeout(ctx, settings.sessionTimeout);
+    if (settings.sessionTickets && g_ticketKeysReady)
+      SSL_CTX_set_tlsext_ticket_keys(ctx, g_ticketKeys, sizeof(g_ticketKeys));
+
+    SSL_CTX_set_tlsext_servername_callback(ctx, onServerName);
+    SSL_CTX_set_tlsext_servername_arg(ctx, this);
+    SSL_CTX_set_alpn_select_cb(ctx, onAlpn, this);
+  }
+#else
+  (void)port;
+  (void)servers;
+#endif
+}
+
+/**
+ * @brief Starts the server side of a handshake on an accepted socket
+ *
+ * @param fd Accepted, non-blocking socket
+ * @return SSL object to drive with SSL_do_handshake(), NULL on failure
+ */
+ssl_st *TlsContext::open(int fd) const {
+#ifdef WEBSERV_HAVE_OPENSSL
+  if (_contexts.empty())
+    return NULL;
+  SSL *ssl = SSL_new(_contexts[_defaultServer < _contexts.size()
+                                   ? _defaultServer
+                                   : 0]);
+  if (!ssl)
+    return NULL;
+  if (SSL_set_fd(ssl, fd) != 1) {
+    SSL_free(ssl);
+    return NULL;
+  }
+  SSL_set_accept_state(ssl);
+  return ssl;
+#else
+  (void)fd;
+  return NULL;
+#endif
+}
+
+/**
+ * @brief Server block the SNI name matched (the default one without SNI)
+ */
+size_t TlsContext::getServerIndex(const ssl_st *ssl) {
+#ifdef WEBSERV_HAVE_OPENSSL
+  size_t slot = reinterpret_cast<size_t>(SSL_get_ex_data(ssl, g_serverSlot));
+  if (slot != 0)
+    return slot - 1;
+#else
+  (void)ssl;
+#endif
+  return static_cast<size_t>(-1);
+}
+
+/**
+ * @brief SNI: routes the handshake to the block serving that name
+ *
+ * Same lookup as the Host header (exact names, then wildcards, else the
+ * default server). Only the certificate changes: the session settings of
+ * every block of the port are the port's.
+ */
+int TlsContext::onServerName(ssl_st *ssl, int *alert, void *arg) {
+  (void)alert;
+#ifdef WEBSERV_HAVE_OPENSSL
+  const TlsContext *self = static_cast<const TlsContext *>(arg);
+  const char *name = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+  if (!name)
+    return SSL_TLSEXT_ERR_NOACK;
+  size_t index = self->_hosts->lookup(name, std::strlen(name));
+  if (index >= self->_contexts.size())
+    return SSL_TLSEXT_ERR_NOACK;
+  SSL_set_ex_data(ssl, g_serverSlot, reinterpret_cast<void *>(index + 1));
+  if (SSL_get_SSL_CTX(ssl) != self->_contexts[index])
+    SSL_set_SSL_CTX(ssl, self->_contexts[index]);
+  return SSL_TLSEXT_ERR_OK;
+#else
+  (void)ssl;
+  (void)arg;
+  return 0;
+#endif
+}
+
+/**
+ * @brief ALPN: "h2" on http2 ports when the client offers it, else
+ *        "http/1.1"
+ */
+int TlsContext::onAlpn(ssl_st *ssl, const unsigned char **out,
+                       unsigned char *outLength, const unsigned char *in,
+                       unsigned int inLength, void *arg) {
+  (void)ssl;
+#ifdef WEBSERV_HAVE_OPENSSL
+  static const unsigned char BOTH[] = "\x02h2\x08http/1.1";
+  static const unsigned char HTTP1[] = "\x08http/1.1";
+  const TlsContext *self = static_cast<const TlsContext *>(arg);
+  const unsigned char *ours = self->_http2 ? BOTH : HTTP1;
+  unsigned int oursLength = static_cast<unsigned int>(
+      self->_http2 ? sizeof(BOTH) - 1 : sizeof(HTTP1) - 1);
+  unsigned char *selected;
+  if (SSL_select_next_proto(&selected, outLength, ours, oursLength, in,
+                            inLength) != OPENSSL_NPN_NEGOTIATED)
+    return SSL_TLSEXT_ERR_NOACK;
+  *out = selected;
+  return SSL_TLSEXT_ERR_OK;
+#else
+  (void)out;
+  (void)outLength;
+  (void)in;
+  (void)inLength;
+  (void)arg;
+  return 0;
+#endif
+}
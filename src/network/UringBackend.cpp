@@ -0,0 +1,433 @@
+#include "network/UringBackend.hpp"
+#include "core/Logger.hpp"
+
+#ifdef WEBSERV_HAVE_URING
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * @file UringBackend.cpp
+ * @brief io_uring(7) readiness backend for Linux (events { use io_uring; })
+ *
+ * The ring itself (setup, mmap, raw system calls) is UringRing; this is
+ * what the event loop asks of it: a submission ring of poll and accept
+ * requests, a completion ring of results.
+ *
+ * Level-triggered semantics, like epoll: polls are one-shot and re-armed
+ * at the next wait() with the fd's current mask. A one-shot poll checks
+ * readiness when it is armed, so an fd the handler did not drain
+ * completes again at once, and ClientConnection keeps doing one
+ * read/write per notification. (Multishot polls report wakeups, not
+ * states: data left unread would never be reported again.)
+ *
+ * What epoll needs one epoll_ctl() for - registering a client, toggling
+ * POLLOUT, removing a closed fd - is an SQE here, and every SQE queued
+ * during a round goes to the kernel with the io_uring_enter() that waits
+ * for the next one. Under load a round costs a single system call.
+ *
+ * Listeners get one multishot IORING_OP_ACCEPT (Linux 5.19) instead of a
+ * poll: the kernel accepts every incoming connection and posts its fd,
+ * so no accept4() runs on the loop. Accepted fds wait in the listener's
+ * queue; the listener is reported POLLIN while it is not empty and
+ * accept() hands them out (the peer address comes from getpeername(): a
+ * multishot accept has no per-connection address buffer). Past
+ * ACCEPT_QUEUE_MAX waiting, the accept is cancelled until the server
+ * caught up, so a connection storm stays in the kernel backlog instead
+ * of piling up as fds. A kernel without multishot accept fails the first
+ * one with EINVAL: listeners then go back to a poll + accept4().
+ *
+ * Every request carries (generation << 32 | fd) as user_data, with
+ * ACCEPT_BIT set for accepts. Changing or removing a registration
+ * cancels the request in flight and bumps the generation, so completions
+ * of an older request - even on a reused fd number - are recognized and
+ * dropped (a connection accepted for a removed listener is closed).
+ *
+ * Needs Linux 5.11 (IORING_FEAT_EXT_ARG: wait with a timeout without a
+ * timeout SQE); EventBackend::create() falls back to epoll otherwise, or
+ * when io_uring is disabled (kernel.io_uring_disabled, seccomp).
+ */
+
+/** @brief Submission ring entries (completion ring: four times more) */
+static const unsigned RING_ENTRIES = 4096;
+
+/** @brief user_data of cancel requests, whose results are ignored */
+static const uint64_t CANCEL_TAG = ~static_cast<uint64_t>(0);
+
+/** @brief Set in the fd half of the user_data of accept requests */
+static const uint32_t ACCEPT_BIT = 0x80000000u;
+
+/** @brief Accepted connections a listener holds before pausing its accept */
+static const size_t ACCEPT_QUEUE_MAX = 256;
+
+static uint64_t tagOf(uint32_t generation, int fd, bool accept) {
+  return (static_cast<uint64_t>(generation) << 32) |
+         static_cast<uint32_t>(fd) | (accept ? ACCEPT_BIT : 0);
+}
+
+UringBackend::UringBackend()
+    : _count(0),
+#ifdef IORING_ACCEPT_MULTISHOT
+      _multishotAccept(true) {
+}
+#else
+      _multishotAccept(false) { // Headers older than Linux 5.19
+}
+#endif
+
+/**
+ * @brief Closes the connections accepted and never taken (the ring
+ *        closes itself)
+ */
+UringBackend::~UringBackend() {
+  for (size_t i = 0; i < _fds.size(); ++i)
+    dropAccepted(_fds[i]);
+}
+
+/**
+ * @brief Creates the ring
+ *
+ * The ring is only used by the event loop thread: where the kernel
+ * supports it, completions are processed only inside io_uring_enter()
+ * (DEFER_TASKRUN), not by interrupting the loop.
+ *
+ * @return false if io_uring is unavailable (caller falls back)
+ */
+bool UringBackend::init() {
+  if (!_ring.init(RING_ENTRIES, RING_ENTRIES * 4, true))
+    return false;
+  if (!(_ring.features() & IORING_FEAT_EXT_ARG)) {
+    _ring.close();
+    errno = ENOSYS;
+    return false;
+  }
+  return true;
+}
+
+UringBackend::FdState &UringBackend::state(int fd) {
+  if (static_cast<size_t>(fd) >= _fds.size()) {
+    FdState empty;
+    empty.registered = false;
+    empty.armed = false;
+    empty.listener = false;
+    empty.events = 0;
+    empty.generation = 0;
+    empty.acceptError = 0;
+    _fds.resize(fd + 1, empty);
+  }
+  return _fds[fd];
+}
+
+/**
+ * @brief Queues the request of fd: a one-shot poll for its registered
+ *        events, or the multishot accept of a listener
+ */
+void UringBackend::arm(int fd) {
+  FdState &entry = _fds[fd];
+  struct io_uring_sqe *sqe = _ring.nextSqe();
+  sqe->fd = fd;
+  if (entry.listener) {
+    sqe->opcode = IORING_OP_ACCEPT;
+#ifdef IORING_ACCEPT_MULTISHOT
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+#endif
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+  } else {
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->poll32_events = static_cast<uint16_t>(entry.events);
+  }
+  sqe->user_data = tagOf(entry.generation, fd, entry.listener);
+  _ring.push();
+  entry.armed = true;
+}
+
+/**
+ * @brief Queues the cancellation of the request in flight for fd
+ *
+ * Its completion (-ECANCELED) carries the current generation: bump it
+ * afterwards so that completion is dropped.
+ */
+void UringBackend::cancel(int fd) {
+  FdState &entry = _fds[fd];
+  struct io_uring_sqe *sqe = _ring.nextSqe();
+  sqe->opcode =
+      entry.listener ? IORING_OP_ASYNC_CANCEL : IORING_OP_POLL_REMOVE;
+  sqe->fd = -1;
+  sqe->addr = tagOf(entry.generation, fd, entry.listener);
+  sqe->user_data = CANCEL_TAG;
+  _ring.push();
+  entry.armed = false;
+}
+
+/**
+ * @brief Closes the connections accepted for a listener and not taken
+ */
+void UringBackend::dropAccepted(FdState &entry) {
+  for (size_t i = 0; i < entry.accepted.size(); ++i)
+    close(entry.accepted[i]);
+  entry.accepted.clear();
+}
+
+bool UringBackend::add(int fd, short events) {
+  if (fd < 0)
+    return false;
+  FdState &entry = state(fd);
+  if (entry.registered)
+    return false;
+  entry.registered = true;
+  entry.listener = false;
+  entry.events = events;
+  ++entry.generation;
+  arm(fd);
+  ++_count;
+  return true;
+}
+
+/**
+ * @brief Registers a listener with a multishot accept (a poll once the
+ *        kernel turned multishot accept down)
+ */
+bool UringBackend::addListener(int fd) {
+  if (!_multishotAccept)
+    return add(fd, POLLIN);
+  if (fd < 0)
+    return false;
+  FdState &entry = state(fd);
+  if (entry.registered)
+    return false;
+  entry.registered = true;
+  entry.listener = true;
+  entry.events = POLLIN;
+  entry.acceptError = 0;
+  ++entry.generation;
+  arm(fd);
+  _listeners.push_back(fd);
+  ++_count;
+  return true;
+}
+
+/**
+ * @brief Changes the events of fd: cancel the poll in flight, arm anew
+ *
+ * An fd whose poll already completed this round is simply armed with the
+ * new mask (wait() then leaves it alone). Listeners keep their accept.
+ */
+bool UringBackend::modify(int fd, short events) {
+  if (fd < 0 || static_cast<size_t>(fd) >= _fds.size() ||
+      !_fds[fd].registered)
+    return false;
+  FdState &entry = _fds[fd];
+  if (entry.listener || (entry.events == events && entry.armed))
+    return true;
+  if (entry.armed)
+    cancel(fd);
+  entry.events = events;
+  ++entry.generation;
+  arm(fd);
+  return true;
+}
+
+/**
+ * @brief Removes fd: its request is cancelled with the next submission
+ *
+ * The caller closes fd right after; the kernel keeps the file until the
+ * cancellation is submitted (at the latest by the next wait()). The
+ * connections a listener accepted and nobody took are closed.
+ */
+void UringBackend::remove(int fd) {
+  if (fd < 0 || static_cast<size_t>(fd) >= _fds.size() ||
+      !_fds[fd].registered)
+    return;
+  FdState &entry = _fds[fd];
+  if (entry.armed)
+    cancel(fd);
+  if (entry.listener) {
+    dropAccepted(entry);
+    _listeners.erase(std::find(_listeners.begin(), _listeners.end(), fd));
+  }
+  ++entry.generation;
+  entry.registered = false;
+  entry.listener = false;
+  entry.acceptError = 0;
+  entry.events = 0;
+  if (_count > 0)
+    --_count;
+}
+
+/**
+ * @brief One connection the kernel accepted for listener fd
+ *
+ * An accept error is reported once; the accept() right after it goes to
+ * the socket directly, so the server's spare-fd trick (EMFILE) takes
+ * the pending connection off the backlog.
+ */
+int UringBackend::accept(int fd, sockaddr_in &addr) {
+  if (fd < 0 || static_cast<size_t>(fd) >= _fds.size() ||
+      !_fds[fd].listener)
+    return EventBackend::accept(fd, addr);
+  FdState &entry = _fds[fd];
+  while (!entry.accepted.empty()) {
+    int clientFd = entry.accepted.front();
+    entry.accepted.pop_front();
+    socklen_t length = sizeof(addr);
+    if (getpeername(clientFd, reinterpret_cast<sockaddr *>(&addr),
+                    &length) == 0)
+      return clientFd;
+    close(clientFd); // Reset by the peer while queued
+  }
+  if (entry.acceptError == -1) {
+    entry.acceptError = 0;
+    return EventBackend::accept(fd, addr);
+  }
+  if (entry.acceptError != 0) {
+    errno = entry.acceptError;
+    entry.acceptError = -1; // The next call accepts directly
+    return -1;
+  }
+  errno = EAGAIN;
+  return -1;
+}
+
+/**
+ * @brief Handles a completion of a listener's multishot accept
+ *
+ * Connections from an accept since paused still belong to the listener;
+ * only those of a removed listener are closed.
+ */
+void UringBackend::onAccept(FdState &entry, int fd,
+                            const struct io_uring_cqe &cqe) {
+  uint32_t generation = static_cast<uint32_t>(cqe.user_data >> 32);
+  bool current = entry.registered && entry.listener;
+  if (cqe.res >= 0) {
+    if (current)
+      entry.accepted.push_back(cqe.res);
+    else
+      close(cqe.res);
+  }
+  if (!current || entry.generation != generation || !entry.armed)
+    return; // Completion of an accept since cancelled
+
+  if (cqe.res == -EINVAL && entry.accepted.empty()) {
+    LOG_WARN("io_uring: no multishot accept in this kernel, listeners "
+             "fall back to poll + accept4()");
+    _multishotAccept = false;
+    _listeners.erase(std::find(_listeners.begin(), _listeners.end(), fd));
+    entry.listener = false;
+    ++entry.generation;
+    arm(fd);
+    return;
+  }
+  if (cqe.res < 0 && cqe.res != -ECANCELED)
+    entry.acceptError = -cqe.res;
+  if (!(cqe.flags & IORING_CQE_F_MORE)) {
+    entry.armed = false; // Ended (on an error): wait() arms it again
+  } else if (entry.accepted.size() >= ACCEPT_QUEUE_MAX) {
+    cancel(fd); // The rest waits in the backlog until the server catches up
+    ++entry.generation;
+  }
+}
+
+/**
+ * @brief Re-arms the completed requests, submits everything and waits
+ *
+ * One io_uring_enter(): the SQEs queued since the last call go in, and
+ * it blocks until a completion or the timeout. Completions already
+ * waiting in the ring, or accepted connections not taken yet, make it
+ * return at once.
+ *
+ * @return Number of ready fds, 0 on timeout, -1 on error (errno set)
+ */
+int UringBackend::wait(int timeoutMs, std::vector<ReadyEvent> &ready) {
+  ready.clear();
+  for (size_t i = 0; i < _rearm.size(); ++i) {
+    int fd = _rearm[i];
+    if (_fds[fd].registered && !_fds[fd].armed && !_fds[fd].listener)
+      arm(fd);
+  }
+  _rearm.clear();
+  bool backlog = false;
+  for (size_t i = 0; i < _listeners.size(); ++i) {
+    FdState &entry = _fds[_listeners[i]];
+    if (!entry.armed && entry.accepted.size() < ACCEPT_QUEUE_MAX / 2)
+      arm(_listeners[i]);
+    if (!entry.accepted.empty() || entry.acceptError > 0)
+      backlog = true;
+  }
+
+  struct __kernel_timespec timeout;
+  struct io_uring_getevents_arg arg;
+  std::memset(&arg, 0, sizeof(arg));
+  if (backlog)
+    timeoutMs = 0;
+  if (timeoutMs >= 0) {
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+    arg.ts = reinterpret_cast<uint64_t>(&timeout);
+  }
+  bool completed = _ring.cqHead() != _ring.cqTail();
+  unsigned minComplete = completed || timeoutMs == 0 ? 0 : 1;
+  int result = _ring.enter(_ring.pending(), minComplete,
+                           IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                           &arg, sizeof(arg));
+  int saved = errno;
+
+  unsigned head = _ring.cqHead();
+  unsigned tail = _ring.cqTail();
+  for (; head != tail; ++head) {
+    const struct io_uring_cqe &cqe = _ring.cqe(head);
+    if (cqe.user_data == CANCEL_TAG)
+      continue;
+    uint32_t low = static_cast<uint32_t>(cqe.user_data & 0xffffffffu);
+    int fd = static_cast<int>(low & ~ACCEPT_BIT);
+    if (static_cast<size_t>(fd) >= _fds.size()) {
+      if ((low & ACCEPT_BIT) && cqe.res >= 0)
+        close(cqe.res);
+      continue;
+    }
+    FdState &entry = _fds[fd];
+    if (low & ACCEPT_BIT) {
+      onAccept(entry, fd, cqe);
+      continue;
+    }
+    uint32_t generation = static_cast<uint32_t>(cqe.user_data >> 32);
+    if (!entry.registered || !entry.armed || entry.generation != generation)
+      continue; // Completion of a poll since changed or removed
+    entry.armed = false;
+    ReadyEvent event;
+    event.fd = fd;
+    if (cqe.res < 0) {
+      event.events = POLLERR; // Not re-armed: it would fail again at once
+    } else {
+      event.events = static_cast<short>(
+          cqe.res & (POLLIN | POLLOUT | POLLERR | POLLHUP | POLLNVAL));
+      _rearm.push_back(fd);
+    }
+    ready.push_back(event);
+  }
+  _ring.cqAdvance(head);
+
+  for (size_t i = 0; i < _listeners.size(); ++i) {
+    const FdState &entry = _fds[_listeners[i]];
+    if (!entry.accepted.empty() || entry.acceptError > 0) {
+      ReadyEvent event;
+      event.fd = _listeners[i];
+      event.events = POLLIN;
+      ready.push_back(event);
+    }
+  }
+
+  if (result < 0 && ready.empty() && saved != ETIME) {
+    errno = saved; // EINTR: a signal to handle
+    return -1;
+  }
+  return static_cast<int>(ready.size());
+}
+
+size_t UringBackend::size() const { return _count; }
+
+const char *UringBackend::name() const { return "io_uring"; }
+
+#endif
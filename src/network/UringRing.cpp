@@ -0,0 +1,188 @@
+#include "network/UringRing.hpp"
+
+#ifdef WEBSERV_HAVE_URING
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * @file UringRing.cpp
+ * @brief io_uring(7) set up with the raw system calls (no liburing)
+ *
+ * A submission ring of requests and a completion ring of results, shared
+ * with the kernel through mmap(). Producers write an SQE in place and
+ * publish it by moving the tail; the kernel consumes up to it in
+ * io_uring_enter(). Results are read between the completion head and
+ * tail, then released by storing the head.
+ */
+
+UringRing::UringRing()
+    : _fd(-1), _features(0), _sqRing(NULL), _sqRingSize(0), _cqRing(NULL),
+      _cqRingSize(0), _sqes(NULL), _sqesSize(0), _sqHead(NULL),
+      _sqTail(NULL), _sqMask(0), _sqEntries(0), _cqHead(NULL), _cqTail(NULL),
+      _cqMask(0), _cqes(NULL), _sqLocalTail(0) {}
+
+UringRing::~UringRing() { close(); }
+
+void UringRing::unmap() {
+  if (_sqes)
+    munmap(_sqes, _sqesSize);
+  if (_cqRing && _cqRing != _sqRing)
+    munmap(_cqRing, _cqRingSize);
+  if (_sqRing)
+    munmap(_sqRing, _sqRingSize);
+  _sqes = NULL;
+  _cqRing = NULL;
+  _sqRing = NULL;
+}
+
+void UringRing::close() {
+  unmap();
+  if (_fd != -1)
+    ::close(_fd);
+  _fd = -1;
+}
+
+/**
+ * @brief Creates the ring and maps its submission/completion queues
+ *
+ * Older kernels refuse SINGLE_ISSUER / DEFER_TASKRUN; the ring is then
+ * created without them.
+ */
+bool UringRing::init(unsigned entries, unsigned cqEntries,
+                     bool singleIssuer) {
+  struct io_uring_params params;
+  unsigned extra = 0;
+#if defined(IORING_SETUP_SINGLE_ISSUER) && defined(IORING_SETUP_DEFER_TASKRUN)
+  if (singleIssuer)
+    extra = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+#else
+  (void)singleIssuer;
+#endif
+  for (;;) {
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | extra;
+    params.cq_entries = cqEntries;
+    _fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (_fd != -1 || errno != EINVAL || extra == 0)
+      break;
+    extra = 0;
+  }
+  if (_fd == -1)
+    return false;
+  fcntl(_fd, F_SETFD, FD_CLOEXEC); // Not inherited by CGI children
+  _features = params.features;
+
+  _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  _cqRingSize =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single && _cqRingSize > _sqRingSize)
+    _sqRingSize = _cqRingSize;
+  void *sq = mmap(NULL, _sqRingSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED) {
+    close();
+    return false;
+  }
+  _sqRing = sq;
+  if (single) {
+    _cqRing = _sqRing;
+  } else {
+    void *cq = mmap(NULL, _cqRingSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED) {
+      close();
+      return false;
+    }
+    _cqRing = cq;
+  }
+  _sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  void *sqes = mmap(NULL, _sqesSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    close();
+    return false;
+  }
+  _sqes = static_cast<struct io_uring_sqe *>(sqes);
+
+  char *sqBase = static_cast<char *>(_sqRing);
+  char *cqBase = static_cast<char *>(_cqRing);
+  _sqHead = reinterpret_cast<unsigned *>(sqBase + params.sq_off.head);
+  _sqTail = reinterpret_cast<unsigned *>(sqBase + params.sq_off.tail);
+  _sqMask = *reinterpret_cast<unsigned *>(sqBase + params.sq_off.ring_mask);
+  _sqEntries = params.sq_entries;
+  _cqHead = reinterpret_cast<unsigned *>(cqBase + params.cq_off.head);
+  _cqTail = reinterpret_cast<unsigned *>(cqBase + params.cq_off.tail);
+  _cqMask = *reinterpret_cast<unsigned *>(cqBase + params.cq_off.ring_mask);
+  _cqes = reinterpret_cast<struct io_uring_cqe *>(cqBase + params.cq_off.cqes);
+
+  // SQE i always sits in slot i: the index array is filled once
+  unsigned *array = reinterpret_cast<unsigned *>(sqBase + params.sq_off.array);
+  for (unsigned i = 0; i < _sqEntries; ++i)
+    array[i] = i;
+  _sqLocalTail = *_sqTail;
+  return true;
+}
+
+bool UringRing::isOpen() const { return _fd != -1; }
+
+unsigned UringRing::features() const { return _features; }
+
+int UringRing::enter(unsigned toSubmit, unsigned minComplete, unsigned flags,
+                     const void *arg, size_t argSize) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, _fd, toSubmit,
+                                  minComplete, flags, arg, argSize));
+}
+
+unsigned UringRing::pending() const {
+  return _sqLocalTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Next free submission entry, zeroed
+ *
+ * A full ring (more requests in one round than it holds) is submitted
+ * first, without waiting.
+ */
+struct io_uring_sqe *UringRing::nextSqe() {
+  if (pending() >= _sqEntries)
+    submit();
+  struct io_uring_sqe *sqe = &_sqes[_sqLocalTail & _sqMask];
+  std::memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+void UringRing::push() {
+  __atomic_store_n(_sqTail, ++_sqLocalTail, __ATOMIC_RELEASE);
+}
+
+void UringRing::submit() {
+  if (pending() > 0)
+    enter(pending(), 0, 0, NULL, 0);
+}
+
+bool UringRing::registerEventfd(int fd) {
+  return syscall(__NR_io_uring_register, _fd, IORING_REGISTER_EVENTFD, &fd,
+                 1) == 0;
+}
+
+unsigned UringRing::cqHead() const { return *_cqHead; }
+
+unsigned UringRing::cqTail() const {
+  return __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+}
+
+const struct io_uring_cqe &UringRing::cqe(unsigned index) const {
+  return _cqes[index & _cqMask];
+}
+
+void UringRing::cqAdvance(unsigned head) {
+  __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+}
+
+#endif
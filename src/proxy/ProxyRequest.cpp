@@ -0,0 +1,516 @@
+#include "proxy/ProxyRequest.hpp"
+#include "http/HttpRequest.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <strings.h>
+#include <sys/uio.h>
+
+/**
+ * @file ProxyRequest.cpp
+ * @brief HTTP/1.1 client side of proxy_pass
+ *
+ * Request sent to the backend:
+ *   <method> <target as received> HTTP/1.1
+ *   client headers, minus the hop-by-hop ones (Connection and what it
+ *   names, Keep-Alive, TE, Transfer-Encoding, Upgrade...) and Expect
+ *   X-Real-IP / X-Forwarded-For / X-Forwarded-Proto: the client
+ *   Content-Length of the (already de-chunked) body
+ *   Connection: close only when the group keeps no idle connection
+ *
+ * With "proxy_pass http://app/v2/;" in "location /api/", the location
+ * prefix of the target is replaced: /api/users?id=1 → /v2/users?id=1.
+ *
+ * Response, rewritten as CGI output for the connection's relay:
+ *   HTTP/1.1 200 OK          →  Status: 200 OK
+ *   end-to-end headers       →  copied (Server and Date are ours)
+ *   Content-Length body      →  copied, connection reusable afterwards
+ *   chunked body             →  decoded (the client gets it re-chunked)
+ *   body until EOF           →  copied, connection not reusable
+ * 1xx interim responses are dropped; HEAD, 204 and 304 have no body.
+ */
+
+/** @brief Longest chunk-size or trailer line accepted */
+static const size_t CHUNK_LINE_MAX = 4096;
+
+/**
+ * @brief Case-insensitive comparison of a field name with a literal
+ */
+static bool nameIs(const char *name, size_t length, const char *literal) {
+  return std::strlen(literal) == length &&
+         strncasecmp(name, literal, length) == 0;
+}
+
+/**
+ * @brief Whether a comma-separated list (Connection) holds a token
+ */
+static bool listHas(const char *list, size_t listLength, const char *token,
+                    size_t tokenLength) {
+  size_t pos = 0;
+  while (list && pos < listLength) {
+    while (pos < listLength && (list[pos] == ' ' || list[pos] == '\t' ||
+                                list[pos] == ','))
+      ++pos;
+    size_t start = pos;
+    while (pos < listLength && list[pos] != ',' && list[pos] != ' ' &&
+           list[pos] != '\t')
+      ++pos;
+    if (pos - start == tokenLength && tokenLength > 0 &&
+        strncasecmp(list + start, token, tokenLength) == 0)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Request fields not forwarded (hop-by-hop, or set by the proxy)
+ */
+static bool isDropped(const char *name, size_t length) {
+  static const char *const DROPPED[] = {
+      "connection",    "keep-alive",        "proxy-connection",
+      "te",            "trailer",           "transfer-encoding",
+      "upgrade",       "expect",            "content-length",
+      "x-real-ip",     "x-forwarded-proto", "x-forwarded-for"};
+  for (size_t i = 0; i < sizeof(DROPPED) / sizeof(DROPPED[0]); ++i) {
+    if (nameIs(name, length, DROPPED[i]))
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Response fields not relayed (hop-by-hop, or set by this server)
+ */
+static bool isHidden(const std::string &name) {
+  static const char *const HIDDEN[] = {
+      "connection", "keep-alive", "proxy-connection", "te",
+      "trailer",    "upgrade",    "status",           "server",
+      "date"};
+  for (size_t i = 0; i < sizeof(HIDDEN) / sizeof(HIDDEN[0]); ++i) {
+    if (nameIs(name.data(), name.size(), HIDDEN[i]))
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Whether value contains token, any case ("Keep-Alive, close")
+ */
+static bool valueHas(const std::string &value, const char *token) {
+  return listHas(value.data(), value.size(), token, std::strlen(token));
+}
+
+ProxyRequest::ProxyRequest()
+    : _headSent(0), _body(NULL), _bodySent(0), _active(false),
+      _headRequest(false), _received(false), _reusable(false), _state(HEAD),
+      _remaining(0) {}
+
+ProxyRequest::~ProxyRequest() {}
+
+/**
+ * @brief Serializes a client request, ready for sendPending()
+ *
+ * @param request Complete client request (body in memory)
+ * @param location Its location (proxy_pass settings and prefix)
+ * @param server Backend the connection goes to (Host if the client sent
+ *        none)
+ * @param clientIp Client address (X-Real-IP, X-Forwarded-For)
+ * @param secure The client connection is TLS (X-Forwarded-Proto)
+ */
+void ProxyRequest::begin(const HttpRequest &request,
+                         const LocationConfig &location,
+                         const std::string &server,
+                         const std::string &clientIp, bool secure) {
+  reset();
+  _active = true;
+  _headRequest = request.getMethod() == "HEAD";
+  const ProxyPass &proxy = location.getProxyPass();
+  const std::string &pattern = location.getPattern();
+
+  size_t targetLength;
+  const char *target = request.getTarget(targetLength);
+  _head.reserve(512 + targetLength);
+  _head += request.getMethod();
+  _head += ' ';
+  if (!proxy.uri.empty() && !pattern.empty() && pattern[0] == '/' &&
+      targetLength >= pattern.size() &&
+      std::memcmp(target, pattern.data(), pattern.size()) == 0) {
+    _head += proxy.uri;
+    _head.append(target + pattern.size(), targetLength - pattern.size());
+  } else {
+    _head.append(target, targetLength);
+  }
+  _head += " HTTP/1.1\r\n";
+
+  size_t connectionLength;
+  const char *connection =
+      request.getHeaderValue("Connection", connectionLength);
+  std::string forwardedFor;
+  bool hasHost = false;
+  for (size_t i = 0; i < request.getHeaderCount(); ++i) {
+    const char *name;
+    const char *value;
+    size_t nameLength;
+    size_t valueLength;
+    request.getHeaderField(i, name, nameLength, value, valueLength);
+    if (nameIs(name, nameLength, "x-forwarded-for")) {
+      forwardedFor.append(value, valueLength);
+      forwardedFor += ", ";
+      continue;
+    }
+    if (isDropped(name, nameLength) ||
+        listHas(connection, connectionLength, name, nameLength))
+      continue;
+    if (nameIs(name, nameLength, "host"))
+      hasHost = true;
+    _head.append(name, nameLength);
+    _head += ": ";
+    _head.append(value, valueLength);
+    _head += "\r\n";
+  }
+  if (!hasHost)
+    _head += "Host: " + server + "\r\n";
+  _head += "X-Real-IP: " + clientIp + "\r\n";
+  _head += "X-Forwarded-For: " + forwardedFor + clientIp + "\r\n";
+  _head += secure ? "X-Forwarded-Proto: https\r\n"
+                  : "X-Forwarded-Proto: http\r\n";
+
+  const std::string &body = request.getBody();
+  if (!body.empty() || request.getContentLength() >= 0 ||
+      request.isChunked()) {
+    std::ostringstream length;
+    length << "Content-Length: " << body.size() << "\r\n";
+    _head += length.str();
+  }
+  if (proxy.keepalive == 0)
+    _head += "Connection: close\r\n";
+  _head += "\r\n";
+  _body = body.empty() ? NULL : &body;
+}
+
+void ProxyRequest::reset() {
+  std::string().swap(_head);
+  _headSent = 0;
+  _body = NULL;
+  _bodySent = 0;
+  _active = false;
+  _headRequest = false;
+  _received = false;
+  _reusable = false;
+  _state = HEAD;
+  _input.clear();
+  _remaining = 0;
+}
+
+/**
+ * @brief Starts the request over: nothing sent, nothing received
+ *
+ * For a reused connection that failed before any response byte; the head
+ * and the body are kept as they were serialized.
+ */
+void ProxyRequest::rewind() {
+  _headSent = 0;
+  _bodySent = 0;
+  _received = false;
+  _reusable = false;
+  _state = HEAD;
+  _input.clear();
+  _remaining = 0;
+}
+
+bool ProxyRequest::isActive() const { return _active; }
+
+bool ProxyRequest::hasPendingOutput() const {
+  return _headSent < _head.size() || (_body && _bodySent < _body->size());
+}
+
+bool ProxyRequest::hasResponse() const { return _received; }
+
+bool ProxyRequest::isComplete() const { return _state == DONE; }
+
+bool ProxyRequest::isReusable() const {
+  return _state == DONE && _reusable && !hasPendingOutput();
+}
+
+/**
+ * @brief Sends as much of the head and body as the socket takes
+ *
+ * Both go out in one writev() while they fit; the body is sent from the
+ * client request, not copied.
+ *
+ * @param fd Connection to the backend (non-blocking; may still be
+ *        connecting, which reads as EAGAIN)
+ * @return false if the connection failed
+ */
+bool ProxyRequest::sendPending(int fd) {
+  while (hasPendingOutput()) {
+    struct iovec iov[2];
+    int count = 0;
+    if (_headSent < _head.size()) {
+      iov[count].iov_base = const_cast<char *>(_head.data() + _headSent);
+      iov[count].iov_len = _head.size() - _headSent;
+      ++count;
+    }
+    if (_body && _bodySent < _body->size()) {
+      iov[count].iov_base = const_cast<char *>(_body->data() + _bodySent);
+      iov[count].iov_len = _body->size() - _bodySent;
+      ++count;
+    }
+    ssize_t sent = writev(fd, iov, count);
+    if (sent < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOTCONN)
+        return true; // POLLOUT will tell when there is room
+      return false;
+    }
+    size_t bytes = static_cast<size_t>(sent);
+    size_t head = _head.size() - _headSent;
+    if (head > bytes)
+      head = bytes;
+    _headSent += head;
+    _bodySent += bytes - head;
+  }
+  return true;
+}
+
+/**
+ * @brief Collects the response header block, then parses it
+ *
+ * @return Bytes of data used (the header block may end inside it)
+ */
+size_t ProxyRequest::consumeHead(const char *data, size_t length,
+                                 std::string &out, bool &error) {
+  size_t old = _input.size();
+  _input.append(data, length);
+  size_t end = _input.find("\r\n\r\n", old >= 3 ? old - 3 : 0);
+  if (end == std::string::npos) {
+    error = _input.size() > MAX_HEAD_SIZE;
+    return length;
+  }
+  end += 4;
+  std::string block = _input.substr(0, end);
+  _input.clear();
+  error = !parseHead(block, out);
+  return end - old;
+}
+
+/**
+ * @brief Turns a response header block into a CGI header block
+ *
+ * Decides how the body is delimited and whether the connection can be
+ * reused. An interim (1xx) response leaves the state at HEAD.
+ *
+ * @param block Status line and headers, up to the empty line
+ * @param out Receives "Status: ...", the relayed headers and the empty line
+ * @return false on a malformed block or 101 (upgrades are not relayed)
+ */
+bool ProxyRequest::parseHead(const std::string &block, std::string &out) {
+  size_t lineEnd = block.find("\r\n");
+  if (lineEnd < 12 || block.compare(0, 7, "HTTP/1.") != 0 ||
+      block[8] != ' ')
+    return false;
+  int code = 0;
+  for (size_t i = 9; i < 12; ++i) {
+    if (block[i] < '0' || block[i] > '9')
+      return false;
+    code = code * 10 + (block[i] - '0');
+  }
+  if (code < 100 || code > 599)
+    return false;
+  if (code < 200)
+    return code != 101; // Interim response: the final one follows
+
+  out += "Status: ";
+  out.append(block, 9, lineEnd - 9);
+  out += "\r\n";
+
+  bool close = block[7] == '0'; // HTTP/1.0: close unless keep-alive
+  bool chunked = false;
+  bool hasLength = false;
+  std::string length;
+  size_t pos = lineEnd + 2;
+  while (pos < block.size()) {
+    size_t next = block.find("\r\n", pos);
+    if (next == pos)
+      break; // Empty line
+    size_t colon = block.find(':', pos);
+    if (colon == std::string::npos || colon >= next || colon == pos)
+      return false;
+    std::string name = block.substr(pos, colon - pos);
+    size_t valueStart = block.find_first_not_of(" \t", colon + 1);
+    size_t valueEnd = block.find_last_not_of(" \t", next - 1);
+    std::string value = valueStart < next && valueEnd >= valueStart
+                            ? block.substr(valueStart,
+                                           valueEnd - valueStart + 1)
+                            : "";
+    pos = next + 2;
+
+    if (nameIs(name.data(), name.size(), "content-length")) {
+      if (value.empty() ||
+          value.find_first_not_of("0123456789") != std::string::npos ||
+          (hasLength && value != length))
+        return false;
+      hasLength = true;
+      length = value;
+    } else if (nameIs(name.data(), name.size(), "transfer-encoding")) {
+      chunked = valueHas(value, "chunked");
+    } else if (nameIs(name.data(), name.size(), "connection")) {
+      if (valueHas(value, "close"))
+        close = true;
+      else if (valueHas(value, "keep-alive"))
+        close = false;
+    } else if (!isHidden(name)) {
+      out += name;
+      out += ": ";
+      out += value;
+      out += "\r\n";
+    }
+  }
+
+  bool bodiless = _headRequest || code == 204 || code == 304;
+  if (hasLength && !chunked) {
+    out += "Content-Length: " + length + "\r\n";
+    _remaining = static_cast<size_t>(std::strtoul(length.c_str(), NULL, 10));
+  } else if (bodiless && !_headRequest) {
+    out += "Content-Length: 0\r\n"; // Not chunked by the relay
+  }
+  out += "\r\n";
+  _reusable = !close;
+
+  if (bodiless)
+    _state = DONE;
+  else if (chunked)
+    _state = CHUNK_SIZE;
+  else if (hasLength)
+    _state = _remaining > 0 ? BODY_LENGTH : DONE;
+  else {
+    _state = BODY_EOF;
+    _reusable = false;
+  }
+  return true;
+}
+
+/**
+ * @brief Collects one line of the chunked coding
+ *
+ * @param complete Set once the line's '\n' is in _input
+ * @return Bytes of data used
+ */
+size_t ProxyRequest::consumeLine(const char *data, size_t length,
+                                 bool &complete, bool &error) {
+  const char *newline =
+      static_cast<const char *>(std::memchr(data, '\n', length));
+  size_t used = newline ? static_cast<size_t>(newline - data) + 1 : length;
+  _input.append(data, used);
+  complete = newline != NULL;
+  error = _input.size() > CHUNK_LINE_MAX;
+  return used;
+}
+
+/**
+ * @brief Applies a complete chunk-size, data-CRLF or trailer line
+ *
+ * @return false on a malformed line
+ */
+bool ProxyRequest::parseChunkLine() {
+  std::string line;
+  line.swap(_input);
+  size_t end = line.find_last_not_of("\r\n");
+  line.erase(end == std::string::npos ? 0 : end + 1);
+
+  if (_state == CHUNK_DATA_CRLF) {
+    if (!line.empty())
+      return false;
+    _state = CHUNK_SIZE;
+    return true;
+  }
+  if (_state == CHUNK_TRAILER) {
+    if (line.empty())
+      _state = DONE; // Trailer fields are dropped
+    return true;
+  }
+  size_t size = 0;
+  size_t digits = 0;
+  for (; digits < line.size(); ++digits) {
+    char c = line[digits];
+    int value;
+    if (c >= '0' && c <= '9')
+      value = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      value = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      value = c - 'A' + 10;
+    else
+      break;
+    if (size > (static_cast<size_t>(-1) >> 4))
+      return false; // Overflow
+    size = size * 16 + static_cast<size_t>(value);
+  }
+  if (digits == 0 || (digits < line.size() && line[digits] != ';' &&
+                      line[digits] != ' ' && line[digits] != '\t'))
+    return false;
+  _remaining = size;
+  _state = size > 0 ? CHUNK_DATA : CHUNK_TRAILER;
+  return true;
+}
+
+/**
+ * @brief Decodes the response bytes received so far
+ *
+ * @param data Bytes read from the backend
+ * @param length Their count
+ * @param out Receives CGI-style output (header block, then body bytes)
+ * @return false on a malformed response
+ */
+bool ProxyRequest::receive(const char *data, size_t length,
+                           std::string &out) {
+  _received = true;
+  while (length > 0 && _state != DONE) {
+    size_t used = length;
+    bool error = false;
+    switch (_state) {
+    case HEAD:
+      used = consumeHead(data, length, out, error);
+      break;
+    case BODY_LENGTH:
+    case CHUNK_DATA:
+      if (used > _remaining)
+        used = _remaining;
+      out.append(data, used);
+      _remaining -= used;
+      if (_remaining == 0)
+        _state = _state == BODY_LENGTH ? DONE : CHUNK_DATA_CRLF;
+      break;
+    case BODY_EOF:
+      out.append(data, length);
+      break;
+    default: {
+      bool complete = false;
+      used = consumeLine(data, length, complete, error);
+      if (complete && !error)
+        error = !parseChunkLine();
+      break;
+    }
+    }
+    if (error)
+      return false;
+    data += used;
+    length -= used;
+  }
+  if (length > 0)
+    _reusable = false; // Bytes past the response: the stream is out of step
+  return true;
+}
+
+/**
+ * @brief Handles the backend closing the connection
+ *
+ * @return true if that ended the response (body delimited by EOF), false
+ *         if the response was cut short
+ */
+bool ProxyRequest::receiveEof() {
+  if (_state != BODY_EOF)
+    return _state == DONE;
+  _state = DONE;
+  return true;
+}
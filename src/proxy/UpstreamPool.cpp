@@ -0,0 +1,292 @@
+#include "proxy/UpstreamPool.hpp"
+#include "core/Logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+
+/**
+ * @file UpstreamPool.cpp
+ * @brief Backend choice and reused connections of proxy_pass
+ *
+ * Configuration (http context, nginx syntax):
+ *   upstream app {
+ *       server 10.0.0.1:8080;
+ *       server 10.0.0.2:8080;
+ *       least_conn;
+ *       keepalive 32;
+ *   }
+ *   location /api/ { proxy_pass http://app; }
+ *
+ * Opening a connection per request would add a TCP handshake (and the
+ * backend's accept) to every proxied request. A connection whose
+ * response ended cleanly goes back to its backend's idle list instead:
+ *
+ *   acquire(group) ── pick backend ── idle connection? ── yes → reuse it
+ *                                                      └─ no  → connect()
+ *   finish(fd, reusable) → idle list (at most "keepalive" per backend)
+ *
+ * Balancing:
+ * - round-robin: backends in turn
+ * - least_conn: the backend with the fewest requests in flight (ties go
+ *   round-robin)
+ * A backend that refused a connection or broke an exchange is skipped
+ * for FAIL_TIMEOUT seconds, unless every backend of the group is down.
+ *
+ * Idle connections are not watched by the event loop; one the backend
+ * closed is noticed when it is taken again (recv(MSG_PEEK) sees EOF).
+ * One it closes just after that check fails the request before any
+ * response byte: the connection retries once on a new connection (see
+ * reconnect()) and the backend is not marked down for it.
+ *
+ * Names are resolved with getaddrinfo() by resolveAll() when the
+ * configuration is loaded (and again on reload): a lookup can block for
+ * seconds, which the event loop must not. A backend whose name did not
+ * resolve then fails its requests until the next reload.
+ *
+ * @note One pool per process (owned by Server), not shared with workers
+ */
+
+UpstreamPool::Backend::Backend()
+    : resolved(false), addrLength(0), active(0), downUntil(0) {
+  std::memset(&addr, 0, sizeof(addr));
+}
+
+UpstreamPool::UpstreamPool() : _opened(0), _reused(0) {}
+
+/**
+ * @brief Destructor - closes every idle connection
+ */
+UpstreamPool::~UpstreamPool() {
+  for (std::map<std::string, Backend>::iterator it = _backends.begin();
+       it != _backends.end(); ++it) {
+    for (size_t i = 0; i < it->second.idle.size(); ++i)
+      close(it->second.idle[i]);
+  }
+}
+
+/**
+ * @brief Resolves a backend address
+ *
+ * @param server "host:port" or "[v6]:port"
+ * @param backend Receives the address
+ * @return false if the name does not resolve
+ */
+bool UpstreamPool::resolve(const std::string &server, Backend &backend) {
+  size_t colon = server.rfind(':');
+  if (colon == std::string::npos)
+    return false;
+  std::string host = server.substr(0, colon);
+  std::string port = server.substr(colon + 1);
+  if (host.size() > 2 && host[0] == '[' && host[host.size() - 1] == ']')
+    host = host.substr(1, host.size() - 2);
+
+  addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *result = NULL;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0 ||
+      !result)
+    return false;
+  std::memcpy(&backend.addr, result->ai_addr, result->ai_addrlen);
+  backend.addrLength = result->ai_addrlen;
+  freeaddrinfo(result);
+  return true;
+}
+
+/**
+ * @brief Resolves every backend named by a proxy_pass location
+ *
+ * Addresses already known are looked up again, so a reload picks up DNS
+ * changes.
+ *
+ * @param servers Server blocks of the configuration being loaded
+ */
+void UpstreamPool::resolveAll(const std::vector<ServerConfig> &servers) {
+  for (size_t s = 0; s < servers.size(); ++s) {
+    const std::vector<LocationConfig> &locations = servers[s].getLocations();
+    for (size_t l = 0; l < locations.size(); ++l) {
+      if (!locations[l].hasProxyPass())
+        continue;
+      const std::vector<std::string> &names =
+          locations[l].getProxyPass().servers;
+      for (size_t i = 0; i < names.size(); ++i) {
+        Backend &backend = _backends[names[i]];
+        backend.resolved = resolve(names[i], backend);
+        if (!backend.resolved)
+          LOG_ERROR("proxy_pass: cannot resolve " << names[i]);
+      }
+    }
+  }
+}
+
+/**
+ * @brief Whether an idle connection is still open on the backend side
+ *
+ * Nothing is expected on an idle connection: readable means EOF (or a
+ * stray byte, which would corrupt the next response), so it is dropped.
+ */
+bool UpstreamPool::isAlive(int fd) {
+  char byte;
+  ssize_t received = recv(fd, &byte, 1, MSG_PEEK);
+  return received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+/**
+ * @brief Chooses the next backend to try
+ *
+ * Backends that are up come first; among them round-robin takes the
+ * first in turn, least_conn the one with the fewest active requests.
+ *
+ * @param group Backends of the location
+ * @param tried Backends that already failed for this request
+ * @param now Current time (down periods)
+ * @return Index into group.servers (one not tried yet)
+ */
+size_t UpstreamPool::pick(const ProxyPass &group,
+                          const std::vector<bool> &tried, time_t now) {
+  size_t count = group.servers.size();
+  size_t start = _next[group.name] % count;
+  size_t best = count;
+  bool bestUp = false;
+  size_t bestActive = 0;
+  for (size_t i = 0; i < count; ++i) {
+    size_t index = (start + i) % count;
+    if (tried[index])
+      continue;
+    const Backend &backend = _backends[group.servers[index]];
+    bool up = backend.downUntil <= now;
+    if (best == count || (up && !bestUp) ||
+        (up == bestUp && group.leastConn && backend.active < bestActive)) {
+      best = index;
+      bestUp = up;
+      bestActive = backend.active;
+    }
+    if (up && !group.leastConn)
+      break;
+  }
+  _next[group.name] = best + 1;
+  return best;
+}
+
+/**
+ * @brief Starts a non-blocking connection to a backend
+ *
+ * @return Socket (possibly still connecting), -1 on failure
+ */
+int UpstreamPool::open(const std::string &server, Backend &backend) {
+  if (!backend.resolved) {
+    LOG_ERROR("proxy_pass: " << server << " was not resolved at load");
+    return -1;
+  }
+
+  int fd = socket(backend.addr.ss_family, SOCK_STREAM, 0);
+  if (fd == -1) {
+    LOG_ERROR("proxy_pass: socket() failed: " << strerror(errno));
+    return -1;
+  }
+  fcntl(fd, F_SETFD, FD_CLOEXEC); // Not inherited by CGI children
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1 ||
+      (connect(fd, reinterpret_cast<sockaddr *>(&backend.addr),
+               backend.addrLength) == -1 &&
+       errno != EINPROGRESS)) {
+    LOG_ERROR("proxy_pass: cannot connect to " << server << ": "
+              << strerror(errno));
+    close(fd);
+    return -1;
+  }
+  ++_opened;
+  return fd;
+}
+
+/**
+ * @brief Returns a connection to one backend of a group
+ *
+ * A backend that cannot be connected to at once is marked down and the
+ * next one is tried.
+ *
+ * @param group proxy_pass backends of the location
+ * @param server Receives the chosen backend
+ * @param reused Receives whether the socket is an idle connection
+ * @return Non-blocking socket, -1 if no backend could be reached
+ */
+int UpstreamPool::acquire(const ProxyPass &group, std::string &server,
+                          bool &reused) {
+  time_t now = time(NULL);
+  std::vector<bool> tried(group.servers.size(), false);
+  for (size_t attempt = 0; attempt < group.servers.size(); ++attempt) {
+    size_t index = pick(group, tried, now);
+    tried[index] = true;
+    Backend &backend = _backends[group.servers[index]];
+
+    int fd = -1;
+    while (fd == -1 && !backend.idle.empty()) {
+      fd = backend.idle.back();
+      backend.idle.pop_back();
+      if (isAlive(fd)) {
+        ++_reused;
+      } else {
+        close(fd); // Closed by the backend while idle
+        fd = -1;
+      }
+    }
+    reused = fd != -1;
+    if (fd == -1)
+      fd = open(group.servers[index], backend);
+    if (fd != -1) {
+      ++backend.active;
+      server = group.servers[index];
+      return fd;
+    }
+    backend.downUntil = now + FAIL_TIMEOUT;
+  }
+  return -1;
+}
+
+/**
+ * @brief Opens a new connection to a backend, for the same request
+ *
+ * The failed connection was given back with finish() first: the backend
+ * counts one request in flight again.
+ *
+ * @param server Backend returned by acquire()
+ * @return Non-blocking socket, -1 on failure
+ */
+int UpstreamPool::reconnect(const std::string &server) {
+  Backend &backend = _backends[server];
+  int fd = open(server, backend);
+  if (fd != -1)
+    ++backend.active;
+  return fd;
+}
+
+/**
+ * @brief Ends the request a connection was acquired for
+ *
+ * @param group Group it was acquired from (keepalive limit)
+ * @param server Backend returned by acquire()
+ * @param fd The connection
+ * @param reusable Response complete and the backend keeps the connection
+ */
+void UpstreamPool::finish(const ProxyPass &group, const std::string &server,
+                          int fd, bool reusable) {
+  Backend &backend = _backends[server];
+  if (backend.active > 0)
+    --backend.active;
+  if (reusable && backend.idle.size() < group.keepalive) {
+    backend.idle.push_back(fd);
+    return;
+  }
+  close(fd);
+}
+
+void UpstreamPool::markFailed(const std::string &server) {
+  _backends[server].downUntil = time(NULL) + FAIL_TIMEOUT;
+}
+
+size_t UpstreamPool::getOpened() const { return _opened; }
+
+size_t UpstreamPool::getReused() const { return _reused; }
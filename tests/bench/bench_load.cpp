@@ -0,0 +1,469 @@
+/**
+ * @file bench_load.cpp
+ * @brief HTTP/1.1 load generator: throughput and latency percentiles
+ *
+ * Drives one URL over N keep-alive connections for a fixed time, with up to
+ * P requests in flight per connection (pipelining), from a single poll()
+ * loop so the generator itself stays cheap next to the server:
+ *
+ *   bench_load.out [-H host] [-p port] [-c connections] [-d seconds]
+ *                  [-P depth] [-X method] [-b body_bytes] [-C]
+ *                  [-n scenario] path
+ *
+ *   -C sends the body with Transfer-Encoding: chunked (1 KB chunks)
+ *
+ * Latency runs from the moment a request is queued on its connection to
+ * the last byte of its response. Responses are framed by Content-Length or
+ * chunked coding; "Connection: close" reconnects. One JSON object is
+ * printed per run, so runs of two builds can be compared line by line:
+ *
+ *   {"scenario": "static_small", "connections": 32, "pipeline": 1,
+ *    "seconds": 5.00, "requests": 412345, "errors": 0,
+ *    "req_per_s": 82469.0, "mb_per_s": 96.1,
+ *    "latency_us": {"p50": 312, "p99": 1204, "p999": 2870, "max": 9120},
+ *    "status": {"200": 412345}}
+ *
+ * Build and run: make bench (tests/bench/run_bench.sh starts a server
+ * and runs every scenario)
+ */
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <vector>
+
+static uint64_t nowMicros() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000ULL +
+         static_cast<uint64_t>(tv.tv_usec);
+}
+
+struct Options {
+  std::string host;
+  int port;
+  int connections;
+  double seconds;
+  int depth;
+  std::string method;
+  size_t bodyBytes;
+  bool chunked;
+  std::string scenario;
+  std::string path;
+};
+
+/** @brief Running totals of one run */
+struct Totals {
+  unsigned long requests;
+  unsigned long errors;
+  unsigned long long bytes;
+  std::vector<uint32_t> latencies; // Microseconds, one per response
+  std::map<int, unsigned long> status;
+};
+
+/** @brief One client connection and its in-flight requests */
+struct Connection {
+  int fd;
+  bool connected;
+  std::string out;        // Bytes queued, not written yet
+  size_t outOffset;
+  std::string in;         // Bytes read, not parsed yet
+  std::vector<uint64_t> sent; // Queue times, oldest first
+  size_t sentHead;
+  size_t expected; // Length of the response being read, 0 = not known yet
+};
+
+static std::string buildRequest(const Options &options) {
+  std::string request = options.method + " " + options.path + " HTTP/1.1\r\n";
+  request += "Host: " + options.host + "\r\n";
+  request += "User-Agent: bench_load\r\n";
+  if (options.bodyBytes == 0 && options.method != "POST") {
+    request += "\r\n";
+    return request;
+  }
+  std::string body(options.bodyBytes, 'x');
+  request += "Content-Type: application/octet-stream\r\n";
+  if (!options.chunked) {
+    char length[32];
+    std::snprintf(length, sizeof(length), "%lu",
+                  static_cast<unsigned long>(body.size()));
+    request += std::string("Content-Length: ") + length + "\r\n\r\n" + body;
+    return request;
+  }
+  request += "Transfer-Encoding: chunked\r\n\r\n";
+  for (size_t pos = 0; pos < body.size(); pos += 1024) {
+    size_t size = std::min(static_cast<size_t>(1024), body.size() - pos);
+    char line[32];
+    std::snprintf(line, sizeof(line), "%lx\r\n",
+                  static_cast<unsigned long>(size));
+    request += line;
+    request.append(body, pos, size);
+    request += "\r\n";
+  }
+  request += "0\r\n\r\n";
+  return request;
+}
+
+static bool openConnection(Connection &conn, const sockaddr_in &addr) {
+  conn.fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (conn.fd < 0)
+    return false;
+  fcntl(conn.fd, F_SETFL, O_NONBLOCK);
+  int one = 1;
+  setsockopt(conn.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  conn.connected = false;
+  conn.out.clear();
+  conn.outOffset = 0;
+  conn.in.clear();
+  conn.sent.clear();
+  conn.sentHead = 0;
+  conn.expected = 0;
+  if (connect(conn.fd, reinterpret_cast<const sockaddr *>(&addr),
+              sizeof(addr)) == 0)
+    conn.connected = true;
+  else if (errno != EINPROGRESS) {
+    close(conn.fd);
+    conn.fd = -1;
+    return false;
+  }
+  return true;
+}
+
+/** @brief Drops a broken connection; its in-flight requests are errors */
+static void failConnection(Connection &conn, Totals &totals) {
+  totals.errors += conn.sent.size() - conn.sentHead;
+  close(conn.fd);
+  conn.fd = -1;
+}
+
+/**
+ * @brief Length of the response starting at data[start]
+ *
+ * @param known Set when the length is final before the body is complete
+ *        (Content-Length), so the headers are not parsed again
+ * @return Bytes of the response, 0 if incomplete, -1 if malformed
+ */
+static long responseLength(const std::string &data, size_t start,
+                           int &status, bool &closeAfter, size_t &known) {
+  size_t headerEnd = data.find("\r\n\r\n", start);
+  if (headerEnd == std::string::npos)
+    return 0;
+  if (data.compare(start, 5, "HTTP/") != 0 || data.size() < start + 12)
+    return -1;
+  status = std::atoi(data.c_str() + start + 9);
+  closeAfter = false;
+
+  long contentLength = -1;
+  bool chunked = false;
+  size_t pos = data.find("\r\n", start) + 2;
+  while (pos < headerEnd) {
+    size_t end = data.find("\r\n", pos);
+    std::string line = data.substr(pos, end - pos);
+    pos = end + 2;
+    size_t colon = line.find(':');
+    if (colon == std::string::npos)
+      continue;
+    std::string name = line.substr(0, colon);
+    const char *value = line.c_str() + colon + 1;
+    while (*value == ' ')
+      ++value;
+    if (strcasecmp(name.c_str(), "Content-Length") == 0)
+      contentLength = std::atol(value);
+    else if (strcasecmp(name.c_str(), "Transfer-Encoding") == 0)
+      chunked = strcasestr(value, "chunked") != NULL;
+    else if (strcasecmp(name.c_str(), "Connection") == 0)
+      closeAfter = strcasecmp(value, "close") == 0;
+  }
+  size_t bodyStart = headerEnd + 4;
+  if (status == 204 || status == 304 || (status >= 100 && status < 200))
+    return static_cast<long>(bodyStart - start);
+  if (!chunked) {
+    if (contentLength < 0)
+      return -1; // Read-until-close bodies are not used by these scenarios
+    known = bodyStart - start + static_cast<size_t>(contentLength);
+    if (data.size() < start + known)
+      return 0;
+    return static_cast<long>(known);
+  }
+
+  pos = bodyStart;
+  while (true) {
+    size_t lineEnd = data.find("\r\n", pos);
+    if (lineEnd == std::string::npos)
+      return 0;
+    unsigned long size = std::strtoul(data.c_str() + pos, NULL, 16);
+    pos = lineEnd + 2;
+    if (size == 0) {
+      size_t trailerEnd = data.find("\r\n", pos);
+      while (trailerEnd != std::string::npos && trailerEnd != pos) {
+        pos = trailerEnd + 2; // Skip trailer fields
+        trailerEnd = data.find("\r\n", pos);
+      }
+      if (trailerEnd == std::string::npos)
+        return 0;
+      return static_cast<long>(pos + 2 - start);
+    }
+    if (data.size() < pos + size + 2)
+      return 0;
+    pos += size + 2;
+  }
+}
+
+static void usage() {
+  std::fprintf(stderr,
+               "usage: bench_load.out [-H host] [-p port] [-c connections] "
+               "[-d seconds] [-P depth] [-X method] [-b body_bytes] [-C] "
+               "[-n scenario] path\n");
+}
+
+static bool parseOptions(int argc, char **argv, Options &options) {
+  options.host = "127.0.0.1";
+  options.port = 8080;
+  options.connections = 32;
+  options.seconds = 5;
+  options.depth = 1;
+  options.method = "GET";
+  options.bodyBytes = 0;
+  options.chunked = false;
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; ++i) {
+    std::string flag = argv[i];
+    if (flag == "-C") {
+      options.chunked = true;
+      continue;
+    }
+    if (i + 1 >= argc)
+      return false;
+    const char *value = argv[++i];
+    if (flag == "-H")
+      options.host = value;
+    else if (flag == "-p")
+      options.port = std::atoi(value);
+    else if (flag == "-c")
+      options.connections = std::atoi(value);
+    else if (flag == "-d")
+      options.seconds = std::atof(value);
+    else if (flag == "-P")
+      options.depth = std::atoi(value);
+    else if (flag == "-X")
+      options.method = value;
+    else if (flag == "-b")
+      options.bodyBytes = static_cast<size_t>(std::atol(value));
+    else if (flag == "-n")
+      options.scenario = value;
+    else
+      return false;
+  }
+  if (i + 1 != argc || options.connections < 1 || options.depth < 1 ||
+      options.seconds <= 0)
+    return false;
+  options.path = argv[i];
+  if (options.scenario.empty())
+    options.scenario = options.path;
+  return true;
+}
+
+static uint32_t percentile(std::vector<uint32_t> &values, double fraction) {
+  if (values.empty())
+    return 0;
+  size_t index = static_cast<size_t>(fraction * (values.size() - 1));
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+static void printJson(const Options &options, Totals &totals,
+                      double seconds) {
+  uint32_t p50 = percentile(totals.latencies, 0.50);
+  uint32_t p99 = percentile(totals.latencies, 0.99);
+  uint32_t p999 = percentile(totals.latencies, 0.999);
+  uint32_t max = totals.latencies.empty()
+                     ? 0
+                     : *std::max_element(totals.latencies.begin(),
+                                         totals.latencies.end());
+  std::printf("{\"scenario\": \"%s\", \"connections\": %d, \"pipeline\": %d, "
+              "\"seconds\": %.2f, \"requests\": %lu, \"errors\": %lu, "
+              "\"req_per_s\": %.1f, \"mb_per_s\": %.1f, "
+              "\"latency_us\": {\"p50\": %u, \"p99\": %u, \"p999\": %u, "
+              "\"max\": %u}, \"status\": {",
+              options.scenario.c_str(), options.connections, options.depth,
+              seconds, totals.requests, totals.errors,
+              totals.requests / seconds, totals.bytes / seconds / 1e6, p50,
+              p99, p999, max);
+  for (std::map<int, unsigned long>::const_iterator it = totals.status.begin();
+       it != totals.status.end(); ++it)
+    std::printf("%s\"%d\": %lu", it == totals.status.begin() ? "" : ", ",
+                it->first, it->second);
+  std::printf("}}\n");
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    usage();
+    return 2;
+  }
+
+  sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(options.port));
+  if (inet_pton(AF_INET, options.host.c_str(), &addr.sin_addr) != 1) {
+    struct hostent *entry = gethostbyname(options.host.c_str());
+    if (!entry) {
+      std::fprintf(stderr, "bench_load: unknown host %s\n",
+                   options.host.c_str());
+      return 1;
+    }
+    std::memcpy(&addr.sin_addr, entry->h_addr_list[0], sizeof(addr.sin_addr));
+  }
+
+  std::string request = buildRequest(options);
+  std::vector<Connection> conns(options.connections);
+  for (size_t i = 0; i < conns.size(); ++i)
+    conns[i].fd = -1;
+  Totals totals;
+  totals.requests = 0;
+  totals.errors = 0;
+  totals.bytes = 0;
+  totals.latencies.reserve(1 << 20);
+
+  std::vector<struct pollfd> fds(conns.size());
+  uint64_t start = nowMicros();
+  uint64_t deadline = start + static_cast<uint64_t>(options.seconds * 1e6);
+  char buffer[64 * 1024];
+
+  while (true) {
+    uint64_t now = nowMicros();
+    if (now >= deadline)
+      break;
+
+    // (Re)connect, and top up every connection to the pipeline depth
+    for (size_t i = 0; i < conns.size(); ++i) {
+      Connection &conn = conns[i];
+      if (conn.fd < 0 && !openConnection(conn, addr)) {
+        ++totals.errors;
+        continue;
+      }
+      while (static_cast<int>(conn.sent.size() - conn.sentHead) <
+             options.depth) {
+        conn.out += request;
+        conn.sent.push_back(now);
+      }
+      fds[i].fd = conn.fd;
+      fds[i].events = POLLIN;
+      if (!conn.connected || conn.outOffset < conn.out.size())
+        fds[i].events |= POLLOUT;
+      fds[i].revents = 0;
+    }
+
+    int timeout = static_cast<int>((deadline - now) / 1000) + 1;
+    if (poll(&fds[0], fds.size(), timeout) < 0) {
+      if (errno == EINTR)
+        continue;
+      std::perror("poll");
+      return 1;
+    }
+
+    for (size_t i = 0; i < conns.size(); ++i) {
+      Connection &conn = conns[i];
+      if (conn.fd < 0 || fds[i].revents == 0)
+        continue;
+      if (!conn.connected && (fds[i].revents & (POLLOUT | POLLERR | POLLHUP))) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+        if (error != 0) {
+          failConnection(conn, totals);
+          continue;
+        }
+        conn.connected = true;
+      }
+
+      if ((fds[i].revents & POLLOUT) && conn.outOffset < conn.out.size()) {
+        ssize_t written = send(conn.fd, conn.out.data() + conn.outOffset,
+                               conn.out.size() - conn.outOffset, MSG_NOSIGNAL);
+        if (written < 0 && errno != EAGAIN) {
+          failConnection(conn, totals);
+          continue;
+        }
+        if (written > 0)
+          conn.outOffset += static_cast<size_t>(written);
+        if (conn.outOffset == conn.out.size()) {
+          conn.out.clear();
+          conn.outOffset = 0;
+        }
+      }
+
+      if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+        continue;
+      ssize_t got = recv(conn.fd, buffer, sizeof(buffer), 0);
+      if (got <= 0) {
+        if (got < 0 && errno == EAGAIN)
+          continue;
+        failConnection(conn, totals);
+        continue;
+      }
+      totals.bytes += static_cast<unsigned long long>(got);
+      conn.in.append(buffer, static_cast<size_t>(got));
+
+      // Every complete response in the buffer, oldest request first
+      uint64_t received = nowMicros();
+      size_t consumed = 0;
+      bool closeAfter = false;
+      while (conn.sentHead < conn.sent.size()) {
+        if (conn.expected > conn.in.size() - consumed)
+          break; // Large body still arriving
+        int status = 0;
+        long length = responseLength(conn.in, consumed, status, closeAfter,
+                                     conn.expected);
+        if (length < 0) {
+          failConnection(conn, totals);
+          break;
+        }
+        if (length == 0)
+          break;
+        consumed += static_cast<size_t>(length);
+        conn.expected = 0;
+        totals.latencies.push_back(
+            static_cast<uint32_t>(received - conn.sent[conn.sentHead++]));
+        ++totals.requests;
+        ++totals.status[status];
+        if (closeAfter)
+          break;
+      }
+      if (conn.fd < 0)
+        continue;
+      conn.in.erase(0, consumed);
+      if (conn.sentHead == conn.sent.size()) {
+        conn.sent.clear();
+        conn.sentHead = 0;
+      }
+      if (closeAfter) {
+        failConnection(conn, totals); // Unanswered pipelined requests count
+        continue;
+      }
+    }
+  }
+
+  double seconds = (nowMicros() - start) / 1e6;
+  for (size_t i = 0; i < conns.size(); ++i)
+    if (conns[i].fd >= 0)
+      close(conns[i].fd);
+  printJson(options, totals, seconds);
+  return totals.requests == 0;
+}
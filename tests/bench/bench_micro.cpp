@@ -0,0 +1,144 @@
+/**
+ * @file bench_micro.cpp
+ * @brief Microbenchmarks of the per-request hot spots, as JSON lines
+ *
+ * - parse: HttpRequest::parse() of a browser GET, one object reused with
+ *   reset() like a keep-alive connection
+ * - build_response: HttpResponse::buildResponse() of a 200 with a 1 KB body
+ *   (new string each time), and appendHeaders() into a reused string (what
+ *   the connection sends from)
+ * - match_location: ServerConfig::matchLocation() (what
+ *   RequestHandler::_matchLocation() calls) over 48 locations, for a deep
+ *   static path, a CGI path and a path only "/" matches
+ *
+ * One line per benchmark:
+ *   {"benchmark": "parse", "iterations": 500000, "ns_per_op": 612.4,
+ *    "ops_per_s": 1632919}
+ *
+ * Build and run: make bench (also part of tests/bench/run_bench.sh)
+ */
+
+#include "config/ServerConfig.hpp"
+#include "http/HttpRequest.hpp"
+#include "http/HttpResponse.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <sys/time.h>
+#include <vector>
+
+static const char REQUEST[] =
+    "GET /static/css/site.css?v=3 HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 "
+    "Firefox/128.0\r\n"
+    "Accept: text/css,*/*;q=0.1\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Connection: keep-alive\r\n"
+    "Referer: http://localhost:8080/\r\n"
+    "Cookie: session_id=8f14e45fceea167a5a36dedd4bea2543; theme=dark\r\n"
+    "\r\n";
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void report(const char *name, unsigned long iterations,
+                   double seconds) {
+  std::printf("{\"benchmark\": \"%s\", \"iterations\": %lu, "
+              "\"ns_per_op\": %.1f, \"ops_per_s\": %.0f}\n",
+              name, iterations, seconds * 1e9 / iterations,
+              iterations / seconds);
+}
+
+static size_t benchParse(unsigned long iterations) {
+  std::string raw(REQUEST);
+  HttpRequest request;
+  request.parse(raw.data(), raw.size()); // Warm up buffer capacity
+  size_t sink = 0;
+  double start = now();
+  for (unsigned long i = 0; i < iterations; ++i) {
+    request.reset();
+    request.parse(raw.data(), raw.size());
+    sink += request.getPath().size();
+  }
+  report("parse", iterations, now() - start);
+  return sink;
+}
+
+static size_t benchBuildResponse(unsigned long iterations) {
+  HttpResponse::tickDate(time(NULL));
+  HttpResponse response;
+  response.setStatus(200, "OK");
+  response.setHeader("Content-Type", "text/css");
+  response.setHeader("Last-Modified", "Tue, 13 Oct 2026 08:00:00 GMT");
+  response.setHeader("ETag", "\"65f1a2b3-400\"");
+  response.setHeader("Connection", "keep-alive");
+  response.setBody(std::string(1024, 'x'));
+  size_t sink = 0;
+
+  double start = now();
+  for (unsigned long i = 0; i < iterations; ++i)
+    sink += response.buildResponse().size();
+  report("build_response", iterations, now() - start);
+
+  std::string out;
+  start = now();
+  for (unsigned long i = 0; i < iterations; ++i) {
+    out.clear();
+    response.appendHeaders(out);
+    sink += out.size();
+  }
+  report("append_headers", iterations, now() - start);
+  return sink;
+}
+
+static size_t benchMatchLocation(unsigned long iterations) {
+  static const char *const sections[] = {"static", "api", "docs", "media",
+                                         "assets", "blog"};
+  std::vector<LocationConfig> locations;
+  LocationConfig root;
+  root.setPattern("/");
+  locations.push_back(root);
+  for (size_t s = 0; s < sizeof(sections) / sizeof(sections[0]); ++s) {
+    std::string base = std::string("/") + sections[s];
+    for (int i = 0; i < 8; ++i) {
+      LocationConfig location;
+      char suffix[32];
+      std::snprintf(suffix, sizeof(suffix), i == 0 ? "" : "/v%d", i);
+      location.setPattern(base + suffix);
+      locations.push_back(location);
+    }
+  }
+  LocationConfig cgi;
+  cgi.setPattern("/cgi-bin");
+  locations.push_back(cgi);
+  ServerConfig server;
+  server.setLocations(locations);
+
+  const std::string paths[] = {"/static/v3/css/themes/dark/site.css",
+                               "/cgi-bin/report.py", "/favicon.ico"};
+  size_t sink = 0;
+  double start = now();
+  for (unsigned long i = 0; i < iterations; ++i) {
+    const LocationConfig *match = server.matchLocation(paths[i % 3]);
+    sink += match ? match->getPattern().size() : 0;
+  }
+  report("match_location", iterations, now() - start);
+  return sink;
+}
+
+int main(int argc, char **argv) {
+  unsigned long iterations =
+      argc > 1 ? std::strtoul(argv[1], NULL, 10) : 500000;
+  if (iterations == 0)
+    iterations = 1;
+  size_t sink = benchParse(iterations);
+  sink += benchBuildResponse(iterations);
+  sink += benchMatchLocation(iterations * 4);
+  return sink == 0; // Keep the work observable
+}
@@ -0,0 +1,223 @@
+/**
+ * @file bench_parser.cpp
+ * @brief Microbenchmark: request header parsing, legacy vs slice parser
+ *
+ * Parses the same browser-like GET request repeatedly with:
+ * - legacy: the previous HttpRequest::parseHeaders() logic (substr +
+ *   istringstream + getline + lowercase map<string,string> + cookies),
+ *   copied here verbatim so both can be compared on one build
+ * - current: HttpRequest::parse(), reusing one object like a keep-alive
+ *   connection does (reset() between requests)
+ *
+ * Each run does a Host lookup, as routing does. Prints requests/second and
+ * heap allocations per request (global operator new is counted).
+ *
+ * The current parser is then run on a proxied request (~7 KB of Via,
+ * X-Forwarded-* and cookie headers) once per ByteScanner kernel available
+ * on this CPU, to compare the scalar and vector delimiter scans.
+ *
+ * Build and run: make bench
+ */
+
+#include "http/ByteScanner.hpp"
+#include "http/HttpRequest.hpp"
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <strings.h>
+#include <sys/time.h>
+
+static unsigned long g_allocations = 0;
+
+void *operator new(size_t size) throw(std::bad_alloc) {
+  ++g_allocations;
+  void *ptr = std::malloc(size ? size : 1);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void *ptr) throw() { std::free(ptr); }
+
+static const char REQUEST[] =
+    "GET /tests/files/index.html?lang=en&page=2 HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 "
+    "Firefox/128.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8"
+    "\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Connection: keep-alive\r\n"
+    "Referer: http://localhost:8080/tests/\r\n"
+    "Cookie: session_id=8f14e45fceea167a5a36dedd4bea2543; theme=dark\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "If-None-Match: \"1a2b-3c-4d5e6f\"\r\n"
+    "\r\n";
+
+/**
+ * @brief REQUEST as seen behind a chain of corporate proxies
+ */
+static std::string makeProxiedRequest() {
+  std::string raw(REQUEST, sizeof(REQUEST) - 3); // Without the blank line
+  raw += "Cookie: ";
+  for (int i = 0; i < 24; ++i)
+    raw += "tracking_segment_id=6f1ed002ab5595859014ebf0951522d9; ";
+  raw += "consent=1\r\n";
+  for (int i = 0; i < 36; ++i) {
+    raw += "X-Forwarded-For: 203.0.113.17, 198.51.100.42, 192.0.2.133, "
+           "10.24.8.1, 10.24.9.254\r\n";
+    if (i % 3 == 0)
+      raw += "Via: 1.1 proxy-eu-west-3.corp.example.com (squid/6.6), 1.1 "
+             "gateway.internal\r\n";
+  }
+  raw += "\r\n";
+  return raw;
+}
+
+/** @brief Previous header parser, kept only as the benchmark baseline */
+struct LegacyRequest {
+  std::string method, path, query, version;
+  std::map<std::string, std::string> headers;
+  std::map<std::string, std::string> cookies;
+  int contentLength;
+  bool chunked, keepAlive;
+
+  bool parse(const std::string &raw) {
+    size_t headerEnd = raw.find("\r\n\r\n");
+    if (headerEnd == std::string::npos)
+      return false;
+    std::string headerPart = raw.substr(0, headerEnd);
+    std::istringstream ss(headerPart);
+    std::string line;
+    if (!std::getline(ss, line))
+      return false;
+    std::istringstream firstLine(line);
+    std::string fullTarget;
+    if (!(firstLine >> method >> fullTarget >> version))
+      return false;
+    size_t qpos = fullTarget.find('?');
+    path = fullTarget.substr(0, qpos);
+    query = qpos == std::string::npos ? "" : fullTarget.substr(qpos + 1);
+    keepAlive = (version == "HTTP/1.1");
+    while (std::getline(ss, line)) {
+      if (line == "\r" || line.empty())
+        break;
+      size_t pos = line.find(":");
+      if (pos == std::string::npos)
+        continue;
+      std::string key = line.substr(0, pos);
+      std::string val = line.substr(pos + 1);
+      if (!val.empty() && val[0] == ' ')
+        val.erase(0, 1);
+      if (!val.empty() && val[val.length() - 1] == '\r')
+        val.erase(val.length() - 1);
+      for (size_t i = 0; i < key.length(); ++i) {
+        if (key[i] >= 'A' && key[i] <= 'Z')
+          key[i] = key[i] - 'A' + 'a';
+      }
+      headers[key] = val;
+      if (key == "content-length")
+        contentLength = std::atoi(val.c_str());
+      else if (key == "transfer-encoding" &&
+               val.find("chunked") != std::string::npos)
+        chunked = true;
+      if (key == "connection")
+        keepAlive = strcasecmp(val.c_str(), "close") != 0;
+    }
+    std::map<std::string, std::string>::const_iterator it =
+        headers.find("cookie");
+    if (it != headers.end()) {
+      std::istringstream cs(it->second);
+      std::string item;
+      while (std::getline(cs, item, ';')) {
+        size_t start = item.find_first_not_of(" ");
+        if (start == std::string::npos)
+          continue;
+        item = item.substr(start);
+        size_t eq = item.find('=');
+        if (eq != std::string::npos)
+          cookies[item.substr(0, eq)] = item.substr(eq + 1);
+      }
+    }
+    return true;
+  }
+};
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void report(const char *name, unsigned long iterations, double seconds,
+                   unsigned long allocations) {
+  std::cout << name << ": " << static_cast<unsigned long>(iterations / seconds)
+            << " req/s, "
+            << static_cast<double>(allocations) / iterations
+            << " allocations/request" << std::endl;
+}
+
+int main(int argc, char **argv) {
+  unsigned long iterations = argc > 1 ? std::strtoul(argv[1], NULL, 10) : 200000;
+  std::string raw(REQUEST);
+  size_t sink = 0;
+
+  // Legacy: fresh object per request, as processing did before
+  unsigned long allocBefore = g_allocations;
+  double start = now();
+  for (unsigned long i = 0; i < iterations; ++i) {
+    LegacyRequest legacy;
+    legacy.contentLength = -1;
+    legacy.chunked = false;
+    legacy.parse(raw);
+    sink += legacy.headers.find("host")->second.size();
+  }
+  report("legacy  parse()", iterations, now() - start,
+         g_allocations - allocBefore);
+
+  // Current: one object reused across requests (keep-alive)
+  HttpRequest request;
+  request.parse(raw.data(), raw.size()); // Warm up buffer capacity
+  allocBefore = g_allocations;
+  start = now();
+  for (unsigned long i = 0; i < iterations; ++i) {
+    request.reset();
+    request.parse(raw.data(), raw.size());
+    sink += request.getOneHeader("Host").size();
+  }
+  report("current parse()", iterations, now() - start,
+         g_allocations - allocBefore);
+
+  // Large proxied header block, once per scanning kernel
+  std::string proxied = makeProxiedRequest();
+  std::cout << "proxied request: " << proxied.size() << " header bytes"
+            << std::endl;
+  const char *backends[] = {"scalar", "sse2", "avx2", "neon"};
+  for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); ++b) {
+    if (!ByteScanner::setBackend(backends[b]))
+      continue;
+    std::string label = std::string("proxied ") + backends[b];
+    label.resize(15, ' ');
+    request.reset();
+    request.parse(proxied.data(), proxied.size());
+    allocBefore = g_allocations;
+    start = now();
+    for (unsigned long i = 0; i < iterations / 10; ++i) {
+      request.reset();
+      request.parse(proxied.data(), proxied.size());
+      sink += request.getOneHeader("Host").size();
+    }
+    report(label.c_str(), iterations / 10, now() - start,
+           g_allocations - allocBefore);
+  }
+
+  return sink == 0; // Keep the work observable
+}
@@ -0,0 +1,142 @@
+/**
+ * @file bench_spawn.cpp
+ * @brief Microbenchmark: CGI launch latency, fork() vs CGIExecutor
+ *
+ * Starts /bin/true the way a CGI is started, repeatedly, with:
+ * - legacy: the previous executeAsync() launch (pipe + fork() + dup2 +
+ *   chdir + execve in the child), copied here so both can be compared on
+ *   one build
+ * - current: CGIExecutor::executeAsync() (posix_spawn() where available)
+ *
+ * Measured is the time the event loop is blocked: from the start of the
+ * launch until the parent can go on. The children are reaped outside the
+ * timed part. Each round is run with a small heap and again after
+ * touching a large one (argv[2] MB, 512 by default), as a server with
+ * full file and response caches has: fork() copies the page tables of
+ * all of it, posix_spawn() does not.
+ *
+ * Build and run: make bench_spawn
+ */
+
+#include "cgi/CGIExecutor.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/time.h>
+#include <vector>
+
+static const char EXECUTABLE[] = "/bin/true";
+static const char SCRIPT[] = "/tmp/script.cgi"; // chdir /tmp, argv[1]
+
+static double now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/** @brief Previous launch: fork(), the child sets itself up and execs */
+static pid_t legacyLaunch(char **envp, int &outFd) {
+  int pipeIn[2];
+  int pipeOut[2];
+  if (pipe(pipeIn) == -1 || pipe(pipeOut) == -1)
+    return -1;
+  pid_t pid = fork();
+  if (pid == 0) {
+    dup2(pipeIn[0], STDIN_FILENO);
+    dup2(pipeOut[1], STDOUT_FILENO);
+    close(pipeOut[1]);
+    close(pipeIn[1]);
+    close(pipeIn[0]);
+    close(pipeOut[0]);
+    if (chdir("/tmp") == -1)
+      _exit(1);
+    char *argv[3];
+    argv[0] = const_cast<char *>(EXECUTABLE);
+    argv[1] = const_cast<char *>("script.cgi");
+    argv[2] = NULL;
+    execve(argv[0], argv, envp);
+    _exit(1);
+  }
+  close(pipeIn[0]);
+  close(pipeOut[1]);
+  close(pipeIn[1]); // No body
+  CGIExecutor::setNonBlocking(pipeOut[0]);
+  outFd = pipeOut[0];
+  return pid;
+}
+
+static void reap(std::vector<pid_t> &pids, std::vector<int> &fds) {
+  for (size_t i = 0; i < pids.size(); ++i) {
+    int status;
+    waitpid(pids[i], &status, 0);
+    close(fds[i]);
+  }
+  pids.clear();
+  fds.clear();
+}
+
+static void report(const char *name, unsigned long iterations,
+                   double seconds) {
+  std::cout << name << ": " << seconds * 1e6 / iterations
+            << " us/launch" << std::endl;
+}
+
+static void runRound(const char *heap, unsigned long iterations,
+                     char **envp) {
+  std::vector<pid_t> pids;
+  std::vector<int> fds;
+
+  double elapsed = 0;
+  for (unsigned long i = 0; i < iterations; ++i) {
+    int fd = -1;
+    double start = now();
+    pid_t pid = legacyLaunch(envp, fd);
+    elapsed += now() - start;
+    if (pid > 0) {
+      pids.push_back(pid);
+      fds.push_back(fd);
+    }
+    if (pids.size() >= 32)
+      reap(pids, fds); // Stay well under the fd and process limits
+  }
+  reap(pids, fds);
+  std::cout << heap << " ";
+  report("legacy  fork()       ", iterations, elapsed);
+
+  elapsed = 0;
+  for (unsigned long i = 0; i < iterations; ++i) {
+    CGIExecutor executor;
+    double start = now();
+    CGIAsyncResult result =
+        executor.executeAsync(EXECUTABLE, SCRIPT, envp, false);
+    elapsed += now() - start;
+    if (result.success) {
+      pids.push_back(result.childPid);
+      fds.push_back(result.pipeFd);
+    }
+    if (pids.size() >= 32)
+      reap(pids, fds);
+  }
+  reap(pids, fds);
+  std::cout << heap << " ";
+  report("current executeAsync()", iterations, elapsed);
+}
+
+int main(int argc, char **argv) {
+  unsigned long iterations =
+      argc > 1 ? std::strtoul(argv[1], NULL, 10) : 500;
+  size_t heapMb = argc > 2 ? std::strtoul(argv[2], NULL, 10) : 512;
+  char *envp[] = {const_cast<char *>("GATEWAY_INTERFACE=CGI/1.1"), NULL};
+
+  runRound("small heap:", iterations, envp);
+
+  // Touched, so every page is mapped and fork() has to copy its entries
+  std::vector<char> heap(heapMb * 1024 * 1024);
+  for (size_t i = 0; i < heap.size(); i += 4096)
+    heap[i] = static_cast<char>(i);
+  std::string label = "heap " + std::string(argc > 2 ? argv[2] : "512") +
+                      " MB:";
+  runRound(label.c_str(), iterations, envp);
+  return 0;
+}
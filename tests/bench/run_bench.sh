@@ -0,0 +1,128 @@
+#!/bin/bash
+# Benchmark suite (make bench): microbenchmarks, then load scenarios against
+# a server started on a generated tree. Prints one JSON document.
+#
+# Environment (defaults in brackets):
+#   BENCH_PORT [8095]  BENCH_DURATION [5] seconds per scenario
+#   BENCH_CONNECTIONS [32]  BENCH_ITERATIONS [500000] per microbenchmark
+#   BENCH_CONFIG_COPIES [300] server blocks x3 in the config load test
+#
+# Compare two builds: make bench BENCH_OUT=before.json, change, make bench
+# BENCH_OUT=after.json, then diff the "load" / "micro" entries.
+
+ROOT="$(cd "$(dirname "$0")/../.." && pwd)"
+PORT=${BENCH_PORT:-8095}
+DURATION=${BENCH_DURATION:-5}
+CONNECTIONS=${BENCH_CONNECTIONS:-32}
+ITERATIONS=${BENCH_ITERATIONS:-500000}
+WORK="$(mktemp -d /tmp/webserv_bench.XXXXXX)"
+SERVER_PID=""
+
+cleanup() {
+    [ -n "$SERVER_PID" ] && kill "$SERVER_PID" 2>/dev/null && wait "$SERVER_PID" 2>/dev/null
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+# ---------- Served tree ----------
+mkdir -p "$WORK/www/dir" "$WORK/www/up" "$WORK/www/cgi-bin"
+head -c 1024 /dev/zero | tr '\0' 'a' > "$WORK/www/small.html"
+head -c $((4 * 1024 * 1024)) /dev/zero > "$WORK/www/large.bin"
+for i in $(seq 1 200); do
+    echo "$i" > "$WORK/www/dir/file_$i.txt"
+done
+cat > "$WORK/www/cgi-bin/hello.sh" <<'EOF'
+echo "Content-Type: text/plain"
+echo ""
+echo "hello"
+EOF
+
+cat > "$WORK/bench.conf" <<EOF
+http {
+    error_log $WORK/error.log error;
+    open_file_cache max=1000 inactive=60s;
+    server {
+        listen $PORT;
+        server_name localhost;
+        root $WORK/www;
+        client_max_body_size 10485760;
+        location / {
+            allow_methods GET HEAD;
+            root $WORK/www;
+        }
+        location /dir {
+            allow_methods GET;
+            root $WORK/www;
+            autoindex on;
+        }
+        location /up {
+            allow_methods GET POST;
+            root $WORK/www;
+            upload_path $WORK/www/up;
+        }
+        location /cgi-bin {
+            allow_methods GET POST;
+            root $WORK/www;
+            cgi_ext .sh;
+            cgi_path /bin/sh;
+        }
+    }
+}
+EOF
+
+# ---------- Microbenchmarks ----------
+MICRO=$("$ROOT/bench_micro.out" "$ITERATIONS" | paste -sd, -)
+
+# ---------- Config load ----------
+# mega_test.conf with its server blocks repeated CONFIG_COPIES times
+# (about 100 lines each), timed by "webServer.out -t"
+CONFIG_COPIES=${BENCH_CONFIG_COPIES:-300}
+MEGA="$ROOT/tests/configs/mega_test.conf"
+LAST=$(($(wc -l < "$MEGA") - 1))
+{
+    echo "http {"
+    for _ in $(seq 1 "$CONFIG_COPIES"); do
+        sed -n "2,${LAST}p" "$MEGA"
+    done
+    echo "}"
+} > "$WORK/large.conf"
+CONFIG=$("$ROOT/webServer.out" -t "$WORK/large.conf" | sed -n \
+    's/.*: \([0-9]*\) server(s), parsed in \([0-9.]*\) ms, built in \([0-9.]*\) ms/{"lines": '"$(wc -l < "$WORK/large.conf")"', "servers": \1, "parse_ms": \2, "build_ms": \3}/p')
+
+# ---------- Server ----------
+"$ROOT/webServer.out" "$WORK/bench.conf" > "$WORK/server.log" 2>&1 &
+SERVER_PID=$!
+for _ in $(seq 1 50); do
+    (exec 3<>"/dev/tcp/127.0.0.1/$PORT") 2>/dev/null && break
+    sleep 0.1
+done
+if ! kill -0 "$SERVER_PID" 2>/dev/null; then
+    echo "run_bench.sh: the server did not start:" >&2
+    cat "$WORK/server.log" >&2
+    exit 1
+fi
+
+# name, then bench_load options and path
+run() {
+    local name=$1
+    shift
+    "$ROOT/bench_load.out" -p "$PORT" -d "$DURATION" -n "$name" "$@"
+    rm -f "$WORK"/www/up/*
+}
+
+LOAD=$(
+    {
+        run static_small -c "$CONNECTIONS" /small.html
+        run static_small_pipelined -c "$CONNECTIONS" -P 16 /small.html
+        run static_large -c 8 /large.bin
+        run not_found -c "$CONNECTIONS" /missing.html
+        run autoindex -c "$CONNECTIONS" /dir/
+        run post_upload -c 8 -X POST -b 4096 /up/
+        run chunked_upload -c 8 -X POST -b 16384 -C /up/
+        run cgi -c 8 /cgi-bin/hello.sh
+    } | paste -sd, -
+)
+
+COMMIT=$(git -C "$ROOT" rev-parse --short HEAD 2>/dev/null || echo unknown)
+printf '{"commit": "%s", "date": "%s", "micro": [%s], "config": %s, "load": [%s]}\n' \
+    "$COMMIT" "$(date -u +%Y-%m-%dT%H:%M:%SZ)" "$MICRO" "${CONFIG:-null}" "$LOAD"
@@ -32,10 +32,28 @@ echo
 echo
 "$BASE_DIR"/test_pipelining.sh
 echo
+"$BASE_DIR"/test_conditional.sh
+echo
+"$BASE_DIR"/test_range.sh
+echo
 "$BASE_DIR"/test_bonus.sh
 echo
 "$BASE_DIR"/test_parser_robustness.sh
 echo
+"$BASE_DIR"/test_http2.sh
+echo
+"$BASE_DIR"/test_tls.sh
+echo
+"$BASE_DIR"/test_proxy.sh
+echo
+"$BASE_DIR"/test_cgi_cache.sh
+echo
+"$BASE_DIR"/test_limit_req.sh
+echo
+"$BASE_DIR"/test_limit_rate.sh
+echo
+"$BASE_DIR"/test_drain.sh
+echo
 echo "--- RUNNING LEGACY TESTS ---"
 "$BASE_DIR"/test-autoindex.sh
 echo
@@ -0,0 +1,82 @@
+#!/bin/bash
+
+# Test script for cgi_cache
+# Starts its own server on PORT with a CGI that prints a new value per run.
+
+PORT=8284
+if [ ! -z "$1" ]; then
+    PORT=$1
+fi
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+URL=http://localhost:$PORT/cgi-bin
+
+echo "--- TESTING CGI_CACHE ---"
+if ! command -v python3 > /dev/null; then
+    echo "⚠️  SKIPPED: python3 not found"
+    exit 0
+fi
+
+TMP=$(mktemp -d)
+mkdir "$TMP/cgi-bin"
+cat > "$TMP/cgi-bin/stamp.py" <<'PY'
+import os, time
+print("Content-Type: text/plain")
+if "nostore" in os.environ.get("QUERY_STRING", ""):
+    print("Cache-Control: no-store")
+print("")
+print("run %d" % time.time_ns())
+PY
+cat > "$TMP/cache.conf" <<CONF
+http {
+    server {
+        listen $PORT;
+        server_name localhost;
+        root $TMP;
+        location /cgi-bin {
+            allow_methods GET HEAD;
+            cgi_ext .py;
+            cgi_path /usr/bin/python3;
+            cgi_cache on;
+            cgi_cache_valid 30s;
+        }
+    }
+}
+CONF
+"$ROOT"/webServer.out "$TMP/cache.conf" > /dev/null 2>&1 &
+PID=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    curl -s -o /dev/null http://localhost:$PORT/ && break
+    sleep 0.3
+done
+
+echo "1. First request runs the script..."
+FIRST=$(curl -s $URL/stamp.py)
+echo "$FIRST" | grep -q "^run " && echo "✅ SUCCESS: got '$FIRST'" || echo "❌ FAILURE: got '$FIRST'"
+
+echo "2. Second request is a hit..."
+HEADERS=$(curl -s -D - -o "$TMP/second" $URL/stamp.py | tr -d '\r')
+SECOND=$(cat "$TMP/second")
+[ "$SECOND" = "$FIRST" ] && echo "$HEADERS" | grep -qi "^Age:" \
+    && echo "✅ SUCCESS: same body, Age header present" || echo "❌ FAILURE: got '$SECOND'"
+
+echo "3. HEAD answered from the GET entry..."
+HEADERS=$(curl -s -I $URL/stamp.py | tr -d '\r')
+echo "$HEADERS" | head -n1 | grep -q " 200" && echo "$HEADERS" | grep -qi "^Age:" \
+    && echo "✅ SUCCESS: 200 with an Age header" || echo "❌ FAILURE: got '$(echo "$HEADERS" | head -n1)'"
+
+echo "4. Query string is part of the key..."
+OTHER=$(curl -s "$URL/stamp.py?page=2")
+[ "$OTHER" != "$FIRST" ] && echo "✅ SUCCESS: separate entry" || echo "❌ FAILURE: served the /stamp.py entry"
+
+echo "5. Authorization always goes to the script..."
+AUTH=$(curl -s -H "Authorization: Bearer x" $URL/stamp.py)
+[ "$AUTH" != "$FIRST" ] && echo "✅ SUCCESS: not served from the cache" || echo "❌ FAILURE: served from the cache"
+
+echo "6. Cache-Control: no-store is not kept..."
+A=$(curl -s "$URL/stamp.py?nostore")
+B=$(curl -s "$URL/stamp.py?nostore")
+[ "$A" != "$B" ] && echo "✅ SUCCESS: script ran twice" || echo "❌ FAILURE: second response came from the cache"
+
+kill $PID 2> /dev/null
+wait $PID 2> /dev/null
+rm -rf "$TMP"
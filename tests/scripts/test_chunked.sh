@@ -50,3 +50,17 @@ data = sock.recv(4096).decode()
 sock.close()
 exit(0 if '200 OK' in data else 1)
 " && echo -e "${GREEN}✅ OK${NC}" || echo -e "${RED}❌ FAIL${NC}"
+
+# Test 4: Chunked upload, streamed to the upload directory
+echo -n "4. Chunked upload (201 Created)... "
+python3 -c "
+import socket
+sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+sock.connect(('localhost', 8080))
+req = 'POST /tests/uploads HTTP/1.1\r\nHost: localhost:8080\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n5\r\nHello\r\n6\r\nWorld!\r\n0\r\n\r\n'
+sock.sendall(req.encode())
+sock.settimeout(3.0)
+data = sock.recv(4096).decode()
+sock.close()
+exit(0 if '201 Created' in data and '(11 bytes)' in data else 1)
+" && echo -e "${GREEN}✅ OK${NC}" || echo -e "${RED}❌ FAIL${NC}"
@@ -0,0 +1,31 @@
+#!/bin/bash
+
+# Test script for conditional GET (ETag / Last-Modified / 304)
+
+PORT=8080
+if [ ! -z "$1" ]; then
+    PORT=$1
+fi
+URL=http://localhost:$PORT/index.html
+
+echo "--- TESTING CONDITIONAL GET ---"
+HEADERS=$(curl -s -I $URL | tr -d '\r')
+ETAG=$(echo "$HEADERS" | grep -i "^ETag:" | cut -d' ' -f2)
+LASTMOD=$(echo "$HEADERS" | grep -i "^Last-Modified:" | cut -d' ' -f2-)
+
+if [ -z "$ETAG" ] || [ -z "$LASTMOD" ]; then
+    echo "❌ FAILURE: Missing ETag or Last-Modified header."
+    exit 0
+fi
+
+echo "1. If-None-Match with current ETag..."
+CODE=$(curl -s -o /dev/null -w "%{http_code}" -H "If-None-Match: $ETAG" $URL)
+[ "$CODE" = "304" ] && echo "✅ SUCCESS: 304 Not Modified" || echo "❌ FAILURE: got $CODE (expected 304)"
+
+echo "2. If-Modified-Since with Last-Modified..."
+CODE=$(curl -s -o /dev/null -w "%{http_code}" -H "If-Modified-Since: $LASTMOD" $URL)
+[ "$CODE" = "304" ] && echo "✅ SUCCESS: 304 Not Modified" || echo "❌ FAILURE: got $CODE (expected 304)"
+
+echo "3. Stale ETag (If-Modified-Since must be ignored)..."
+CODE=$(curl -s -o /dev/null -w "%{http_code}" -H 'If-None-Match: "stale"' -H "If-Modified-Since: $LASTMOD" $URL)
+[ "$CODE" = "200" ] && echo "✅ SUCCESS: 200 OK" || echo "❌ FAILURE: got $CODE (expected 200)"
@@ -0,0 +1,120 @@
+#!/bin/bash
+
+# Test script for graceful shutdown (SIGQUIT) and binary upgrade (SIGUSR2)
+# Starts its own server on PORT with a CGI that answers after 2 seconds.
+
+PORT=8286
+if [ ! -z "$1" ]; then
+    PORT=$1
+fi
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+URL=http://localhost:$PORT
+
+echo "--- TESTING DRAIN / SIGUSR2 ---"
+if ! command -v python3 > /dev/null; then
+    echo "⚠️  SKIPPED: python3 not found"
+    exit 0
+fi
+
+TMP=$(mktemp -d)
+mkdir "$TMP/cgi-bin"
+echo "ok" > "$TMP/index.html"
+cat > "$TMP/cgi-bin/slow.py" <<'PY'
+import os, time
+time.sleep(2)
+print("Content-Type: text/plain")
+print("")
+print("done by %d" % os.getppid())
+PY
+cat > "$TMP/drain.conf" <<CONF
+http {
+    server {
+        listen $PORT;
+        server_name localhost;
+        root $TMP;
+        index index.html;
+        location / {
+            allow_methods GET;
+        }
+        location /cgi-bin {
+            allow_methods GET;
+            cgi_ext .py;
+            cgi_path /usr/bin/python3;
+        }
+    }
+}
+CONF
+
+start_server() {
+    "$ROOT"/webServer.out "$TMP/drain.conf" > /dev/null 2>&1 &
+    PID=$!
+    for i in 1 2 3 4 5 6 7 8 9 10; do
+        curl -s -o /dev/null $URL/ && break
+        sleep 0.3
+    done
+}
+
+# Waits up to $2 tenths of a second for process $1 to exit
+wait_exit() {
+    for i in $(seq 1 $2); do
+        kill -0 $1 2> /dev/null || return 0
+        sleep 0.1
+    done
+    return 1
+}
+
+start_server
+
+echo "1. SIGQUIT lets the request in flight finish..."
+curl -s -D "$TMP/headers" -o "$TMP/body" -w "%{http_code}" $URL/cgi-bin/slow.py > "$TMP/code" &
+CURL=$!
+sleep 0.5
+kill -QUIT $PID
+wait $CURL
+CODE=$(cat "$TMP/code")
+[ "$CODE" = "200" ] && grep -q "^done" "$TMP/body" && echo "✅ SUCCESS: 200 after the signal" || echo "❌ FAILURE: got '$CODE'"
+
+echo "2. ... with Connection: close..."
+grep -qi "^Connection: close" "$TMP/headers" && echo "✅ SUCCESS: Connection: close" || echo "❌ FAILURE: no Connection: close"
+
+echo "3. ... and the process exits once it is done..."
+wait_exit $PID 30 && echo "✅ SUCCESS: exited" || echo "❌ FAILURE: still running"
+kill -9 $PID 2> /dev/null
+wait $PID 2> /dev/null
+
+start_server
+
+echo "4. SIGUSR2 starts a new process on the same port..."
+kill -USR2 $PID
+NEW=""
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    NEW=$(pgrep -P $PID -x webServer.out)
+    [ ! -z "$NEW" ] && break
+    sleep 0.2
+done
+sleep 0.5
+[ ! -z "$NEW" ] && kill -0 $NEW 2> /dev/null && echo "✅ SUCCESS: new pid $NEW" || echo "❌ FAILURE: no new process"
+
+echo "5. The port keeps answering while the old process drains..."
+curl -s -o "$TMP/body" $URL/cgi-bin/slow.py &
+CURL=$!
+sleep 0.5
+kill -QUIT $PID
+CODES=""
+for i in 1 2 3 4 5; do
+    CODES="$CODES$(curl -s -o /dev/null -w "%{http_code}" $URL/) "
+    sleep 0.2
+done
+wait $CURL
+[ "$CODES" = "200 200 200 200 200 " ] && grep -q "^done" "$TMP/body" \
+    && echo "✅ SUCCESS: $CODES, in-flight CGI finished" || echo "❌ FAILURE: got '$CODES'"
+
+echo "6. The old process exits, the new one serves alone..."
+wait_exit $PID 30
+CODE=$(curl -s -o /dev/null -w "%{http_code}" $URL/)
+! kill -0 $PID 2> /dev/null && [ "$CODE" = "200" ] && echo "✅ SUCCESS: 200 from pid $NEW" || echo "❌ FAILURE: got $CODE"
+
+kill -9 $PID 2> /dev/null
+wait $PID 2> /dev/null
+[ ! -z "$NEW" ] && kill $NEW 2> /dev/null && wait_exit $NEW 30
+rm -rf "$TMP"
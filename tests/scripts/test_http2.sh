@@ -0,0 +1,68 @@
+#!/bin/bash
+
+# Test script for HTTP/2 over cleartext (listen ... http2)
+# Starts its own server on PORT; needs a curl built with HTTP/2.
+
+PORT=8282
+if [ ! -z "$1" ]; then
+    PORT=$1
+fi
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+URL=http://localhost:$PORT
+
+echo "--- TESTING HTTP/2 ---"
+if ! curl -V | grep -q "HTTP2"; then
+    echo "⚠️  SKIPPED: curl was built without HTTP/2"
+    exit 0
+fi
+
+TMP=$(mktemp -d)
+cat > "$TMP/h2.conf" <<CONF
+http {
+    server {
+        listen $PORT http2;
+        server_name localhost;
+        root $ROOT/www;
+        index index.html;
+        location / {
+            allow_methods GET POST;
+        }
+        location /cgi-bin {
+            allow_methods GET POST;
+            cgi_ext .py;
+            cgi_path /usr/bin/python3;
+        }
+    }
+}
+CONF
+"$ROOT"/webServer.out "$TMP/h2.conf" > /dev/null 2>&1 &
+PID=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    curl -s -o /dev/null $URL/ && break
+    sleep 0.3
+done
+
+echo "1. GET with prior knowledge..."
+OUT=$(curl -s --http2-prior-knowledge -o /dev/null -w "%{http_version} %{http_code}" $URL/index.html)
+[ "$OUT" = "2 200" ] && echo "✅ SUCCESS: HTTP/2 200" || echo "❌ FAILURE: got '$OUT' (expected '2 200')"
+
+echo "2. Same body as the file on disk..."
+curl -s --http2-prior-knowledge $URL/index.html | cmp -s - "$ROOT/www/index.html" && echo "✅ SUCCESS: body matches" || echo "❌ FAILURE: body differs"
+
+echo "3. Missing file over HTTP/2..."
+OUT=$(curl -s --http2-prior-knowledge -o /dev/null -w "%{http_version} %{http_code}" $URL/no-such-file)
+[ "$OUT" = "2 404" ] && echo "✅ SUCCESS: HTTP/2 404" || echo "❌ FAILURE: got '$OUT' (expected '2 404')"
+
+echo "4. CGI over HTTP/2 is sent back to HTTP/1.1..."
+# The stream is reset with HTTP_1_1_REQUIRED; curl then retries over HTTP/1.1
+LOG=$(curl -sv --http2-prior-knowledge -o /dev/null -w "%{http_version} %{http_code}" $URL/cgi-bin/test.py 2>&1)
+echo "$LOG" | grep -q "HTTP_1_1_REQUIRED" && echo "$LOG" | tail -n1 | grep -q "^1.1 200" \
+    && echo "✅ SUCCESS: HTTP_1_1_REQUIRED, then 200 over HTTP/1.1" || echo "❌ FAILURE: got '$(echo "$LOG" | tail -n1)'"
+
+echo "5. HTTP/1.1 still served on the same port..."
+OUT=$(curl -s --http1.1 -o /dev/null -w "%{http_version} %{http_code}" $URL/index.html)
+[ "$OUT" = "1.1 200" ] && echo "✅ SUCCESS: HTTP/1.1 200" || echo "❌ FAILURE: got '$OUT'"
+
+kill $PID 2> /dev/null
+wait $PID 2> /dev/null
+rm -rf "$TMP"
@@ -0,0 +1,56 @@
+#!/bin/bash
+
+# Test script for limit_rate and limit_rate_after (response pacing)
+# Starts its own server on PORT.
+
+PORT=8288
+if [ ! -z "$1" ]; then
+    PORT=$1
+fi
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+URL=http://localhost:$PORT
+
+echo "--- TESTING LIMIT_RATE ---"
+TMP=$(mktemp -d)
+mkdir "$TMP/slow" "$TMP/after"
+head -c 61440 /dev/zero > "$TMP/slow/60k.bin"
+cp "$TMP/slow/60k.bin" "$TMP/after/60k.bin"
+cat > "$TMP/rate.conf" <<CONF
+http {
+    server {
+        listen $PORT;
+        server_name localhost;
+        root $TMP;
+        location / {
+            allow_methods GET;
+        }
+        location /slow {
+            allow_methods GET;
+            limit_rate 20k;
+        }
+        location /after {
+            allow_methods GET;
+            limit_rate 20k;
+            limit_rate_after 64k;
+        }
+    }
+}
+CONF
+"$ROOT"/webServer.out "$TMP/rate.conf" > /dev/null 2>&1 &
+PID=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    curl -s -o /dev/null $URL/ && break
+    sleep 0.3
+done
+
+echo "1. limit_rate 20k paces a 60 KB download..."
+TIME=$(curl -s -o /dev/null -w "%{time_total}" $URL/slow/60k.bin)
+awk "BEGIN { exit !($TIME >= 1.5) }" && echo "✅ SUCCESS: took ${TIME}s" || echo "❌ FAILURE: took ${TIME}s (expected >= 1.5s)"
+
+echo "2. limit_rate_after larger than the file..."
+TIME=$(curl -s -o /dev/null -w "%{time_total}" $URL/after/60k.bin)
+awk "BEGIN { exit !($TIME < 1.0) }" && echo "✅ SUCCESS: took ${TIME}s" || echo "❌ FAILURE: took ${TIME}s (expected < 1s)"
+
+kill $PID 2> /dev/null
+wait $PID 2> /dev/null
+rm -rf "$TMP"
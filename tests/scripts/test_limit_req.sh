@@ -0,0 +1,70 @@
+#!/bin/bash
+
+# Test script for limit_req (429 past the burst)
+# Starts its own server on PORT.
+
+PORT=8285
+if [ ! -z "$1" ]; then
+    PORT=$1
+fi
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+URL=http://localhost:$PORT
+
+echo "--- TESTING LIMIT_REQ ---"
+TMP=$(mktemp -d)
+mkdir "$TMP/req" "$TMP/key"
+echo "ok" > "$TMP/req/index.html"
+echo "ok" > "$TMP/key/index.html"
+cat > "$TMP/limits.conf" <<CONF
+http {
+    limit_req_zone \$binary_remote_addr zone=ip:1m rate=1r/m;
+    limit_req_zone \$http_x_api_key zone=key:1m rate=1r/m;
+    server {
+        listen $PORT;
+        server_name localhost;
+        root $TMP;
+        index index.html;
+        location / {
+            allow_methods GET;
+        }
+        location /req {
+            allow_methods GET;
+            limit_req zone=ip burst=2 nodelay;
+        }
+        location /key {
+            allow_methods GET;
+            limit_req zone=key nodelay;
+        }
+    }
+}
+CONF
+"$ROOT"/webServer.out "$TMP/limits.conf" > /dev/null 2>&1 &
+PID=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    curl -s -o /dev/null $URL/ && break
+    sleep 0.3
+done
+
+echo "1. Burst of 2 passes, the 4th request gets 429..."
+CODES=""
+for i in 1 2 3 4; do
+    CODES="$CODES$(curl -s -o /dev/null -w "%{http_code}" $URL/req/) "
+done
+[ "$CODES" = "200 200 200 429 " ] && echo "✅ SUCCESS: $CODES" || echo "❌ FAILURE: got '$CODES' (expected 200 200 200 429)"
+
+echo "2. Keyed on a header: each key has its own bucket..."
+A1=$(curl -s -o /dev/null -w "%{http_code}" -H "X-Api-Key: alpha" $URL/key/)
+A2=$(curl -s -o /dev/null -w "%{http_code}" -H "X-Api-Key: alpha" $URL/key/)
+B1=$(curl -s -o /dev/null -w "%{http_code}" -H "X-Api-Key: beta" $URL/key/)
+[ "$A1 $A2 $B1" = "200 429 200" ] && echo "✅ SUCCESS: alpha limited, beta not" || echo "❌ FAILURE: got '$A1 $A2 $B1' (expected 200 429 200)"
+
+echo "3. Requests without the header are not limited..."
+CODES=""
+for i in 1 2 3; do
+    CODES="$CODES$(curl -s -o /dev/null -w "%{http_code}" $URL/key/) "
+done
+[ "$CODES" = "200 200 200 " ] && echo "✅ SUCCESS: $CODES" || echo "❌ FAILURE: got '$CODES'"
+
+kill $PID 2> /dev/null
+wait $PID 2> /dev/null
+rm -rf "$TMP"
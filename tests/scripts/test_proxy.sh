@@ -0,0 +1,100 @@
+#!/bin/bash
+
+# Test script for proxy_pass
+# Starts a small Python backend on BPORT and its own server on PORT.
+
+PORT=8283
+BPORT=8293
+if [ ! -z "$1" ]; then
+    PORT=$1
+fi
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+URL=http://localhost:$PORT
+
+echo "--- TESTING PROXY_PASS ---"
+if ! command -v python3 > /dev/null; then
+    echo "⚠️  SKIPPED: python3 not found"
+    exit 0
+fi
+
+TMP=$(mktemp -d)
+cat > "$TMP/backend.py" <<'PY'
+import sys
+from http.server import BaseHTTPRequestHandler, HTTPServer
+
+class Echo(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def reply(self, body):
+        body = ("%s %s xff=%s\n" % (self.command, self.path,
+                self.headers.get("X-Forwarded-For")) + body).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "text/plain")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def do_GET(self):
+        self.reply("")
+
+    def do_POST(self):
+        length = int(self.headers.get("Content-Length", 0))
+        self.reply(self.rfile.read(length).decode())
+
+    def log_message(self, *args):
+        pass
+
+HTTPServer(("127.0.0.1", int(sys.argv[1])), Echo).serve_forever()
+PY
+cat > "$TMP/proxy.conf" <<CONF
+http {
+    server {
+        listen $PORT;
+        server_name localhost;
+        root $ROOT/www;
+        location /api {
+            allow_methods GET POST;
+            proxy_pass http://127.0.0.1:$BPORT;
+        }
+        location /old/ {
+            allow_methods GET;
+            proxy_pass http://127.0.0.1:$BPORT/new/;
+        }
+    }
+}
+CONF
+python3 "$TMP/backend.py" $BPORT &
+BPID=$!
+# A backend that refuses the first request would be skipped for 10 seconds
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    curl -s -o /dev/null http://127.0.0.1:$BPORT/ && break
+    sleep 0.3
+done
+"$ROOT"/webServer.out "$TMP/proxy.conf" > /dev/null 2>&1 &
+PID=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    curl -s -o /dev/null $URL/api/ready && break
+    sleep 0.3
+done
+
+echo "1. GET forwarded to the backend..."
+BODY=$(curl -s "$URL/api/items?id=7")
+echo "$BODY" | grep -q "^GET /api/items?id=7 xff=127.0.0.1" && echo "✅ SUCCESS: target and X-Forwarded-For passed" || echo "❌ FAILURE: got '$BODY'"
+
+echo "2. POST body forwarded..."
+BODY=$(curl -s -d "hello backend" $URL/api/echo)
+echo "$BODY" | grep -q "^hello backend$" && echo "✅ SUCCESS: body echoed" || echo "❌ FAILURE: got '$BODY'"
+
+echo "3. URI after the address replaces the location prefix..."
+BODY=$(curl -s $URL/old/page)
+echo "$BODY" | grep -q "^GET /new/page " && echo "✅ SUCCESS: /old/page sent as /new/page" || echo "❌ FAILURE: got '$BODY'"
+
+echo "4. Backend down..."
+kill $BPID 2> /dev/null
+wait $BPID 2> /dev/null
+CODE=$(curl -s -o /dev/null -w "%{http_code}" $URL/api/items)
+[ "$CODE" = "502" ] && echo "✅ SUCCESS: 502 Bad Gateway" || echo "❌ FAILURE: got $CODE (expected 502)"
+
+kill $PID 2> /dev/null
+wait $PID 2> /dev/null
+rm -rf "$TMP"
@@ -0,0 +1,34 @@
+#!/bin/bash
+
+# Test script for Range requests (206 Partial Content / 416)
+
+PORT=8080
+if [ ! -z "$1" ]; then
+    PORT=$1
+fi
+URL=http://localhost:$PORT/index.html
+
+echo "--- TESTING RANGE REQUESTS ---"
+FULL=$(curl -s $URL | head -c 10)
+ETAG=$(curl -s -I $URL | tr -d '\r' | grep -i "^ETag:" | cut -d' ' -f2)
+
+echo "1. Single range bytes=0-9..."
+PART=$(curl -s -r 0-9 $URL)
+CODE=$(curl -s -o /dev/null -w "%{http_code}" -r 0-9 $URL)
+[ "$CODE" = "206" ] && [ "$PART" = "$FULL" ] && echo "✅ SUCCESS: 206 with the first 10 bytes" || echo "❌ FAILURE: got $CODE (expected 206)"
+
+echo "2. Multiple ranges..."
+TYPE=$(curl -s -o /dev/null -w "%{content_type}" -r 0-0,5-6 $URL)
+echo "$TYPE" | grep -q "multipart/byteranges" && echo "✅ SUCCESS: multipart/byteranges" || echo "❌ FAILURE: got '$TYPE'"
+
+echo "3. Range past the end..."
+CODE=$(curl -s -o /dev/null -w "%{http_code}" -r 100000000- $URL)
+[ "$CODE" = "416" ] && echo "✅ SUCCESS: 416 Range Not Satisfiable" || echo "❌ FAILURE: got $CODE (expected 416)"
+
+echo "4. If-Range with a stale ETag..."
+CODE=$(curl -s -o /dev/null -w "%{http_code}" -H 'If-Range: "stale"' -r 0-9 $URL)
+[ "$CODE" = "200" ] && echo "✅ SUCCESS: 200 OK (full body)" || echo "❌ FAILURE: got $CODE (expected 200)"
+
+echo "5. If-Range with the current ETag..."
+CODE=$(curl -s -o /dev/null -w "%{http_code}" -H "If-Range: $ETAG" -r 0-9 $URL)
+[ "$CODE" = "206" ] && echo "✅ SUCCESS: 206 Partial Content" || echo "❌ FAILURE: got $CODE (expected 206)"
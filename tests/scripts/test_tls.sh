@@ -0,0 +1,61 @@
+#!/bin/bash
+
+# Test script for TLS termination (listen ... ssl)
+# Starts its own server on PORT with a throwaway self-signed certificate.
+
+PORT=8443
+if [ ! -z "$1" ]; then
+    PORT=$1
+fi
+ROOT=$(cd "$(dirname "$0")/../.." && pwd)
+URL=https://localhost:$PORT/index.html
+
+echo "--- TESTING TLS ---"
+if ! command -v openssl > /dev/null; then
+    echo "⚠️  SKIPPED: openssl not found"
+    exit 0
+fi
+
+TMP=$(mktemp -d)
+openssl req -x509 -newkey rsa:2048 -nodes -days 1 -subj "/CN=localhost" \
+    -keyout "$TMP/key.pem" -out "$TMP/cert.pem" > /dev/null 2>&1
+cat > "$TMP/tls.conf" <<CONF
+http {
+    server {
+        listen $PORT ssl;
+        server_name localhost;
+        root $ROOT/www;
+        index index.html;
+        ssl_certificate     $TMP/cert.pem;
+        ssl_certificate_key $TMP/key.pem;
+        location / {
+            allow_methods GET;
+        }
+    }
+}
+CONF
+"$ROOT"/webServer.out "$TMP/tls.conf" > /dev/null 2>&1 &
+PID=$!
+for i in 1 2 3 4 5 6 7 8 9 10; do
+    curl -sk -o /dev/null $URL && break
+    sleep 0.3
+done
+
+echo "1. GET over TLS..."
+CODE=$(curl -sk -o /dev/null -w "%{http_code}" $URL)
+[ "$CODE" = "200" ] && echo "✅ SUCCESS: 200 OK over https" || echo "❌ FAILURE: got $CODE (expected 200)"
+
+echo "2. Same body as the file on disk..."
+curl -sk $URL | cmp -s - "$ROOT/www/index.html" && echo "✅ SUCCESS: body matches" || echo "❌ FAILURE: body differs"
+
+echo "3. Two requests on one TLS connection (keep-alive)..."
+REUSED=$(curl -sk -v -o /dev/null $URL -o /dev/null $URL 2>&1 | grep -c "Re-using existing connection")
+[ "$REUSED" -ge 1 ] && echo "✅ SUCCESS: connection reused" || echo "❌ FAILURE: second request opened a new connection"
+
+echo "4. Plain HTTP on the TLS port is refused..."
+CODE=$(curl -s -o /dev/null -w "%{http_code}" --max-time 3 http://localhost:$PORT/)
+[ "$CODE" != "200" ] && echo "✅ SUCCESS: no plaintext response ($CODE)" || echo "❌ FAILURE: got 200 over plain HTTP"
+
+kill $PID 2> /dev/null
+wait $PID 2> /dev/null
+rm -rf "$TMP"